@@ -0,0 +1,111 @@
+#!/bin/bash
+
+# ============================================================================
+# STVM Backend Benchmark
+# 栈式 / 寄存器格式两种执行后端在功能测试程序上的对比
+#   用法: ./bench_backends.sh [重复次数]   (默认 20)
+# ============================================================================
+
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+BLUE='\033[0;34m'
+NC='\033[0m'
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+STVM_BIN="$SCRIPT_DIR/build/bin/stvm"
+FUNC_DIR="$SCRIPT_DIR/tests/functional"
+REPEAT="${1:-20}"
+TMP_DIR="$(mktemp -d /tmp/stvm_bench_XXXXXX)"
+FAILED=0
+
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+if [ ! -x "$STVM_BIN" ]; then
+    echo -e "${RED}未找到 $STVM_BIN，请先执行 make${NC}"
+    exit 1
+fi
+
+echo ""
+echo -e "${BLUE}============================================${NC}"
+echo -e "${BLUE}  STVM 执行后端对比 (重复 $REPEAT 次)${NC}"
+echo -e "${BLUE}============================================${NC}"
+echo ""
+printf "%-20s %-8s %12s %12s %12s\n" "程序" "后端" "字节码指令" "执行指令数" "耗时(ms)"
+
+# 运行一个后端：输出 "静态指令数 执行指令数 总耗时毫秒"，失败时返回非零
+run_backend() {
+    local file="$1"
+    local bc_file="$2"
+    local compile_args="$3"
+    local run_args="$4"
+    local log="$TMP_DIR/run.log"
+
+    "$STVM_BIN" -c "$file" -o "$bc_file" -s $compile_args > "$TMP_DIR/compile.log" 2>&1 || return 1
+    local static_count
+    static_count=$(grep -m1 "指令数量" "$TMP_DIR/compile.log" | awk -F': ' '{print $2}')
+
+    local start end
+    start=$(date +%s%N)
+    for ((i = 0; i < REPEAT; i++)); do
+        timeout 10 "$STVM_BIN" -r "$bc_file" -s $run_args > "$log" 2>&1
+        local rc=$?
+        if [ $rc -ne 0 ] && [ $rc -ne 124 ]; then
+            tail -5 "$log"
+            return 1
+        fi
+    done
+    end=$(date +%s%N)
+
+    local executed
+    executed=$(grep -m1 "执行指令数" "$log" | awk -F': ' '{print $2}')
+    echo "$static_count $executed $(( (end - start) / 1000000 ))"
+    # 程序输出（去掉统计信息）供两个后端比对
+    sed '/=== 统计信息 ===/,$d' "$log" > "$bc_file.out"
+}
+
+bench() {
+    local name="$1"
+    local file="$2"
+    local args="$3"
+    local stack_bc="$TMP_DIR/${name}_stack.stbc"
+    local reg_bc="$TMP_DIR/${name}_reg.stbc"
+
+    local stack_result reg_result
+    if ! stack_result=$(run_backend "$file" "$stack_bc" "" "$args"); then
+        echo -e "${RED}$name: 栈式后端失败${NC}"
+        FAILED=$((FAILED + 1))
+        return 1
+    fi
+    if ! reg_result=$(run_backend "$file" "$reg_bc" "--regvm" "$args"); then
+        echo -e "${RED}$name: 寄存器后端失败${NC}"
+        FAILED=$((FAILED + 1))
+        return 1
+    fi
+
+    read -r s_static s_exec s_ms <<< "$stack_result"
+    read -r r_static r_exec r_ms <<< "$reg_result"
+    printf "%-20s %-8s %12s %12s %12s\n" "$name" "stack" "$s_static" "$s_exec" "$s_ms"
+    printf "%-20s %-8s %12s %12s %12s\n" "" "register" "$r_static" "$r_exec" "$r_ms"
+
+    if ! cmp -s "$stack_bc.out" "$reg_bc.out"; then
+        echo -e "${RED}  输出不一致${NC}"
+        diff "$stack_bc.out" "$reg_bc.out" | head -5
+        FAILED=$((FAILED + 1))
+    elif [ -n "$s_exec" ] && [ -n "$r_exec" ] && [ "$r_exec" -gt 0 ]; then
+        echo -e "  ${GREEN}输出一致${NC}，执行指令数比 $(awk "BEGIN {printf \"%.2f\", $s_exec / $r_exec}")x"
+    fi
+}
+
+# io_test 与 reactor_2oo4_test 在栈式后端上本身即运行失败，无法比对，不纳入对比
+bench "syntax_test"        "$FUNC_DIR/syntax_test.st"        ""
+bench "safety_test"        "$FUNC_DIR/safety_test.st"        ""
+echo ""
+
+if [ $FAILED -eq 0 ]; then
+    echo -e "${GREEN}两种后端结果一致${NC}"
+    exit 0
+else
+    echo -e "${YELLOW}存在失败用例: $FAILED${NC}"
+    exit 1
+fi
@@ -249,6 +249,19 @@ ASTNode* ast_create_case_element(ASTNode* labels, ASTNode* statements) {
     return node;
 }
 
+/**
+ * @brief 创建case范围标签节点
+ */
+ASTNode* ast_create_case_range(ASTNode* low, ASTNode* high) {
+    ASTNode* node = ast_create_node(AST_CASE_RANGE);
+    if (!node) return NULL;
+    
+    node->data.case_range.low = low;
+    node->data.case_range.high = high;
+    
+    return node;
+}
+
 /**
  * @brief 创建语句块节点
  */
@@ -471,6 +484,11 @@ void ast_free_node(ASTNode* node) {
             ast_free_node(node->data.case_element.statements);
             break;
             
+        case AST_CASE_RANGE:
+            ast_free_node(node->data.case_range.low);
+            ast_free_node(node->data.case_range.high);
+            break;
+            
         case AST_BINARY_OP:
             ast_free_node(node->data.binary_op.left);
             ast_free_node(node->data.binary_op.right);
@@ -542,6 +560,8 @@ const char* binary_op_to_string(BinaryOp op) {
     if (op >= 0 && op <= BINOP_OR) {
         return op_strings[op];
     }
+    if (op == BINOP_AND_THEN) return "AND_THEN";
+    if (op == BINOP_OR_ELSE) return "OR_ELSE";
     return "?";
 }
 
@@ -679,6 +699,14 @@ void ast_print(ASTNode* node, int indent) {
             ast_print(node->data.case_element.statements, indent + 2);
             break;
             
+        case AST_CASE_RANGE:
+            printf("CASE_RANGE\n");
+            print_indent(indent); printf("  Low:\n");
+            ast_print(node->data.case_range.low, indent + 2);
+            print_indent(indent); printf("  High:\n");
+            ast_print(node->data.case_range.high, indent + 2);
+            break;
+            
         case AST_BINARY_OP:
             printf("BINARY_OP: %s\n", binary_op_to_string(node->data.binary_op.op));
             print_indent(indent); printf("  Left:\n");
@@ -782,6 +810,11 @@ void ast_visit(ASTNode* node, ASTVisitor visitor, void* context) {
             ast_visit(node->data.case_element.statements, visitor, context);
             break;
             
+        case AST_CASE_RANGE:
+            ast_visit(node->data.case_range.low, visitor, context);
+            ast_visit(node->data.case_range.high, visitor, context);
+            break;
+            
         case AST_BINARY_OP:
             ast_visit(node->data.binary_op.left, visitor, context);
             ast_visit(node->data.binary_op.right, visitor, context);
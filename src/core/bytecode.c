@@ -4,10 +4,15 @@
  */
 
 #include "bytecode.h"
+#include "bytecode_io.h"
+#include "regcode.h"
 #include "mmgr.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
 /**
  * @brief 获取操作码名称字符串
@@ -22,7 +27,10 @@ const char* opcode_to_string(Opcode opcode) {
         "JMP", "JZ", "JNZ", "CALL", "RET",
         "HALT", "CALL_EXT", "NOP", "LOAD_INDEXED", "STORE_INDEXED",
         "LOAD_VAL", "LOAD_QUALITY", "STORE_VAL", "STORE_QUALITY",
-        "IO_READ", "IO_WRITE"
+        "IO_READ", "IO_WRITE",
+        "SWITCH",
+        "FOR_INIT", "FOR_STEP",
+        "LOAD_ARRAY", "STORE_ARRAY"
     };
     
     if (opcode >= 0 && opcode < OP_COUNT) {
@@ -35,47 +43,51 @@ const char* opcode_to_string(Opcode opcode) {
  * @brief 创建字节码模块
  */
 BytecodeModule* bytecode_module_create(void) {
+    return bytecode_module_create_sized(INITIAL_INSTRUCTION_CAPACITY,
+                                        INITIAL_CONSTANT_CAPACITY,
+                                        INITIAL_FUNCTION_CAPACITY);
+}
+
+/**
+ * @brief 按给定容量创建字节码模块
+ */
+BytecodeModule* bytecode_module_create_sized(uint32_t instruction_capacity,
+                                             uint32_t const_capacity,
+                                             uint32_t function_capacity) {
     BytecodeModule* module = (BytecodeModule*)mmgr_calloc(sizeof(BytecodeModule));
     if (!module) return NULL;
     
     // 分配指令数组
-    module->instruction_capacity = INITIAL_INSTRUCTION_CAPACITY;
-    module->instructions = (Instruction*)mmgr_alloc(sizeof(Instruction) * module->instruction_capacity);
-    if (!module->instructions) {
-        mmgr_free(module);
-        return NULL;
+    if (instruction_capacity > 0) {
+        module->instructions = (Instruction*)mmgr_alloc(sizeof(Instruction) * instruction_capacity);
+        if (!module->instructions) {
+            mmgr_free(module);
+            return NULL;
+        }
+        module->instruction_capacity = instruction_capacity;
     }
     
     // 分配常量池
-    module->const_capacity = INITIAL_CONSTANT_CAPACITY;
-    module->constants = (Constant*)mmgr_alloc(sizeof(Constant) * module->const_capacity);
-    if (!module->constants) {
-        mmgr_free(module->instructions);
-        mmgr_free(module);
-        return NULL;
+    if (const_capacity > 0) {
+        module->constants = (Constant*)mmgr_alloc(sizeof(Constant) * const_capacity);
+        if (!module->constants) {
+            bytecode_module_free(module);
+            return NULL;
+        }
+        module->const_capacity = const_capacity;
     }
     
     // 分配函数表
-    module->function_capacity = INITIAL_FUNCTION_CAPACITY;
-    module->functions = (FunctionEntry*)mmgr_alloc(sizeof(FunctionEntry) * module->function_capacity);
-    if (!module->functions) {
-        mmgr_free(module->constants);
-        mmgr_free(module->instructions);
-        mmgr_free(module);
-        return NULL;
+    if (function_capacity > 0) {
+        module->functions = (FunctionEntry*)mmgr_alloc(sizeof(FunctionEntry) * function_capacity);
+        if (!module->functions) {
+            bytecode_module_free(module);
+            return NULL;
+        }
+        module->function_capacity = function_capacity;
     }
     
-    module->instruction_count = 0;
-    module->const_count = 0;
-    module->function_count = 0;
-    module->global_count = 0;
-    module->entry_point = 0;
-    module->line_numbers = NULL;
-    module->source_file = NULL;
-    module->library_deps = NULL;
-    module->library_dep_count = 0;
-    module->globals_info = NULL;
-    
+    // 其余字段由 mmgr_calloc 清零
     return module;
 }
 
@@ -85,8 +97,10 @@ BytecodeModule* bytecode_module_create(void) {
 void bytecode_module_free(BytecodeModule* module) {
     if (!module) return;
     
-    // 释放指令数组
-    if (module->instructions) {
+    regcode_free(module->reg_code);
+    
+    // 释放指令数组（指向映像时由映像统一释放）
+    if (module->instructions && !bytecode_in_image(module, module->instructions)) {
         mmgr_free(module->instructions);
     }
     
@@ -102,13 +116,17 @@ void bytecode_module_free(BytecodeModule* module) {
     
     // 释放常量池中的字符串
     for (uint32_t i = 0; i < module->const_count; i++) {
-        if (module->constants[i].type == CONST_STRING && module->constants[i].string_val) {
+        if (module->constants[i].type == CONST_STRING && module->constants[i].string_val &&
+            !bytecode_in_image(module, module->constants[i].string_val)) {
             mmgr_free(module->constants[i].string_val);
         }
     }
     if (module->constants) {
         mmgr_free(module->constants);
     }
+    if (module->const_index) {
+        mmgr_free(module->const_index);
+    }
     
     // 释放函数表中的字符串和参数类型数组
     for (uint32_t i = 0; i < module->function_count; i++) {
@@ -123,9 +141,30 @@ void bytecode_module_free(BytecodeModule* module) {
         mmgr_free(module->functions);
     }
     
-    // 释放行号数组
-    if (module->line_numbers) {
-        mmgr_free(module->line_numbers);
+    // 释放跳转表
+    if (module->switch_tables) {
+        mmgr_free(module->switch_tables);
+    }
+    if (module->switch_cases) {
+        mmgr_free(module->switch_cases);
+    }
+    
+    // 释放循环描述符
+    if (module->for_loops) {
+        mmgr_free(module->for_loops);
+    }
+    
+    // 释放数组描述符
+    if (module->array_bounds) {
+        mmgr_free(module->array_bounds);
+    }
+    
+    // 释放行号表
+    if (module->line_table.entries) {
+        mmgr_free(module->line_table.entries);
+    }
+    if (module->line_table.by_line) {
+        mmgr_free(module->line_table.by_line);
     }
     
     // 释放源文件名
@@ -143,14 +182,68 @@ void bytecode_module_free(BytecodeModule* module) {
         mmgr_free(module->library_deps);
     }
     
+    // 释放文件映像
+    if (module->image) {
+        if (module->image_mapped) {
+            munmap(module->image, module->image_size);
+        } else {
+            mmgr_free(module->image);
+        }
+    }
+    
     mmgr_free(module);
 }
 
 /**
- * @brief 扩展指令数组容量
+ * @brief 判断指针是否位于文件映像内
+ */
+bool bytecode_in_image(const BytecodeModule* module, const void* ptr) {
+    if (!module || !module->image || !ptr) return false;
+    const uint8_t* base = (const uint8_t*)module->image;
+    const uint8_t* p = (const uint8_t*)ptr;
+    return p >= base && p < base + module->image_size;
+}
+
+/**
+ * @brief 确保指令数组可写（写时复制）
+ */
+bool bytecode_make_writable(BytecodeModule* module) {
+    if (!module) return false;
+    // 指令即将被修改，由其翻译的寄存器代码随之失效
+    regcode_discard(module);
+    if (!bytecode_in_image(module, module->instructions)) return true;
+    
+    uint32_t capacity = module->instruction_count ? module->instruction_count : 1;
+    Instruction* copy = (Instruction*)mmgr_alloc(sizeof(Instruction) * capacity);
+    if (!copy) return false;
+    
+    memcpy(copy, module->instructions, sizeof(Instruction) * module->instruction_count);
+    module->instructions = copy;
+    module->instruction_capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief 计算几何增长后的容量
+ */
+static uint32_t grow_capacity(uint32_t current, uint32_t needed, uint32_t minimum) {
+    uint32_t capacity = current ? current : minimum;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+/**
+ * @brief 确保指令数组容量
  */
-static bool expand_instructions(BytecodeModule* module) {
-    uint32_t new_capacity = module->instruction_capacity * 2;
+bool bytecode_reserve_instructions(BytecodeModule* module, uint32_t needed) {
+    if (!module) return false;
+    if (!bytecode_make_writable(module)) return false;
+    if (needed <= module->instruction_capacity) return true;
+    
+    uint32_t new_capacity = grow_capacity(module->instruction_capacity, needed,
+                                          INITIAL_INSTRUCTION_CAPACITY);
     Instruction* new_instructions = (Instruction*)mmgr_realloc(
         module->instructions, 
         sizeof(Instruction) * new_capacity
@@ -160,18 +253,6 @@ static bool expand_instructions(BytecodeModule* module) {
     
     module->instructions = new_instructions;
     module->instruction_capacity = new_capacity;
-    
-    // 同时扩展行号数组（如果存在）
-    if (module->line_numbers) {
-        int* new_line_numbers = (int*)mmgr_realloc(
-            module->line_numbers,
-            sizeof(int) * new_capacity
-        );
-        if (new_line_numbers) {
-            module->line_numbers = new_line_numbers;
-        }
-    }
-    
     return true;
 }
 
@@ -179,10 +260,8 @@ static bool expand_instructions(BytecodeModule* module) {
  * @brief 添加指令
  */
 uint32_t bytecode_add_instruction(BytecodeModule* module, Opcode opcode, uint8_t flags, uint16_t operand) {
-    if (module->instruction_count >= module->instruction_capacity) {
-        if (!expand_instructions(module)) {
-            return (uint32_t)-1;
-        }
+    if (!bytecode_reserve_instructions(module, module->instruction_count + 1)) {
+        return (uint32_t)-1;
     }
     
     uint32_t index = module->instruction_count++;
@@ -198,36 +277,355 @@ uint32_t bytecode_add_instruction(BytecodeModule* module, Opcode opcode, uint8_t
  */
 uint32_t bytecode_add_instruction_with_line(BytecodeModule* module, Opcode opcode, 
                                              uint8_t flags, uint16_t operand, int line) {
-    // 如果还没有行号数组，创建一个
-    if (!module->line_numbers) {
-        module->line_numbers = (int*)mmgr_calloc(sizeof(int) * module->instruction_capacity);
-        if (!module->line_numbers) {
-            return (uint32_t)-1;
+    uint32_t index = bytecode_add_instruction(module, opcode, flags, operand);
+    if (index != (uint32_t)-1 && !bytecode_line_table_append(module, index, line)) {
+        return (uint32_t)-1;
+    }
+    
+    return index;
+}
+
+// ============================================================================
+// 行号表
+// ============================================================================
+
+/**
+ * @brief 在行号表末尾记录行号
+ */
+bool bytecode_line_table_append(BytecodeModule* module, uint32_t pc, int32_t line) {
+    if (!module) return false;
+    LineTable* table = &module->line_table;
+    
+    if (table->count > 0) {
+        LineEntry* last = &table->entries[table->count - 1];
+        if (pc < last->pc) return false;
+        if (last->line == line) return true;   // 同一行的连续指令共用一个条目
+        if (last->pc == pc) {                   // 同一 pc 重新指定行号
+            last->line = line;
+            goto invalidate;
         }
     }
     
-    uint32_t index = bytecode_add_instruction(module, opcode, flags, operand);
-    if (index != (uint32_t)-1) {
-        module->line_numbers[index] = line;
+    if (table->count >= table->capacity) {
+        uint32_t capacity = table->capacity ? table->capacity * 2 : 64;
+        LineEntry* entries = (LineEntry*)mmgr_realloc(table->entries, sizeof(LineEntry) * capacity);
+        if (!entries) return false;
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+    table->entries[table->count].pc = pc;
+    table->entries[table->count].line = line;
+    table->count++;
+    
+invalidate:
+    if (table->by_line) {
+        mmgr_free(table->by_line);
+        table->by_line = NULL;
+    }
+    return true;
+}
+
+/**
+ * @brief pc → 行号：二分查找最后一个起始地址不大于 pc 的条目
+ */
+int32_t bytecode_line_for_pc(const BytecodeModule* module, uint32_t pc) {
+    if (!module || module->line_table.count == 0 || pc >= module->instruction_count) {
+        return 0;
     }
     
+    const LineEntry* entries = module->line_table.entries;
+    if (pc < entries[0].pc) return 0;
+    
+    uint32_t lo = 0, hi = module->line_table.count - 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo + 1) / 2;
+        if (entries[mid].pc <= pc) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return entries[lo].line;
+}
+
+/**
+ * @brief 行号索引的构建锁（查询可能来自调试器等多个线程）
+ */
+static pthread_mutex_t g_line_index_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief 按 (line, pc) 比较条目
+ */
+static int compare_by_line(const void* a, const void* b) {
+    const LineEntry* ea = (const LineEntry*)a;
+    const LineEntry* eb = (const LineEntry*)b;
+    if (ea->line != eb->line) return ea->line < eb->line ? -1 : 1;
+    if (ea->pc != eb->pc) return ea->pc < eb->pc ? -1 : 1;
+    return 0;
+}
+
+/**
+ * @brief 取行号索引，没有时在锁内构建并发布
+ */
+static const LineEntry* line_index(LineTable* table) {
+    LineEntry* index = __atomic_load_n(&table->by_line, __ATOMIC_ACQUIRE);
+    if (index) return index;
+    
+    pthread_mutex_lock(&g_line_index_lock);
+    index = table->by_line;
+    if (!index) {
+        index = (LineEntry*)mmgr_alloc(sizeof(LineEntry) * table->count);
+        if (index) {
+            memcpy(index, table->entries, sizeof(LineEntry) * table->count);
+            qsort(index, table->count, sizeof(LineEntry), compare_by_line);
+            __atomic_store_n(&table->by_line, index, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&g_line_index_lock);
     return index;
 }
 
+/**
+ * @brief 行号 → pc：在按行号排序的索引上二分查找
+ */
+uint32_t bytecode_pc_for_line(BytecodeModule* module, int32_t line) {
+    if (!module || module->line_table.count == 0) return (uint32_t)-1;
+    LineTable* table = &module->line_table;
+    const LineEntry* index = line_index(table);
+    if (!index) return (uint32_t)-1;
+    
+    // 第一个 line' >= line 的条目；相同行号中 pc 最小者排在最前
+    uint32_t lo = 0, hi = table->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (index[mid].line < line) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == table->count) return (uint32_t)-1;
+    return index[lo].pc;
+}
+
 /**
  * @brief 修改指令的操作数（用于回填跳转地址）
  */
 void bytecode_patch_operand(BytecodeModule* module, uint32_t index, uint16_t operand) {
-    if (index < module->instruction_count) {
+    if (index < module->instruction_count && bytecode_make_writable(module)) {
         module->instructions[index].operand = operand;
     }
 }
 
+/**
+ * @brief 按地址映射重定位指令以外的代码地址
+ * 
+ * 函数入口、跳转表、FOR 循环描述符和入口点中不超过 count 的地址 a 改为 map[a]。
+ */
+static void relocate_addresses(BytecodeModule* module, const uint32_t* map, uint32_t count) {
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        if (module->functions[i].address <= count) {
+            module->functions[i].address = map[module->functions[i].address];
+        }
+    }
+    for (uint32_t i = 0; i < module->switch_table_count; i++) {
+        if (module->switch_tables[i].default_target <= count) {
+            module->switch_tables[i].default_target = map[module->switch_tables[i].default_target];
+        }
+    }
+    for (uint32_t i = 0; i < module->switch_case_count; i++) {
+        if (module->switch_cases[i].target <= count) {
+            module->switch_cases[i].target = map[module->switch_cases[i].target];
+        }
+    }
+    for (uint32_t i = 0; i < module->for_loop_count; i++) {
+        if (module->for_loops[i].body <= count) {
+            module->for_loops[i].body = map[module->for_loops[i].body];
+        }
+        if (module->for_loops[i].exit <= count) {
+            module->for_loops[i].exit = map[module->for_loops[i].exit];
+        }
+    }
+    if (module->entry_point <= count) {
+        module->entry_point = map[module->entry_point];
+    }
+    // 导出符号索引记录的是旧地址，失效后回退到顺序查找
+    module->symbol_index = NULL;
+}
+
+/**
+ * @brief 删除标记的指令并重定位地址
+ */
+uint32_t bytecode_remove_instructions(BytecodeModule* module, const bool* removed) {
+    if (!module || !removed) return (uint32_t)-1;
+    
+    // 行号表要随指令重定位，调试段须先载入；指令数组可能仍指向只读映像
+    if (bytecode_load_debug_info(module) != OK || !bytecode_make_writable(module)) {
+        return (uint32_t)-1;
+    }
+    
+    uint32_t count = module->instruction_count;
+    
+    // map[i]：旧地址 i 之后（含 i）第一条保留指令的新地址；map[count] 为新的指令数
+    uint32_t* map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (count + 1));
+    if (!map) return (uint32_t)-1;
+    
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        map[i] = kept;
+        if (!removed[i]) kept++;
+    }
+    map[count] = kept;
+    
+    if (kept == count) {
+        mmgr_free(map);
+        return 0;
+    }
+    
+    // 压缩指令并重定位跳转目标（CALL 的操作数是函数索引，不需要调整）
+    for (uint32_t i = 0; i < count; i++) {
+        if (removed[i]) continue;
+        Instruction instr = module->instructions[i];
+        if ((instr.opcode == OP_JMP || instr.opcode == OP_JZ || instr.opcode == OP_JNZ) &&
+            instr.operand <= count) {
+            instr.operand = (uint16_t)map[instr.operand];
+        }
+        module->instructions[map[i]] = instr;
+    }
+    module->instruction_count = kept;
+    relocate_addresses(module, map, count);
+    
+    // 行号表：落在同一新地址上的条目以后者为准，相邻同行条目合并
+    LineTable* table = &module->line_table;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < table->count; i++) {
+        uint32_t pc = table->entries[i].pc <= count ? map[table->entries[i].pc] : kept;
+        int32_t line = table->entries[i].line;
+        if (pc >= kept) break;
+        if (n > 0 && table->entries[n - 1].pc == pc) {
+            n--;
+        }
+        if (n > 0 && table->entries[n - 1].line == line) {
+            continue;
+        }
+        table->entries[n].pc = pc;
+        table->entries[n].line = line;
+        n++;
+    }
+    table->count = n;
+    if (table->by_line) {
+        mmgr_free(table->by_line);
+        table->by_line = NULL;
+    }
+    
+    mmgr_free(map);
+    return count - kept;
+}
+
+/**
+ * @brief 用一段指令替换一条指令并重定位地址
+ */
+bool bytecode_replace_instruction(BytecodeModule* module, uint32_t index,
+                                  const Instruction* code, uint32_t count,
+                                  const LineEntry* lines, uint32_t line_count) {
+    if (!module || !code || count == 0 || index >= module->instruction_count) return false;
+    
+    uint32_t old_count = module->instruction_count;
+    uint32_t new_count = old_count + count - 1;
+    if (new_count > UINT16_MAX) return false;
+    if (bytecode_load_debug_info(module) != OK ||
+        !bytecode_reserve_instructions(module, new_count)) {
+        return false;
+    }
+    
+    // 行号表先按新布局重建（失败时模块保持不变）
+    LineTable* table = &module->line_table;
+    LineEntry* entries = NULL;
+    uint32_t n = 0;
+    if (table->count > 0 || line_count > 0) {
+        entries = (LineEntry*)mmgr_alloc(sizeof(LineEntry) * (table->count + line_count + 1));
+        if (!entries) return false;
+        
+        int32_t next_line = index + 1 < old_count ? bytecode_line_for_pc(module, index + 1) : 0;
+        uint32_t i = 0;
+        for (; i < table->count && table->entries[i].pc <= index; i++) {
+            entries[n++] = table->entries[i];
+        }
+        for (uint32_t j = 0; j < line_count; j++) {
+            entries[n].pc = index + lines[j].pc;
+            entries[n++].line = lines[j].line;
+        }
+        if (index + 1 < old_count) {
+            entries[n].pc = index + count;
+            entries[n++].line = next_line;
+        }
+        for (; i < table->count; i++) {
+            entries[n].pc = table->entries[i].pc + count - 1;
+            entries[n++].line = table->entries[i].line;
+        }
+        
+        // 同一地址以后者为准，相邻同行条目合并
+        uint32_t kept = 0;
+        for (uint32_t j = 0; j < n; j++) {
+            if (kept > 0 && entries[kept - 1].pc == entries[j].pc) kept--;
+            if (kept > 0 && entries[kept - 1].line == entries[j].line) continue;
+            entries[kept++] = entries[j];
+        }
+        n = kept;
+    }
+    
+    // map[i]：旧地址 i 的新地址，指向被替换指令的地址仍指向片段起点
+    uint32_t* map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (old_count + 1));
+    if (!map) {
+        if (entries) mmgr_free(entries);
+        return false;
+    }
+    for (uint32_t i = 0; i <= old_count; i++) {
+        map[i] = i <= index ? i : i + count - 1;
+    }
+    
+    Instruction* instrs = module->instructions;
+    for (uint32_t i = 0; i < old_count; i++) {
+        Opcode op = instrs[i].opcode;
+        if ((op == OP_JMP || op == OP_JZ || op == OP_JNZ) && instrs[i].operand <= old_count) {
+            instrs[i].operand = (uint16_t)map[instrs[i].operand];
+        }
+    }
+    memmove(&instrs[index + count], &instrs[index + 1], sizeof(Instruction) * (old_count - index - 1));
+    memcpy(&instrs[index], code, sizeof(Instruction) * count);
+    module->instruction_count = new_count;
+    relocate_addresses(module, map, old_count);
+    mmgr_free(map);
+    
+    if (entries) {
+        if (table->entries) mmgr_free(table->entries);
+        table->entries = entries;
+        table->count = n;
+        table->capacity = n;
+        if (table->by_line) {
+            mmgr_free(table->by_line);
+            table->by_line = NULL;
+        }
+    }
+    return true;
+}
+
 /**
  * @brief 扩展常量池容量
  */
 static bool expand_constants(BytecodeModule* module) {
-    uint32_t new_capacity = module->const_capacity * 2;
+    return bytecode_reserve_constants(module, module->const_count + 1);
+}
+
+/**
+ * @brief 确保常量池容量
+ */
+bool bytecode_reserve_constants(BytecodeModule* module, uint32_t needed) {
+    if (!module) return false;
+    if (needed <= module->const_capacity) return true;
+    
+    uint32_t new_capacity = grow_capacity(module->const_capacity, needed,
+                                          INITIAL_CONSTANT_CAPACITY);
     Constant* new_constants = (Constant*)mmgr_realloc(
         module->constants,
         sizeof(Constant) * new_capacity
@@ -240,16 +638,159 @@ static bool expand_constants(BytecodeModule* module) {
     return true;
 }
 
+// ============================================================================
+// 常量池哈希索引
+// ============================================================================
+
+#define CONST_INDEX_MIN_CAPACITY 64
+
 /**
- * @brief 添加整数常量
+ * @brief 计算常量的哈希值（FNV-1a，类型参与哈希）
+ *
+ * 实数按位比较：-0.0 与 0.0 视为不同常量，NaN 可与自身去重。
  */
-uint32_t bytecode_add_int_constant(BytecodeModule* module, int32_t value) {
-    // 检查是否已存在相同的常量
-    for (uint32_t i = 0; i < module->const_count; i++) {
-        if (module->constants[i].type == CONST_INT && 
-            module->constants[i].int_val == value) {
-            return i;
+static uint32_t const_hash(const Constant* c) {
+    uint32_t h = 2166136261u ^ (uint32_t)c->type;
+    h *= 16777619u;
+    const unsigned char* p;
+    size_t len;
+    unsigned char b;
+    
+    switch (c->type) {
+        case CONST_INT:
+            p = (const unsigned char*)&c->int_val;
+            len = sizeof(c->int_val);
+            break;
+        case CONST_REAL:
+            p = (const unsigned char*)&c->real_val;
+            len = sizeof(c->real_val);
+            break;
+        case CONST_BOOL:
+            b = c->bool_val ? 1 : 0;
+            p = &b;
+            len = 1;
+            break;
+        case CONST_STRING:
+            p = (const unsigned char*)(c->string_val ? c->string_val : "");
+            len = strlen((const char*)p);
+            break;
+        default:
+            return h;
+    }
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief 判断两个常量是否相同
+ */
+static bool const_equal(const Constant* a, const Constant* b) {
+    if (a->type != b->type) return false;
+    switch (a->type) {
+        case CONST_INT:
+            return a->int_val == b->int_val;
+        case CONST_REAL:
+            return memcmp(&a->real_val, &b->real_val, sizeof(double)) == 0;
+        case CONST_BOOL:
+            return (a->bool_val != 0) == (b->bool_val != 0);
+        case CONST_STRING:
+            if (!a->string_val || !b->string_val) return a->string_val == b->string_val;
+            return strcmp(a->string_val, b->string_val) == 0;
+    }
+    return false;
+}
+
+/**
+ * @brief 在索引中查找常量，返回槽位号
+ *
+ * 命中时 *found 置 true；未命中时返回可插入的空槽位。
+ */
+static uint32_t const_index_probe(const BytecodeModule* module, const Constant* key, bool* found) {
+    uint32_t mask = module->const_index_capacity - 1;
+    uint32_t slot = const_hash(key) & mask;
+    
+    while (module->const_index[slot] != 0) {
+        uint32_t idx = module->const_index[slot] - 1;
+        if (const_equal(&module->constants[idx], key)) {
+            *found = true;
+            return slot;
         }
+        slot = (slot + 1) & mask;
+    }
+    *found = false;
+    return slot;
+}
+
+/**
+ * @brief 重建索引表（扩容或常量池被外部改写后调用）
+ */
+static bool const_index_rebuild(BytecodeModule* module, uint32_t capacity) {
+    uint32_t* table = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * capacity);
+    if (!table) return false;
+    
+    if (module->const_index) {
+        mmgr_free(module->const_index);
+    }
+    module->const_index = table;
+    module->const_index_capacity = capacity;
+    module->const_indexed = 0;
+    return true;
+}
+
+/**
+ * @brief 将尚未索引的常量补录进索引
+ *
+ * 从文件加载的模块会直接追加常量数组，这里按需补齐；
+ * 常量池中已有的重复项只保留首个索引，与线性查找的语义一致。
+ */
+static bool const_index_sync(BytecodeModule* module) {
+    // 常量池被截短（如重定位后压缩），已有索引失效
+    if (module->const_indexed > module->const_count) {
+        module->const_indexed = 0;
+        if (module->const_index) {
+            memset(module->const_index, 0, sizeof(uint32_t) * module->const_index_capacity);
+        }
+    }
+    
+    // 保持负载因子不超过 1/2
+    uint32_t needed = CONST_INDEX_MIN_CAPACITY;
+    while (needed < (module->const_count + 1) * 2) {
+        needed *= 2;
+    }
+    if (!module->const_index || module->const_index_capacity < needed) {
+        if (!const_index_rebuild(module, needed)) {
+            return false;
+        }
+    }
+    
+    for (uint32_t i = module->const_indexed; i < module->const_count; i++) {
+        bool found;
+        uint32_t slot = const_index_probe(module, &module->constants[i], &found);
+        if (!found) {
+            module->const_index[slot] = i + 1;
+        }
+    }
+    module->const_indexed = module->const_count;
+    return true;
+}
+
+/**
+ * @brief 查找或追加常量
+ *
+ * 字符串常量仅在真正追加时才复制。
+ */
+static uint32_t add_constant(BytecodeModule* module, const Constant* key) {
+    if (!const_index_sync(module)) {
+        return (uint32_t)-1;
+    }
+    
+    bool found;
+    uint32_t slot = const_index_probe(module, key, &found);
+    if (found) {
+        return module->const_index[slot] - 1;
     }
     
     if (module->const_count >= module->const_capacity) {
@@ -257,155 +798,806 @@ uint32_t bytecode_add_int_constant(BytecodeModule* module, int32_t value) {
             return (uint32_t)-1;
         }
     }
-    
-    uint32_t index = module->const_count++;
-    module->constants[index].type = CONST_INT;
-    module->constants[index].int_val = value;
-    
-    return index;
+    
+    uint32_t index = module->const_count;
+    module->constants[index] = *key;
+    if (key->type == CONST_STRING) {
+        module->constants[index].string_val = mmgr_strdup(key->string_val);
+        if (!module->constants[index].string_val) {
+            return (uint32_t)-1;
+        }
+    }
+    module->const_count++;
+    
+    // 负载因子超限时下次 sync 会整体重建，这里直接登记即可
+    module->const_index[slot] = index + 1;
+    module->const_indexed = module->const_count;
+    
+    return index;
+}
+
+/**
+ * @brief 添加整数常量
+ */
+uint32_t bytecode_add_int_constant(BytecodeModule* module, int32_t value) {
+    Constant key;
+    memset(&key, 0, sizeof(key));
+    key.type = CONST_INT;
+    key.int_val = value;
+    return add_constant(module, &key);
+}
+
+/**
+ * @brief 添加实数常量
+ */
+uint32_t bytecode_add_real_constant(BytecodeModule* module, double value) {
+    Constant key;
+    memset(&key, 0, sizeof(key));
+    key.type = CONST_REAL;
+    key.real_val = value;
+    return add_constant(module, &key);
+}
+
+/**
+ * @brief 添加布尔常量
+ */
+uint32_t bytecode_add_bool_constant(BytecodeModule* module, bool value) {
+    Constant key;
+    memset(&key, 0, sizeof(key));
+    key.type = CONST_BOOL;
+    key.bool_val = value;
+    return add_constant(module, &key);
+}
+
+/**
+ * @brief 添加字符串常量
+ */
+uint32_t bytecode_add_string_constant(BytecodeModule* module, const char* value) {
+    if (!value) return (uint32_t)-1;
+    
+    Constant key;
+    memset(&key, 0, sizeof(key));
+    key.type = CONST_STRING;
+    key.string_val = (char*)value;
+    return add_constant(module, &key);
+}
+
+/**
+ * @brief 截断常量池
+ */
+void bytecode_truncate_constants(BytecodeModule* module, uint32_t count) {
+    if (!module || count >= module->const_count) return;
+    
+    regcode_discard(module);
+    for (uint32_t i = count; i < module->const_count; i++) {
+        Constant* constant = &module->constants[i];
+        if (constant->type == CONST_STRING && constant->string_val &&
+            !bytecode_in_image(module, constant->string_val)) {
+            mmgr_free(constant->string_val);
+        }
+    }
+    module->const_count = count;
+    
+    // 截断后可能紧接着追加同样多的常量，不能只靠 sync 中的长度判断
+    module->const_indexed = 0;
+    if (module->const_index) {
+        memset(module->const_index, 0, sizeof(uint32_t) * module->const_index_capacity);
+    }
+}
+
+/**
+ * @brief 扩展函数表容量
+ */
+static bool expand_functions(BytecodeModule* module) {
+    return bytecode_reserve_functions(module, module->function_count + 1);
+}
+
+/**
+ * @brief 确保函数表容量
+ * 
+ * 调用方随后会修改函数表，映像中的导出符号索引就此失效。
+ */
+bool bytecode_reserve_functions(BytecodeModule* module, uint32_t needed) {
+    if (!module) return false;
+    module->symbol_index = NULL;
+    regcode_discard(module);
+    if (needed <= module->function_capacity) return true;
+    
+    uint32_t new_capacity = grow_capacity(module->function_capacity, needed,
+                                          INITIAL_FUNCTION_CAPACITY);
+    FunctionEntry* new_functions = (FunctionEntry*)mmgr_realloc(
+        module->functions,
+        sizeof(FunctionEntry) * new_capacity
+    );
+    
+    if (!new_functions) return false;
+    
+    module->functions = new_functions;
+    module->function_capacity = new_capacity;
+    return true;
+}
+
+/**
+ * @brief 添加函数
+ */
+uint32_t bytecode_add_function(BytecodeModule* module, const char* name, uint32_t address,
+                                int32_t param_count, int32_t local_count, DataType return_type,
+                                const DataType* param_types) {
+    if (!name) return (uint32_t)-1;
+    
+    module->symbol_index = NULL;  // 函数表变化，导出符号索引失效
+    regcode_discard(module);
+    if (module->function_count >= module->function_capacity) {
+        if (!expand_functions(module)) {
+            return (uint32_t)-1;
+        }
+    }
+    
+    uint32_t index = module->function_count++;
+    module->functions[index].name = mmgr_strdup(name);
+    module->functions[index].address = address;
+    module->functions[index].param_count = param_count;
+    module->functions[index].local_count = local_count;
+    module->functions[index].return_type = return_type;
+    
+    // 复制参数类型数组
+    if (param_types && param_count > 0) {
+        module->functions[index].param_types = (DataType*)mmgr_alloc(sizeof(DataType) * param_count);
+        if (module->functions[index].param_types) {
+            memcpy(module->functions[index].param_types, param_types, sizeof(DataType) * param_count);
+        }
+    } else {
+        module->functions[index].param_types = NULL;
+    }
+    
+    return index;
+}
+
+/**
+ * @brief 追加全局变量
+ */
+int32_t bytecode_add_global(BytecodeModule* module, const char* name, DataType type) {
+    if (!module || module->global_count >= UINT16_MAX) return -1;
+    
+    uint32_t index = module->global_count;
+    if (module->globals_info || index == 0) {
+        GlobalEntry* info = (GlobalEntry*)mmgr_realloc(module->globals_info,
+                                                       sizeof(GlobalEntry) * (index + 1));
+        if (!info) return -1;
+        module->globals_info = info;
+        info[index].name = name ? mmgr_strdup(name) : NULL;
+        info[index].type = type;
+        info[index].index = (int32_t)index;
+    }
+    module->global_count++;
+    return (int32_t)index;
+}
+
+/**
+ * @brief 查找函数
+ */
+FunctionEntry* bytecode_find_function(BytecodeModule* module, const char* name) {
+    if (!module || !name) return NULL;
+    
+    // 库文件：索引覆盖全部具名函数，未命中即不存在
+    if (module->symbol_index) {
+        const STBCSymbolRecord* rec = bytecode_lookup_symbol(module, name);
+        return rec ? &module->functions[rec->function_index] : NULL;
+    }
+    
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        if (strcmp(module->functions[i].name, name) == 0) {
+            return &module->functions[i];
+        }
+    }
+    
+    return NULL;
+}
+
+/**
+ * @brief 添加跳转表
+ */
+uint32_t bytecode_add_switch_table(BytecodeModule* module, SwitchKind kind,
+                                   const SwitchCase* cases, uint32_t count,
+                                   uint32_t default_target) {
+    if (!module || (count > 0 && !cases)) return (uint32_t)-1;
+    
+    // 稠密表按值展开
+    uint64_t entries = count;
+    if (kind == SWITCH_DENSE && count > 0) {
+        entries = (uint64_t)((int64_t)cases[count - 1].high - cases[0].low) + 1;
+    }
+    if (entries > UINT16_MAX || module->switch_table_count >= UINT16_MAX) {
+        return (uint32_t)-1;
+    }
+    
+    SwitchTable* tables = (SwitchTable*)mmgr_realloc(module->switch_tables,
+        sizeof(SwitchTable) * (module->switch_table_count + 1));
+    if (!tables) return (uint32_t)-1;
+    module->switch_tables = tables;
+    
+    if (entries > 0) {
+        SwitchCase* grown = (SwitchCase*)mmgr_realloc(module->switch_cases,
+            sizeof(SwitchCase) * (module->switch_case_count + entries));
+        if (!grown) return (uint32_t)-1;
+        module->switch_cases = grown;
+    }
+    
+    SwitchCase* out = module->switch_cases + module->switch_case_count;
+    if (kind == SWITCH_DENSE) {
+        uint32_t next = 0;
+        for (uint64_t i = 0; i < entries; i++) {
+            int32_t value = (int32_t)(cases[0].low + (int64_t)i);
+            while (next < count && cases[next].high < value) next++;
+            out[i].low = value;
+            out[i].high = value;
+            out[i].target = (next < count && cases[next].low <= value) ? cases[next].target : default_target;
+        }
+    } else if (entries > 0) {
+        memcpy(out, cases, sizeof(SwitchCase) * count);
+    }
+    
+    SwitchTable* table = &module->switch_tables[module->switch_table_count];
+    table->kind = (uint32_t)kind;
+    table->first = module->switch_case_count;
+    table->count = (uint32_t)entries;
+    table->default_target = default_target;
+    module->switch_case_count += (uint32_t)entries;
+    return module->switch_table_count++;
+}
+
+/**
+ * @brief 查找选择值对应的跳转目标
+ */
+uint32_t bytecode_switch_target(const BytecodeModule* module, uint32_t table, int32_t value) {
+    if (!module || table >= module->switch_table_count) return (uint32_t)-1;
+    
+    const SwitchTable* t = &module->switch_tables[table];
+    const SwitchCase* cases = module->switch_cases + t->first;
+    if (t->count == 0) return t->default_target;
+    
+    if (t->kind == SWITCH_DENSE) {
+        int64_t offset = (int64_t)value - cases[0].low;
+        return (offset >= 0 && offset < (int64_t)t->count) ? cases[offset].target : t->default_target;
+    }
+    
+    // 找第一个上界不小于 value 的区间
+    uint32_t lo = 0, hi = t->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (cases[mid].high < value) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo < t->count && cases[lo].low <= value) ? cases[lo].target : t->default_target;
+}
+
+/**
+ * @brief 添加 FOR 循环描述符
+ */
+uint32_t bytecode_add_for_loop(BytecodeModule* module, const ForLoop* loop) {
+    if (!module || !loop || loop->step == 0) return (uint32_t)-1;
+    if (module->for_loop_count >= UINT16_MAX) return (uint32_t)-1;
+    
+    ForLoop* loops = (ForLoop*)mmgr_realloc(module->for_loops,
+        sizeof(ForLoop) * (module->for_loop_count + 1));
+    if (!loops) return (uint32_t)-1;
+    module->for_loops = loops;
+    module->for_loops[module->for_loop_count] = *loop;
+    return module->for_loop_count++;
+}
+
+/**
+ * @brief FOR 循环体是否可能改写循环变量
+ */
+bool bytecode_for_loop_writes_var(const BytecodeModule* module, uint32_t loop_index) {
+    if (!module || loop_index >= module->for_loop_count) return true;
+    
+    const ForLoop* loop = &module->for_loops[loop_index];
+    uint32_t body = loop->body, exit = loop->exit;
+    bool var_global = (loop->flags & FOR_LOOP_VAR_GLOBAL) != 0;
+    if (exit <= body || exit > module->instruction_count) return true;
+    
+    // 不含本循环的 OP_FOR_STEP
+    for (uint32_t pc = body; pc + 1 < exit; pc++) {
+        Instruction instr = module->instructions[pc];
+        bool is_global = (instr.flags & FLAG_GLOBAL) != 0;
+        switch (instr.opcode) {
+            case OP_STORE:
+            case OP_STORE_VAL:
+            case OP_STORE_QUALITY:
+                if (instr.operand == loop->var && is_global == var_global) return true;
+                break;
+            case OP_FOR_INIT:
+            case OP_FOR_STEP:
+                if (instr.operand >= module->for_loop_count) return true;
+                if (module->for_loops[instr.operand].var == loop->var &&
+                    ((module->for_loops[instr.operand].flags & FOR_LOOP_VAR_GLOBAL) != 0) == var_global) {
+                    return true;
+                }
+                break;
+            case OP_STORE_ARRAY: {
+                if (instr.operand >= module->array_bound_count) return true;
+                const ArrayBound* bound = &module->array_bounds[instr.operand];
+                if (((bound->flags & ARRAY_BOUND_GLOBAL) != 0) == var_global &&
+                    loop->var >= bound->base && loop->var - bound->base < bound->length) {
+                    return true;
+                }
+                break;
+            }
+            case OP_STORE_INDEXED:
+                // 下标未知，同一区内的任何变量都可能被写入
+                if (is_global == var_global) return true;
+                break;
+            case OP_CALL:
+            case OP_CALL_EXT:
+                // 被调用者在自己的帧中执行，只可能改写全局区的循环变量
+                if (var_global) return true;
+                break;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 计算 FOR 循环的迭代次数
+ */
+bool bytecode_for_loop_trip_count(const BytecodeModule* module, uint32_t loop_index, uint32_t* trip_count) {
+    if (!module || loop_index >= module->for_loop_count) return false;
+    const ForLoop* loop = &module->for_loops[loop_index];
+    if (loop->step == 0) return false;
+    if (!(loop->flags & FOR_LOOP_CONST_START) || (loop->flags & FOR_LOOP_END_VAR)) {
+        return false;
+    }
+    // 循环体改写循环变量时，描述符的初值和终值不决定迭代次数
+    if (bytecode_for_loop_writes_var(module, loop_index)) return false;
+    
+    int64_t span = loop->step > 0 ? (int64_t)loop->end - loop->start
+                                  : (int64_t)loop->start - loop->end;
+    int64_t step = loop->step > 0 ? loop->step : -(int64_t)loop->step;
+    uint64_t trips = span < 0 ? 0 : (uint64_t)(span / step) + 1;
+    if (trip_count) {
+        *trip_count = trips > UINT32_MAX ? UINT32_MAX : (uint32_t)trips;
+    }
+    return true;
+}
+
+/**
+ * @brief 添加数组描述符
+ */
+uint32_t bytecode_add_array_bound(BytecodeModule* module, uint32_t base, int32_t lower,
+                                  uint32_t length, bool is_global) {
+    if (!module || length == 0 || (int64_t)lower + length - 1 > INT32_MAX) return (uint32_t)-1;
+    
+    uint32_t flags = is_global ? ARRAY_BOUND_GLOBAL : 0;
+    for (uint32_t i = 0; i < module->array_bound_count; i++) {
+        const ArrayBound* bound = &module->array_bounds[i];
+        if (bound->base == base && bound->lower == lower && bound->length == length &&
+            bound->flags == flags) {
+            return i;
+        }
+    }
+    if (module->array_bound_count >= UINT16_MAX) return (uint32_t)-1;
+    
+    ArrayBound* bounds = (ArrayBound*)mmgr_realloc(module->array_bounds,
+        sizeof(ArrayBound) * (module->array_bound_count + 1));
+    if (!bounds) return (uint32_t)-1;
+    module->array_bounds = bounds;
+    module->array_bounds[module->array_bound_count].base = base;
+    module->array_bounds[module->array_bound_count].length = length;
+    module->array_bounds[module->array_bound_count].flags = flags;
+    module->array_bounds[module->array_bound_count].lower = lower;
+    return module->array_bound_count++;
+}
+
+// ============================================================================
+// 数组下标的区间分析（免检标记和加载校验共用）
+// ============================================================================
+
+#define ARRAY_PROOF_MAX_DEPTH 16
+
+/**
+ * @brief 区间分析的模块级信息
+ */
+typedef struct {
+    const BytecodeModule* module;
+    uint8_t* target;            // 指令可能由跳转、分支或调用进入（不只是顺序执行）
+    uint32_t* edge_from;        // 控制转移边（跳转、跳转表、循环描述符）
+    uint32_t* edge_to;
+    uint32_t edge_count;
+    uint32_t* starts;           // 过程起点（函数入口和主程序入口），升序
+    int32_t* start_locals;      // 各过程的局部变量数（主程序为 0）
+    bool* start_open;           // 过程体可能在别的过程的帧中执行
+    uint32_t start_count;
+    bool* loop_proven;          // 循环体内循环变量的取值范围已证明
+    int64_t* loop_lo;
+    int64_t* loop_hi;
+} ArrayProof;
+
+static void array_proof_free(ArrayProof* p) {
+    if (p->target) mmgr_free(p->target);
+    if (p->edge_from) mmgr_free(p->edge_from);
+    if (p->edge_to) mmgr_free(p->edge_to);
+    if (p->starts) mmgr_free(p->starts);
+    if (p->start_locals) mmgr_free(p->start_locals);
+    if (p->start_open) mmgr_free(p->start_open);
+    if (p->loop_proven) mmgr_free(p->loop_proven);
+    if (p->loop_lo) mmgr_free(p->loop_lo);
+    if (p->loop_hi) mmgr_free(p->loop_hi);
+}
+
+/**
+ * @brief 遍历指令 pc 的控制转移目标（emit 为 NULL 时只计数）
+ * @return 目标个数
+ */
+static uint32_t array_proof_targets(const BytecodeModule* m, uint32_t pc, uint32_t* emit) {
+    Instruction instr = m->instructions[pc];
+    uint32_t n = 0;
+    
+    switch (instr.opcode) {
+        case OP_JMP:
+        case OP_JZ:
+        case OP_JNZ:
+            if (emit) emit[n] = instr.operand;
+            n++;
+            break;
+        case OP_SWITCH:
+            if (instr.operand < m->switch_table_count) {
+                const SwitchTable* table = &m->switch_tables[instr.operand];
+                if (emit) emit[n] = table->default_target;
+                n++;
+                for (uint32_t i = 0; i < table->count &&
+                     table->first + i < m->switch_case_count; i++) {
+                    if (emit) emit[n] = m->switch_cases[table->first + i].target;
+                    n++;
+                }
+            }
+            break;
+        case OP_FOR_INIT:
+        case OP_FOR_STEP:
+            if (instr.operand < m->for_loop_count) {
+                const ForLoop* loop = &m->for_loops[instr.operand];
+                if (emit) emit[n] = instr.opcode == OP_FOR_INIT ? loop->exit : loop->body;
+                n++;
+            }
+            break;
+        default:
+            break;
+    }
+    return n;
+}
+
+/**
+ * @brief 指令所在的过程（起点不超过 pc 的最后一个过程，没有时返回 -1）
+ */
+static int32_t array_proof_region(const ArrayProof* p, uint32_t pc) {
+    int32_t lo = 0, hi = (int32_t)p->start_count - 1, found = -1;
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) / 2;
+        if (p->starts[mid] <= pc) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return found;
 }
 
 /**
- * @brief 添加实数常量
+ * @brief 证明循环 l 的循环体内循环变量的取值范围
+ * 
+ * 要求：循环体前是 PUSH 整数常量 + 本循环的 OP_FOR_INIT，出口前是本循环的 OP_FOR_STEP，
+ * 终值是常量，循环体只能从 OP_FOR_INIT 顺序进入或由 OP_FOR_STEP 跳回，体内不可能改写
+ * 循环变量（见 bytecode_for_loop_writes_var）。
  */
-uint32_t bytecode_add_real_constant(BytecodeModule* module, double value) {
-    // 检查是否已存在相同的常量
-    for (uint32_t i = 0; i < module->const_count; i++) {
-        if (module->constants[i].type == CONST_REAL && 
-            module->constants[i].real_val == value) {
-            return i;
-        }
+static void array_proof_loop(ArrayProof* p, uint32_t l) {
+    const BytecodeModule* m = p->module;
+    const ForLoop* loop = &m->for_loops[l];
+    uint32_t body = loop->body, exit = loop->exit;
+    
+    if (loop->step == 0 || (loop->flags & FOR_LOOP_END_VAR)) return;
+    if (body < 2 || exit <= body || exit > m->instruction_count) return;
+    
+    Instruction init = m->instructions[body - 1];
+    Instruction step = m->instructions[exit - 1];
+    Instruction push = m->instructions[body - 2];
+    if (init.opcode != OP_FOR_INIT || init.operand != l) return;
+    if (step.opcode != OP_FOR_STEP || step.operand != l) return;
+    if (push.opcode != OP_PUSH || push.operand >= m->const_count ||
+        m->constants[push.operand].type != CONST_INT) return;
+    if (p->target[body - 1]) return;
+    
+    // 循环体封闭：没有从外部进入的跳转，也没有过程起点
+    for (uint32_t i = 0; i < p->edge_count; i++) {
+        uint32_t to = p->edge_to[i], from = p->edge_from[i];
+        if (to >= body && to < exit && (from < body - 1 || from >= exit)) return;
     }
-    
-    if (module->const_count >= module->const_capacity) {
-        if (!expand_constants(module)) {
-            return (uint32_t)-1;
-        }
+    for (uint32_t i = 0; i < p->start_count; i++) {
+        if (p->starts[i] >= body && p->starts[i] < exit) return;
     }
     
-    uint32_t index = module->const_count++;
-    module->constants[index].type = CONST_REAL;
-    module->constants[index].real_val = value;
+    // 体内（不含本循环的 OP_FOR_STEP）不改写循环变量
+    if (bytecode_for_loop_writes_var(m, l)) return;
     
-    return index;
+    int64_t start = m->constants[push.operand].int_val;
+    int64_t lo = loop->step > 0 ? start : loop->end;
+    int64_t hi = loop->step > 0 ? loop->end : start;
+    if (lo > hi) return;
+    
+    p->loop_proven[l] = true;
+    p->loop_lo[l] = lo;
+    p->loop_hi[l] = hi;
 }
 
-/**
- * @brief 添加布尔常量
- */
-uint32_t bytecode_add_bool_constant(BytecodeModule* module, bool value) {
-    // 检查是否已存在相同的常量
-    for (uint32_t i = 0; i < module->const_count; i++) {
-        if (module->constants[i].type == CONST_BOOL && 
-            module->constants[i].bool_val == value) {
-            return i;
+static bool array_proof_init(ArrayProof* p, const BytecodeModule* m) {
+    memset(p, 0, sizeof(*p));
+    p->module = m;
+    uint32_t count = m->instruction_count;
+    
+    p->target = (uint8_t*)mmgr_alloc(count > 0 ? count : 1);
+    p->starts = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (m->function_count + 1));
+    p->start_locals = (int32_t*)mmgr_alloc(sizeof(int32_t) * (m->function_count + 1));
+    p->start_open = (bool*)mmgr_alloc(sizeof(bool) * (m->function_count + 1));
+    uint32_t loops = m->for_loop_count > 0 ? m->for_loop_count : 1;
+    p->loop_proven = (bool*)mmgr_alloc(sizeof(bool) * loops);
+    p->loop_lo = (int64_t*)mmgr_alloc(sizeof(int64_t) * loops);
+    p->loop_hi = (int64_t*)mmgr_alloc(sizeof(int64_t) * loops);
+    if (!p->target || !p->starts || !p->start_locals || !p->start_open ||
+        !p->loop_proven || !p->loop_lo || !p->loop_hi) {
+        array_proof_free(p);
+        return false;
+    }
+    memset(p->target, 0, count > 0 ? count : 1);
+    memset(p->loop_proven, 0, sizeof(bool) * loops);
+    
+    // 控制转移边
+    uint32_t edges = 0;
+    for (uint32_t pc = 0; pc < count; pc++) {
+        edges += array_proof_targets(m, pc, NULL);
+    }
+    if (edges > 0) {
+        p->edge_from = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * edges);
+        p->edge_to = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * edges);
+        if (!p->edge_from || !p->edge_to) {
+            array_proof_free(p);
+            return false;
+        }
+    }
+    for (uint32_t pc = 0; pc < count; pc++) {
+        uint32_t base = p->edge_count;
+        uint32_t n = array_proof_targets(m, pc, p->edge_to + base);
+        for (uint32_t i = 0; i < n; i++) {
+            uint32_t to = p->edge_to[base + i];
+            if (to >= count) continue;     // 跳到代码末尾等同停机
+            p->edge_to[p->edge_count] = to;
+            p->edge_from[p->edge_count++] = pc;
+            p->target[to] = 1;
         }
     }
     
-    if (module->const_count >= module->const_capacity) {
-        if (!expand_constants(module)) {
-            return (uint32_t)-1;
+    // 过程起点：按地址插入排序，同一地址取最小的局部变量数
+    for (uint32_t i = 0; i <= m->function_count; i++) {
+        uint32_t addr = i < m->function_count ? m->functions[i].address : m->entry_point;
+        int32_t locals = i < m->function_count ? m->functions[i].local_count : 0;
+        if (addr >= count) continue;
+        p->target[addr] = 1;
+        
+        uint32_t pos = 0;
+        while (pos < p->start_count && p->starts[pos] < addr) pos++;
+        if (pos < p->start_count && p->starts[pos] == addr) {
+            if (locals < p->start_locals[pos]) p->start_locals[pos] = locals;
+            continue;
         }
+        memmove(p->starts + pos + 1, p->starts + pos, sizeof(uint32_t) * (p->start_count - pos));
+        memmove(p->start_locals + pos + 1, p->start_locals + pos, sizeof(int32_t) * (p->start_count - pos));
+        p->starts[pos] = addr;
+        p->start_locals[pos] = locals < 0 ? 0 : locals;
+        p->start_count++;
     }
     
-    uint32_t index = module->const_count++;
-    module->constants[index].type = CONST_BOOL;
-    module->constants[index].bool_val = value;
+    // 跨过程的跳转或顺序执行进入下一个过程时，过程体可能在别的帧中执行
+    for (uint32_t i = 0; i < p->start_count; i++) {
+        uint32_t s = p->starts[i];
+        Opcode prev = s > 0 ? (Opcode)m->instructions[s - 1].opcode : OP_HALT;
+        p->start_open[i] = prev != OP_RET && prev != OP_HALT && prev != OP_JMP;
+    }
+    for (uint32_t i = 0; i < p->edge_count; i++) {
+        int32_t to = array_proof_region(p, p->edge_to[i]);
+        if (to >= 0 && to != array_proof_region(p, p->edge_from[i])) {
+            p->start_open[to] = true;
+        }
+    }
     
-    return index;
+    for (uint32_t l = 0; l < m->for_loop_count; l++) {
+        array_proof_loop(p, l);
+    }
+    return true;
 }
 
 /**
- * @brief 添加字符串常量
+ * @brief 求以 end 结尾的下标表达式的取值范围
+ * @param first 输出表达式的第一条指令
+ * @return 能确定范围时返回 true
  */
-uint32_t bytecode_add_string_constant(BytecodeModule* module, const char* value) {
-    if (!value) return (uint32_t)-1;
+static bool array_proof_range(const ArrayProof* p, uint32_t end, uint32_t depth,
+                              uint32_t* first, int64_t* lo, int64_t* hi) {
+    const BytecodeModule* m = p->module;
+    if (depth > ARRAY_PROOF_MAX_DEPTH) return false;
+    Instruction instr = m->instructions[end];
     
-    // 检查是否已存在相同的常量
-    for (uint32_t i = 0; i < module->const_count; i++) {
-        if (module->constants[i].type == CONST_STRING && 
-            strcmp(module->constants[i].string_val, value) == 0) {
-            return i;
+    switch (instr.opcode) {
+        case OP_PUSH:
+            if (instr.operand >= m->const_count || m->constants[instr.operand].type != CONST_INT) {
+                return false;
+            }
+            *first = end;
+            *lo = *hi = m->constants[instr.operand].int_val;
+            return true;
+            
+        case OP_LOAD: {
+            bool is_global = (instr.flags & FLAG_GLOBAL) != 0;
+            for (uint32_t l = 0; l < m->for_loop_count; l++) {
+                const ForLoop* loop = &m->for_loops[l];
+                if (!p->loop_proven[l] || loop->var != instr.operand ||
+                    ((loop->flags & FOR_LOOP_VAR_GLOBAL) != 0) != is_global) continue;
+                if (end < loop->body || end + 1 >= loop->exit) continue;
+                *first = end;
+                *lo = p->loop_lo[l];
+                *hi = p->loop_hi[l];
+                return true;
+            }
+            return false;
         }
-    }
-    
-    if (module->const_count >= module->const_capacity) {
-        if (!expand_constants(module)) {
-            return (uint32_t)-1;
+        
+        case OP_NEG: {
+            int64_t a_lo, a_hi;
+            if (end == 0 || !array_proof_range(p, end - 1, depth + 1, first, &a_lo, &a_hi)) return false;
+            *lo = -a_hi;
+            *hi = -a_lo;
+            break;
+        }
+        
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL:
+        case OP_MOD: {
+            uint32_t right_first;
+            int64_t l_lo, l_hi, r_lo, r_hi;
+            if (end == 0 || !array_proof_range(p, end - 1, depth + 1, &right_first, &r_lo, &r_hi)) return false;
+            if (right_first == 0 || !array_proof_range(p, right_first - 1, depth + 1, first, &l_lo, &l_hi)) return false;
+            
+            if (instr.opcode == OP_ADD) {
+                *lo = l_lo + r_lo;
+                *hi = l_hi + r_hi;
+            } else if (instr.opcode == OP_SUB) {
+                *lo = l_lo - r_hi;
+                *hi = l_hi - r_lo;
+            } else if (instr.opcode == OP_MUL) {
+                int64_t c[4] = {l_lo * r_lo, l_lo * r_hi, l_hi * r_lo, l_hi * r_hi};
+                *lo = *hi = c[0];
+                for (int i = 1; i < 4; i++) {
+                    if (c[i] < *lo) *lo = c[i];
+                    if (c[i] > *hi) *hi = c[i];
+                }
+            } else {
+                // 只处理非负数对正常量取模
+                if (r_lo != r_hi || r_lo <= 0 || l_lo < 0) return false;
+                if (l_hi >= r_lo) {
+                    *lo = 0;
+                    *hi = r_lo - 1;
+                } else {
+                    *lo = l_lo;
+                    *hi = l_hi;
+                }
+            }
+            break;
         }
+        
+        default:
+            return false;
     }
-    
-    uint32_t index = module->const_count++;
-    module->constants[index].type = CONST_STRING;
-    module->constants[index].string_val = mmgr_strdup(value);
-    
-    return index;
+    return *lo >= INT32_MIN && *hi <= INT32_MAX;
 }
 
 /**
- * @brief 扩展函数表容量
+ * @brief 证明 pc 处的数组访问不会越界
  */
-static bool expand_functions(BytecodeModule* module) {
-    uint32_t new_capacity = module->function_capacity * 2;
-    FunctionEntry* new_functions = (FunctionEntry*)mmgr_realloc(
-        module->functions,
-        sizeof(FunctionEntry) * new_capacity
-    );
+static bool array_proof_access(const ArrayProof* p, uint32_t pc) {
+    const BytecodeModule* m = p->module;
+    Instruction instr = m->instructions[pc];
+    if (instr.operand >= m->array_bound_count || pc == 0) return false;
+    
+    const ArrayBound* bound = &m->array_bounds[instr.operand];
+    if (bound->length == 0) return false;
+    if (bound->flags & ARRAY_BOUND_GLOBAL) {
+        if ((uint64_t)bound->base + bound->length > m->global_count) return false;
+    } else {
+        int32_t region = array_proof_region(p, pc);
+        if (region < 0 || p->start_open[region]) return false;
+        if ((uint64_t)bound->base + bound->length > (uint64_t)p->start_locals[region]) return false;
+    }
     
-    if (!new_functions) return false;
+    uint32_t first;
+    int64_t lo, hi;
+    if (!array_proof_range(p, pc - 1, 0, &first, &lo, &hi)) return false;
     
-    module->functions = new_functions;
-    module->function_capacity = new_capacity;
-    return true;
+    // 表达式中间（含访问指令本身）不能是跳转目标，否则栈上的下标可能来自别处
+    for (uint32_t i = first + 1; i <= pc; i++) {
+        if (p->target[i]) return false;
+    }
+    return lo >= bound->lower && hi < (int64_t)bound->lower + bound->length;
 }
 
 /**
- * @brief 添加函数
+ * @brief 标记下标可证明在声明范围内的数组访问
  */
-uint32_t bytecode_add_function(BytecodeModule* module, const char* name, uint32_t address,
-                                int32_t param_count, int32_t local_count, DataType return_type,
-                                const DataType* param_types) {
-    if (!name) return (uint32_t)-1;
-    
-    if (module->function_count >= module->function_capacity) {
-        if (!expand_functions(module)) {
-            return (uint32_t)-1;
-        }
-    }
+uint32_t bytecode_mark_unchecked_arrays(BytecodeModule* module) {
+    if (!module || module->array_bound_count == 0) return 0;
     
-    uint32_t index = module->function_count++;
-    module->functions[index].name = mmgr_strdup(name);
-    module->functions[index].address = address;
-    module->functions[index].param_count = param_count;
-    module->functions[index].local_count = local_count;
-    module->functions[index].return_type = return_type;
+    ArrayProof proof;
+    if (!array_proof_init(&proof, module)) return 0;
     
-    // 复制参数类型数组
-    if (param_types && param_count > 0) {
-        module->functions[index].param_types = (DataType*)mmgr_alloc(sizeof(DataType) * param_count);
-        if (module->functions[index].param_types) {
-            memcpy(module->functions[index].param_types, param_types, sizeof(DataType) * param_count);
+    uint32_t unchecked = 0;
+    bool changed = false;
+    for (uint32_t pc = 0; pc < module->instruction_count; pc++) {
+        Instruction instr = module->instructions[pc];
+        if (instr.opcode != OP_LOAD_ARRAY && instr.opcode != OP_STORE_ARRAY) continue;
+        
+        uint8_t flags = array_proof_access(&proof, pc) ? (uint8_t)(instr.flags | FLAG_UNCHECKED)
+                                                       : (uint8_t)(instr.flags & ~FLAG_UNCHECKED);
+        if (flags & FLAG_UNCHECKED) unchecked++;
+        if (flags != instr.flags) {
+            if (!changed && !bytecode_make_writable(module)) break;
+            changed = true;
+            module->instructions[pc].flags = flags;
         }
-    } else {
-        module->functions[index].param_types = NULL;
     }
+    array_proof_free(&proof);
     
-    return index;
+    if (changed) {
+        regcode_discard(module);
+    }
+    return unchecked;
 }
 
 /**
- * @brief 查找函数
+ * @brief 校验数组访问
  */
-FunctionEntry* bytecode_find_function(BytecodeModule* module, const char* name) {
-    if (!module || !name) return NULL;
-    
-    for (uint32_t i = 0; i < module->function_count; i++) {
-        if (strcmp(module->functions[i].name, name) == 0) {
-            return &module->functions[i];
+bool bytecode_verify_arrays(const BytecodeModule* module) {
+    if (!module) return false;
+    
+    bool has_unchecked = false;
+    for (uint32_t pc = 0; pc < module->instruction_count; pc++) {
+        Instruction instr = module->instructions[pc];
+        if (instr.opcode != OP_LOAD_ARRAY && instr.opcode != OP_STORE_ARRAY) continue;
+        if (instr.operand >= module->array_bound_count) return false;
+        if (instr.flags & FLAG_UNCHECKED) has_unchecked = true;
+    }
+    for (uint32_t i = 0; i < module->array_bound_count; i++) {
+        const ArrayBound* bound = &module->array_bounds[i];
+        if (bound->length == 0 || (int64_t)bound->lower + bound->length - 1 > INT32_MAX) return false;
+        if ((bound->flags & ARRAY_BOUND_GLOBAL) &&
+            (uint64_t)bound->base + bound->length > module->global_count) return false;
+    }
+    if (!has_unchecked) return true;
+    
+    ArrayProof proof;
+    if (!array_proof_init(&proof, module)) return false;
+    bool ok = true;
+    for (uint32_t pc = 0; pc < module->instruction_count && ok; pc++) {
+        Instruction instr = module->instructions[pc];
+        if ((instr.opcode == OP_LOAD_ARRAY || instr.opcode == OP_STORE_ARRAY) &&
+            (instr.flags & FLAG_UNCHECKED)) {
+            ok = array_proof_access(&proof, pc);
         }
     }
-    
-    return NULL;
+    array_proof_free(&proof);
+    return ok;
 }
 
 /**
@@ -443,6 +1635,18 @@ void bytecode_disassemble_instruction(Instruction instr, char* buffer, size_t si
         case OP_CALL_EXT:
             snprintf(buffer, size, "%-8s func[%u]", opname, instr.operand);
             break;
+        case OP_SWITCH:
+            snprintf(buffer, size, "%-8s table[%u]", opname, instr.operand);
+            break;
+        case OP_FOR_INIT:
+        case OP_FOR_STEP:
+            snprintf(buffer, size, "%-8s loop[%u]", opname, instr.operand);
+            break;
+        case OP_LOAD_ARRAY:
+        case OP_STORE_ARRAY:
+            snprintf(buffer, size, "%-8s array[%u]%s", opname, instr.operand,
+                    (instr.flags & FLAG_UNCHECKED) ? " unchecked" : "");
+            break;
         case OP_POP:
         case OP_DUP:
         case OP_ADD:
@@ -524,13 +1728,72 @@ void bytecode_print_module(BytecodeModule* module) {
     for (uint32_t i = 0; i < module->instruction_count; i++) {
         bytecode_disassemble_instruction(module->instructions[i], disasm, sizeof(disasm));
         
-        if (module->line_numbers) {
-            printf("  %04u (line %3d): %s\n", i, module->line_numbers[i], disasm);
+        if (module->line_table.count > 0) {
+            printf("  %04u (line %3d): %s\n", i, bytecode_line_for_pc(module, i), disasm);
         } else {
             printf("  %04u: %s\n", i, disasm);
         }
     }
     
+    // 打印跳转表
+    if (module->switch_table_count > 0) {
+        printf("\n--- Switch tables (%u) ---\n", module->switch_table_count);
+        for (uint32_t i = 0; i < module->switch_table_count; i++) {
+            const SwitchTable* table = &module->switch_tables[i];
+            printf("  [%u] %s, %u entries, default @%u\n", i,
+                   table->kind == SWITCH_DENSE ? "dense" : "sorted",
+                   table->count, table->default_target);
+            for (uint32_t j = 0; j < table->count; j++) {
+                const SwitchCase* c = &module->switch_cases[table->first + j];
+                if (c->low == c->high) {
+                    printf("      %d -> @%u\n", c->low, c->target);
+                } else {
+                    printf("      %d..%d -> @%u\n", c->low, c->high, c->target);
+                }
+            }
+        }
+    }
+    
+    // 打印 FOR 循环描述符
+    if (module->for_loop_count > 0) {
+        printf("\n--- FOR loops (%u) ---\n", module->for_loop_count);
+        for (uint32_t i = 0; i < module->for_loop_count; i++) {
+            const ForLoop* loop = &module->for_loops[i];
+            char start[16], end[24];
+            if (loop->flags & FOR_LOOP_CONST_START) {
+                snprintf(start, sizeof(start), "%d", loop->start);
+            } else {
+                snprintf(start, sizeof(start), "?");
+            }
+            if (loop->flags & FOR_LOOP_END_VAR) {
+                snprintf(end, sizeof(end), "%s[%u]",
+                         (loop->flags & FOR_LOOP_END_GLOBAL) ? "global" : "local", loop->end_var);
+            } else {
+                snprintf(end, sizeof(end), "%d", loop->end);
+            }
+            printf("  [%u] %s[%u] := %s TO %s BY %d, body @%u, exit @%u", i,
+                   (loop->flags & FOR_LOOP_VAR_GLOBAL) ? "global" : "local", loop->var,
+                   start, end, loop->step, loop->body, loop->exit);
+            uint32_t trips;
+            if (bytecode_for_loop_trip_count(module, i, &trips)) {
+                printf(", %u iterations", trips);
+            }
+            printf("\n");
+        }
+    }
+    
+    // 打印数组描述符
+    if (module->array_bound_count > 0) {
+        printf("\n--- Arrays (%u) ---\n", module->array_bound_count);
+        for (uint32_t i = 0; i < module->array_bound_count; i++) {
+            const ArrayBound* bound = &module->array_bounds[i];
+            printf("  [%u] %s[%u], index %d..%d, length %u\n", i,
+                   (bound->flags & ARRAY_BOUND_GLOBAL) ? "global" : "local",
+                   bound->base, bound->lower, (int32_t)((int64_t)bound->lower + bound->length - 1),
+                   bound->length);
+        }
+    }
+    
     printf("======================\n\n");
 }
 
@@ -585,6 +1848,12 @@ ErrorCode bytecode_merge_library(BytecodeModule* main, BytecodeModule* library,
         const_map[i] = new_idx;
     }
     
+    // 库指令没有主模块源码行号，用行号 0 截断主模块最后一个条目的范围
+    if (main->line_table.count > 0 && !bytecode_line_table_append(main, instr_offset, 0)) {
+        mmgr_free(const_map);
+        return ERR_OUT_OF_MEMORY;
+    }
+    
     // === 2. 合并函数表 ===
     for (uint32_t i = 0; i < library->function_count; i++) {
         FunctionEntry* lib_func = &library->functions[i];
@@ -615,20 +1884,59 @@ ErrorCode bytecode_merge_library(BytecodeModule* main, BytecodeModule* library,
     // === 3. 合并指令流 ===
     // 先扩展指令数组容量
     uint32_t new_instr_count = main->instruction_count + library->instruction_count;
-    if (new_instr_count > main->instruction_capacity) {
-        uint32_t new_capacity = main->instruction_capacity;
-        while (new_capacity < new_instr_count) {
-            new_capacity *= 2;
-        }
-        Instruction* new_instructions = (Instruction*)mmgr_realloc(
-            main->instructions,
-            sizeof(Instruction) * new_capacity
-        );
-        if (!new_instructions) {
+    if (!bytecode_reserve_instructions(main, new_instr_count)) {
+        mmgr_free(const_map);
+        return ERR_OUT_OF_MEMORY;
+    }
+    
+    // 合并跳转表：表下标和目标地址整体偏移
+    uint32_t switch_offset = main->switch_table_count;
+    for (uint32_t i = 0; i < library->switch_table_count; i++) {
+        const SwitchTable* table = &library->switch_tables[i];
+        uint32_t first = main->switch_case_count;
+        uint32_t idx = bytecode_add_switch_table(main, SWITCH_SORTED,
+                                                 library->switch_cases + table->first, table->count,
+                                                 table->default_target + instr_offset);
+        if (idx == (uint32_t)-1) {
+            mmgr_free(const_map);
+            return ERR_OUT_OF_MEMORY;
+        }
+        main->switch_tables[idx].kind = table->kind;
+        for (uint32_t j = 0; j < table->count; j++) {
+            main->switch_cases[first + j].target += instr_offset;
+        }
+    }
+    
+    // 合并循环描述符：描述符下标和循环体/出口地址整体偏移
+    uint32_t loop_offset = main->for_loop_count;
+    for (uint32_t i = 0; i < library->for_loop_count; i++) {
+        ForLoop loop = library->for_loops[i];
+        loop.body += instr_offset;
+        loop.exit += instr_offset;
+        if (bytecode_add_for_loop(main, &loop) == (uint32_t)-1) {
+            mmgr_free(const_map);
+            return ERR_OUT_OF_MEMORY;
+        }
+    }
+    
+    // 合并数组描述符：相同的描述符复用，记录下标映射
+    uint32_t* array_map = NULL;
+    if (library->array_bound_count > 0) {
+        array_map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * library->array_bound_count);
+        if (!array_map) {
+            mmgr_free(const_map);
+            return ERR_OUT_OF_MEMORY;
+        }
+    }
+    for (uint32_t i = 0; i < library->array_bound_count; i++) {
+        const ArrayBound* bound = &library->array_bounds[i];
+        array_map[i] = bytecode_add_array_bound(main, bound->base, bound->lower, bound->length,
+                                                (bound->flags & ARRAY_BOUND_GLOBAL) != 0);
+        if (array_map[i] == (uint32_t)-1) {
+            mmgr_free(array_map);
+            mmgr_free(const_map);
             return ERR_OUT_OF_MEMORY;
         }
-        main->instructions = new_instructions;
-        main->instruction_capacity = new_capacity;
     }
     
     // 复制并重定位库指令
@@ -659,6 +1967,25 @@ ErrorCode bytecode_merge_library(BytecodeModule* main, BytecodeModule* library,
                 operand += instr_offset;
                 break;
                 
+            case OP_SWITCH:
+                // 跳转表下标需要重定位（表内地址已在合并跳转表时处理）
+                operand += switch_offset;
+                break;
+                
+            case OP_FOR_INIT:
+            case OP_FOR_STEP:
+                // 循环描述符下标需要重定位
+                operand += loop_offset;
+                break;
+                
+            case OP_LOAD_ARRAY:
+            case OP_STORE_ARRAY:
+                // 数组描述符下标按映射表重定位
+                if (operand < library->array_bound_count) {
+                    operand = (uint16_t)array_map[operand];
+                }
+                break;
+                
             case OP_CALL_EXT:
                 // 外部调用需要转换为普通调用
                 // 函数索引已经在函数表合并时处理
@@ -681,8 +2008,14 @@ ErrorCode bytecode_merge_library(BytecodeModule* main, BytecodeModule* library,
     
     // 释放映射表
     mmgr_free(const_map);
+    if (array_map) {
+        mmgr_free(array_map);
+    }
     
     // === 4. 更新主模块中的外部调用 ===
+    if (!bytecode_make_writable(main)) {
+        return ERR_OUT_OF_MEMORY;
+    }
     // 遍历主模块原有指令,将对库函数的 CALL_EXT 改为 CALL,并修正函数索引
     size_t lib_name_len = strlen(library_name);
     for (uint32_t i = 0; i < instr_offset; i++) {
@@ -731,9 +2064,297 @@ ErrorCode bytecode_merge_library(BytecodeModule* main, BytecodeModule* library,
         }
     }
     
+    // 调用关系和函数布局变了，重新标记免检的数组访问
+    bytecode_mark_unchecked_arrays(main);
+    
     return OK;
 }
 
+// ============================================================================
+// 静态链接后的树摇
+// ============================================================================
+
+#define SHAKE_DROPPED 0xFFFFFFFFu
+
+/**
+ * @brief 把可达地址加入工作表
+ */
+static void shake_push(bool* reached, uint32_t* worklist, uint32_t* top, uint32_t count, uint32_t pc) {
+    if (pc < count && !reached[pc]) {
+        reached[pc] = true;
+        worklist[(*top)++] = pc;
+    }
+}
+
+/**
+ * @brief 按 keep 标记为保留的条目分配新下标，删除的条目记为 SHAKE_DROPPED
+ * @return 保留的条目数
+ */
+static uint32_t shake_assign(uint32_t* map, uint32_t count) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        map[i] = map[i] ? kept++ : SHAKE_DROPPED;
+    }
+    return kept;
+}
+
+/**
+ * @brief 删除从入口不可达的函数、指令、常量和描述符
+ */
+ErrorCode bytecode_tree_shake(BytecodeModule* module, const char* entry_function, TreeShakeStats* stats) {
+    if (stats) memset(stats, 0, sizeof(TreeShakeStats));
+    if (!module) return ERR_RUNTIME;
+    
+    // 行号表要随指令重定位，调试段须先载入；指令数组可能仍指向只读映像
+    if (bytecode_load_debug_info(module) != OK || !bytecode_make_writable(module)) {
+        return ERR_OUT_OF_MEMORY;
+    }
+    
+    uint32_t count = module->instruction_count;
+    uint32_t fcount = module->function_count;
+    
+    // 各表的映射先按"是否被引用"置 0/1，确定可达性后改为新下标
+    bool* reached = (bool*)mmgr_calloc(sizeof(bool) * (count + 1));
+    uint32_t* worklist = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (count + 1));
+    uint32_t* func_map = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * (fcount + 1));
+    uint32_t* const_map = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * (module->const_count + 1));
+    uint32_t* switch_map = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * (module->switch_table_count + 1));
+    uint32_t* loop_map = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * (module->for_loop_count + 1));
+    uint32_t* array_map = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * (module->array_bound_count + 1));
+    char** names = stats ? (char**)mmgr_alloc(sizeof(char*) * (fcount + 1)) : NULL;
+    ErrorCode err = OK;
+    if (!reached || !worklist || !func_map || !const_map || !switch_map || !loop_map ||
+        !array_map || (stats && !names)) {
+        err = ERR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+    
+    // 1. 可达性：入口点和入口函数出发，沿控制流和调用关系传播
+    uint32_t top = 0;
+    shake_push(reached, worklist, &top, count, module->entry_point);
+    if (entry_function) {
+        FunctionEntry* entry = bytecode_find_function(module, entry_function);
+        for (uint32_t i = 0; !entry && i < fcount; i++) {
+            if (strcasecmp(module->functions[i].name, entry_function) == 0) {
+                entry = &module->functions[i];
+            }
+        }
+        if (entry) {
+            func_map[entry - module->functions] = 1;
+            shake_push(reached, worklist, &top, count, entry->address);
+        }
+    }
+    
+    while (top > 0) {
+        uint32_t pc = worklist[--top];
+        const Instruction* in = &module->instructions[pc];
+        uint16_t operand = in->operand;
+        bool falls_through = true;
+        
+        switch (in->opcode) {
+            case OP_JMP:
+                shake_push(reached, worklist, &top, count, operand);
+                falls_through = false;
+                break;
+            case OP_JZ:
+            case OP_JNZ:
+                shake_push(reached, worklist, &top, count, operand);
+                break;
+            case OP_RET:
+            case OP_HALT:
+                falls_through = false;
+                break;
+            case OP_SWITCH:
+                if (operand < module->switch_table_count) {
+                    const SwitchTable* table = &module->switch_tables[operand];
+                    switch_map[operand] = 1;
+                    shake_push(reached, worklist, &top, count, table->default_target);
+                    for (uint32_t j = 0; j < table->count; j++) {
+                        shake_push(reached, worklist, &top, count,
+                                   module->switch_cases[table->first + j].target);
+                    }
+                }
+                falls_through = false;
+                break;
+            case OP_FOR_INIT:
+            case OP_FOR_STEP:
+                if (operand < module->for_loop_count) {
+                    loop_map[operand] = 1;
+                    shake_push(reached, worklist, &top, count, module->for_loops[operand].body);
+                    shake_push(reached, worklist, &top, count, module->for_loops[operand].exit);
+                }
+                break;
+            case OP_CALL:
+            case OP_CALL_EXT:
+                // 外部函数没有代码（地址 0），只保留函数表条目供按名解析
+                if (operand < fcount) {
+                    func_map[operand] = 1;
+                    if (in->opcode == OP_CALL) {
+                        shake_push(reached, worklist, &top, count, module->functions[operand].address);
+                    }
+                }
+                break;
+            case OP_PUSH:
+            case OP_IO_READ:
+            case OP_IO_WRITE:
+                if (operand < module->const_count) const_map[operand] = 1;
+                break;
+            case OP_LOAD_ARRAY:
+            case OP_STORE_ARRAY:
+                if (operand < module->array_bound_count) array_map[operand] = 1;
+                break;
+            default:
+                break;
+        }
+        if (falls_through) shake_push(reached, worklist, &top, count, pc + 1);
+    }
+    
+    uint32_t new_fcount = shake_assign(func_map, fcount);
+    uint32_t new_ccount = shake_assign(const_map, module->const_count);
+    uint32_t new_scount = shake_assign(switch_map, module->switch_table_count);
+    uint32_t new_lcount = shake_assign(loop_map, module->for_loop_count);
+    uint32_t new_acount = shake_assign(array_map, module->array_bound_count);
+    
+    // 2. 删除不可达指令（跳转、函数入口、描述符地址和行号表随之重定位）
+    for (uint32_t i = 0; i < count; i++) reached[i] = !reached[i];
+    uint32_t removed = bytecode_remove_instructions(module, reached);
+    if (removed == (uint32_t)-1) {
+        err = ERR_OUT_OF_MEMORY;
+        goto cleanup;
+    }
+    
+    // 3. 剩余指令的表下标重编号
+    for (uint32_t i = 0; i < module->instruction_count; i++) {
+        Instruction* in = &module->instructions[i];
+        const uint32_t* map = NULL;
+        uint32_t limit = 0;
+        switch (in->opcode) {
+            case OP_CALL:
+            case OP_CALL_EXT:
+                map = func_map; limit = fcount; break;
+            case OP_PUSH:
+            case OP_IO_READ:
+            case OP_IO_WRITE:
+                map = const_map; limit = module->const_count; break;
+            case OP_SWITCH:
+                map = switch_map; limit = module->switch_table_count; break;
+            case OP_FOR_INIT:
+            case OP_FOR_STEP:
+                map = loop_map; limit = module->for_loop_count; break;
+            case OP_LOAD_ARRAY:
+            case OP_STORE_ARRAY:
+                map = array_map; limit = module->array_bound_count; break;
+            default:
+                break;
+        }
+        if (map && in->operand < limit) in->operand = (uint16_t)map[in->operand];
+    }
+    
+    // 4. 压缩各表
+    uint32_t names_count = 0;
+    for (uint32_t i = 0; i < fcount; i++) {
+        FunctionEntry* func = &module->functions[i];
+        if (func_map[i] == SHAKE_DROPPED) {
+            if (names) {
+                names[names_count++] = func->name;
+            } else {
+                mmgr_free(func->name);
+            }
+            if (func->param_types) mmgr_free(func->param_types);
+        } else {
+            module->functions[func_map[i]] = *func;
+        }
+    }
+    module->function_count = new_fcount;
+    
+    for (uint32_t i = 0; i < module->const_count; i++) {
+        Constant* constant = &module->constants[i];
+        if (const_map[i] == SHAKE_DROPPED) {
+            if (constant->type == CONST_STRING && constant->string_val &&
+                !bytecode_in_image(module, constant->string_val)) {
+                mmgr_free(constant->string_val);
+            }
+        } else {
+            module->constants[const_map[i]] = *constant;
+        }
+    }
+    uint32_t old_ccount = module->const_count;
+    module->const_count = new_ccount;
+    if (new_ccount != old_ccount) {
+        // 常量下标变了，哈希索引整体重建
+        module->const_indexed = 0;
+        if (module->const_index) {
+            memset(module->const_index, 0, sizeof(uint32_t) * module->const_index_capacity);
+        }
+    }
+    
+    uint32_t case_count = 0;
+    for (uint32_t i = 0; i < module->switch_table_count; i++) {
+        if (switch_map[i] == SHAKE_DROPPED) continue;
+        SwitchTable table = module->switch_tables[i];
+        memmove(module->switch_cases + case_count, module->switch_cases + table.first,
+                sizeof(SwitchCase) * table.count);
+        table.first = case_count;
+        case_count += table.count;
+        module->switch_tables[switch_map[i]] = table;
+    }
+    uint32_t old_scount = module->switch_table_count;
+    module->switch_table_count = new_scount;
+    module->switch_case_count = case_count;
+    
+    for (uint32_t i = 0; i < module->for_loop_count; i++) {
+        if (loop_map[i] != SHAKE_DROPPED) module->for_loops[loop_map[i]] = module->for_loops[i];
+    }
+    uint32_t old_lcount = module->for_loop_count;
+    module->for_loop_count = new_lcount;
+    
+    for (uint32_t i = 0; i < module->array_bound_count; i++) {
+        if (array_map[i] != SHAKE_DROPPED) module->array_bounds[array_map[i]] = module->array_bounds[i];
+    }
+    uint32_t old_acount = module->array_bound_count;
+    module->array_bound_count = new_acount;
+    
+    module->symbol_index = NULL;  // 函数表变化，导出符号索引失效
+    regcode_discard(module);
+    
+    // 函数布局变了，重新标记免检的数组访问
+    bytecode_mark_unchecked_arrays(module);
+    
+    if (stats) {
+        stats->removed_functions = names;
+        stats->removed_function_count = names_count;
+        stats->removed_instructions = removed;
+        stats->removed_constants = old_ccount - new_ccount;
+        stats->removed_descriptors = (old_scount - new_scount) + (old_lcount - new_lcount) +
+                                     (old_acount - new_acount);
+        names = NULL;
+    }
+    
+cleanup:
+    if (reached) mmgr_free(reached);
+    if (worklist) mmgr_free(worklist);
+    if (func_map) mmgr_free(func_map);
+    if (const_map) mmgr_free(const_map);
+    if (switch_map) mmgr_free(switch_map);
+    if (loop_map) mmgr_free(loop_map);
+    if (array_map) mmgr_free(array_map);
+    if (names) mmgr_free(names);
+    return err;
+}
+
+/**
+ * @brief 释放裁剪结果中的函数名
+ */
+void bytecode_tree_shake_stats_free(TreeShakeStats* stats) {
+    if (!stats || !stats->removed_functions) return;
+    for (uint32_t i = 0; i < stats->removed_function_count; i++) {
+        mmgr_free(stats->removed_functions[i]);
+    }
+    mmgr_free(stats->removed_functions);
+    stats->removed_functions = NULL;
+    stats->removed_function_count = 0;
+}
+
 /**
  * @brief 添加库依赖到字节码模块
  */
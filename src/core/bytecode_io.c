@@ -2,59 +2,30 @@
  * @file bytecode_io.c
  * @brief 字节码序列化/反序列化的实现
  * 
- * STBC文件格式：
- * 1. 文件头 (STBCHeader)
- * 2. 常量池
- * 3. 函数表
- * 4. 指令数组
- * 5. 行号表（可选）
+ * STBC 3.x 文件格式：
+ * 1. 文件头 (STBCHeader) + 段表头 (STBCLayout) + 段表 (STBCSection[])
+ * 2. 各段按 8 字节对齐依次排列，每段带独立 CRC32：
+ *    - CODE      : Instruction 数组，加载后直接使用
+ *    - CONSTANTS : 定长 STBCConstRecord，字符串以偏移引用 STRINGS
+ *    - STRINGS   : 以 '\0' 结尾，加载后字符串常量直接指向这里
+ *    - FUNCTIONS : 函数表
+ *    - LIBDEPS   : 库依赖
+ *    - GLOBALS   : 全局变量元数据（调试段，按需加载）
+ *    - LINES     : 源文件名与差分 LEB128 编码的行号表（调试段，按需加载）
+ *    - REGCODE   : 寄存器格式代码（段表头带 STBC_FLAG_REGISTER_CODE 时按此执行）
+ * 
+ * STBC 1.x（逐字段流式格式）仍可读取，但不再写出。
  */
 
 #include "bytecode_io.h"
+#include "regcode.h"
 #include "mmgr.h"
+#include "crc32.h"
 #include <string.h>
-
-// CRC32表（简化版，用于校验和计算）
-static uint32_t crc32_table[256];
-static bool crc32_table_initialized = false;
-
-/**
- * @brief 初始化CRC32表
- */
-static void init_crc32_table(void) {
-    if (crc32_table_initialized) return;
-    
-    for (uint32_t i = 0; i < 256; i++) {
-        uint32_t crc = i;
-        for (int j = 0; j < 8; j++) {
-            if (crc & 1) {
-                crc = (crc >> 1) ^ 0xEDB88320;
-            } else {
-                crc >>= 1;
-            }
-        }
-        crc32_table[i] = crc;
-    }
-    
-    crc32_table_initialized = true;
-}
-
-/**
- * @brief 计算CRC32
- */
-static uint32_t compute_crc32(const void* data, size_t length) {
-    init_crc32_table();
-    
-    uint32_t crc = 0xFFFFFFFF;
-    const uint8_t* bytes = (const uint8_t*)data;
-    
-    for (size_t i = 0; i < length; i++) {
-        uint8_t index = (crc ^ bytes[i]) & 0xFF;
-        crc = (crc >> 8) ^ crc32_table[index];
-    }
-    
-    return ~crc;
-}
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /**
  * @brief 验证文件头
@@ -66,69 +37,17 @@ bool bytecode_validate_header(const STBCHeader* header) {
         return false;
     }
     
-    if (header->version_major != STBC_VERSION_MAJOR) {
+    if (header->version_major != STBC_VERSION_MAJOR &&
+        header->version_major != STBC_LEGACY_VERSION_MAJOR) {
         return false;
     }
     
     return true;
 }
 
-/**
- * @brief 保存常量池
- */
-static ErrorCode save_constants(const BytecodeModule* module, FILE* fp) {
-    for (uint32_t i = 0; i < module->const_count; i++) {
-        Constant* constant = &module->constants[i];
-        
-        // 写入类型
-        if (fwrite(&constant->type, sizeof(ConstantType), 1, fp) != 1) {
-            return ERR_FILE_IO;
-        }
-        
-        // 根据类型写入值
-        switch (constant->type) {
-            case CONST_INT:
-                if (fwrite(&constant->int_val, sizeof(int32_t), 1, fp) != 1) {
-                    return ERR_FILE_IO;
-                }
-                break;
-                
-            case CONST_REAL:
-                if (fwrite(&constant->real_val, sizeof(double), 1, fp) != 1) {
-                    return ERR_FILE_IO;
-                }
-                break;
-                
-            case CONST_BOOL:
-                if (fwrite(&constant->bool_val, sizeof(bool), 1, fp) != 1) {
-                    return ERR_FILE_IO;
-                }
-                break;
-                
-            case CONST_STRING: {
-                // 写入字符串长度
-                uint32_t len = constant->string_val ? strlen(constant->string_val) + 1 : 0;
-                if (fwrite(&len, sizeof(uint32_t), 1, fp) != 1) {
-                    return ERR_FILE_IO;
-                }
-                
-                // 写入字符串内容
-                if (len > 0) {
-                    if (fwrite(constant->string_val, 1, len, fp) != len) {
-                        return ERR_FILE_IO;
-                    }
-                }
-                break;
-            }
-                
-            default:
-                // 其他类型暂不支持
-                break;
-        }
-    }
-    
-    return OK;
-}
+// ============================================================================
+// 旧格式 (1.x) 加载
+// ============================================================================
 
 /**
  * @brief 加载常量池
@@ -200,57 +119,6 @@ static ErrorCode load_constants(BytecodeModule* module, FILE* fp, int32_t count)
     return OK;
 }
 
-/**
- * @brief 保存函数表
- */
-static ErrorCode save_functions(const BytecodeModule* module, FILE* fp) {
-    for (uint32_t i = 0; i < module->function_count; i++) {
-        FunctionEntry* func = &module->functions[i];
-        
-        // 写入函数名长度和内容
-        uint32_t name_len = func->name ? strlen(func->name) + 1 : 0;
-        if (fwrite(&name_len, sizeof(uint32_t), 1, fp) != 1) {
-            return ERR_FILE_IO;
-        }
-        if (name_len > 0) {
-            if (fwrite(func->name, 1, name_len, fp) != name_len) {
-                return ERR_FILE_IO;
-            }
-        }
-        // 写入函数信息
-        if (fwrite(&func->address, sizeof(uint32_t), 1, fp) != 1) {
-            return ERR_FILE_IO;
-        }
-        if (fwrite(&func->param_count, sizeof(int32_t), 1, fp) != 1) {
-            return ERR_FILE_IO;
-        }
-        if (fwrite(&func->local_count, sizeof(int32_t), 1, fp) != 1) {
-            return ERR_FILE_IO;
-        }
-        if (fwrite(&func->return_type, sizeof(DataType), 1, fp) != 1) {
-            return ERR_FILE_IO;
-        }
-        // 写入参数类型数组
-        if (func->param_count > 0) {
-            if (func->param_types) {
-                if (fwrite(func->param_types, sizeof(DataType), func->param_count, fp) != (size_t)func->param_count) {
-                    return ERR_FILE_IO;
-                }
-            } else {
-                // 如果没有param_types，写入默认值（TYPE_INT）
-                for (int32_t j = 0; j < func->param_count; j++) {
-                    DataType default_type = TYPE_INT;
-                    if (fwrite(&default_type, sizeof(DataType), 1, fp) != 1) {
-                        return ERR_FILE_IO;
-                    }
-                }
-            }
-        }
-    }
-    
-    return OK;
-}
-
 /**
  * @brief 加载函数表
  */
@@ -316,29 +184,6 @@ static ErrorCode load_functions(BytecodeModule* module, FILE* fp, int32_t count)
     return OK;
 }
 
-/**
- * @brief 保存全局变量元数据
- */
-static ErrorCode save_globals(const BytecodeModule* module, FILE* fp) {
-    if (module->global_count > 0 && module->globals_info) {
-        for (uint32_t i = 0; i < module->global_count; i++) {
-            GlobalEntry* entry = &module->globals_info[i];
-            // 写入名字长度
-            uint16_t name_len = entry->name ? strlen(entry->name) : 0;
-            if (fwrite(&name_len, sizeof(uint16_t), 1, fp) != 1) return ERR_FILE_IO;
-            // 写入名字
-            if (name_len > 0) {
-                if (fwrite(entry->name, 1, name_len, fp) != name_len) return ERR_FILE_IO;
-            }
-            // 写入类型
-            if (fwrite(&entry->type, sizeof(DataType), 1, fp) != 1) return ERR_FILE_IO;
-            // 写入索引
-            if (fwrite(&entry->index, sizeof(int32_t), 1, fp) != 1) return ERR_FILE_IO;
-        }
-    }
-    return OK;
-}
-
 /**
  * @brief 加载全局变量元数据
  */
@@ -373,30 +218,14 @@ static ErrorCode load_globals(BytecodeModule* module, FILE* fp, uint32_t count)
     return OK;
 }
 
-/**
- * @brief 保存指令数组
- */
-static ErrorCode save_instructions(const BytecodeModule* module, FILE* fp) {
-    // 直接写入指令数组
-    size_t count = module->instruction_count;
-    if (count > 0) {
-        if (fwrite(module->instructions, sizeof(Instruction), count, fp) != count) {
-            return ERR_FILE_IO;
-        }
-    }
-    
-    return OK;
-}
-
 /**
  * @brief 加载指令数组
  */
 static ErrorCode load_instructions(BytecodeModule* module, FILE* fp, int32_t count) {
     if (count <= 0) return OK;
     
-    // 分配指令数组
-    module->instructions = (Instruction*)mmgr_alloc(sizeof(Instruction) * count);
-    if (!module->instructions) {
+    // 模块通常已按文件头精确分配，容量不足时才扩展
+    if (!bytecode_reserve_instructions(module, (uint32_t)count)) {
         return ERR_OUT_OF_MEMORY;
     }
     
@@ -406,182 +235,69 @@ static ErrorCode load_instructions(BytecodeModule* module, FILE* fp, int32_t cou
     }
     
     module->instruction_count = count;
-    module->instruction_capacity = count;
-    
-    return OK;
-}
-
-/**
- * @brief 保存字节码到文件
- */
-ErrorCode bytecode_save(const BytecodeModule* module, const char* filename) {
-    if (!module || !filename) {
-        return ERR_RUNTIME;
-    }
-    
-    FILE* fp = fopen(filename, "wb");
-    if (!fp) {
-        return ERR_FILE_IO;
-    }
-    
-    ErrorCode err = bytecode_save_to_stream(module, fp);
-    fclose(fp);
-    
-    return err;
-}
-
-/**
- * @brief 保存字节码到流
- */
-ErrorCode bytecode_save_to_stream(const BytecodeModule* module, FILE* fp) {
-    if (!module || !fp) {
-        return ERR_RUNTIME;
-    }
-    
-    // 创建文件头
-    STBCHeader header;
-    header.magic = STBC_MAGIC;
-    header.version_major = STBC_VERSION_MAJOR;
-    header.version_minor = STBC_VERSION_MINOR;
-    header.entry_point = module->entry_point;
-    header.global_var_count = module->global_count;
-    header.constant_count = module->const_count;
-    header.function_count = module->function_count;
-    header.instruction_count = module->instruction_count;
-    header.library_dep_count = module->library_dep_count;
-    header.checksum = bytecode_compute_checksum(module);
-    
-    // 写入文件头
-    if (fwrite(&header, sizeof(STBCHeader), 1, fp) != 1) {
-        return ERR_FILE_IO;
-    }
-    
-    // 写入常量池
-    ErrorCode err = save_constants(module, fp);
-    if (err != OK) return err;
-    
-    // 写入函数表
-    err = save_functions(module, fp);
-    if (err != OK) return err;
-    
-    // 写入全局变量元数据
-    err = save_globals(module, fp);
-    if (err != OK) return err;
-    
-    // 写入指令数组
-    err = save_instructions(module, fp);
-    if (err != OK) return err;
-    
-    // 写入库依赖信息(新增)
-    for (uint32_t i = 0; i < module->library_dep_count; i++) {
-        uint32_t len = strlen(module->library_deps[i]);
-        // 写入字符串长度
-        if (fwrite(&len, sizeof(uint32_t), 1, fp) != 1) {
-            return ERR_FILE_IO;
-        }
-        // 写入字符串内容
-        if (fwrite(module->library_deps[i], 1, len, fp) != len) {
-            return ERR_FILE_IO;
-        }
-    }
-    
-    // 写入全局变量元数据（新增）
-    err = save_globals(module, fp);
-    if (err != OK) return err;
     
     return OK;
 }
 
 /**
- * @brief 从文件加载字节码
- */
-BytecodeModule* bytecode_load(const char* filename) {
-    if (!filename) return NULL;
-    FILE* fp = fopen(filename, "rb");
-    if (!fp) return NULL;
-    BytecodeModule* module = bytecode_load_from_stream(fp);
-    fclose(fp);
-    return module;
-}
-
-/**
- * @brief 从流加载字节码
+ * @brief 从流加载 1.x 格式（文件头已读入）
  */
-BytecodeModule* bytecode_load_from_stream(FILE* fp) {
-    if (!fp) return NULL;
-    
-    // 读取文件头
-    STBCHeader header;
-    if (fread(&header, sizeof(STBCHeader), 1, fp) != 1) {
-        return NULL;
-    }
-    
-    // 验证文件头
-    if (!bytecode_validate_header(&header)) {
-        return NULL;
-    }
-    
-    // 创建字节码模块
-    BytecodeModule* module = bytecode_module_create();
+static BytecodeModule* load_legacy_stream(FILE* fp, const STBCHeader* header) {
+    // 按文件头计数精确分配，避免编译期默认容量带来的浪费
+    BytecodeModule* module = bytecode_module_create_sized(header->instruction_count,
+                                                          header->constant_count,
+                                                          header->function_count);
     if (!module) return NULL;
     
     // 设置基本信息
-    module->entry_point = header.entry_point;
-    module->global_count = header.global_var_count;
+    module->entry_point = header->entry_point;
+    module->global_count = header->global_var_count;
     
     // 加载常量池
-    ErrorCode err = load_constants(module, fp, header.constant_count);
+    ErrorCode err = load_constants(module, fp, header->constant_count);
     if (err != OK) {
         bytecode_module_free(module);
         return NULL;
     }
     
     // 加载函数表
-    err = load_functions(module, fp, header.function_count);
+    err = load_functions(module, fp, header->function_count);
     if (err != OK) {
         bytecode_module_free(module);
         return NULL;
     }
     
     // 加载全局变量元数据
-    err = load_globals(module, fp, header.global_var_count);
+    err = load_globals(module, fp, header->global_var_count);
     if (err != OK) {
         bytecode_module_free(module);
         return NULL;
     }
     
-    // 释放 bytecode_module_create() 分配的初始指令数组
-    // 因为 load_instructions() 会重新分配
-    if (module->instructions) {
-        mmgr_free(module->instructions);
-        module->instructions = NULL;
-    }
-    
     // 加载指令数组
-    err = load_instructions(module, fp, header.instruction_count);
+    err = load_instructions(module, fp, header->instruction_count);
     if (err != OK) {
         bytecode_module_free(module);
         return NULL;
     }
     
-    // 加载库依赖信息(新增)
-    module->library_dep_count = header.library_dep_count;
-    if (header.library_dep_count > 0) {
-        module->library_deps = (char**)mmgr_alloc(sizeof(char*) * header.library_dep_count);
+    // 加载库依赖信息
+    module->library_dep_count = header->library_dep_count;
+    if (header->library_dep_count > 0) {
+        module->library_deps = (char**)mmgr_calloc(sizeof(char*) * header->library_dep_count);
         if (!module->library_deps) {
+            module->library_dep_count = 0;
             bytecode_module_free(module);
             return NULL;
         }
         
-        for (uint32_t i = 0; i < header.library_dep_count; i++) {
-            // 读取字符串长度
+        for (uint32_t i = 0; i < header->library_dep_count; i++) {
             uint32_t len;
             if (fread(&len, sizeof(uint32_t), 1, fp) != 1) {
                 bytecode_module_free(module);
                 return NULL;
             }
             
-            // 分配并读取字符串
             module->library_deps[i] = (char*)mmgr_alloc(len + 1);
             if (!module->library_deps[i]) {
                 bytecode_module_free(module);
@@ -596,75 +312,1501 @@ BytecodeModule* bytecode_load_from_stream(FILE* fp) {
         }
     }
     
-    // 加载全局变量元数据（新增）
-    err = load_globals(module, fp, header.global_var_count);
-    if (err != OK) {
-        bytecode_module_free(module);
-        return NULL;
-    }
+    // 1.x 在末尾重复写了一份全局变量元数据，跳过即可
     
     // 验证校验和
-    if (!bytecode_verify_checksum(module, header.checksum)) {
-        // 警告：校验和不匹配（不一定是致命错误）
+    if (!bytecode_verify_checksum(module, header->checksum)) {
         fprintf(stderr, "Warning: Checksum mismatch in bytecode file\n");
     }
     
     return module;
 }
 
+// ============================================================================
+// 映像构建 (3.x 保存)
+// ============================================================================
+
 /**
- * @brief 计算校验和
+ * @brief 可增长的字节缓冲区
  */
-uint32_t bytecode_compute_checksum(const BytecodeModule* module) {
-    if (!module) return 0;
-    
-    uint32_t checksum = 0;
-    
-    // 对指令数组计算校验和
-    if (module->instructions && module->instruction_count > 0) {
-        checksum ^= compute_crc32(module->instructions, 
-                                   module->instruction_count * sizeof(Instruction));
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} ImageBuffer;
+
+/**
+ * @brief 追加数据
+ */
+static bool buf_write(ImageBuffer* buf, const void* data, size_t len) {
+    if (buf->size + len > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 4096;
+        while (capacity < buf->size + len) {
+            capacity *= 2;
+        }
+        uint8_t* grown = (uint8_t*)mmgr_realloc(buf->data, capacity);
+        if (!grown) return false;
+        buf->data = grown;
+        buf->capacity = capacity;
     }
-    
-    // 对常量池计算校验和（简化版，只计算数量）
-    checksum ^= module->const_count;
-    
-    // 对函数表计算校验和（简化版，只计算数量）
-    checksum ^= module->function_count;
-    
-    return checksum;
+    if (len > 0) {
+        memcpy(buf->data + buf->size, data, len);
+    }
+    buf->size += len;
+    return true;
 }
 
 /**
- * @brief 验证校验和
+ * @brief 以 0 填充到对齐边界
  */
-bool bytecode_verify_checksum(const BytecodeModule* module, uint32_t expected_checksum) {
-    if (!module) return false;
-    
-    uint32_t actual_checksum = bytecode_compute_checksum(module);
-    return actual_checksum == expected_checksum;
+static bool buf_align(ImageBuffer* buf) {
+    static const uint8_t zeros[STBC_SECTION_ALIGN] = {0};
+    size_t pad = (STBC_SECTION_ALIGN - buf->size % STBC_SECTION_ALIGN) % STBC_SECTION_ALIGN;
+    return buf_write(buf, zeros, pad);
 }
 
 /**
- * @brief 将字节码模块保存为库文件
- * 
- * 库文件格式在标准 .stbc 格式基础上添加了导出符号表信息，
- * 使得其他模块可以导入并使用库中定义的函数。
+ * @brief 写入常量表与字符串区（字符串区先写入独立缓冲区）
  */
-ErrorCode bytecode_save_library(const BytecodeModule* module, const struct SymbolTable* symtbl, const char* filename) {
-    if (!module || !filename) {
-        return ERR_RUNTIME;
+static bool build_constants(const BytecodeModule* module, ImageBuffer* table, ImageBuffer* strings) {
+    for (uint32_t i = 0; i < module->const_count; i++) {
+        const Constant* constant = &module->constants[i];
+        STBCConstRecord rec;
+        memset(&rec, 0, sizeof(rec));
+        rec.type = (uint32_t)constant->type;
+        
+        switch (constant->type) {
+            case CONST_INT:
+                rec.value.int_val = constant->int_val;
+                break;
+            case CONST_REAL:
+                rec.value.real_val = constant->real_val;
+                break;
+            case CONST_BOOL:
+                rec.value.bool_val = constant->bool_val ? 1 : 0;
+                break;
+            case CONST_STRING:
+                if (constant->string_val) {
+                    rec.length = (uint32_t)strlen(constant->string_val) + 1;
+                    rec.value.string_ref = strings->size;
+                    if (!buf_write(strings, constant->string_val, rec.length)) return false;
+                }
+                break;
+        }
+        if (!buf_write(table, &rec, sizeof(rec))) return false;
     }
-    
-    // 库文件就是标准的字节码文件，包含所有函数定义
-    // LibraryManager 会从字节码中提取函数签名信息
-    // 这里直接使用标准保存函数即可
-    // symtbl 参数保留用于未来可能的扩展
-    (void)symtbl;  // 避免未使用参数警告
-    
-    return bytecode_save(module, filename);
-    
-    // 注意：符号表信息已经编码在字节码的函数表中
-    // 包括函数名、参数类型、返回类型等
-    // 所以不需要单独保存符号表
+    return true;
+}
+
+/**
+ * @brief 写入函数表段
+ */
+static bool build_functions(const BytecodeModule* module, ImageBuffer* buf) {
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        const FunctionEntry* func = &module->functions[i];
+        uint32_t name_len = func->name ? (uint32_t)strlen(func->name) + 1 : 0;
+        if (!buf_write(buf, &name_len, sizeof(name_len)) ||
+            !buf_write(buf, func->name, name_len) ||
+            !buf_write(buf, &func->address, sizeof(uint32_t)) ||
+            !buf_write(buf, &func->param_count, sizeof(int32_t)) ||
+            !buf_write(buf, &func->local_count, sizeof(int32_t)) ||
+            !buf_write(buf, &func->return_type, sizeof(DataType))) {
+            return false;
+        }
+        for (int32_t j = 0; j < func->param_count; j++) {
+            // 没有 param_types 时写入默认值（TYPE_INT）
+            DataType type = func->param_types ? func->param_types[j] : TYPE_INT;
+            if (!buf_write(buf, &type, sizeof(DataType))) return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 写入全局变量元数据段（无元数据时写入空条目，保证条目数与文件头一致）
+ */
+static bool build_globals(const BytecodeModule* module, ImageBuffer* buf) {
+    for (uint32_t i = 0; i < module->global_count; i++) {
+        const GlobalEntry* entry = module->globals_info ? &module->globals_info[i] : NULL;
+        const char* name = entry ? entry->name : NULL;
+        uint16_t name_len = name ? (uint16_t)strlen(name) : 0;
+        DataType type = entry ? entry->type : TYPE_VOID;
+        int32_t index = entry ? entry->index : (int32_t)i;
+        if (!buf_write(buf, &name_len, sizeof(name_len)) ||
+            !buf_write(buf, name, name_len) ||
+            !buf_write(buf, &type, sizeof(DataType)) ||
+            !buf_write(buf, &index, sizeof(int32_t))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 写入库依赖段
+ */
+static bool build_libdeps(const BytecodeModule* module, ImageBuffer* buf) {
+    for (uint32_t i = 0; i < module->library_dep_count; i++) {
+        uint32_t len = (uint32_t)strlen(module->library_deps[i]);
+        if (!buf_write(buf, &len, sizeof(len)) ||
+            !buf_write(buf, module->library_deps[i], len)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 写入无符号 LEB128
+ */
+static bool buf_write_uleb(ImageBuffer* buf, uint32_t value) {
+    uint8_t bytes[5];
+    size_t n = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        if (value) byte |= 0x80;
+        bytes[n++] = byte;
+    } while (value);
+    return buf_write(buf, bytes, n);
+}
+
+/**
+ * @brief 写入有符号 LEB128
+ */
+static bool buf_write_sleb(ImageBuffer* buf, int32_t value) {
+    uint8_t bytes[5];
+    size_t n = 0;
+    bool more = true;
+    while (more) {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;  // 算术右移
+        if ((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40))) {
+            more = false;
+        } else {
+            byte |= 0x80;
+        }
+        bytes[n++] = byte;
+    }
+    return buf_write(buf, bytes, n);
+}
+
+/**
+ * @brief 写入行号段：源文件名 + 条目数 + 差分编码的 (pc, line) 序列
+ */
+static bool build_lines(const BytecodeModule* module, ImageBuffer* buf) {
+    const LineTable* table = &module->line_table;
+    uint32_t name_len = module->source_file ? (uint32_t)strlen(module->source_file) : 0;
+    if (!buf_write(buf, &name_len, sizeof(name_len)) ||
+        !buf_write(buf, module->source_file, name_len) ||
+        !buf_write(buf, &table->count, sizeof(table->count))) {
+        return false;
+    }
+    
+    uint32_t prev_pc = 0;
+    int32_t prev_line = 0;
+    for (uint32_t i = 0; i < table->count; i++) {
+        if (!buf_write_uleb(buf, table->entries[i].pc - prev_pc) ||
+            !buf_write_sleb(buf, table->entries[i].line - prev_line)) {
+            return false;
+        }
+        prev_pc = table->entries[i].pc;
+        prev_line = table->entries[i].line;
+    }
+    return true;
+}
+
+/**
+ * @brief 写入导出符号索引段（同名函数只索引第一个）
+ */
+static bool build_symbols(const BytecodeModule* module, ImageBuffer* buf) {
+    uint32_t bucket_count = 8;
+    while (bucket_count < module->function_count * 2) {
+        bucket_count *= 2;
+    }
+    uint32_t mask = bucket_count - 1;
+    
+    uint32_t* slots = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * bucket_count);
+    STBCSymbolRecord* records = module->function_count
+        ? (STBCSymbolRecord*)mmgr_calloc(sizeof(STBCSymbolRecord) * module->function_count) : NULL;
+    if (!slots || (module->function_count && !records)) {
+        if (slots) mmgr_free(slots);
+        if (records) mmgr_free(records);
+        return false;
+    }
+    
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        const FunctionEntry* func = &module->functions[i];
+        if (!func->name) continue;
+        
+        uint32_t hash = bytecode_symbol_hash(func->name);
+        uint32_t slot = hash & mask;
+        bool duplicate = false;
+        while (slots[slot] != 0) {
+            const STBCSymbolRecord* other = &records[slots[slot] - 1];
+            if (other->hash == hash &&
+                strcmp(module->functions[other->function_index].name, func->name) == 0) {
+                duplicate = true;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+        if (duplicate) continue;
+        
+        STBCSymbolRecord* rec = &records[count];
+        rec->hash = hash;
+        rec->function_index = i;
+        rec->address = func->address;
+        rec->param_count = func->param_count;
+        rec->local_count = func->local_count;
+        rec->return_type = (uint32_t)func->return_type;
+        slots[slot] = ++count;
+    }
+    
+    STBCSymbolIndex index;
+    memset(&index, 0, sizeof(index));
+    index.symbol_count = count;
+    index.bucket_count = bucket_count;
+    index.function_count = module->function_count;
+    bool ok = buf_write(buf, &index, sizeof(index)) &&
+              buf_write(buf, slots, sizeof(uint32_t) * bucket_count) &&
+              buf_write(buf, records, sizeof(STBCSymbolRecord) * count);
+    
+    mmgr_free(slots);
+    if (records) mmgr_free(records);
+    return ok;
+}
+
+/**
+ * @brief 写入跳转表段
+ */
+static bool build_switches(const BytecodeModule* module, ImageBuffer* buf) {
+    STBCSwitchHeader header;
+    header.table_count = module->switch_table_count;
+    header.case_count = module->switch_case_count;
+    return buf_write(buf, &header, sizeof(header)) &&
+           buf_write(buf, module->switch_tables, sizeof(SwitchTable) * module->switch_table_count) &&
+           buf_write(buf, module->switch_cases, sizeof(SwitchCase) * module->switch_case_count);
+}
+
+/**
+ * @brief 写入 FOR 循环描述符段
+ */
+static bool build_loops(const BytecodeModule* module, ImageBuffer* buf) {
+    STBCLoopHeader header;
+    header.loop_count = module->for_loop_count;
+    return buf_write(buf, &header, sizeof(header)) &&
+           buf_write(buf, module->for_loops, sizeof(ForLoop) * module->for_loop_count);
+}
+
+/**
+ * @brief 写入数组描述符段
+ */
+static bool build_arrays(const BytecodeModule* module, ImageBuffer* buf) {
+    STBCArrayHeader header;
+    header.bound_count = module->array_bound_count;
+    return buf_write(buf, &header, sizeof(header)) &&
+           buf_write(buf, module->array_bounds, sizeof(ArrayBound) * module->array_bound_count);
+}
+
+/**
+ * @brief 写入寄存器格式代码段
+ */
+static bool build_regcode(const BytecodeModule* module, ImageBuffer* buf) {
+    const RegCode* rc = module->reg_code;
+    STBCRegCodeHeader header;
+    memset(&header, 0, sizeof(header));
+    header.instruction_count = rc->count;
+    header.function_count = rc->function_count;
+    header.main_entry = rc->main_entry;
+    header.main_frame_size = rc->main_frame_size;
+    header.map_count = rc->map_count;
+    return buf_write(buf, &header, sizeof(header)) &&
+           buf_write(buf, rc->functions, sizeof(RegFunction) * rc->function_count) &&
+           buf_write(buf, rc->code, sizeof(RegInstruction) * rc->count) &&
+           buf_write(buf, rc->origin, sizeof(uint32_t) * rc->count) &&
+           buf_write(buf, rc->address_map, sizeof(uint32_t) * rc->map_count);
+}
+
+/**
+ * @brief 待写出的段
+ */
+typedef struct {
+    uint32_t type;
+    uint32_t flags;
+    const void* data;
+    size_t size;
+} PendingSection;
+
+/**
+ * @brief 构建完整的 3.x 文件映像
+ * 
+ * library 为 true 或模块带函数时写出 SYMBOLS 段（`stvm -c` 的输出也能按索引导入）。
+ */
+static ErrorCode build_image(const BytecodeModule* module, bool library, ImageBuffer* image) {
+    STBCHeader header;
+    STBCLayout layout;
+    STBCSection table[STBC_MAX_SECTIONS];
+    PendingSection sections[STBC_MAX_SECTIONS];
+    uint32_t count = 0;
+    memset(&header, 0, sizeof(header));
+    memset(&layout, 0, sizeof(layout));
+    memset(table, 0, sizeof(table));
+    
+    ImageBuffer consts = {0};
+    ImageBuffer strings = {0};
+    ImageBuffer funcs = {0};
+    ImageBuffer deps = {0};
+    ImageBuffer globals = {0};
+    ImageBuffer lines = {0};
+    ImageBuffer symbols = {0};
+    ImageBuffer switches = {0};
+    ImageBuffer loops = {0};
+    ImageBuffer arrays = {0};
+    ImageBuffer regcode = {0};
+    ErrorCode err = ERR_OUT_OF_MEMORY;
+    bool export_symbols = library || module->function_count > 0;
+    
+    if (!build_constants(module, &consts, &strings) ||
+        !build_functions(module, &funcs) ||
+        !build_libdeps(module, &deps) ||
+        (export_symbols && !build_symbols(module, &symbols)) ||
+        (module->switch_table_count > 0 && !build_switches(module, &switches)) ||
+        (module->for_loop_count > 0 && !build_loops(module, &loops)) ||
+        (module->array_bound_count > 0 && !build_arrays(module, &arrays)) ||
+        (module->reg_code && !build_regcode(module, &regcode))) {
+        goto cleanup;
+    }
+    
+    sections[count++] = (PendingSection){ STBC_SECTION_CODE, 0, module->instructions,
+                                          sizeof(Instruction) * module->instruction_count };
+    sections[count++] = (PendingSection){ STBC_SECTION_CONSTANTS, 0, consts.data, consts.size };
+    sections[count++] = (PendingSection){ STBC_SECTION_STRINGS, 0, strings.data, strings.size };
+    sections[count++] = (PendingSection){ STBC_SECTION_FUNCTIONS, 0, funcs.data, funcs.size };
+    sections[count++] = (PendingSection){ STBC_SECTION_LIBDEPS, 0, deps.data, deps.size };
+    if (export_symbols) {
+        sections[count++] = (PendingSection){ STBC_SECTION_SYMBOLS, 0, symbols.data, symbols.size };
+    }
+    if (module->switch_table_count > 0) {
+        sections[count++] = (PendingSection){ STBC_SECTION_SWITCHES, 0, switches.data, switches.size };
+    }
+    if (module->for_loop_count > 0) {
+        sections[count++] = (PendingSection){ STBC_SECTION_LOOPS, 0, loops.data, loops.size };
+    }
+    if (module->array_bound_count > 0) {
+        sections[count++] = (PendingSection){ STBC_SECTION_ARRAYS, 0, arrays.data, arrays.size };
+    }
+    if (module->reg_code) {
+        sections[count++] = (PendingSection){ STBC_SECTION_REGCODE, 0, regcode.data, regcode.size };
+        layout.flags |= STBC_FLAG_REGISTER_CODE;
+    }
+    
+    // 调试段：尚未加载时原样转写映像中的内容
+    static const uint32_t debug_types[] = { STBC_SECTION_GLOBALS, STBC_SECTION_LINES };
+    for (size_t i = 0; i < sizeof(debug_types) / sizeof(debug_types[0]); i++) {
+        uint32_t type = debug_types[i];
+        const void* data = NULL;
+        uint32_t size = 0;
+        if (module->debug_pending) {
+            data = bytecode_get_section(module, (STBCSectionType)type, &size);
+            if (!data) continue;
+        } else if (type == STBC_SECTION_GLOBALS) {
+            if (module->global_count == 0) continue;
+            if (!build_globals(module, &globals)) goto cleanup;
+            data = globals.data;
+            size = (uint32_t)globals.size;
+        } else {
+            if (module->line_table.count == 0 && !module->source_file) continue;
+            if (!build_lines(module, &lines)) goto cleanup;
+            data = lines.data;
+            size = (uint32_t)lines.size;
+        }
+        sections[count++] = (PendingSection){ type, STBC_SECTION_FLAG_DEBUG, data, size };
+    }
+    
+    // 文件头、段表先占位，最后回填
+    if (!buf_write(image, &header, sizeof(header)) ||
+        !buf_write(image, &layout, sizeof(layout)) ||
+        !buf_write(image, table, sizeof(STBCSection) * count)) {
+        goto cleanup;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        if (!buf_align(image)) goto cleanup;
+        table[i].type = sections[i].type;
+        table[i].flags = sections[i].flags;
+        table[i].offset = (uint32_t)image->size;
+        table[i].size = (uint32_t)sections[i].size;
+        table[i].checksum = crc32_compute(sections[i].data, sections[i].size);
+        if (!buf_write(image, sections[i].data, sections[i].size)) goto cleanup;
+    }
+    
+    layout.file_size = (uint32_t)image->size;
+    layout.section_count = count;
+    
+    header.magic = STBC_MAGIC;
+    header.version_major = STBC_VERSION_MAJOR;
+    header.version_minor = STBC_VERSION_MINOR;
+    header.entry_point = module->entry_point;
+    header.global_var_count = module->global_count;
+    header.constant_count = module->const_count;
+    header.function_count = module->function_count;
+    header.instruction_count = module->instruction_count;
+    header.library_dep_count = module->library_dep_count;
+    // 代码段的 CRC 刚算过（段 0），直接复用，等价于 bytecode_compute_checksum
+    header.checksum = table[0].checksum ^ module->const_count ^ module->function_count;
+    memcpy(image->data, &header, sizeof(header));
+    memcpy(image->data + sizeof(header), &layout, sizeof(layout));
+    memcpy(image->data + sizeof(header) + sizeof(layout), table, sizeof(STBCSection) * count);
+    err = OK;
+    
+cleanup:
+    if (consts.data) mmgr_free(consts.data);
+    if (strings.data) mmgr_free(strings.data);
+    if (funcs.data) mmgr_free(funcs.data);
+    if (deps.data) mmgr_free(deps.data);
+    if (globals.data) mmgr_free(globals.data);
+    if (lines.data) mmgr_free(lines.data);
+    if (symbols.data) mmgr_free(symbols.data);
+    if (switches.data) mmgr_free(switches.data);
+    if (loops.data) mmgr_free(loops.data);
+    if (arrays.data) mmgr_free(arrays.data);
+    if (regcode.data) mmgr_free(regcode.data);
+    return err;
+}
+
+/**
+ * @brief 构建映像并写入流
+ */
+static ErrorCode write_image(const BytecodeModule* module, bool library, FILE* fp) {
+    ImageBuffer image = {0};
+    ErrorCode err = build_image(module, library, &image);
+    if (err == OK && fwrite(image.data, 1, image.size, fp) != image.size) {
+        err = ERR_FILE_IO;
+    }
+    if (image.data) mmgr_free(image.data);
+    
+    return err;
+}
+
+/**
+ * @brief 构建映像并原子地替换目标文件
+ *
+ * 已加载的模块以 MAP_PRIVATE 映射着原文件，原地截断会让尚未读入的页
+ * 触发 SIGBUS 或读到新内容。因此先写入 <file>.tmp 并落盘，再 rename 覆盖，
+ * 旧映射继续引用被替换掉的那个 inode。
+ */
+static ErrorCode write_image_file(const BytecodeModule* module, bool library, const char* filename) {
+    size_t name_len = strlen(filename);
+    char* tmp_file = (char*)mmgr_alloc(name_len + 5);
+    if (!tmp_file) {
+        return ERR_OUT_OF_MEMORY;
+    }
+    memcpy(tmp_file, filename, name_len);
+    memcpy(tmp_file + name_len, ".tmp", 5);
+    
+    ErrorCode err = ERR_FILE_IO;
+    FILE* fp = fopen(tmp_file, "wb");
+    if (fp) {
+        err = write_image(module, library, fp);
+        if (err == OK && (fflush(fp) != 0 || fsync(fileno(fp)) != 0)) {
+            err = ERR_FILE_IO;
+        }
+        if (fclose(fp) != 0 && err == OK) {
+            err = ERR_FILE_IO;
+        }
+        if (err == OK && rename(tmp_file, filename) != 0) {
+            err = ERR_FILE_IO;
+        }
+        if (err != OK) {
+            remove(tmp_file);
+        }
+    }
+    
+    mmgr_free(tmp_file);
+    return err;
+}
+
+/**
+ * @brief 保存字节码到文件
+ */
+ErrorCode bytecode_save(const BytecodeModule* module, const char* filename) {
+    if (!module || !filename) {
+        return ERR_RUNTIME;
+    }
+    
+    return write_image_file(module, false, filename);
+}
+
+/**
+ * @brief 保存字节码到流
+ */
+ErrorCode bytecode_save_to_stream(const BytecodeModule* module, FILE* fp) {
+    if (!module || !fp) {
+        return ERR_RUNTIME;
+    }
+    
+    return write_image(module, false, fp);
+}
+
+// ============================================================================
+// 映像解析 (3.x 加载)
+// ============================================================================
+
+/**
+ * @brief 带边界检查的顺序读取器
+ */
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+} ImageReader;
+
+/**
+ * @brief 取出 len 字节，越界返回 NULL
+ */
+static const uint8_t* rd_take(ImageReader* rd, size_t len) {
+    if (len > rd->size - rd->pos) return NULL;
+    const uint8_t* p = rd->data + rd->pos;
+    rd->pos += len;
+    return p;
+}
+
+/**
+ * @brief 读取定长字段
+ */
+static bool rd_read(ImageReader* rd, void* out, size_t len) {
+    const uint8_t* p = rd_take(rd, len);
+    if (!p) return false;
+    memcpy(out, p, len);
+    return true;
+}
+
+/**
+ * @brief 在映像的段表中查找段（段表已在加载时校验过边界）
+ */
+static const STBCSection* find_section(const uint8_t* base, uint32_t type) {
+    STBCLayout layout;
+    memcpy(&layout, base + sizeof(STBCHeader), sizeof(layout));
+    const STBCSection* table = (const STBCSection*)(base + sizeof(STBCHeader) + sizeof(STBCLayout));
+    for (uint32_t i = 0; i < layout.section_count; i++) {
+        if (table[i].type == type) {
+            return &table[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief 获取模块映像中的段
+ */
+const void* bytecode_get_section(const BytecodeModule* module, STBCSectionType type, uint32_t* size) {
+    if (!module || !module->image) return NULL;
+    
+    const uint8_t* base = (const uint8_t*)module->image;
+    const STBCHeader* header = (const STBCHeader*)base;
+    if (header->version_major != STBC_VERSION_MAJOR) return NULL;
+    
+    const STBCSection* sec = find_section(base, type);
+    if (!sec) return NULL;
+    if (size) *size = sec->size;
+    return base + sec->offset;
+}
+
+/**
+ * @brief 取段内容并校验 CRC；段不存在时返回空读取器
+ */
+static ErrorCode open_section(const uint8_t* base, uint32_t type, ImageReader* rd) {
+    rd->data = base;
+    rd->size = 0;
+    rd->pos = 0;
+    
+    const STBCSection* sec = find_section(base, type);
+    if (!sec) return OK;
+    
+    rd->data = base + sec->offset;
+    rd->size = sec->size;
+    if (crc32_compute(rd->data, sec->size) != sec->checksum) {
+        fprintf(stderr, "Error: Checksum mismatch in bytecode section %u\n", type);
+        return ERR_INVALID_BYTECODE;
+    }
+    return OK;
+}
+
+/**
+ * @brief 解析函数表段
+ */
+static ErrorCode parse_functions(BytecodeModule* module, uint32_t count, ImageReader* rd) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t name_len, address;
+        int32_t param_count, local_count;
+        DataType return_type;
+        if (!rd_read(rd, &name_len, sizeof(name_len))) return ERR_INVALID_BYTECODE;
+        const char* name = (const char*)rd_take(rd, name_len);
+        if (!name || name_len == 0 || name[name_len - 1] != '\0') return ERR_INVALID_BYTECODE;
+        if (!rd_read(rd, &address, sizeof(address)) ||
+            !rd_read(rd, &param_count, sizeof(param_count)) ||
+            !rd_read(rd, &local_count, sizeof(local_count)) ||
+            !rd_read(rd, &return_type, sizeof(return_type))) {
+            return ERR_INVALID_BYTECODE;
+        }
+        // 可变参数函数（如内置 PRINT）的参数个数为负，不带参数类型
+        size_t type_count = param_count > 0 ? (size_t)param_count : 0;
+        const uint8_t* types = rd_take(rd, sizeof(DataType) * type_count);
+        if (!types) return ERR_INVALID_BYTECODE;
+        
+        // 参数类型在映像中未必对齐，复制出来再交给函数表
+        DataType* param_types = NULL;
+        if (param_count > 0) {
+            param_types = (DataType*)mmgr_alloc(sizeof(DataType) * param_count);
+            if (!param_types) return ERR_OUT_OF_MEMORY;
+            memcpy(param_types, types, sizeof(DataType) * param_count);
+        }
+        uint32_t idx = bytecode_add_function(module, name, address, param_count,
+                                             local_count, return_type, param_types);
+        if (param_types) mmgr_free(param_types);
+        if (idx == (uint32_t)-1) return ERR_OUT_OF_MEMORY;
+    }
+    return OK;
+}
+
+/**
+ * @brief 解析库依赖段
+ */
+static ErrorCode parse_libdeps(BytecodeModule* module, uint32_t count, ImageReader* rd) {
+    if (count == 0) return OK;
+    
+    module->library_deps = (char**)mmgr_calloc(sizeof(char*) * count);
+    if (!module->library_deps) return ERR_OUT_OF_MEMORY;
+    module->library_dep_count = count;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t len;
+        if (!rd_read(rd, &len, sizeof(len))) return ERR_INVALID_BYTECODE;
+        const char* path = (const char*)rd_take(rd, len);
+        if (!path) return ERR_INVALID_BYTECODE;
+        module->library_deps[i] = (char*)mmgr_alloc(len + 1);
+        if (!module->library_deps[i]) return ERR_OUT_OF_MEMORY;
+        memcpy(module->library_deps[i], path, len);
+        module->library_deps[i][len] = '\0';
+    }
+    return OK;
+}
+
+/**
+ * @brief 校验导出符号索引段并挂到模块上（索引直接引用映像）
+ */
+static ErrorCode parse_symbols(BytecodeModule* module, ImageReader* rd) {
+    if (rd->size == 0) return OK;  // 不是库文件
+    
+    STBCSymbolIndex index;
+    if (!rd_read(rd, &index, sizeof(index))) return ERR_INVALID_BYTECODE;
+    if (index.bucket_count == 0 || (index.bucket_count & (index.bucket_count - 1)) != 0 ||
+        index.symbol_count >= index.bucket_count ||
+        index.function_count != module->function_count ||
+        (uint64_t)index.bucket_count * sizeof(uint32_t) +
+        (uint64_t)index.symbol_count * sizeof(STBCSymbolRecord) != rd->size - rd->pos) {
+        return ERR_INVALID_BYTECODE;
+    }
+    
+    // 槽位与记录都不越界，查找时才能省去检查
+    const uint32_t* slots = (const uint32_t*)(rd->data + rd->pos);
+    const STBCSymbolRecord* records = (const STBCSymbolRecord*)(slots + index.bucket_count);
+    for (uint32_t i = 0; i < index.bucket_count; i++) {
+        if (slots[i] > index.symbol_count) return ERR_INVALID_BYTECODE;
+    }
+    for (uint32_t i = 0; i < index.symbol_count; i++) {
+        if (records[i].function_index >= module->function_count) return ERR_INVALID_BYTECODE;
+    }
+    
+    module->symbol_index = (const STBCSymbolIndex*)rd->data;
+    return OK;
+}
+
+/**
+ * @brief 解析跳转表段（复制到堆上，链接和窥孔优化会原地重定位）
+ */
+static ErrorCode parse_switches(BytecodeModule* module, ImageReader* rd) {
+    if (rd->size == 0) return OK;
+    
+    STBCSwitchHeader header;
+    if (!rd_read(rd, &header, sizeof(header)) ||
+        (uint64_t)header.table_count * sizeof(SwitchTable) +
+        (uint64_t)header.case_count * sizeof(SwitchCase) != rd->size - rd->pos) {
+        return ERR_INVALID_BYTECODE;
+    }
+    if (header.table_count == 0) return OK;
+    
+    SwitchTable* tables = (SwitchTable*)mmgr_alloc(sizeof(SwitchTable) * header.table_count);
+    SwitchCase* cases = header.case_count
+        ? (SwitchCase*)mmgr_alloc(sizeof(SwitchCase) * header.case_count) : NULL;
+    if (!tables || (header.case_count && !cases)) {
+        if (tables) mmgr_free(tables);
+        if (cases) mmgr_free(cases);
+        return ERR_OUT_OF_MEMORY;
+    }
+    rd_read(rd, tables, sizeof(SwitchTable) * header.table_count);
+    rd_read(rd, cases, sizeof(SwitchCase) * header.case_count);
+    
+    // 查找时不再检查条目范围
+    for (uint32_t i = 0; i < header.table_count; i++) {
+        if (tables[i].kind > SWITCH_SORTED ||
+            (uint64_t)tables[i].first + tables[i].count > header.case_count) {
+            mmgr_free(tables);
+            if (cases) mmgr_free(cases);
+            return ERR_INVALID_BYTECODE;
+        }
+    }
+    
+    module->switch_tables = tables;
+    module->switch_table_count = header.table_count;
+    module->switch_cases = cases;
+    module->switch_case_count = header.case_count;
+    return OK;
+}
+
+/**
+ * @brief 解析 FOR 循环描述符段（复制到堆上，链接和窥孔优化会原地重定位）
+ */
+static ErrorCode parse_loops(BytecodeModule* module, ImageReader* rd) {
+    if (rd->size == 0) return OK;
+    
+    STBCLoopHeader header;
+    if (!rd_read(rd, &header, sizeof(header)) ||
+        (uint64_t)header.loop_count * sizeof(ForLoop) != rd->size - rd->pos) {
+        return ERR_INVALID_BYTECODE;
+    }
+    if (header.loop_count == 0) return OK;
+    
+    ForLoop* loops = (ForLoop*)mmgr_alloc(sizeof(ForLoop) * header.loop_count);
+    if (!loops) return ERR_OUT_OF_MEMORY;
+    rd_read(rd, loops, sizeof(ForLoop) * header.loop_count);
+    
+    // 执行时不再检查步长和标志
+    const uint32_t known = FOR_LOOP_VAR_GLOBAL | FOR_LOOP_END_VAR |
+                           FOR_LOOP_END_GLOBAL | FOR_LOOP_CONST_START;
+    for (uint32_t i = 0; i < header.loop_count; i++) {
+        if (loops[i].step == 0 || (loops[i].flags & ~known) != 0 ||
+            loops[i].var > UINT16_MAX || loops[i].end_var > UINT16_MAX) {
+            mmgr_free(loops);
+            return ERR_INVALID_BYTECODE;
+        }
+    }
+    
+    module->for_loops = loops;
+    module->for_loop_count = header.loop_count;
+    return OK;
+}
+
+/**
+ * @brief 3.4 的数组描述符（没有下界，下标从 0 开始）
+ */
+#define STBC_ARRAY_BOUND_V34_SIZE (3 * sizeof(uint32_t))
+
+/**
+ * @brief 解析数组描述符段（复制到堆上，静态链接会追加描述符）
+ * 
+ * 3.4 的记录没有 lower 字段，是 3.5 记录的前缀，按段大小区分。
+ */
+static ErrorCode parse_arrays(BytecodeModule* module, ImageReader* rd) {
+    if (rd->size == 0) return OK;
+    
+    STBCArrayHeader header;
+    if (!rd_read(rd, &header, sizeof(header))) return ERR_INVALID_BYTECODE;
+    uint64_t remaining = rd->size - rd->pos;
+    size_t record_size;
+    if ((uint64_t)header.bound_count * sizeof(ArrayBound) == remaining) {
+        record_size = sizeof(ArrayBound);
+    } else if ((uint64_t)header.bound_count * STBC_ARRAY_BOUND_V34_SIZE == remaining) {
+        record_size = STBC_ARRAY_BOUND_V34_SIZE;
+    } else {
+        return ERR_INVALID_BYTECODE;
+    }
+    if (header.bound_count == 0) return OK;
+    
+    ArrayBound* bounds = (ArrayBound*)mmgr_calloc(sizeof(ArrayBound) * header.bound_count);
+    if (!bounds) return ERR_OUT_OF_MEMORY;
+    for (uint32_t i = 0; i < header.bound_count; i++) {
+        rd_read(rd, &bounds[i], record_size);
+    }
+    
+    for (uint32_t i = 0; i < header.bound_count; i++) {
+        if (bounds[i].length == 0 || (bounds[i].flags & ~(uint32_t)ARRAY_BOUND_GLOBAL) != 0 ||
+            bounds[i].base > UINT16_MAX || bounds[i].length > UINT16_MAX ||
+            (int64_t)bounds[i].lower + bounds[i].length - 1 > INT32_MAX) {
+            mmgr_free(bounds);
+            return ERR_INVALID_BYTECODE;
+        }
+    }
+    
+    module->array_bounds = bounds;
+    module->array_bound_count = header.bound_count;
+    return OK;
+}
+
+/**
+ * @brief 解析寄存器格式代码段（复制到堆上，经 regcode_attach 完整校验后挂接）
+ */
+static ErrorCode parse_regcode(BytecodeModule* module, ImageReader* rd) {
+    STBCRegCodeHeader header;
+    if (!rd_read(rd, &header, sizeof(header)) ||
+        header.function_count != module->function_count ||
+        header.map_count != module->instruction_count ||
+        header.instruction_count == 0 || header.instruction_count > UINT16_MAX ||
+        (uint64_t)header.function_count * sizeof(RegFunction) +
+        (uint64_t)header.instruction_count * (sizeof(RegInstruction) + sizeof(uint32_t)) +
+        (uint64_t)header.map_count * sizeof(uint32_t) != rd->size - rd->pos) {
+        return ERR_INVALID_BYTECODE;
+    }
+    
+    RegCode* rc = (RegCode*)mmgr_calloc(sizeof(RegCode));
+    if (!rc) return ERR_OUT_OF_MEMORY;
+    rc->count = header.instruction_count;
+    rc->function_count = header.function_count;
+    rc->main_entry = header.main_entry;
+    rc->main_frame_size = header.main_frame_size;
+    rc->map_count = header.map_count;
+    rc->code = (RegInstruction*)mmgr_alloc(sizeof(RegInstruction) * rc->count);
+    rc->origin = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * rc->count);
+    rc->address_map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (rc->map_count ? rc->map_count : 1));
+    if (rc->function_count > 0) {
+        rc->functions = (RegFunction*)mmgr_alloc(sizeof(RegFunction) * rc->function_count);
+    }
+    if (!rc->code || !rc->origin || !rc->address_map ||
+        (rc->function_count > 0 && !rc->functions)) {
+        regcode_free(rc);
+        return ERR_OUT_OF_MEMORY;
+    }
+    if (rc->function_count > 0) {
+        rd_read(rd, rc->functions, sizeof(RegFunction) * rc->function_count);
+    }
+    rd_read(rd, rc->code, sizeof(RegInstruction) * rc->count);
+    rd_read(rd, rc->origin, sizeof(uint32_t) * rc->count);
+    rd_read(rd, rc->address_map, sizeof(uint32_t) * rc->map_count);
+    
+    ErrorCode err = regcode_attach(module, rc);
+    if (err != OK) regcode_free(rc);
+    return err;
+}
+
+/**
+ * @brief 解析全局变量元数据段
+ */
+static ErrorCode parse_globals(BytecodeModule* module, ImageReader* rd) {
+    if (module->global_count == 0 || rd->size == 0) return OK;
+    
+    GlobalEntry* info = (GlobalEntry*)mmgr_calloc(sizeof(GlobalEntry) * module->global_count);
+    if (!info) return ERR_OUT_OF_MEMORY;
+    
+    ErrorCode err = OK;
+    for (uint32_t i = 0; i < module->global_count && err == OK; i++) {
+        GlobalEntry* entry = &info[i];
+        uint16_t name_len;
+        const char* name = NULL;
+        if (!rd_read(rd, &name_len, sizeof(name_len)) ||
+            !(name = (const char*)rd_take(rd, name_len)) ||
+            !rd_read(rd, &entry->type, sizeof(DataType)) ||
+            !rd_read(rd, &entry->index, sizeof(int32_t))) {
+            err = ERR_INVALID_BYTECODE;
+            break;
+        }
+        if (name_len > 0) {
+            entry->name = (char*)mmgr_alloc(name_len + 1);
+            if (!entry->name) {
+                err = ERR_OUT_OF_MEMORY;
+                break;
+            }
+            memcpy(entry->name, name, name_len);
+            entry->name[name_len] = '\0';
+        }
+    }
+    
+    if (err != OK) {
+        for (uint32_t i = 0; i < module->global_count; i++) {
+            if (info[i].name) mmgr_free(info[i].name);
+        }
+        mmgr_free(info);
+        return err;
+    }
+    module->globals_info = info;
+    return OK;
+}
+
+/**
+ * @brief 读取无符号 LEB128
+ */
+static bool rd_read_uleb(ImageReader* rd, uint32_t* out) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        const uint8_t* p = rd_take(rd, 1);
+        if (!p) return false;
+        value |= (uint32_t)(*p & 0x7F) << shift;
+        if (!(*p & 0x80)) {
+            *out = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 读取有符号 LEB128
+ */
+static bool rd_read_sleb(ImageReader* rd, int32_t* out) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        const uint8_t* p = rd_take(rd, 1);
+        if (!p) return false;
+        value |= (uint32_t)(*p & 0x7F) << shift;
+        if (!(*p & 0x80)) {
+            if (shift + 7 < 32 && (*p & 0x40)) {
+                value |= ~0u << (shift + 7);  // 符号扩展
+            }
+            *out = (int32_t)value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 解析行号段
+ */
+static ErrorCode parse_lines(BytecodeModule* module, ImageReader* rd) {
+    if (rd->size == 0) return OK;
+    
+    uint32_t name_len, count;
+    const char* name;
+    if (!rd_read(rd, &name_len, sizeof(name_len)) ||
+        !(name = (const char*)rd_take(rd, name_len)) ||
+        !rd_read(rd, &count, sizeof(count)) ||
+        count > rd->size) {  // 每个条目至少占 2 字节，过大的计数必然损坏
+        return ERR_INVALID_BYTECODE;
+    }
+    
+    if (name_len > 0) {
+        module->source_file = (char*)mmgr_alloc(name_len + 1);
+        if (!module->source_file) return ERR_OUT_OF_MEMORY;
+        memcpy(module->source_file, name, name_len);
+        module->source_file[name_len] = '\0';
+    }
+    
+    uint32_t pc = 0;
+    int32_t line = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t pc_delta;
+        int32_t line_delta;
+        if (!rd_read_uleb(rd, &pc_delta) || !rd_read_sleb(rd, &line_delta)) {
+            return ERR_INVALID_BYTECODE;
+        }
+        pc += pc_delta;
+        line += line_delta;
+        if (!bytecode_line_table_append(module, pc, line)) {
+            return ERR_INVALID_BYTECODE;
+        }
+    }
+    return OK;
+}
+
+/**
+ * @brief 按需加载调试段
+ */
+ErrorCode bytecode_load_debug_info(BytecodeModule* module) {
+    if (!module) return ERR_RUNTIME;
+    if (!module->debug_pending) return OK;
+    
+    // 无论成功与否只尝试一次
+    module->debug_pending = false;
+    
+    const uint8_t* base = (const uint8_t*)module->image;
+    ImageReader rd;
+    ErrorCode err = open_section(base, STBC_SECTION_GLOBALS, &rd);
+    if (err == OK) err = parse_globals(module, &rd);
+    if (err != OK) return err;
+    
+    err = open_section(base, STBC_SECTION_LINES, &rd);
+    if (err == OK) err = parse_lines(module, &rd);
+    return err;
+}
+
+/**
+ * @brief 校验文件头、段表边界以及文件头计数与段大小是否相符
+ *
+ * 在按文件头计数分配模块之前调用，避免伪造的计数触发超大分配。
+ */
+static ErrorCode check_image(const uint8_t* base, size_t size) {
+    if (size < sizeof(STBCHeader) + sizeof(STBCLayout)) return ERR_INVALID_BYTECODE;
+    
+    STBCHeader header;
+    STBCLayout layout;
+    memcpy(&header, base, sizeof(header));
+    memcpy(&layout, base + sizeof(header), sizeof(layout));
+    if (header.magic != STBC_MAGIC || header.version_major != STBC_VERSION_MAJOR ||
+        layout.file_size > size || layout.section_count > STBC_MAX_SECTIONS ||
+        sizeof(header) + sizeof(layout) + sizeof(STBCSection) * layout.section_count > layout.file_size) {
+        return ERR_INVALID_BYTECODE;
+    }
+    
+    // 校验段表边界
+    const STBCSection* table = (const STBCSection*)(base + sizeof(header) + sizeof(layout));
+    for (uint32_t i = 0; i < layout.section_count; i++) {
+        if (table[i].offset % STBC_SECTION_ALIGN != 0 ||
+            (uint64_t)table[i].offset + table[i].size > layout.file_size) {
+            return ERR_INVALID_BYTECODE;
+        }
+    }
+    
+    // 计数须与段大小相符：常量记录定长，函数表项至少含名字长度、
+    // 一字节名字以及地址、参数个数、局部变量个数和返回类型
+    const STBCSection* code = find_section(base, STBC_SECTION_CODE);
+    const STBCSection* consts = find_section(base, STBC_SECTION_CONSTANTS);
+    const STBCSection* funcs = find_section(base, STBC_SECTION_FUNCTIONS);
+    const uint64_t min_function = sizeof(uint32_t) + 1 + sizeof(uint32_t) +
+                                  2 * sizeof(int32_t) + sizeof(DataType);
+    if ((uint64_t)header.instruction_count * sizeof(Instruction) != (code ? code->size : 0) ||
+        (uint64_t)header.constant_count * sizeof(STBCConstRecord) != (consts ? consts->size : 0) ||
+        (uint64_t)header.function_count * min_function > (funcs ? funcs->size : 0)) {
+        return ERR_INVALID_BYTECODE;
+    }
+    return OK;
+}
+
+/**
+ * @brief 将映像挂到模块上并解析执行所需的段
+ * 
+ * 指令数组与字符串常量直接引用映像，其余表按文件头计数精确分配；
+ * 调试段只记录为待加载。映像须已通过 check_image 校验。
+ */
+static ErrorCode parse_image(BytecodeModule* module, void* image, size_t size, bool mapped) {
+    module->image = image;
+    module->image_size = size;
+    module->image_mapped = mapped;
+    
+    const uint8_t* base = (const uint8_t*)image;
+    STBCHeader header;
+    STBCLayout layout;
+    memcpy(&header, base, sizeof(header));
+    memcpy(&layout, base + sizeof(header), sizeof(layout));
+    
+    const STBCSection* table = (const STBCSection*)(base + sizeof(header) + sizeof(layout));
+    for (uint32_t i = 0; i < layout.section_count; i++) {
+        if (table[i].flags & STBC_SECTION_FLAG_DEBUG) {
+            module->debug_pending = true;
+        }
+    }
+    
+    module->entry_point = header.entry_point;
+    module->global_count = header.global_var_count;
+    
+    // 代码段：零拷贝
+    ImageReader code, consts, strings, rd;
+    ErrorCode err = open_section(base, STBC_SECTION_CODE, &code);
+    if (err != OK) return err;
+    if (code.size != (uint64_t)header.instruction_count * sizeof(Instruction)) {
+        return ERR_INVALID_BYTECODE;
+    }
+    module->instructions = header.instruction_count ? (Instruction*)code.data : NULL;
+    module->instruction_count = header.instruction_count;
+    module->instruction_capacity = header.instruction_count;
+    
+    // 常量表：字符串直接指向字符串段
+    if ((err = open_section(base, STBC_SECTION_CONSTANTS, &consts)) != OK ||
+        (err = open_section(base, STBC_SECTION_STRINGS, &strings)) != OK) {
+        return err;
+    }
+    if (consts.size != (uint64_t)header.constant_count * sizeof(STBCConstRecord)) {
+        return ERR_INVALID_BYTECODE;
+    }
+    const STBCConstRecord* records = (const STBCConstRecord*)consts.data;
+    const char* blob = (const char*)strings.data;
+    for (uint32_t i = 0; i < header.constant_count; i++) {
+        const STBCConstRecord* rec = &records[i];
+        Constant* constant = &module->constants[i];
+        memset(constant, 0, sizeof(*constant));
+        constant->type = (ConstantType)rec->type;
+        
+        switch (rec->type) {
+            case CONST_INT:
+                constant->int_val = rec->value.int_val;
+                break;
+            case CONST_REAL:
+                constant->real_val = rec->value.real_val;
+                break;
+            case CONST_BOOL:
+                constant->bool_val = rec->value.bool_val != 0;
+                break;
+            case CONST_STRING:
+                if (rec->length > 0) {
+                    if (rec->value.string_ref + rec->length > strings.size ||
+                        blob[rec->value.string_ref + rec->length - 1] != '\0') {
+                        return ERR_INVALID_BYTECODE;
+                    }
+                    constant->string_val = (char*)(blob + rec->value.string_ref);
+                }
+                break;
+            default:
+                return ERR_INVALID_BYTECODE;
+        }
+        module->const_count = i + 1;
+    }
+    
+    // 函数表与库依赖
+    if ((err = open_section(base, STBC_SECTION_FUNCTIONS, &rd)) != OK ||
+        (err = parse_functions(module, header.function_count, &rd)) != OK) {
+        return err;
+    }
+    if ((err = open_section(base, STBC_SECTION_LIBDEPS, &rd)) != OK ||
+        (err = parse_libdeps(module, header.library_dep_count, &rd)) != OK) {
+        return err;
+    }
+    
+    if ((err = open_section(base, STBC_SECTION_SWITCHES, &rd)) != OK ||
+        (err = parse_switches(module, &rd)) != OK) {
+        return err;
+    }
+    if ((err = open_section(base, STBC_SECTION_LOOPS, &rd)) != OK ||
+        (err = parse_loops(module, &rd)) != OK) {
+        return err;
+    }
+    
+    // 数组描述符：免检访问依赖跳转表、循环描述符和函数表，执行前在此重新证明
+    if ((err = open_section(base, STBC_SECTION_ARRAYS, &rd)) != OK ||
+        (err = parse_arrays(module, &rd)) != OK) {
+        return err;
+    }
+    if (!bytecode_verify_arrays(module)) {
+        return ERR_INVALID_BYTECODE;
+    }
+    
+    // 导出符号索引：须在函数表解析之后挂接（添加函数会使索引失效）
+    if ((err = open_section(base, STBC_SECTION_SYMBOLS, &rd)) != OK ||
+        (err = parse_symbols(module, &rd)) != OK) {
+        return err;
+    }
+    
+    // 寄存器格式代码：依赖函数表、跳转表和循环描述符，最后挂接
+    if (layout.flags & STBC_FLAG_REGISTER_CODE) {
+        if ((err = open_section(base, STBC_SECTION_REGCODE, &rd)) != OK) return err;
+        if (rd.size == 0) return ERR_INVALID_BYTECODE;
+        if ((err = parse_regcode(module, &rd)) != OK) return err;
+    }
+    
+    // 验证校验和：代码段 CRC 已在打开段时校验过，不再重新计算
+    const STBCSection* code_sec = find_section(base, STBC_SECTION_CODE);
+    uint32_t code_crc = code_sec ? code_sec->checksum : 0;
+    if ((code_crc ^ header.constant_count ^ header.function_count) != header.checksum) {
+        fprintf(stderr, "Warning: Checksum mismatch in bytecode file\n");
+    }
+    return OK;
+}
+
+/**
+ * @brief 为映像创建模块并解析，失败时释放映像
+ */
+static BytecodeModule* load_image(void* image, size_t size, bool mapped) {
+    const STBCHeader* header = (const STBCHeader*)image;
+    BytecodeModule* module = NULL;
+    
+    if (check_image((const uint8_t*)image, size) == OK) {
+        // 指令区不单独分配，其余表按文件头精确分配
+        module = bytecode_module_create_sized(0, header->constant_count, header->function_count);
+    }
+    if (!module) {
+        if (mapped) {
+            munmap(image, size);
+        } else {
+            mmgr_free(image);
+        }
+        return NULL;
+    }
+    
+    if (parse_image(module, image, size, mapped) != OK) {
+        bytecode_module_free(module);  // 同时释放映像
+        return NULL;
+    }
+    return module;
+}
+
+/**
+ * @brief 以流方式加载文件（旧格式或无法映射时使用）
+ */
+static BytecodeModule* load_file_stream(const char* filename) {
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+    BytecodeModule* module = bytecode_load_from_stream(fp);
+    fclose(fp);
+    return module;
+}
+
+/**
+ * @brief 从文件加载字节码（3.x 使用只读 mmap 零拷贝）
+ */
+BytecodeModule* bytecode_load(const char* filename) {
+    if (!filename) return NULL;
+    
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+    
+    struct stat st;
+    void* map = MAP_FAILED;
+    size_t size = 0;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(STBCHeader) + sizeof(STBCLayout)) {
+        size = (size_t)st.st_size;
+        map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    
+    if (map == MAP_FAILED) {
+        return load_file_stream(filename);
+    }
+    
+    const STBCHeader* header = (const STBCHeader*)map;
+    if (header->magic == STBC_MAGIC && header->version_major == STBC_VERSION_MAJOR) {
+        return load_image(map, size, true);
+    }
+    
+    // 旧格式：回退到流式读取
+    munmap(map, size);
+    return load_file_stream(filename);
+}
+
+/**
+ * @brief 从流加载字节码
+ */
+BytecodeModule* bytecode_load_from_stream(FILE* fp) {
+    if (!fp) return NULL;
+    
+    // 读取文件头
+    STBCHeader header;
+    if (fread(&header, sizeof(STBCHeader), 1, fp) != 1) {
+        return NULL;
+    }
+    
+    // 验证文件头
+    if (!bytecode_validate_header(&header)) {
+        return NULL;
+    }
+    
+    if (header.version_major == STBC_LEGACY_VERSION_MAJOR) {
+        return load_legacy_stream(fp, &header);
+    }
+    
+    // 3.x：读入段表头得到文件大小，再把整个映像读入缓冲区
+    STBCLayout layout;
+    if (fread(&layout, sizeof(STBCLayout), 1, fp) != 1 ||
+        layout.file_size < sizeof(STBCHeader) + sizeof(STBCLayout)) {
+        return NULL;
+    }
+    
+    uint8_t* image = (uint8_t*)mmgr_alloc(layout.file_size);
+    if (!image) return NULL;
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + sizeof(header), &layout, sizeof(layout));
+    size_t rest = layout.file_size - sizeof(header) - sizeof(layout);
+    if (fread(image + sizeof(header) + sizeof(layout), 1, rest, fp) != rest) {
+        mmgr_free(image);
+        return NULL;
+    }
+    
+    return load_image(image, layout.file_size, false);
+}
+
+/**
+ * @brief 从内存映像加载字节码
+ */
+BytecodeModule* bytecode_load_from_memory(void* data, size_t size, bool take_ownership) {
+    if (!data || size == 0) return NULL;
+    
+    void* image = data;
+    if (!take_ownership) {
+        image = mmgr_alloc(size);
+        if (!image) return NULL;
+        memcpy(image, data, size);
+    }
+    return load_image(image, size, false);
+}
+
+/**
+ * @brief 计算校验和
+ */
+uint32_t bytecode_compute_checksum(const BytecodeModule* module) {
+    if (!module) return 0;
+    
+    uint32_t checksum = 0;
+    
+    // 对指令数组计算校验和
+    if (module->instructions && module->instruction_count > 0) {
+        checksum ^= crc32_compute(module->instructions,
+                                  module->instruction_count * sizeof(Instruction));
+    }
+    
+    // 对常量池计算校验和（简化版，只计算数量）
+    checksum ^= module->const_count;
+    
+    // 对函数表计算校验和（简化版，只计算数量）
+    checksum ^= module->function_count;
+    
+    return checksum;
+}
+
+/**
+ * @brief 验证校验和
+ */
+bool bytecode_verify_checksum(const BytecodeModule* module, uint32_t expected_checksum) {
+    if (!module) return false;
+    
+    uint32_t actual_checksum = bytecode_compute_checksum(module);
+    return actual_checksum == expected_checksum;
+}
+
+/**
+ * @brief 把字符串（含长度）加入摘要
+ */
+uint32_t bytecode_digest_string(uint32_t crc, const char* str) {
+    uint32_t len = str ? (uint32_t)strlen(str) : 0;
+    crc = crc32_update(crc, &len, sizeof(len));
+    return len > 0 ? crc32_update(crc, str, len) : crc;
+}
+
+/**
+ * @brief 把常量加入摘要（按值，不含联合体中未使用的字节）
+ */
+uint32_t bytecode_digest_constant(uint32_t crc, const Constant* constant) {
+    uint32_t type = (uint32_t)constant->type;
+    crc = crc32_update(crc, &type, sizeof(type));
+    switch (constant->type) {
+        case CONST_INT:
+            return crc32_update(crc, &constant->int_val, sizeof(constant->int_val));
+        case CONST_REAL:
+            return crc32_update(crc, &constant->real_val, sizeof(constant->real_val));
+        case CONST_BOOL: {
+            uint8_t b = constant->bool_val ? 1 : 0;
+            return crc32_update(crc, &b, sizeof(b));
+        }
+        case CONST_STRING:
+            return bytecode_digest_string(crc, constant->string_val);
+        default:
+            return crc;
+    }
+}
+
+/**
+ * @brief 把函数表条目加入摘要
+ */
+uint32_t bytecode_digest_function(uint32_t crc, const char* name, uint32_t address,
+                                  int32_t param_count, int32_t local_count,
+                                  DataType return_type, const void* param_types) {
+    crc = bytecode_digest_string(crc, name);
+    crc = crc32_update(crc, &address, sizeof(address));
+    crc = crc32_update(crc, &param_count, sizeof(param_count));
+    crc = crc32_update(crc, &local_count, sizeof(local_count));
+    crc = crc32_update(crc, &return_type, sizeof(return_type));
+    for (int32_t i = 0; i < param_count; i++) {
+        // 与 build_functions 一致：没有参数类型时按 TYPE_INT 计
+        DataType type = TYPE_INT;
+        if (param_types) {
+            memcpy(&type, (const uint8_t*)param_types + sizeof(DataType) * (size_t)i, sizeof(type));
+        }
+        crc = crc32_update(crc, &type, sizeof(type));
+    }
+    return crc;
+}
+
+/**
+ * @brief 计算模块内容摘要
+ */
+uint32_t bytecode_compute_digest(const BytecodeModule* module) {
+    if (!module) return 0;
+    
+    STBCDigestShape shape = {
+        module->entry_point, module->instruction_count, module->const_count,
+        module->function_count, module->global_count, module->library_dep_count,
+        module->switch_table_count, module->switch_case_count,
+        module->for_loop_count, module->array_bound_count
+    };
+    uint32_t crc = crc32_update(0, &shape, sizeof(shape));
+    if (module->instruction_count > 0) {
+        crc = crc32_update(crc, module->instructions, sizeof(Instruction) * module->instruction_count);
+    }
+    for (uint32_t i = 0; i < module->const_count; i++) {
+        crc = bytecode_digest_constant(crc, &module->constants[i]);
+    }
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        const FunctionEntry* func = &module->functions[i];
+        crc = bytecode_digest_function(crc, func->name, func->address, func->param_count,
+                                       func->local_count, func->return_type, func->param_types);
+    }
+    for (uint32_t i = 0; i < module->library_dep_count; i++) {
+        crc = bytecode_digest_string(crc, module->library_deps[i]);
+    }
+    if (module->switch_table_count > 0) {
+        crc = crc32_update(crc, module->switch_tables, sizeof(SwitchTable) * module->switch_table_count);
+    }
+    if (module->switch_case_count > 0) {
+        crc = crc32_update(crc, module->switch_cases, sizeof(SwitchCase) * module->switch_case_count);
+    }
+    if (module->for_loop_count > 0) {
+        crc = crc32_update(crc, module->for_loops, sizeof(ForLoop) * module->for_loop_count);
+    }
+    if (module->array_bound_count > 0) {
+        crc = crc32_update(crc, module->array_bounds, sizeof(ArrayBound) * module->array_bound_count);
+    }
+    return crc;
+}
+
+/**
+ * @brief 将字节码模块保存为库文件
+ * 
+ * 库文件格式在标准 .stbc 格式基础上添加了导出符号索引段，
+ * 使得其他模块可以导入并使用库中定义的函数，而不必在加载时重建查找结构。
+ */
+ErrorCode bytecode_save_library(const BytecodeModule* module, const struct SymbolTable* symtbl, const char* filename) {
+    if (!module || !filename) {
+        return ERR_RUNTIME;
+    }
+    
+    // 函数名、参数类型、返回类型等已编码在函数表中，symtbl 参数保留
+    (void)symtbl;
+    
+    return write_image_file(module, true, filename);
+}
+
+// ============================================================================
+// 导出符号索引
+// ============================================================================
+
+/**
+ * @brief 计算符号名哈希（FNV-1a）
+ */
+uint32_t bytecode_symbol_hash(const char* name) {
+    uint32_t h = 2166136261u;
+    for (const unsigned char* p = (const unsigned char*)name; *p; p++) {
+        h ^= *p;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * @brief 在导出符号索引中查找符号
+ * 
+ * 加载时已保证槽位数大于符号数（必有空槽，探测必然终止）且下标不越界。
+ */
+const STBCSymbolRecord* bytecode_lookup_symbol(const BytecodeModule* module, const char* name) {
+    if (!module || !name || !module->symbol_index) return NULL;
+    
+    const STBCSymbolIndex* index = module->symbol_index;
+    const uint32_t* slots = (const uint32_t*)(index + 1);
+    const STBCSymbolRecord* records = (const STBCSymbolRecord*)(slots + index->bucket_count);
+    uint32_t mask = index->bucket_count - 1;
+    uint32_t hash = bytecode_symbol_hash(name);
+    
+    for (uint32_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+        const STBCSymbolRecord* rec = &records[slots[slot] - 1];
+        if (rec->hash == hash && strcmp(module->functions[rec->function_index].name, name) == 0) {
+            return rec;
+        }
+    }
+    return NULL;
 }
@@ -0,0 +1,1907 @@
+/**
+ * @file bytecode_patch.c
+ * @brief 字节码差分补丁的实现
+ *
+ * STBP 3.x 文件格式（小端、字段不对齐；2.x 按绝对地址逐条比较指令，不再接受）：
+ * 1. 文件头 (STBPHeader)
+ * 2. 代码段：{target_offset, base_offset, count, line_delta} × segment_count
+ * 3. 指令区间：{offset, count, Instruction[count]} × run_count
+ * 4. 常量复制区间：{target_offset, source_offset, count} × const_copy_count
+ * 5. 新常量：{type, 值}，字符串为 {len(含 '\0'), 字节}
+ * 6. 函数条目：{index, name_len, name, address, param_count, local_count,
+ *    return_type, param_types[]} × function_record_count
+ * 7. 全局变量条目：{index, name_len, name, type} × global_record_count
+ * 8. 库依赖（STBP_FLAG_LIBDEPS）：{count, {len, 字节} × count}
+ * 9. 行号复制区间：{target_offset, source_offset, count} × line_copy_count
+ * 10. 新行号条目：LineEntry[line_count - 复制的条目数]
+ * 11. 跳转表（STBP_FLAG_SWITCHES）：{table_count, case_count, SwitchTable[], SwitchCase[]}
+ * 12. FOR 循环描述符（STBP_FLAG_LOOPS）：{count, ForLoop[count]}
+ * 13. 数组描述符（STBP_FLAG_ARRAYS）：{count, ArrayBound[count]}
+ *
+ * 目标指令先由代码段从基准搬移并重定位，再由指令区间覆盖；生成和应用用同一套
+ * 重定位代码，跳转表和 FOR 循环描述符没有标志时也按同样的地址映射重定位。
+ * 生成补丁时先序列化，再用同一个解析器建立视图，保存与加载走同一条路径。
+ */
+
+#include "bytecode_patch.h"
+#include "bytecode_io.h"
+#include "crc32.h"
+#include "mmgr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 相邻两个区间的间隔不超过区间头大小时合并，省掉一个区间头
+#define PATCH_RUN_MERGE_GAP ((2 * sizeof(uint32_t)) / sizeof(Instruction))
+
+// ============================================================================
+// 序列化缓冲区
+// ============================================================================
+
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} PatchBuffer;
+
+/**
+ * @brief 追加数据
+ */
+static bool buf_write(PatchBuffer* buf, const void* data, size_t len) {
+    if (buf->size + len > buf->capacity) {
+        size_t capacity = buf->capacity ? buf->capacity : 1024;
+        while (capacity < buf->size + len) {
+            capacity *= 2;
+        }
+        uint8_t* grown = (uint8_t*)mmgr_realloc(buf->data, capacity);
+        if (!grown) return false;
+        buf->data = grown;
+        buf->capacity = capacity;
+    }
+    if (len > 0) {
+        memcpy(buf->data + buf->size, data, len);
+    }
+    buf->size += len;
+    return true;
+}
+
+/**
+ * @brief 追加 32 位整数
+ */
+static bool buf_write_u32(PatchBuffer* buf, uint32_t value) {
+    return buf_write(buf, &value, sizeof(value));
+}
+
+/**
+ * @brief 追加带长度（含 '\0'）的字符串，NULL 写为空串
+ */
+static bool buf_write_str(PatchBuffer* buf, const char* str) {
+    if (!str) str = "";
+    uint32_t len = (uint32_t)strlen(str) + 1;
+    return buf_write_u32(buf, len) && buf_write(buf, str, len);
+}
+
+// ============================================================================
+// 读取器
+// ============================================================================
+
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+} PatchReader;
+
+/**
+ * @brief 取出 len 字节，越界返回 NULL
+ */
+static const uint8_t* rd_take(PatchReader* rd, size_t len) {
+    if (len > rd->size - rd->pos) return NULL;
+    const uint8_t* p = rd->data + rd->pos;
+    rd->pos += len;
+    return p;
+}
+
+/**
+ * @brief 复制出 len 字节
+ */
+static bool rd_read(PatchReader* rd, void* out, size_t len) {
+    const uint8_t* p = rd_take(rd, len);
+    if (!p) return false;
+    memcpy(out, p, len);
+    return true;
+}
+
+/**
+ * @brief 读取带长度的字符串（须以 '\0' 结尾）
+ */
+static const char* rd_str(PatchReader* rd) {
+    uint32_t len;
+    if (!rd_read(rd, &len, sizeof(len)) || len == 0) return NULL;
+    const char* str = (const char*)rd_take(rd, len);
+    if (!str || str[len - 1] != '\0') return NULL;
+    return str;
+}
+
+/**
+ * @brief 读取一条常量记录（读取失败返回 false）
+ */
+static bool rd_constant(PatchReader* rd, Constant* out) {
+    uint32_t type;
+    if (!rd_read(rd, &type, sizeof(type))) return false;
+    out->type = (ConstantType)type;
+    switch (out->type) {
+        case CONST_INT:
+            return rd_read(rd, &out->int_val, sizeof(out->int_val));
+        case CONST_REAL:
+            return rd_read(rd, &out->real_val, sizeof(out->real_val));
+        case CONST_BOOL: {
+            uint8_t b;
+            if (!rd_read(rd, &b, sizeof(b))) return false;
+            out->bool_val = b != 0;
+            return true;
+        }
+        case CONST_STRING:
+            out->string_val = (char*)rd_str(rd);
+            return out->string_val != NULL;
+        default:
+            return false;
+    }
+}
+
+// ============================================================================
+// 代码段重定位（生成与应用共用，保证两侧得到相同的重定位结果）
+// ============================================================================
+
+#define PATCH_UNMAPPED UINT32_MAX
+
+/**
+ * @brief 比较两个可能为 NULL 的字符串
+ */
+static bool name_equal(const char* a, const char* b) {
+    if (!a || !b) return a == b;
+    return strcmp(a, b) == 0;
+}
+
+/**
+ * @brief 由代码段和常量复制区间推出的基准→目标映射
+ */
+typedef struct {
+    const BytecodeModule* base;
+    const PatchSegment* segments;
+    uint32_t segment_count;
+    uint32_t* address_map;          // 基准地址 → 目标地址（含末尾地址）
+    uint32_t* segment_of;           // 基准地址所在的代码段
+    uint32_t* const_map;            // 基准常量下标 → 目标常量下标
+    uint32_t* function_map;         // 基准函数下标 → 同名目标函数下标
+} PatchReloc;
+
+/**
+ * @brief 释放重定位映射
+ */
+static void reloc_free(PatchReloc* r) {
+    if (r->address_map) mmgr_free(r->address_map);
+    if (r->segment_of) mmgr_free(r->segment_of);
+    if (r->const_map) mmgr_free(r->const_map);
+    if (r->function_map) mmgr_free(r->function_map);
+    memset(r, 0, sizeof(*r));
+}
+
+/**
+ * @brief 建立重定位映射（代码段和常量复制区间的来源须已确认落在基准模块内）
+ *
+ * 段内地址先映射；段末地址（跳到函数末尾或循环出口）在没有别的段占用时
+ * 映射到目标段末。同一基准常量被复制到多处时，操作数取最后一处。
+ * 目标函数名由 target_names 给出，用于重定位 CALL 的函数下标。
+ */
+static bool reloc_init(PatchReloc* r, const BytecodeModule* base,
+                       const PatchSegment* segments, uint32_t segment_count,
+                       const PatchCopy* const_copies, uint32_t const_copy_count,
+                       const char* const* target_names, uint32_t target_function_count) {
+    memset(r, 0, sizeof(*r));
+    r->base = base;
+    r->segments = segments;
+    r->segment_count = segment_count;
+
+    uint32_t count = base->instruction_count;
+    r->address_map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (count + 1));
+    r->segment_of = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (count + 1));
+    r->const_map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (base->const_count + 1));
+    r->function_map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (base->function_count + 1));
+    if (!r->address_map || !r->segment_of || !r->const_map || !r->function_map) {
+        reloc_free(r);
+        return false;
+    }
+
+    for (uint32_t i = 0; i <= count; i++) {
+        r->address_map[i] = PATCH_UNMAPPED;
+        r->segment_of[i] = PATCH_UNMAPPED;
+    }
+    for (uint32_t s = 0; s < segment_count; s++) {
+        const PatchSegment* seg = &segments[s];
+        for (uint32_t k = 0; k < seg->count; k++) {
+            r->address_map[seg->base_offset + k] = seg->target_offset + k;
+            r->segment_of[seg->base_offset + k] = s;
+        }
+    }
+    for (uint32_t s = 0; s < segment_count; s++) {
+        const PatchSegment* seg = &segments[s];
+        if (r->address_map[seg->base_offset + seg->count] == PATCH_UNMAPPED) {
+            r->address_map[seg->base_offset + seg->count] = seg->target_offset + seg->count;
+        }
+    }
+
+    for (uint32_t i = 0; i < base->const_count; i++) {
+        r->const_map[i] = PATCH_UNMAPPED;
+    }
+    for (uint32_t c = 0; c < const_copy_count; c++) {
+        const PatchCopy* copy = &const_copies[c];
+        for (uint32_t k = 0; k < copy->count; k++) {
+            r->const_map[copy->source_offset + k] = copy->target_offset + k;
+        }
+    }
+
+    for (uint32_t i = 0; i < base->function_count; i++) {
+        const char* name = base->functions[i].name;
+        r->function_map[i] = PATCH_UNMAPPED;
+        if (i < target_function_count && name_equal(target_names[i], name)) {
+            r->function_map[i] = i;
+            continue;
+        }
+        for (uint32_t j = 0; j < target_function_count; j++) {
+            if (name_equal(target_names[j], name)) {
+                r->function_map[i] = j;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 重定位一个基准代码地址（不在任何代码段内的地址保持不变）
+ */
+static uint32_t reloc_address(const PatchReloc* r, uint32_t addr) {
+    if (addr <= r->base->instruction_count && r->address_map[addr] != PATCH_UNMAPPED) {
+        return r->address_map[addr];
+    }
+    return addr;
+}
+
+/**
+ * @brief 重定位一条基准指令的操作数
+ */
+static Instruction reloc_instruction(const PatchReloc* r, Instruction in) {
+    uint32_t mapped = PATCH_UNMAPPED;
+    switch (in.opcode) {
+        case OP_JMP:
+        case OP_JZ:
+        case OP_JNZ:
+            mapped = reloc_address(r, in.operand);
+            break;
+        case OP_PUSH:
+        case OP_IO_READ:
+        case OP_IO_WRITE:
+            if (in.operand < r->base->const_count) mapped = r->const_map[in.operand];
+            break;
+        case OP_CALL:
+        case OP_CALL_EXT:
+            if (in.operand < r->base->function_count) mapped = r->function_map[in.operand];
+            break;
+        default:
+            break;
+    }
+    if (mapped != PATCH_UNMAPPED && mapped <= UINT16_MAX) {
+        in.operand = (uint16_t)mapped;
+    }
+    return in;
+}
+
+/**
+ * @brief 把各代码段的基准指令重定位到目标位置，covered 标记写到的目标地址
+ */
+static void reloc_code(const PatchReloc* r, Instruction* out, bool* covered) {
+    for (uint32_t s = 0; s < r->segment_count; s++) {
+        const PatchSegment* seg = &r->segments[s];
+        for (uint32_t k = 0; k < seg->count; k++) {
+            out[seg->target_offset + k] = reloc_instruction(r, r->base->instructions[seg->base_offset + k]);
+            if (covered) covered[seg->target_offset + k] = true;
+        }
+    }
+}
+
+/**
+ * @brief 重定位基准行号表：落在代码段内的条目随段平移，返回条目数
+ *
+ * out 至少要能容纳基准行号条目数。
+ */
+static uint32_t reloc_lines(const PatchReloc* r, LineEntry* out) {
+    const LineTable* table = &r->base->line_table;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < table->count; i++) {
+        uint32_t pc = table->entries[i].pc;
+        if (pc >= r->base->instruction_count || r->segment_of[pc] == PATCH_UNMAPPED) continue;
+        const PatchSegment* seg = &r->segments[r->segment_of[pc]];
+        out[n].pc = pc - seg->base_offset + seg->target_offset;
+        out[n].line = table->entries[i].line + seg->line_delta;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief 重定位基准跳转表中的目标地址
+ */
+static void reloc_switches(const PatchReloc* r, SwitchTable* tables, SwitchCase* cases) {
+    const BytecodeModule* base = r->base;
+    for (uint32_t i = 0; i < base->switch_table_count; i++) {
+        tables[i] = base->switch_tables[i];
+        tables[i].default_target = reloc_address(r, tables[i].default_target);
+    }
+    for (uint32_t i = 0; i < base->switch_case_count; i++) {
+        cases[i] = base->switch_cases[i];
+        cases[i].target = reloc_address(r, cases[i].target);
+    }
+}
+
+/**
+ * @brief 重定位基准 FOR 循环描述符中的地址
+ */
+static void reloc_for_loops(const PatchReloc* r, ForLoop* loops) {
+    const BytecodeModule* base = r->base;
+    for (uint32_t i = 0; i < base->for_loop_count; i++) {
+        loops[i] = base->for_loops[i];
+        loops[i].body = reloc_address(r, loops[i].body);
+        loops[i].exit = reloc_address(r, loops[i].exit);
+    }
+}
+
+/**
+ * @brief 从 i 起第一个不在复制区间内的下标（复制区间按目标下标递增，cursor 随之前进）
+ */
+static uint32_t skip_copied(const PatchCopy* copies, uint32_t count, uint32_t* cursor, uint32_t i) {
+    while (*cursor < count && copies[*cursor].target_offset <= i) {
+        const PatchCopy* copy = &copies[(*cursor)++];
+        if (i < copy->target_offset + copy->count) i = copy->target_offset + copy->count;
+    }
+    return i;
+}
+
+// ============================================================================
+// 补丁生成
+// ============================================================================
+
+/**
+ * @brief 比较两个常量是否相同（实数按位比较）
+ */
+static bool constant_equal(const Constant* a, const Constant* b) {
+    if (a->type != b->type) return false;
+    switch (a->type) {
+        case CONST_INT:
+            return a->int_val == b->int_val;
+        case CONST_REAL:
+            return memcmp(&a->real_val, &b->real_val, sizeof(double)) == 0;
+        case CONST_BOOL:
+            return a->bool_val == b->bool_val;
+        case CONST_STRING:
+            if (!a->string_val || !b->string_val) return a->string_val == b->string_val;
+            return strcmp(a->string_val, b->string_val) == 0;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 比较两个函数表条目（基准条目的入口地址取重定位后的 base_address）
+ */
+static bool function_equal(const FunctionEntry* a, uint32_t base_address, const FunctionEntry* b) {
+    if (!name_equal(a->name, b->name) || base_address != b->address ||
+        a->param_count != b->param_count || a->local_count != b->local_count ||
+        a->return_type != b->return_type) {
+        return false;
+    }
+    if (a->param_count <= 0) return true;
+    if (!a->param_types || !b->param_types) return a->param_types == b->param_types;
+    return memcmp(a->param_types, b->param_types, sizeof(DataType) * a->param_count) == 0;
+}
+
+/**
+ * @brief 代码区域：函数入口到下一个函数入口（第一个函数之前的代码名字为 NULL）
+ */
+typedef struct {
+    const char* name;
+    uint32_t start;
+    uint32_t end;
+    uint32_t index;
+} CodeRegion;
+
+/**
+ * @brief 按起始地址排序代码区域（同一地址按函数下标）
+ */
+static int compare_region_start(const void* a, const void* b) {
+    const CodeRegion* ra = (const CodeRegion*)a;
+    const CodeRegion* rb = (const CodeRegion*)b;
+    if (ra->start != rb->start) return (ra->start > rb->start) - (ra->start < rb->start);
+    return (ra->index > rb->index) - (ra->index < rb->index);
+}
+
+/**
+ * @brief 按函数入口把代码划分为区域
+ */
+static CodeRegion* collect_regions(const BytecodeModule* module, uint32_t* out_count) {
+    CodeRegion* regions = (CodeRegion*)mmgr_alloc(sizeof(CodeRegion) * (module->function_count + 1));
+    if (!regions) return NULL;
+
+    // 首项留给第一个函数之前的代码
+    uint32_t n = 1;
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        const FunctionEntry* func = &module->functions[i];
+        if (func->address < module->instruction_count) {
+            regions[n].name = func->name;
+            regions[n].start = func->address;
+            regions[n].index = i;
+            n++;
+        }
+    }
+    qsort(regions + 1, n - 1, sizeof(CodeRegion), compare_region_start);
+
+    uint32_t kept = 1;
+    for (uint32_t i = 1; i < n; i++) {
+        if (kept == 1 || regions[i].start != regions[kept - 1].start) {
+            regions[kept++] = regions[i];
+        }
+    }
+    n = kept;
+
+    uint32_t first = 0;
+    if (n == 1 || regions[1].start > 0) {
+        regions[0].name = NULL;
+        regions[0].start = 0;
+        regions[0].index = UINT32_MAX;
+    } else {
+        first = 1;
+    }
+    for (uint32_t i = first; i < n; i++) {
+        regions[i].end = i + 1 < n ? regions[i + 1].start : module->instruction_count;
+    }
+
+    if (first > 0) memmove(regions, regions + 1, sizeof(CodeRegion) * (n - 1));
+    *out_count = n - first;
+    return regions;
+}
+
+/**
+ * @brief 追加一个代码段，与前一段首尾相接且行号偏移相同时合并
+ */
+static void add_segment(const BytecodeModule* base, const BytecodeModule* target,
+                        PatchSegment* segments, uint32_t* count,
+                        uint32_t target_offset, uint32_t base_offset, uint32_t length) {
+    if (length == 0) return;
+
+    int32_t base_line = bytecode_line_for_pc(base, base_offset);
+    int32_t target_line = bytecode_line_for_pc(target, target_offset);
+    int32_t line_delta = (base_line > 0 && target_line > 0) ? target_line - base_line : 0;
+
+    if (*count > 0) {
+        PatchSegment* prev = &segments[*count - 1];
+        if (prev->target_offset + prev->count == target_offset &&
+            prev->base_offset + prev->count == base_offset && prev->line_delta == line_delta) {
+            prev->count += length;
+            return;
+        }
+    }
+    PatchSegment* seg = &segments[(*count)++];
+    seg->target_offset = target_offset;
+    seg->base_offset = base_offset;
+    seg->count = length;
+    seg->line_delta = line_delta;
+}
+
+/**
+ * @brief 操作码和标志相同（操作数由重定位处理）
+ */
+static bool same_shape(const Instruction* a, const Instruction* b) {
+    return a->opcode == b->opcode && a->flags == b->flags;
+}
+
+/**
+ * @brief 按函数名对齐基准与目标的代码区域，每对区域取相同形状的前缀和后缀作为代码段
+ */
+static PatchSegment* build_segments(const BytecodeModule* base, const BytecodeModule* target,
+                                    uint32_t* segment_count) {
+    uint32_t base_n = 0, target_n = 0;
+    CodeRegion* base_regions = collect_regions(base, &base_n);
+    CodeRegion* target_regions = collect_regions(target, &target_n);
+    PatchSegment* segments = (PatchSegment*)mmgr_alloc(sizeof(PatchSegment) * (2 * target_n + 1));
+    if (!base_regions || !target_regions || !segments) {
+        if (base_regions) mmgr_free(base_regions);
+        if (target_regions) mmgr_free(target_regions);
+        if (segments) mmgr_free(segments);
+        return NULL;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < target_n; i++) {
+        const CodeRegion* t = &target_regions[i];
+        const CodeRegion* b = NULL;
+        if (i < base_n && name_equal(base_regions[i].name, t->name)) {
+            b = &base_regions[i];
+        }
+        for (uint32_t j = 0; !b && j < base_n; j++) {
+            if (name_equal(base_regions[j].name, t->name)) b = &base_regions[j];
+        }
+        if (!b) continue;
+
+        uint32_t t_len = t->end - t->start;
+        uint32_t b_len = b->end - b->start;
+        uint32_t common = t_len < b_len ? t_len : b_len;
+        uint32_t prefix = 0;
+        while (prefix < common &&
+               same_shape(&base->instructions[b->start + prefix], &target->instructions[t->start + prefix])) {
+            prefix++;
+        }
+        uint32_t suffix = 0;
+        while (suffix < common - prefix &&
+               same_shape(&base->instructions[b->end - 1 - suffix], &target->instructions[t->end - 1 - suffix])) {
+            suffix++;
+        }
+        add_segment(base, target, segments, &count, t->start, b->start, prefix);
+        add_segment(base, target, segments, &count, t->end - suffix, b->end - suffix, suffix);
+    }
+
+    mmgr_free(base_regions);
+    mmgr_free(target_regions);
+    *segment_count = count;
+    return segments;
+}
+
+/**
+ * @brief 目标指令是否已由代码段重定位得到
+ */
+static bool same_as_relocated(const BytecodeModule* target, const Instruction* relocated,
+                              const bool* covered, uint32_t pc) {
+    return covered[pc] && memcmp(&relocated[pc], &target->instructions[pc], sizeof(Instruction)) == 0;
+}
+
+/**
+ * @brief 写入指令区间：目标中未被代码段覆盖、或重定位结果与目标不同的指令
+ */
+static bool write_code_runs(const BytecodeModule* target, const Instruction* relocated,
+                            const bool* covered, PatchBuffer* buf, uint32_t* run_count) {
+    uint32_t count = target->instruction_count;
+    uint32_t pc = 0;
+    *run_count = 0;
+
+    while (pc < count) {
+        // 跳过相同的指令
+        while (pc < count && same_as_relocated(target, relocated, covered, pc)) {
+            pc++;
+        }
+        if (pc >= count) break;
+
+        // 向后延伸，短间隔并入同一区间
+        uint32_t start = pc;
+        uint32_t end = pc + 1;
+        uint32_t same = 0;
+        for (pc = end; pc < count; pc++) {
+            if (same_as_relocated(target, relocated, covered, pc)) {
+                if (++same > PATCH_RUN_MERGE_GAP) break;
+            } else {
+                same = 0;
+                end = pc + 1;
+            }
+        }
+        pc = end;
+
+        uint32_t run = end - start;
+        if (!buf_write_u32(buf, start) || !buf_write_u32(buf, run) ||
+            !buf_write(buf, &target->instructions[start], sizeof(Instruction) * run)) {
+            return false;
+        }
+        (*run_count)++;
+    }
+    return true;
+}
+
+/**
+ * @brief 写入一条常量记录
+ */
+static bool write_constant(PatchBuffer* buf, const Constant* constant) {
+    if (!buf_write_u32(buf, (uint32_t)constant->type)) return false;
+    switch (constant->type) {
+        case CONST_INT:
+            return buf_write(buf, &constant->int_val, sizeof(constant->int_val));
+        case CONST_REAL:
+            return buf_write(buf, &constant->real_val, sizeof(constant->real_val));
+        case CONST_BOOL: {
+            uint8_t b = constant->bool_val ? 1 : 0;
+            return buf_write(buf, &b, sizeof(b));
+        }
+        case CONST_STRING:
+            return buf_write_str(buf, constant->string_val);
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 写入一个函数条目
+ */
+static bool write_function(PatchBuffer* buf, uint32_t index, const FunctionEntry* func) {
+    if (!buf_write_u32(buf, index) || !buf_write_str(buf, func->name) ||
+        !buf_write_u32(buf, func->address) ||
+        !buf_write(buf, &func->param_count, sizeof(func->param_count)) ||
+        !buf_write(buf, &func->local_count, sizeof(func->local_count)) ||
+        !buf_write(buf, &func->return_type, sizeof(func->return_type))) {
+        return false;
+    }
+    for (int32_t i = 0; i < func->param_count; i++) {
+        // 与 .stbc 函数表段一致：没有参数类型时写入 TYPE_INT
+        DataType type = func->param_types ? func->param_types[i] : TYPE_INT;
+        if (!buf_write(buf, &type, sizeof(type))) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 判断库依赖是否变化
+ */
+static bool library_deps_changed(const BytecodeModule* base, const BytecodeModule* target) {
+    if (base->library_dep_count != target->library_dep_count) return true;
+    for (uint32_t i = 0; i < target->library_dep_count; i++) {
+        if (!name_equal(base->library_deps[i], target->library_deps[i])) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 判断跳转表重定位后是否与目标不同
+ */
+static bool switch_tables_changed(const PatchReloc* r, const BytecodeModule* target, bool* out_changed) {
+    const BytecodeModule* base = r->base;
+    if (base->switch_table_count != target->switch_table_count ||
+        base->switch_case_count != target->switch_case_count) {
+        *out_changed = true;
+        return true;
+    }
+    SwitchTable* tables = (SwitchTable*)mmgr_alloc(sizeof(SwitchTable) * (base->switch_table_count + 1));
+    SwitchCase* cases = (SwitchCase*)mmgr_alloc(sizeof(SwitchCase) * (base->switch_case_count + 1));
+    if (!tables || !cases) {
+        if (tables) mmgr_free(tables);
+        if (cases) mmgr_free(cases);
+        return false;
+    }
+    reloc_switches(r, tables, cases);
+    *out_changed = (target->switch_table_count > 0 &&
+                    memcmp(tables, target->switch_tables,
+                           sizeof(SwitchTable) * target->switch_table_count) != 0) ||
+                   (target->switch_case_count > 0 &&
+                    memcmp(cases, target->switch_cases,
+                           sizeof(SwitchCase) * target->switch_case_count) != 0);
+    mmgr_free(tables);
+    mmgr_free(cases);
+    return true;
+}
+
+/**
+ * @brief 判断 FOR 循环描述符重定位后是否与目标不同
+ */
+static bool for_loops_changed(const PatchReloc* r, const BytecodeModule* target, bool* out_changed) {
+    const BytecodeModule* base = r->base;
+    if (base->for_loop_count != target->for_loop_count) {
+        *out_changed = true;
+        return true;
+    }
+    ForLoop* loops = (ForLoop*)mmgr_alloc(sizeof(ForLoop) * (base->for_loop_count + 1));
+    if (!loops) return false;
+    reloc_for_loops(r, loops);
+    *out_changed = target->for_loop_count > 0 &&
+                   memcmp(loops, target->for_loops, sizeof(ForLoop) * target->for_loop_count) != 0;
+    mmgr_free(loops);
+    return true;
+}
+
+/**
+ * @brief 判断数组描述符是否变化
+ */
+static bool array_bounds_changed(const BytecodeModule* base, const BytecodeModule* target) {
+    if (base->array_bound_count != target->array_bound_count) return true;
+    return target->array_bound_count > 0 &&
+           memcmp(base->array_bounds, target->array_bounds,
+                  sizeof(ArrayBound) * target->array_bound_count) != 0;
+}
+
+/**
+ * @brief 追加目标下标 target_offset 取自来源 source_offset 的复制，与前一区间首尾相接时合并
+ */
+static void add_copy(PatchCopy* copies, uint32_t* count, uint32_t target_offset, uint32_t source_offset) {
+    if (*count > 0) {
+        PatchCopy* prev = &copies[*count - 1];
+        if (prev->target_offset + prev->count == target_offset &&
+            prev->source_offset + prev->count == source_offset) {
+            prev->count++;
+            return;
+        }
+    }
+    PatchCopy* copy = &copies[(*count)++];
+    copy->target_offset = target_offset;
+    copy->source_offset = source_offset;
+    copy->count = 1;
+}
+
+/**
+ * @brief 常量的值摘要与下标，用于按值查找基准常量
+ */
+typedef struct {
+    uint32_t hash;
+    uint32_t index;
+} ConstantKey;
+
+/**
+ * @brief 按摘要排序（同一摘要按下标）
+ */
+static int compare_constant_key(const void* a, const void* b) {
+    const ConstantKey* ka = (const ConstantKey*)a;
+    const ConstantKey* kb = (const ConstantKey*)b;
+    if (ka->hash != kb->hash) return (ka->hash > kb->hash) - (ka->hash < kb->hash);
+    return (ka->index > kb->index) - (ka->index < kb->index);
+}
+
+/**
+ * @brief 为目标常量池找出取自基准的复制区间
+ *
+ * 优先延续上一个区间，否则按值查找下标最小的相同基准常量；
+ * 常量池中间插入或删除常量时，两侧仍各自成一个区间。
+ */
+static PatchCopy* match_constants(const BytecodeModule* base, const BytecodeModule* target,
+                                  uint32_t* copy_count) {
+    PatchCopy* copies = (PatchCopy*)mmgr_alloc(sizeof(PatchCopy) * (target->const_count + 1));
+    ConstantKey* keys = (ConstantKey*)mmgr_alloc(sizeof(ConstantKey) * (base->const_count + 1));
+    if (!copies || !keys) {
+        if (copies) mmgr_free(copies);
+        if (keys) mmgr_free(keys);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < base->const_count; i++) {
+        keys[i].hash = bytecode_digest_constant(0, &base->constants[i]);
+        keys[i].index = i;
+    }
+    qsort(keys, base->const_count, sizeof(ConstantKey), compare_constant_key);
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < target->const_count; i++) {
+        const Constant* constant = &target->constants[i];
+        if (n > 0) {
+            const PatchCopy* prev = &copies[n - 1];
+            uint32_t next = prev->source_offset + prev->count;
+            if (prev->target_offset + prev->count == i && next < base->const_count &&
+                constant_equal(&base->constants[next], constant)) {
+                add_copy(copies, &n, i, next);
+                continue;
+            }
+        }
+
+        uint32_t hash = bytecode_digest_constant(0, constant);
+        uint32_t lo = 0, hi = base->const_count;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (keys[mid].hash < hash) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        for (; lo < base->const_count && keys[lo].hash == hash; lo++) {
+            if (constant_equal(&base->constants[keys[lo].index], constant)) {
+                add_copy(copies, &n, i, keys[lo].index);
+                break;
+            }
+        }
+    }
+    mmgr_free(keys);
+    *copy_count = n;
+    return copies;
+}
+
+/**
+ * @brief 为目标行号表找出取自重定位后基准行号表的复制区间（两表都按地址递增）
+ */
+static PatchCopy* match_lines(const LineEntry* source, uint32_t source_count,
+                              const LineEntry* target, uint32_t target_count, uint32_t* copy_count) {
+    PatchCopy* copies = (PatchCopy*)mmgr_alloc(sizeof(PatchCopy) * (target_count + 1));
+    if (!copies) return NULL;
+
+    uint32_t n = 0;
+    uint32_t j = 0;
+    for (uint32_t i = 0; i < target_count; i++) {
+        if (n > 0) {
+            const PatchCopy* prev = &copies[n - 1];
+            uint32_t next = prev->source_offset + prev->count;
+            if (prev->target_offset + prev->count == i && next < source_count &&
+                memcmp(&source[next], &target[i], sizeof(LineEntry)) == 0) {
+                add_copy(copies, &n, i, next);
+                j = next + 1;
+                continue;
+            }
+        }
+        while (j < source_count && source[j].pc < target[i].pc) {
+            j++;
+        }
+        for (uint32_t k = j; k < source_count && source[k].pc == target[i].pc; k++) {
+            if (memcmp(&source[k], &target[i], sizeof(LineEntry)) == 0) {
+                add_copy(copies, &n, i, k);
+                j = k + 1;
+                break;
+            }
+        }
+    }
+    *copy_count = n;
+    return copies;
+}
+
+/**
+ * @brief 写入复制区间
+ */
+static bool write_copies(PatchBuffer* buf, const PatchCopy* copies, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (!buf_write_u32(buf, copies[i].target_offset) || !buf_write_u32(buf, copies[i].source_offset) ||
+            !buf_write_u32(buf, copies[i].count)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 生成补丁
+ */
+BytecodePatch* bytecode_patch_create(BytecodeModule* base, BytecodeModule* target) {
+    if (!base || !target) return NULL;
+
+    // 全局变量布局与行号表在调试段中
+    bytecode_load_debug_info(base);
+    bytecode_load_debug_info(target);
+
+    STBPHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = STBP_MAGIC;
+    header.version_major = STBP_VERSION_MAJOR;
+    header.version_minor = STBP_VERSION_MINOR;
+    header.base_digest = bytecode_compute_digest(base);
+    header.target_digest = bytecode_compute_digest(target);
+    header.entry_point = target->entry_point;
+    header.instruction_count = target->instruction_count;
+    header.const_count = target->const_count;
+    header.function_count = target->function_count;
+    header.global_count = target->global_count;
+    header.line_count = target->line_table.count;
+
+    PatchBuffer buf = {0};
+    PatchReloc reloc;
+    memset(&reloc, 0, sizeof(reloc));
+    PatchSegment* segments = NULL;
+    PatchCopy* const_copies = NULL;
+    PatchCopy* line_copies = NULL;
+    const char** names = NULL;
+    Instruction* relocated = NULL;
+    bool* covered = NULL;
+    LineEntry* lines = NULL;
+    bool ok = false;
+
+    // 常量复制区间、代码段与重定位映射
+    const_copies = match_constants(base, target, &header.const_copy_count);
+    segments = build_segments(base, target, &header.segment_count);
+    names = (const char**)mmgr_alloc(sizeof(char*) * (target->function_count + 1));
+    relocated = (Instruction*)mmgr_alloc(sizeof(Instruction) * (target->instruction_count + 1));
+    covered = (bool*)mmgr_calloc(sizeof(bool) * (target->instruction_count + 1));
+    lines = (LineEntry*)mmgr_alloc(sizeof(LineEntry) * (base->line_table.count + 1));
+    if (!const_copies || !segments || !names || !relocated || !covered || !lines) goto done;
+    for (uint32_t i = 0; i < target->function_count; i++) {
+        names[i] = target->functions[i].name;
+    }
+    if (!reloc_init(&reloc, base, segments, header.segment_count,
+                    const_copies, header.const_copy_count, names, target->function_count)) {
+        goto done;
+    }
+    reloc_code(&reloc, relocated, covered);
+
+    // 行号表：与重定位后的基准条目比较
+    uint32_t relocated_lines = reloc_lines(&reloc, lines);
+    line_copies = match_lines(lines, relocated_lines, target->line_table.entries, header.line_count,
+                              &header.line_copy_count);
+    if (!line_copies) goto done;
+
+    if (!buf_write(&buf, &header, sizeof(header))) goto done;
+
+    // 1. 代码段
+    for (uint32_t i = 0; i < header.segment_count; i++) {
+        const PatchSegment* seg = &segments[i];
+        if (!buf_write_u32(&buf, seg->target_offset) || !buf_write_u32(&buf, seg->base_offset) ||
+            !buf_write_u32(&buf, seg->count) ||
+            !buf_write(&buf, &seg->line_delta, sizeof(seg->line_delta))) {
+            goto done;
+        }
+    }
+
+    // 2. 指令区间
+    if (!write_code_runs(target, relocated, covered, &buf, &header.run_count)) goto done;
+
+    // 3. 常量：复制区间，其余逐条给出
+    if (!write_copies(&buf, const_copies, header.const_copy_count)) goto done;
+    uint32_t cursor = 0;
+    for (uint32_t i = skip_copied(const_copies, header.const_copy_count, &cursor, 0); i < target->const_count;
+         i = skip_copied(const_copies, header.const_copy_count, &cursor, i + 1)) {
+        if (!write_constant(&buf, &target->constants[i])) goto done;
+    }
+
+    // 4. 函数表：入口地址按代码段重定位后比较
+    for (uint32_t i = 0; i < target->function_count; i++) {
+        if (i < base->function_count &&
+            function_equal(&base->functions[i], reloc_address(&reloc, base->functions[i].address),
+                           &target->functions[i])) {
+            continue;
+        }
+        if (!write_function(&buf, i, &target->functions[i])) goto done;
+        header.function_record_count++;
+    }
+
+    // 5. 全局变量布局
+    if (target->globals_info) {
+        header.flags |= STBP_FLAG_GLOBAL_INFO;
+        for (uint32_t i = 0; i < target->global_count; i++) {
+            const GlobalEntry* entry = &target->globals_info[i];
+            if (base->globals_info && i < base->global_count &&
+                name_equal(base->globals_info[i].name, entry->name) &&
+                base->globals_info[i].type == entry->type) {
+                continue;
+            }
+            if (!buf_write_u32(&buf, i) || !buf_write_str(&buf, entry->name) ||
+                !buf_write(&buf, &entry->type, sizeof(entry->type))) {
+                goto done;
+            }
+            header.global_record_count++;
+        }
+    }
+
+    // 6. 库依赖
+    if (library_deps_changed(base, target)) {
+        header.flags |= STBP_FLAG_LIBDEPS;
+        if (!buf_write_u32(&buf, target->library_dep_count)) goto done;
+        for (uint32_t i = 0; i < target->library_dep_count; i++) {
+            if (!buf_write_str(&buf, target->library_deps[i])) goto done;
+        }
+    }
+
+    // 7. 行号表：复制区间，其余逐条给出
+    if (!write_copies(&buf, line_copies, header.line_copy_count)) goto done;
+    cursor = 0;
+    for (uint32_t i = skip_copied(line_copies, header.line_copy_count, &cursor, 0); i < header.line_count;
+         i = skip_copied(line_copies, header.line_copy_count, &cursor, i + 1)) {
+        if (!buf_write(&buf, &target->line_table.entries[i], sizeof(LineEntry))) goto done;
+    }
+
+    // 8. 跳转表
+    bool changed = false;
+    if (!switch_tables_changed(&reloc, target, &changed)) goto done;
+    if (changed) {
+        header.flags |= STBP_FLAG_SWITCHES;
+        if (!buf_write_u32(&buf, target->switch_table_count) ||
+            !buf_write_u32(&buf, target->switch_case_count) ||
+            !buf_write(&buf, target->switch_tables, sizeof(SwitchTable) * target->switch_table_count) ||
+            !buf_write(&buf, target->switch_cases, sizeof(SwitchCase) * target->switch_case_count)) {
+            goto done;
+        }
+    }
+
+    // 9. FOR 循环描述符
+    if (!for_loops_changed(&reloc, target, &changed)) goto done;
+    if (changed) {
+        header.flags |= STBP_FLAG_LOOPS;
+        if (!buf_write_u32(&buf, target->for_loop_count) ||
+            !buf_write(&buf, target->for_loops, sizeof(ForLoop) * target->for_loop_count)) {
+            goto done;
+        }
+    }
+
+    // 10. 数组描述符
+    if (array_bounds_changed(base, target)) {
+        header.flags |= STBP_FLAG_ARRAYS;
+        if (!buf_write_u32(&buf, target->array_bound_count) ||
+            !buf_write(&buf, target->array_bounds, sizeof(ArrayBound) * target->array_bound_count)) {
+            goto done;
+        }
+    }
+
+    header.payload_size = (uint32_t)(buf.size - sizeof(header));
+    header.payload_checksum = crc32_compute(buf.data + sizeof(header), header.payload_size);
+    memcpy(buf.data, &header, sizeof(header));
+    ok = true;
+
+done:
+    reloc_free(&reloc);
+    if (segments) mmgr_free(segments);
+    if (const_copies) mmgr_free(const_copies);
+    if (line_copies) mmgr_free(line_copies);
+    if (names) mmgr_free(names);
+    if (relocated) mmgr_free(relocated);
+    if (covered) mmgr_free(covered);
+    if (lines) mmgr_free(lines);
+    if (!ok) {
+        if (buf.data) mmgr_free(buf.data);
+        return NULL;
+    }
+    return bytecode_patch_load_from_memory(buf.data, buf.size, true);
+}
+
+// ============================================================================
+// 补丁解析
+// ============================================================================
+
+/**
+ * @brief 分配视图数组（count 为 0 时返回 true 且不分配）
+ */
+static bool alloc_views(void** out, size_t elem_size, uint32_t count) {
+    *out = NULL;
+    if (count == 0) return true;
+    *out = mmgr_calloc(elem_size * count);
+    return *out != NULL;
+}
+
+/**
+ * @brief 读取复制区间：目标下标递增、互不重叠且落在 total 内，输出复制的条目总数
+ *
+ * 来源范围在检查时对照基准模块。
+ */
+static bool rd_copies(PatchReader* rd, PatchCopy* copies, uint32_t count, uint32_t total, uint32_t* copied) {
+    uint32_t next = 0;
+    *copied = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        PatchCopy* copy = &copies[i];
+        if (!rd_read(rd, &copy->target_offset, sizeof(copy->target_offset)) ||
+            !rd_read(rd, &copy->source_offset, sizeof(copy->source_offset)) ||
+            !rd_read(rd, &copy->count, sizeof(copy->count)) ||
+            copy->count == 0 || copy->target_offset < next ||
+            copy->target_offset > total || copy->count > total - copy->target_offset) {
+            return false;
+        }
+        next = copy->target_offset + copy->count;
+        *copied += copy->count;
+    }
+    return true;
+}
+
+/**
+ * @brief 解析补丁内容，建立各视图
+ */
+static bool parse_patch(BytecodePatch* patch) {
+    if (patch->size < sizeof(STBPHeader)) return false;
+
+    STBPHeader* h = &patch->header;
+    memcpy(h, patch->data, sizeof(*h));
+    if (h->magic != STBP_MAGIC || h->version_major != STBP_VERSION_MAJOR ||
+        h->payload_size != patch->size - sizeof(STBPHeader)) {
+        return false;
+    }
+
+    PatchReader rd = { patch->data + sizeof(STBPHeader), h->payload_size, 0 };
+    if (crc32_compute(rd.data, rd.size) != h->payload_checksum) {
+        fprintf(stderr, "Error: Checksum mismatch in bytecode patch\n");
+        return false;
+    }
+
+    // 各条目至少占 8 字节，先按剩余长度粗略限制个数，避免超大分配
+    if (h->segment_count > rd.size / 8 || h->run_count > rd.size / 8 ||
+        h->function_record_count > rd.size / 8 || h->global_record_count > rd.size / 8 ||
+        h->const_copy_count > rd.size / 8 || h->line_copy_count > rd.size / 8) {
+        return false;
+    }
+    if (!alloc_views((void**)&patch->segments, sizeof(PatchSegment), h->segment_count) ||
+        !alloc_views((void**)&patch->runs, sizeof(PatchCodeRun), h->run_count) ||
+        !alloc_views((void**)&patch->const_copies, sizeof(PatchCopy), h->const_copy_count) ||
+        !alloc_views((void**)&patch->line_copies, sizeof(PatchCopy), h->line_copy_count) ||
+        !alloc_views((void**)&patch->functions, sizeof(PatchFunction), h->function_record_count) ||
+        !alloc_views((void**)&patch->globals, sizeof(PatchGlobal), h->global_record_count)) {
+        return false;
+    }
+
+    // 代码段：目标地址递增、互不重叠且落在目标代码内（基准范围在检查时对照模块）
+    uint32_t next_pc = 0;
+    for (uint32_t i = 0; i < h->segment_count; i++) {
+        PatchSegment* seg = &patch->segments[i];
+        if (!rd_read(&rd, &seg->target_offset, sizeof(seg->target_offset)) ||
+            !rd_read(&rd, &seg->base_offset, sizeof(seg->base_offset)) ||
+            !rd_read(&rd, &seg->count, sizeof(seg->count)) ||
+            !rd_read(&rd, &seg->line_delta, sizeof(seg->line_delta)) ||
+            seg->count == 0 || seg->target_offset < next_pc ||
+            seg->target_offset > h->instruction_count ||
+            seg->count > h->instruction_count - seg->target_offset) {
+            return false;
+        }
+        next_pc = seg->target_offset + seg->count;
+    }
+
+    // 指令区间：按地址递增、互不重叠且落在目标代码内
+    next_pc = 0;
+    for (uint32_t i = 0; i < h->run_count; i++) {
+        PatchCodeRun* run = &patch->runs[i];
+        if (!rd_read(&rd, &run->offset, sizeof(run->offset)) ||
+            !rd_read(&rd, &run->count, sizeof(run->count)) ||
+            run->count == 0 || run->offset < next_pc ||
+            run->offset > h->instruction_count ||
+            run->count > h->instruction_count - run->offset) {
+            return false;
+        }
+        run->code = rd_take(&rd, sizeof(Instruction) * (size_t)run->count);
+        if (!run->code) return false;
+        next_pc = run->offset + run->count;
+    }
+
+    // 常量复制区间与新常量
+    uint32_t copied = 0;
+    if (!rd_copies(&rd, patch->const_copies, h->const_copy_count, h->const_count, &copied)) return false;
+    patch->new_const_count = h->const_count - copied;
+    patch->constants = rd.data + rd.pos;
+    for (uint32_t i = 0; i < patch->new_const_count; i++) {
+        Constant constant;
+        if (!rd_constant(&rd, &constant)) return false;
+    }
+    patch->constants_size = (size_t)(rd.data + rd.pos - patch->constants);
+
+    // 函数条目：下标递增
+    for (uint32_t i = 0; i < h->function_record_count; i++) {
+        PatchFunction* func = &patch->functions[i];
+        if (!rd_read(&rd, &func->index, sizeof(func->index)) ||
+            func->index >= h->function_count ||
+            (i > 0 && func->index <= patch->functions[i - 1].index)) {
+            return false;
+        }
+        func->name = rd_str(&rd);
+        if (!func->name ||
+            !rd_read(&rd, &func->address, sizeof(func->address)) ||
+            !rd_read(&rd, &func->param_count, sizeof(func->param_count)) ||
+            !rd_read(&rd, &func->local_count, sizeof(func->local_count)) ||
+            !rd_read(&rd, &func->return_type, sizeof(func->return_type))) {
+            return false;
+        }
+        // 可变参数函数的参数个数为负，不带参数类型
+        size_t type_count = func->param_count > 0 ? (size_t)func->param_count : 0;
+        func->param_types = rd_take(&rd, sizeof(DataType) * type_count);
+        if (!func->param_types) return false;
+    }
+
+    // 全局变量条目：下标递增
+    for (uint32_t i = 0; i < h->global_record_count; i++) {
+        PatchGlobal* global = &patch->globals[i];
+        if (!(h->flags & STBP_FLAG_GLOBAL_INFO) ||
+            !rd_read(&rd, &global->index, sizeof(global->index)) ||
+            global->index >= h->global_count ||
+            (i > 0 && global->index <= patch->globals[i - 1].index)) {
+            return false;
+        }
+        global->name = rd_str(&rd);
+        if (!global->name || !rd_read(&rd, &global->type, sizeof(global->type))) return false;
+    }
+
+    // 库依赖
+    if (h->flags & STBP_FLAG_LIBDEPS) {
+        if (!rd_read(&rd, &patch->library_dep_count, sizeof(patch->library_dep_count))) return false;
+        patch->library_deps = rd.data + rd.pos;
+        for (uint32_t i = 0; i < patch->library_dep_count; i++) {
+            if (!rd_str(&rd)) return false;
+        }
+        patch->library_deps_size = (size_t)(rd.data + rd.pos - patch->library_deps);
+    }
+
+    // 行号复制区间与新行号条目
+    if (!rd_copies(&rd, patch->line_copies, h->line_copy_count, h->line_count, &copied)) return false;
+    patch->new_line_count = h->line_count - copied;
+    patch->lines = rd_take(&rd, sizeof(LineEntry) * (size_t)patch->new_line_count);
+    if (!patch->lines) return false;
+
+    // 跳转表
+    if (h->flags & STBP_FLAG_SWITCHES) {
+        if (!rd_read(&rd, &patch->switch_table_count, sizeof(patch->switch_table_count)) ||
+            !rd_read(&rd, &patch->switch_case_count, sizeof(patch->switch_case_count))) {
+            return false;
+        }
+        patch->switch_tables = rd_take(&rd, sizeof(SwitchTable) * (size_t)patch->switch_table_count);
+        patch->switch_cases = rd_take(&rd, sizeof(SwitchCase) * (size_t)patch->switch_case_count);
+        if (!patch->switch_tables || !patch->switch_cases) return false;
+        for (uint32_t i = 0; i < patch->switch_table_count; i++) {
+            SwitchTable table;
+            memcpy(&table, patch->switch_tables + sizeof(SwitchTable) * i, sizeof(table));
+            if (table.kind > SWITCH_SORTED ||
+                (uint64_t)table.first + table.count > patch->switch_case_count) {
+                return false;
+            }
+        }
+    }
+
+    // FOR 循环描述符
+    if (h->flags & STBP_FLAG_LOOPS) {
+        if (!rd_read(&rd, &patch->for_loop_count, sizeof(patch->for_loop_count))) return false;
+        patch->for_loops = rd_take(&rd, sizeof(ForLoop) * (size_t)patch->for_loop_count);
+        if (!patch->for_loops) return false;
+        for (uint32_t i = 0; i < patch->for_loop_count; i++) {
+            ForLoop loop;
+            memcpy(&loop, patch->for_loops + sizeof(ForLoop) * i, sizeof(loop));
+            if (loop.step == 0) return false;
+        }
+    }
+
+    // 数组描述符
+    if (h->flags & STBP_FLAG_ARRAYS) {
+        if (!rd_read(&rd, &patch->array_bound_count, sizeof(patch->array_bound_count))) return false;
+        patch->array_bounds = rd_take(&rd, sizeof(ArrayBound) * (size_t)patch->array_bound_count);
+        if (!patch->array_bounds) return false;
+        for (uint32_t i = 0; i < patch->array_bound_count; i++) {
+            ArrayBound bound;
+            memcpy(&bound, patch->array_bounds + sizeof(ArrayBound) * i, sizeof(bound));
+            if (bound.length == 0 || (int64_t)bound.lower + bound.length - 1 > INT32_MAX) return false;
+        }
+    }
+
+    return rd.pos == rd.size;
+}
+
+/**
+ * @brief 从内存解析补丁
+ */
+BytecodePatch* bytecode_patch_load_from_memory(void* data, size_t size, bool take_ownership) {
+    if (!data || size == 0) return NULL;
+
+    uint8_t* bytes = (uint8_t*)data;
+    if (!take_ownership) {
+        bytes = (uint8_t*)mmgr_alloc(size);
+        if (!bytes) return NULL;
+        memcpy(bytes, data, size);
+    }
+
+    BytecodePatch* patch = (BytecodePatch*)mmgr_calloc(sizeof(BytecodePatch));
+    if (!patch) {
+        mmgr_free(bytes);
+        return NULL;
+    }
+    patch->data = bytes;
+    patch->size = size;
+
+    if (!parse_patch(patch)) {
+        bytecode_patch_free(patch);
+        return NULL;
+    }
+    return patch;
+}
+
+/**
+ * @brief 从文件加载补丁
+ */
+BytecodePatch* bytecode_patch_load(const char* filename) {
+    if (!filename) return NULL;
+
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) return NULL;
+
+    uint8_t* data = NULL;
+    long size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) size = ftell(fp);
+    if (size > 0 && fseek(fp, 0, SEEK_SET) == 0) {
+        data = (uint8_t*)mmgr_alloc((size_t)size);
+        if (data && fread(data, 1, (size_t)size, fp) != (size_t)size) {
+            mmgr_free(data);
+            data = NULL;
+        }
+    }
+    fclose(fp);
+
+    if (!data) return NULL;
+    return bytecode_patch_load_from_memory(data, (size_t)size, true);
+}
+
+/**
+ * @brief 保存补丁
+ */
+ErrorCode bytecode_patch_save(const BytecodePatch* patch, const char* filename) {
+    if (!patch || !filename) return ERR_INVALID_ARGUMENT;
+
+    FILE* fp = fopen(filename, "wb");
+    if (!fp) return ERR_FILE_IO;
+
+    bool ok = fwrite(patch->data, 1, patch->size, fp) == patch->size;
+    if (fclose(fp) != 0) ok = false;
+    return ok ? OK : ERR_FILE_IO;
+}
+
+/**
+ * @brief 释放补丁
+ */
+void bytecode_patch_free(BytecodePatch* patch) {
+    if (!patch) return;
+    if (patch->segments) mmgr_free(patch->segments);
+    if (patch->runs) mmgr_free(patch->runs);
+    if (patch->const_copies) mmgr_free(patch->const_copies);
+    if (patch->line_copies) mmgr_free(patch->line_copies);
+    if (patch->functions) mmgr_free(patch->functions);
+    if (patch->globals) mmgr_free(patch->globals);
+    if (patch->data) mmgr_free(patch->data);
+    mmgr_free(patch);
+}
+
+// ============================================================================
+// 补丁应用
+// ============================================================================
+
+/**
+ * @brief 在临时缓冲中构造的目标模块内容（检查时算摘要，应用时整体换入）
+ */
+typedef struct {
+    PatchReloc reloc;
+    const char** names;             // 目标函数名（指向补丁或基准）
+    Instruction* code;              // 目标指令
+    Constant* constants;            // 目标常量（浅拷贝，字符串指向补丁或基准）
+    LineEntry* lines;               // 目标行号表（只在应用时构造）
+    SwitchTable* switch_tables;
+    SwitchCase* switch_cases;
+    ForLoop* for_loops;
+} PatchStage;
+
+/**
+ * @brief 释放构造缓冲（已换入模块的数组须先置空）
+ */
+static void stage_free(PatchStage* stage) {
+    reloc_free(&stage->reloc);
+    if (stage->names) mmgr_free(stage->names);
+    if (stage->code) mmgr_free(stage->code);
+    if (stage->constants) mmgr_free(stage->constants);
+    if (stage->lines) mmgr_free(stage->lines);
+    if (stage->switch_tables) mmgr_free(stage->switch_tables);
+    if (stage->switch_cases) mmgr_free(stage->switch_cases);
+    if (stage->for_loops) mmgr_free(stage->for_loops);
+    memset(stage, 0, sizeof(*stage));
+}
+
+/**
+ * @brief 按补丁构造目标模块的指令、常量、跳转表和 FOR 循环描述符
+ *
+ * 调用前须已确认补丁能补齐各表（bytecode_patch_check 的规模检查）。
+ * 目标中有指令既不在代码段内、也不在指令区间内时返回 ERR_INVALID_BYTECODE。
+ */
+static ErrorCode stage_build(const BytecodePatch* patch, const BytecodeModule* module, PatchStage* stage) {
+    const STBPHeader* h = &patch->header;
+    memset(stage, 0, sizeof(*stage));
+
+    stage->names = (const char**)mmgr_alloc(sizeof(char*) * (h->function_count + 1));
+    if (!stage->names) return ERR_OUT_OF_MEMORY;
+    uint32_t r = 0;
+    for (uint32_t i = 0; i < h->function_count; i++) {
+        if (r < h->function_record_count && patch->functions[r].index == i) {
+            stage->names[i] = patch->functions[r++].name;
+        } else {
+            stage->names[i] = module->functions[i].name;
+        }
+    }
+    if (!reloc_init(&stage->reloc, module, patch->segments, h->segment_count,
+                    patch->const_copies, h->const_copy_count, stage->names, h->function_count)) {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    // 指令：代码段重定位后叠加指令区间
+    stage->code = (Instruction*)mmgr_alloc(sizeof(Instruction) * (h->instruction_count + 1));
+    bool* covered = (bool*)mmgr_calloc(sizeof(bool) * (h->instruction_count + 1));
+    if (!stage->code || !covered) {
+        if (covered) mmgr_free(covered);
+        return ERR_OUT_OF_MEMORY;
+    }
+    reloc_code(&stage->reloc, stage->code, covered);
+    for (uint32_t i = 0; i < h->run_count; i++) {
+        const PatchCodeRun* run = &patch->runs[i];
+        memcpy(&stage->code[run->offset], run->code, sizeof(Instruction) * run->count);
+        memset(&covered[run->offset], 1, sizeof(bool) * run->count);
+    }
+    bool complete = true;
+    for (uint32_t pc = 0; pc < h->instruction_count && complete; pc++) {
+        complete = covered[pc];
+    }
+    mmgr_free(covered);
+    if (!complete) return ERR_INVALID_BYTECODE;
+
+    // 常量：复制区间取基准，其余依次取补丁
+    stage->constants = (Constant*)mmgr_alloc(sizeof(Constant) * (h->const_count + 1));
+    if (!stage->constants) return ERR_OUT_OF_MEMORY;
+    for (uint32_t c = 0; c < h->const_copy_count; c++) {
+        const PatchCopy* copy = &patch->const_copies[c];
+        memcpy(&stage->constants[copy->target_offset], &module->constants[copy->source_offset],
+               sizeof(Constant) * copy->count);
+    }
+    PatchReader rd = { patch->constants, patch->constants_size, 0 };
+    uint32_t cursor = 0;
+    for (uint32_t i = skip_copied(patch->const_copies, h->const_copy_count, &cursor, 0); i < h->const_count;
+         i = skip_copied(patch->const_copies, h->const_copy_count, &cursor, i + 1)) {
+        rd_constant(&rd, &stage->constants[i]);
+    }
+
+    // 跳转表、FOR 循环描述符：补丁整体给出，或重定位基准
+    bool switches = (h->flags & STBP_FLAG_SWITCHES) != 0;
+    uint32_t table_count = switches ? patch->switch_table_count : module->switch_table_count;
+    uint32_t case_count = switches ? patch->switch_case_count : module->switch_case_count;
+    if (table_count > 0) {
+        stage->switch_tables = (SwitchTable*)mmgr_alloc(sizeof(SwitchTable) * table_count);
+        if (!stage->switch_tables) return ERR_OUT_OF_MEMORY;
+    }
+    if (case_count > 0) {
+        stage->switch_cases = (SwitchCase*)mmgr_alloc(sizeof(SwitchCase) * case_count);
+        if (!stage->switch_cases) return ERR_OUT_OF_MEMORY;
+    }
+    if (switches) {
+        if (table_count > 0) memcpy(stage->switch_tables, patch->switch_tables, sizeof(SwitchTable) * table_count);
+        if (case_count > 0) memcpy(stage->switch_cases, patch->switch_cases, sizeof(SwitchCase) * case_count);
+    } else {
+        reloc_switches(&stage->reloc, stage->switch_tables, stage->switch_cases);
+    }
+
+    bool loops = (h->flags & STBP_FLAG_LOOPS) != 0;
+    uint32_t loop_count = loops ? patch->for_loop_count : module->for_loop_count;
+    if (loop_count > 0) {
+        stage->for_loops = (ForLoop*)mmgr_alloc(sizeof(ForLoop) * loop_count);
+        if (!stage->for_loops) return ERR_OUT_OF_MEMORY;
+        if (loops) {
+            memcpy(stage->for_loops, patch->for_loops, sizeof(ForLoop) * loop_count);
+        } else {
+            reloc_for_loops(&stage->reloc, stage->for_loops);
+        }
+    }
+    return OK;
+}
+
+/**
+ * @brief 构造目标行号表（基准调试段须已载入）
+ */
+static ErrorCode stage_lines(const BytecodePatch* patch, const BytecodeModule* module, PatchStage* stage) {
+    const STBPHeader* h = &patch->header;
+    LineEntry* relocated = (LineEntry*)mmgr_alloc(sizeof(LineEntry) * (module->line_table.count + 1));
+    stage->lines = (LineEntry*)mmgr_alloc(sizeof(LineEntry) * (h->line_count + 1));
+    if (!relocated || !stage->lines) {
+        if (relocated) mmgr_free(relocated);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    // 复制区间的来源须落在重定位结果内
+    uint32_t n = reloc_lines(&stage->reloc, relocated);
+    for (uint32_t c = 0; c < h->line_copy_count; c++) {
+        const PatchCopy* copy = &patch->line_copies[c];
+        if (copy->source_offset > n || copy->count > n - copy->source_offset) {
+            mmgr_free(relocated);
+            return ERR_INVALID_BYTECODE;
+        }
+        memcpy(&stage->lines[copy->target_offset], &relocated[copy->source_offset],
+               sizeof(LineEntry) * copy->count);
+    }
+    uint32_t cursor = 0;
+    uint32_t next = 0;
+    for (uint32_t i = skip_copied(patch->line_copies, h->line_copy_count, &cursor, 0); i < h->line_count;
+         i = skip_copied(patch->line_copies, h->line_copy_count, &cursor, i + 1)) {
+        memcpy(&stage->lines[i], patch->lines + sizeof(LineEntry) * next++, sizeof(LineEntry));
+    }
+    mmgr_free(relocated);
+    return OK;
+}
+
+/**
+ * @brief 构造结果的内容摘要（顺序与 bytecode_compute_digest 相同）
+ */
+static uint32_t stage_digest(const BytecodePatch* patch, const BytecodeModule* module,
+                             const PatchStage* stage) {
+    const STBPHeader* h = &patch->header;
+    bool deps = (h->flags & STBP_FLAG_LIBDEPS) != 0;
+    bool switches = (h->flags & STBP_FLAG_SWITCHES) != 0;
+    bool loops = (h->flags & STBP_FLAG_LOOPS) != 0;
+    bool arrays = (h->flags & STBP_FLAG_ARRAYS) != 0;
+
+    STBCDigestShape shape = {
+        h->entry_point, h->instruction_count, h->const_count, h->function_count, h->global_count,
+        deps ? patch->library_dep_count : module->library_dep_count,
+        switches ? patch->switch_table_count : module->switch_table_count,
+        switches ? patch->switch_case_count : module->switch_case_count,
+        loops ? patch->for_loop_count : module->for_loop_count,
+        arrays ? patch->array_bound_count : module->array_bound_count
+    };
+    uint32_t crc = crc32_update(0, &shape, sizeof(shape));
+    if (h->instruction_count > 0) {
+        crc = crc32_update(crc, stage->code, sizeof(Instruction) * h->instruction_count);
+    }
+    for (uint32_t i = 0; i < h->const_count; i++) {
+        crc = bytecode_digest_constant(crc, &stage->constants[i]);
+    }
+
+    // 函数表：有条目的下标取补丁，其余沿用基准并重定位入口地址
+    uint32_t r = 0;
+    for (uint32_t i = 0; i < h->function_count; i++) {
+        if (r < h->function_record_count && patch->functions[r].index == i) {
+            const PatchFunction* rec = &patch->functions[r++];
+            crc = bytecode_digest_function(crc, rec->name, rec->address, rec->param_count,
+                                           rec->local_count, rec->return_type, rec->param_types);
+        } else {
+            const FunctionEntry* func = &module->functions[i];
+            crc = bytecode_digest_function(crc, func->name, reloc_address(&stage->reloc, func->address),
+                                           func->param_count, func->local_count, func->return_type,
+                                           func->param_types);
+        }
+    }
+
+    if (deps) {
+        PatchReader deps_rd = { patch->library_deps, patch->library_deps_size, 0 };
+        for (uint32_t i = 0; i < patch->library_dep_count; i++) {
+            crc = bytecode_digest_string(crc, rd_str(&deps_rd));
+        }
+    } else {
+        for (uint32_t i = 0; i < module->library_dep_count; i++) {
+            crc = bytecode_digest_string(crc, module->library_deps[i]);
+        }
+    }
+
+    const void* bounds = arrays ? (const void*)patch->array_bounds : (const void*)module->array_bounds;
+    if (shape.switch_table_count > 0) {
+        crc = crc32_update(crc, stage->switch_tables, sizeof(SwitchTable) * shape.switch_table_count);
+    }
+    if (shape.switch_case_count > 0) {
+        crc = crc32_update(crc, stage->switch_cases, sizeof(SwitchCase) * shape.switch_case_count);
+    }
+    if (shape.for_loop_count > 0) {
+        crc = crc32_update(crc, stage->for_loops, sizeof(ForLoop) * shape.for_loop_count);
+    }
+    if (shape.array_bound_count > 0) {
+        crc = crc32_update(crc, bounds, sizeof(ArrayBound) * shape.array_bound_count);
+    }
+    return crc;
+}
+
+/**
+ * @brief 检查补丁的规模能否由基准补齐
+ */
+static bool patch_fits(const BytecodePatch* patch, const BytecodeModule* module) {
+    const STBPHeader* h = &patch->header;
+    if (bytecode_compute_digest(module) != h->base_digest) return false;
+
+    // 常量复制区间的来源落在基准常量池内
+    for (uint32_t i = 0; i < h->const_copy_count; i++) {
+        const PatchCopy* copy = &patch->const_copies[i];
+        if (copy->source_offset > module->const_count ||
+            copy->count > module->const_count - copy->source_offset) {
+            return false;
+        }
+    }
+
+    // 代码段的基准范围落在基准代码内
+    for (uint32_t i = 0; i < h->segment_count; i++) {
+        const PatchSegment* seg = &patch->segments[i];
+        if (seg->base_offset > module->instruction_count ||
+            seg->count > module->instruction_count - seg->base_offset) {
+            return false;
+        }
+    }
+
+    // 超出基准长度的函数、全局变量都必须由补丁给出
+    uint32_t expected = module->function_count;
+    for (uint32_t i = 0; i < h->function_record_count; i++) {
+        if (patch->functions[i].index == expected) expected++;
+    }
+    if (expected < h->function_count) return false;
+
+    if (h->flags & STBP_FLAG_GLOBAL_INFO) {
+        expected = module->globals_info ? module->global_count : 0;
+        for (uint32_t i = 0; i < h->global_record_count; i++) {
+            if (patch->globals[i].index == expected) expected++;
+        }
+        if (expected < h->global_count) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 构造目标内容并核对目标摘要
+ */
+static ErrorCode stage_verified(const BytecodePatch* patch, const BytecodeModule* module, PatchStage* stage) {
+    memset(stage, 0, sizeof(*stage));
+    if (!patch_fits(patch, module)) return ERR_INVALID_BYTECODE;
+
+    ErrorCode err = stage_build(patch, module, stage);
+    if (err == OK && stage_digest(patch, module, stage) != patch->header.target_digest) {
+        err = ERR_INVALID_BYTECODE;
+    }
+    if (err != OK) stage_free(stage);
+    return err;
+}
+
+/**
+ * @brief 检查补丁能否应用
+ */
+ErrorCode bytecode_patch_check(const BytecodePatch* patch, const BytecodeModule* module) {
+    if (!patch || !module) return ERR_INVALID_ARGUMENT;
+
+    // 叠加结果须是补丁的目标模块；在修改模块之前发现不符
+    PatchStage stage;
+    ErrorCode err = stage_verified(patch, module, &stage);
+    if (err == OK) stage_free(&stage);
+    return err;
+}
+
+/**
+ * @brief 释放函数表条目持有的内存
+ */
+static void free_function_entry(FunctionEntry* func) {
+    if (func->name) mmgr_free(func->name);
+    if (func->param_types) mmgr_free(func->param_types);
+    func->name = NULL;
+    func->param_types = NULL;
+}
+
+/**
+ * @brief 按补丁调整全局变量元数据
+ */
+static bool apply_globals(BytecodeModule* module, const BytecodePatch* patch) {
+    const STBPHeader* h = &patch->header;
+
+    if (!(h->flags & STBP_FLAG_GLOBAL_INFO)) {
+        // 目标模块没有元数据
+        if (module->globals_info) {
+            for (uint32_t i = 0; i < module->global_count; i++) {
+                if (module->globals_info[i].name) mmgr_free(module->globals_info[i].name);
+            }
+            mmgr_free(module->globals_info);
+            module->globals_info = NULL;
+        }
+        module->global_count = h->global_count;
+        return true;
+    }
+
+    uint32_t old_count = module->globals_info ? module->global_count : 0;
+    if (h->global_count != old_count) {
+        for (uint32_t i = h->global_count; i < old_count; i++) {
+            if (module->globals_info[i].name) mmgr_free(module->globals_info[i].name);
+        }
+        GlobalEntry* info = NULL;
+        if (h->global_count > 0) {
+            info = (GlobalEntry*)mmgr_realloc(module->globals_info, sizeof(GlobalEntry) * h->global_count);
+            if (!info) return false;
+            if (h->global_count > old_count) {
+                memset(info + old_count, 0, sizeof(GlobalEntry) * (h->global_count - old_count));
+            }
+        } else if (module->globals_info) {
+            mmgr_free(module->globals_info);
+        }
+        module->globals_info = info;
+    }
+    module->global_count = h->global_count;
+
+    for (uint32_t i = 0; i < h->global_record_count; i++) {
+        const PatchGlobal* rec = &patch->globals[i];
+        GlobalEntry* entry = &module->globals_info[rec->index];
+        if (entry->name) mmgr_free(entry->name);
+        entry->name = mmgr_strdup(rec->name);
+        entry->type = rec->type;
+        entry->index = (int32_t)rec->index;
+    }
+    return true;
+}
+
+/**
+ * @brief 原地应用补丁
+ */
+ErrorCode bytecode_patch_apply(BytecodeModule* module, const BytecodePatch* patch) {
+    if (!patch || !module) return ERR_INVALID_ARGUMENT;
+
+    // 行号表随代码段重定位，基准的调试段须先载入
+    if (bytecode_load_debug_info(module) != OK) return ERR_INVALID_BYTECODE;
+
+    const STBPHeader* h = &patch->header;
+
+    // 先在临时缓冲中构造并核对，再预留容量；之后的修改只剩字符串复制可能失败
+    PatchStage stage;
+    ErrorCode err = stage_verified(patch, module, &stage);
+    if (err != OK) return err;
+    err = stage_lines(patch, module, &stage);
+    if (err != OK) {
+        stage_free(&stage);
+        return err;
+    }
+    bool* moved = (bool*)mmgr_calloc(sizeof(bool) * (module->const_count + 1));
+    if (!moved) {
+        stage_free(&stage);
+        return ERR_OUT_OF_MEMORY;
+    }
+    ArrayBound* array_bounds = NULL;
+    if ((h->flags & STBP_FLAG_ARRAYS) && patch->array_bound_count > 0) {
+        array_bounds = (ArrayBound*)mmgr_alloc(sizeof(ArrayBound) * patch->array_bound_count);
+        if (!array_bounds) {
+            mmgr_free(moved);
+            stage_free(&stage);
+            return ERR_OUT_OF_MEMORY;
+        }
+    }
+    char** deps = NULL;
+    if ((h->flags & STBP_FLAG_LIBDEPS) && patch->library_dep_count > 0) {
+        deps = (char**)mmgr_calloc(sizeof(char*) * patch->library_dep_count);
+        if (!deps) {
+            if (array_bounds) mmgr_free(array_bounds);
+            mmgr_free(moved);
+            stage_free(&stage);
+            return ERR_OUT_OF_MEMORY;
+        }
+    }
+    if (!bytecode_reserve_instructions(module, h->instruction_count) ||
+        !bytecode_reserve_constants(module, h->const_count) ||
+        !bytecode_reserve_functions(module, h->function_count) ||
+        !apply_globals(module, patch)) {
+        if (deps) mmgr_free(deps);
+        if (array_bounds) mmgr_free(array_bounds);
+        mmgr_free(moved);
+        stage_free(&stage);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    // 1. 指令
+    if (h->instruction_count > 0) {
+        memcpy(module->instructions, stage.code, sizeof(Instruction) * h->instruction_count);
+    }
+    module->instruction_count = h->instruction_count;
+    module->entry_point = h->entry_point;
+
+    // 2. 常量：复制的基准字符串第一次使用时转移所有权，再次使用和补丁给出的字符串复制一份；
+    //    截断后整体放回，未被复制的基准字符串在截断时释放
+    for (uint32_t c = 0; c < h->const_copy_count; c++) {
+        const PatchCopy* copy = &patch->const_copies[c];
+        for (uint32_t k = 0; k < copy->count; k++) {
+            Constant* constant = &stage.constants[copy->target_offset + k];
+            if (constant->type != CONST_STRING || !constant->string_val ||
+                bytecode_in_image(module, constant->string_val)) {
+                continue;
+            }
+            if (moved[copy->source_offset + k]) {
+                constant->string_val = mmgr_strdup(constant->string_val);
+            } else {
+                moved[copy->source_offset + k] = true;
+            }
+        }
+    }
+    uint32_t cursor = 0;
+    for (uint32_t i = skip_copied(patch->const_copies, h->const_copy_count, &cursor, 0); i < h->const_count;
+         i = skip_copied(patch->const_copies, h->const_copy_count, &cursor, i + 1)) {
+        if (stage.constants[i].type == CONST_STRING) {
+            stage.constants[i].string_val = mmgr_strdup(stage.constants[i].string_val);
+        }
+    }
+    for (uint32_t i = 0; i < module->const_count; i++) {
+        if (moved[i]) module->constants[i].string_val = NULL;
+    }
+    mmgr_free(moved);
+    bytecode_truncate_constants(module, 0);
+    if (h->const_count > 0) {
+        memcpy(module->constants, stage.constants, sizeof(Constant) * h->const_count);
+    }
+    module->const_count = h->const_count;
+
+    // 3. 函数表：沿用的条目重定位入口地址，其余取补丁
+    uint32_t kept = module->function_count < h->function_count ? module->function_count : h->function_count;
+    for (uint32_t i = 0; i < kept; i++) {
+        module->functions[i].address = reloc_address(&stage.reloc, module->functions[i].address);
+    }
+    for (uint32_t i = h->function_count; i < module->function_count; i++) {
+        free_function_entry(&module->functions[i]);
+    }
+    for (uint32_t i = 0; i < h->function_record_count; i++) {
+        const PatchFunction* rec = &patch->functions[i];
+        FunctionEntry* func = &module->functions[rec->index];
+        if (rec->index < module->function_count) {
+            free_function_entry(func);
+        }
+        func->name = mmgr_strdup(rec->name);
+        func->address = rec->address;
+        func->param_count = rec->param_count;
+        func->local_count = rec->local_count;
+        func->return_type = rec->return_type;
+        func->param_types = NULL;
+        if (rec->param_count > 0) {
+            func->param_types = (DataType*)mmgr_alloc(sizeof(DataType) * rec->param_count);
+            if (func->param_types) {
+                memcpy(func->param_types, rec->param_types, sizeof(DataType) * rec->param_count);
+            }
+        }
+    }
+    module->function_count = h->function_count;
+
+    // 4. 库依赖
+    if (h->flags & STBP_FLAG_LIBDEPS) {
+        for (uint32_t i = 0; i < module->library_dep_count; i++) {
+            if (module->library_deps[i]) mmgr_free(module->library_deps[i]);
+        }
+        if (module->library_deps) mmgr_free(module->library_deps);
+
+        PatchReader deps_rd = { patch->library_deps, patch->library_deps_size, 0 };
+        for (uint32_t i = 0; i < patch->library_dep_count; i++) {
+            deps[i] = mmgr_strdup(rd_str(&deps_rd));
+        }
+        module->library_deps = deps;
+        module->library_dep_count = patch->library_dep_count;
+    }
+
+    // 5. 行号表
+    LineTable* table = &module->line_table;
+    if (table->entries) mmgr_free(table->entries);
+    if (table->by_line) mmgr_free(table->by_line);
+    table->entries = h->line_count > 0 ? stage.lines : NULL;
+    table->count = h->line_count;
+    table->capacity = h->line_count;
+    table->by_line = NULL;
+    if (h->line_count > 0) stage.lines = NULL;
+
+    // 6. 跳转表、FOR 循环描述符（构造时已按补丁给出或重定位）
+    if (h->flags & STBP_FLAG_SWITCHES) {
+        module->switch_table_count = patch->switch_table_count;
+        module->switch_case_count = patch->switch_case_count;
+    }
+    if (module->switch_tables) mmgr_free(module->switch_tables);
+    if (module->switch_cases) mmgr_free(module->switch_cases);
+    module->switch_tables = stage.switch_tables;
+    module->switch_cases = stage.switch_cases;
+    if (!module->switch_tables) module->switch_table_count = 0;
+    if (!module->switch_cases) module->switch_case_count = 0;
+    stage.switch_tables = NULL;
+    stage.switch_cases = NULL;
+
+    if (h->flags & STBP_FLAG_LOOPS) {
+        module->for_loop_count = patch->for_loop_count;
+    }
+    if (module->for_loops) mmgr_free(module->for_loops);
+    module->for_loops = stage.for_loops;
+    if (!module->for_loops) module->for_loop_count = 0;
+    stage.for_loops = NULL;
+
+    // 7. 数组描述符
+    if (h->flags & STBP_FLAG_ARRAYS) {
+        if (module->array_bounds) mmgr_free(module->array_bounds);
+        if (array_bounds) {
+            memcpy(array_bounds, patch->array_bounds, sizeof(ArrayBound) * patch->array_bound_count);
+        }
+        module->array_bounds = array_bounds;
+        module->array_bound_count = array_bounds ? patch->array_bound_count : 0;
+    }
+
+    stage_free(&stage);
+    return OK;
+}
+
+/**
+ * @brief 判断补丁是否修改了 [start, end) 内的指令
+ */
+bool bytecode_patch_touches(const BytecodePatch* patch, uint32_t start, uint32_t end) {
+    if (!patch) return false;
+
+    // 区间按地址递增，二分找到第一个结束位置在 start 之后的区间
+    uint32_t lo = 0, hi = patch->header.run_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        const PatchCodeRun* run = &patch->runs[mid];
+        if (run->offset + run->count <= start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < patch->header.run_count && patch->runs[lo].offset < end;
+}
+
+/**
+ * @brief 判断基准 [start, end) 内的代码是否改变或平移
+ */
+bool bytecode_patch_moves_range(const BytecodePatch* patch, uint32_t start, uint32_t end) {
+    if (!patch) return true;
+    if (start >= end) return false;
+
+    for (uint32_t i = 0; i < patch->header.segment_count; i++) {
+        const PatchSegment* seg = &patch->segments[i];
+        if (start < seg->base_offset || start >= seg->base_offset + seg->count) continue;
+        if (seg->target_offset != seg->base_offset || end > seg->base_offset + seg->count) {
+            return true;
+        }
+        return bytecode_patch_touches(patch, start, end);
+    }
+    return true;
+}
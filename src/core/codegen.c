@@ -7,9 +7,12 @@
  * 2. 跳转使用回填技术
  * 3. 变量访问通过符号表获取偏移量
  * 4. 函数调用需要参数入栈
+ * 5. --ir 时改由中间表示（ir.h）构建 SSA 后降级生成
  */
 
 #include "codegen.h"
+#include "ir.h"
+#include "optimizer.h"
 #include "mmgr.h"
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,6 +20,7 @@
 
 // 前向声明
 static ErrorCode generate_program(CodeGenContext* ctx, ASTNode* program);
+static ErrorCode generate_via_ir(CodeGenContext* ctx, ASTNode* program);
 static ErrorCode generate_var_decls(CodeGenContext* ctx, ASTNode* var_decls);
 static ErrorCode generate_binary_op(CodeGenContext* ctx, ASTNode* node);
 static ErrorCode generate_unary_op(CodeGenContext* ctx, ASTNode* node);
@@ -33,6 +37,7 @@ static ErrorCode generate_repeat(CodeGenContext* ctx, ASTNode* node, LoopContext
 static ErrorCode generate_case(CodeGenContext* ctx, ASTNode* node, LoopContext* loop_ctx);
 static ErrorCode generate_return(CodeGenContext* ctx, ASTNode* node);
 static ErrorCode generate_block(CodeGenContext* ctx, ASTNode* stmts, LoopContext* loop_ctx);
+static ErrorCode generate_statement(CodeGenContext* ctx, ASTNode* stmt, LoopContext* loop_ctx);
 
 /**
  * @brief 创建代码生成器上下文
@@ -63,37 +68,19 @@ void codegen_free(CodeGenContext* ctx) {
  * @brief 发射一条指令
  */
 int32_t codegen_emit(CodeGenContext* ctx, Opcode opcode, uint16_t operand) {
-    return bytecode_add_instruction(ctx->module, opcode, 0, operand);
+    return codegen_emit_with_flags(ctx, opcode, 0, operand);
 }
 
 /**
  * @brief 发射一条带flags的指令
  */
 int32_t codegen_emit_with_flags(CodeGenContext* ctx, Opcode opcode, uint8_t flags, uint16_t operand) {
-    Instruction instr;
-    instr.opcode = opcode;
-    instr.flags = flags;
-    instr.operand = operand;
-    
-    // 直接添加到指令数组
-    if (ctx->module->instruction_count >= ctx->module->instruction_capacity) {
-        // 扩容
-        size_t new_capacity = ctx->module->instruction_capacity * 2;
-        if (new_capacity == 0) new_capacity = 256;
-        
-        Instruction* new_instructions = (Instruction*)mmgr_realloc(
-            ctx->module->instructions,
-            new_capacity * sizeof(Instruction)
-        );
-        if (!new_instructions) return -1;
-        
-        ctx->module->instructions = new_instructions;
-        ctx->module->instruction_capacity = new_capacity;
-    }
-    
-    int32_t index = ctx->module->instruction_count;
-    ctx->module->instructions[index] = instr;
-    ctx->module->instruction_count++;
+    // 容量按几何增长，由 bytecode_add_instruction 负责扩容；
+    // 已知当前语句行号时同时记入行号表
+    uint32_t index = ctx->current_line > 0
+        ? bytecode_add_instruction_with_line(ctx->module, opcode, flags, operand, ctx->current_line)
+        : bytecode_add_instruction(ctx->module, opcode, flags, operand);
+    if (index == (uint32_t)-1) return -1;
     
     return index;
 }
@@ -175,6 +162,55 @@ void codegen_patch_jump_list(CodeGenContext* ctx, JumpLabel* labels, uint16_t ta
     }
 }
 
+/**
+ * @brief 经中间表示生成：构建 IR，-O 时执行 IR 优化遍，--dump-ir 时打印；
+ *        --ir 或 -O 时由 IR 降级为字节码，否则（只打印）仍由 AST 直接生成
+ *
+ * 只有 -O 而 IR 构建失败（IR 尚不支持的构造）时退回 AST 直接生成。
+ */
+static ErrorCode generate_via_ir(CodeGenContext* ctx, ASTNode* program) {
+    IrModule* ir = NULL;
+    ErrorCode err = ir_build(program, ctx->symtbl, ctx->error_msg, sizeof(ctx->error_msg), &ir);
+    if (err != OK) {
+        if (!ctx->use_ir && !ctx->dump_ir) {
+            ctx->error_msg[0] = '\0';
+            return generate_program(ctx, program);
+        }
+        ctx->error_code = err;
+        return err;
+    }
+    
+    // -O：公共子表达式消除与循环不变量外提
+    if (ctx->optimizer) {
+        err = optimizer_run_ir(ctx->optimizer, ir);
+        if (err != OK) {
+            snprintf(ctx->error_msg, sizeof(ctx->error_msg), "IR optimization failed");
+            ir_module_free(ir);
+            ctx->error_code = err;
+            return err;
+        }
+    }
+    
+    if (ctx->dump_ir) {
+        printf("\n=== 中间表示 ===\n");
+        ir_print_module(ir);
+        printf("\n");
+    }
+    
+    if (ctx->use_ir || ctx->optimizer) {
+        err = codegen_init_globals(ctx);
+        if (err == OK) {
+            err = ir_lower(ir, ctx->module, ctx->symtbl, ctx->error_msg, sizeof(ctx->error_msg));
+        }
+    } else {
+        err = generate_program(ctx, program);
+    }
+    
+    ir_module_free(ir);
+    if (err != OK) ctx->error_code = err;
+    return err;
+}
+
 /**
  * @brief 从AST生成字节码
  */
@@ -190,15 +226,19 @@ ErrorCode codegen_generate(CodeGenContext* ctx, ASTNode* program) {
         return ERR_RUNTIME;
     }
     
-    return generate_program(ctx, program);
+    ErrorCode err = (ctx->use_ir || ctx->dump_ir || ctx->optimizer) ? generate_via_ir(ctx, program)
+                                                                    : generate_program(ctx, program);
+    if (err != OK) return err;
+    
+    // 所有地址确定后再做数组下标的区间分析
+    bytecode_mark_unchecked_arrays(ctx->module);
+    return OK;
 }
 
 /**
- * @brief 生成程序节点
+ * @brief 填充模块的全局变量计数和元数据
  */
-static ErrorCode generate_program(CodeGenContext* ctx, ASTNode* program) {
-    ErrorCode err;
-    
+ErrorCode codegen_init_globals(CodeGenContext* ctx) {
     // 设置模块的全局变量计数（typecheck已定义全局变量，symtbl保存了计数）
     ctx->module->global_count = ctx->symtbl->global_var_count;
     
@@ -216,7 +256,7 @@ static ErrorCode generate_program(CodeGenContext* ctx, ASTNode* program) {
             for (int i = 0; i < SYMBOL_TABLE_SIZE; i++) {
                 Symbol* sym = scope->symbols[i];
                 while (sym) {
-                    if (sym->kind == SYM_VARIABLE && sym->is_global) {
+                    if ((sym->kind == SYM_VARIABLE || sym->kind == SYM_CONSTANT) && sym->is_global) {
                         int32_t idx = sym->index;
                         if (idx >= 0 && idx < (int32_t)ctx->module->global_count) {
                             ctx->module->globals_info[idx].name = mmgr_strdup(sym->name);
@@ -230,6 +270,16 @@ static ErrorCode generate_program(CodeGenContext* ctx, ASTNode* program) {
         }
     }
     
+    return OK;
+}
+
+/**
+ * @brief 生成程序节点
+ */
+static ErrorCode generate_program(CodeGenContext* ctx, ASTNode* program) {
+    ErrorCode err = codegen_init_globals(ctx);
+    if (err != OK) return err;
+    
     // 设置入口点为0（从头开始执行）
     ctx->module->entry_point = 0;
     
@@ -661,12 +711,84 @@ static ErrorCode generate_identifier(CodeGenContext* ctx, ASTNode* node) {
     return OK;
 }
 
+/**
+ * @brief 表达式是否无副作用：不调用函数、不读取外部 I/O 变量
+ *
+ * 数组越界、除零等运行时错误不算副作用，短路跳过时不再报告。
+ */
+static bool expr_side_effect_free(SymbolTable* symtbl, const ASTNode* expr) {
+    if (!expr) return true;
+    
+    switch (expr->type) {
+        case AST_LITERAL:
+            return true;
+        case AST_IDENTIFIER: {
+            Symbol* sym = symtbl_lookup(symtbl, expr->data.identifier.name);
+            return !sym || !sym->is_external;
+        }
+        case AST_UNARY_OP:
+            return expr_side_effect_free(symtbl, expr->data.unary_op.operand);
+        case AST_BINARY_OP:
+            return expr_side_effect_free(symtbl, expr->data.binary_op.left) &&
+                   expr_side_effect_free(symtbl, expr->data.binary_op.right);
+        case AST_ARRAY_ACCESS:
+            return expr_side_effect_free(symtbl, expr->data.array_access.array) &&
+                   expr_side_effect_free(symtbl, expr->data.array_access.index);
+        case AST_MEMBER_ACCESS:
+            return expr_side_effect_free(symtbl, expr->data.member_access.object);
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 逻辑运算是否按短路方式生成
+ */
+bool codegen_short_circuit(SymbolTable* symtbl, const ASTNode* node) {
+    if (!node || node->type != AST_BINARY_OP) return false;
+    
+    BinaryOp op = node->data.binary_op.op;
+    if (op == BINOP_AND_THEN || op == BINOP_OR_ELSE) return true;
+    if (op != BINOP_AND && op != BINOP_OR) return false;
+    if (node->resolved_type && node->resolved_type->base_type == TYPE_INT) return false;
+    return expr_side_effect_free(symtbl, node->data.binary_op.right);
+}
+
+/**
+ * @brief 生成短路逻辑运算
+ *
+ * AND：左值; DUP; JZ 结束; POP; 右值; 结束:
+ * OR ：左值; DUP; JNZ 结束; POP; 右值; 结束:
+ * 跳过右操作数时栈顶的左值就是结果
+ */
+static ErrorCode generate_short_circuit(CodeGenContext* ctx, ASTNode* node) {
+    BinaryOp op = node->data.binary_op.op;
+    bool is_and = (op == BINOP_AND || op == BINOP_AND_THEN);
+    
+    ErrorCode err = codegen_expr(ctx, node->data.binary_op.left);
+    if (err != OK) return err;
+    
+    codegen_emit(ctx, OP_DUP, 0);
+    int32_t skip = codegen_emit(ctx, is_and ? OP_JZ : OP_JNZ, 0);
+    codegen_emit(ctx, OP_POP, 0);
+    
+    err = codegen_expr(ctx, node->data.binary_op.right);
+    if (err != OK) return err;
+    
+    codegen_patch_jump(ctx, skip, codegen_current_position(ctx));
+    return OK;
+}
+
 /**
  * @brief 生成二元运算
  */
 static ErrorCode generate_binary_op(CodeGenContext* ctx, ASTNode* node) {
     ErrorCode err;
     
+    if (codegen_short_circuit(ctx->symtbl, node)) {
+        return generate_short_circuit(ctx, node);
+    }
+    
     // 左操作数
     err = codegen_expr(ctx, node->data.binary_op.left);
     if (err != OK) return err;
@@ -829,16 +951,12 @@ static ErrorCode generate_function_call(CodeGenContext* ctx, ASTNode* node) {
         
         // 发射CALL_EXT指令
         uint32_t func_index = func - ctx->module->functions;
-        Instruction instr;
-        instr.opcode = OP_CALL_EXT;
-        instr.operand = func_index;  // 函数索引
-        instr.flags = node->data.function_call.arg_count;
-        
-        if (ctx->module->instruction_count >= ctx->module->instruction_capacity) {
-            ctx->error_code = ERR_RUNTIME;
-            return ERR_RUNTIME;
+        if (codegen_emit_with_flags(ctx, OP_CALL_EXT,
+                                    (uint8_t)node->data.function_call.arg_count,
+                                    (uint16_t)func_index) < 0) {
+            ctx->error_code = ERR_OUT_OF_MEMORY;
+            return ERR_OUT_OF_MEMORY;
         }
-        ctx->module->instructions[ctx->module->instruction_count++] = instr;
         
         return OK;
     }
@@ -850,6 +968,55 @@ static ErrorCode generate_function_call(CodeGenContext* ctx, ASTNode* node) {
     return ERR_NAME;
 }
 
+/**
+ * @brief 常量下标的元素地址（声明范围已知时在编译期检查边界）
+ */
+static ErrorCode constant_element_address(CodeGenContext* ctx, Symbol* array_sym,
+                                          int32_t index, uint16_t* addr) {
+    uint32_t length = type_info_array_length(array_sym->type);
+    int32_t lower = type_info_array_lower(array_sym->type);
+    int64_t rel = (int64_t)index - lower;
+    if (length > 0 && (rel < 0 || rel >= (int64_t)length)) {
+        snprintf(ctx->error_msg, sizeof(ctx->error_msg),
+                "Array index out of bounds: %s[%d] (range %d..%lld)", array_sym->name, index,
+                lower, (long long)lower + length - 1);
+        ctx->error_code = ERR_OUT_OF_BOUNDS;
+        return ERR_OUT_OF_BOUNDS;
+    }
+    *addr = (uint16_t)((array_sym->is_global ? array_sym->index : array_sym->offset) + rel);
+    return OK;
+}
+
+/**
+ * @brief 发射运行时下标的数组访问（下标已在栈顶）
+ * 
+ * 声明长度已知时记录数组描述符，发射按声明范围检查的 OP_LOAD_ARRAY/OP_STORE_ARRAY，
+ * 生成结束后能证明不越界的访问标为免检；否则发射只检查变量区的 *_INDEXED
+ * （下界不为 0 时先把下标换算成相对首元素的偏移）。
+ */
+static void emit_indexed_access(CodeGenContext* ctx, Symbol* array_sym, bool is_store) {
+    uint16_t base_offset = array_sym->is_global ? array_sym->index : array_sym->offset;
+    uint32_t length = type_info_array_length(array_sym->type);
+    int32_t lower = type_info_array_lower(array_sym->type);
+    uint32_t bound = length > 0
+        ? bytecode_add_array_bound(ctx->module, base_offset, lower, length, array_sym->is_global)
+        : (uint32_t)-1;
+    
+    if (bound != (uint32_t)-1) {
+        codegen_emit(ctx, is_store ? OP_STORE_ARRAY : OP_LOAD_ARRAY, (uint16_t)bound);
+        return;
+    }
+    
+    if (lower != 0) {
+        codegen_emit(ctx, OP_PUSH, (uint16_t)bytecode_add_int_constant(ctx->module, lower));
+        codegen_emit(ctx, OP_SUB, 0);
+    }
+    
+    // operand = 数组基地址，flags 标识全局/局部
+    uint8_t flags = array_sym->is_global ? FLAG_GLOBAL : 0x00;
+    codegen_emit_with_flags(ctx, is_store ? OP_STORE_INDEXED : OP_LOAD_INDEXED, flags, base_offset);
+}
+
 /**
  * @brief 生成数组访问
  */
@@ -879,18 +1046,11 @@ static ErrorCode generate_array_access(CodeGenContext* ctx, ASTNode* node) {
     
     // 检查索引是否是字面量（编译时常量）
     if (node->data.array_access.index->type != AST_LITERAL) {
-        // 运行时数组索引 - 使用 OP_LOAD_INDEXED
-        
-        // 计算索引表达式并压入栈
+        // 运行时数组索引：计算索引表达式并压入栈
         err = codegen_expr(ctx, node->data.array_access.index);
         if (err != OK) return err;
         
-        // 发出 OP_LOAD_INDEXED 指令
-        // operand = 数组基地址，flags 标识全局/局部
-        uint8_t flags = array_sym->is_global ? FLAG_GLOBAL : 0x00;
-        uint16_t base_offset = array_sym->is_global ? array_sym->index : array_sym->offset;
-        codegen_emit_with_flags(ctx, OP_LOAD_INDEXED, flags, base_offset);
-        
+        emit_indexed_access(ctx, array_sym, false);
         return OK;
     }
     
@@ -903,15 +1063,15 @@ static ErrorCode generate_array_access(CodeGenContext* ctx, ASTNode* node) {
         ctx->error_code = ERR_TYPE;
         return ERR_TYPE;
     }
-    int32_t index = idx_val.int_val;
-    
-    // TODO: 检查数组边界（需要类型系统支持）
     
     // 计算实际变量偏移：base_offset + index
-    uint16_t offset = array_sym->offset + index;
+    uint16_t offset;
+    err = constant_element_address(ctx, array_sym, idx_val.int_val, &offset);
+    if (err != OK) return err;
     
     // 生成LOAD指令
-    // 使用 is_global 判断全局/局部
+    uint8_t flags = array_sym->is_global ? FLAG_GLOBAL : 0x00;
+    codegen_emit_with_flags(ctx, OP_LOAD, flags, offset);
     
     return OK;
 }
@@ -979,6 +1139,20 @@ static ErrorCode generate_member_access(CodeGenContext* ctx, ASTNode* node) {
 ErrorCode codegen_stmt(CodeGenContext* ctx, ASTNode* stmt, LoopContext* loop_ctx) {
     if (!stmt) return OK;
     
+    // 语句开始处更新当前行号；嵌套语句返回后恢复，使循环回跳等指令归属外层语句行
+    int saved_line = ctx->current_line;
+    if (stmt->location.line > 0) {
+        ctx->current_line = stmt->location.line;
+    }
+    ErrorCode err = generate_statement(ctx, stmt, loop_ctx);
+    ctx->current_line = saved_line;
+    return err;
+}
+
+/**
+ * @brief 按语句类型分派代码生成
+ */
+static ErrorCode generate_statement(CodeGenContext* ctx, ASTNode* stmt, LoopContext* loop_ctx) {
     switch (stmt->type) {
         case AST_ASSIGN:
             return generate_assign(ctx, stmt);
@@ -1122,12 +1296,11 @@ static ErrorCode generate_assign(CodeGenContext* ctx, ASTNode* node) {
                 ctx->error_code = ERR_TYPE;
                 return ERR_TYPE;
             }
-            int32_t index = idx_val.int_val;
-            
-            // TODO: 检查数组边界（需要类型系统支持）
             
             // 计算实际变量偏移：base_offset + index
-            uint16_t offset = (array_sym->is_global ? array_sym->index : array_sym->offset) + index;
+            uint16_t offset;
+            err = constant_element_address(ctx, array_sym, idx_val.int_val, &offset);
+            if (err != OK) return err;
             
             // 生成STORE指令
             uint8_t flags = array_sym->is_global ? 0x01 : 0x00;
@@ -1135,18 +1308,13 @@ static ErrorCode generate_assign(CodeGenContext* ctx, ASTNode* node) {
             
             return OK;
         } else {
-            // 运行时索引 - 使用 OP_STORE_INDEXED
+            // 运行时索引
             // 栈布局：[... value, index]，其中 value 已经在栈上（之前计算的右值）
             // 现在需要计算索引并将其也压入栈
             err = codegen_expr(ctx, target->data.array_access.index);
             if (err != OK) return err;
             
-            // 发出 OP_STORE_INDEXED 指令
-            // operand = 数组基地址，flags 标识全局/局部
-            uint8_t flags = array_sym->is_global ? FLAG_GLOBAL : 0x00;
-            uint16_t base_offset = array_sym->is_global ? array_sym->index : array_sym->offset;
-            codegen_emit_with_flags(ctx, OP_STORE_INDEXED, flags, base_offset);
-            
+            emit_indexed_access(ctx, array_sym, true);
             return OK;
         }
         
@@ -1296,8 +1464,142 @@ static ErrorCode generate_while(CodeGenContext* ctx, ASTNode* node, LoopContext*
     return OK;
 }
 
+/**
+ * @brief 取整数常量的值（字面量或取负的字面量）
+ */
+static bool const_int_value(const ASTNode* expr, int32_t* value) {
+    if (!expr) return false;
+    if (expr->type == AST_LITERAL && expr->data.literal.value.type == TYPE_INT) {
+        *value = expr->data.literal.value.int_val;
+        return true;
+    }
+    if (expr->type == AST_UNARY_OP && expr->data.unary_op.op == UNOP_NEG &&
+        const_int_value(expr->data.unary_op.operand, value) && *value != INT32_MIN) {
+        *value = -*value;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 解析 FOR 循环的终值变量（非外部的 INT 变量或参数），写入描述符
+ */
+static bool for_end_variable(SymbolTable* symtbl, const char* func_name, const ASTNode* expr,
+                             ForLoop* loop) {
+    if (!expr || expr->type != AST_IDENTIFIER) return false;
+    const char* var_name = expr->data.identifier.name;
+    Symbol* sym = NULL;
+    
+    // 与 generate_identifier 相同：函数内先查静态变量的完全限定名
+    if (func_name) {
+        size_t qualified_len = strlen(func_name) + strlen(var_name) + 2;
+        char* qualified_name = (char*)mmgr_alloc(qualified_len);
+        if (!qualified_name) return false;
+        snprintf(qualified_name, qualified_len, "%s.%s", func_name, var_name);
+        sym = symtbl_lookup(symtbl, qualified_name);
+        mmgr_free(qualified_name);
+        if (sym && !sym->is_static) sym = NULL;
+    }
+    if (!sym) sym = symtbl_lookup(symtbl, var_name);
+    
+    if (!sym || (sym->kind != SYM_VARIABLE && sym->kind != SYM_PARAMETER) ||
+        sym->is_external || !sym->type || sym->type->base_type != TYPE_INT) {
+        return false;
+    }
+    
+    bool is_global = sym->is_global || sym->is_static;
+    int32_t addr = is_global ? sym->index : sym->offset;
+    if (addr < 0 || addr > UINT16_MAX) return false;
+    loop->flags |= FOR_LOOP_END_VAR | (is_global ? FOR_LOOP_END_GLOBAL : 0);
+    loop->end_var = (uint32_t)addr;
+    return true;
+}
+
+/**
+ * @brief 语句列表中是否直接给变量赋值（含嵌套语句和同名的内层 FOR 循环变量）
+ */
+static bool statements_assign_var(const ASTNode* stmt, const char* name) {
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->type) {
+            case AST_ASSIGN: {
+                const ASTNode* target = stmt->data.assign.target;
+                if (target && target->type == AST_IDENTIFIER &&
+                    strcmp(target->data.identifier.name, name) == 0) {
+                    return true;
+                }
+                break;
+            }
+            case AST_IF:
+                if (statements_assign_var(stmt->data.if_stmt.then_branch, name) ||
+                    statements_assign_var(stmt->data.if_stmt.else_branch, name)) {
+                    return true;
+                }
+                break;
+            case AST_WHILE:
+                if (statements_assign_var(stmt->data.while_stmt.body, name)) return true;
+                break;
+            case AST_REPEAT:
+                if (statements_assign_var(stmt->data.repeat_stmt.body, name)) return true;
+                break;
+            case AST_FOR:
+                if (strcmp(stmt->data.for_stmt.variable, name) == 0 ||
+                    statements_assign_var(stmt->data.for_stmt.body, name)) {
+                    return true;
+                }
+                break;
+            case AST_CASE:
+                for (int i = 0; i < stmt->data.case_stmt.case_count; i++) {
+                    const ASTNode* element = stmt->data.case_stmt.cases[i];
+                    if (element && statements_assign_var(element->data.case_element.statements, name)) {
+                        return true;
+                    }
+                }
+                if (statements_assign_var(stmt->data.case_stmt.default_case, name)) return true;
+                break;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief FOR 循环能否用循环描述符生成
+ */
+bool codegen_for_loop_descriptor(SymbolTable* symtbl, const char* func_name, ASTNode* node,
+                                 const Symbol* loop_var, ForLoop* loop) {
+    memset(loop, 0, sizeof(*loop));
+    if (loop_var->is_external || !loop_var->type || loop_var->type->base_type != TYPE_INT) {
+        return false;
+    }
+    if (statements_assign_var(node->data.for_stmt.body, node->data.for_stmt.variable)) {
+        return false;
+    }
+    
+    loop->step = 1;
+    if (node->data.for_stmt.step &&
+        (!const_int_value(node->data.for_stmt.step, &loop->step) || loop->step == 0)) {
+        return false;
+    }
+    if (!const_int_value(node->data.for_stmt.end, &loop->end) &&
+        !for_end_variable(symtbl, func_name, node->data.for_stmt.end, loop)) {
+        return false;
+    }
+    if (const_int_value(node->data.for_stmt.start, &loop->start)) {
+        loop->flags |= FOR_LOOP_CONST_START;
+    }
+    
+    loop->var = loop_var->is_global ? (uint32_t)loop_var->index : (uint32_t)loop_var->offset;
+    if (loop_var->is_global) loop->flags |= FOR_LOOP_VAR_GLOBAL;
+    return true;
+}
+
 /**
  * @brief 生成for循环
+ *
+ * 常量步长的整数循环生成 <初值>; FOR_INIT; 循环体; FOR_STEP，比较和步进
+ * 由循环描述符完成，编译期已知的迭代次数可供 WCET 分析使用；其余情况
+ * 展开为比较循环（步长为负常量时比较 >=）。
  */
 static ErrorCode generate_for(CodeGenContext* ctx, ASTNode* node, LoopContext* parent_loop) {
     ErrorCode err;
@@ -1321,6 +1623,33 @@ static ErrorCode generate_for(CodeGenContext* ctx, ASTNode* node, LoopContext* p
     err = codegen_expr(ctx, node->data.for_stmt.start);
     if (err != OK) return err;
     
+    ForLoop loop;
+    if (ctx->module->for_loop_count < UINT16_MAX &&
+        codegen_for_loop_descriptor(ctx->symtbl,
+                                    ctx->current_function ? ctx->current_function->name : NULL,
+                                    node, loop_var, &loop)) {
+        uint32_t loop_index = bytecode_add_for_loop(ctx->module, &loop);
+        if (loop_index == (uint32_t)-1) {
+            ctx->error_code = ERR_OUT_OF_MEMORY;
+            return ERR_OUT_OF_MEMORY;
+        }
+        codegen_emit(ctx, OP_FOR_INIT, (uint16_t)loop_index);
+        ctx->module->for_loops[loop_index].body = (uint32_t)codegen_current_position(ctx);
+        
+        err = generate_block(ctx, node->data.for_stmt.body, &loop_ctx);
+        if (err != OK) return err;
+        
+        int32_t step_pos = codegen_emit(ctx, OP_FOR_STEP, (uint16_t)loop_index);
+        int32_t loop_end = codegen_current_position(ctx);
+        ctx->module->for_loops[loop_index].exit = (uint32_t)loop_end;
+        codegen_patch_jump_list(ctx, loop_ctx.break_labels, loop_end);
+        codegen_patch_jump_list(ctx, loop_ctx.continue_labels, step_pos);
+        
+        jump_label_free_list(loop_ctx.break_labels);
+        jump_label_free_list(loop_ctx.continue_labels);
+        return OK;
+    }
+    
     uint8_t flags = loop_var->is_global ? 0x01 : 0x00;
     uint16_t addr = loop_var->is_global ? loop_var->index : loop_var->offset;
     codegen_emit_with_flags(ctx, OP_STORE, flags, addr);
@@ -1335,8 +1664,11 @@ static ErrorCode generate_for(CodeGenContext* ctx, ASTNode* node, LoopContext* p
     err = codegen_expr(ctx, node->data.for_stmt.end);
     if (err != OK) return err;
     
-    // 比较：var <= end
-    codegen_emit(ctx, OP_LE, 0);
+    // 比较：var <= end（步长为负常量时 var >= end）
+    int32_t step_value = 1;
+    bool descending = node->data.for_stmt.step &&
+                      const_int_value(node->data.for_stmt.step, &step_value) && step_value < 0;
+    codegen_emit(ctx, descending ? OP_GE : OP_LE, 0);
     
     // 如果false，跳出循环
     int32_t jz_index = codegen_emit(ctx, OP_JZ, 0);
@@ -1426,166 +1758,262 @@ static ErrorCode generate_repeat(CodeGenContext* ctx, ASTNode* node, LoopContext
     return OK;
 }
 
+#define CASE_TABLE_MIN_RANGES   3       // 使用跳转表的最少区间数（合并后）
+#define CASE_DENSE_MAX_SPAN     1024    // 稠密表的最大值域
+#define CASE_DENSE_MIN_PERCENT  40      // 稠密表值域的最低覆盖率（%）
+
+static int compare_case_ranges(const void* a, const void* b) {
+    const CaseRange* x = (const CaseRange*)a;
+    const CaseRange* y = (const CaseRange*)b;
+    return (x->low > y->low) - (x->low < y->low);
+}
+
+/**
+ * @brief 收集 CASE 的标签区间，判断能否用跳转表
+ */
+ErrorCode codegen_case_ranges(ASTNode* node, CaseRange** out, uint32_t* count) {
+    *out = NULL;
+    *count = 0;
+    
+    ASTNode* selector = node->data.case_stmt.expression;
+    if (!selector || !selector->resolved_type || selector->resolved_type->base_type != TYPE_INT) {
+        return OK;
+    }
+    
+    uint32_t total = 0;
+    for (int i = 0; i < node->data.case_stmt.case_count; i++) {
+        ASTNode* elem = node->data.case_stmt.cases[i];
+        if (!elem || elem->type != AST_CASE_ELEMENT) return OK;
+        for (ASTNode* label = elem->data.case_element.labels; label; label = label->next) total++;
+    }
+    if (total < CASE_TABLE_MIN_RANGES) return OK;
+    
+    CaseRange* ranges = (CaseRange*)mmgr_alloc(sizeof(CaseRange) * total);
+    if (!ranges) return ERR_OUT_OF_MEMORY;
+    
+    uint32_t n = 0;
+    for (int i = 0; i < node->data.case_stmt.case_count; i++) {
+        ASTNode* elem = node->data.case_stmt.cases[i];
+        for (ASTNode* label = elem->data.case_element.labels; label; label = label->next) {
+            int32_t low, high;
+            bool constant = (label->type == AST_CASE_RANGE)
+                ? const_int_value(label->data.case_range.low, &low) &&
+                  const_int_value(label->data.case_range.high, &high)
+                : const_int_value(label, &low);
+            if (!constant) {
+                mmgr_free(ranges);
+                return OK;
+            }
+            if (label->type != AST_CASE_RANGE) high = low;
+            if (low > high) continue;       // 空区间永不匹配
+            ranges[n].low = low;
+            ranges[n].high = high;
+            ranges[n].branch = i;
+            n++;
+        }
+    }
+    
+    qsort(ranges, n, sizeof(CaseRange), compare_case_ranges);
+    
+    uint32_t merged = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (merged > 0) {
+            CaseRange* prev = &ranges[merged - 1];
+            if (ranges[i].low <= prev->high) {
+                mmgr_free(ranges);
+                return OK;
+            }
+            if (prev->branch == ranges[i].branch && (int64_t)prev->high + 1 == ranges[i].low) {
+                prev->high = ranges[i].high;
+                continue;
+            }
+        }
+        ranges[merged++] = ranges[i];
+    }
+    
+    if (merged < CASE_TABLE_MIN_RANGES) {
+        mmgr_free(ranges);
+        return OK;
+    }
+    *out = ranges;
+    *count = merged;
+    return OK;
+}
+
+/**
+ * @brief 选择跳转表形式
+ */
+SwitchKind codegen_case_table_kind(const CaseRange* ranges, uint32_t count) {
+    int64_t span = (int64_t)ranges[count - 1].high - ranges[0].low + 1;
+    int64_t covered = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        covered += (int64_t)ranges[i].high - ranges[i].low + 1;
+    }
+    if (span <= CASE_DENSE_MAX_SPAN && covered * 100 >= span * CASE_DENSE_MIN_PERCENT) {
+        return SWITCH_DENSE;
+    }
+    return SWITCH_SORTED;
+}
+
+/**
+ * @brief 为一个标签生成比较链片段（匹配时跳转，跳转指令加入 labels）
+ *
+ * 单值：DUP; 标签; EQ; JNZ 分支
+ * 区间：DUP; 下界; GE; JZ 跳过; DUP; 上界; LE; JNZ 分支; 跳过:
+ */
+static ErrorCode case_emit_compare(CodeGenContext* ctx, ASTNode* label, JumpLabel** labels) {
+    ErrorCode err;
+    int32_t skip = -1;
+    ASTNode* value = label;
+    
+    if (label->type == AST_CASE_RANGE) {
+        codegen_emit(ctx, OP_DUP, 0);
+        err = codegen_expr(ctx, label->data.case_range.low);
+        if (err != OK) return err;
+        codegen_emit(ctx, OP_GE, 0);
+        skip = codegen_emit(ctx, OP_JZ, 0);
+        value = label->data.case_range.high;
+    }
+    
+    codegen_emit(ctx, OP_DUP, 0);
+    err = codegen_expr(ctx, value);
+    if (err != OK) return err;
+    codegen_emit(ctx, label->type == AST_CASE_RANGE ? OP_LE : OP_EQ, 0);
+    
+    JumpLabel* jump = jump_label_create(codegen_emit(ctx, OP_JNZ, 0));
+    if (!jump) return ERR_OUT_OF_MEMORY;
+    jump->next = *labels;
+    *labels = jump;
+    
+    if (skip >= 0) {
+        codegen_patch_jump(ctx, skip, codegen_current_position(ctx));
+    }
+    return OK;
+}
+
 /**
  * @brief 生成 CASE 语句
  * 
- * CASE 语句的代码生成策略：
- * 1. 计算 CASE 表达式并保存在栈上（需要多次比较）
- * 2. 对每个分支的每个标签：
- *    - 复制栈顶的表达式值
- *    - 计算标签值
- *    - 比较是否相等
- *    - 如果相等，跳转到该分支的代码
- * 3. 所有标签都不匹配，跳转到 ELSE 分支（如果有）或结束
- * 4. 每个分支执行完后跳转到 CASE 语句结束
+ * 选择表达式的值留在栈上，按标签形式选择分派方式：
+ * 1. 跳转表：INT 选择值、全部为整数常量标签且区间不重叠、合并后至少
+ *    CASE_TABLE_MIN_RANGES 个区间时，发射 OP_SWITCH（弹出选择值）。
+ *    值域小且覆盖率高用稠密表（O(1) 下标），否则用有序区间表（二分查找）
+ * 2. 比较链：其余情况逐个标签比较，命中跳到分支并弹出选择值
+ * 所有标签都不匹配时进入 ELSE 分支（如果有）；每个分支执行完后跳到 CASE 结束
  */
 static ErrorCode generate_case(CodeGenContext* ctx, ASTNode* node, LoopContext* loop_ctx) {
     ErrorCode err;
+    int case_count = node->data.case_stmt.case_count;
     
     // 1. 计算 CASE 表达式
     err = codegen_expr(ctx, node->data.case_stmt.expression);
     if (err != OK) return err;
     
-    // 用于存储每个分支开始位置的跳转索引
-    typedef struct {
-        int32_t* jump_indices;  // 该分支所有标签的跳转索引
-        int label_count;        // 标签数量
-    } BranchJumps;
-    
-    int case_count = node->data.case_stmt.case_count;
-    BranchJumps* branch_jumps = (BranchJumps*)mmgr_alloc(sizeof(BranchJumps) * case_count);
-    if (!branch_jumps) return ERR_OUT_OF_MEMORY;
+    CaseRange* ranges = NULL;
+    uint32_t range_count = 0;
+    err = codegen_case_ranges(node, &ranges, &range_count);
+    if (err != OK) return err;
     
-    // 2. 为每个分支的每个标签生成比较和条件跳转
-    for (int i = 0; i < case_count; i++) {
-        ASTNode* case_elem = node->data.case_stmt.cases[i];
-        if (!case_elem || case_elem->type != AST_CASE_ELEMENT) {
-            continue;
-        }
-        
-        // 计算该分支有多少个标签
-        int label_count = 0;
-        ASTNode* label = case_elem->data.case_element.labels;
-        while (label) {
-            label_count++;
-            label = label->next;
-        }
-        
-        branch_jumps[i].label_count = label_count;
-        branch_jumps[i].jump_indices = (int32_t*)mmgr_alloc(sizeof(int32_t) * label_count);
-        if (!branch_jumps[i].jump_indices) {
-            for (int j = 0; j < i; j++) {
-                mmgr_free(branch_jumps[j].jump_indices);
-            }
-            mmgr_free(branch_jumps);
-            return ERR_OUT_OF_MEMORY;
-        }
-        
-        // 为每个标签生成比较代码
-        label = case_elem->data.case_element.labels;
-        int label_idx = 0;
-        while (label) {
-            // 复制栈顶的 CASE 表达式值（用于比较）
-            codegen_emit(ctx, OP_DUP, 0);
-            
-            // 计算标签值
-            err = codegen_expr(ctx, label);
-            if (err != OK) {
-                for (int j = 0; j <= i; j++) {
-                    mmgr_free(branch_jumps[j].jump_indices);
-                }
-                mmgr_free(branch_jumps);
-                return err;
-            }
-            
-            // 比较是否相等
-            codegen_emit(ctx, OP_EQ, 0);
-            
-            // 如果相等，跳转到该分支（稍后回填）
-            branch_jumps[i].jump_indices[label_idx] = codegen_emit(ctx, OP_JNZ, 0);
-            
-            label_idx++;
-            label = label->next;
-        }
+    JumpLabel** branch_labels = (JumpLabel**)mmgr_alloc(sizeof(JumpLabel*) * (case_count + 1));
+    int32_t* branch_starts = (int32_t*)mmgr_alloc(sizeof(int32_t) * (case_count + 1));
+    int32_t* end_jumps = (int32_t*)mmgr_alloc(sizeof(int32_t) * (case_count + 1));
+    if (!branch_labels || !branch_starts || !end_jumps) {
+        err = ERR_OUT_OF_MEMORY;
+        goto cleanup;
     }
+    memset(branch_labels, 0, sizeof(JumpLabel*) * (case_count + 1));
     
-    // 3. 所有标签都不匹配，跳转到 ELSE 或结束
-    int32_t default_jump = codegen_emit(ctx, OP_JMP, 0);
-    
-    // 用于存储每个分支结束时跳转到 CASE 结束的跳转索引
-    int32_t* end_jumps = (int32_t*)mmgr_alloc(sizeof(int32_t) * case_count);
-    if (!end_jumps) {
+    // 2. 分派：跳转表或比较链
+    int32_t switch_index = -1;
+    int32_t default_jump = -1;
+    if (ranges) {
+        switch_index = codegen_emit(ctx, OP_SWITCH, 0);
+    } else {
         for (int i = 0; i < case_count; i++) {
-            mmgr_free(branch_jumps[i].jump_indices);
+            ASTNode* case_elem = node->data.case_stmt.cases[i];
+            if (!case_elem || case_elem->type != AST_CASE_ELEMENT) continue;
+            for (ASTNode* label = case_elem->data.case_element.labels; label; label = label->next) {
+                err = case_emit_compare(ctx, label, &branch_labels[i]);
+                if (err != OK) goto cleanup;
+            }
         }
-        mmgr_free(branch_jumps);
-        return ERR_OUT_OF_MEMORY;
+        default_jump = codegen_emit(ctx, OP_JMP, 0);
     }
     
-    // 4. 生成每个分支的代码
+    // 3. 生成每个分支的代码
     for (int i = 0; i < case_count; i++) {
         ASTNode* case_elem = node->data.case_stmt.cases[i];
+        end_jumps[i] = -1;
         if (!case_elem) continue;
         
-        // 回填该分支所有标签的跳转地址到这里
-        int32_t branch_start = codegen_current_position(ctx);
-        for (int j = 0; j < branch_jumps[i].label_count; j++) {
-            codegen_patch_jump(ctx, branch_jumps[i].jump_indices[j], branch_start);
+        branch_starts[i] = codegen_current_position(ctx);
+        if (!ranges) {
+            codegen_patch_jump_list(ctx, branch_labels[i], branch_starts[i]);
+            // 弹出栈顶的 CASE 表达式值（已经匹配，不再需要）
+            codegen_emit(ctx, OP_POP, 0);
         }
         
-        // 弹出栈顶的 CASE 表达式值（已经匹配，不再需要）
-        codegen_emit(ctx, OP_POP, 0);
-        
-        // 生成分支语句
         if (case_elem->data.case_element.statements) {
             err = generate_block(ctx, case_elem->data.case_element.statements, loop_ctx);
-            if (err != OK) {
-                for (int j = 0; j < case_count; j++) {
-                    mmgr_free(branch_jumps[j].jump_indices);
-                }
-                mmgr_free(branch_jumps);
-                mmgr_free(end_jumps);
-                return err;
-            }
+            if (err != OK) goto cleanup;
         }
         
         // 跳转到 CASE 结束
         end_jumps[i] = codegen_emit(ctx, OP_JMP, 0);
     }
     
-    // 5. 生成 ELSE 分支（如果有）
+    // 4. 生成 ELSE 分支（如果有）
     int32_t else_start = codegen_current_position(ctx);
-    codegen_patch_jump(ctx, default_jump, else_start);
-    
-    // 弹出栈顶的 CASE 表达式值
-    codegen_emit(ctx, OP_POP, 0);
+    if (!ranges) {
+        codegen_patch_jump(ctx, default_jump, else_start);
+        codegen_emit(ctx, OP_POP, 0);
+    }
     
     if (node->data.case_stmt.default_case) {
         err = generate_block(ctx, node->data.case_stmt.default_case, loop_ctx);
-        if (err != OK) {
-            for (int i = 0; i < case_count; i++) {
-                mmgr_free(branch_jumps[i].jump_indices);
-            }
-            mmgr_free(branch_jumps);
-            mmgr_free(end_jumps);
-            return err;
-        }
+        if (err != OK) goto cleanup;
     }
     
-    // 6. 回填所有分支结束时的跳转到 CASE 结束
+    // 5. 回填所有分支结束时的跳转到 CASE 结束
     int32_t case_end = codegen_current_position(ctx);
     for (int i = 0; i < case_count; i++) {
-        codegen_patch_jump(ctx, end_jumps[i], case_end);
+        if (end_jumps[i] >= 0) codegen_patch_jump(ctx, end_jumps[i], case_end);
     }
     
-    // 释放内存
-    for (int i = 0; i < case_count; i++) {
-        mmgr_free(branch_jumps[i].jump_indices);
+    // 6. 分支地址确定后登记跳转表
+    if (ranges) {
+        SwitchCase* cases = (SwitchCase*)mmgr_alloc(sizeof(SwitchCase) * range_count);
+        if (!cases) {
+            err = ERR_OUT_OF_MEMORY;
+            goto cleanup;
+        }
+        for (uint32_t i = 0; i < range_count; i++) {
+            cases[i].low = ranges[i].low;
+            cases[i].high = ranges[i].high;
+            cases[i].target = (uint32_t)branch_starts[ranges[i].branch];
+        }
+        uint32_t table = bytecode_add_switch_table(ctx->module, codegen_case_table_kind(ranges, range_count),
+                                                   cases, range_count, (uint32_t)else_start);
+        mmgr_free(cases);
+        if (table == (uint32_t)-1 || table > UINT16_MAX) {
+            snprintf(ctx->error_msg, sizeof(ctx->error_msg),
+                     "Failed to register jump table for CASE statement");
+            err = ERR_OUT_OF_MEMORY;
+            goto cleanup;
+        }
+        ctx->module->instructions[switch_index].operand = (uint16_t)table;
     }
-    mmgr_free(branch_jumps);
-    mmgr_free(end_jumps);
+    err = OK;
     
-    return OK;
+cleanup:
+    if (branch_labels) {
+        for (int i = 0; i < case_count; i++) jump_label_free_list(branch_labels[i]);
+    }
+    mmgr_free(branch_labels);
+    mmgr_free(branch_starts);
+    mmgr_free(end_jumps);
+    mmgr_free(ranges);
+    return err;
 }
 
 /**
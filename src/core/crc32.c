@@ -0,0 +1,252 @@
+/**
+ * @file crc32.c
+ * @brief CRC32 校验的实现
+ *
+ * - slicing-by-8：每次处理 8 字节，8 张 256 项表，可移植回退路径
+ * - PCLMULQDQ 折叠（x86-64，运行时检测）：按 Intel《Fast CRC Computation
+ *   for Generic Polynomials Using PCLMULQDQ Instruction》的反射域常量，
+ *   先 4×128 位并行折叠，再归约到 128 位，最后 Barrett 归约到 32 位
+ *
+ * 注：SSE4.2 的 crc32 指令计算的是 CRC32C（Castagnoli），与 .stbc 使用的
+ * IEEE 多项式不同，因此加速路径只依赖 PCLMULQDQ 与 SSE4.1。
+ */
+
+#include "crc32.h"
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define CRC32_HAVE_CLMUL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// slicing-by-8 查表实现
+// ============================================================================
+
+static uint32_t crc_tables[8][256];
+static bool crc_tables_ready = false;
+
+/**
+ * @brief 生成查表（幂等，重复初始化结果相同）
+ */
+static void init_tables(void) {
+    if (crc_tables_ready) return;
+
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int j = 0; j < 8; j++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        crc_tables[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = crc_tables[0][i];
+        for (int k = 1; k < 8; k++) {
+            crc = crc_tables[0][crc & 0xFF] ^ (crc >> 8);
+            crc_tables[k][i] = crc;
+        }
+    }
+    crc_tables_ready = true;
+}
+
+/**
+ * @brief 查表实现
+ */
+uint32_t crc32_update_portable(uint32_t crc, const void* data, size_t length) {
+    init_tables();
+
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t c = ~crc;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (length >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= c;
+        c = crc_tables[7][lo & 0xFF] ^ crc_tables[6][(lo >> 8) & 0xFF] ^
+            crc_tables[5][(lo >> 16) & 0xFF] ^ crc_tables[4][lo >> 24] ^
+            crc_tables[3][hi & 0xFF] ^ crc_tables[2][(hi >> 8) & 0xFF] ^
+            crc_tables[1][(hi >> 16) & 0xFF] ^ crc_tables[0][hi >> 24];
+        p += 8;
+        length -= 8;
+    }
+#endif
+
+    while (length--) {
+        c = crc_tables[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+    }
+    return ~c;
+}
+
+// ============================================================================
+// PCLMULQDQ 折叠实现
+// ============================================================================
+
+#ifdef CRC32_HAVE_CLMUL
+
+#define CLMUL_MIN_LENGTH 64
+
+/**
+ * @brief 对 len 字节（len >= 64 且为 16 的倍数）折叠，crc 为反转后的状态
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_fold_clmul(const uint8_t* buf, size_t len, uint32_t crc) {
+    static const uint64_t k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    static const uint64_t k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    static const uint64_t k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124ULL, 0x0000000000ULL };
+    static const uint64_t poly[2] __attribute__((aligned(16))) = { 0x01db710641ULL, 0x01f7011641ULL };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+    buf += 64;
+    len -= 64;
+
+    // 4 路并行折叠
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buf += 64;
+        len -= 64;
+    }
+
+    // 归约到 128 位
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // 剩余的 16 字节块
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    // 128 位 -> 64 位
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett 归约到 32 位
+    x0 = _mm_load_si128((const __m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+/**
+ * @brief 折叠处理 16 字节整数倍的前缀，尾部交给查表实现
+ */
+static uint32_t crc32_update_clmul(uint32_t crc, const void* data, size_t length) {
+    const uint8_t* p = (const uint8_t*)data;
+    if (length >= CLMUL_MIN_LENGTH) {
+        size_t chunk = length & ~(size_t)15;
+        crc = ~crc32_fold_clmul(p, chunk, ~crc);
+        p += chunk;
+        length -= chunk;
+    }
+    return length ? crc32_update_portable(crc, p, length) : crc;
+}
+
+/**
+ * @brief 检测 CPU 是否支持 PCLMULQDQ 与 SSE4.1
+ */
+static bool cpu_has_clmul(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    return (ecx & bit_PCLMUL) && (ecx & bit_SSE4_1);
+}
+
+#endif // CRC32_HAVE_CLMUL
+
+// ============================================================================
+// 运行时分派
+// ============================================================================
+
+typedef uint32_t (*Crc32Fn)(uint32_t crc, const void* data, size_t length);
+
+static Crc32Fn crc_impl = NULL;
+static const char* crc_impl_name = "slice8";
+
+/**
+ * @brief 首次调用时选择实现
+ */
+static Crc32Fn select_impl(void) {
+    if (crc_impl) return crc_impl;
+
+    init_tables();
+    Crc32Fn fn = crc32_update_portable;
+#ifdef CRC32_HAVE_CLMUL
+    if (cpu_has_clmul()) {
+        fn = crc32_update_clmul;
+        crc_impl_name = "pclmul";
+    }
+#endif
+    crc_impl = fn;
+    return fn;
+}
+
+/**
+ * @brief 增量计算 CRC32
+ */
+uint32_t crc32_update(uint32_t crc, const void* data, size_t length) {
+    if (!data || length == 0) return crc;
+    return select_impl()(crc, data, length);
+}
+
+/**
+ * @brief 计算一块数据的 CRC32
+ */
+uint32_t crc32_compute(const void* data, size_t length) {
+    return crc32_update(0, data, length);
+}
+
+/**
+ * @brief 获取当前选用的实现名称
+ */
+const char* crc32_implementation(void) {
+    select_impl();
+    return crc_impl_name;
+}
@@ -37,6 +37,11 @@ Debugger* debugger_create(VM* vm) {
     dbg->state = DEBUG_STOPPED;
     dbg->show_disasm = true;
     
+    // 调试段（全局变量名、行号表）在生产加载路径上被跳过，这里按需读取
+    if (vm->module) {
+        bytecode_load_debug_info(vm->module);
+    }
+    
     return dbg;
 }
 
@@ -196,6 +201,11 @@ void debugger_print_frame(Debugger* dbg) {
     
     printf("=== 当前栈帧 ===\n");
     printf("PC: %u\n", vm->pc);
+    int line = vm_get_current_line(vm);
+    if (line > 0) {
+        const char* file = vm_get_current_file(vm);
+        printf("源码: %s:%d\n", file ? file : "<unknown>", line);
+    }
     printf("SP: %d\n", vm->sp);
     
     if (vm->call_sp >= 0) {
@@ -286,8 +296,12 @@ void debugger_print_globals(Debugger* dbg) {
     
     printf("=== 全局变量 ===\n");
     
+    const GlobalEntry* info = vm->module ? vm->module->globals_info : NULL;
     for (int i = 0; i < vm->global_count; i++) {
         printf("  [%d] ", i);
+        if (info && (uint32_t)i < vm->module->global_count && info[i].name) {
+            printf("%s = ", info[i].name);
+        }
         value_print(&vm->globals[i]);
         printf("\n");
     }
@@ -844,6 +858,7 @@ void debugger_print_help(void) {
     printf("  n, next              单步执行（跳过函数）\n");
     printf("  f, finish            执行到函数返回\n");
     printf("  b <addr>             在地址设置断点\n");
+    printf("  b :<line>            在源码行设置断点\n");
     printf("  d <addr>             删除断点\n");
     printf("  info breakpoints     列出所有断点\n");
     printf("  info frame           显示当前栈帧\n");
@@ -928,11 +943,21 @@ bool debugger_handle_command(Debugger* dbg, const char* command) {
     // 设置断点
     else if (strcmp(token, "b") == 0 || strcmp(token, "break") == 0) {
         char* arg = strtok(NULL, " \t");
-        if (arg) {
+        if (arg && arg[0] == ':') {
+            // 按源码行设置断点
+            int line = atoi(arg + 1);
+            uint32_t addr = bytecode_pc_for_line(dbg->vm->module, line);
+            if (addr == (uint32_t)-1) {
+                printf("第 %d 行之后没有可执行代码\n", line);
+            } else {
+                printf("第 %d 行 -> 地址 %u\n", line, addr);
+                debugger_add_breakpoint(dbg, addr);
+            }
+        } else if (arg) {
             uint32_t addr = (uint32_t)atoi(arg);
             debugger_add_breakpoint(dbg, addr);
         } else {
-            printf("用法: b <地址>\n");
+            printf("用法: b <地址> | b :<行号>\n");
         }
     }
     // 删除断点
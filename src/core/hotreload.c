@@ -18,6 +18,9 @@ static FunctionMapping* create_function_mapping(const char* name,
                                                  FunctionEntry* old_func, 
                                                  FunctionEntry* new_func);
 static ErrorCode merge_modules(HotReloadManager* mgr);
+static ErrorCode analyze_patch_diff(HotReloadManager* mgr);
+static bool check_patch_compatibility(HotReloadManager* mgr);
+static ErrorCode apply_patch(HotReloadManager* mgr);
 static bool is_function_in_call_stack(VM* vm, const char* func_name);
 
 /**
@@ -56,6 +59,7 @@ void hotreload_free(HotReloadManager* mgr) {
     if (mgr->staged_module && mgr->staged_module != mgr->active_module) {
         bytecode_module_free(mgr->staged_module);
     }
+    bytecode_patch_free(mgr->staged_patch);
     
     // 清理函数映射
     free_function_mappings(mgr->mappings);
@@ -89,10 +93,12 @@ ErrorCode hotreload_stage_module(HotReloadManager* mgr, const char* bytecode_fil
 ErrorCode hotreload_stage_module_from_memory(HotReloadManager* mgr, BytecodeModule* new_module) {
     if (!mgr || !new_module) return ERR_RUNTIME;
     
-    // 清理之前暂存的模块
+    // 清理之前暂存的模块或补丁
     if (mgr->staged_module && mgr->staged_module != mgr->active_module) {
         bytecode_module_free(mgr->staged_module);
     }
+    bytecode_patch_free(mgr->staged_patch);
+    mgr->staged_patch = NULL;
     free_function_mappings(mgr->mappings);
     mgr->mappings = NULL;
     
@@ -100,6 +106,10 @@ ErrorCode hotreload_stage_module_from_memory(HotReloadManager* mgr, BytecodeModu
     mgr->reload_pending = true;
     mgr->pending_op = HOTRELOAD_OP_REPLACE_MODULE;
     
+    // 按名迁移全局变量需要调试段中的元数据，此时才加载
+    bytecode_load_debug_info(mgr->active_module);
+    bytecode_load_debug_info(new_module);
+    
     // 分析模块差异
     ErrorCode err = analyze_module_diff(mgr);
     if (err != OK) {
@@ -118,6 +128,66 @@ ErrorCode hotreload_stage_module_from_memory(HotReloadManager* mgr, BytecodeModu
     return OK;
 }
 
+/**
+ * @brief 暂存差分补丁（从文件加载）
+ */
+ErrorCode hotreload_stage_patch(HotReloadManager* mgr, const char* patch_file) {
+    if (!mgr || !patch_file) return ERR_RUNTIME;
+    
+    if (mgr->verbose) {
+        printf("[HotReload] Staging patch from: %s\n", patch_file);
+    }
+    
+    BytecodePatch* patch = bytecode_patch_load(patch_file);
+    if (!patch) {
+        fprintf(stderr, "[HotReload] Failed to load patch from: %s\n", patch_file);
+        return ERR_RUNTIME;
+    }
+    
+    return hotreload_stage_patch_from_memory(mgr, patch);
+}
+
+/**
+ * @brief 暂存差分补丁（从内存）
+ */
+ErrorCode hotreload_stage_patch_from_memory(HotReloadManager* mgr, BytecodePatch* patch) {
+    if (!mgr || !patch) {
+        bytecode_patch_free(patch);
+        return ERR_RUNTIME;
+    }
+    
+    // 清理之前暂存的模块或补丁
+    hotreload_cancel_staged(mgr);
+    
+    // 按名迁移全局变量需要调试段中的元数据
+    bytecode_load_debug_info(mgr->active_module);
+    
+    ErrorCode err = bytecode_patch_check(patch, mgr->active_module);
+    if (err != OK) {
+        fprintf(stderr, "[HotReload] Patch does not match the active module\n");
+        bytecode_patch_free(patch);
+        return err;
+    }
+    
+    mgr->staged_patch = patch;
+    mgr->reload_pending = true;
+    mgr->pending_op = HOTRELOAD_OP_APPLY_PATCH;
+    
+    err = analyze_patch_diff(mgr);
+    if (err != OK) {
+        fprintf(stderr, "[HotReload] Failed to analyze patch\n");
+        hotreload_cancel_staged(mgr);
+        return err;
+    }
+    
+    if (mgr->verbose) {
+        printf("[HotReload] Patch staged successfully (%zu bytes)\n", patch->size);
+        hotreload_dump_diff(mgr);
+    }
+    
+    return OK;
+}
+
 /**
  * @brief 检查是否可以安全热更新
  */
@@ -155,7 +225,10 @@ bool hotreload_is_safe(HotReloadManager* mgr) {
     }
     
     // 检查 3: 兼容性验证
-    if (!hotreload_check_compatibility(mgr, mgr->staged_module)) {
+    bool compatible = (mgr->pending_op == HOTRELOAD_OP_APPLY_PATCH) ?
+                      check_patch_compatibility(mgr) :
+                      hotreload_check_compatibility(mgr, mgr->staged_module);
+    if (!compatible) {
         if (mgr->verbose) {
             printf("[HotReload] Unsafe: Module compatibility check failed\n");
         }
@@ -190,11 +263,22 @@ ErrorCode hotreload_apply_staged(HotReloadManager* mgr) {
     // 记录开始时间
     clock_t start = clock();
     
-    // 合并模块
-    ErrorCode err = merge_modules(mgr);
-    if (err != OK) {
-        fprintf(stderr, "[HotReload] Failed to merge modules\n");
-        return err;
+    // 合并模块或原地应用补丁
+    ErrorCode err;
+    if (mgr->pending_op == HOTRELOAD_OP_APPLY_PATCH) {
+        err = apply_patch(mgr);
+        if (err != OK) {
+            fprintf(stderr, "[HotReload] Failed to apply patch\n");
+            return err;
+        }
+        bytecode_patch_free(mgr->staged_patch);
+        mgr->staged_patch = NULL;
+    } else {
+        err = merge_modules(mgr);
+        if (err != OK) {
+            fprintf(stderr, "[HotReload] Failed to merge modules\n");
+            return err;
+        }
     }
     
     // 更新统计信息
@@ -228,6 +312,8 @@ void hotreload_cancel_staged(HotReloadManager* mgr) {
         bytecode_module_free(mgr->staged_module);
     }
     mgr->staged_module = NULL;
+    bytecode_patch_free(mgr->staged_patch);
+    mgr->staged_patch = NULL;
     
     free_function_mappings(mgr->mappings);
     mgr->mappings = NULL;
@@ -517,6 +603,253 @@ static ErrorCode merge_modules(HotReloadManager* mgr) {
     return OK;
 }
 
+/**
+ * @brief 查找补丁中某下标的函数条目
+ */
+static const PatchFunction* find_patch_function(const BytecodePatch* patch, uint32_t index) {
+    uint32_t lo = 0, hi = patch->header.function_record_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (patch->functions[mid].index < index) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < patch->header.function_record_count && patch->functions[lo].index == index) {
+        return &patch->functions[lo];
+    }
+    return NULL;
+}
+
+/**
+ * @brief 判断补丁是否把某个名字的函数保留在目标模块中（按名查找条目）
+ */
+static bool patch_defines_function(const BytecodePatch* patch, const char* name) {
+    for (uint32_t i = 0; i < patch->header.function_record_count; i++) {
+        if (strcmp(patch->functions[i].name, name) == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 按地址排序函数下标的比较函数
+ */
+static const FunctionEntry* g_sort_functions = NULL;
+
+static int compare_function_address(const void* a, const void* b) {
+    uint32_t addr_a = g_sort_functions[*(const uint32_t*)a].address;
+    uint32_t addr_b = g_sort_functions[*(const uint32_t*)b].address;
+    return (addr_a > addr_b) - (addr_a < addr_b);
+}
+
+/**
+ * @brief 分析补丁涉及的函数（只为有变化的函数建立映射）
+ * 
+ * 函数体范围取到下一个函数入口为止；条目变化、函数体内有指令被改写
+ * 或函数体随代码段平移的函数视为修改，这样入口地址平移的函数也会被安全检查覆盖。
+ */
+static ErrorCode analyze_patch_diff(HotReloadManager* mgr) {
+    BytecodeModule* old_mod = mgr->active_module;
+    const BytecodePatch* patch = mgr->staged_patch;
+    const STBPHeader* h = &patch->header;
+    
+    mgr->stats.functions_updated = 0;
+    mgr->stats.functions_added = 0;
+    mgr->stats.functions_deleted = 0;
+    mgr->stats.constants_merged = patch->new_const_count;
+    mgr->stats.instructions_added = 0;
+    for (uint32_t i = 0; i < h->run_count; i++) {
+        mgr->stats.instructions_added += patch->runs[i].count;
+    }
+    
+    // 1. 基准模块中的函数：按地址排序以确定函数体范围
+    uint32_t* order = NULL;
+    if (old_mod->function_count > 0) {
+        order = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * old_mod->function_count);
+        if (!order) return ERR_OUT_OF_MEMORY;
+        for (uint32_t i = 0; i < old_mod->function_count; i++) {
+            order[i] = i;
+        }
+        g_sort_functions = old_mod->functions;
+        qsort(order, old_mod->function_count, sizeof(uint32_t), compare_function_address);
+        g_sort_functions = NULL;
+    }
+    
+    ErrorCode err = OK;
+    for (uint32_t k = 0; k < old_mod->function_count; k++) {
+        uint32_t i = order[k];
+        FunctionEntry* old_func = &old_mod->functions[i];
+        uint32_t end = (k + 1 < old_mod->function_count) ?
+                       old_mod->functions[order[k + 1]].address : old_mod->instruction_count;
+        const PatchFunction* rec = (i < h->function_count) ? find_patch_function(patch, i) : NULL;
+        
+        bool removed = (i >= h->function_count) || (rec && strcmp(rec->name, old_func->name) != 0);
+        FunctionMapping* mapping = NULL;
+        if (removed) {
+            if (patch_defines_function(patch, old_func->name)) {
+                // 换了位置，由下面的函数条目处理
+                continue;
+            }
+            mapping = create_function_mapping(old_func->name, old_func, NULL);
+            if (!mapping) {
+                err = ERR_OUT_OF_MEMORY;
+                break;
+            }
+            mapping->is_deleted = true;
+            mgr->stats.functions_deleted++;
+        } else if (rec || bytecode_patch_moves_range(patch, old_func->address, end)) {
+            mapping = create_function_mapping(old_func->name, old_func, NULL);
+            if (!mapping) {
+                err = ERR_OUT_OF_MEMORY;
+                break;
+            }
+            mapping->is_modified = true;
+            mgr->stats.functions_updated++;
+        } else {
+            continue;
+        }
+        mapping->next = mgr->mappings;
+        mgr->mappings = mapping;
+    }
+    if (order) mmgr_free(order);
+    if (err != OK) return err;
+    
+    // 2. 补丁中的函数条目：基准中没有的是新增函数，换了位置的是修改
+    for (uint32_t i = 0; i < h->function_record_count; i++) {
+        const PatchFunction* rec = &patch->functions[i];
+        if (rec->index < old_mod->function_count &&
+            strcmp(old_mod->functions[rec->index].name, rec->name) == 0) {
+            continue;  // 已在上面按修改处理
+        }
+        
+        FunctionEntry* old_func = bytecode_find_function(old_mod, rec->name);
+        FunctionMapping* mapping = create_function_mapping(rec->name, old_func, NULL);
+        if (!mapping) return ERR_OUT_OF_MEMORY;
+        if (old_func) {
+            mapping->is_modified = true;
+            mgr->stats.functions_updated++;
+        } else {
+            mapping->is_new = true;
+            mgr->stats.functions_added++;
+        }
+        mapping->next = mgr->mappings;
+        mgr->mappings = mapping;
+    }
+    
+    return OK;
+}
+
+/**
+ * @brief 检查补丁与当前模块的兼容性
+ */
+static bool check_patch_compatibility(HotReloadManager* mgr) {
+    const BytecodePatch* patch = mgr->staged_patch;
+    BytecodeModule* old_mod = mgr->active_module;
+    
+    if (!patch || bytecode_patch_check(patch, old_mod) != OK) {
+        if (mgr->verbose) {
+            printf("[HotReload] Incompatible: Patch base digest or target does not match active module\n");
+        }
+        return false;
+    }
+    
+    // 全局变量布局变化时需要两侧元数据才能按名迁移
+    const STBPHeader* h = &patch->header;
+    bool layout_changed = h->global_count != old_mod->global_count || h->global_record_count > 0;
+    if (layout_changed && (!old_mod->globals_info || !(h->flags & STBP_FLAG_GLOBAL_INFO))) {
+        if (mgr->verbose) {
+            printf("[HotReload] Incompatible: Global layout changed (%u -> %u) without metadata\n",
+                   old_mod->global_count, h->global_count);
+        }
+        return false;
+    }
+    
+    return true;
+}
+
+/**
+ * @brief 原地应用补丁并迁移全局变量
+ */
+static ErrorCode apply_patch(HotReloadManager* mgr) {
+    BytecodeModule* module = mgr->active_module;
+    const BytecodePatch* patch = mgr->staged_patch;
+    const STBPHeader* h = &patch->header;
+    VM* vm = mgr->vm;
+    
+    if (!module || !patch || !vm) return ERR_RUNTIME;
+    
+    if (mgr->verbose) {
+        printf("[HotReload] Patching module %p in place (%u runs, %u functions)\n",
+               (void*)module, h->run_count, h->function_record_count);
+    }
+    
+    // 1. 补丁改写元数据之前，先算出新全局变量数组
+    bool layout_changed = h->global_count != module->global_count || h->global_record_count > 0;
+    Value* new_globals = NULL;
+    if ((layout_changed || !mgr->preserve_global_state) && h->global_count > 0) {
+        new_globals = (Value*)mmgr_calloc(sizeof(Value) * h->global_count);
+        if (!new_globals) return ERR_OUT_OF_MEMORY;
+    }
+    
+    if (layout_changed && mgr->preserve_global_state && vm->globals && module->globals_info) {
+        uint32_t r = 0;
+        for (uint32_t i = 0; i < h->global_count; i++) {
+            const PatchGlobal* rec = NULL;
+            if (r < h->global_record_count && patch->globals[r].index == i) {
+                rec = &patch->globals[r++];
+            }
+            
+            if (!rec) {
+                // 条目未变，原下标不变
+                if (i < (uint32_t)vm->global_count) {
+                    new_globals[i] = vm->globals[i];
+                }
+                continue;
+            }
+            
+            // 条目变化：在旧布局中按名查找同类型变量
+            for (uint32_t j = 0; j < module->global_count; j++) {
+                GlobalEntry* old_entry = &module->globals_info[j];
+                if (old_entry->name && strcmp(old_entry->name, rec->name) == 0) {
+                    if (old_entry->type == rec->type && j < (uint32_t)vm->global_count) {
+                        new_globals[i] = vm->globals[j];
+                        if (mgr->verbose) {
+                            printf("[HotReload] Migrated global '%s' (idx %u -> %u)\n", rec->name, j, i);
+                        }
+                    } else if (mgr->verbose) {
+                        printf("[HotReload] Global '%s' type changed, resetting value\n", rec->name);
+                    }
+                    break;
+                }
+            }
+        }
+    }
+    
+    // 2. 原地修改模块
+    ErrorCode err = bytecode_patch_apply(module, patch);
+    if (err != OK) {
+        if (new_globals) mmgr_free(new_globals);
+        return err;
+    }
+    
+    // 3. 替换全局变量数组（布局未变且保留状态时沿用原数组）
+    if (layout_changed || !mgr->preserve_global_state) {
+        if (vm->globals) {
+            mmgr_free(vm->globals);
+        }
+        vm->globals = new_globals;
+        vm->global_count = h->global_count;
+    }
+    
+    // 4. 从入口点重新开始
+    vm->pc = module->entry_point;
+    vm->sp = -1;
+    vm->call_sp = -1;
+    
+    return OK;
+}
+
 /**
  * @brief 创建函数映射
  */
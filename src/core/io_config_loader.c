@@ -4,14 +4,35 @@
  * 
  * 注意：这是一个简化版本,仅支持基本的 JSON 格式解析
  * 未来可以替换为完整的 JSON 解析库 (如 cJSON)
+ *
+ * 大规模配置（上万个点）的加载分两步：
+ * 1. 配置编译：一次读入源文件，解析为 IOPointConfig 数组，再批量建点
+ * 2. 二进制缓存：以源文件内容哈希为键写出可 mmap 的定长记录，
+ *    源文件未变化时重启直接从缓存建点，跳过文本解析
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "iomgr.h"
 #include "mmgr.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// ============================================================================
+// 二进制缓存格式
+// ============================================================================
+
+#define IO_CONFIG_CACHE_MAGIC       0x43495453  // "STIC"
+#define IO_CONFIG_CACHE_VERSION     1
+#define IO_CONFIG_CACHE_HEADER_SIZE 32
+#define IO_CONFIG_CACHE_RECORD_SIZE 48
+#define IO_CONFIG_CACHE_NO_PATH     0xFFFFFFFFu
 
 /**
  * @brief 简单的配置解析器 - 仅解析我们需要的字段
@@ -20,7 +41,8 @@
  * {
  *   "address": "%IX0.0",
  *   "type": "digital_in",
- *   "pin": 27
+ *   "pin": 27,
+ *   "deadband": 0.5
  * }
  */
 
@@ -28,6 +50,7 @@ typedef struct {
     char address[32];
     char type[32];
     int pin;
+    double deadband;
     bool valid;
 } SimpleIOConfig;
 
@@ -92,31 +115,100 @@ static IODeviceType string_to_device_type(const char* type_str) {
 }
 
 /**
- * @brief 从配置文件加载 IO 点
- * 
- * @param mgr IO 管理器
- * @param config_file 配置文件路径
- * @return ErrorCode
+ * @brief 读取整个文件到内存
  */
-ErrorCode io_manager_load_config_simple(IOManager* mgr, const char* config_file) {
-    if (!mgr || !config_file) {
-        return ERR_INVALID_ARGUMENT;
-    }
-    
-    FILE* f = fopen(config_file, "r");
+static ErrorCode read_whole_file(const char* path, char** data, size_t* size) {
+    FILE* f = fopen(path, "rb");
     if (!f) {
-        fprintf(stderr, "错误：无法打开配置文件 '%s'\n", config_file);
         return ERR_NOT_FOUND;
     }
     
-    char line[512];
+    fseek(f, 0, SEEK_END);
+    long len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (len < 0) {
+        fclose(f);
+        return ERR_FILE_IO;
+    }
+    
+    char* buf = (char*)mmgr_alloc((size_t)len + 1);
+    if (!buf) {
+        fclose(f);
+        return ERR_OUT_OF_MEMORY;
+    }
+    
+    if (fread(buf, 1, (size_t)len, f) != (size_t)len) {
+        mmgr_free(buf);
+        fclose(f);
+        return ERR_FILE_IO;
+    }
+    buf[len] = '\0';
+    fclose(f);
+    
+    *data = buf;
+    *size = (size_t)len;
+    return OK;
+}
+
+/**
+ * @brief FNV-1a 64 位哈希（缓存键）
+ */
+static uint64_t hash_source(const char* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (uint8_t)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief 将 SimpleIOConfig 转换为 IOPointConfig
+ */
+static bool build_point_config(const SimpleIOConfig* simple, IOPointConfig* config) {
+    IOAddress addr;
+    if (io_address_parse(simple->address, &addr) != OK) {
+        return false;
+    }
+    
+    memset(config, 0, sizeof(IOPointConfig));
+    config->address = addr;
+    config->device_type = string_to_device_type(simple->type);
+    config->access_mode = (config->device_type == IO_DEV_GPIO_IN || 
+                           config->device_type == IO_DEV_ADC || 
+                           config->device_type == IO_DEV_ENCODER) 
+                          ? IO_ACCESS_READ : IO_ACCESS_WRITE;
+    config->hardware_path = NULL;
+    config->hardware_address = simple->pin;
+    config->scale = 1.0;
+    config->offset = 0.0;
+    config->enable_filter = false;
+    config->filter_samples = 1;
+    config->deadband = simple->deadband;
+    return true;
+}
+
+/**
+ * @brief 解析配置文本为点配置数组（容量按几何级数增长）
+ */
+static ErrorCode parse_config_text(char* text, IOPointConfig** out, uint32_t* out_count) {
+    uint32_t capacity = 256;
+    uint32_t count = 0;
+    IOPointConfig* configs = (IOPointConfig*)mmgr_alloc(sizeof(IOPointConfig) * capacity);
+    if (!configs) {
+        return ERR_OUT_OF_MEMORY;
+    }
+    
     SimpleIOConfig current_config = {0};
     bool in_point = false;
-    int points_added = 0;
-    
-    printf("正在加载 IO 配置文件: %s\n", config_file);
+    char* line = text;
     
-    while (fgets(line, sizeof(line), f)) {
+    while (line && *line) {
+        char* next = strchr(line, '\n');
+        if (next) {
+            *next = '\0';
+        }
+        
         // 检测是否进入一个新的配置块 (简化判断)
         if (strstr(line, "\"address\"")) {
             in_point = true;
@@ -141,41 +233,341 @@ ErrorCode io_manager_load_config_simple(IOManager* mgr, const char* config_file)
                 current_config.pin = atoi(value);
             }
             
+            // 解析 deadband（可选）
+            if (parse_config_line(line, "deadband", value, sizeof(value))) {
+                current_config.deadband = atof(value);
+            }
+            
             // 检测配置块结束 (遇到 } 或下一个配置)
             if (strchr(line, '}') && current_config.address[0] != '\0') {
-                // 添加这个 IO 点
-                IOAddress addr;
-                if (io_address_parse(current_config.address, &addr) == OK) {
-                    IOPointConfig config;
-                    config.address = addr;
-                    config.device_type = string_to_device_type(current_config.type);
-                    config.access_mode = (config.device_type == IO_DEV_GPIO_IN || 
-                                         config.device_type == IO_DEV_ADC || 
-                                         config.device_type == IO_DEV_ENCODER) 
-                                        ? IO_ACCESS_READ : IO_ACCESS_WRITE;
-                    config.hardware_path = NULL;
-                    config.hardware_address = current_config.pin;
-                    config.scale = 1.0;
-                    config.offset = 0.0;
-                    config.enable_filter = false;
-                    config.filter_samples = 1;
-                    
-                    ErrorCode err = io_manager_add_point(mgr, &config);
-                    if (err == OK) {
-                        printf("  已添加: %s (%s, pin %d)\n", 
-                               current_config.address, current_config.type, current_config.pin);
-                        points_added++;
+                if (count >= capacity) {
+                    uint32_t new_capacity = capacity * 2;
+                    IOPointConfig* grown = (IOPointConfig*)mmgr_alloc(
+                        sizeof(IOPointConfig) * new_capacity);
+                    if (!grown) {
+                        mmgr_free(configs);
+                        return ERR_OUT_OF_MEMORY;
                     }
+                    memcpy(grown, configs, sizeof(IOPointConfig) * count);
+                    mmgr_free(configs);
+                    configs = grown;
+                    capacity = new_capacity;
+                }
+                
+                if (build_point_config(&current_config, &configs[count])) {
+                    count++;
                 }
                 
                 in_point = false;
             }
         }
+        
+        line = next ? next + 1 : NULL;
     }
     
-    fclose(f);
+    *out = configs;
+    *out_count = count;
+    return OK;
+}
+
+/**
+ * @brief 编译配置文件为点配置数组
+ */
+ErrorCode io_config_compile(const char* config_file, IOPointConfig** configs, uint32_t* count) {
+    if (!config_file || !configs || !count) {
+        return ERR_INVALID_ARGUMENT;
+    }
     
-    printf("配置加载完成，共添加 %d 个 IO 点\n", points_added);
+    char* text = NULL;
+    size_t size = 0;
+    ErrorCode err = read_whole_file(config_file, &text, &size);
+    if (err != OK) {
+        return err;
+    }
     
+    err = parse_config_text(text, configs, count);
+    mmgr_free(text);
+    return err;
+}
+
+/**
+ * @brief 释放 io_config_compile 的结果
+ */
+void io_config_free_compiled(IOPointConfig* configs, uint32_t count) {
+    if (!configs) {
+        return;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        if (configs[i].hardware_path) {
+            mmgr_free(configs[i].hardware_path);
+        }
+    }
+    mmgr_free(configs);
+}
+
+/**
+ * @brief 从配置文件加载 IO 点
+ * 
+ * @param mgr IO 管理器
+ * @param config_file 配置文件路径
+ * @return ErrorCode
+ */
+ErrorCode io_manager_load_config_simple(IOManager* mgr, const char* config_file) {
+    if (!mgr || !config_file) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    printf("正在加载 IO 配置文件: %s\n", config_file);
+    
+    IOPointConfig* configs = NULL;
+    uint32_t count = 0;
+    ErrorCode err = io_config_compile(config_file, &configs, &count);
+    if (err != OK) {
+        fprintf(stderr, "错误：无法打开配置文件 '%s'\n", config_file);
+        return err;
+    }
+    
+    uint32_t points_added = 0;
+    err = io_manager_add_points(mgr, configs, count, &points_added);
+    io_config_free_compiled(configs, count);
+    
+    printf("配置加载完成，共添加 %u 个 IO 点\n", points_added);
+    
+    if (err != OK) {
+        return err;
+    }
+    return points_added > 0 ? OK : ERR_NOT_FOUND;
+}
+
+// ============================================================================
+// 二进制配置缓存
+// ============================================================================
+
+static void cache_put_u32(uint8_t* p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+static void cache_put_u64(uint8_t* p, uint64_t v) { memcpy(p, &v, sizeof(v)); }
+static uint32_t cache_get_u32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static uint64_t cache_get_u64(const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+/**
+ * @brief 写出二进制配置缓存
+ *
+ * 布局：文件头 | point_count × 48 字节定长记录 | 硬件路径字符串区
+ * 先写入临时文件再 rename，避免并发重启读到半个缓存。
+ */
+static ErrorCode write_config_cache(const char* cache_file, uint64_t source_hash,
+                                    uint64_t source_size,
+                                    const IOPointConfig* configs, uint32_t count) {
+    uint32_t blob_size = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (configs[i].hardware_path) {
+            blob_size += (uint32_t)strlen(configs[i].hardware_path) + 1;
+        }
+    }
+    
+    size_t total = IO_CONFIG_CACHE_HEADER_SIZE +
+                   (size_t)count * IO_CONFIG_CACHE_RECORD_SIZE + blob_size;
+    uint8_t* buf = (uint8_t*)mmgr_alloc(total);
+    if (!buf) {
+        return ERR_OUT_OF_MEMORY;
+    }
+    memset(buf, 0, total);
+    
+    cache_put_u32(buf, IO_CONFIG_CACHE_MAGIC);
+    cache_put_u32(buf + 4, IO_CONFIG_CACHE_VERSION);
+    cache_put_u32(buf + 8, count);
+    cache_put_u32(buf + 12, blob_size);
+    cache_put_u64(buf + 16, source_hash);
+    cache_put_u64(buf + 24, source_size);
+    
+    uint8_t* blob = buf + IO_CONFIG_CACHE_HEADER_SIZE + (size_t)count * IO_CONFIG_CACHE_RECORD_SIZE;
+    uint32_t blob_pos = 0;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        const IOPointConfig* c = &configs[i];
+        uint8_t* r = buf + IO_CONFIG_CACHE_HEADER_SIZE + (size_t)i * IO_CONFIG_CACHE_RECORD_SIZE;
+        r[0] = (uint8_t)c->address.location;
+        r[1] = (uint8_t)c->address.size;
+        r[2] = c->address.bit_offset;
+        r[3] = (uint8_t)c->device_type;
+        r[4] = (uint8_t)c->access_mode;
+        r[5] = c->enable_filter ? 1 : 0;
+        cache_put_u32(r + 8, c->address.byte_offset);
+        cache_put_u32(r + 12, c->hardware_address);
+        cache_put_u32(r + 16, c->filter_samples);
+        if (c->hardware_path) {
+            size_t len = strlen(c->hardware_path) + 1;
+            memcpy(blob + blob_pos, c->hardware_path, len);
+            cache_put_u32(r + 20, blob_pos);
+            blob_pos += (uint32_t)len;
+        } else {
+            cache_put_u32(r + 20, IO_CONFIG_CACHE_NO_PATH);
+        }
+        memcpy(r + 24, &c->scale, sizeof(double));
+        memcpy(r + 32, &c->offset, sizeof(double));
+        memcpy(r + 40, &c->deadband, sizeof(double));
+    }
+    
+    char tmp_file[1024];
+    snprintf(tmp_file, sizeof(tmp_file), "%s.tmp", cache_file);
+    
+    ErrorCode err = ERR_FILE_IO;
+    FILE* f = fopen(tmp_file, "wb");
+    if (f) {
+        bool ok = fwrite(buf, 1, total, f) == total;
+        ok = (fclose(f) == 0) && ok;
+        if (ok && rename(tmp_file, cache_file) == 0) {
+            err = OK;
+        } else {
+            remove(tmp_file);
+        }
+    }
+    
+    mmgr_free(buf);
+    return err;
+}
+
+/**
+ * @brief 尝试从 mmap 的缓存建点
+ * @return OK；缓存缺失、损坏（含路径越界或未以 NUL 结尾）或哈希不匹配时返回 ERR_NOT_FOUND
+ */
+static ErrorCode load_from_cache(IOManager* mgr, const char* cache_file,
+                                 uint64_t source_hash, uint64_t source_size,
+                                 uint32_t* points_added) {
+    int fd = open(cache_file, O_RDONLY);
+    if (fd < 0) {
+        return ERR_NOT_FOUND;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < IO_CONFIG_CACHE_HEADER_SIZE) {
+        close(fd);
+        return ERR_NOT_FOUND;
+    }
+    
+    size_t map_size = (size_t)st.st_size;
+    const uint8_t* map = (const uint8_t*)mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return ERR_NOT_FOUND;
+    }
+    
+    uint32_t count = cache_get_u32(map + 8);
+    uint32_t blob_size = cache_get_u32(map + 12);
+    size_t expected = IO_CONFIG_CACHE_HEADER_SIZE +
+                      (size_t)count * IO_CONFIG_CACHE_RECORD_SIZE + blob_size;
+    
+    if (cache_get_u32(map) != IO_CONFIG_CACHE_MAGIC ||
+        cache_get_u32(map + 4) != IO_CONFIG_CACHE_VERSION ||
+        cache_get_u64(map + 16) != source_hash ||
+        cache_get_u64(map + 24) != source_size ||
+        expected != map_size) {
+        munmap((void*)map, map_size);
+        return ERR_NOT_FOUND;
+    }
+    
+    IOPointConfig* configs = NULL;
+    if (count > 0) {
+        configs = (IOPointConfig*)mmgr_alloc(sizeof(IOPointConfig) * count);
+        if (!configs) {
+            munmap((void*)map, map_size);
+            return ERR_OUT_OF_MEMORY;
+        }
+    }
+    
+    const char* blob = (const char*)map + IO_CONFIG_CACHE_HEADER_SIZE +
+                       (size_t)count * IO_CONFIG_CACHE_RECORD_SIZE;
+    
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* r = map + IO_CONFIG_CACHE_HEADER_SIZE + (size_t)i * IO_CONFIG_CACHE_RECORD_SIZE;
+        IOPointConfig* c = &configs[i];
+        memset(c, 0, sizeof(IOPointConfig));
+        c->address.location = (IOLocation)r[0];
+        c->address.size = (IODataSize)r[1];
+        c->address.bit_offset = r[2];
+        c->device_type = (IODeviceType)r[3];
+        c->access_mode = (IOAccessMode)r[4];
+        c->enable_filter = r[5] != 0;
+        c->address.byte_offset = cache_get_u32(r + 8);
+        c->hardware_address = cache_get_u32(r + 12);
+        c->filter_samples = cache_get_u32(r + 16);
+        uint32_t path_offset = cache_get_u32(r + 20);
+        if (path_offset != IO_CONFIG_CACHE_NO_PATH &&
+            (path_offset >= blob_size || !memchr(blob + path_offset, '\0', blob_size - path_offset))) {
+            // 路径越界或没有结尾的 NUL：按损坏处理，回退到解析源文件
+            if (configs) mmgr_free(configs);
+            munmap((void*)map, map_size);
+            return ERR_NOT_FOUND;
+        }
+        // 路径直接指向映射区，io_manager_add_points 会复制
+        c->hardware_path = path_offset != IO_CONFIG_CACHE_NO_PATH ? (char*)blob + path_offset : NULL;
+        memcpy(&c->scale, r + 24, sizeof(double));
+        memcpy(&c->offset, r + 32, sizeof(double));
+        memcpy(&c->deadband, r + 40, sizeof(double));
+    }
+    
+    ErrorCode err = io_manager_add_points(mgr, configs, count, points_added);
+    
+    if (configs) mmgr_free(configs);
+    munmap((void*)map, map_size);
+    
+    return err;
+}
+
+/**
+ * @brief 通过二进制缓存加载配置
+ */
+ErrorCode io_manager_load_config_cached(IOManager* mgr, const char* config_file,
+                                        const char* cache_file) {
+    if (!mgr || !config_file) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    char default_cache[1024];
+    if (!cache_file) {
+        snprintf(default_cache, sizeof(default_cache), "%s.cache", config_file);
+        cache_file = default_cache;
+    }
+    
+    char* text = NULL;
+    size_t size = 0;
+    ErrorCode err = read_whole_file(config_file, &text, &size);
+    if (err != OK) {
+        fprintf(stderr, "错误：无法打开配置文件 '%s'\n", config_file);
+        return err;
+    }
+    
+    uint64_t source_hash = hash_source(text, size);
+    uint32_t points_added = 0;
+    
+    // 缓存命中：跳过文本解析
+    err = load_from_cache(mgr, cache_file, source_hash, size, &points_added);
+    if (err != ERR_NOT_FOUND) {
+        mmgr_free(text);
+        if (err != OK) {
+            return err;
+        }
+        return points_added > 0 ? OK : ERR_NOT_FOUND;
+    }
+    
+    // 缓存未命中：编译源文件并重写缓存
+    IOPointConfig* configs = NULL;
+    uint32_t count = 0;
+    err = parse_config_text(text, &configs, &count);
+    mmgr_free(text);
+    if (err != OK) {
+        return err;
+    }
+    
+    if (write_config_cache(cache_file, source_hash, size, configs, count) != OK) {
+        fprintf(stderr, "警告：无法写入 IO 配置缓存 '%s'\n", cache_file);
+    }
+    
+    err = io_manager_add_points(mgr, configs, count, &points_added);
+    io_config_free_compiled(configs, count);
+    
+    if (err != OK) {
+        return err;
+    }
     return points_added > 0 ? OK : ERR_NOT_FOUND;
 }
@@ -0,0 +1,479 @@
+/**
+ * @file io_trace.c
+ * @brief STVM I/O 输入记录与回放
+ *
+ * 功能：
+ * - 在 io_manager_refresh_inputs() 中记录每次输入刷新
+ * - 紧凑的定长二进制轨迹格式（按扫描序号 O(1) 定位）
+ * - 通过 mmap 回放轨迹，按刷新计数确定性地驱动输入
+ *
+ * 文件格式（小端，字段均按字节打包）：
+ *   文件头   : magic(4) ver_major(2) ver_minor(2) column_count(4)
+ *              record_size(4) start_time_us(8)
+ *   列表     : column_count × { location(1) size(1) bit_offset(1)
+ *              reserved(1) byte_offset(4) }
+ *   扫描记录 : { scan(8) timestamp_us(8) column_count × 样本 }
+ *   样本     : type(1) quality(1) payload(8)
+ *
+ * 扫描记录数由文件大小推算，记录过程中异常退出也能回放已写入的部分。
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "iomgr.h"
+#include "mmgr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// ============================================================================
+// 格式定义
+// ============================================================================
+
+#define IO_TRACE_MAGIC          0x54495453  // "STIT"
+#define IO_TRACE_VERSION_MAJOR  1
+#define IO_TRACE_VERSION_MINOR  0
+
+#define IO_TRACE_HEADER_SIZE    24
+#define IO_TRACE_COLUMN_SIZE    8
+#define IO_TRACE_RECORD_HEAD    16
+#define IO_TRACE_SAMPLE_SIZE    10
+
+struct IOTraceRecorder {
+    FILE* fp;
+    IOPoint** columns;          // 记录列（开始记录时的输入点）
+    uint32_t column_count;
+    uint8_t* record_buf;        // 单条扫描记录缓冲区
+    uint32_t record_size;
+    uint64_t start_time_us;
+    uint64_t scan_count;
+};
+
+struct IOTraceReplay {
+    int fd;
+    const uint8_t* map;         // 只读映射
+    size_t map_size;
+    uint32_t column_count;
+    uint32_t record_size;
+    uint64_t scan_count;
+    const uint8_t* records;     // 第一条扫描记录
+    IOAddress* addresses;       // 每列的 I/O 地址
+    IOPoint** points;           // 挂接后每列对应的 I/O 点
+};
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+/**
+ * @brief 获取单调时钟（微秒）
+ */
+static uint64_t trace_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void put_u16(uint8_t* p, uint16_t v) { memcpy(p, &v, sizeof(v)); }
+static void put_u32(uint8_t* p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+static void put_u64(uint8_t* p, uint64_t v) { memcpy(p, &v, sizeof(v)); }
+static uint16_t get_u16(const uint8_t* p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+static uint32_t get_u32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+static uint64_t get_u64(const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+/**
+ * @brief 将值编码为 10 字节样本
+ */
+static void encode_sample(uint8_t* p, const Value* value) {
+    p[0] = (uint8_t)value->type;
+    p[1] = (uint8_t)value->quality;
+    switch (value->type) {
+        case TYPE_REAL:
+        case TYPE_QREAL:
+            memcpy(p + 2, &value->real_val, sizeof(double));
+            break;
+        case TYPE_BOOL:
+        case TYPE_QBOOL:
+            put_u64(p + 2, value->bool_val ? 1 : 0);
+            break;
+        default:
+            put_u64(p + 2, (uint64_t)(int64_t)value->int_val);
+            break;
+    }
+}
+
+/**
+ * @brief 从 10 字节样本解码值
+ */
+static void decode_sample(const uint8_t* p, Value* value) {
+    memset(value, 0, sizeof(Value));
+    value->type = (DataType)p[0];
+    value->quality = (QualityFlag)p[1];
+    switch (value->type) {
+        case TYPE_REAL:
+        case TYPE_QREAL:
+            memcpy(&value->real_val, p + 2, sizeof(double));
+            break;
+        case TYPE_BOOL:
+        case TYPE_QBOOL:
+            value->bool_val = get_u64(p + 2) != 0;
+            break;
+        default:
+            value->int_val = (int32_t)(int64_t)get_u64(p + 2);
+            break;
+    }
+}
+
+// ============================================================================
+// 记录
+// ============================================================================
+
+/**
+ * @brief 开始记录输入刷新
+ */
+ErrorCode io_trace_start_recording(IOManager* mgr, const char* trace_file) {
+    if (!mgr || !trace_file) {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    if (mgr->trace_recorder) {
+        return ERR_ALREADY_EXISTS;
+    }
+
+    IOTraceRecorder* rec = (IOTraceRecorder*)mmgr_alloc(sizeof(IOTraceRecorder));
+    if (!rec) {
+        return ERR_OUT_OF_MEMORY;
+    }
+    memset(rec, 0, sizeof(IOTraceRecorder));
+
+    pthread_mutex_lock(&mgr->mgr_mutex);
+
+    // 收集输入点作为记录列
+    for (uint32_t i = 0; i < mgr->point_count; i++) {
+        if (mgr->io_points[i] && mgr->io_points[i]->config.address.location == IO_LOC_INPUT) {
+            rec->column_count++;
+        }
+    }
+
+    if (rec->column_count > 0) {
+        rec->columns = (IOPoint**)mmgr_alloc(sizeof(IOPoint*) * rec->column_count);
+        if (!rec->columns) {
+            pthread_mutex_unlock(&mgr->mgr_mutex);
+            mmgr_free(rec);
+            return ERR_OUT_OF_MEMORY;
+        }
+        uint32_t col = 0;
+        for (uint32_t i = 0; i < mgr->point_count; i++) {
+            IOPoint* point = mgr->io_points[i];
+            if (point && point->config.address.location == IO_LOC_INPUT) {
+                rec->columns[col++] = point;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+
+    rec->record_size = IO_TRACE_RECORD_HEAD + rec->column_count * IO_TRACE_SAMPLE_SIZE;
+    rec->record_buf = (uint8_t*)mmgr_alloc(rec->record_size);
+    if (!rec->record_buf) {
+        if (rec->columns) mmgr_free(rec->columns);
+        mmgr_free(rec);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    rec->fp = fopen(trace_file, "wb");
+    if (!rec->fp) {
+        mmgr_free(rec->record_buf);
+        if (rec->columns) mmgr_free(rec->columns);
+        mmgr_free(rec);
+        return ERR_FILE_IO;
+    }
+
+    rec->start_time_us = trace_time_us();
+
+    // 写入文件头和列表
+    uint8_t header[IO_TRACE_HEADER_SIZE];
+    put_u32(header, IO_TRACE_MAGIC);
+    put_u16(header + 4, IO_TRACE_VERSION_MAJOR);
+    put_u16(header + 6, IO_TRACE_VERSION_MINOR);
+    put_u32(header + 8, rec->column_count);
+    put_u32(header + 12, rec->record_size);
+    put_u64(header + 16, rec->start_time_us);
+
+    bool ok = fwrite(header, sizeof(header), 1, rec->fp) == 1;
+
+    for (uint32_t i = 0; ok && i < rec->column_count; i++) {
+        const IOAddress* addr = &rec->columns[i]->config.address;
+        uint8_t column[IO_TRACE_COLUMN_SIZE];
+        column[0] = (uint8_t)addr->location;
+        column[1] = (uint8_t)addr->size;
+        column[2] = addr->bit_offset;
+        column[3] = 0;
+        put_u32(column + 4, addr->byte_offset);
+        ok = fwrite(column, sizeof(column), 1, rec->fp) == 1;
+    }
+
+    if (!ok) {
+        fclose(rec->fp);
+        mmgr_free(rec->record_buf);
+        if (rec->columns) mmgr_free(rec->columns);
+        mmgr_free(rec);
+        return ERR_FILE_IO;
+    }
+
+    mgr->trace_recorder = rec;
+
+    return OK;
+}
+
+/**
+ * @brief 停止记录并关闭轨迹文件
+ */
+ErrorCode io_trace_stop_recording(IOManager* mgr) {
+    if (!mgr) {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    IOTraceRecorder* rec = mgr->trace_recorder;
+    if (!rec) {
+        return OK;
+    }
+
+    mgr->trace_recorder = NULL;
+
+    ErrorCode result = (fclose(rec->fp) == 0) ? OK : ERR_FILE_IO;
+
+    mmgr_free(rec->record_buf);
+    if (rec->columns) mmgr_free(rec->columns);
+    mmgr_free(rec);
+
+    return result;
+}
+
+/**
+ * @brief 追加一条扫描记录
+ *
+ * 整条记录先在缓冲区中编码，再用一次 fwrite 写出，避免在刷新路径上
+ * 产生逐字段的 I/O 调用。
+ */
+ErrorCode io_trace_record_scan(IOManager* mgr) {
+    IOTraceRecorder* rec = mgr ? mgr->trace_recorder : NULL;
+    if (!rec) {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    put_u64(rec->record_buf, rec->scan_count);
+    put_u64(rec->record_buf + 8, trace_time_us() - rec->start_time_us);
+
+    uint8_t* sample = rec->record_buf + IO_TRACE_RECORD_HEAD;
+    for (uint32_t i = 0; i < rec->column_count; i++) {
+        IOPoint* point = rec->columns[i];
+        pthread_mutex_lock(&point->mutex);
+        encode_sample(sample, &point->current_value);
+        pthread_mutex_unlock(&point->mutex);
+        sample += IO_TRACE_SAMPLE_SIZE;
+    }
+
+    if (fwrite(rec->record_buf, rec->record_size, 1, rec->fp) != 1) {
+        return ERR_FILE_IO;
+    }
+
+    rec->scan_count++;
+
+    return OK;
+}
+
+// ============================================================================
+// 回放
+// ============================================================================
+
+/**
+ * @brief 以 mmap 方式打开轨迹文件
+ */
+IOTraceReplay* io_trace_replay_open(const char* trace_file) {
+    if (!trace_file) {
+        return NULL;
+    }
+
+    int fd = open(trace_file, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < IO_TRACE_HEADER_SIZE) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t map_size = (size_t)st.st_size;
+    const uint8_t* map = (const uint8_t*)mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    // 校验文件头
+    uint32_t column_count = get_u32(map + 8);
+    uint32_t record_size = get_u32(map + 12);
+    size_t data_offset = IO_TRACE_HEADER_SIZE + (size_t)column_count * IO_TRACE_COLUMN_SIZE;
+
+    if (get_u32(map) != IO_TRACE_MAGIC ||
+        get_u16(map + 4) != IO_TRACE_VERSION_MAJOR ||
+        record_size != IO_TRACE_RECORD_HEAD + column_count * IO_TRACE_SAMPLE_SIZE ||
+        data_offset > map_size) {
+        munmap((void*)map, map_size);
+        close(fd);
+        return NULL;
+    }
+
+    IOTraceReplay* replay = (IOTraceReplay*)mmgr_alloc(sizeof(IOTraceReplay));
+    if (!replay) {
+        munmap((void*)map, map_size);
+        close(fd);
+        return NULL;
+    }
+    memset(replay, 0, sizeof(IOTraceReplay));
+
+    replay->fd = fd;
+    replay->map = map;
+    replay->map_size = map_size;
+    replay->column_count = column_count;
+    replay->record_size = record_size;
+    replay->records = map + data_offset;
+    // 只计算完整的记录，忽略尾部被截断的部分
+    replay->scan_count = (map_size - data_offset) / record_size;
+
+    if (column_count > 0) {
+        replay->addresses = (IOAddress*)mmgr_alloc(sizeof(IOAddress) * column_count);
+        replay->points = (IOPoint**)mmgr_alloc(sizeof(IOPoint*) * column_count);
+        if (!replay->addresses || !replay->points) {
+            io_trace_replay_close(replay);
+            return NULL;
+        }
+        memset(replay->points, 0, sizeof(IOPoint*) * column_count);
+
+        const uint8_t* column = map + IO_TRACE_HEADER_SIZE;
+        for (uint32_t i = 0; i < column_count; i++) {
+            replay->addresses[i].location = (IOLocation)column[0];
+            replay->addresses[i].size = (IODataSize)column[1];
+            replay->addresses[i].bit_offset = column[2];
+            replay->addresses[i].byte_offset = get_u32(column + 4);
+            column += IO_TRACE_COLUMN_SIZE;
+        }
+    }
+
+    return replay;
+}
+
+/**
+ * @brief 关闭回放并解除映射
+ */
+void io_trace_replay_close(IOTraceReplay* replay) {
+    if (!replay) {
+        return;
+    }
+
+    if (replay->addresses) mmgr_free(replay->addresses);
+    if (replay->points) mmgr_free(replay->points);
+    munmap((void*)replay->map, replay->map_size);
+    close(replay->fd);
+    mmgr_free(replay);
+}
+
+/**
+ * @brief 获取扫描记录数
+ */
+uint64_t io_trace_replay_scan_count(const IOTraceReplay* replay) {
+    return replay ? replay->scan_count : 0;
+}
+
+/**
+ * @brief 获取列数
+ */
+uint32_t io_trace_replay_column_count(const IOTraceReplay* replay) {
+    return replay ? replay->column_count : 0;
+}
+
+/**
+ * @brief 读取指定扫描、指定列的记录值
+ */
+ErrorCode io_trace_replay_get(const IOTraceReplay* replay, uint64_t scan, uint32_t column,
+                              Value* value, uint64_t* timestamp_us) {
+    if (!replay || !value) {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    if (scan >= replay->scan_count || column >= replay->column_count) {
+        return ERR_OUT_OF_BOUNDS;
+    }
+
+    const uint8_t* record = replay->records + scan * replay->record_size;
+    if (timestamp_us) {
+        *timestamp_us = get_u64(record + 8);
+    }
+    decode_sample(record + IO_TRACE_RECORD_HEAD + column * IO_TRACE_SAMPLE_SIZE, value);
+
+    return OK;
+}
+
+/**
+ * @brief 将回放源挂接到 I/O 管理器
+ */
+ErrorCode io_manager_attach_replay(IOManager* mgr, IOTraceReplay* replay) {
+    if (!mgr) {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    pthread_mutex_lock(&mgr->mgr_mutex);
+
+    if (replay) {
+        // 按地址将轨迹列映射到当前的输入点，未配置的列在回放时跳过
+        for (uint32_t i = 0; i < replay->column_count; i++) {
+            replay->points[i] = io_manager_find_point(mgr, &replay->addresses[i]);
+        }
+    }
+
+    mgr->trace_replay = replay;
+    mgr->replay_base_cycle = mgr->scan_count;
+
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+
+    return OK;
+}
+
+/**
+ * @brief 用当前扫描的记录填充输入
+ *
+ * 记录序号 = 当前刷新次数 - 挂接时的刷新次数，与墙钟时间和统计重置无关。
+ * 轨迹耗尽后输入保持最后一次的值，返回 ERR_OUT_OF_BOUNDS。
+ */
+ErrorCode io_trace_replay_scan(IOManager* mgr) {
+    IOTraceReplay* replay = mgr ? mgr->trace_replay : NULL;
+    if (!replay) {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    uint64_t scan = mgr->scan_count - mgr->replay_base_cycle;
+    if (scan >= replay->scan_count) {
+        return ERR_OUT_OF_BOUNDS;
+    }
+
+    const uint8_t* sample = replay->records + scan * replay->record_size + IO_TRACE_RECORD_HEAD;
+    for (uint32_t i = 0; i < replay->column_count; i++) {
+        IOPoint* point = replay->points[i];
+        if (point) {
+            pthread_mutex_lock(&point->mutex);
+            decode_sample(sample, &point->current_value);
+            pthread_mutex_unlock(&point->mutex);
+        }
+        sample += IO_TRACE_SAMPLE_SIZE;
+    }
+
+    return OK;
+}
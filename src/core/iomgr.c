@@ -10,6 +10,9 @@
  * - 统计与诊断
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE     // CPU_SET / pthread_attr_setaffinity_np
+#endif
 #define _POSIX_C_SOURCE 200809L
 
 #include "iomgr.h"
@@ -22,6 +25,12 @@
 #include <time.h>
 #include <unistd.h>
 #include <math.h>
+#include <sched.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+// 查找表槽位上限（超出的地址走遍历查找）
+#define IO_LOOKUP_MAX_SLOTS (1u << 18)
 
 // ============================================================================
 // 辅助函数
@@ -58,6 +67,31 @@ static void log_message(IOManager* mgr, const char* level, const char* fmt, ...)
     }
 }
 
+/**
+ * @brief 按点容量调整变化位图大小（保持已有位）
+ */
+static ErrorCode cos_ensure_bitmap(IOManager* mgr, uint32_t point_capacity) {
+    uint32_t words = (point_capacity + 63) / 64;
+    if (words <= mgr->cos.bitmap_words) {
+        return OK;
+    }
+    
+    uint64_t* bitmap = (uint64_t*)mmgr_alloc(sizeof(uint64_t) * words);
+    if (!bitmap) {
+        return ERR_OUT_OF_MEMORY;
+    }
+    
+    memset(bitmap, 0, sizeof(uint64_t) * words);
+    if (mgr->cos.bitmap) {
+        memcpy(bitmap, mgr->cos.bitmap, sizeof(uint64_t) * mgr->cos.bitmap_words);
+        mmgr_free(mgr->cos.bitmap);
+    }
+    mgr->cos.bitmap = bitmap;
+    mgr->cos.bitmap_words = words;
+    
+    return OK;
+}
+
 // ============================================================================
 // I/O 地址解析
 // ============================================================================
@@ -193,7 +227,7 @@ IOManager* io_manager_create(IOHardwareAdapter* hal_adapter) {
     }
     
     // 初始化查找表
-    mgr->lookup.input_size = 256;  // 假设最多 256 个输入字节
+    mgr->lookup.input_size = 256;  // 槽位数（byte_offset * 8 + bit_offset），按需扩展
     mgr->lookup.output_size = 256;
     mgr->lookup.memory_size = 1024;
     
@@ -201,7 +235,9 @@ IOManager* io_manager_create(IOHardwareAdapter* hal_adapter) {
     mgr->lookup.outputs = (IOPoint**)mmgr_alloc(sizeof(IOPoint*) * mgr->lookup.output_size);
     mgr->lookup.memory = (IOPoint**)mmgr_alloc(sizeof(IOPoint*) * mgr->lookup.memory_size);
     
-    if (!mgr->lookup.inputs || !mgr->lookup.outputs || !mgr->lookup.memory) {
+    if (!mgr->lookup.inputs || !mgr->lookup.outputs || !mgr->lookup.memory ||
+        cos_ensure_bitmap(mgr, mgr->point_capacity) != OK) {
+        if (mgr->cos.bitmap) mmgr_free(mgr->cos.bitmap);
         if (mgr->lookup.inputs) mmgr_free(mgr->lookup.inputs);
         if (mgr->lookup.outputs) mmgr_free(mgr->lookup.outputs);
         if (mgr->lookup.memory) mmgr_free(mgr->lookup.memory);
@@ -214,6 +250,10 @@ IOManager* io_manager_create(IOHardwareAdapter* hal_adapter) {
     memset(mgr->lookup.outputs, 0, sizeof(IOPoint*) * mgr->lookup.output_size);
     memset(mgr->lookup.memory, 0, sizeof(IOPoint*) * mgr->lookup.memory_size);
     
+    // 默认不启用实时属性
+    mgr->rt_config.cpu_affinity = -1;
+    mgr->rt_config.sched_policy = SCHED_OTHER;
+    
     // 初始化互斥锁
     pthread_mutex_init(&mgr->mgr_mutex, NULL);
     
@@ -243,6 +283,11 @@ void io_manager_free(IOManager* mgr) {
         io_manager_stop_refresh(mgr);
     }
     
+    // 关闭输入记录
+    if (mgr->trace_recorder) {
+        io_trace_stop_recording(mgr);
+    }
+    
     // 释放所有 I/O 点
     for (uint32_t i = 0; i < mgr->point_count; i++) {
         IOPoint* point = mgr->io_points[i];
@@ -277,6 +322,13 @@ void io_manager_free(IOManager* mgr) {
     // 释放 I/O 点数组
     if (mgr->io_points) mmgr_free(mgr->io_points);
     
+    // 释放变化检测数据
+    if (mgr->cos.bitmap) mmgr_free(mgr->cos.bitmap);
+    if (mgr->cos.work) mmgr_free(mgr->cos.work);
+    if (mgr->cos.events) mmgr_free(mgr->cos.events);
+    if (mgr->cos.dispatch) mmgr_free(mgr->cos.dispatch);
+    if (mgr->cos.subs) mmgr_free(mgr->cos.subs);
+    
     // 清理 HAL 适配器
     if (mgr->hal_adapter && mgr->hal_adapter->cleanup) {
         mgr->hal_adapter->cleanup(mgr->hal_adapter);
@@ -295,40 +347,110 @@ void io_manager_free(IOManager* mgr) {
 // ============================================================================
 
 /**
- * @brief 查找 I/O 点
+ * @brief 查找表槽位：byte_offset * 8 + bit_offset
+ *
+ * 同一字节内的不同位点各占一个槽位，避免位点之间相互冲突。
  */
-IOPoint* io_manager_find_point(IOManager* mgr, const IOAddress* addr) {
-    if (!mgr || !addr) {
-        return NULL;
-    }
-    
-    // 根据地址类型选择查找表
-    IOPoint** lookup_table = NULL;
-    uint32_t lookup_size = 0;
-    
-    switch (addr->location) {
+static uint64_t lookup_slot_index(const IOAddress* addr) {
+    return (uint64_t)addr->byte_offset * 8 + addr->bit_offset;
+}
+
+/**
+ * @brief 获取地址所属区域的查找表
+ */
+static bool lookup_table_for(IOManager* mgr, IOLocation location,
+                             IOPoint**** table, uint32_t** size) {
+    switch (location) {
         case IO_LOC_INPUT:
-            lookup_table = mgr->lookup.inputs;
-            lookup_size = mgr->lookup.input_size;
-            break;
+            *table = &mgr->lookup.inputs;
+            *size = &mgr->lookup.input_size;
+            return true;
         case IO_LOC_OUTPUT:
-            lookup_table = mgr->lookup.outputs;
-            lookup_size = mgr->lookup.output_size;
-            break;
+            *table = &mgr->lookup.outputs;
+            *size = &mgr->lookup.output_size;
+            return true;
         case IO_LOC_MEMORY:
-            lookup_table = mgr->lookup.memory;
-            lookup_size = mgr->lookup.memory_size;
-            break;
+            *table = &mgr->lookup.memory;
+            *size = &mgr->lookup.memory_size;
+            return true;
         default:
-            return NULL;
+            return false;
+    }
+}
+
+/**
+ * @brief 扩展查找表以容纳指定槽位（超过上限的地址走遍历查找）
+ */
+static ErrorCode lookup_ensure(IOManager* mgr, IOLocation location, uint64_t slot) {
+    IOPoint*** table;
+    uint32_t* size;
+    
+    if (!lookup_table_for(mgr, location, &table, &size)) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    if (slot < *size || slot >= IO_LOOKUP_MAX_SLOTS) {
+        return OK;
+    }
+    
+    uint32_t new_size = *size ? *size : 64;
+    while (new_size <= slot) {
+        new_size *= 2;
+    }
+    if (new_size > IO_LOOKUP_MAX_SLOTS) {
+        new_size = IO_LOOKUP_MAX_SLOTS;
+    }
+    
+    IOPoint** new_table = (IOPoint**)mmgr_alloc(sizeof(IOPoint*) * new_size);
+    if (!new_table) {
+        return ERR_OUT_OF_MEMORY;
+    }
+    
+    memset(new_table, 0, sizeof(IOPoint*) * new_size);
+    if (*table) {
+        memcpy(new_table, *table, sizeof(IOPoint*) * (*size));
+        mmgr_free(*table);
+    }
+    *table = new_table;
+    *size = new_size;
+    
+    return OK;
+}
+
+/**
+ * @brief 获取地址对应的查找表槽位（不在表范围内返回 NULL）
+ */
+static IOPoint** lookup_slot(IOManager* mgr, const IOAddress* addr) {
+    IOPoint*** table;
+    uint32_t* size;
+    
+    if (!lookup_table_for(mgr, addr->location, &table, &size)) {
+        return NULL;
+    }
+    
+    uint64_t slot = lookup_slot_index(addr);
+    return slot < *size ? &(*table)[slot] : NULL;
+}
+
+/**
+ * @brief 查找 I/O 点
+ */
+IOPoint* io_manager_find_point(IOManager* mgr, const IOAddress* addr) {
+    if (!mgr || !addr) {
+        return NULL;
     }
     
     // 快速查找
-    if (addr->byte_offset < lookup_size) {
-        IOPoint* point = lookup_table[addr->byte_offset];
+    IOPoint** slot = lookup_slot(mgr, addr);
+    if (slot) {
+        IOPoint* point = *slot;
         if (point && io_address_equal(&point->config.address, addr)) {
             return point;
         }
+        // 槽位在表内且为空：地址不存在
+        if (!point) {
+            return NULL;
+        }
     }
     
     // 遍历查找（备用）
@@ -343,42 +465,55 @@ IOPoint* io_manager_find_point(IOManager* mgr, const IOAddress* addr) {
 }
 
 /**
- * @brief 添加 I/O 点
+ * @brief 调整 I/O 点数组容量（调用者持有 mgr_mutex）
  */
-ErrorCode io_manager_add_point(IOManager* mgr, const IOPointConfig* config) {
-    if (!mgr || !config) {
-        return ERR_INVALID_ARGUMENT;
+static ErrorCode reserve_points_locked(IOManager* mgr, uint32_t capacity) {
+    if (capacity <= mgr->point_capacity) {
+        return OK;
     }
     
-    pthread_mutex_lock(&mgr->mgr_mutex);
+    IOPoint** new_points = (IOPoint**)mmgr_alloc(sizeof(IOPoint*) * capacity);
+    if (!new_points || cos_ensure_bitmap(mgr, capacity) != OK) {
+        if (new_points) mmgr_free(new_points);
+        return ERR_OUT_OF_MEMORY;
+    }
+    
+    memcpy(new_points, mgr->io_points, sizeof(IOPoint*) * mgr->point_count);
+    mmgr_free(mgr->io_points);
+    mgr->io_points = new_points;
+    mgr->point_capacity = capacity;
     
+    return OK;
+}
+
+/**
+ * @brief 添加 I/O 点（调用者持有 mgr_mutex）
+ */
+static ErrorCode add_point_locked(IOManager* mgr, const IOPointConfig* config) {
     // 检查是否已存在
     if (io_manager_find_point(mgr, &config->address)) {
-        pthread_mutex_unlock(&mgr->mgr_mutex);
-        log_message(mgr, "ERROR", "I/O point already exists");
         return ERR_ALREADY_EXISTS;
     }
     
     // 检查容量
     if (mgr->point_count >= mgr->point_capacity) {
         // 扩容
-        uint32_t new_capacity = mgr->point_capacity * 2;
-        IOPoint** new_points = (IOPoint**)mmgr_alloc(sizeof(IOPoint*) * new_capacity);
-        if (!new_points) {
-            pthread_mutex_unlock(&mgr->mgr_mutex);
-            return ERR_OUT_OF_MEMORY;
+        ErrorCode err = reserve_points_locked(mgr, mgr->point_capacity * 2);
+        if (err != OK) {
+            return err;
         }
-        
-        memcpy(new_points, mgr->io_points, sizeof(IOPoint*) * mgr->point_count);
-        mmgr_free(mgr->io_points);
-        mgr->io_points = new_points;
-        mgr->point_capacity = new_capacity;
+    }
+    
+    // 确保查找表覆盖该地址
+    ErrorCode err = lookup_ensure(mgr, config->address.location,
+                                  lookup_slot_index(&config->address));
+    if (err != OK) {
+        return err;
     }
     
     // 创建 I/O 点
     IOPoint* point = (IOPoint*)mmgr_alloc(sizeof(IOPoint));
     if (!point) {
-        pthread_mutex_unlock(&mgr->mgr_mutex);
         return ERR_OUT_OF_MEMORY;
     }
     
@@ -387,7 +522,7 @@ ErrorCode io_manager_add_point(IOManager* mgr, const IOPointConfig* config) {
     
     // 复制硬件路径字符串
     if (config->hardware_path) {
-        point->config.hardware_path = strdup(config->hardware_path);
+        point->config.hardware_path = mmgr_strdup(config->hardware_path);
     }
     
     // 初始化互斥锁
@@ -400,7 +535,6 @@ ErrorCode io_manager_add_point(IOManager* mgr, const IOPointConfig* config) {
             pthread_mutex_destroy(&point->mutex);
             if (point->config.hardware_path) mmgr_free(point->config.hardware_path);
             mmgr_free(point);
-            pthread_mutex_unlock(&mgr->mgr_mutex);
             return ERR_OUT_OF_MEMORY;
         }
         memset(point->filter_buffer, 0, sizeof(Value) * config->filter_samples);
@@ -426,35 +560,108 @@ ErrorCode io_manager_add_point(IOManager* mgr, const IOPointConfig* config) {
     mgr->io_points[mgr->point_count++] = point;
     
     // 添加到查找表
-    IOPoint** lookup_table = NULL;
-    uint32_t lookup_size = 0;
+    IOPoint** slot = lookup_slot(mgr, &config->address);
+    if (slot) {
+        *slot = point;
+    }
     
-    switch (config->address.location) {
-        case IO_LOC_INPUT:
-            lookup_table = mgr->lookup.inputs;
-            lookup_size = mgr->lookup.input_size;
-            break;
-        case IO_LOC_OUTPUT:
-            lookup_table = mgr->lookup.outputs;
-            lookup_size = mgr->lookup.output_size;
-            break;
-        case IO_LOC_MEMORY:
-            lookup_table = mgr->lookup.memory;
-            lookup_size = mgr->lookup.memory_size;
-            break;
+    return OK;
+}
+
+/**
+ * @brief 添加 I/O 点
+ */
+ErrorCode io_manager_add_point(IOManager* mgr, const IOPointConfig* config) {
+    if (!mgr || !config) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    pthread_mutex_lock(&mgr->mgr_mutex);
+    ErrorCode err = add_point_locked(mgr, config);
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+    
+    if (err == ERR_ALREADY_EXISTS) {
+        log_message(mgr, "ERROR", "I/O point already exists");
+        return err;
+    }
+    
+    if (err == OK) {
+        char addr_str[32];
+        io_address_format(&config->address, addr_str, sizeof(addr_str));
+        log_message(mgr, "INFO", "I/O point added: %s", addr_str);
     }
     
-    if (lookup_table && config->address.byte_offset < lookup_size) {
-        lookup_table[config->address.byte_offset] = point;
+    return err;
+}
+
+/**
+ * @brief 预分配 I/O 点数组和查找表
+ */
+ErrorCode io_manager_reserve(IOManager* mgr, uint32_t point_count) {
+    if (!mgr) {
+        return ERR_INVALID_ARGUMENT;
     }
     
+    pthread_mutex_lock(&mgr->mgr_mutex);
+    ErrorCode err = reserve_points_locked(mgr, point_count);
     pthread_mutex_unlock(&mgr->mgr_mutex);
     
-    char addr_str[32];
-    io_address_format(&config->address, addr_str, sizeof(addr_str));
-    log_message(mgr, "INFO", "I/O point added: %s", addr_str);
+    return err;
+}
+
+/**
+ * @brief 批量添加 I/O 点
+ *
+ * 先按整个列表一次性确定点数组、变化位图和查找表的大小，再在一次加锁内
+ * 逐个插入；不逐点输出日志。重复地址被跳过并计入返回值之外。
+ */
+ErrorCode io_manager_add_points(IOManager* mgr, const IOPointConfig* configs, uint32_t count,
+                                uint32_t* added) {
+    if (!mgr || (!configs && count > 0)) {
+        return ERR_INVALID_ARGUMENT;
+    }
     
-    return OK;
+    // 统计各区域的最大槽位
+    uint64_t max_slot[3] = {0, 0, 0};
+    bool has_slot[3] = {false, false, false};
+    for (uint32_t i = 0; i < count; i++) {
+        const IOAddress* addr = &configs[i].address;
+        int region = addr->location == IO_LOC_INPUT ? 0 :
+                     addr->location == IO_LOC_OUTPUT ? 1 : 2;
+        uint64_t slot = lookup_slot_index(addr);
+        if (!has_slot[region] || slot > max_slot[region]) {
+            max_slot[region] = slot;
+            has_slot[region] = true;
+        }
+    }
+    
+    pthread_mutex_lock(&mgr->mgr_mutex);
+    
+    ErrorCode err = reserve_points_locked(mgr, mgr->point_count + count);
+    static const IOLocation regions[3] = {IO_LOC_INPUT, IO_LOC_OUTPUT, IO_LOC_MEMORY};
+    for (int r = 0; r < 3 && err == OK; r++) {
+        if (has_slot[r]) {
+            err = lookup_ensure(mgr, regions[r], max_slot[r]);
+        }
+    }
+    
+    uint32_t ok_count = 0;
+    for (uint32_t i = 0; i < count && err == OK; i++) {
+        ErrorCode point_err = add_point_locked(mgr, &configs[i]);
+        if (point_err == OK) {
+            ok_count++;
+        } else if (point_err != ERR_ALREADY_EXISTS) {
+            err = point_err;
+        }
+    }
+    
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+    
+    if (added) {
+        *added = ok_count;
+    }
+    
+    return err;
 }
 
 /**
@@ -475,26 +682,9 @@ ErrorCode io_manager_remove_point(IOManager* mgr, const IOAddress* addr) {
     }
     
     // 从查找表移除
-    IOPoint** lookup_table = NULL;
-    uint32_t lookup_size = 0;
-    
-    switch (addr->location) {
-        case IO_LOC_INPUT:
-            lookup_table = mgr->lookup.inputs;
-            lookup_size = mgr->lookup.input_size;
-            break;
-        case IO_LOC_OUTPUT:
-            lookup_table = mgr->lookup.outputs;
-            lookup_size = mgr->lookup.output_size;
-            break;
-        case IO_LOC_MEMORY:
-            lookup_table = mgr->lookup.memory;
-            lookup_size = mgr->lookup.memory_size;
-            break;
-    }
-    
-    if (lookup_table && addr->byte_offset < lookup_size) {
-        lookup_table[addr->byte_offset] = NULL;
+    IOPoint** slot = lookup_slot(mgr, addr);
+    if (slot && *slot == point) {
+        *slot = NULL;
     }
     
     // 从数组移除
@@ -521,6 +711,18 @@ ErrorCode io_manager_remove_point(IOManager* mgr, const IOAddress* addr) {
         }
     }
     
+    // 槽位被释放后，让共享同一槽位的其他点（如 %IW0 与 %IX0.0）重新占用
+    if (slot && *slot == NULL) {
+        for (uint32_t i = 0; i < mgr->point_count; i++) {
+            IOPoint* other = mgr->io_points[i];
+            if (other->config.address.location == addr->location &&
+                lookup_slot_index(&other->config.address) == lookup_slot_index(addr)) {
+                *slot = other;
+                break;
+            }
+        }
+    }
+    
     pthread_mutex_unlock(&mgr->mgr_mutex);
     
     char addr_str[32];
@@ -622,6 +824,157 @@ ErrorCode io_manager_write(IOManager* mgr, const IOAddress* addr, const Value* v
     return OK;
 }
 
+/**
+ * @brief 判断值相对上次上报是否超出死区
+ */
+static bool cos_value_changed(const Value* old_value, const Value* new_value, double deadband) {
+    if (old_value->type != new_value->type || old_value->quality != new_value->quality) {
+        return true;
+    }
+    
+    switch (new_value->type) {
+        case TYPE_REAL:
+        case TYPE_QREAL:
+            return fabs(new_value->real_val - old_value->real_val) > deadband;
+        case TYPE_INT:
+        case TYPE_QINT:
+            return fabs((double)new_value->int_val - (double)old_value->int_val) > deadband;
+        case TYPE_BOOL:
+        case TYPE_QBOOL:
+            return new_value->bool_val != old_value->bool_val;
+        default:
+            return memcmp(&new_value->int_val, &old_value->int_val, sizeof(int32_t)) != 0;
+    }
+}
+
+/**
+ * @brief 按点数调整刷新路径私有的工作位图与事件缓冲（只在刷新路径调用）
+ */
+static ErrorCode cos_ensure_work(IOManager* mgr, uint32_t point_count) {
+    uint32_t words = (point_count + 63) / 64;
+    if (words > mgr->cos.work_words) {
+        uint64_t* work = (uint64_t*)mmgr_alloc(sizeof(uint64_t) * words);
+        if (!work) {
+            return ERR_OUT_OF_MEMORY;
+        }
+        if (mgr->cos.work) mmgr_free(mgr->cos.work);
+        mgr->cos.work = work;
+        mgr->cos.work_words = words;
+    }
+    
+    if (point_count > mgr->cos.event_capacity) {
+        IOChangeEvent* events = (IOChangeEvent*)mmgr_alloc(sizeof(IOChangeEvent) * point_count);
+        if (!events) {
+            return ERR_OUT_OF_MEMORY;
+        }
+        if (mgr->cos.events) mmgr_free(mgr->cos.events);
+        mgr->cos.events = events;
+        mgr->cos.event_capacity = point_count;
+    }
+    
+    return OK;
+}
+
+/**
+ * @brief 计算本次刷新的变化位图，并向订阅者分发事件
+ *
+ * 死区以上次上报的值为基准，缓慢漂移累计超过死区后同样会上报。
+ * 位图和事件先写入刷新路径私有的缓冲，整次刷新只加一次 mgr_mutex：
+ * 发布位图快照并复制订阅列表，解锁后再分发事件，回调因此可以重入本模块。
+ * 读者在锁内复制，不会看到写了一半或已释放的位图。
+ */
+static void cos_detect_changes(IOManager* mgr) {
+    uint32_t point_count = mgr->point_count;
+    if (cos_ensure_work(mgr, point_count) != OK) {
+        log_message(mgr, "ERROR", "Out of memory in change detection");
+        return;
+    }
+    
+    uint32_t words = (point_count + 63) / 64;
+    uint64_t* work = mgr->cos.work;
+    IOChangeEvent* events = mgr->cos.events;
+    uint32_t changed = 0;
+    uint64_t cycle = mgr->stats.refresh_cycles;
+    memset(work, 0, sizeof(uint64_t) * words);
+    
+    for (uint32_t i = 0; i < point_count; i++) {
+        IOPoint* point = mgr->io_points[i];
+        
+        if (!point || point->config.address.location != IO_LOC_INPUT) {
+            continue;
+        }
+        
+        IOChangeEvent* event = &events[changed];
+        
+        pthread_mutex_lock(&point->mutex);
+        
+        bool is_changed = !point->reported ||
+            cos_value_changed(&point->reported_value, &point->current_value,
+                              point->config.deadband);
+        
+        if (is_changed) {
+            event->old_value = point->reported_value;
+            event->new_value = point->current_value;
+            point->reported_value = point->current_value;
+            point->reported = true;
+        }
+        
+        pthread_mutex_unlock(&point->mutex);
+        
+        if (!is_changed) {
+            continue;
+        }
+        
+        work[i / 64] |= (uint64_t)1 << (i % 64);
+        event->point_index = i;
+        event->address = point->config.address;
+        event->refresh_cycle = cycle;
+        changed++;
+    }
+    
+    pthread_mutex_lock(&mgr->mgr_mutex);
+    
+    // 发布位图快照（已发布位图在加点时于同一把锁内扩容，不小于 words）
+    memcpy(mgr->cos.bitmap, work, sizeof(uint64_t) * words);
+    mgr->cos.published_words = words;
+    mgr->cos.changed_count = changed;
+    
+    // 订阅数组会被订阅/取消订阅重新分配，分发前复制一份
+    uint32_t sub_count = changed > 0 ? mgr->cos.sub_count : 0;
+    bool dispatch_oom = false;
+    if (sub_count > mgr->cos.dispatch_capacity) {
+        IOChangeSubscription* dispatch = (IOChangeSubscription*)mmgr_alloc(
+            sizeof(IOChangeSubscription) * mgr->cos.sub_capacity);
+        if (dispatch) {
+            if (mgr->cos.dispatch) mmgr_free(mgr->cos.dispatch);
+            mgr->cos.dispatch = dispatch;
+            mgr->cos.dispatch_capacity = mgr->cos.sub_capacity;
+        } else {
+            sub_count = 0;
+            dispatch_oom = true;
+        }
+    }
+    if (sub_count > 0) {
+        memcpy(mgr->cos.dispatch, mgr->cos.subs, sizeof(IOChangeSubscription) * sub_count);
+    }
+    
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+    
+    if (dispatch_oom) {
+        log_message(mgr, "ERROR", "Out of memory dispatching change events");
+    }
+    
+    for (uint32_t e = 0; e < changed && sub_count > 0; e++) {
+        for (uint32_t j = 0; j < sub_count; j++) {
+            const IOChangeSubscription* sub = &mgr->cos.dispatch[j];
+            if (sub->has_filter && !io_address_equal(&sub->filter, &events[e].address)) {
+                continue;
+            }
+            sub->callback(&events[e], sub->user_data);
+        }
+    }
+}
+
 /**
  * @brief 刷新输入（从硬件读取到缓存）
  */
@@ -632,6 +985,18 @@ ErrorCode io_manager_refresh_inputs(IOManager* mgr) {
     
     ErrorCode result = OK;
     
+    // 回放模式：输入来自轨迹文件，不访问硬件
+    if (mgr->trace_replay) {
+        result = io_trace_replay_scan(mgr);
+        if (mgr->trace_recorder) {
+            io_trace_record_scan(mgr);
+        }
+        cos_detect_changes(mgr);
+        mgr->stats.refresh_cycles++;
+        mgr->scan_count++;
+        return result;
+    }
+    
     for (uint32_t i = 0; i < mgr->point_count; i++) {
         IOPoint* point = mgr->io_points[i];
         
@@ -681,7 +1046,19 @@ ErrorCode io_manager_refresh_inputs(IOManager* mgr) {
         pthread_mutex_unlock(&point->mutex);
     }
     
+    // 记录本次刷新结果
+    if (mgr->trace_recorder) {
+        ErrorCode rec_err = io_trace_record_scan(mgr);
+        if (rec_err != OK && result == OK) {
+            result = rec_err;
+        }
+    }
+    
+    // 变化检测与事件分发
+    cos_detect_changes(mgr);
+    
     mgr->stats.refresh_cycles++;
+    mgr->scan_count++;
     
     return result;
 }
@@ -732,16 +1109,97 @@ ErrorCode io_manager_refresh_outputs(IOManager* mgr) {
 // 自动刷新线程
 // ============================================================================
 
+/**
+ * @brief 时间值转换为微秒
+ */
+static uint64_t timespec_to_us(const struct timespec* ts) {
+    return (uint64_t)ts->tv_sec * 1000000 + (uint64_t)ts->tv_nsec / 1000;
+}
+
+/**
+ * @brief 将时间值推进指定微秒数
+ */
+static void timespec_add_us(struct timespec* ts, uint64_t us) {
+    ts->tv_sec += (time_t)(us / 1000000);
+    ts->tv_nsec += (long)(us % 1000000) * 1000;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_nsec -= 1000000000L;
+        ts->tv_sec++;
+    }
+}
+
+/**
+ * @brief 微秒值对应的直方图桶（2 的幂分桶）
+ */
+static uint32_t timing_bucket(uint64_t us) {
+    if (us == 0) {
+        return 0;
+    }
+    uint32_t bucket = 64 - (uint32_t)__builtin_clzll(us);
+    return bucket < IO_TIMING_HIST_BUCKETS ? bucket : IO_TIMING_HIST_BUCKETS - 1;
+}
+
+/**
+ * @brief 无锁更新最大值（仅刷新线程写入）
+ */
+static void timing_update_max(uint64_t* slot, uint64_t value) {
+    if (value > __atomic_load_n(slot, __ATOMIC_RELAXED)) {
+        __atomic_store_n(slot, value, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief 逐字段原子清零时序统计（刷新线程可能正在更新）
+ *
+ * realtime_applied 由刷新线程启动时写入，不属于计数，保持不变。
+ */
+static void timing_reset(IOTimingStats* timing) {
+    for (uint32_t i = 0; i < IO_TIMING_HIST_BUCKETS; i++) {
+        __atomic_store_n(&timing->latency_hist[i], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&timing->jitter_hist[i], 0, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&timing->cycles, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&timing->overruns, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&timing->max_latency_us, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&timing->max_jitter_us, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&timing->max_exec_us, 0, __ATOMIC_RELAXED);
+}
+
 /**
  * @brief 自动刷新线程函数
+ *
+ * 按绝对截止时刻 (clock_nanosleep + TIMER_ABSTIME) 调度，周期不会因
+ * 刷新耗时而累积漂移。热路径上只做原子计数，不做格式化输出。
  */
 static void* refresh_thread_func(void* arg) {
     IOManager* mgr = (IOManager*)arg;
+    IOTimingStats* timing = &mgr->timing;
     
-    log_message(mgr, "INFO", "Refresh thread started (cycle: %u us)", mgr->refresh_cycle_us);
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    uint64_t last_wake_us = timespec_to_us(&deadline);
+    bool first_cycle = true;
     
     while (mgr->auto_refresh) {
-        uint64_t start_time = get_time_us();
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t wake_us = timespec_to_us(&now);
+        
+        // 唤醒延迟与周期抖动
+        uint64_t deadline_us = timespec_to_us(&deadline);
+        uint64_t latency = wake_us > deadline_us ? wake_us - deadline_us : 0;
+        __atomic_fetch_add(&timing->latency_hist[timing_bucket(latency)], 1, __ATOMIC_RELAXED);
+        timing_update_max(&timing->max_latency_us, latency);
+        
+        if (!first_cycle) {
+            uint64_t period = wake_us - last_wake_us;
+            uint64_t jitter = period > mgr->refresh_cycle_us ?
+                period - mgr->refresh_cycle_us : mgr->refresh_cycle_us - period;
+            __atomic_fetch_add(&timing->jitter_hist[timing_bucket(jitter)], 1, __ATOMIC_RELAXED);
+            timing_update_max(&timing->max_jitter_us, jitter);
+        }
+        first_cycle = false;
+        last_wake_us = wake_us;
         
         // 刷新输入
         io_manager_refresh_inputs(mgr);
@@ -750,27 +1208,96 @@ static void* refresh_thread_func(void* arg) {
         io_manager_refresh_outputs(mgr);
         
         // 计算耗时
-        uint64_t elapsed = get_time_us() - start_time;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        uint64_t end_us = timespec_to_us(&now);
+        timing_update_max(&timing->max_exec_us, end_us - wake_us);
+        __atomic_fetch_add(&timing->cycles, 1, __ATOMIC_RELAXED);
         
-        // 睡眠剩余时间
-        if (elapsed < mgr->refresh_cycle_us) {
-            uint64_t sleep_us = mgr->refresh_cycle_us - elapsed;
-            struct timespec ts = {
-                .tv_sec = sleep_us / 1000000,
-                .tv_nsec = (sleep_us % 1000000) * 1000
-            };
-            nanosleep(&ts, NULL);
-        } else {
-            log_message(mgr, "WARNING", "Refresh cycle overrun: %lu us (limit: %u us)",
-                       elapsed, mgr->refresh_cycle_us);
+        // 推进到下一个绝对截止时刻；超限时跳过已错过的周期，重新对齐
+        timespec_add_us(&deadline, mgr->refresh_cycle_us);
+        if (timespec_to_us(&deadline) <= end_us) {
+            __atomic_fetch_add(&timing->overruns, 1, __ATOMIC_RELAXED);
+            deadline = now;
+            timespec_add_us(&deadline, mgr->refresh_cycle_us);
+        }
+        
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+            // 被信号打断，继续等待同一截止时刻
         }
     }
     
-    log_message(mgr, "INFO", "Refresh thread stopped");
-    
     return NULL;
 }
 
+/**
+ * @brief 按实时配置构造线程属性
+ * @return 是否成功应用全部实时属性
+ */
+static bool build_realtime_attr(IOManager* mgr, pthread_attr_t* attr) {
+    const IORealtimeConfig* rt = &mgr->rt_config;
+    bool ok = true;
+    
+    if (rt->sched_policy != SCHED_OTHER) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = rt->sched_priority;
+        
+        ok = pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) == 0 &&
+             pthread_attr_setschedpolicy(attr, rt->sched_policy) == 0 &&
+             pthread_attr_setschedparam(attr, &param) == 0;
+    }
+    
+#ifdef __linux__
+    if (ok && rt->cpu_affinity >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(rt->cpu_affinity, &cpus);
+        ok = pthread_attr_setaffinity_np(attr, sizeof(cpus), &cpus) == 0;
+    }
+#endif
+    
+    return ok;
+}
+
+/**
+ * @brief 设置刷新线程实时属性
+ */
+ErrorCode io_manager_set_realtime(IOManager* mgr, const IORealtimeConfig* config) {
+    if (!mgr || !config) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    if (mgr->auto_refresh) {
+        return ERR_RUNTIME;
+    }
+    
+    mgr->rt_config = *config;
+    
+    return OK;
+}
+
+/**
+ * @brief 获取刷新周期时序统计快照
+ */
+ErrorCode io_manager_get_timing_stats(IOManager* mgr, IOTimingStats* stats) {
+    if (!mgr || !stats) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    for (uint32_t i = 0; i < IO_TIMING_HIST_BUCKETS; i++) {
+        stats->latency_hist[i] = __atomic_load_n(&mgr->timing.latency_hist[i], __ATOMIC_RELAXED);
+        stats->jitter_hist[i] = __atomic_load_n(&mgr->timing.jitter_hist[i], __ATOMIC_RELAXED);
+    }
+    stats->cycles = __atomic_load_n(&mgr->timing.cycles, __ATOMIC_RELAXED);
+    stats->overruns = __atomic_load_n(&mgr->timing.overruns, __ATOMIC_RELAXED);
+    stats->max_latency_us = __atomic_load_n(&mgr->timing.max_latency_us, __ATOMIC_RELAXED);
+    stats->max_jitter_us = __atomic_load_n(&mgr->timing.max_jitter_us, __ATOMIC_RELAXED);
+    stats->max_exec_us = __atomic_load_n(&mgr->timing.max_exec_us, __ATOMIC_RELAXED);
+    stats->realtime_applied = mgr->timing.realtime_applied;
+    
+    return OK;
+}
+
 /**
  * @brief 启动自动刷新
  */
@@ -787,13 +1314,36 @@ ErrorCode io_manager_start_refresh(IOManager* mgr, uint32_t cycle_us) {
     mgr->refresh_cycle_us = cycle_us;
     mgr->auto_refresh = true;
     
-    // 创建线程
-    if (pthread_create(&mgr->refresh_thread, NULL, refresh_thread_func, mgr) != 0) {
+    // 锁定内存，避免刷新线程缺页
+    if (mgr->rt_config.lock_memory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        log_message(mgr, "WARNING", "mlockall failed, memory not locked");
+    }
+    
+    // 按实时配置创建线程，失败时退回默认属性
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    bool rt_ok = build_realtime_attr(mgr, &attr);
+    int rc = rt_ok ? pthread_create(&mgr->refresh_thread, &attr, refresh_thread_func, mgr) : -1;
+    pthread_attr_destroy(&attr);
+    
+    bool rt_requested = mgr->rt_config.sched_policy != SCHED_OTHER || mgr->rt_config.cpu_affinity >= 0;
+    mgr->timing.realtime_applied = (rc == 0) && rt_requested;
+    
+    if (rc != 0) {
+        if (rt_requested) {
+            log_message(mgr, "WARNING", "Real-time thread attributes rejected, using defaults");
+        }
+        rc = pthread_create(&mgr->refresh_thread, NULL, refresh_thread_func, mgr);
+    }
+    
+    if (rc != 0) {
         mgr->auto_refresh = false;
         log_message(mgr, "ERROR", "Failed to create refresh thread");
         return ERR_SYSTEM_ERROR;
     }
     
+    log_message(mgr, "INFO", "Refresh thread started (cycle: %u us)", mgr->refresh_cycle_us);
+    
     return OK;
 }
 
@@ -819,6 +1369,161 @@ ErrorCode io_manager_stop_refresh(IOManager* mgr) {
     return OK;
 }
 
+// ============================================================================
+// 变化检测与订阅
+// ============================================================================
+
+/**
+ * @brief 设置变化检测死区
+ */
+ErrorCode io_manager_set_deadband(IOManager* mgr, const IOAddress* addr, double deadband) {
+    if (!mgr || !addr || deadband < 0.0) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    IOPoint* point = io_manager_find_point(mgr, addr);
+    if (!point) {
+        return ERR_NOT_FOUND;
+    }
+    
+    pthread_mutex_lock(&point->mutex);
+    point->config.deadband = deadband;
+    pthread_mutex_unlock(&point->mutex);
+    
+    return OK;
+}
+
+/**
+ * @brief 订阅变化事件
+ */
+ErrorCode io_manager_subscribe(IOManager* mgr, const IOAddress* filter,
+                               IOChangeCallback callback, void* user_data, uint32_t* out_id) {
+    if (!mgr || !callback) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    pthread_mutex_lock(&mgr->mgr_mutex);
+    
+    // 检查容量
+    if (mgr->cos.sub_count >= mgr->cos.sub_capacity) {
+        uint32_t new_capacity = mgr->cos.sub_capacity ? mgr->cos.sub_capacity * 2 : 8;
+        IOChangeSubscription* new_subs = (IOChangeSubscription*)mmgr_alloc(
+            sizeof(IOChangeSubscription) * new_capacity);
+        if (!new_subs) {
+            pthread_mutex_unlock(&mgr->mgr_mutex);
+            return ERR_OUT_OF_MEMORY;
+        }
+        
+        if (mgr->cos.subs) {
+            memcpy(new_subs, mgr->cos.subs, sizeof(IOChangeSubscription) * mgr->cos.sub_count);
+            mmgr_free(mgr->cos.subs);
+        }
+        mgr->cos.subs = new_subs;
+        mgr->cos.sub_capacity = new_capacity;
+    }
+    
+    IOChangeSubscription* sub = &mgr->cos.subs[mgr->cos.sub_count++];
+    memset(sub, 0, sizeof(IOChangeSubscription));
+    sub->id = ++mgr->cos.next_sub_id;
+    sub->callback = callback;
+    sub->user_data = user_data;
+    if (filter) {
+        sub->has_filter = true;
+        sub->filter = *filter;
+    }
+    
+    if (out_id) {
+        *out_id = sub->id;
+    }
+    
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+    
+    return OK;
+}
+
+/**
+ * @brief 取消订阅
+ */
+ErrorCode io_manager_unsubscribe(IOManager* mgr, uint32_t id) {
+    if (!mgr) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    pthread_mutex_lock(&mgr->mgr_mutex);
+    
+    for (uint32_t i = 0; i < mgr->cos.sub_count; i++) {
+        if (mgr->cos.subs[i].id == id) {
+            // 移动后续元素
+            for (uint32_t j = i; j < mgr->cos.sub_count - 1; j++) {
+                mgr->cos.subs[j] = mgr->cos.subs[j + 1];
+            }
+            mgr->cos.sub_count--;
+            pthread_mutex_unlock(&mgr->mgr_mutex);
+            return OK;
+        }
+    }
+    
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+    
+    return ERR_NOT_FOUND;
+}
+
+/**
+ * @brief 复制最近一次刷新的变化位图
+ */
+ErrorCode io_manager_copy_change_bitmap(IOManager* mgr, uint64_t* out, uint32_t max_words,
+                                        uint32_t* word_count) {
+    if (!mgr || (!out && max_words > 0)) {
+        return ERR_INVALID_ARGUMENT;
+    }
+    
+    pthread_mutex_lock(&mgr->mgr_mutex);
+    
+    uint32_t words = mgr->cos.published_words;
+    uint32_t copy = words < max_words ? words : max_words;
+    if (copy > 0) {
+        memcpy(out, mgr->cos.bitmap, sizeof(uint64_t) * copy);
+    }
+    if (word_count) {
+        *word_count = words;
+    }
+    
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+    
+    return OK;
+}
+
+/**
+ * @brief 最近一次刷新中指定点是否变化
+ */
+bool io_manager_point_changed(IOManager* mgr, uint32_t index) {
+    if (!mgr) {
+        return false;
+    }
+    
+    pthread_mutex_lock(&mgr->mgr_mutex);
+    bool changed = index / 64 < mgr->cos.published_words &&
+                   ((mgr->cos.bitmap[index / 64] >> (index % 64)) & 1);
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+    
+    return changed;
+}
+
+/**
+ * @brief 最近一次刷新变化的点数
+ */
+uint32_t io_manager_get_changed_count(IOManager* mgr) {
+    if (!mgr) {
+        return 0;
+    }
+    
+    pthread_mutex_lock(&mgr->mgr_mutex);
+    uint32_t count = mgr->cos.changed_count;
+    pthread_mutex_unlock(&mgr->mgr_mutex);
+    
+    return count;
+}
+
 // ============================================================================
 // 统计与诊断
 // ============================================================================
@@ -839,6 +1544,8 @@ void io_manager_reset_stats(IOManager* mgr) {
     mgr->stats.refresh_cycles = 0;
     mgr->stats.start_time_us = get_time_us();
     
+    timing_reset(&mgr->timing);
+    
     pthread_mutex_unlock(&mgr->mgr_mutex);
     
     log_message(mgr, "INFO", "Statistics reset");
@@ -0,0 +1,1125 @@
+/**
+ * @file ir.c
+ * @brief 中间表示 - 数据结构、控制流图分析、SSA 构造与打印
+ *
+ * SSA 构造采用经典做法：
+ * 1. Cooper-Harvey-Kennedy 迭代算法求支配树，由支配树求支配边界
+ * 2. 在变量定义块集合的迭代支配边界处插入 PHI
+ * 3. 沿支配树先序遍历重命名：变量读改写为当前定义，变量写压入新定义
+ * 4. 剪除无用 PHI（只被 PHI 使用的环也一并删除）和平凡 PHI（所有操作数相同）
+ *
+ * 所有可提升变量在入口块有一个默认值（0 / 0.0 / FALSE），
+ * 因此任何路径上的读取都有到达定义，不需要"未定义值"。
+ */
+
+#include "ir.h"
+#include "mmgr.h"
+#include <stdio.h>
+#include <string.h>
+
+#define IR_INITIAL_BLOCKS   8
+#define IR_INITIAL_INSTRS   8
+#define IR_INITIAL_REGS     16
+
+// ============================================================================
+// 构造与释放
+// ============================================================================
+
+static void free_block(IrBlock* block) {
+    if (!block) return;
+    for (uint32_t i = 0; i < block->instr_count; i++) {
+        mmgr_free(block->instrs[i].args);
+    }
+    mmgr_free(block->instrs);
+    mmgr_free(block->preds);
+    if (block->succs != block->succ_buf) mmgr_free(block->succs);
+    mmgr_free(block->cases);
+    mmgr_free(block);
+}
+
+static void free_function(IrFunction* func) {
+    if (!func) return;
+    for (uint32_t i = 0; i < func->block_count; i++) {
+        free_block(func->blocks[i]);
+    }
+    mmgr_free(func->blocks);
+    mmgr_free(func->reg_types);
+    mmgr_free(func->vars);
+    mmgr_free(func->loops);
+    mmgr_free(func->param_types);
+    mmgr_free(func->name);
+    mmgr_free(func);
+}
+
+IrModule* ir_module_create(void) {
+    return (IrModule*)mmgr_calloc(sizeof(IrModule));
+}
+
+void ir_module_free(IrModule* module) {
+    if (!module) return;
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        free_function(module->functions[i]);
+    }
+    mmgr_free(module->functions);
+    mmgr_free(module);
+}
+
+IrFunction* ir_function_add(IrModule* module, const char* name) {
+    if (!module || !name) return NULL;
+
+    if (module->function_count >= module->function_capacity) {
+        uint32_t capacity = module->function_capacity ? module->function_capacity * 2 : 8;
+        IrFunction** functions = (IrFunction**)mmgr_realloc(module->functions,
+                                                            sizeof(IrFunction*) * capacity);
+        if (!functions) return NULL;
+        module->functions = functions;
+        module->function_capacity = capacity;
+    }
+
+    IrFunction* func = (IrFunction*)mmgr_calloc(sizeof(IrFunction));
+    if (!func) return NULL;
+    func->name = mmgr_strdup(name);
+    func->return_type = TYPE_VOID;
+    func->return_offset = -1;
+    if (!func->name || !ir_block_create(func)) {
+        free_function(func);
+        return NULL;
+    }
+
+    module->functions[module->function_count++] = func;
+    return func;
+}
+
+IrFunction* ir_module_find_function(const IrModule* module, const char* name) {
+    if (!module || !name) return NULL;
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        if (strcmp(module->functions[i]->name, name) == 0) {
+            return module->functions[i];
+        }
+    }
+    return NULL;
+}
+
+IrBlock* ir_block_create(IrFunction* func) {
+    if (!func) return NULL;
+
+    if (func->block_count >= func->block_capacity) {
+        uint32_t capacity = func->block_capacity ? func->block_capacity * 2 : IR_INITIAL_BLOCKS;
+        IrBlock** blocks = (IrBlock**)mmgr_realloc(func->blocks, sizeof(IrBlock*) * capacity);
+        if (!blocks) return NULL;
+        func->blocks = blocks;
+        func->block_capacity = capacity;
+    }
+
+    IrBlock* block = (IrBlock*)mmgr_calloc(sizeof(IrBlock));
+    if (!block) return NULL;
+    block->id = func->block_count;
+    block->term = IR_TERM_NONE;
+    block->term_value = IR_NO_REG;
+    block->succs = block->succ_buf;
+    block->idom = -1;
+    block->rpo = -1;
+
+    func->blocks[func->block_count++] = block;
+    return block;
+}
+
+IrReg ir_new_reg(IrFunction* func, DataType type) {
+    if (!func) return IR_NO_REG;
+
+    if (func->reg_count >= func->reg_capacity) {
+        uint32_t capacity = func->reg_capacity ? func->reg_capacity * 2 : IR_INITIAL_REGS;
+        DataType* types = (DataType*)mmgr_realloc(func->reg_types, sizeof(DataType) * capacity);
+        if (!types) return IR_NO_REG;
+        func->reg_types = types;
+        func->reg_capacity = capacity;
+    }
+
+    func->reg_types[func->reg_count] = type;
+    return (IrReg)func->reg_count++;
+}
+
+/**
+ * @brief 在块的 position 处插入一条空指令，返回其指针
+ */
+static IrInstr* insert_instr(IrBlock* block, uint32_t position) {
+    if (block->instr_count >= block->instr_capacity) {
+        uint32_t capacity = block->instr_capacity ? block->instr_capacity * 2 : IR_INITIAL_INSTRS;
+        IrInstr* instrs = (IrInstr*)mmgr_realloc(block->instrs, sizeof(IrInstr) * capacity);
+        if (!instrs) return NULL;
+        block->instrs = instrs;
+        block->instr_capacity = capacity;
+    }
+
+    if (position < block->instr_count) {
+        memmove(&block->instrs[position + 1], &block->instrs[position],
+                sizeof(IrInstr) * (block->instr_count - position));
+    }
+    block->instr_count++;
+
+    IrInstr* ins = &block->instrs[position];
+    memset(ins, 0, sizeof(IrInstr));
+    ins->dest = IR_NO_REG;
+    ins->var.promoted = -1;
+    return ins;
+}
+
+/**
+ * @brief 在指定位置插入指令（type 非 VOID 时分配目标寄存器）
+ */
+static IrInstr* insert_at(IrFunction* func, IrBlock* block, uint32_t position, IrOp op,
+                          DataType type, const IrReg* args, uint32_t arg_count, int line) {
+    IrReg* arg_copy = NULL;
+    if (arg_count > 0) {
+        arg_copy = (IrReg*)mmgr_alloc(sizeof(IrReg) * arg_count);
+        if (!arg_copy) return NULL;
+        if (args) {
+            memcpy(arg_copy, args, sizeof(IrReg) * arg_count);
+        } else {
+            for (uint32_t i = 0; i < arg_count; i++) arg_copy[i] = IR_NO_REG;
+        }
+    }
+
+    IrReg dest = IR_NO_REG;
+    if (type != TYPE_VOID) {
+        dest = ir_new_reg(func, type);
+        if (dest == IR_NO_REG) {
+            mmgr_free(arg_copy);
+            return NULL;
+        }
+    }
+
+    IrInstr* ins = insert_instr(block, position);
+    if (!ins) {
+        mmgr_free(arg_copy);
+        return NULL;
+    }
+    ins->op = op;
+    ins->opcode = OP_NOP;
+    ins->type = type;
+    ins->dest = dest;
+    ins->args = arg_copy;
+    ins->arg_count = arg_count;
+    ins->line = line;
+    return ins;
+}
+
+IrInstr* ir_append(IrFunction* func, IrBlock* block, IrOp op, DataType type,
+                   const IrReg* args, uint32_t arg_count, int line) {
+    if (!func || !block) return NULL;
+    return insert_at(func, block, block->instr_count, op, type, args, arg_count, line);
+}
+
+void ir_terminate(IrBlock* block, IrTermKind kind, IrReg value,
+                  uint32_t succ0, uint32_t succ1, int line) {
+    if (!block || block->term != IR_TERM_NONE) return;
+
+    // 两个分支指向同一块的条件分支等价于无条件跳转
+    if (kind == IR_TERM_BR && succ0 == succ1) {
+        kind = IR_TERM_JMP;
+        value = IR_NO_REG;
+    }
+
+    block->term = kind;
+    block->term_value = value;
+    block->term_line = line;
+    block->succs[0] = succ0;
+    block->succs[1] = succ1;
+    switch (kind) {
+        case IR_TERM_JMP:       block->succ_count = 1; break;
+        case IR_TERM_BR:
+        case IR_TERM_FOR_INIT:
+        case IR_TERM_FOR_STEP:  block->succ_count = 2; break;
+        default:                block->succ_count = 0; break;
+    }
+}
+
+ErrorCode ir_terminate_switch(IrBlock* block, IrReg selector, SwitchKind kind,
+                              const SwitchCase* cases, uint32_t case_count,
+                              uint32_t default_block, int line) {
+    if (!block || !cases || case_count == 0) return ERR_RUNTIME;
+    if (block->term != IR_TERM_NONE) return OK;
+
+    // 后继：默认目标在前，其后是各不相同的分支目标
+    uint32_t* succs = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (case_count + 1));
+    SwitchCase* copy = (SwitchCase*)mmgr_alloc(sizeof(SwitchCase) * case_count);
+    if (!succs || !copy) {
+        mmgr_free(succs);
+        mmgr_free(copy);
+        return ERR_OUT_OF_MEMORY;
+    }
+    memcpy(copy, cases, sizeof(SwitchCase) * case_count);
+    uint32_t count = 0;
+    succs[count++] = default_block;
+    for (uint32_t i = 0; i < case_count; i++) {
+        uint32_t s = 0;
+        while (s < count && succs[s] != cases[i].target) s++;
+        if (s == count) succs[count++] = cases[i].target;
+    }
+
+    block->term = IR_TERM_SWITCH;
+    block->term_value = selector;
+    block->term_line = line;
+    block->succs = succs;
+    block->succ_count = count;
+    block->cases = copy;
+    block->case_count = case_count;
+    block->switch_kind = kind;
+    return OK;
+}
+
+int32_t ir_add_loop(IrFunction* func, const IrLoop* loop) {
+    if (!func || !loop) return -1;
+    IrLoop* loops = (IrLoop*)mmgr_realloc(func->loops, sizeof(IrLoop) * (func->loop_count + 1));
+    if (!loops) return -1;
+    func->loops = loops;
+    func->loops[func->loop_count] = *loop;
+    return (int32_t)func->loop_count++;
+}
+
+int32_t ir_add_var(IrFunction* func, const char* name, DataType type,
+                   uint16_t offset, int32_t param_index, bool is_return) {
+    if (!func) return -1;
+
+    if (func->var_count >= func->var_capacity) {
+        uint32_t capacity = func->var_capacity ? func->var_capacity * 2 : 8;
+        IrVar* vars = (IrVar*)mmgr_realloc(func->vars, sizeof(IrVar) * capacity);
+        if (!vars) return -1;
+        func->vars = vars;
+        func->var_capacity = capacity;
+    }
+
+    IrVar* var = &func->vars[func->var_count];
+    var->name = name;
+    var->type = type;
+    var->offset = offset;
+    var->param_index = param_index;
+    var->is_return = is_return;
+    return (int32_t)func->var_count++;
+}
+
+// ============================================================================
+// 控制流图与支配树
+// ============================================================================
+
+/**
+ * @brief 删除入口不可达的块并重新编号（只在 SSA 构造前调用，此时没有 PHI）
+ */
+static ErrorCode remove_unreachable(IrFunction* func, const bool* reachable) {
+    int32_t* remap = (int32_t*)mmgr_alloc(sizeof(int32_t) * func->block_count);
+    if (!remap) return ERR_OUT_OF_MEMORY;
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < func->block_count; i++) {
+        if (reachable[i]) {
+            remap[i] = (int32_t)kept;
+            func->blocks[kept] = func->blocks[i];
+            func->blocks[kept]->id = kept;
+            kept++;
+        } else {
+            remap[i] = -1;
+            free_block(func->blocks[i]);
+        }
+    }
+    func->block_count = kept;
+
+    for (uint32_t i = 0; i < kept; i++) {
+        IrBlock* block = func->blocks[i];
+        for (uint32_t s = 0; s < block->succ_count; s++) {
+            block->succs[s] = (uint32_t)remap[block->succs[s]];
+        }
+        for (uint32_t c = 0; c < block->case_count; c++) {
+            block->cases[c].target = (uint32_t)remap[block->cases[c].target];
+        }
+    }
+
+    mmgr_free(remap);
+    return OK;
+}
+
+/**
+ * @brief 求两个块在支配树上的最近公共祖先（按逆后序编号上溯）
+ */
+static int32_t intersect(IrFunction* func, int32_t a, int32_t b) {
+    while (a != b) {
+        while (func->blocks[a]->rpo > func->blocks[b]->rpo) a = func->blocks[a]->idom;
+        while (func->blocks[b]->rpo > func->blocks[a]->rpo) b = func->blocks[b]->idom;
+    }
+    return a;
+}
+
+ErrorCode ir_compute_cfg(IrFunction* func) {
+    if (!func || func->block_count == 0) return ERR_RUNTIME;
+
+    uint32_t n = func->block_count;
+    ErrorCode err = OK;
+
+    // 1. 深度优先遍历求可达块和后序
+    bool* visited = (bool*)mmgr_calloc(sizeof(bool) * n);
+    uint32_t* stack = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * n);
+    uint32_t* next_succ = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * n);
+    uint32_t* postorder = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * n);
+    if (!visited || !stack || !next_succ || !postorder) {
+        err = ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    uint32_t sp = 0, post_count = 0;
+    stack[sp++] = 0;
+    visited[0] = true;
+    while (sp > 0) {
+        IrBlock* block = func->blocks[stack[sp - 1]];
+        if (next_succ[block->id] < block->succ_count) {
+            uint32_t succ = block->succs[next_succ[block->id]++];
+            if (!visited[succ]) {
+                visited[succ] = true;
+                stack[sp++] = succ;
+            }
+        } else {
+            postorder[post_count++] = block->id;
+            sp--;
+        }
+    }
+
+    if (post_count < n) {
+        err = remove_unreachable(func, visited);
+        if (err != OK) goto done;
+        mmgr_free(visited);
+        mmgr_free(stack);
+        mmgr_free(next_succ);
+        mmgr_free(postorder);
+        return ir_compute_cfg(func);
+    }
+
+    // 2. 逆后序编号，前驱表（按块编号顺序，保证重复计算时次序不变）
+    for (uint32_t i = 0; i < n; i++) {
+        IrBlock* block = func->blocks[postorder[n - 1 - i]];
+        block->rpo = (int32_t)i;
+        block->idom = -1;
+        mmgr_free(block->preds);
+        block->preds = NULL;
+        block->pred_count = 0;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        IrBlock* block = func->blocks[i];
+        for (uint32_t s = 0; s < block->succ_count; s++) {
+            IrBlock* succ = func->blocks[block->succs[s]];
+            uint32_t* preds = (uint32_t*)mmgr_realloc(succ->preds,
+                                                      sizeof(uint32_t) * (succ->pred_count + 1));
+            if (!preds) {
+                err = ERR_OUT_OF_MEMORY;
+                goto done;
+            }
+            succ->preds = preds;
+            succ->preds[succ->pred_count++] = i;
+        }
+    }
+
+    // 3. 支配树（Cooper-Harvey-Kennedy）：按逆后序迭代到不动点
+    func->blocks[0]->idom = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = 1; i < n; i++) {
+            IrBlock* block = func->blocks[postorder[n - 1 - i]];
+            int32_t new_idom = -1;
+            for (uint32_t p = 0; p < block->pred_count; p++) {
+                int32_t pred = (int32_t)block->preds[p];
+                if (func->blocks[pred]->idom < 0) continue;
+                new_idom = new_idom < 0 ? pred : intersect(func, pred, new_idom);
+            }
+            if (new_idom != block->idom) {
+                block->idom = new_idom;
+                changed = true;
+            }
+        }
+    }
+    func->blocks[0]->idom = -1;
+
+done:
+    mmgr_free(visited);
+    mmgr_free(stack);
+    mmgr_free(next_succ);
+    mmgr_free(postorder);
+    return err;
+}
+
+bool ir_dominates(const IrFunction* func, uint32_t a, uint32_t b) {
+    if (!func || a >= func->block_count || b >= func->block_count) return false;
+    int32_t runner = (int32_t)b;
+    while (runner >= 0) {
+        if ((uint32_t)runner == a) return true;
+        runner = func->blocks[runner]->idom;
+    }
+    return false;
+}
+
+/**
+ * @brief 内存访问的位置范围 [low, high)（同一存储区内：全局区或帧）
+ *
+ * 声明长度未知的运行时下标访问可能落在存储区内任意位置。
+ */
+static void access_range(const IrInstr* ins, uint32_t* low, uint32_t* high) {
+    if (ins->op == IR_LOAD_INDEXED || ins->op == IR_STORE_INDEXED) {
+        if (ins->var.length == 0) {
+            *low = 0;
+            *high = UINT32_MAX;
+            return;
+        }
+        *low = ins->var.address;
+        *high = (uint32_t)ins->var.address + ins->var.length;
+        return;
+    }
+    *low = ins->var.address;
+    *high = (uint32_t)ins->var.address + 1;
+}
+
+bool ir_is_store(const IrInstr* ins) {
+    return ins->op == IR_STORE || ins->op == IR_STORE_INDEXED || ins->op == IR_STORE_MEMBER;
+}
+
+bool ir_may_alias(const IrInstr* a, const IrInstr* b) {
+    if (a->var.is_global != b->var.is_global) return false;
+    uint32_t a_low, a_high, b_low, b_high;
+    access_range(a, &a_low, &a_high);
+    access_range(b, &b_low, &b_high);
+    return a_low < b_high && b_low < a_high;
+}
+
+void ir_count_uses(const IrFunction* func, uint32_t* counts) {
+    if (!func || !counts) return;
+    memset(counts, 0, sizeof(uint32_t) * func->reg_count);
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        const IrBlock* block = func->blocks[b];
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            const IrInstr* ins = &block->instrs[i];
+            for (uint32_t a = 0; a < ins->arg_count; a++) {
+                if (ins->args[a] >= 0) counts[ins->args[a]]++;
+            }
+        }
+        if (block->term_value >= 0) counts[block->term_value]++;
+    }
+}
+
+// ============================================================================
+// SSA 构造
+// ============================================================================
+
+/**
+ * @brief 块编号集合上的简单位图
+ */
+typedef struct {
+    uint8_t* bits;
+    uint32_t size;
+} BlockSet;
+
+static bool blockset_init(BlockSet* set, uint32_t size) {
+    set->size = size;
+    set->bits = (uint8_t*)mmgr_calloc((size + 7) / 8 + 1);
+    return set->bits != NULL;
+}
+
+static bool blockset_test(const BlockSet* set, uint32_t i) {
+    return (set->bits[i / 8] >> (i % 8)) & 1;
+}
+
+static void blockset_add(BlockSet* set, uint32_t i) {
+    set->bits[i / 8] |= (uint8_t)(1u << (i % 8));
+}
+
+static void blockset_clear(BlockSet* set) {
+    memset(set->bits, 0, (set->size + 7) / 8 + 1);
+}
+
+/**
+ * @brief SSA 构造的工作状态
+ */
+typedef struct {
+    IrFunction* func;
+    BlockSet* frontier;         // 每块的支配边界
+    uint32_t** dom_children;    // 支配树子节点
+    uint32_t* dom_child_count;
+    IrReg** stacks;             // 每个变量的当前定义栈
+    uint32_t* stack_size;
+    uint32_t* stack_capacity;
+    IrReg* repl;                // 寄存器替换表（-1 表示不替换）
+} SsaState;
+
+static IrReg resolve(const IrReg* repl, IrReg reg) {
+    while (reg >= 0 && repl[reg] >= 0) reg = repl[reg];
+    return reg;
+}
+
+static bool push_def(SsaState* st, int32_t var, IrReg reg) {
+    if (st->stack_size[var] >= st->stack_capacity[var]) {
+        uint32_t capacity = st->stack_capacity[var] ? st->stack_capacity[var] * 2 : 8;
+        IrReg* stack = (IrReg*)mmgr_realloc(st->stacks[var], sizeof(IrReg) * capacity);
+        if (!stack) return false;
+        st->stacks[var] = stack;
+        st->stack_capacity[var] = capacity;
+    }
+    st->stacks[var][st->stack_size[var]++] = reg;
+    return true;
+}
+
+/**
+ * @brief 计算支配边界与支配树子节点表
+ */
+static ErrorCode compute_frontiers(SsaState* st) {
+    IrFunction* func = st->func;
+    uint32_t n = func->block_count;
+
+    for (uint32_t b = 0; b < n; b++) {
+        IrBlock* block = func->blocks[b];
+        if (block->pred_count >= 2) {
+            for (uint32_t p = 0; p < block->pred_count; p++) {
+                int32_t runner = (int32_t)block->preds[p];
+                while (runner >= 0 && runner != block->idom) {
+                    blockset_add(&st->frontier[runner], b);
+                    runner = func->blocks[runner]->idom;
+                }
+            }
+        }
+        if (block->idom >= 0) {
+            uint32_t parent = (uint32_t)block->idom;
+            uint32_t* children = (uint32_t*)mmgr_realloc(st->dom_children[parent],
+                                                         sizeof(uint32_t) * (st->dom_child_count[parent] + 1));
+            if (!children) return ERR_OUT_OF_MEMORY;
+            st->dom_children[parent] = children;
+            children[st->dom_child_count[parent]++] = b;
+        }
+    }
+    return OK;
+}
+
+/**
+ * @brief 在迭代支配边界处为每个变量插入 PHI
+ */
+static ErrorCode insert_phis(SsaState* st) {
+    IrFunction* func = st->func;
+    uint32_t n = func->block_count;
+    ErrorCode err = OK;
+
+    BlockSet has_phi, in_work;
+    uint32_t* worklist = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * n);
+    bool ok_sets = blockset_init(&has_phi, n);
+    ok_sets = blockset_init(&in_work, n) && ok_sets;
+    if (!worklist || !ok_sets) {
+        err = ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+
+    for (uint32_t v = 0; v < func->var_count; v++) {
+        blockset_clear(&has_phi);
+        blockset_clear(&in_work);
+        uint32_t count = 0;
+
+        // 入口块定义所有变量（默认值）；其余定义块为含写入的块
+        worklist[count++] = 0;
+        blockset_add(&in_work, 0);
+        for (uint32_t b = 1; b < n; b++) {
+            IrBlock* block = func->blocks[b];
+            for (uint32_t i = 0; i < block->instr_count; i++) {
+                if (block->instrs[i].op == IR_STORE && block->instrs[i].var.promoted == (int32_t)v) {
+                    worklist[count++] = b;
+                    blockset_add(&in_work, b);
+                    break;
+                }
+            }
+        }
+
+        while (count > 0) {
+            uint32_t b = worklist[--count];
+            for (uint32_t f = 0; f < n; f++) {
+                if (!blockset_test(&st->frontier[b], f) || blockset_test(&has_phi, f)) continue;
+                blockset_add(&has_phi, f);
+
+                IrBlock* target = func->blocks[f];
+                IrInstr* phi = insert_at(func, target, 0, IR_PHI, func->vars[v].type,
+                                         NULL, target->pred_count, 0);
+                if (!phi) {
+                    err = ERR_OUT_OF_MEMORY;
+                    goto done;
+                }
+                phi->var.name = func->vars[v].name;
+                phi->var.type = func->vars[v].type;
+                phi->var.address = func->vars[v].offset;
+                phi->var.promoted = (int32_t)v;
+
+                if (!blockset_test(&in_work, f)) {
+                    blockset_add(&in_work, f);
+                    worklist[count++] = f;
+                }
+            }
+        }
+    }
+
+done:
+    mmgr_free(worklist);
+    mmgr_free(has_phi.bits);
+    mmgr_free(in_work.bits);
+    return err;
+}
+
+/**
+ * @brief 沿支配树重命名：读改为复制当前定义，写压栈后删除
+ */
+static ErrorCode rename_block(SsaState* st, uint32_t b) {
+    IrFunction* func = st->func;
+    IrBlock* block = func->blocks[b];
+
+    uint32_t* saved = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (func->var_count + 1));
+    if (!saved) return ERR_OUT_OF_MEMORY;
+    for (uint32_t v = 0; v < func->var_count; v++) saved[v] = st->stack_size[v];
+
+    ErrorCode err = OK;
+    for (uint32_t i = 0; i < block->instr_count; i++) {
+        IrInstr* ins = &block->instrs[i];
+        int32_t v = ins->var.promoted;
+        if (v < 0) continue;
+
+        if (ins->op == IR_PHI) {
+            if (!push_def(st, v, ins->dest)) { err = ERR_OUT_OF_MEMORY; goto done; }
+        } else if (ins->op == IR_LOAD) {
+            IrReg current = st->stacks[v][st->stack_size[v] - 1];
+            st->repl[ins->dest] = current;
+            ins->op = IR_COPY;
+            ins->dest = IR_NO_REG;      // 标记删除
+        } else if (ins->op == IR_STORE) {
+            if (!push_def(st, v, ins->args[0])) { err = ERR_OUT_OF_MEMORY; goto done; }
+            ins->op = IR_COPY;          // 标记删除
+        }
+    }
+
+    // 填写后继块中 PHI 来自本块的操作数
+    for (uint32_t s = 0; s < block->succ_count; s++) {
+        IrBlock* succ = func->blocks[block->succs[s]];
+        for (uint32_t p = 0; p < succ->pred_count; p++) {
+            if (succ->preds[p] != b) continue;
+            for (uint32_t i = 0; i < succ->instr_count && succ->instrs[i].op == IR_PHI; i++) {
+                IrInstr* phi = &succ->instrs[i];
+                int32_t v = phi->var.promoted;
+                phi->args[p] = st->stacks[v][st->stack_size[v] - 1];
+            }
+        }
+    }
+
+    for (uint32_t c = 0; c < st->dom_child_count[b]; c++) {
+        err = rename_block(st, st->dom_children[b][c]);
+        if (err != OK) goto done;
+    }
+
+    for (uint32_t v = 0; v < func->var_count; v++) st->stack_size[v] = saved[v];
+
+done:
+    mmgr_free(saved);
+    return err;
+}
+
+/**
+ * @brief 删除被标记的指令
+ */
+static void compact_block(IrBlock* block) {
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < block->instr_count; i++) {
+        if (IR_IS_DELETED(&block->instrs[i])) {
+            mmgr_free(block->instrs[i].args);
+            continue;
+        }
+        block->instrs[kept++] = block->instrs[i];
+    }
+    block->instr_count = kept;
+}
+
+/**
+ * @brief 应用替换表到所有操作数
+ */
+static void apply_repl(IrFunction* func, const IrReg* repl) {
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        IrBlock* block = func->blocks[b];
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            IrInstr* ins = &block->instrs[i];
+            for (uint32_t a = 0; a < ins->arg_count; a++) {
+                ins->args[a] = resolve(repl, ins->args[a]);
+            }
+        }
+        block->term_value = resolve(repl, block->term_value);
+    }
+}
+
+void ir_compact(IrFunction* func) {
+    if (!func) return;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        compact_block(func->blocks[b]);
+    }
+}
+
+void ir_replace_regs(IrFunction* func, const IrReg* repl) {
+    if (!func || !repl) return;
+    apply_repl(func, repl);
+}
+
+/**
+ * @brief 删除无用 PHI：从非 PHI 使用出发标记活跃 PHI，其余删除
+ */
+static ErrorCode prune_dead_phis(IrFunction* func) {
+    bool* live = (bool*)mmgr_calloc(sizeof(bool) * (func->reg_count + 1));
+    IrInstr** def = (IrInstr**)mmgr_calloc(sizeof(IrInstr*) * (func->reg_count + 1));
+    IrReg* worklist = (IrReg*)mmgr_alloc(sizeof(IrReg) * (func->reg_count + 1));
+    if (!live || !def || !worklist) {
+        mmgr_free(live);
+        mmgr_free(def);
+        mmgr_free(worklist);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        IrBlock* block = func->blocks[b];
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            IrInstr* ins = &block->instrs[i];
+            if (ins->op == IR_PHI) {
+                def[ins->dest] = ins;
+                continue;
+            }
+            for (uint32_t a = 0; a < ins->arg_count; a++) {
+                IrReg r = ins->args[a];
+                if (r >= 0 && !live[r]) { live[r] = true; worklist[count++] = r; }
+            }
+        }
+        IrReg r = block->term_value;
+        if (r >= 0 && !live[r]) { live[r] = true; worklist[count++] = r; }
+    }
+
+    while (count > 0) {
+        IrInstr* phi = def[worklist[--count]];
+        if (!phi) continue;
+        for (uint32_t a = 0; a < phi->arg_count; a++) {
+            IrReg r = phi->args[a];
+            if (r >= 0 && !live[r]) { live[r] = true; worklist[count++] = r; }
+        }
+    }
+
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        IrBlock* block = func->blocks[b];
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            IrInstr* ins = &block->instrs[i];
+            if (ins->op == IR_PHI && !live[ins->dest]) {
+                ins->op = IR_COPY;
+                ins->dest = IR_NO_REG;
+            }
+        }
+        compact_block(block);
+    }
+
+    mmgr_free(live);
+    mmgr_free(def);
+    mmgr_free(worklist);
+    return OK;
+}
+
+/**
+ * @brief 删除平凡 PHI（除自身外所有操作数相同），迭代到不动点
+ */
+static void remove_trivial_phis(IrFunction* func, IrReg* repl) {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t b = 0; b < func->block_count; b++) {
+            IrBlock* block = func->blocks[b];
+            for (uint32_t i = 0; i < block->instr_count; i++) {
+                IrInstr* phi = &block->instrs[i];
+                if (phi->op != IR_PHI) continue;
+
+                IrReg same = IR_NO_REG;
+                bool trivial = true;
+                for (uint32_t a = 0; a < phi->arg_count; a++) {
+                    IrReg r = resolve(repl, phi->args[a]);
+                    if (r == phi->dest || r == same) continue;
+                    if (same != IR_NO_REG) { trivial = false; break; }
+                    same = r;
+                }
+                if (!trivial || same == IR_NO_REG) continue;
+
+                repl[phi->dest] = same;
+                phi->op = IR_COPY;
+                phi->dest = IR_NO_REG;
+                changed = true;
+            }
+        }
+    }
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        compact_block(func->blocks[b]);
+    }
+    apply_repl(func, repl);
+}
+
+/**
+ * @brief 删除未使用的常量和参数读取（默认值初始化留下的）
+ */
+static ErrorCode remove_unused_pure(IrFunction* func) {
+    uint32_t* uses = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (func->reg_count + 1));
+    if (!uses) return ERR_OUT_OF_MEMORY;
+    ir_count_uses(func, uses);
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        IrBlock* block = func->blocks[b];
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            IrInstr* ins = &block->instrs[i];
+            if ((ins->op == IR_CONST || ins->op == IR_PARAM) && uses[ins->dest] == 0) {
+                ins->op = IR_COPY;
+                ins->dest = IR_NO_REG;
+            }
+        }
+        compact_block(block);
+    }
+    mmgr_free(uses);
+    return OK;
+}
+
+/**
+ * @brief 变量类型的默认值
+ */
+static Value default_value(DataType type) {
+    Value v;
+    memset(&v, 0, sizeof(v));
+    v.type = type;
+    return v;
+}
+
+ErrorCode ir_to_ssa(IrFunction* func) {
+    if (!func) return ERR_RUNTIME;
+    if (func->in_ssa) return OK;
+
+    ErrorCode err = ir_compute_cfg(func);
+    if (err != OK) return err;
+
+    if (func->var_count == 0) {
+        func->in_ssa = true;
+        return OK;
+    }
+
+    uint32_t n = func->block_count;
+    uint32_t vars = func->var_count;
+    SsaState st;
+    memset(&st, 0, sizeof(st));
+    st.func = func;
+    st.frontier = (BlockSet*)mmgr_calloc(sizeof(BlockSet) * n);
+    st.dom_children = (uint32_t**)mmgr_calloc(sizeof(uint32_t*) * n);
+    st.dom_child_count = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * n);
+    st.stacks = (IrReg**)mmgr_calloc(sizeof(IrReg*) * vars);
+    st.stack_size = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * vars);
+    st.stack_capacity = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * vars);
+    if (!st.frontier || !st.dom_children || !st.dom_child_count ||
+        !st.stacks || !st.stack_size || !st.stack_capacity) {
+        err = ERR_OUT_OF_MEMORY;
+        goto done;
+    }
+    for (uint32_t b = 0; b < n; b++) {
+        if (!blockset_init(&st.frontier[b], n)) {
+            err = ERR_OUT_OF_MEMORY;
+            goto done;
+        }
+    }
+
+    err = compute_frontiers(&st);
+    if (err != OK) goto done;
+    err = insert_phis(&st);
+    if (err != OK) goto done;
+
+    // 入口块开头为每个变量放一个默认值作为最初的到达定义
+    for (uint32_t v = 0; v < vars; v++) {
+        IrInstr* init = insert_at(func, func->blocks[0], v, IR_CONST, func->vars[v].type, NULL, 0, 0);
+        if (!init) { err = ERR_OUT_OF_MEMORY; goto done; }
+        init->constant = default_value(func->vars[v].type);
+        if (!push_def(&st, (int32_t)v, init->dest)) { err = ERR_OUT_OF_MEMORY; goto done; }
+    }
+
+    // 替换表在插入默认值之后分配（寄存器数已确定，重命名不再新建寄存器）
+    st.repl = (IrReg*)mmgr_alloc(sizeof(IrReg) * (func->reg_count + 1));
+    if (!st.repl) { err = ERR_OUT_OF_MEMORY; goto done; }
+    for (uint32_t r = 0; r <= func->reg_count; r++) st.repl[r] = IR_NO_REG;
+
+    err = rename_block(&st, 0);
+    if (err != OK) goto done;
+
+    for (uint32_t b = 0; b < n; b++) compact_block(func->blocks[b]);
+    apply_repl(func, st.repl);
+
+    err = prune_dead_phis(func);
+    if (err != OK) goto done;
+    remove_trivial_phis(func, st.repl);
+    err = remove_unused_pure(func);
+    if (err != OK) goto done;
+
+    func->in_ssa = true;
+
+done:
+    if (st.frontier) {
+        for (uint32_t b = 0; b < n; b++) mmgr_free(st.frontier[b].bits);
+    }
+    if (st.dom_children) {
+        for (uint32_t b = 0; b < n; b++) mmgr_free(st.dom_children[b]);
+    }
+    if (st.stacks) {
+        for (uint32_t v = 0; v < vars; v++) mmgr_free(st.stacks[v]);
+    }
+    mmgr_free(st.frontier);
+    mmgr_free(st.dom_children);
+    mmgr_free(st.dom_child_count);
+    mmgr_free(st.stacks);
+    mmgr_free(st.stack_size);
+    mmgr_free(st.stack_capacity);
+    mmgr_free(st.repl);
+    return err;
+}
+
+// ============================================================================
+// 调试输出
+// ============================================================================
+
+static const char* op_name(const IrInstr* ins) {
+    switch (ins->op) {
+        case IR_CONST:          return "const";
+        case IR_PARAM:          return "param";
+        case IR_COPY:           return "copy";
+        case IR_BINARY:
+        case IR_UNARY:
+        case IR_LOAD_MEMBER:
+        case IR_STORE_MEMBER:   return opcode_to_string(ins->opcode);
+        case IR_LOAD:           return "load";
+        case IR_STORE:          return "store";
+        case IR_LOAD_INDEXED:   return "load_indexed";
+        case IR_STORE_INDEXED:  return "store_indexed";
+        case IR_IO_READ:        return "io_read";
+        case IR_IO_WRITE:       return "io_write";
+        case IR_CALL:           return "call";
+        case IR_PHI:            return "phi";
+        default:                return "?";
+    }
+}
+
+static void print_var(const IrVarRef* var) {
+    printf(" %s%s[%u]", var->is_global ? "@" : "$", var->name ? var->name : "", var->address);
+}
+
+static void print_instr(const IrBlock* block, const IrInstr* ins) {
+    printf("    ");
+    if (ins->dest >= 0) printf("%%%d = ", ins->dest);
+    printf("%s", op_name(ins));
+
+    switch (ins->op) {
+        case IR_CONST: {
+            char buffer[64];
+            value_to_string(ins->constant, buffer, sizeof(buffer));
+            printf(" %s", buffer);
+            break;
+        }
+        case IR_PARAM:
+            printf(" %d", ins->index);
+            break;
+        case IR_LOAD:
+        case IR_STORE:
+        case IR_LOAD_INDEXED:
+        case IR_STORE_INDEXED:
+        case IR_LOAD_MEMBER:
+        case IR_STORE_MEMBER:
+            print_var(&ins->var);
+            break;
+        case IR_IO_READ:
+        case IR_IO_WRITE:
+            printf(" %s", ins->io_address ? ins->io_address : "?");
+            break;
+        case IR_CALL:
+            printf(" %s", ins->callee ? ins->callee : "?");
+            break;
+        default:
+            break;
+    }
+
+    for (uint32_t a = 0; a < ins->arg_count; a++) {
+        if (ins->op == IR_PHI) {
+            printf(" [%%%d, b%u]", ins->args[a], block->preds[a]);
+        } else {
+            printf("%s%%%d", a == 0 ? " " : ", ", ins->args[a]);
+        }
+    }
+
+    if (ins->type != TYPE_VOID) printf(" : %s", type_to_string(ins->type));
+    if (ins->op == IR_PHI && ins->var.name) printf("    ; %s", ins->var.name);
+    printf("\n");
+}
+
+void ir_print_function(const IrFunction* func) {
+    if (!func) return;
+
+    printf("function %s (params %d, frame %d)", func->name, func->param_count, func->frame_size);
+    if (func->return_type != TYPE_VOID) printf(" : %s", type_to_string(func->return_type));
+    printf("%s\n", func->in_ssa ? " [ssa]" : "");
+
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        const IrBlock* block = func->blocks[b];
+        printf("  b%u:", block->id);
+        if (block->pred_count > 0) {
+            printf("    ; preds");
+            for (uint32_t p = 0; p < block->pred_count; p++) printf(" b%u", block->preds[p]);
+            if (block->idom >= 0) printf(", idom b%d", block->idom);
+        }
+        printf("\n");
+
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            print_instr(block, &block->instrs[i]);
+        }
+
+        switch (block->term) {
+            case IR_TERM_JMP:
+                printf("    jmp b%u\n", block->succs[0]);
+                break;
+            case IR_TERM_BR:
+                printf("    br %%%d, b%u, b%u\n", block->term_value, block->succs[0], block->succs[1]);
+                break;
+            case IR_TERM_RET:
+                if (block->term_value >= 0) printf("    ret %%%d\n", block->term_value);
+                else printf("    ret\n");
+                break;
+            case IR_TERM_HALT:
+                printf("    halt\n");
+                break;
+            case IR_TERM_SWITCH:
+                printf("    switch %%%d, default b%u", block->term_value, block->succs[0]);
+                for (uint32_t c = 0; c < block->case_count; c++) {
+                    const SwitchCase* sc = &block->cases[c];
+                    if (sc->low == sc->high) printf(", %d: b%u", sc->low, sc->target);
+                    else printf(", %d..%d: b%u", sc->low, sc->high, sc->target);
+                }
+                printf("\n");
+                break;
+            case IR_TERM_FOR_INIT: {
+                const IrLoop* loop = &func->loops[block->loop];
+                printf("    for_init %%%d,", block->term_value);
+                print_var(&loop->var);
+                printf(", step %d, b%u, b%u\n", loop->desc.step,
+                       block->succs[0], block->succs[1]);
+                break;
+            }
+            case IR_TERM_FOR_STEP: {
+                const IrLoop* loop = &func->loops[block->loop];
+                printf("    for_step");
+                print_var(&loop->var);
+                printf(", step %d, b%u, b%u\n", loop->desc.step,
+                       block->succs[0], block->succs[1]);
+                break;
+            }
+            default:
+                printf("    <unterminated>\n");
+                break;
+        }
+    }
+}
+
+void ir_print_module(const IrModule* module) {
+    if (!module) return;
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        if (i > 0) printf("\n");
+        ir_print_function(module->functions[i]);
+    }
+}
@@ -0,0 +1,1183 @@
+/**
+ * @file ir_build.c
+ * @brief 中间表示 - 由类型检查后的 AST 构建 IR
+ *
+ * 变量解析、作用域与帧布局和 codegen.c 保持一致：进入函数作用域、
+ * 依次定义参数、函数名返回值变量、局部变量，帧大小取符号表的
+ * local_var_offset；静态变量先按 "函数名.变量名" 查找。
+ *
+ * 每个函数构建完成后立即转换为 SSA 形式。
+ */
+
+#include "ir.h"
+#include "codegen.h"
+#include "mmgr.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#define IR_TEMP_OFFSET  0xFFFF      // 构建时引入的临时变量（总被提升，不占帧槽位）
+
+/**
+ * @brief IR 构建器状态
+ */
+typedef struct {
+    IrModule* module;
+    SymbolTable* symtbl;
+    ASTNode* program;
+    IrFunction* func;           // 当前函数
+    IrBlock* block;             // 当前插入块
+    const char* func_name;      // 当前函数名（主程序为 NULL）
+    int line;                   // 当前语句行号
+    ErrorCode error;
+    char* error_msg;
+    size_t error_size;
+} IrBuilder;
+
+static IrReg build_expr(IrBuilder* b, ASTNode* expr);
+static IrReg build_value(IrBuilder* b, ASTNode* expr);
+static void build_stmt_list(IrBuilder* b, ASTNode* stmts);
+
+// ============================================================================
+// 辅助函数
+// ============================================================================
+
+static void build_error(IrBuilder* b, ErrorCode code, const char* fmt, ...) {
+    if (b->error != OK) return;
+    b->error = code;
+    if (b->error_msg && b->error_size > 0) {
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(b->error_msg, b->error_size, fmt, args);
+        va_end(args);
+    }
+}
+
+static IrInstr* emit(IrBuilder* b, IrOp op, DataType type, const IrReg* args, uint32_t arg_count) {
+    IrInstr* ins = ir_append(b->func, b->block, op, type, args, arg_count, b->line);
+    if (!ins) build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+    return ins;
+}
+
+static IrBlock* new_block(IrBuilder* b) {
+    IrBlock* block = ir_block_create(b->func);
+    if (!block) build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+    return block;
+}
+
+/**
+ * @brief 结束当前块并跳转到 target（当前块已结束时不变）
+ */
+static void jump_to(IrBuilder* b, IrBlock* target) {
+    ir_terminate(b->block, IR_TERM_JMP, IR_NO_REG, target->id, 0, b->line);
+}
+
+static IrReg emit_const(IrBuilder* b, Value value) {
+    IrInstr* ins = emit(b, IR_CONST, value.type, NULL, 0);
+    if (!ins) return IR_NO_REG;
+    ins->constant = value;
+    return ins->dest;
+}
+
+static DataType node_type(ASTNode* node, DataType fallback) {
+    if (node && node->resolved_type) return node->resolved_type->base_type;
+    return fallback;
+}
+
+static bool is_promotable_type(DataType type) {
+    return type == TYPE_INT || type == TYPE_REAL || type == TYPE_BOOL;
+}
+
+/**
+ * @brief 解析变量名（函数内先查静态变量的完全限定名）
+ */
+static Symbol* lookup_variable(IrBuilder* b, const char* name) {
+    if (b->func_name) {
+        size_t qualified_len = strlen(b->func_name) + strlen(name) + 2;
+        char* qualified_name = (char*)mmgr_alloc(qualified_len);
+        if (!qualified_name) {
+            build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+            return NULL;
+        }
+        snprintf(qualified_name, qualified_len, "%s.%s", b->func_name, name);
+        Symbol* sym = symtbl_lookup(b->symtbl, qualified_name);
+        mmgr_free(qualified_name);
+        if (sym && sym->is_static) return sym;
+    }
+
+    Symbol* sym = symtbl_lookup(b->symtbl, name);
+    if (!sym) build_error(b, ERR_NAME, "Undefined variable: %s", name);
+    return sym;
+}
+
+/**
+ * @brief 由符号生成变量引用（帧内标量变量关联到可提升变量）
+ */
+static IrVarRef var_ref(IrBuilder* b, Symbol* sym, int32_t element) {
+    IrVarRef ref;
+    memset(&ref, 0, sizeof(ref));
+    ref.name = sym->name;
+    ref.is_global = sym->is_global;
+    ref.address = (uint16_t)((sym->is_global ? sym->index : sym->offset) + element);
+    ref.type = sym->type ? sym->type->base_type : TYPE_VOID;
+    ref.promoted = -1;
+
+    if (!sym->is_global && element == 0) {
+        for (uint32_t v = 0; v < b->func->var_count; v++) {
+            if (b->func->vars[v].offset == ref.address) {
+                ref.promoted = (int32_t)v;
+                break;
+            }
+        }
+    }
+    return ref;
+}
+
+static IrReg load_symbol(IrBuilder* b, Symbol* sym) {
+    if (sym->is_external && sym->io_address) {
+        IrInstr* ins = emit(b, IR_IO_READ, sym->type ? sym->type->base_type : TYPE_INT, NULL, 0);
+        if (!ins) return IR_NO_REG;
+        ins->io_address = sym->io_address;
+        return ins->dest;
+    }
+
+    IrVarRef ref = var_ref(b, sym, 0);
+    IrInstr* ins = emit(b, IR_LOAD, ref.type, NULL, 0);
+    if (!ins) return IR_NO_REG;
+    ins->var = ref;
+    return ins->dest;
+}
+
+static void store_symbol(IrBuilder* b, Symbol* sym, IrReg value) {
+    if (sym->is_external && sym->io_address) {
+        IrInstr* ins = emit(b, IR_IO_WRITE, TYPE_VOID, &value, 1);
+        if (ins) ins->io_address = sym->io_address;
+        return;
+    }
+
+    IrInstr* ins = emit(b, IR_STORE, TYPE_VOID, &value, 1);
+    if (ins) ins->var = var_ref(b, sym, 0);
+}
+
+// ============================================================================
+// 表达式
+// ============================================================================
+
+static Opcode binary_opcode(ASTNode* node) {
+    BinaryOp op = node->data.binary_op.op;
+    bool bitwise = node->resolved_type && node->resolved_type->base_type == TYPE_INT;
+
+    switch (op) {
+        case BINOP_ADD: return OP_ADD;
+        case BINOP_SUB: return OP_SUB;
+        case BINOP_MUL: return OP_MUL;
+        case BINOP_DIV: return OP_DIV;
+        case BINOP_MOD: return OP_MOD;
+        case BINOP_EQ:  return OP_EQ;
+        case BINOP_NE:  return OP_NE;
+        case BINOP_LT:  return OP_LT;
+        case BINOP_LE:  return OP_LE;
+        case BINOP_GT:  return OP_GT;
+        case BINOP_GE:  return OP_GE;
+        // AND/OR/XOR 按结果类型选择逻辑或位运算（同 codegen）
+        case BINOP_AND: return bitwise ? OP_BIT_AND : OP_AND;
+        case BINOP_OR:  return bitwise ? OP_BIT_OR : OP_OR;
+        case BINOP_XOR: return bitwise ? OP_BIT_XOR : OP_XOR;
+        case BINOP_BIT_AND: return OP_BIT_AND;
+        case BINOP_BIT_OR:  return OP_BIT_OR;
+        case BINOP_BIT_XOR: return OP_BIT_XOR;
+        case BINOP_SHL: return OP_SHL;
+        case BINOP_SHR: return OP_SHR;
+        default:        return OP_NOP;
+    }
+}
+
+/**
+ * @brief 写入/读取构建时引入的临时变量（SSA 构造后成为寄存器）
+ */
+static void store_temp(IrBuilder* b, int32_t var, IrReg value) {
+    IrInstr* store = emit(b, IR_STORE, TYPE_VOID, &value, 1);
+    if (!store) return;
+    store->var.name = b->func->vars[var].name;
+    store->var.address = b->func->vars[var].offset;
+    store->var.type = b->func->vars[var].type;
+    store->var.promoted = var;
+}
+
+static IrReg load_temp(IrBuilder* b, int32_t var) {
+    IrInstr* load = emit(b, IR_LOAD, b->func->vars[var].type, NULL, 0);
+    if (!load) return IR_NO_REG;
+    load->var.name = b->func->vars[var].name;
+    load->var.address = b->func->vars[var].offset;
+    load->var.type = b->func->vars[var].type;
+    load->var.promoted = var;
+    return load->dest;
+}
+
+/**
+ * @brief 短路逻辑运算（判定同 codegen）：两条路径的结果经临时变量汇合，
+ *        SSA 构造后成为汇合块中的 PHI
+ */
+static IrReg build_short_circuit(IrBuilder* b, ASTNode* node) {
+    BinaryOp op = node->data.binary_op.op;
+    bool is_and = (op == BINOP_AND || op == BINOP_AND_THEN);
+
+    IrReg left = build_value(b, node->data.binary_op.left);
+    if (b->error != OK) return IR_NO_REG;
+
+    int32_t var = ir_add_var(b->func, "$short_circuit", TYPE_BOOL, IR_TEMP_OFFSET, -1, false);
+    if (var < 0) {
+        build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+        return IR_NO_REG;
+    }
+    store_temp(b, var, left);
+    IrBlock* rhs = new_block(b);
+    IrBlock* join = new_block(b);
+    if (b->error != OK) return IR_NO_REG;
+    ir_terminate(b->block, IR_TERM_BR, left,
+                 is_and ? rhs->id : join->id, is_and ? join->id : rhs->id, b->line);
+
+    b->block = rhs;
+    IrReg right = build_value(b, node->data.binary_op.right);
+    if (b->error != OK) return IR_NO_REG;
+    store_temp(b, var, right);
+    jump_to(b, join);
+
+    b->block = join;
+    return load_temp(b, var);
+}
+
+static IrReg build_binary(IrBuilder* b, ASTNode* node) {
+    if (codegen_short_circuit(b->symtbl, node)) return build_short_circuit(b, node);
+
+    IrReg args[2];
+    args[0] = build_value(b, node->data.binary_op.left);
+    args[1] = build_value(b, node->data.binary_op.right);
+    if (b->error != OK) return IR_NO_REG;
+
+    Opcode opcode = binary_opcode(node);
+    if (opcode == OP_NOP) {
+        build_error(b, ERR_RUNTIME, "Unsupported binary operator: %d", node->data.binary_op.op);
+        return IR_NO_REG;
+    }
+
+    DataType type;
+    switch (opcode) {
+        case OP_EQ: case OP_NE: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+            type = TYPE_BOOL;
+            break;
+        default:
+            type = node_type(node, b->func->reg_types[args[0]]);
+            break;
+    }
+
+    IrInstr* ins = emit(b, IR_BINARY, type, args, 2);
+    if (!ins) return IR_NO_REG;
+    ins->opcode = opcode;
+    return ins->dest;
+}
+
+static IrReg build_unary(IrBuilder* b, ASTNode* node) {
+    IrReg operand = build_value(b, node->data.unary_op.operand);
+    if (b->error != OK) return IR_NO_REG;
+
+    Opcode opcode;
+    switch (node->data.unary_op.op) {
+        case UNOP_NEG:
+            opcode = OP_NEG;
+            break;
+        case UNOP_NOT:
+            opcode = node->resolved_type && node->resolved_type->base_type == TYPE_INT
+                   ? OP_BIT_NOT : OP_NOT;
+            break;
+        case UNOP_BIT_NOT:
+            opcode = OP_BIT_NOT;
+            break;
+        default:
+            build_error(b, ERR_RUNTIME, "Unsupported unary operator: %d", node->data.unary_op.op);
+            return IR_NO_REG;
+    }
+
+    IrInstr* ins = emit(b, IR_UNARY, node_type(node, b->func->reg_types[operand]), &operand, 1);
+    if (!ins) return IR_NO_REG;
+    ins->opcode = opcode;
+    return ins->dest;
+}
+
+/**
+ * @brief 函数调用（无返回值时返回 IR_NO_REG）
+ */
+static IrReg build_call(IrBuilder* b, ASTNode* node) {
+    int argc = node->data.function_call.arg_count;
+    IrReg* args = NULL;
+    if (argc > 0) {
+        args = (IrReg*)mmgr_alloc(sizeof(IrReg) * argc);
+        if (!args) {
+            build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+            return IR_NO_REG;
+        }
+        for (int i = 0; i < argc; i++) {
+            args[i] = build_value(b, node->data.function_call.arguments[i]);
+        }
+    }
+    if (b->error != OK) {
+        mmgr_free(args);
+        return IR_NO_REG;
+    }
+
+    const char* name = node->data.function_call.name;
+    Symbol* sym = symtbl_lookup(b->symtbl, name);
+    if (!sym || sym->kind != SYM_FUNCTION) {
+        mmgr_free(args);
+        build_error(b, ERR_NAME, "Undefined function: %s", name);
+        return IR_NO_REG;
+    }
+
+    DataType return_type = TYPE_VOID;
+    if (sym->type && sym->type->base_type == TYPE_FUNCTION && sym->type->func_info.return_type) {
+        return_type = sym->type->func_info.return_type->base_type;
+    } else if (sym->type && sym->type->base_type != TYPE_FUNCTION) {
+        return_type = sym->type->base_type;
+    }
+
+    IrInstr* ins = emit(b, IR_CALL, return_type, args, (uint32_t)argc);
+    mmgr_free(args);
+    if (!ins) return IR_NO_REG;
+    ins->callee = (sym->is_library && sym->qualified_name) ? sym->qualified_name : name;
+    ins->callee_params = sym->param_count;
+    return ins->dest;
+}
+
+/**
+ * @brief 常量下标在声明长度已知时必须在 [下界, 下界 + 长度) 内
+ */
+static bool check_constant_index(IrBuilder* b, Symbol* sym, int32_t index) {
+    uint32_t length = type_info_array_length(sym->type);
+    int32_t lower = type_info_array_lower(sym->type);
+    int64_t rel = (int64_t)index - lower;
+    if (length > 0 && (rel < 0 || rel >= (int64_t)length)) {
+        build_error(b, ERR_OUT_OF_BOUNDS, "Array index out of bounds: %s[%d] (range %d..%lld)",
+                    sym->name, index, lower, (long long)lower + length - 1);
+        return false;
+    }
+    return true;
+}
+
+static IrReg build_array_load(IrBuilder* b, ASTNode* node) {
+    ASTNode* base = node->data.array_access.array;
+    if (base->type != AST_IDENTIFIER) {
+        build_error(b, ERR_RUNTIME, "Array base must be an identifier");
+        return IR_NO_REG;
+    }
+    Symbol* sym = lookup_variable(b, base->data.identifier.name);
+    if (!sym) return IR_NO_REG;
+
+    DataType elem_type = TYPE_INT;
+    if (sym->type && sym->type->base_type == TYPE_ARRAY && sym->type->array_info.elem_type) {
+        elem_type = sym->type->array_info.elem_type->base_type;
+    }
+    elem_type = node_type(node, elem_type);
+
+    ASTNode* index = node->data.array_access.index;
+    if (index->type == AST_LITERAL) {
+        if (index->data.literal.value.type != TYPE_INT) {
+            build_error(b, ERR_TYPE, "Array index must be an integer");
+            return IR_NO_REG;
+        }
+        if (!check_constant_index(b, sym, index->data.literal.value.int_val)) return IR_NO_REG;
+        // 常量下标直接访问 基址+(下标-下界) 处的变量
+        IrInstr* ins = emit(b, IR_LOAD, elem_type, NULL, 0);
+        if (!ins) return IR_NO_REG;
+        ins->var = var_ref(b, sym, index->data.literal.value.int_val - type_info_array_lower(sym->type));
+        ins->var.type = elem_type;
+        return ins->dest;
+    }
+
+    IrReg idx = build_value(b, index);
+    if (b->error != OK) return IR_NO_REG;
+    IrInstr* ins = emit(b, IR_LOAD_INDEXED, elem_type, &idx, 1);
+    if (!ins) return IR_NO_REG;
+    ins->var = var_ref(b, sym, 0);
+    ins->var.promoted = -1;
+    ins->var.length = (uint16_t)type_info_array_length(sym->type);
+    ins->var.lower = type_info_array_lower(sym->type);
+    return ins->dest;
+}
+
+/**
+ * @brief 解析质量化变量成员访问的对象
+ */
+static Symbol* member_symbol(IrBuilder* b, ASTNode* node) {
+    ASTNode* object = node->data.member_access.object;
+    if (object->type != AST_IDENTIFIER) {
+        build_error(b, ERR_RUNTIME, "Member access object must be an identifier");
+        return NULL;
+    }
+    Symbol* sym = lookup_variable(b, object->data.identifier.name);
+    if (!sym) return NULL;
+    if (!sym->type || !is_qualified_type(sym->type->base_type)) {
+        build_error(b, ERR_TYPE, "Variable '%s' is not a qualified type", object->data.identifier.name);
+        return NULL;
+    }
+    return sym;
+}
+
+static IrReg build_member_load(IrBuilder* b, ASTNode* node) {
+    Symbol* sym = member_symbol(b, node);
+    if (!sym) return IR_NO_REG;
+
+    bool is_val = node->data.member_access.member == MEMBER_VAL;
+    DataType type = node_type(node, is_val ? get_base_type(sym->type->base_type) : TYPE_INT);
+    IrInstr* ins = emit(b, IR_LOAD_MEMBER, type, NULL, 0);
+    if (!ins) return IR_NO_REG;
+    ins->opcode = is_val ? OP_LOAD_VAL : OP_LOAD_QUALITY;
+    ins->var = var_ref(b, sym, 0);
+    ins->var.promoted = -1;
+    return ins->dest;
+}
+
+static IrReg build_expr(IrBuilder* b, ASTNode* expr) {
+    if (b->error != OK) return IR_NO_REG;
+    if (!expr) {
+        build_error(b, ERR_RUNTIME, "Missing expression");
+        return IR_NO_REG;
+    }
+
+    switch (expr->type) {
+        case AST_LITERAL:
+            return emit_const(b, expr->data.literal.value);
+
+        case AST_IDENTIFIER: {
+            Symbol* sym = lookup_variable(b, expr->data.identifier.name);
+            return sym ? load_symbol(b, sym) : IR_NO_REG;
+        }
+
+        case AST_BINARY_OP:
+            return build_binary(b, expr);
+
+        case AST_UNARY_OP:
+            return build_unary(b, expr);
+
+        case AST_FUNCTION_CALL:
+            return build_call(b, expr);
+
+        case AST_ARRAY_ACCESS:
+            return build_array_load(b, expr);
+
+        case AST_MEMBER_ACCESS:
+            return build_member_load(b, expr);
+
+        default:
+            build_error(b, ERR_RUNTIME, "Unsupported expression type: %d", expr->type);
+            return IR_NO_REG;
+    }
+}
+
+/**
+ * @brief 计算值并要求其非空（void 调用不能作为值使用）
+ */
+static IrReg build_value(IrBuilder* b, ASTNode* expr) {
+    IrReg reg = build_expr(b, expr);
+    if (b->error == OK && reg == IR_NO_REG) {
+        build_error(b, ERR_TYPE, "Expression has no value");
+    }
+    return reg;
+}
+
+// ============================================================================
+// 语句
+// ============================================================================
+
+static void build_assign(IrBuilder* b, ASTNode* node) {
+    // 先计算右值（与 codegen 的求值顺序一致）
+    IrReg value = build_value(b, node->data.assign.value);
+    if (b->error != OK) return;
+
+    ASTNode* target = node->data.assign.target;
+    switch (target->type) {
+        case AST_IDENTIFIER: {
+            Symbol* sym = lookup_variable(b, target->data.identifier.name);
+            if (sym) store_symbol(b, sym, value);
+            return;
+        }
+
+        case AST_ARRAY_ACCESS: {
+            ASTNode* base = target->data.array_access.array;
+            if (base->type != AST_IDENTIFIER) {
+                build_error(b, ERR_RUNTIME, "Array base must be an identifier");
+                return;
+            }
+            Symbol* sym = lookup_variable(b, base->data.identifier.name);
+            if (!sym) return;
+
+            ASTNode* index = target->data.array_access.index;
+            if (index->type == AST_LITERAL) {
+                if (index->data.literal.value.type != TYPE_INT) {
+                    build_error(b, ERR_TYPE, "Array index must be an integer");
+                    return;
+                }
+                if (!check_constant_index(b, sym, index->data.literal.value.int_val)) return;
+                IrInstr* ins = emit(b, IR_STORE, TYPE_VOID, &value, 1);
+                if (ins) {
+                    ins->var = var_ref(b, sym, index->data.literal.value.int_val -
+                                              type_info_array_lower(sym->type));
+                    ins->var.type = b->func->reg_types[value];
+                }
+                return;
+            }
+
+            IrReg args[2];
+            args[0] = value;
+            args[1] = build_value(b, index);
+            if (b->error != OK) return;
+            IrInstr* ins = emit(b, IR_STORE_INDEXED, TYPE_VOID, args, 2);
+            if (ins) {
+                ins->var = var_ref(b, sym, 0);
+                ins->var.promoted = -1;
+                ins->var.length = (uint16_t)type_info_array_length(sym->type);
+                ins->var.lower = type_info_array_lower(sym->type);
+            }
+            return;
+        }
+
+        case AST_MEMBER_ACCESS: {
+            Symbol* sym = member_symbol(b, target);
+            if (!sym) return;
+            IrInstr* ins = emit(b, IR_STORE_MEMBER, TYPE_VOID, &value, 1);
+            if (!ins) return;
+            ins->opcode = target->data.member_access.member == MEMBER_VAL
+                        ? OP_STORE_VAL : OP_STORE_QUALITY;
+            ins->var = var_ref(b, sym, 0);
+            ins->var.promoted = -1;
+            return;
+        }
+
+        default:
+            build_error(b, ERR_RUNTIME, "Invalid assignment target");
+            return;
+    }
+}
+
+static void build_if(IrBuilder* b, ASTNode* node) {
+    IrReg cond = build_value(b, node->data.if_stmt.condition);
+    IrBlock* then_block = new_block(b);
+    IrBlock* join = new_block(b);
+    IrBlock* else_block = node->data.if_stmt.else_branch ? new_block(b) : join;
+    if (b->error != OK) return;
+
+    ir_terminate(b->block, IR_TERM_BR, cond, then_block->id, else_block->id, b->line);
+
+    b->block = then_block;
+    build_stmt_list(b, node->data.if_stmt.then_branch);
+    jump_to(b, join);
+
+    if (else_block != join) {
+        b->block = else_block;
+        build_stmt_list(b, node->data.if_stmt.else_branch);
+        jump_to(b, join);
+    }
+    b->block = join;
+}
+
+static void build_while(IrBuilder* b, ASTNode* node) {
+    IrBlock* header = new_block(b);
+    IrBlock* body = new_block(b);
+    IrBlock* exit = new_block(b);
+    if (b->error != OK) return;
+
+    jump_to(b, header);
+    b->block = header;
+    IrReg cond = build_value(b, node->data.while_stmt.condition);
+    if (b->error != OK) return;
+    ir_terminate(b->block, IR_TERM_BR, cond, body->id, exit->id, b->line);
+
+    b->block = body;
+    build_stmt_list(b, node->data.while_stmt.body);
+    jump_to(b, header);
+    b->block = exit;
+}
+
+/**
+ * @brief FOR 步长是否为负整数常量（字面量或取负的正字面量）
+ */
+static bool step_descending(const ASTNode* step) {
+    if (!step) return false;
+    if (step->type == AST_LITERAL) {
+        return step->data.literal.value.type == TYPE_INT && step->data.literal.value.int_val < 0;
+    }
+    const ASTNode* operand = step->type == AST_UNARY_OP && step->data.unary_op.op == UNOP_NEG
+                           ? step->data.unary_op.operand : NULL;
+    return operand && operand->type == AST_LITERAL &&
+           operand->data.literal.value.type == TYPE_INT && operand->data.literal.value.int_val > 0;
+}
+
+/**
+ * @brief FOR 循环能否用循环描述符构建（判定同 codegen），可以时填写 loop
+ *
+ * 循环变量和帧内终值变量须不可提升（见 pin_loop_vars）：OP_FOR_INIT/OP_FOR_STEP
+ * 直接读写内存中的变量。
+ */
+static bool for_loop_descriptor(IrBuilder* b, ASTNode* node, Symbol* var, IrLoop* loop) {
+    memset(loop, 0, sizeof(*loop));
+    if (!codegen_for_loop_descriptor(b->symtbl, b->func_name, node, var, &loop->desc)) {
+        return false;
+    }
+    loop->var = var_ref(b, var, 0);
+    if (loop->desc.flags & FOR_LOOP_END_VAR) {
+        Symbol* end = lookup_variable(b, node->data.for_stmt.end->data.identifier.name);
+        if (!end) return false;
+        loop->end_var = var_ref(b, end, 0);
+    } else {
+        loop->end_var.promoted = -1;
+    }
+    return loop->var.promoted < 0 && loop->end_var.promoted < 0;
+}
+
+/**
+ * @brief FOR 循环
+ *
+ * 能用循环描述符时构建为 <初值>; FOR_INIT -> 循环体 ... FOR_STEP -> 循环体 / 出口，
+ * 降级为 OP_FOR_INIT/OP_FOR_STEP（同 codegen）；其余情况构建为比较循环，
+ * 结束值和步长每次迭代重新计算，负常量步长比较 >=。
+ */
+static void build_for(IrBuilder* b, ASTNode* node) {
+    Symbol* var = lookup_variable(b, node->data.for_stmt.variable);
+    if (!var) return;
+
+    IrReg start = build_value(b, node->data.for_stmt.start);
+    if (b->error != OK) return;
+
+    IrLoop loop;
+    if (for_loop_descriptor(b, node, var, &loop)) {
+        int32_t index = ir_add_loop(b->func, &loop);
+        IrBlock* body = new_block(b);
+        IrBlock* exit = new_block(b);
+        if (index < 0) build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+        if (b->error != OK) return;
+
+        b->block->loop = (uint32_t)index;
+        ir_terminate(b->block, IR_TERM_FOR_INIT, start, body->id, exit->id, b->line);
+        b->block = body;
+        build_stmt_list(b, node->data.for_stmt.body);
+        if (b->error != OK) return;
+        b->block->loop = (uint32_t)index;
+        ir_terminate(b->block, IR_TERM_FOR_STEP, IR_NO_REG, body->id, exit->id, b->line);
+        b->block = exit;
+        return;
+    }
+    if (b->error != OK) return;
+    store_symbol(b, var, start);
+
+    IrBlock* header = new_block(b);
+    IrBlock* body = new_block(b);
+    IrBlock* exit = new_block(b);
+    if (b->error != OK) return;
+
+    jump_to(b, header);
+    b->block = header;
+    IrReg args[2];
+    args[0] = load_symbol(b, var);
+    args[1] = build_value(b, node->data.for_stmt.end);
+    if (b->error != OK) return;
+    IrInstr* cmp = emit(b, IR_BINARY, TYPE_BOOL, args, 2);
+    if (!cmp) return;
+    cmp->opcode = step_descending(node->data.for_stmt.step) ? OP_GE : OP_LE;
+    ir_terminate(b->block, IR_TERM_BR, cmp->dest, body->id, exit->id, b->line);
+
+    b->block = body;
+    build_stmt_list(b, node->data.for_stmt.body);
+    if (b->error != OK) return;
+
+    args[0] = load_symbol(b, var);
+    if (node->data.for_stmt.step) {
+        args[1] = build_value(b, node->data.for_stmt.step);
+    } else {
+        Value one = {.type = TYPE_INT};
+        one.int_val = 1;
+        args[1] = emit_const(b, one);
+    }
+    if (b->error != OK) return;
+    IrInstr* add = emit(b, IR_BINARY, b->func->reg_types[args[0]], args, 2);
+    if (!add) return;
+    add->opcode = OP_ADD;
+    store_symbol(b, var, add->dest);
+    jump_to(b, header);
+    b->block = exit;
+}
+
+/**
+ * @brief REPEAT 循环：条件为真时退出
+ */
+static void build_repeat(IrBuilder* b, ASTNode* node) {
+    IrBlock* body = new_block(b);
+    IrBlock* exit = new_block(b);
+    if (b->error != OK) return;
+
+    jump_to(b, body);
+    b->block = body;
+    build_stmt_list(b, node->data.repeat_stmt.body);
+    IrReg cond = build_value(b, node->data.repeat_stmt.condition);
+    if (b->error != OK) return;
+    ir_terminate(b->block, IR_TERM_BR, cond, exit->id, body->id, b->line);
+    b->block = exit;
+}
+
+/**
+ * @brief CASE 标签比较：单值比较相等，区间标签先比下界再比上界
+ *
+ * 匹配时跳到 arm，否则在新块中继续后面的标签
+ */
+static void build_case_label(IrBuilder* b, IrReg selector, ASTNode* label, IrBlock* arm) {
+    bool is_range = (label->type == AST_CASE_RANGE);
+    IrReg args[2];
+    args[0] = selector;
+
+    if (is_range) {
+        args[1] = build_value(b, label->data.case_range.low);
+        IrBlock* upper = new_block(b);
+        IrBlock* miss = new_block(b);
+        if (b->error != OK) return;
+        IrInstr* ge = emit(b, IR_BINARY, TYPE_BOOL, args, 2);
+        if (!ge) return;
+        ge->opcode = OP_GE;
+        ir_terminate(b->block, IR_TERM_BR, ge->dest, upper->id, miss->id, b->line);
+
+        b->block = upper;
+        args[1] = build_value(b, label->data.case_range.high);
+        if (b->error != OK) return;
+        IrInstr* le = emit(b, IR_BINARY, TYPE_BOOL, args, 2);
+        if (!le) return;
+        le->opcode = OP_LE;
+        ir_terminate(b->block, IR_TERM_BR, le->dest, arm->id, miss->id, b->line);
+        b->block = miss;
+        return;
+    }
+
+    args[1] = build_value(b, label);
+    IrBlock* next = new_block(b);
+    if (b->error != OK) return;
+    IrInstr* eq = emit(b, IR_BINARY, TYPE_BOOL, args, 2);
+    if (!eq) return;
+    eq->opcode = OP_EQ;
+    ir_terminate(b->block, IR_TERM_BR, eq->dest, arm->id, next->id, b->line);
+    b->block = next;
+}
+
+/**
+ * @brief CASE 语句：选择表达式只计算一次
+ *
+ * 能用跳转表时（判定同 codegen，见 codegen_case_ranges）以 SWITCH 结束，
+ * 否则按标签顺序逐个比较。
+ */
+static void build_case(IrBuilder* b, ASTNode* node) {
+    IrReg selector = build_value(b, node->data.case_stmt.expression);
+    IrBlock* join = new_block(b);
+    if (b->error != OK) return;
+
+    CaseRange* ranges = NULL;
+    uint32_t range_count = 0;
+    if (codegen_case_ranges(node, &ranges, &range_count) != OK) {
+        build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+        return;
+    }
+    if (ranges) {
+        int count = node->data.case_stmt.case_count;
+        uint32_t* arms = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (count + 1));
+        SwitchCase* cases = (SwitchCase*)mmgr_alloc(sizeof(SwitchCase) * range_count);
+        IrBlock* dispatch = b->block;
+        IrBlock* otherwise = new_block(b);
+        if (!arms || !cases) build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+
+        for (int i = 0; i < count && b->error == OK; i++) {
+            IrBlock* arm = new_block(b);
+            if (!arm) break;
+            arms[i] = arm->id;
+            b->block = arm;
+            build_stmt_list(b, node->data.case_stmt.cases[i]->data.case_element.statements);
+            jump_to(b, join);
+        }
+        if (b->error == OK) {
+            for (uint32_t r = 0; r < range_count; r++) {
+                cases[r].low = ranges[r].low;
+                cases[r].high = ranges[r].high;
+                cases[r].target = arms[ranges[r].branch];
+            }
+            ErrorCode err = ir_terminate_switch(dispatch, selector,
+                                                codegen_case_table_kind(ranges, range_count),
+                                                cases, range_count, otherwise->id, b->line);
+            if (err != OK) build_error(b, err, "Out of memory while building IR");
+        }
+        mmgr_free(arms);
+        mmgr_free(cases);
+        mmgr_free(ranges);
+        if (b->error != OK) return;
+
+        b->block = otherwise;
+        build_stmt_list(b, node->data.case_stmt.default_case);
+        jump_to(b, join);
+        b->block = join;
+        return;
+    }
+
+    for (int i = 0; i < node->data.case_stmt.case_count; i++) {
+        ASTNode* element = node->data.case_stmt.cases[i];
+        if (!element || element->type != AST_CASE_ELEMENT) continue;
+
+        IrBlock* arm = new_block(b);
+        if (b->error != OK) return;
+        for (ASTNode* label = element->data.case_element.labels; label; label = label->next) {
+            build_case_label(b, selector, label, arm);
+            if (b->error != OK) return;
+        }
+
+        IrBlock* resume = b->block;
+        b->block = arm;
+        build_stmt_list(b, element->data.case_element.statements);
+        jump_to(b, join);
+        b->block = resume;
+    }
+
+    build_stmt_list(b, node->data.case_stmt.default_case);
+    jump_to(b, join);
+    b->block = join;
+}
+
+/**
+ * @brief 函数返回值（函数名变量的当前值），无可提升的返回值变量时为 IR_NO_REG
+ */
+static IrReg return_value(IrBuilder* b) {
+    if (b->func->is_main || b->func->return_offset < 0) return IR_NO_REG;
+    for (uint32_t v = 0; v < b->func->var_count; v++) {
+        if (b->func->vars[v].is_return) {
+            IrInstr* ins = emit(b, IR_LOAD, b->func->vars[v].type, NULL, 0);
+            if (!ins) return IR_NO_REG;
+            ins->var.name = b->func->vars[v].name;
+            ins->var.address = b->func->vars[v].offset;
+            ins->var.type = b->func->vars[v].type;
+            ins->var.promoted = (int32_t)v;
+            return ins->dest;
+        }
+    }
+    return IR_NO_REG;
+}
+
+static void terminate_return(IrBuilder* b) {
+    if (b->func->is_main) {
+        ir_terminate(b->block, IR_TERM_HALT, IR_NO_REG, 0, 0, b->line);
+    } else {
+        IrReg value = return_value(b);
+        ir_terminate(b->block, IR_TERM_RET, value, 0, 0, b->line);
+    }
+}
+
+static void build_return(IrBuilder* b, ASTNode* node) {
+    if (node->data.return_stmt.value) {
+        IrReg value = build_value(b, node->data.return_stmt.value);
+        if (b->error != OK) return;
+        // IEC 61131-3：返回值即函数名变量
+        if (b->func_name) {
+            Symbol* sym = symtbl_lookup(b->symtbl, b->func_name);
+            if (sym && sym->kind != SYM_FUNCTION && !sym->is_global) {
+                store_symbol(b, sym, value);
+            }
+        }
+    }
+    terminate_return(b);
+
+    // RETURN 之后的语句不可达，放入新块（构建 CFG 时删除）
+    IrBlock* dead = new_block(b);
+    if (dead) b->block = dead;
+}
+
+static void build_stmt(IrBuilder* b, ASTNode* stmt) {
+    int saved_line = b->line;
+    if (stmt->location.line > 0) b->line = stmt->location.line;
+
+    switch (stmt->type) {
+        case AST_ASSIGN: build_assign(b, stmt); break;
+        case AST_IF:     build_if(b, stmt); break;
+        case AST_WHILE:  build_while(b, stmt); break;
+        case AST_FOR:    build_for(b, stmt); break;
+        case AST_REPEAT: build_repeat(b, stmt); break;
+        case AST_CASE:   build_case(b, stmt); break;
+        case AST_RETURN: build_return(b, stmt); break;
+        default:
+            // 表达式语句：结果不使用
+            build_expr(b, stmt);
+            break;
+    }
+
+    b->line = saved_line;
+}
+
+static void build_stmt_list(IrBuilder* b, ASTNode* stmts) {
+    for (ASTNode* stmt = stmts; stmt && b->error == OK; stmt = stmt->next) {
+        if (stmt->type == AST_BLOCK) {
+            // 语句块的语句就是链表中其后的语句（见 ast_create_block）
+            build_stmt_list(b, stmt->next);
+            return;
+        }
+        build_stmt(b, stmt);
+    }
+}
+
+/**
+ * @brief 取消帧内变量的提升（按帧内偏移，函数名返回值变量除外）
+ */
+static void pin_frame_var(IrFunction* func, const Symbol* sym) {
+    if (!sym || sym->is_global) return;
+    for (uint32_t v = 0; v < func->var_count; v++) {
+        if (func->vars[v].offset != (uint16_t)sym->offset || func->vars[v].is_return) continue;
+        memmove(&func->vars[v], &func->vars[v + 1], sizeof(IrVar) * (func->var_count - v - 1));
+        func->var_count--;
+        return;
+    }
+}
+
+/**
+ * @brief 能用循环描述符的 FOR 循环的循环变量和终值变量留在内存中（不提升）
+ *
+ * 在构建语句之前调用：提升与否须在整个函数内一致。
+ */
+static void pin_loop_vars(IrBuilder* b, ASTNode* stmts) {
+    for (ASTNode* stmt = stmts; stmt && b->error == OK; stmt = stmt->next) {
+        switch (stmt->type) {
+            case AST_IF:
+                pin_loop_vars(b, stmt->data.if_stmt.then_branch);
+                pin_loop_vars(b, stmt->data.if_stmt.else_branch);
+                break;
+            case AST_WHILE:
+                pin_loop_vars(b, stmt->data.while_stmt.body);
+                break;
+            case AST_REPEAT:
+                pin_loop_vars(b, stmt->data.repeat_stmt.body);
+                break;
+            case AST_CASE:
+                for (int i = 0; i < stmt->data.case_stmt.case_count; i++) {
+                    ASTNode* element = stmt->data.case_stmt.cases[i];
+                    if (element && element->type == AST_CASE_ELEMENT) {
+                        pin_loop_vars(b, element->data.case_element.statements);
+                    }
+                }
+                pin_loop_vars(b, stmt->data.case_stmt.default_case);
+                break;
+            case AST_FOR: {
+                Symbol* var = lookup_variable(b, stmt->data.for_stmt.variable);
+                ForLoop loop;
+                if (var && codegen_for_loop_descriptor(b->symtbl, b->func_name, stmt, var, &loop)) {
+                    pin_frame_var(b->func, var);
+                    if (loop.flags & FOR_LOOP_END_VAR) {
+                        pin_frame_var(b->func, lookup_variable(b, stmt->data.for_stmt.end->data.identifier.name));
+                    }
+                }
+                pin_loop_vars(b, stmt->data.for_stmt.body);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
+
+/**
+ * @brief 变量声明的初始化（与 codegen 的 generate_var_decls 一致）
+ */
+static void build_var_inits(IrBuilder* b, ASTNode* decls) {
+    for (ASTNode* decl = decls; decl && b->error == OK; decl = decl->next) {
+        if (decl->type != AST_VAR_DECL) continue;
+
+        int saved_line = b->line;
+        if (decl->location.line > 0) b->line = decl->location.line;
+
+        Symbol* sym = lookup_variable(b, decl->data.var_decl.name);
+        if (sym) {
+            if (decl->data.var_decl.initializer) {
+                IrReg value = build_value(b, decl->data.var_decl.initializer);
+                if (b->error == OK) store_symbol(b, sym, value);
+            } else if (!sym->is_global && sym->type) {
+                // 局部变量每次调用都初始化为默认值；全局变量由 VM 清零并在热更新时保留
+                DataType type = sym->type->base_type;
+                if (type == TYPE_INT || type == TYPE_REAL || type == TYPE_BOOL || type == TYPE_STRING) {
+                    Value value;
+                    memset(&value, 0, sizeof(value));
+                    value.type = type;
+                    if (type == TYPE_STRING) value.string_val = "";
+                    IrReg reg = emit_const(b, value);
+                    if (b->error == OK) store_symbol(b, sym, reg);
+                }
+            }
+        }
+
+        b->line = saved_line;
+    }
+}
+
+// ============================================================================
+// 函数与程序
+// ============================================================================
+
+static void build_function(IrBuilder* b, ASTNode* decl) {
+    const char* name = decl->data.function_decl.name;
+    Symbol* func_sym = symtbl_lookup(b->symtbl, name);
+    if (!func_sym) {
+        build_error(b, ERR_NAME, "Undefined function: %s", name);
+        return;
+    }
+
+    IrFunction* func = ir_function_add(b->module, name);
+    if (!func) {
+        build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+        return;
+    }
+    b->func = func;
+    b->block = func->blocks[0];
+    b->func_name = name;
+    b->line = decl->location.line;
+
+    symtbl_enter_scope(b->symtbl);
+    symtbl_reset_local_offset(b->symtbl);
+
+    // 1. 参数
+    for (ASTNode* param = decl->data.function_decl.params; param; param = param->next) {
+        if (param->type == AST_VAR_DECL) func->param_count++;
+    }
+    if (func->param_count > 0) {
+        func->param_types = (DataType*)mmgr_alloc(sizeof(DataType) * func->param_count);
+        if (!func->param_types) {
+            build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+            goto leave;
+        }
+    }
+    int32_t index = 0;
+    for (ASTNode* param = decl->data.function_decl.params; param; param = param->next) {
+        if (param->type != AST_VAR_DECL) continue;
+        Symbol* sym = symtbl_define_parameter(b->symtbl, param->data.var_decl.name, param->data.var_decl.type);
+        if (!sym) {
+            build_error(b, ERR_NAME, "Cannot define parameter: %s", param->data.var_decl.name);
+            goto leave;
+        }
+        DataType type = param->data.var_decl.type ? param->data.var_decl.type->base_type : TYPE_VOID;
+        func->param_types[index] = type;
+        if (is_promotable_type(type)) {
+            ir_add_var(func, sym->name, type, (uint16_t)sym->offset, index, false);
+        }
+        index++;
+    }
+
+    // 2. 函数名作为返回值变量
+    TypeInfo* return_type = func_sym->type ? func_sym->type->func_info.return_type : NULL;
+    if (return_type) {
+        Symbol* sym = symtbl_define_variable(b->symtbl, name, return_type, false);
+        if (!sym) {
+            build_error(b, ERR_NAME, "Cannot define return value variable: %s", name);
+            goto leave;
+        }
+        func->return_type = return_type->base_type;
+        func->return_offset = sym->offset;
+        if (is_promotable_type(return_type->base_type)) {
+            ir_add_var(func, sym->name, return_type->base_type, (uint16_t)sym->offset, -1, true);
+        }
+    }
+
+    // 3. 局部变量（静态变量在全局区，已由类型检查定义）
+    for (ASTNode* var = decl->data.function_decl.declarations; var; var = var->next) {
+        if (var->type != AST_VAR_DECL || var->data.var_decl.is_global) continue;
+        Symbol* sym = symtbl_define_variable(b->symtbl, var->data.var_decl.name,
+                                             var->data.var_decl.type, var->data.var_decl.is_const);
+        if (!sym) {
+            build_error(b, ERR_NAME, "Cannot define local variable: %s", var->data.var_decl.name);
+            goto leave;
+        }
+        DataType type = var->data.var_decl.type ? var->data.var_decl.type->base_type : TYPE_VOID;
+        if (is_promotable_type(type) && !sym->is_external) {
+            ir_add_var(func, sym->name, type, (uint16_t)sym->offset, -1, false);
+        }
+    }
+    func->frame_size = b->symtbl->local_var_offset;
+    pin_loop_vars(b, decl->data.function_decl.body);
+
+    // 4. 入口：参数值写入对应变量，然后是局部变量初始化和函数体
+    for (uint32_t v = 0; v < func->var_count && b->error == OK; v++) {
+        if (func->vars[v].param_index < 0) continue;
+        IrInstr* param = emit(b, IR_PARAM, func->vars[v].type, NULL, 0);
+        if (!param) break;
+        param->index = func->vars[v].param_index;
+        IrReg value = param->dest;
+        IrInstr* store = emit(b, IR_STORE, TYPE_VOID, &value, 1);
+        if (!store) break;
+        store->var.name = func->vars[v].name;
+        store->var.address = func->vars[v].offset;
+        store->var.type = func->vars[v].type;
+        store->var.promoted = (int32_t)v;
+    }
+
+    build_var_inits(b, decl->data.function_decl.declarations);
+    build_stmt_list(b, decl->data.function_decl.body);
+    if (b->error == OK) terminate_return(b);
+
+    if (b->error == OK) {
+        ErrorCode err = ir_to_ssa(func);
+        if (err != OK) build_error(b, err, "Cannot construct SSA form for %s", name);
+    }
+
+leave:
+    symtbl_leave_scope(b->symtbl);
+    b->func_name = NULL;
+}
+
+static void build_main(IrBuilder* b, ASTNode* program) {
+    IrFunction* func = ir_function_add(b->module, IR_MAIN_NAME);
+    if (!func) {
+        build_error(b, ERR_OUT_OF_MEMORY, "Out of memory while building IR");
+        return;
+    }
+    func->is_main = true;
+    b->func = func;
+    b->block = func->blocks[0];
+    b->func_name = NULL;
+    b->line = 0;
+
+    build_var_inits(b, program->data.program.var_decls);
+    build_stmt_list(b, program->data.program.body);
+    if (b->error == OK) terminate_return(b);
+
+    if (b->error == OK) {
+        ErrorCode err = ir_to_ssa(func);
+        if (err != OK) build_error(b, err, "Cannot construct SSA form for main program");
+    }
+}
+
+ErrorCode ir_build(ASTNode* program, SymbolTable* symtbl,
+                   char* error_msg, size_t error_size, IrModule** out) {
+    if (!program || !symtbl || !out) return ERR_RUNTIME;
+    *out = NULL;
+
+    if (program->type != AST_PROGRAM) {
+        if (error_msg && error_size > 0) {
+            snprintf(error_msg, error_size, "Expected program node, got %d", program->type);
+        }
+        return ERR_RUNTIME;
+    }
+
+    IrBuilder b;
+    memset(&b, 0, sizeof(b));
+    b.module = ir_module_create();
+    b.symtbl = symtbl;
+    b.program = program;
+    b.error = OK;
+    b.error_msg = error_msg;
+    b.error_size = error_size;
+    if (!b.module) return ERR_OUT_OF_MEMORY;
+
+    for (ASTNode* func = program->data.program.functions; func && b.error == OK; func = func->next) {
+        if (func->type == AST_FUNCTION_DECL) build_function(&b, func);
+    }
+    if (b.error == OK) build_main(&b, program);
+
+    if (b.error != OK) {
+        ir_module_free(b.module);
+        return b.error;
+    }
+    *out = b.module;
+    return OK;
+}
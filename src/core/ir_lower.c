@@ -0,0 +1,775 @@
+/**
+ * @file ir_lower.c
+ * @brief 中间表示 - 降级为栈式字节码
+ *
+ * 基本块按逆后序排列。寄存器的存放方式：
+ * 1. 常量、参数入口值：不占位置，每次使用时重新生成（PUSH / LOAD 参数槽）；
+ *    只在定义块内使用、定义与使用之间没有可能改写该变量的指令的 LOAD 也在使用处重新读取，
+ *    FOR 循环体内对循环变量的读取因此保持可被数组下标证明识别的形式
+ * 2. 只在定义块内被下一条相邻使用者按栈序消费一次的值：留在操作数栈上，
+ *    与 codegen 生成的表达式求值序列相同
+ * 3. 其余值（跨块、多次使用、栈序不匹配）：定义后 STORE 到帧槽位，使用时 LOAD。
+ *    帧槽位追加在符号表分配的帧之后，函数的 local_count 相应增大
+ *
+ * 第 2 类的判定通过逐块模拟操作数栈完成：某个值在使用时不在期望的栈位置，
+ * 就把它降为第 3 类并重新模拟该块，直到整块可以调度。
+ *
+ * PHI 使用两组槽位消除并行复制问题：前驱在跳转前把操作数写入"入口槽"，
+ * 后继块开头把入口槽复制到 PHI 自身的槽位。
+ *
+ * FOR_INIT/FOR_STEP 降级为 OP_FOR_INIT/OP_FOR_STEP，循环描述符的 body 为循环体块的
+ * 地址，exit 为 OP_FOR_STEP 之后（出口块不紧随其后时在此处跳转）；SWITCH 降级为
+ * OP_SWITCH，跳转表在块地址确定后登记。
+ *
+ * 主程序需要帧槽位时包装为函数 IR_MAIN_NAME，入口处 CALL 之后 HALT。
+ */
+
+#include "ir.h"
+#include "mmgr.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NO_SLOT (-1)
+
+/**
+ * @brief 单个函数的降级状态
+ */
+typedef struct {
+    IrFunction* func;
+    IrInstr** def;              // 寄存器的定义指令
+    uint32_t* def_block;        // 定义所在块
+    uint32_t* uses;             // 使用次数
+    uint32_t* use_block;        // 最后一次使用所在块
+    bool* use_in_phi;           // 最后一次使用是否为 PHI 操作数
+    bool* on_stack;             // 在操作数栈上传递
+    bool* remat_load;           // 在使用处重新 LOAD 的变量读取
+    int32_t* slot;              // 帧槽位
+    int32_t* phi_in;            // PHI 的入口槽位
+    int32_t slot_count;         // 追加的槽位数
+    uint32_t* order;            // 块排列顺序
+    uint32_t* address;          // 块起始地址
+    uint32_t* loop_index;       // FOR 循环描述符在模块中的下标
+    int64_t* loop_exit;         // OP_FOR_STEP 之后的地址（没有 FOR_STEP 时为 -1）
+    int32_t function_index;     // 函数表下标（未包装的主程序为 -1）
+    bool wrapped;               // 主程序包装为函数
+} LowerFunc;
+
+/**
+ * @brief 跳转回填项
+ */
+typedef struct {
+    uint32_t instruction;
+    uint32_t block;
+} JumpFixup;
+
+/**
+ * @brief 跳转表回填项（OP_SWITCH 指令与 SWITCH 终结符所在块）
+ */
+typedef struct {
+    uint32_t instruction;
+    const IrBlock* block;
+} SwitchFixup;
+
+/**
+ * @brief 降级上下文
+ */
+typedef struct {
+    IrModule* ir;
+    BytecodeModule* module;
+    SymbolTable* symtbl;
+    LowerFunc* funcs;
+    JumpFixup* fixups;
+    uint32_t fixup_count;
+    uint32_t fixup_capacity;
+    SwitchFixup* switches;
+    uint32_t switch_count;
+    uint32_t switch_capacity;
+    ErrorCode error;
+    char* error_msg;
+    size_t error_size;
+} LowerCtx;
+
+static void lower_error(LowerCtx* lc, ErrorCode code, const char* msg) {
+    if (lc->error != OK) return;
+    lc->error = code;
+    if (lc->error_msg && lc->error_size > 0) {
+        snprintf(lc->error_msg, lc->error_size, "%s", msg);
+    }
+}
+
+static bool is_remat(const LowerFunc* lf, IrReg r) {
+    const IrInstr* def = lf->def[r];
+    return def && (def->op == IR_CONST || def->op == IR_PARAM || lf->remat_load[r]);
+}
+
+static void free_lower_func(LowerFunc* lf) {
+    mmgr_free(lf->def);
+    mmgr_free(lf->def_block);
+    mmgr_free(lf->uses);
+    mmgr_free(lf->use_block);
+    mmgr_free(lf->use_in_phi);
+    mmgr_free(lf->on_stack);
+    mmgr_free(lf->remat_load);
+    mmgr_free(lf->slot);
+    mmgr_free(lf->phi_in);
+    mmgr_free(lf->order);
+    mmgr_free(lf->address);
+    mmgr_free(lf->loop_index);
+    mmgr_free(lf->loop_exit);
+}
+
+// ============================================================================
+// 调度分析
+// ============================================================================
+
+/**
+ * @brief 检查一组操作数能否按栈序消费
+ *
+ * 留在栈上的操作数必须是参数列表的前缀，并且恰好是模拟栈的栈顶部分。
+ *
+ * @return 需要降为槽位的寄存器，可以调度时返回 IR_NO_REG
+ */
+static IrReg consume_operands(const LowerFunc* lf, IrReg* vstack, uint32_t* depth,
+                              const IrReg* args, uint32_t count) {
+    uint32_t k = 0;
+    while (k < count && args[k] >= 0 && lf->on_stack[args[k]]) k++;
+    for (uint32_t j = k; j < count; j++) {
+        if (args[j] >= 0 && lf->on_stack[args[j]]) return args[j];
+    }
+    if (k == 0) return IR_NO_REG;
+    if (*depth < k) return args[0];
+
+    for (uint32_t j = 0; j < k; j++) {
+        if (vstack[*depth - k + j] != args[j]) {
+            // 栈顶是与本指令无关的值时降级栈顶，否则降级最深的操作数
+            IrReg top = vstack[*depth - 1];
+            for (uint32_t m = 0; m < k; m++) {
+                if (args[m] == top) return args[0];
+            }
+            return top;
+        }
+    }
+    *depth -= k;
+    return IR_NO_REG;
+}
+
+/**
+ * @brief 模拟一个块的操作数栈
+ * @return 需要降为槽位的寄存器，整块可调度时返回 IR_NO_REG
+ */
+static IrReg simulate_block(const LowerFunc* lf, const IrBlock* block, IrReg* vstack) {
+    uint32_t depth = 0;
+    for (uint32_t i = 0; i < block->instr_count; i++) {
+        const IrInstr* ins = &block->instrs[i];
+        if (ins->op == IR_PHI) continue;
+
+        IrReg bad = consume_operands(lf, vstack, &depth, ins->args, ins->arg_count);
+        if (bad != IR_NO_REG) return bad;
+        if (ins->dest >= 0 && lf->on_stack[ins->dest]) vstack[depth++] = ins->dest;
+    }
+    if (block->term_value >= 0) {
+        IrReg bad = consume_operands(lf, vstack, &depth, &block->term_value, 1);
+        if (bad != IR_NO_REG) return bad;
+    }
+    return depth > 0 ? vstack[depth - 1] : IR_NO_REG;
+}
+
+/**
+ * @brief 指令是否可能改写 load 读取的变量（重新 LOAD 时不能越过）
+ *
+ * 写内存的指令按地址范围判断；调用和 I/O 可能改写任意全局变量，帧内变量只会被本帧的写入改变。
+ */
+static bool may_clobber(const IrInstr* ins, const IrInstr* load) {
+    switch (ins->op) {
+        case IR_STORE:
+        case IR_STORE_INDEXED:
+        case IR_STORE_MEMBER:
+            return ir_may_alias(ins, load);
+        case IR_CALL:
+        case IR_IO_READ:
+        case IR_IO_WRITE:
+            return load->var.is_global;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 块内第 index 条 LOAD 的值能否在每个使用处重新读取
+ *
+ * 要求所有使用都是本块的非 PHI 指令或终结符，且定义之后第一条可能改写该变量的指令之后
+ * 不再使用（该指令本身可以使用，操作数在写入前已压栈）。
+ */
+static bool can_reload(const LowerFunc* lf, const IrBlock* block, uint32_t index) {
+    const IrInstr* load = &block->instrs[index];
+    IrReg r = load->dest;
+    uint32_t found = 0;
+    bool written = false;
+    for (uint32_t i = index + 1; i < block->instr_count; i++) {
+        const IrInstr* ins = &block->instrs[i];
+        for (uint32_t a = 0; a < ins->arg_count; a++) {
+            if (ins->args[a] != r) continue;
+            if (written || ins->op == IR_PHI) return false;
+            found++;
+        }
+        if (may_clobber(ins, load)) written = true;
+    }
+    if (block->term_value == r) {
+        if (written) return false;
+        found++;
+    }
+    return found == lf->uses[r];
+}
+
+/**
+ * @brief 分析函数：决定每个寄存器的存放方式并分配槽位
+ */
+static ErrorCode analyze_function(LowerFunc* lf, IrFunction* func) {
+    memset(lf, 0, sizeof(*lf));
+    lf->func = func;
+    lf->function_index = -1;
+
+    uint32_t regs = func->reg_count + 1;
+    uint32_t blocks = func->block_count;
+    lf->def = (IrInstr**)mmgr_calloc(sizeof(IrInstr*) * regs);
+    lf->def_block = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * regs);
+    lf->uses = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * regs);
+    lf->use_block = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * regs);
+    lf->use_in_phi = (bool*)mmgr_calloc(sizeof(bool) * regs);
+    lf->on_stack = (bool*)mmgr_calloc(sizeof(bool) * regs);
+    lf->remat_load = (bool*)mmgr_calloc(sizeof(bool) * regs);
+    lf->slot = (int32_t*)mmgr_alloc(sizeof(int32_t) * regs);
+    lf->phi_in = (int32_t*)mmgr_alloc(sizeof(int32_t) * regs);
+    lf->order = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (blocks + 1));
+    lf->address = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * (blocks + 1));
+    lf->loop_index = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * (func->loop_count + 1));
+    lf->loop_exit = (int64_t*)mmgr_alloc(sizeof(int64_t) * (func->loop_count + 1));
+    if (!lf->def || !lf->def_block || !lf->uses || !lf->use_block || !lf->use_in_phi ||
+        !lf->on_stack || !lf->remat_load || !lf->slot || !lf->phi_in || !lf->order || !lf->address ||
+        !lf->loop_index || !lf->loop_exit) {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    // 1. 定义与使用位置；块按逆后序排列
+    for (uint32_t b = 0; b < blocks; b++) {
+        IrBlock* block = func->blocks[b];
+        lf->order[block->rpo >= 0 ? (uint32_t)block->rpo : b] = b;
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            IrInstr* ins = &block->instrs[i];
+            if (ins->dest >= 0) {
+                lf->def[ins->dest] = ins;
+                lf->def_block[ins->dest] = b;
+            }
+            for (uint32_t a = 0; a < ins->arg_count; a++) {
+                IrReg r = ins->args[a];
+                if (r < 0) continue;
+                lf->uses[r]++;
+                lf->use_block[r] = b;
+                lf->use_in_phi[r] = ins->op == IR_PHI;
+            }
+        }
+        if (block->term_value >= 0) {
+            lf->uses[block->term_value]++;
+            lf->use_block[block->term_value] = b;
+            lf->use_in_phi[block->term_value] = false;
+        }
+    }
+
+    // 2. 候选：定义块内唯一一次非 PHI 使用
+    for (uint32_t r = 0; r < func->reg_count; r++) {
+        IrInstr* def = lf->def[r];
+        lf->on_stack[r] = def && def->op != IR_PHI && !is_remat(lf, (IrReg)r) &&
+                          lf->uses[r] == 1 && !lf->use_in_phi[r] &&
+                          lf->use_block[r] == lf->def_block[r];
+    }
+
+    // 3. 逐块模拟，无法按栈序消费的值降为槽位
+    uint32_t max_instrs = 1;
+    for (uint32_t b = 0; b < blocks; b++) {
+        if (func->blocks[b]->instr_count + 1 > max_instrs) max_instrs = func->blocks[b]->instr_count + 1;
+    }
+    IrReg* vstack = (IrReg*)mmgr_alloc(sizeof(IrReg) * max_instrs);
+    if (!vstack) return ERR_OUT_OF_MEMORY;
+    for (uint32_t b = 0; b < blocks; b++) {
+        IrReg bad;
+        while ((bad = simulate_block(lf, func->blocks[b], vstack)) != IR_NO_REG) {
+            lf->on_stack[bad] = false;
+        }
+    }
+    mmgr_free(vstack);
+
+    // 4. 不能留在栈上的变量读取尽量在使用处重新 LOAD
+    for (uint32_t b = 0; b < blocks; b++) {
+        const IrBlock* block = func->blocks[b];
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            const IrInstr* ins = &block->instrs[i];
+            if (ins->op == IR_LOAD && ins->dest >= 0 && !lf->on_stack[ins->dest] &&
+                lf->uses[ins->dest] > 0) {
+                lf->remat_load[ins->dest] = can_reload(lf, block, i);
+            }
+        }
+    }
+
+    // 5. 槽位分配（追加在符号表分配的帧之后）
+    for (uint32_t r = 0; r < func->reg_count; r++) {
+        lf->slot[r] = NO_SLOT;
+        lf->phi_in[r] = NO_SLOT;
+        IrInstr* def = lf->def[r];
+        if (!def || lf->on_stack[r] || is_remat(lf, (IrReg)r)) continue;
+        if (def->op == IR_PHI) {
+            lf->slot[r] = func->frame_size + lf->slot_count++;
+            lf->phi_in[r] = func->frame_size + lf->slot_count++;
+        } else if (lf->uses[r] > 0) {
+            lf->slot[r] = func->frame_size + lf->slot_count++;
+        }
+    }
+
+    lf->wrapped = func->is_main && lf->slot_count > 0;
+    return OK;
+}
+
+// ============================================================================
+// 指令发射
+// ============================================================================
+
+static uint32_t emit_instr(LowerCtx* lc, Opcode opcode, uint8_t flags, uint16_t operand, int line) {
+    uint32_t index = line > 0
+        ? bytecode_add_instruction_with_line(lc->module, opcode, flags, operand, line)
+        : bytecode_add_instruction(lc->module, opcode, flags, operand);
+    if (index == (uint32_t)-1) lower_error(lc, ERR_OUT_OF_MEMORY, "Out of memory while lowering IR");
+    return index;
+}
+
+static void emit_jump(LowerCtx* lc, Opcode opcode, uint32_t target, int line) {
+    uint32_t index = emit_instr(lc, opcode, 0, 0, line);
+    if (index == (uint32_t)-1) return;
+
+    if (lc->fixup_count >= lc->fixup_capacity) {
+        uint32_t capacity = lc->fixup_capacity ? lc->fixup_capacity * 2 : 32;
+        JumpFixup* fixups = (JumpFixup*)mmgr_realloc(lc->fixups, sizeof(JumpFixup) * capacity);
+        if (!fixups) {
+            lower_error(lc, ERR_OUT_OF_MEMORY, "Out of memory while lowering IR");
+            return;
+        }
+        lc->fixups = fixups;
+        lc->fixup_capacity = capacity;
+    }
+    lc->fixups[lc->fixup_count].instruction = index;
+    lc->fixups[lc->fixup_count].block = target;
+    lc->fixup_count++;
+}
+
+static int32_t add_constant(BytecodeModule* module, Value value) {
+    switch (value.type) {
+        case TYPE_INT:    return (int32_t)bytecode_add_int_constant(module, value.int_val);
+        case TYPE_REAL:   return (int32_t)bytecode_add_real_constant(module, value.real_val);
+        case TYPE_BOOL:   return (int32_t)bytecode_add_bool_constant(module, value.bool_val);
+        case TYPE_STRING: return (int32_t)bytecode_add_string_constant(module, value.string_val ? value.string_val : "");
+        default:          return -1;
+    }
+}
+
+/**
+ * @brief 把不在栈上的操作数压栈
+ */
+static void push_operand(LowerCtx* lc, const LowerFunc* lf, IrReg r, int line) {
+    const IrInstr* def = lf->def[r];
+    if (def && def->op == IR_CONST) {
+        int32_t index = add_constant(lc->module, def->constant);
+        if (index < 0) {
+            lower_error(lc, ERR_OUT_OF_MEMORY, "Cannot add constant while lowering IR");
+            return;
+        }
+        emit_instr(lc, OP_PUSH, 0, (uint16_t)index, line);
+    } else if (def && def->op == IR_PARAM) {
+        emit_instr(lc, OP_LOAD, FLAG_LOCAL, (uint16_t)def->index, line);
+    } else if (lf->remat_load[r]) {
+        emit_instr(lc, OP_LOAD, def->var.is_global ? FLAG_GLOBAL : FLAG_LOCAL, def->var.address, line);
+    } else if (lf->slot[r] != NO_SLOT) {
+        emit_instr(lc, OP_LOAD, FLAG_LOCAL, (uint16_t)lf->slot[r], line);
+    } else {
+        lower_error(lc, ERR_RUNTIME, "IR value has no location");
+    }
+}
+
+/**
+ * @brief 查找或登记被调函数，返回函数表下标
+ */
+static int32_t call_target(LowerCtx* lc, const IrInstr* ins, bool* internal) {
+    IrFunction* callee = ir_module_find_function(lc->ir, ins->callee);
+    if (callee) {
+        for (uint32_t i = 0; i < lc->ir->function_count; i++) {
+            if (lc->ir->functions[i] == callee) {
+                *internal = true;
+                return lc->funcs[i].function_index;
+            }
+        }
+    }
+
+    *internal = false;
+    FunctionEntry* entry = bytecode_find_function(lc->module, ins->callee);
+    if (entry) return (int32_t)(entry - lc->module->functions);
+
+    // 外部函数：地址为 0 的函数表项，运行时由 CALL_EXT 按名称解析
+    uint32_t index = bytecode_add_function(lc->module, ins->callee, 0, ins->callee_params,
+                                           0, ins->type, NULL);
+    if (index == (uint32_t)-1) {
+        lower_error(lc, ERR_RUNTIME, "Failed to add external function");
+        return -1;
+    }
+    return (int32_t)index;
+}
+
+static void emit_operation(LowerCtx* lc, const IrInstr* ins) {
+    uint8_t flags = ins->var.is_global ? FLAG_GLOBAL : FLAG_LOCAL;
+    int line = ins->line;
+
+    switch (ins->op) {
+        case IR_CONST:
+        case IR_PARAM:
+        case IR_COPY:
+        case IR_PHI:
+            break;
+        case IR_BINARY:
+        case IR_UNARY:
+            emit_instr(lc, ins->opcode, 0, 0, line);
+            break;
+        case IR_LOAD:
+            emit_instr(lc, OP_LOAD, flags, ins->var.address, line);
+            break;
+        case IR_STORE:
+            emit_instr(lc, OP_STORE, flags, ins->var.address, line);
+            break;
+        case IR_LOAD_INDEXED:
+        case IR_STORE_INDEXED: {
+            // 声明长度已知时按数组描述符检查（免检标记在生成结束后统一计算）
+            bool is_store = ins->op == IR_STORE_INDEXED;
+            uint32_t bound = ins->var.length > 0
+                ? bytecode_add_array_bound(lc->module, ins->var.address, ins->var.lower,
+                                           ins->var.length, ins->var.is_global)
+                : (uint32_t)-1;
+            if (bound != (uint32_t)-1) {
+                emit_instr(lc, is_store ? OP_STORE_ARRAY : OP_LOAD_ARRAY, 0, (uint16_t)bound, line);
+            } else {
+                // *_INDEXED 按相对首元素的偏移寻址
+                if (ins->var.lower != 0) {
+                    emit_instr(lc, OP_PUSH, 0,
+                               (uint16_t)bytecode_add_int_constant(lc->module, ins->var.lower), line);
+                    emit_instr(lc, OP_SUB, 0, 0, line);
+                }
+                emit_instr(lc, is_store ? OP_STORE_INDEXED : OP_LOAD_INDEXED, flags, ins->var.address, line);
+            }
+            break;
+        }
+        case IR_LOAD_MEMBER:
+        case IR_STORE_MEMBER:
+            emit_instr(lc, ins->opcode, flags, ins->var.address, line);
+            break;
+        case IR_IO_READ:
+        case IR_IO_WRITE: {
+            uint32_t index = bytecode_add_string_constant(lc->module, ins->io_address);
+            if (index == (uint32_t)-1) {
+                lower_error(lc, ERR_OUT_OF_MEMORY, "Cannot add constant while lowering IR");
+                return;
+            }
+            emit_instr(lc, ins->op == IR_IO_READ ? OP_IO_READ : OP_IO_WRITE, 0, (uint16_t)index, line);
+            break;
+        }
+        case IR_CALL: {
+            bool internal = false;
+            int32_t index = call_target(lc, ins, &internal);
+            if (index < 0) return;
+            if (internal) {
+                emit_instr(lc, OP_CALL, 0, (uint16_t)index, line);
+            } else {
+                emit_instr(lc, OP_CALL_EXT, (uint8_t)ins->arg_count, (uint16_t)index, line);
+            }
+            break;
+        }
+    }
+}
+
+static bool is_next_block(const LowerFunc* lf, uint32_t position, uint32_t block) {
+    return position + 1 < lf->func->block_count && lf->order[position + 1] == block;
+}
+
+static void lower_block(LowerCtx* lc, LowerFunc* lf, uint32_t position) {
+    IrFunction* func = lf->func;
+    IrBlock* block = func->blocks[lf->order[position]];
+    lf->address[block->id] = bytecode_current_position(lc->module);
+
+    // 1. PHI：入口槽 → PHI 槽
+    for (uint32_t i = 0; i < block->instr_count && block->instrs[i].op == IR_PHI; i++) {
+        IrReg dest = block->instrs[i].dest;
+        if (lf->slot[dest] == NO_SLOT) continue;
+        emit_instr(lc, OP_LOAD, FLAG_LOCAL, (uint16_t)lf->phi_in[dest], block->instrs[i].line);
+        emit_instr(lc, OP_STORE, FLAG_LOCAL, (uint16_t)lf->slot[dest], block->instrs[i].line);
+    }
+
+    // 2. 普通指令
+    int line = 0;
+    for (uint32_t i = 0; i < block->instr_count && lc->error == OK; i++) {
+        const IrInstr* ins = &block->instrs[i];
+        if (ins->op == IR_PHI || (ins->dest >= 0 && lf->remat_load[ins->dest])) continue;
+        line = ins->line;
+
+        uint32_t k = 0;
+        while (k < ins->arg_count && lf->on_stack[ins->args[k]]) k++;
+        for (uint32_t a = k; a < ins->arg_count; a++) {
+            push_operand(lc, lf, ins->args[a], line);
+        }
+        emit_operation(lc, ins);
+
+        IrReg dest = ins->dest;
+        if (dest < 0 || is_remat(lf, dest) || lf->on_stack[dest]) continue;
+        if (lf->uses[dest] == 0) {
+            emit_instr(lc, OP_POP, 0, 0, line);
+        } else {
+            emit_instr(lc, OP_STORE, FLAG_LOCAL, (uint16_t)lf->slot[dest], line);
+        }
+    }
+    if (block->term_line > 0) line = block->term_line;
+
+    // 3. 后继块 PHI 的入口槽
+    for (uint32_t s = 0; s < block->succ_count; s++) {
+        IrBlock* succ = func->blocks[block->succs[s]];
+        for (uint32_t p = 0; p < succ->pred_count; p++) {
+            if (succ->preds[p] != block->id) continue;
+            for (uint32_t i = 0; i < succ->instr_count && succ->instrs[i].op == IR_PHI; i++) {
+                const IrInstr* phi = &succ->instrs[i];
+                push_operand(lc, lf, phi->args[p], line);
+                emit_instr(lc, OP_STORE, FLAG_LOCAL, (uint16_t)lf->phi_in[phi->dest], line);
+            }
+        }
+    }
+
+    // 4. 终结符
+    IrReg value = block->term_value;
+    if (value >= 0 && !lf->on_stack[value]) push_operand(lc, lf, value, line);
+
+    switch (block->term) {
+        case IR_TERM_JMP:
+            if (!is_next_block(lf, position, block->succs[0])) {
+                emit_jump(lc, OP_JMP, block->succs[0], line);
+            }
+            break;
+        case IR_TERM_BR:
+            if (is_next_block(lf, position, block->succs[0])) {
+                emit_jump(lc, OP_JZ, block->succs[1], line);
+            } else if (is_next_block(lf, position, block->succs[1])) {
+                emit_jump(lc, OP_JNZ, block->succs[0], line);
+            } else {
+                emit_jump(lc, OP_JZ, block->succs[1], line);
+                emit_jump(lc, OP_JMP, block->succs[0], line);
+            }
+            break;
+        case IR_TERM_RET:
+            // 返回值写入函数名变量槽位（VM 从 bp + param_count 读取）
+            if (value >= 0) {
+                emit_instr(lc, OP_STORE, FLAG_LOCAL, (uint16_t)func->return_offset, line);
+            }
+            emit_instr(lc, OP_RET, 0, 0, line);
+            break;
+        case IR_TERM_HALT:
+            emit_instr(lc, lf->wrapped ? OP_RET : OP_HALT, 0, 0, line);
+            break;
+        case IR_TERM_FOR_INIT:
+            // 进入循环时顺序执行到循环体
+            emit_instr(lc, OP_FOR_INIT, 0, (uint16_t)lf->loop_index[block->loop], line);
+            if (!is_next_block(lf, position, block->succs[0])) {
+                emit_jump(lc, OP_JMP, block->succs[0], line);
+            }
+            break;
+        case IR_TERM_FOR_STEP:
+            // 循环结束时顺序执行到出口
+            emit_instr(lc, OP_FOR_STEP, 0, (uint16_t)lf->loop_index[block->loop], line);
+            lf->loop_exit[block->loop] = bytecode_current_position(lc->module);
+            if (!is_next_block(lf, position, block->succs[1])) {
+                emit_jump(lc, OP_JMP, block->succs[1], line);
+            }
+            break;
+        case IR_TERM_SWITCH: {
+            uint32_t index = emit_instr(lc, OP_SWITCH, 0, 0, line);
+            if (index == (uint32_t)-1) break;
+            if (lc->switch_count >= lc->switch_capacity) {
+                uint32_t capacity = lc->switch_capacity ? lc->switch_capacity * 2 : 8;
+                SwitchFixup* switches = (SwitchFixup*)mmgr_realloc(lc->switches,
+                                                                   sizeof(SwitchFixup) * capacity);
+                if (!switches) {
+                    lower_error(lc, ERR_OUT_OF_MEMORY, "Out of memory while lowering IR");
+                    break;
+                }
+                lc->switches = switches;
+                lc->switch_capacity = capacity;
+            }
+            lc->switches[lc->switch_count].instruction = index;
+            lc->switches[lc->switch_count].block = block;
+            lc->switch_count++;
+            break;
+        }
+        default:
+            lower_error(lc, ERR_RUNTIME, "Unterminated IR block");
+            break;
+    }
+}
+
+/**
+ * @brief 登记函数中（可达的）FOR 循环的描述符，body/exit 在块地址确定后填写
+ */
+static void add_for_loops(LowerCtx* lc, LowerFunc* lf) {
+    IrFunction* func = lf->func;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        const IrBlock* block = func->blocks[b];
+        if (block->term != IR_TERM_FOR_INIT) continue;
+        uint32_t index = lc->module->for_loop_count < UINT16_MAX
+            ? bytecode_add_for_loop(lc->module, &func->loops[block->loop].desc)
+            : (uint32_t)-1;
+        if (index == (uint32_t)-1) {
+            lower_error(lc, ERR_OUT_OF_MEMORY, "Cannot add FOR loop descriptor while lowering IR");
+            return;
+        }
+        lf->loop_index[block->loop] = index;
+        lf->loop_exit[block->loop] = -1;
+    }
+}
+
+/**
+ * @brief 块地址确定后填写循环描述符并登记跳转表
+ */
+static void resolve_block_targets(LowerCtx* lc, LowerFunc* lf) {
+    IrFunction* func = lf->func;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        const IrBlock* block = func->blocks[b];
+        if (block->term != IR_TERM_FOR_INIT) continue;
+        // 循环体不会回到 FOR_STEP（如以 RETURN 结束）时 FOR_STEP 已随不可达块删除
+        ForLoop* loop = &lc->module->for_loops[lf->loop_index[block->loop]];
+        loop->body = lf->address[block->succs[0]];
+        loop->exit = lf->loop_exit[block->loop] >= 0 ? (uint32_t)lf->loop_exit[block->loop]
+                                                     : lf->address[block->succs[1]];
+    }
+
+    for (uint32_t i = 0; i < lc->switch_count && lc->error == OK; i++) {
+        const IrBlock* block = lc->switches[i].block;
+        SwitchCase* cases = (SwitchCase*)mmgr_alloc(sizeof(SwitchCase) * block->case_count);
+        if (!cases) {
+            lower_error(lc, ERR_OUT_OF_MEMORY, "Out of memory while lowering IR");
+            return;
+        }
+        for (uint32_t c = 0; c < block->case_count; c++) {
+            cases[c] = block->cases[c];
+            cases[c].target = lf->address[block->cases[c].target];
+        }
+        uint32_t table = bytecode_add_switch_table(lc->module, block->switch_kind, cases,
+                                                   block->case_count, lf->address[block->succs[0]]);
+        mmgr_free(cases);
+        if (table == (uint32_t)-1 || table > UINT16_MAX) {
+            lower_error(lc, ERR_OUT_OF_MEMORY, "Failed to register jump table for CASE statement");
+            return;
+        }
+        bytecode_patch_operand(lc->module, lc->switches[i].instruction, (uint16_t)table);
+    }
+}
+
+static void lower_function(LowerCtx* lc, LowerFunc* lf) {
+    uint32_t address = bytecode_current_position(lc->module);
+    lc->fixup_count = 0;
+    lc->switch_count = 0;
+
+    add_for_loops(lc, lf);
+    for (uint32_t position = 0; position < lf->func->block_count && lc->error == OK; position++) {
+        lower_block(lc, lf, position);
+    }
+    if (lc->error != OK) return;
+
+    for (uint32_t i = 0; i < lc->fixup_count; i++) {
+        bytecode_patch_operand(lc->module, lc->fixups[i].instruction,
+                               (uint16_t)lf->address[lc->fixups[i].block]);
+    }
+    resolve_block_targets(lc, lf);
+    if (lc->error != OK) return;
+
+    if (lf->function_index >= 0) {
+        FunctionEntry* entry = &lc->module->functions[lf->function_index];
+        entry->address = address;
+        entry->local_count = lf->func->frame_size + lf->slot_count;
+    }
+}
+
+ErrorCode ir_lower(IrModule* ir, BytecodeModule* module, SymbolTable* symtbl,
+                   char* error_msg, size_t error_size) {
+    if (!ir || !module) return ERR_RUNTIME;
+
+    LowerCtx lc;
+    memset(&lc, 0, sizeof(lc));
+    lc.ir = ir;
+    lc.module = module;
+    lc.symtbl = symtbl;
+    lc.error = OK;
+    lc.error_msg = error_msg;
+    lc.error_size = error_size;
+
+    lc.funcs = (LowerFunc*)mmgr_calloc(sizeof(LowerFunc) * (ir->function_count + 1));
+    if (!lc.funcs) return ERR_OUT_OF_MEMORY;
+
+    IrFunction* main_func = NULL;
+    LowerFunc* main_lf = NULL;
+
+    // 1. 分析所有函数，登记函数表（地址在发射后回填）
+    for (uint32_t i = 0; i < ir->function_count && lc.error == OK; i++) {
+        IrFunction* func = ir->functions[i];
+        if (!func->in_ssa) {
+            ErrorCode err = ir_compute_cfg(func);
+            if (err != OK) { lower_error(&lc, err, "Cannot compute IR control flow graph"); break; }
+        }
+        ErrorCode err = analyze_function(&lc.funcs[i], func);
+        if (err != OK) { lower_error(&lc, err, "Out of memory while lowering IR"); break; }
+
+        if (func->is_main) {
+            main_func = func;
+            main_lf = &lc.funcs[i];
+            if (!main_lf->wrapped) continue;
+        }
+        uint32_t index = bytecode_add_function(module, func->name, 0, func->param_count, 0,
+                                               func->return_type, func->param_types);
+        if (index == (uint32_t)-1) {
+            lower_error(&lc, ERR_OUT_OF_MEMORY, "Cannot add function while lowering IR");
+            break;
+        }
+        lc.funcs[i].function_index = (int32_t)index;
+    }
+
+    // 2. 入口：跳到主程序体，或调用包装后的主程序
+    uint32_t entry_jump = (uint32_t)-1;
+    if (lc.error == OK) {
+        module->entry_point = 0;
+        if (main_lf && main_lf->wrapped) {
+            emit_instr(&lc, OP_CALL, 0, (uint16_t)main_lf->function_index, 0);
+            emit_instr(&lc, OP_HALT, 0, 0, 0);
+        } else {
+            entry_jump = emit_instr(&lc, OP_JMP, 0, 0, 0);
+        }
+    }
+
+    // 3. 函数体，主程序最后
+    for (uint32_t i = 0; i < ir->function_count && lc.error == OK; i++) {
+        if (ir->functions[i] == main_func) continue;
+        lower_function(&lc, &lc.funcs[i]);
+    }
+    if (lc.error == OK && main_lf) {
+        if (entry_jump != (uint32_t)-1) {
+            bytecode_patch_operand(module, entry_jump, (uint16_t)bytecode_current_position(module));
+        }
+        lower_function(&lc, main_lf);
+    } else if (lc.error == OK && entry_jump != (uint32_t)-1) {
+        bytecode_patch_operand(module, entry_jump, (uint16_t)bytecode_current_position(module));
+        emit_instr(&lc, OP_HALT, 0, 0, 0);
+    }
+
+    for (uint32_t i = 0; i < ir->function_count; i++) {
+        free_lower_func(&lc.funcs[i]);
+    }
+    mmgr_free(lc.funcs);
+    mmgr_free(lc.fixups);
+    mmgr_free(lc.switches);
+    return lc.error;
+}
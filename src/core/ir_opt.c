@@ -0,0 +1,834 @@
+/**
+ * @file ir_opt.c
+ * @brief 中间表示 - 公共子表达式消除与循环不变量外提
+ *
+ * 两个变换移动或合并没有副作用的指令：常量、参数入口值、一元/二元运算和
+ * 纯函数调用（由调用者的副作用分析判定）。内存读取另按存储位置处理：
+ * - CSE 只在同一块内合并读取（变量、数组元素、质量化变量成员），两次读取之间
+ *   不能有可能写到同一位置的写入；非纯函数调用和 I/O 访问使全局区的读取失效。
+ *   块内两次读取之间没有程序自身的写入时，强制、调试器写入落在两次读取之间
+ *   与落在第二次读取之后不可区分
+ * - 外提只针对帧内变量（循环中没有写入它的指令）：全局变量（含函数内静态变量）
+ *   在循环的迭代之间可能被强制、调试器、热更新或 I/O 扫描改写，被调函数在
+ *   自己的帧中执行，不会改写调用者的帧
+ *
+ * 可能报错的运算（整数溢出、除零、非法移位量、数组越界）与函数调用：
+ * - CSE 可以合并：支配它的等价指令已先执行且没有报错，重复执行的结果相同
+ * - 外提只在不改变报错时机时进行（见 ir_hoist_loop_invariants）
+ */
+
+#include "ir.h"
+#include "bytecode_io.h"
+#include "mmgr.h"
+#include <string.h>
+
+// ============================================================================
+// 公共工具
+// ============================================================================
+
+static IrReg resolve(const IrReg* repl, IrReg reg) {
+    while (reg >= 0 && repl[reg] >= 0) reg = repl[reg];
+    return reg;
+}
+
+/**
+ * @brief 指令是否只计算一个结果、没有副作用
+ */
+static bool is_pure(const IrInstr* ins, IrPureCallFn pure_call, void* data) {
+    if (ins->dest == IR_NO_REG) return false;
+    switch (ins->op) {
+        case IR_CONST:
+        case IR_PARAM:
+        case IR_COPY:
+        case IR_BINARY:
+        case IR_UNARY:
+            return true;
+        case IR_CALL:
+            return ins->callee && pure_call && pure_call(ins->callee, data);
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 指令执行时是否可能报告运行时错误
+ *
+ * 与虚拟机一致：ADD/SUB/MUL 检查整数溢出，DIV/MOD 检查除零，SHL/SHR 检查移位量；
+ * 比较、逻辑、按位运算和取负不报错，变量读取不报错。函数调用按可能报错处理。
+ */
+static bool can_trap(const IrInstr* ins) {
+    switch (ins->op) {
+        case IR_CONST:
+        case IR_PARAM:
+        case IR_COPY:
+        case IR_LOAD:
+            return false;
+        case IR_BINARY:
+            switch (ins->opcode) {
+                case OP_EQ: case OP_NE: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+                case OP_AND: case OP_OR: case OP_XOR:
+                case OP_BIT_AND: case OP_BIT_OR: case OP_BIT_XOR:
+                    return false;
+                default:
+                    return true;
+            }
+        case IR_UNARY:
+            return ins->opcode != OP_NEG && ins->opcode != OP_NOT && ins->opcode != OP_BIT_NOT;
+        default:
+            return true;
+    }
+}
+
+/**
+ * @brief 指令是否有副作用（写内存、I/O、调用）或读取时可能越界
+ */
+static bool has_effect(const IrInstr* ins) {
+    switch (ins->op) {
+        case IR_STORE:
+        case IR_STORE_INDEXED:
+        case IR_STORE_MEMBER:
+        case IR_LOAD_INDEXED:
+        case IR_IO_READ:
+        case IR_IO_WRITE:
+        case IR_CALL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 统计为一次优化的指令（常量和参数读取降级时本就按需重新生成，不计入）
+ */
+static bool counts_as_change(const IrInstr* ins) {
+    return ins->op != IR_CONST && ins->op != IR_PARAM;
+}
+
+/**
+ * @brief 把指令标记为删除（由 ir_compact 移除）
+ */
+static void mark_deleted(IrInstr* ins) {
+    ins->op = IR_COPY;
+    ins->dest = IR_NO_REG;
+}
+
+/**
+ * @brief 按逆后序列出可达块，返回可达块数
+ */
+static uint32_t blocks_in_rpo(const IrFunction* func, uint32_t* order) {
+    uint32_t count = 0;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        int32_t rpo = func->blocks[b]->rpo;
+        if (rpo < 0) continue;
+        order[rpo] = b;
+        count++;
+    }
+    return count;
+}
+
+// ============================================================================
+// 公共子表达式消除
+// ============================================================================
+
+/**
+ * @brief 值编号表的条目（按哈希分桶的链表）
+ */
+typedef struct {
+    const IrInstr* ins;
+    uint32_t block;
+    int32_t next;
+} CseEntry;
+
+/**
+ * @brief 二元运算是否满足交换律（字符串拼接除外）
+ */
+static bool is_commutative(const IrFunction* func, const IrInstr* ins) {
+    if (ins->op != IR_BINARY || ins->arg_count != 2) return false;
+    if (ins->args[0] >= 0 && func->reg_types[ins->args[0]] == TYPE_STRING) return false;
+    switch (ins->opcode) {
+        case OP_ADD: case OP_MUL:
+        case OP_EQ: case OP_NE:
+        case OP_AND: case OP_OR: case OP_XOR:
+        case OP_BIT_AND: case OP_BIT_OR: case OP_BIT_XOR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 常量能否参与值编号（只比较标量和字符串内容）
+ */
+static bool is_numbered_constant(const Value* v) {
+    switch (v->type) {
+        case TYPE_BOOL:
+        case TYPE_INT:
+        case TYPE_REAL:
+            return true;
+        case TYPE_STRING:
+            return v->string_val != NULL;
+        default:
+            return false;
+    }
+}
+
+static bool same_constant(const Value* a, const Value* b) {
+    if (a->type != b->type || a->quality != b->quality) return false;
+    switch (a->type) {
+        case TYPE_BOOL:   return a->bool_val == b->bool_val;
+        case TYPE_INT:    return a->int_val == b->int_val;
+        // 按位比较：0.0 与 -0.0 不同
+        case TYPE_REAL:   return memcmp(&a->real_val, &b->real_val, sizeof(double)) == 0;
+        case TYPE_STRING: return strcmp(a->string_val, b->string_val) == 0;
+        default:          return false;
+    }
+}
+
+#define CSE_MAX_LOADS   64      // 块内同时记录的读取数（超出时淘汰最早的）
+
+/**
+ * @brief 是否为参与块内 CSE 的内存读取（已提升的变量不再是内存访问）
+ */
+static bool is_memory_read(const IrInstr* ins) {
+    switch (ins->op) {
+        case IR_LOAD:
+            return ins->var.promoted < 0 && ins->dest >= 0;
+        case IR_LOAD_INDEXED:
+        case IR_LOAD_MEMBER:
+            return ins->dest >= 0;
+        default:
+            return false;
+    }
+}
+
+static bool same_read(const IrInstr* a, const IrInstr* b) {
+    if (a->op != b->op || a->opcode != b->opcode || a->type != b->type ||
+        a->var.is_global != b->var.is_global || a->var.address != b->var.address) {
+        return false;
+    }
+    if (a->op == IR_LOAD_INDEXED) {
+        return a->args[0] == b->args[0] && a->var.length == b->var.length && a->var.lower == b->var.lower;
+    }
+    return true;
+}
+
+/**
+ * @brief 删除被 ins 改写（或可能改写）的已记录读取
+ */
+static void kill_reads(const IrInstr** reads, uint32_t* count, const IrInstr* ins,
+                       IrPureCallFn pure_call, void* data) {
+    bool store = ir_is_store(ins);
+    bool globals = (ins->op == IR_CALL && !is_pure(ins, pure_call, data)) ||
+                   ins->op == IR_IO_READ || ins->op == IR_IO_WRITE;
+    if (!store && !globals) return;
+
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < *count; i++) {
+        const IrInstr* read = reads[i];
+        bool killed = store ? ir_may_alias(read, ins) : read->var.is_global;
+        if (!killed) reads[kept++] = read;
+    }
+    *count = kept;
+}
+
+static uint32_t hash_instr(const IrFunction* func, const IrInstr* ins) {
+    uint32_t h = ((uint32_t)ins->op * 31u + (uint32_t)ins->opcode) * 31u + (uint32_t)ins->type;
+    switch (ins->op) {
+        case IR_CONST:
+            switch (ins->constant.type) {
+                case TYPE_BOOL: h = h * 31u + (uint32_t)ins->constant.bool_val; break;
+                case TYPE_INT:  h = h * 31u + (uint32_t)ins->constant.int_val; break;
+                case TYPE_REAL: {
+                    uint64_t bits;
+                    memcpy(&bits, &ins->constant.real_val, sizeof(bits));
+                    h = h * 31u + (uint32_t)(bits ^ (bits >> 32));
+                    break;
+                }
+                default:
+                    h = h * 31u + bytecode_symbol_hash(ins->constant.string_val);
+                    break;
+            }
+            break;
+        case IR_PARAM:
+            h = h * 31u + (uint32_t)ins->index;
+            break;
+        case IR_CALL:
+            h = h * 31u + bytecode_symbol_hash(ins->callee);
+            break;
+        default:
+            break;
+    }
+
+    if (is_commutative(func, ins)) {
+        // 操作数顺序无关
+        return h * 31u + (uint32_t)ins->args[0] + (uint32_t)ins->args[1];
+    }
+    for (uint32_t a = 0; a < ins->arg_count; a++) {
+        h = h * 31u + (uint32_t)ins->args[a];
+    }
+    return h;
+}
+
+static bool same_instr(const IrFunction* func, const IrInstr* a, const IrInstr* b) {
+    if (a->op != b->op || a->opcode != b->opcode || a->type != b->type ||
+        a->arg_count != b->arg_count) {
+        return false;
+    }
+    switch (a->op) {
+        case IR_CONST:
+            if (!same_constant(&a->constant, &b->constant)) return false;
+            break;
+        case IR_PARAM:
+            if (a->index != b->index) return false;
+            break;
+        case IR_CALL:
+            if (strcmp(a->callee, b->callee) != 0) return false;
+            break;
+        default:
+            break;
+    }
+
+    bool same_order = true;
+    for (uint32_t i = 0; i < a->arg_count; i++) {
+        if (a->args[i] != b->args[i]) { same_order = false; break; }
+    }
+    if (same_order) return true;
+    return is_commutative(func, a) &&
+           a->args[0] == b->args[1] && a->args[1] == b->args[0];
+}
+
+ErrorCode ir_eliminate_common_subexprs(IrFunction* func, IrPureCallFn pure_call, void* data,
+                                       uint32_t* changes) {
+    if (changes) *changes = 0;
+    if (!func) return ERR_RUNTIME;
+    if (!func->in_ssa) return OK;
+
+    uint32_t instr_count = 0;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        instr_count += func->blocks[b]->instr_count;
+    }
+    if (instr_count == 0) return OK;
+
+    uint32_t bucket_count = 16;
+    while (bucket_count < instr_count * 2) bucket_count *= 2;
+
+    int32_t* buckets = (int32_t*)mmgr_alloc(sizeof(int32_t) * bucket_count);
+    CseEntry* entries = (CseEntry*)mmgr_alloc(sizeof(CseEntry) * instr_count);
+    IrReg* repl = (IrReg*)mmgr_alloc(sizeof(IrReg) * (func->reg_count + 1));
+    uint32_t* order = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * func->block_count);
+    if (!buckets || !entries || !repl || !order) {
+        mmgr_free(buckets);
+        mmgr_free(entries);
+        mmgr_free(repl);
+        mmgr_free(order);
+        return ERR_OUT_OF_MEMORY;
+    }
+    for (uint32_t i = 0; i < bucket_count; i++) buckets[i] = -1;
+    for (uint32_t r = 0; r <= func->reg_count; r++) repl[r] = IR_NO_REG;
+
+    // 逆后序保证支配者先于被支配块处理；查到的等价指令还须支配当前块
+    uint32_t entry_count = 0;
+    uint32_t removed = 0;
+    uint32_t reachable = blocks_in_rpo(func, order);
+    const IrInstr* reads[CSE_MAX_LOADS];
+    for (uint32_t k = 0; k < reachable; k++) {
+        uint32_t b = order[k];
+        IrBlock* block = func->blocks[b];
+        uint32_t read_count = 0;
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            IrInstr* ins = &block->instrs[i];
+            for (uint32_t a = 0; a < ins->arg_count; a++) {
+                ins->args[a] = resolve(repl, ins->args[a]);
+            }
+
+            // 块内的内存读取：之后没有可能改写同一位置的指令时复用
+            if (is_memory_read(ins)) {
+                const IrInstr* found = NULL;
+                for (uint32_t r = 0; r < read_count && !found; r++) {
+                    if (same_read(reads[r], ins)) found = reads[r];
+                }
+                if (found) {
+                    repl[ins->dest] = found->dest;
+                    removed++;
+                    mark_deleted(ins);
+                    continue;
+                }
+                if (read_count == CSE_MAX_LOADS) {
+                    memmove(&reads[0], &reads[1], sizeof(reads[0]) * (CSE_MAX_LOADS - 1));
+                    read_count--;
+                }
+                reads[read_count++] = ins;
+                continue;
+            }
+            kill_reads(reads, &read_count, ins, pure_call, data);
+
+            if (ins->op == IR_PHI || ins->op == IR_COPY || !is_pure(ins, pure_call, data)) continue;
+            if (ins->op == IR_CONST && !is_numbered_constant(&ins->constant)) continue;
+
+            uint32_t bucket = hash_instr(func, ins) & (bucket_count - 1);
+            const IrInstr* found = NULL;
+            for (int32_t e = buckets[bucket]; e >= 0; e = entries[e].next) {
+                if (same_instr(func, entries[e].ins, ins) && ir_dominates(func, entries[e].block, b)) {
+                    found = entries[e].ins;
+                    break;
+                }
+            }
+            if (found) {
+                repl[ins->dest] = found->dest;
+                if (counts_as_change(ins)) removed++;
+                mark_deleted(ins);
+                continue;
+            }
+            entries[entry_count].ins = ins;
+            entries[entry_count].block = b;
+            entries[entry_count].next = buckets[bucket];
+            buckets[bucket] = (int32_t)entry_count++;
+        }
+    }
+
+    // PHI 的回边操作数和终结符在遍历时可能尚未替换
+    ir_replace_regs(func, repl);
+    ir_compact(func);
+
+    mmgr_free(buckets);
+    mmgr_free(entries);
+    mmgr_free(repl);
+    mmgr_free(order);
+    if (changes) *changes = removed;
+    return OK;
+}
+
+// ============================================================================
+// 循环不变量外提
+// ============================================================================
+
+/**
+ * @brief 外提的工作状态
+ */
+typedef struct {
+    IrFunction* func;
+    IrPureCallFn pure_call;
+    void* data;
+    uint32_t* order;            // 可达块的逆后序
+    uint32_t reachable;
+    bool* in_loop;              // 当前循环包含的块
+    uint32_t* work;
+    uint32_t* exits;            // 当前循环中有后继在循环外的块
+    uint32_t exit_count;
+    uint32_t block_capacity;    // 以上按块分配的数组的容量
+    int32_t* def_block;         // 寄存器的定义块（外提后更新）
+    uint32_t reg_capacity;
+    int32_t* moved;             // 试探时临时改动了定义块的寄存器及其原定义块（成对）
+    uint32_t hoisted;
+} LicmState;
+
+/**
+ * @brief 求以 header 为头的自然循环（沿回边源块反向遍历到循环头）
+ * @return 是循环头且循环只能从循环头进入时返回 true
+ */
+static bool collect_loop(LicmState* st, uint32_t header) {
+    IrFunction* func = st->func;
+    const IrBlock* h = func->blocks[header];
+    memset(st->in_loop, 0, sizeof(bool) * func->block_count);
+    st->in_loop[header] = true;
+
+    uint32_t pending = 0;
+    bool has_latch = false;
+    for (uint32_t p = 0; p < h->pred_count; p++) {
+        uint32_t pred = h->preds[p];
+        if (func->blocks[pred]->rpo < 0 || !ir_dominates(func, header, pred)) continue;
+        has_latch = true;
+        if (!st->in_loop[pred]) {
+            st->in_loop[pred] = true;
+            st->work[pending++] = pred;
+        }
+    }
+    if (!has_latch) return false;
+
+    while (pending > 0) {
+        const IrBlock* block = func->blocks[st->work[--pending]];
+        for (uint32_t p = 0; p < block->pred_count; p++) {
+            uint32_t pred = block->preds[p];
+            if (st->in_loop[pred] || func->blocks[pred]->rpo < 0) continue;
+            // 从循环头以外进入循环体（不可归约的控制流）
+            if (!ir_dominates(func, header, pred)) return false;
+            st->in_loop[pred] = true;
+            st->work[pending++] = pred;
+        }
+    }
+
+    // 出口块：有后继在循环外（含以 RETURN 离开循环的路径）
+    st->exit_count = 0;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        if (!st->in_loop[b]) continue;
+        const IrBlock* block = func->blocks[b];
+        for (uint32_t s = 0; s < block->succ_count; s++) {
+            if (!st->in_loop[block->succs[s]]) {
+                st->exits[st->exit_count++] = b;
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief 循环的前置块：循环外唯一的前驱，且只跳转到循环头，
+ *        或以 FOR_INIT 进入以循环头为循环体的 FOR 循环
+ * @return 块编号，没有时返回 -1
+ */
+static int32_t find_preheader(const LicmState* st, uint32_t header) {
+    const IrBlock* h = st->func->blocks[header];
+    int32_t preheader = -1;
+    for (uint32_t p = 0; p < h->pred_count; p++) {
+        uint32_t pred = h->preds[p];
+        if (st->in_loop[pred]) continue;
+        if (preheader >= 0 && (uint32_t)preheader != pred) return -1;
+        preheader = (int32_t)pred;
+    }
+    if (preheader < 0) return -1;
+    const IrBlock* block = st->func->blocks[preheader];
+    if (block->term == IR_TERM_JMP && block->succ_count == 1) return preheader;
+    if (block->term == IR_TERM_FOR_INIT && block->succs[0] == header) return preheader;
+    return -1;
+}
+
+static bool is_invariant(const LicmState* st, const IrInstr* ins) {
+    for (uint32_t a = 0; a < ins->arg_count; a++) {
+        IrReg r = ins->args[a];
+        if (r < 0) continue;
+        int32_t def = st->def_block[r];
+        if (def >= 0 && st->in_loop[def]) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 循环中是否可能写入帧内变量 load 读取的位置（含 FOR 循环变量的初始化和步进）
+ */
+static bool loop_writes(const LicmState* st, const IrInstr* load) {
+    const IrFunction* func = st->func;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        if (!st->in_loop[b]) continue;
+        const IrBlock* block = func->blocks[b];
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            const IrInstr* ins = &block->instrs[i];
+            if (ir_is_store(ins) && !IR_IS_DELETED(ins) && ir_may_alias(ins, load)) return true;
+        }
+        if (block->term == IR_TERM_FOR_INIT || block->term == IR_TERM_FOR_STEP) {
+            const IrVarRef* var = &func->loops[block->loop].var;
+            if (!var->is_global && var->address == load->var.address) return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 读取帧内变量能否外提：循环中没有写入它的指令
+ */
+static bool is_invariant_read(const LicmState* st, const IrInstr* ins) {
+    return ins->op == IR_LOAD && ins->dest >= 0 && !ins->var.is_global &&
+           ins->var.promoted < 0 && !loop_writes(st, ins);
+}
+
+/**
+ * @brief 块 b 是否支配当前循环的所有出口块（进入循环后第一次迭代一定执行它）
+ */
+static bool dominates_exits(const LicmState* st, uint32_t b) {
+    for (uint32_t e = 0; e < st->exit_count; e++) {
+        if (!ir_dominates(st->func, b, st->exits[e])) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 块 b 是否为（内层）循环头：内层循环可能不终止，其后的指令不一定执行
+ */
+static bool is_loop_header(const IrFunction* func, uint32_t b) {
+    const IrBlock* block = func->blocks[b];
+    for (uint32_t p = 0; p < block->pred_count; p++) {
+        if (ir_dominates(func, b, block->preds[p])) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 外提一个循环中的不变量到前置块末尾
+ *
+ * 按逆后序遍历循环体，操作数都在循环外定义（或已外提）的纯指令和循环中
+ * 没有写入的帧内变量读取即为不变量。可能报错的不变量（allow_trap 时）只从
+ * 支配所有出口块的块中外提，且循环中在它之前的指令都已外提或既无副作用也
+ * 不会报错、之前没有内层循环：进入循环后第一次迭代一定先执行到它，错误仍在
+ * 同一位置之前报告。
+ *
+ * @param apply 为 false 时只试探：不移动指令，发现可外提的可能报错的指令时
+ *              置 *wants_trap 并返回
+ */
+static ErrorCode scan_loop(LicmState* st, uint32_t header, uint32_t preheader,
+                           bool allow_trap, bool apply, bool* wants_trap) {
+    IrFunction* func = st->func;
+    bool barrier = false;       // 循环中已有未外提的副作用、可能报错的指令或内层循环
+    uint32_t moved = 0;
+
+    for (uint32_t k = (uint32_t)func->blocks[header]->rpo; k < st->reachable; k++) {
+        uint32_t b = st->order[k];
+        if (!st->in_loop[b]) continue;
+        if (b != header && is_loop_header(func, b)) barrier = true;
+        bool first_iteration = allow_trap && dominates_exits(st, b);
+
+        IrBlock* block = func->blocks[b];
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            IrInstr* ins = &block->instrs[i];
+            if (IR_IS_DELETED(ins) || ins->op == IR_PHI) continue;
+
+            bool trap = can_trap(ins);
+            bool hoist = (is_pure(ins, st->pure_call, st->data) || is_invariant_read(st, ins)) &&
+                         is_invariant(st, ins);
+            if (hoist && trap) hoist = first_iteration && !barrier;
+            if (!hoist) {
+                if (trap || has_effect(ins)) barrier = true;
+                continue;
+            }
+
+            if (!apply) {
+                if (trap) {
+                    *wants_trap = true;
+                    goto restore;
+                }
+                st->moved[moved++] = ins->dest;
+                st->moved[moved++] = (int32_t)b;
+                st->def_block[ins->dest] = (int32_t)preheader;
+                continue;
+            }
+
+            // 前置块不在循环内，追加指令不会移动 ins 所在的块
+            IrInstr* copy = ir_append(func, func->blocks[preheader], IR_COPY, TYPE_VOID, NULL, 0, ins->line);
+            if (!copy) return ERR_OUT_OF_MEMORY;
+            *copy = *ins;
+            st->def_block[copy->dest] = (int32_t)preheader;
+            if (counts_as_change(copy)) st->hoisted++;
+
+            ins->args = NULL;
+            ins->arg_count = 0;
+            mark_deleted(ins);
+        }
+    }
+
+restore:
+    for (uint32_t m = 0; m < moved; m += 2) {
+        st->def_block[st->moved[m]] = st->moved[m + 1];
+    }
+    return OK;
+}
+
+/**
+ * @brief 以 FOR_INIT 进入的循环是否执行循环体
+ * @return 1 一定执行，0 一定不执行，-1 运行时才知道
+ */
+static int for_loop_entered(const IrFunction* func, const IrBlock* preheader) {
+    const ForLoop* loop = &func->loops[preheader->loop].desc;
+    if (!(loop->flags & FOR_LOOP_CONST_START) || (loop->flags & FOR_LOOP_END_VAR)) return -1;
+    bool entered = loop->step > 0 ? loop->start <= loop->end : loop->start >= loop->end;
+    return entered ? 1 : 0;
+}
+
+/**
+ * @brief 按先前的前驱表重排 block 中 PHI 的操作数（from 的新后继 to 沿用 from 的操作数）
+ */
+static ErrorCode remap_phi_args(IrBlock* block, const uint32_t* old_preds, uint32_t old_count,
+                                uint32_t from, uint32_t to) {
+    for (uint32_t i = 0; i < block->instr_count && block->instrs[i].op == IR_PHI; i++) {
+        IrInstr* phi = &block->instrs[i];
+        IrReg* args = (IrReg*)mmgr_alloc(sizeof(IrReg) * (block->pred_count + 1));
+        if (!args) return ERR_OUT_OF_MEMORY;
+        for (uint32_t p = 0; p < block->pred_count; p++) {
+            uint32_t pred = block->preds[p] == to ? from : block->preds[p];
+            args[p] = IR_NO_REG;
+            for (uint32_t q = 0; q < old_count; q++) {
+                if (old_preds[q] == pred) {
+                    args[p] = phi->args[q];
+                    break;
+                }
+            }
+        }
+        mmgr_free(phi->args);
+        phi->args = args;
+        phi->arg_count = block->pred_count;
+    }
+    return OK;
+}
+
+/**
+ * @brief 按当前块数和寄存器数扩充工作数组，重新求逆后序
+ */
+static ErrorCode refresh_state(LicmState* st) {
+    IrFunction* func = st->func;
+    if (func->block_count > st->block_capacity) {
+        uint32_t capacity = func->block_count * 2;
+        uint32_t* order = (uint32_t*)mmgr_realloc(st->order, sizeof(uint32_t) * capacity);
+        if (order) st->order = order;
+        bool* in_loop = (bool*)mmgr_realloc(st->in_loop, sizeof(bool) * capacity);
+        if (in_loop) st->in_loop = in_loop;
+        uint32_t* work = (uint32_t*)mmgr_realloc(st->work, sizeof(uint32_t) * capacity);
+        if (work) st->work = work;
+        uint32_t* exits = (uint32_t*)mmgr_realloc(st->exits, sizeof(uint32_t) * capacity);
+        if (exits) st->exits = exits;
+        if (!order || !in_loop || !work || !exits) return ERR_OUT_OF_MEMORY;
+        st->block_capacity = capacity;
+    }
+    if (func->reg_count + 1 > st->reg_capacity) {
+        uint32_t capacity = (func->reg_count + 1) * 2;
+        int32_t* def_block = (int32_t*)mmgr_realloc(st->def_block, sizeof(int32_t) * capacity);
+        if (def_block) st->def_block = def_block;
+        int32_t* moved = (int32_t*)mmgr_realloc(st->moved, sizeof(int32_t) * 2 * capacity);
+        if (moved) st->moved = moved;
+        if (!def_block || !moved) return ERR_OUT_OF_MEMORY;
+        st->reg_capacity = capacity;
+    }
+    st->reachable = blocks_in_rpo(func, st->order);
+    return OK;
+}
+
+/**
+ * @brief 为以 FOR_INIT 进入的循环加入口判断，返回新的前置块
+ *
+ * 前置块 P 原以 FOR_INIT 结束（进入跳循环体 B，否则跳出口 E）。新建块 G 承接
+ * FOR_INIT，P 改为按 FOR_INIT 相同的比较（初值与当前终值）跳到 G 或 E。
+ * G 只在循环体至少执行一次时到达，外提到 G 的指令在第一次迭代中本就会执行。
+ */
+static ErrorCode add_entry_guard(LicmState* st, uint32_t header, uint32_t preheader,
+                                 uint32_t* guarded) {
+    IrFunction* func = st->func;
+    IrBlock* pre = func->blocks[preheader];
+    const IrLoop* loop = &func->loops[pre->loop];
+    uint32_t body = pre->succs[0];
+    uint32_t exit = pre->succs[1];
+    IrReg start = pre->term_value;
+    int line = pre->term_line;
+
+    IrBlock* guard = ir_block_create(func);
+    if (!guard) return ERR_OUT_OF_MEMORY;
+
+    IrInstr* ins;
+    if (loop->desc.flags & FOR_LOOP_END_VAR) {
+        ins = ir_append(func, pre, IR_LOAD, TYPE_INT, NULL, 0, line);
+        if (!ins) return ERR_OUT_OF_MEMORY;
+        ins->var = loop->end_var;
+    } else {
+        ins = ir_append(func, pre, IR_CONST, TYPE_INT, NULL, 0, line);
+        if (!ins) return ERR_OUT_OF_MEMORY;
+        ins->constant.type = TYPE_INT;
+        ins->constant.int_val = loop->desc.end;
+    }
+    IrReg args[2] = {start, ins->dest};
+    ins = ir_append(func, pre, IR_BINARY, TYPE_BOOL, args, 2, line);
+    if (!ins) return ERR_OUT_OF_MEMORY;
+    ins->opcode = loop->desc.step > 0 ? OP_LE : OP_GE;
+    IrReg cond = ins->dest;
+
+    guard->loop = pre->loop;
+    pre->term = IR_TERM_NONE;
+    ir_terminate(pre, IR_TERM_BR, cond, guard->id, exit, line);
+    ir_terminate(guard, IR_TERM_FOR_INIT, start, body, exit, line);
+
+    // 前驱表按块编号重建：循环体的前驱 P 换成 G，出口多一个前驱 G（操作数同 P）
+    IrBlock* targets[2] = {func->blocks[body], func->blocks[exit]};
+    uint32_t* old_preds[2] = {NULL, NULL};
+    uint32_t old_counts[2];
+    ErrorCode err = OK;
+    for (int t = 0; t < 2 && err == OK; t++) {
+        old_counts[t] = targets[t]->pred_count;
+        old_preds[t] = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * (old_counts[t] + 1));
+        if (!old_preds[t]) err = ERR_OUT_OF_MEMORY;
+        else memcpy(old_preds[t], targets[t]->preds, sizeof(uint32_t) * old_counts[t]);
+    }
+    if (err == OK) err = ir_compute_cfg(func);
+    if (err == OK) err = remap_phi_args(targets[0], old_preds[0], old_counts[0], preheader, guard->id);
+    if (err == OK) err = remap_phi_args(targets[1], old_preds[1], old_counts[1], preheader, guard->id);
+    mmgr_free(old_preds[0]);
+    mmgr_free(old_preds[1]);
+    if (err != OK) return err;
+
+    err = refresh_state(st);
+    if (err != OK) return err;
+    st->def_block[args[1]] = (int32_t)preheader;
+    st->def_block[cond] = (int32_t)preheader;
+    collect_loop(st, header);
+    *guarded = guard->id;
+    return OK;
+}
+
+/**
+ * @brief 外提一个循环的不变量
+ *
+ * 以 FOR_INIT 进入的循环可能一次也不执行：初值和终值都是常量时按编译期结果
+ * 决定能否外提可能报错的指令，否则在确有这样的指令可外提时先加入口判断。
+ */
+static ErrorCode hoist_loop(LicmState* st, uint32_t header, uint32_t preheader) {
+    const IrBlock* pre = st->func->blocks[preheader];
+    bool allow_trap = true;
+    if (pre->term == IR_TERM_FOR_INIT) {
+        int entered = for_loop_entered(st->func, pre);
+        if (entered == 0) {
+            allow_trap = false;
+        } else if (entered < 0) {
+            bool wants_trap = false;
+            ErrorCode err = scan_loop(st, header, preheader, true, false, &wants_trap);
+            if (err != OK) return err;
+            allow_trap = wants_trap;
+            if (wants_trap) {
+                err = add_entry_guard(st, header, preheader, &preheader);
+                if (err != OK) return err;
+            }
+        }
+    }
+    return scan_loop(st, header, preheader, allow_trap, true, NULL);
+}
+
+ErrorCode ir_hoist_loop_invariants(IrFunction* func, IrPureCallFn pure_call, void* data,
+                                   uint32_t* changes) {
+    if (changes) *changes = 0;
+    if (!func) return ERR_RUNTIME;
+    if (!func->in_ssa || func->block_count < 2) return OK;
+
+    LicmState st;
+    memset(&st, 0, sizeof(st));
+    st.func = func;
+    st.pure_call = pure_call;
+    st.data = data;
+    uint32_t* headers = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * func->block_count);
+    ErrorCode err = headers ? refresh_state(&st) : ERR_OUT_OF_MEMORY;
+    if (err != OK) goto done;
+
+    for (uint32_t r = 0; r <= func->reg_count; r++) st.def_block[r] = -1;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        const IrBlock* block = func->blocks[b];
+        for (uint32_t i = 0; i < block->instr_count; i++) {
+            if (block->instrs[i].dest >= 0) st.def_block[block->instrs[i].dest] = (int32_t)b;
+        }
+    }
+
+    // 循环头按逆后序从后往前处理：内层循环先外提到自己的前置块（位于外层循环体内），
+    // 再随外层循环继续外提。加入口判断会新建块、改变逆后序，因此先记下循环头的次序
+    uint32_t header_count = st.reachable;
+    for (uint32_t k = 0; k < header_count; k++) headers[k] = st.order[header_count - 1 - k];
+    for (uint32_t k = 0; k < header_count && err == OK; k++) {
+        uint32_t header = headers[k];
+        if (!collect_loop(&st, header)) continue;
+        int32_t preheader = find_preheader(&st, header);
+        if (preheader < 0) continue;
+        err = hoist_loop(&st, header, (uint32_t)preheader);
+    }
+    ir_compact(func);
+
+done:
+    if (changes) *changes = st.hoisted;
+    mmgr_free(headers);
+    mmgr_free(st.order);
+    mmgr_free(st.in_loop);
+    mmgr_free(st.work);
+    mmgr_free(st.exits);
+    mmgr_free(st.def_block);
+    mmgr_free(st.moved);
+    return err;
+}
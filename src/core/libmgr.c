@@ -7,14 +7,24 @@
  * 2. 符号导入和解析
  * 3. 库依赖管理
  * 4. 符号冲突检测
+ * 5. 进程级共享库缓存
+ * 6. 延迟加载与库函数调用解析缓存
  */
 
+#define _XOPEN_SOURCE 700   // realpath
+
 #include "libmgr.h"
 #include "bytecode_io.h"
+#include "crc32.h"
 #include "mmgr.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+// 前向声明
+static void library_cache_release(CachedLibrary* entry);
 
 /**
  * @brief 创建库管理器
@@ -53,10 +63,8 @@ static void free_loaded_library(LoadedLibrary* lib) {
     
     if (lib->name) mmgr_free(lib->name);
     if (lib->path) mmgr_free(lib->path);
-    // 重要：先释放符号表，因为它可能引用module中的字符串
-    if (lib->symbols) symtbl_free(lib->symbols);
-    // 然后再释放模块
-    if (lib->module) bytecode_module_free(lib->module);
+    // 模块与符号表归缓存所有，这里只释放引用
+    library_cache_release(lib->cache_entry);
     
     mmgr_free(lib);
 }
@@ -73,6 +81,37 @@ static void free_imported_symbol(ImportedSymbol* sym) {
     mmgr_free(sym);
 }
 
+/**
+ * @brief 释放延迟依赖记录
+ */
+static void free_pending_library(PendingLibrary* pending) {
+    if (!pending) return;
+    
+    if (pending->name) mmgr_free(pending->name);
+    if (pending->filename) mmgr_free(pending->filename);
+    
+    mmgr_free(pending);
+}
+
+/**
+ * @brief 清除调用解析缓存（lib 为 NULL 时清除全部，否则只清除属于该库的条目）
+ */
+static void clear_call_cache(LibraryManager* mgr, const LoadedLibrary* lib) {
+    for (int i = 0; i < LIBMGR_CALL_BUCKETS; i++) {
+        ResolvedCall** link = &mgr->call_cache[i];
+        while (*link) {
+            ResolvedCall* call = *link;
+            if (!lib || call->library == lib) {
+                *link = call->next;
+                mmgr_free(call->name);
+                mmgr_free(call);
+            } else {
+                link = &call->next;
+            }
+        }
+    }
+}
+
 /**
  * @brief 释放库管理器
  */
@@ -95,6 +134,15 @@ void libmgr_free(LibraryManager* mgr) {
         sym = next;
     }
     
+    // 释放延迟依赖与调用解析缓存
+    PendingLibrary* pending = mgr->pending;
+    while (pending) {
+        PendingLibrary* next = pending->next;
+        free_pending_library(pending);
+        pending = next;
+    }
+    clear_call_cache(mgr, NULL);
+    
     mmgr_free(mgr);
 }
 
@@ -143,47 +191,217 @@ static char* find_library_file(LibraryManager* mgr, const char* filename) {
     return NULL;
 }
 
+/**
+ * @brief 将库函数登记为符号
+ */
+static Symbol* define_function_symbol(SymbolTable* symtbl, const FunctionEntry* func) {
+    // 创建函数类型信息
+    TypeInfo* return_type = type_info_create(func->return_type);
+    
+    // 使用FunctionEntry中的参数类型信息
+    TypeInfo** param_types = NULL;
+    if (func->param_count > 0) {
+        param_types = (TypeInfo**)mmgr_alloc(sizeof(TypeInfo*) * func->param_count);
+        for (int32_t j = 0; j < func->param_count; j++) {
+            // 如果有参数类型信息就使用，否则默认为int
+            DataType param_type = (func->param_types && func->param_types[j] != TYPE_VOID) 
+                                   ? func->param_types[j] : TYPE_INT;
+            param_types[j] = type_info_create(param_type);
+        }
+    }
+    
+    // 注册函数符号
+    Symbol* sym = symtbl_define_function(symtbl, func->name, return_type, param_types, func->param_count);
+    
+    // 释放参数类型
+    if (param_types) {
+        for (int32_t j = 0; j < func->param_count; j++) {
+            type_info_free(param_types[j]);
+        }
+        mmgr_free(param_types);
+    }
+    type_info_free(return_type);
+    
+    return sym;
+}
+
 /**
  * @brief 从库模块构建符号表
+ * 
+ * 带导出符号索引的库返回空表，符号由 lookup_library_symbol 按需登记。
  */
 static SymbolTable* build_symbol_table_from_module(BytecodeModule* module) {
     SymbolTable* symtbl = symtbl_init();
-    if (!symtbl) return NULL;
+    if (!symtbl || module->symbol_index) return symtbl;
     
     // 导出所有函数
     for (uint32_t i = 0; i < module->function_count; i++) {
         FunctionEntry* func = &module->functions[i];
         if (!func->name) continue;
-        
-        // 创建函数类型信息
-        TypeInfo* return_type = type_info_create(func->return_type);
-        
-        // 使用FunctionEntry中的参数类型信息
-        TypeInfo** param_types = NULL;
-        if (func->param_count > 0) {
-            param_types = (TypeInfo**)mmgr_alloc(sizeof(TypeInfo*) * func->param_count);
-            for (int32_t j = 0; j < func->param_count; j++) {
-                // 如果有参数类型信息就使用，否则默认为int
-                DataType param_type = (func->param_types && func->param_types[j] != TYPE_VOID) 
-                                       ? func->param_types[j] : TYPE_INT;
-                param_types[j] = type_info_create(param_type);
-            }
+        define_function_symbol(symtbl, func);
+    }
+    
+    return symtbl;
+}
+
+// ============================================================================
+// 进程级库缓存
+// ============================================================================
+
+static CachedLibrary* g_library_cache = NULL;
+static pthread_mutex_t g_library_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_library_cache_hits = 0;
+static uint64_t g_library_cache_misses = 0;
+
+/**
+ * @brief 计算已加载库的内容摘要
+ * 
+ * 文件头只记录代码 CRC 与常量、函数个数，常量值或描述符变化时不变，不能作为缓存键。
+ * 3.x 映像对文件头、段表头和段表（含每段内容的 CRC，加载时已逐段校验）求 CRC32，
+ * 覆盖全部段内容；摘要与被共享的模块来自同一份映像，加载之后文件再被改写也不会错配。
+ * 没有映像的旧版本文件按模块内容计算（bytecode_compute_digest）。
+ */
+static uint32_t library_digest(const BytecodeModule* module) {
+    const uint8_t* base = (const uint8_t*)module->image;
+    if (base && module->image_size >= sizeof(STBCHeader) + sizeof(STBCLayout)) {
+        STBCHeader header;
+        STBCLayout layout;
+        memcpy(&header, base, sizeof(header));
+        memcpy(&layout, base + sizeof(header), sizeof(layout));
+        size_t table_size = sizeof(STBCSection) * layout.section_count;
+        if (header.version_major == STBC_VERSION_MAJOR && layout.section_count <= STBC_MAX_SECTIONS &&
+            sizeof(header) + sizeof(layout) + table_size <= module->image_size) {
+            uint32_t crc = crc32_update(0, &header, sizeof(header));
+            crc = crc32_update(crc, &layout, sizeof(layout));
+            return crc32_update(crc, base + sizeof(header) + sizeof(layout), table_size);
         }
-        
-        // 注册函数符号
-        symtbl_define_function(symtbl, func->name, return_type, param_types, func->param_count);
-        
-        // 释放参数类型
-        if (param_types) {
-            for (int32_t j = 0; j < func->param_count; j++) {
-                type_info_free(param_types[j]);
-            }
-            mmgr_free(param_types);
+    }
+    return bytecode_compute_digest(module);
+}
+
+/**
+ * @brief 获取缓存条目（命中则增加引用，未命中则把加载的模块加入缓存）
+ * 
+ * 整个加载查找过程持锁，同一个库并发加载时只会加入一次。先加载再按映像求摘要，
+ * 命中时丢弃刚加载的模块（只读映射，代价是一次 mmap 和段校验）。
+ */
+static CachedLibrary* library_cache_acquire(const char* path, ErrorCode* err) {
+    char canonical[PATH_MAX];
+    if (!realpath(path, canonical)) {
+        *err = ERR_FILE_IO;
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&g_library_cache_mutex);
+    
+    BytecodeModule* module = bytecode_load(canonical);
+    if (!module) {
+        pthread_mutex_unlock(&g_library_cache_mutex);
+        *err = ERR_FILE_IO;
+        return NULL;
+    }
+    uint32_t digest = library_digest(module);
+    
+    // 路径与内容摘要都相同才视为同一个库（文件被重新编译后会加载新版本）
+    CachedLibrary* entry = g_library_cache;
+    while (entry) {
+        if (entry->digest == digest && strcmp(entry->path, canonical) == 0) {
+            entry->ref_count++;
+            g_library_cache_hits++;
+            pthread_mutex_unlock(&g_library_cache_mutex);
+            bytecode_module_free(module);
+            *err = OK;
+            return entry;
         }
-        type_info_free(return_type);
+        entry = entry->next;
     }
     
-    return symtbl;
+    SymbolTable* symbols = build_symbol_table_from_module(module);
+    entry = symbols ? (CachedLibrary*)mmgr_calloc(sizeof(CachedLibrary)) : NULL;
+    if (entry) {
+        entry->path = mmgr_strdup(canonical);
+    }
+    if (!entry || !entry->path) {
+        if (entry) mmgr_free(entry);
+        if (symbols) symtbl_free(symbols);
+        bytecode_module_free(module);
+        pthread_mutex_unlock(&g_library_cache_mutex);
+        *err = ERR_OUT_OF_MEMORY;
+        return NULL;
+    }
+    
+    entry->digest = digest;
+    entry->module = module;
+    entry->symbols = symbols;
+    entry->ref_count = 1;
+    entry->next = g_library_cache;
+    g_library_cache = entry;
+    g_library_cache_misses++;
+    
+    pthread_mutex_unlock(&g_library_cache_mutex);
+    *err = OK;
+    return entry;
+}
+
+/**
+ * @brief 释放缓存条目的一个引用，归零时移出缓存并释放
+ */
+static void library_cache_release(CachedLibrary* entry) {
+    if (!entry) return;
+    
+    pthread_mutex_lock(&g_library_cache_mutex);
+    if (--entry->ref_count > 0) {
+        pthread_mutex_unlock(&g_library_cache_mutex);
+        return;
+    }
+    
+    CachedLibrary** link = &g_library_cache;
+    while (*link && *link != entry) {
+        link = &(*link)->next;
+    }
+    if (*link) *link = entry->next;
+    pthread_mutex_unlock(&g_library_cache_mutex);
+    
+    // 重要：先释放符号表，因为它可能引用module中的字符串
+    if (entry->symbols) symtbl_free(entry->symbols);
+    if (entry->module) bytecode_module_free(entry->module);
+    mmgr_free(entry->path);
+    mmgr_free(entry);
+}
+
+/**
+ * @brief 在库中查找导出符号
+ * 
+ * 符号表为各管理器共享，按需登记时持缓存锁。
+ */
+static Symbol* lookup_library_symbol(LoadedLibrary* lib, const char* name) {
+    pthread_mutex_lock(&g_library_cache_mutex);
+    Symbol* sym = symtbl_lookup(lib->symbols, name);
+    if (!sym && lib->module->symbol_index) {
+        const STBCSymbolRecord* rec = bytecode_lookup_symbol(lib->module, name);
+        if (rec) {
+            sym = define_function_symbol(lib->symbols, &lib->module->functions[rec->function_index]);
+        }
+    }
+    pthread_mutex_unlock(&g_library_cache_mutex);
+    return sym;
+}
+
+/**
+ * @brief 获取库缓存统计
+ */
+void libmgr_cache_get_stats(LibraryCacheStats* stats) {
+    if (!stats) return;
+    
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&g_library_cache_mutex);
+    for (CachedLibrary* entry = g_library_cache; entry; entry = entry->next) {
+        stats->entries++;
+        stats->references += entry->ref_count;
+    }
+    stats->hits = g_library_cache_hits;
+    stats->misses = g_library_cache_misses;
+    pthread_mutex_unlock(&g_library_cache_mutex);
 }
 
 /**
@@ -246,56 +464,68 @@ ErrorCode libmgr_load_library(LibraryManager* mgr, const char* filename) {
         return ERR_FILE_IO;
     }
     
-    // 加载字节码模块
-    BytecodeModule* module = bytecode_load(fullpath);
-    if (!module) {
+    // 从进程级缓存获取模块与符号表（未命中时加载）
+    ErrorCode err;
+    CachedLibrary* entry = library_cache_acquire(fullpath, &err);
+    if (!entry) {
         mmgr_free(lib_name);
         fprintf(stderr, "Error: Failed to load library: %s\n", fullpath);
-        return ERR_FILE_IO;
-    }
-    
-    // 构建符号表
-    SymbolTable* symbols = build_symbol_table_from_module(module);
-    if (!symbols) {
-        bytecode_module_free(module);
-        mmgr_free(lib_name);
-        return ERR_OUT_OF_MEMORY;
+        return err;
     }
     
     // 创建库记录
     LoadedLibrary* lib = (LoadedLibrary*)mmgr_alloc(sizeof(LoadedLibrary));
     if (!lib) {
-        symtbl_free(symbols);
-        bytecode_module_free(module);
+        library_cache_release(entry);
         mmgr_free(lib_name);
         return ERR_OUT_OF_MEMORY;
     }
     
     lib->name = lib_name;
     lib->path = mmgr_strdup(fullpath);
-    lib->module = module;
-    lib->symbols = symbols;
+    lib->module = entry->module;
+    lib->symbols = entry->symbols;
+    lib->cache_entry = entry;
     lib->next = mgr->libraries;
     mgr->libraries = lib;
     
+    // 已加载的库不再是延迟依赖
+    PendingLibrary** pending_ptr = &mgr->pending;
+    while (*pending_ptr) {
+        PendingLibrary* pending = *pending_ptr;
+        if (strcmp(pending->name, lib_name) == 0) {
+            *pending_ptr = pending->next;
+            free_pending_library(pending);
+        } else {
+            pending_ptr = &pending->next;
+        }
+    }
+    
     // printf("[libmgr] Loaded library: %s (%u functions)\n", 
     //        lib_name, module->function_count);
     
     return OK;
 }
 
+/**
+ * @brief 导入符号所在的哈希桶
+ */
+static ImportedSymbol** import_bucket(LibraryManager* mgr, const char* name) {
+    return &mgr->import_buckets[bytecode_symbol_hash(name) & (LIBMGR_IMPORT_BUCKETS - 1)];
+}
+
 /**
  * @brief 查找已导入的符号
  */
 ImportedSymbol* libmgr_find_import(LibraryManager* mgr, const char* name) {
     if (!mgr || !name) return NULL;
     
-    ImportedSymbol* sym = mgr->imports;
+    ImportedSymbol* sym = *import_bucket(mgr, name);
     while (sym) {
-        if (sym->name && strcmp(sym->name, name) == 0) {
+        if (strcmp(sym->name, name) == 0) {
             return sym;
         }
-        sym = sym->next;
+        sym = sym->hash_next;
     }
     
     return NULL;
@@ -322,7 +552,7 @@ ErrorCode libmgr_import_symbol(LibraryManager* mgr, const char* library_name,
     mmgr_free(lib_name);
     
     // 在库的符号表中查找符号
-    Symbol* symbol = symtbl_lookup(lib->symbols, symbol_name);
+    Symbol* symbol = lookup_library_symbol(lib, symbol_name);
     if (!symbol) {
         fprintf(stderr, "Error: Symbol not found in library %s: %s\n", 
                 library_name, symbol_name);
@@ -355,11 +585,19 @@ ErrorCode libmgr_import_symbol(LibraryManager* mgr, const char* library_name,
     
     import->name = mmgr_strdup(import_name);  // 使用导入名称（别名或原名）
     import->original_name = mmgr_strdup(symbol_name);
+    if (!import->name || !import->original_name) {
+        free_imported_symbol(import);
+        return ERR_OUT_OF_MEMORY;
+    }
     import->library = lib;
     import->symbol = symbol;
     import->next = mgr->imports;
     mgr->imports = import;
     
+    ImportedSymbol** bucket = import_bucket(mgr, import->name);
+    import->hash_next = *bucket;
+    *bucket = import;
+    
     // 将符号注册到全局符号表
     // 使用导入名称（别名或原名），这样代码中可以直接使用简单名称
     TypeInfo* type_copy = type_info_retain(symbol->type);
@@ -441,7 +679,7 @@ Symbol* libmgr_resolve_symbol(LibraryManager* mgr, const char* qualified_name) {
     if (!lib) return NULL;
     
     // 在库的符号表中查找符号
-    return symtbl_lookup(lib->symbols, symbol_name);
+    return lookup_library_symbol(lib, symbol_name);
 }
 
 /**
@@ -460,13 +698,20 @@ ErrorCode libmgr_unload_library(LibraryManager* mgr, const char* name) {
                 ImportedSymbol* import = *import_ptr;
                 if (import->library == lib) {
                     *import_ptr = import->next;
+                    
+                    ImportedSymbol** bucket = import_bucket(mgr, import->name);
+                    while (*bucket != import) {
+                        bucket = &(*bucket)->hash_next;
+                    }
+                    *bucket = import->hash_next;
                     free_imported_symbol(import);
                 } else {
                     import_ptr = &import->next;
                 }
             }
             
-            // 移除库
+            // 移除库及其调用解析缓存
+            clear_call_cache(mgr, lib);
             *lib_ptr = lib->next;
             free_loaded_library(lib);
             
@@ -480,6 +725,163 @@ ErrorCode libmgr_unload_library(LibraryManager* mgr, const char* name) {
     return ERR_NAME;
 }
 
+// ============================================================================
+// 延迟加载与库函数调用解析
+// ============================================================================
+
+/**
+ * @brief 登记延迟加载的库依赖
+ */
+ErrorCode libmgr_defer_library(LibraryManager* mgr, const char* filename) {
+    if (!mgr || !filename) return ERR_RUNTIME;
+    
+    char* lib_name = extract_library_name(filename);
+    if (!lib_name) return ERR_OUT_OF_MEMORY;
+    
+    // 已加载或已登记
+    bool known = libmgr_find_library(mgr, lib_name) != NULL;
+    for (PendingLibrary* pending = mgr->pending; pending && !known; pending = pending->next) {
+        known = strcmp(pending->name, lib_name) == 0;
+    }
+    if (known) {
+        mmgr_free(lib_name);
+        return OK;
+    }
+    
+    PendingLibrary* pending = (PendingLibrary*)mmgr_alloc(sizeof(PendingLibrary));
+    if (!pending) {
+        mmgr_free(lib_name);
+        return ERR_OUT_OF_MEMORY;
+    }
+    pending->name = lib_name;
+    pending->filename = mmgr_strdup(filename);
+    if (!pending->filename) {
+        free_pending_library(pending);
+        return ERR_OUT_OF_MEMORY;
+    }
+    pending->next = mgr->pending;
+    mgr->pending = pending;
+    
+    return OK;
+}
+
+/**
+ * @brief 获取尚未加载的延迟依赖个数
+ */
+uint32_t libmgr_get_pending_count(LibraryManager* mgr) {
+    if (!mgr) return 0;
+    
+    uint32_t count = 0;
+    for (PendingLibrary* pending = mgr->pending; pending; pending = pending->next) {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @brief 判断路径是否以 suffix 的前 suffix_len 个字符结尾，且在路径分隔处对齐
+ *
+ * "lib/util.stbc" 匹配 "util.stbc"，"myutil.stbc" 不匹配。
+ */
+static bool path_has_suffix(const char* path, const char* suffix, size_t suffix_len) {
+    size_t len = strlen(path);
+    if (len < suffix_len || strncmp(path + len - suffix_len, suffix, suffix_len) != 0) {
+        return false;
+    }
+    return len == suffix_len || path[len - suffix_len - 1] == '/' || suffix[0] == '/';
+}
+
+/**
+ * @brief 在路径匹配的库中查找函数，必要时加载匹配的延迟依赖
+ *
+ * 已加载的库中找不到时继续尝试匹配的延迟依赖，每个依赖文件只尝试一次。
+ * 加载会改动延迟依赖链表（移除已加载的，登记新库自己的依赖），每次加载后从头重新查找。
+ */
+static FunctionEntry* find_library_function(LibraryManager* mgr, const char* lib_path, size_t lib_path_len,
+                                            const char* func_name, LoadedLibrary** lib_out) {
+    char** tried = NULL;
+    uint32_t tried_count = 0;
+    FunctionEntry* found = NULL;
+    
+    for (;;) {
+        // lib->path 可能是完整路径，检查是否以 lib_path 结尾
+        for (LoadedLibrary* lib = mgr->libraries; lib && !found; lib = lib->next) {
+            if (!path_has_suffix(lib->path, lib_path, lib_path_len)) continue;
+            found = bytecode_find_function(lib->module, func_name);
+            if (found) *lib_out = lib;
+        }
+        if (found) break;
+        
+        PendingLibrary* match = NULL;
+        for (PendingLibrary* pending = mgr->pending; pending && !match; pending = pending->next) {
+            if (!path_has_suffix(pending->filename, lib_path, lib_path_len)) continue;
+            bool seen = false;
+            for (uint32_t i = 0; i < tried_count && !seen; i++) {
+                seen = strcmp(tried[i], pending->filename) == 0;
+            }
+            if (!seen) match = pending;
+        }
+        if (!match) break;
+        
+        // 加载成功后延迟记录被移除，先复制文件名
+        char** grown = (char**)mmgr_realloc(tried, sizeof(char*) * (tried_count + 1));
+        if (!grown) break;
+        tried = grown;
+        tried[tried_count] = mmgr_strdup(match->filename);
+        if (!tried[tried_count]) break;
+        libmgr_load_library(mgr, tried[tried_count++]);
+    }
+    
+    for (uint32_t i = 0; i < tried_count; i++) {
+        mmgr_free(tried[i]);
+    }
+    if (tried) mmgr_free(tried);
+    return found;
+}
+
+/**
+ * @brief 解析库函数调用
+ */
+FunctionEntry* libmgr_resolve_call(LibraryManager* mgr, const char* call_name, LoadedLibrary** lib_out) {
+    if (!mgr || !call_name) return NULL;
+    
+    // 命中缓存
+    ResolvedCall** bucket = &mgr->call_cache[bytecode_symbol_hash(call_name) & (LIBMGR_CALL_BUCKETS - 1)];
+    for (ResolvedCall* call = *bucket; call; call = call->next) {
+        if (strcmp(call->name, call_name) == 0) {
+            if (lib_out) *lib_out = call->library;
+            return call->function;
+        }
+    }
+    
+    // 拆分库文件路径（含 ".stbc"）与函数名（最后一个点之后）
+    const char* stbc_pos = strstr(call_name, ".stbc.");
+    if (!stbc_pos) return NULL;
+    const char* real_name = strrchr(call_name, '.') + 1;
+    size_t lib_path_len = (size_t)(stbc_pos - call_name) + 5;
+    
+    LoadedLibrary* lib = NULL;
+    FunctionEntry* func = find_library_function(mgr, call_name, lib_path_len, real_name, &lib);
+    if (!func) return NULL;
+    
+    // 缓存失败不影响本次解析
+    ResolvedCall* call = (ResolvedCall*)mmgr_alloc(sizeof(ResolvedCall));
+    if (call) {
+        call->name = mmgr_strdup(call_name);
+        if (call->name) {
+            call->library = lib;
+            call->function = func;
+            call->next = *bucket;
+            *bucket = call;
+        } else {
+            mmgr_free(call);
+        }
+    }
+    
+    if (lib_out) *lib_out = lib;
+    return func;
+}
+
 /**
  * @brief 打印已加载的库列表
  */
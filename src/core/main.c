@@ -7,6 +7,7 @@
 #include "vm.h"
 #include "bytecode.h"
 #include "bytecode_io.h"
+#include "bytecode_patch.h"
 #include "codegen.h"
 #include "typecheck.h"
 #include "symtbl.h"
@@ -16,6 +17,8 @@
 #include "debugger.h"
 #include "iomgr.h"
 #include "wcet.h"
+#include "optimizer.h"
+#include "regcode.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -70,15 +73,23 @@ bool cli_parse_args(int argc, char** argv, CliOptions* options) {
         {"dump-ast",      no_argument,       0, 'A'},
         {"dump-bytecode", no_argument,       0, 'B'},
         {"stats",         no_argument,       0, 's'},
+        {"statistics",    no_argument,       0, 's'},
         {"static",        no_argument,       0, 'S'},
         {"entry",         required_argument, 0, 'e'},
         {"cycle",         required_argument, 0, 'C'},
         {"io-simulator",  no_argument,       0, 'I'},
         {"io-config",     required_argument, 0, 'g'},
+        {"io-record",     required_argument, 0, 'T'},
+        {"io-replay",     required_argument, 0, 'Y'},
         {"wcet",          no_argument,       0, 'W'},
         {"wcet-entry",    required_argument, 0, 'E'},
         {"wcet-source",   required_argument, 0, 'F'},
         {"wcet-cpu",      required_argument, 0, 'P'},
+        {"make-patch",    required_argument, 0, 'M'},
+        {"lazy-libs",     no_argument,       0, 'Z'},
+        {"ir",            no_argument,       0, 'R'},
+        {"dump-ir",       no_argument,       0, 'D'},
+        {"regvm",         no_argument,       0, 'G'},
         {0, 0, 0, 0}
     };
     
@@ -172,6 +183,14 @@ bool cli_parse_args(int argc, char** argv, CliOptions* options) {
                 options->io_config_file = optarg;
                 break;
                 
+            case 'T':
+                options->io_record_file = optarg;
+                break;
+                
+            case 'Y':
+                options->io_replay_file = optarg;
+                break;
+                
             case 'W':
                 options->mode = MODE_WCET;
                 options->run_wcet = true;
@@ -195,6 +214,27 @@ bool cli_parse_args(int argc, char** argv, CliOptions* options) {
                 }
                 break;
                 
+            case 'M':
+                options->mode = MODE_MAKE_PATCH;
+                options->patch_base_file = optarg;
+                break;
+                
+            case 'Z':
+                options->lazy_libraries = true;
+                break;
+                
+            case 'R':
+                options->use_ir = true;
+                break;
+                
+            case 'D':
+                options->dump_ir = true;
+                break;
+                
+            case 'G':
+                options->register_vm = true;
+                break;
+                
             case '?':
                 // getopt_long 已经打印了错误消息
                 return false;
@@ -246,6 +286,11 @@ bool cli_parse_args(int argc, char** argv, CliOptions* options) {
         return false;
     }
     
+    if (options->mode == MODE_MAKE_PATCH && options->input_file == NULL) {
+        fprintf(stderr, "错误：生成补丁需要指定新的字节码文件\n");
+        return false;
+    }
+    
     return true;
 }
 
@@ -334,6 +379,69 @@ int cli_wcet(const CliOptions* options) {
     return (err == OK) ? 0 : 1;
 }
 
+/**
+ * @brief 差分补丁生成模式入口
+ */
+int cli_make_patch(const CliOptions* options) {
+    if (!mmgr_init()) {
+        fprintf(stderr, "错误：无法初始化内存管理器\n");
+        return 1;
+    }
+    
+    BytecodeModule* base = bytecode_load(options->patch_base_file);
+    if (!base) {
+        fprintf(stderr, "错误：无法加载基准字节码文件 '%s'\n", options->patch_base_file);
+        mmgr_cleanup();
+        return 1;
+    }
+    BytecodeModule* target = bytecode_load(options->input_file);
+    if (!target) {
+        fprintf(stderr, "错误：无法加载字节码文件 '%s'\n", options->input_file);
+        bytecode_module_free(base);
+        mmgr_cleanup();
+        return 1;
+    }
+    
+    // 确定输出文件名：默认将目标文件扩展名替换为 .stbp
+    char output_file[512];
+    if (options->output_file) {
+        snprintf(output_file, sizeof(output_file), "%s", options->output_file);
+    } else {
+        snprintf(output_file, sizeof(output_file), "%s", options->input_file);
+        char* ext = strrchr(output_file, '.');
+        if (ext) *ext = '\0';
+        strncat(output_file, ".stbp", sizeof(output_file) - strlen(output_file) - 1);
+    }
+    
+    int exit_code = 0;
+    BytecodePatch* patch = bytecode_patch_create(base, target);
+    if (!patch) {
+        fprintf(stderr, "错误：无法生成补丁\n");
+        exit_code = 1;
+    } else if (bytecode_patch_save(patch, output_file) != OK) {
+        fprintf(stderr, "错误：无法保存补丁文件 '%s'\n", output_file);
+        exit_code = 1;
+    } else {
+        const STBPHeader* h = &patch->header;
+        printf("补丁已生成: %s (%zu 字节)\n", output_file, patch->size);
+        if (options->verbose || options->statistics) {
+            printf("  基准摘要:   0x%08X\n", h->base_digest);
+            printf("  目标摘要:   0x%08X\n", h->target_digest);
+            printf("  代码段:     %u\n", h->segment_count);
+            printf("  指令区间:   %u\n", h->run_count);
+            printf("  新增常量:   %u\n", patch->new_const_count);
+            printf("  函数条目:   %u\n", h->function_record_count);
+            printf("  全局变量:   %u\n", h->global_record_count);
+        }
+    }
+    
+    bytecode_patch_free(patch);
+    bytecode_module_free(target);
+    bytecode_module_free(base);
+    mmgr_cleanup();
+    return exit_code;
+}
+
 /**
  * @brief 显示帮助信息
  */
@@ -352,18 +460,26 @@ void cli_print_help(void) {
     printf("  -o, --output <file>     指定输出文件名\n");
     printf("  -d, --debug             启用调试模式\n");
     printf("  -V, --verbose           详细输出\n");
-    printf("  -O, --optimize          启用优化\n");
-    printf("  -s, --stats             显示统计信息\n");
-    printf("  --static                静态链接库（将库代码合并到输出）\n");
+    printf("  -O, --optimize          启用优化（经中间表示生成，含 CSE、循环不变量外提）\n");
+    printf("  -s, --stats, --statistics  显示统计信息（-O 时含各优化遍统计）\n");
+    printf("  --static                静态链接库（将库代码合并到输出，删除不可达的函数）\n");
     printf("  -L <path>               添加库搜索路径\n");
     printf("  --dump-ast              打印抽象语法树\n");
-    printf("  --dump-bytecode         打印字节码\n\n");
+    printf("  --dump-bytecode         打印字节码\n");
+    printf("  --ir                    经中间表示（基本块 + SSA）生成字节码（不加 -O 时也如此）\n");
+    printf("  --dump-ir               打印中间表示\n");
+    printf("  --regvm                 同时生成寄存器格式代码，虚拟机按寄存器格式执行主程序\n\n");
     printf("运行模式专用选项:\n");
     printf("  -e, --entry <function>  指定入口函数名（默认：main，不区分大小写）\n");
-    printf("  -C, --cycle <ms>        指定执行周期（毫秒，默认：0表示单次执行）\n\n");
+    printf("  -C, --cycle <ms>        指定执行周期（毫秒，默认：0表示单次执行）\n");
+    printf("  --lazy-libs             库依赖在首次调用其中函数时才加载\n\n");
     printf("I/O 选项:\n");
     printf("  -I, --io-simulator      启用IO模拟器（无需真实硬件）\n");
-    printf("  --io-config <file>      指定IO配置文件（JSON格式）\n\n");
+    printf("  --io-config <file>      指定IO配置文件（JSON格式）\n");
+    printf("  --io-record <file>      将每次扫描的输入记录到轨迹文件\n");
+    printf("  --io-replay <file>      从轨迹文件回放输入（每次扫描取一条记录，确定性回放）\n\n");
+    printf("热更新:\n");
+    printf("  --make-patch <base>     生成从 <base> 到 [文件] 的差分补丁 (.stbp)\n\n");
     printf("示例:\n");
     printf("  stvm program.st                    # 编译并运行program.st\n");
     printf("  stvm program.stbc                  # 运行字节码\n");
@@ -375,6 +491,7 @@ void cli_print_help(void) {
     printf("  stvm io_blink.st -I -C 100         # IO模拟器，周期100ms\n");
     printf("  stvm program.st -d                 # 调试模式运行\n");
     printf("  stvm -i                            # 启动REPL\n");
+    printf("  stvm --make-patch v1.stbc v2.stbc  # 生成v1到v2的补丁v2.stbp\n");
 }
 
 /**
@@ -388,6 +505,27 @@ void cli_print_version(void) {
     printf("Built on %s %s\n", __DATE__, __TIME__);
 }
 
+/**
+ * @brief 按命令行选项生成寄存器格式代码（须在优化和静态链接之后）
+ *
+ * 不能翻译的模块保持栈式格式，只在详细输出时给出原因。
+ */
+static void cli_generate_register_code(BytecodeModule* module, const CliOptions* options) {
+    if (!options->register_vm) {
+        return;
+    }
+    
+    char reason[256] = "";
+    if (regcode_generate(module, reason, sizeof(reason)) != OK) {
+        if (options->verbose) {
+            printf("警告：无法生成寄存器格式代码，保持栈式格式：%s\n", reason);
+        }
+    } else if (options->verbose) {
+        printf("寄存器格式代码: %u 条指令（栈式 %u 条）\n",
+               module->reg_code->count, module->instruction_count);
+    }
+}
+
 /**
  * @brief 编译模式
  */
@@ -496,16 +634,37 @@ int cli_compile(const CliOptions* options) {
     
     typecheck_cleanup(&typechecker);
     
+    // 优化：AST 遍（类型检查之后、代码生成之前）
+    Optimizer* optimizer = NULL;
+    if (options->optimize) {
+        optimizer = optimizer_create();
+        if (optimizer) optimizer->libmgr = libmgr;
+        if (!optimizer || optimizer_run_ast(optimizer, parse_result) != OK) {
+            fprintf(stderr, "错误：优化失败\n");
+            libmgr_free(libmgr);
+            symtbl_free(symtbl);
+            optimizer_free(optimizer);
+            ast_free_node(parse_result);
+            mmgr_cleanup();
+            return 1;
+        }
+        if (options->verbose) {
+            printf("AST 优化完成（%u 轮）\n", optimizer->rounds);
+        }
+    }
+    
     // 创建字节码模块
     BytecodeModule* module = bytecode_module_create();
     if (!module) {
         fprintf(stderr, "错误：无法创建字节码模块\n");
         libmgr_free(libmgr);
         symtbl_free(symtbl);
+        optimizer_free(optimizer);
         ast_free_node(parse_result);
         mmgr_cleanup();
         return 1;
     }
+    module->source_file = mmgr_strdup(options->input_file);  // 行号表所属源文件
     
     // 代码生成
     if (options->verbose) {
@@ -518,10 +677,14 @@ int cli_compile(const CliOptions* options) {
         bytecode_module_free(module);
         libmgr_free(libmgr);
         symtbl_free(symtbl);
+        optimizer_free(optimizer);
         ast_free_node(parse_result);
         mmgr_cleanup();
         return 1;
     }
+    codegen->use_ir = options->use_ir;
+    codegen->dump_ir = options->dump_ir;
+    codegen->optimizer = optimizer;
     
     err = codegen_generate(codegen, parse_result);
     if (err != OK) {
@@ -530,6 +693,7 @@ int cli_compile(const CliOptions* options) {
         bytecode_module_free(module);
         libmgr_free(libmgr);
         symtbl_free(symtbl);
+        optimizer_free(optimizer);
         ast_free_node(parse_result);
         mmgr_cleanup();
         return 1;
@@ -603,10 +767,43 @@ int cli_compile(const CliOptions* options) {
         }
     }
     
+    // 优化：字节码遍（静态链接之后，合并进来的库函数也可内联）
+    if (optimizer && optimizer_run_bytecode(optimizer, module) != OK) {
+        fprintf(stderr, "错误：字节码优化失败\n");
+        bytecode_module_free(module);
+        libmgr_free(libmgr);
+        symtbl_free(symtbl);
+        optimizer_free(optimizer);
+        ast_free_node(parse_result);
+        mmgr_cleanup();
+        return 1;
+    }
+    
+    // 树摇（在字节码优化之后）：库中未被调用或已在所有调用点内联的函数和它们引用的常量不进入输出
+    if (options->static_link) {
+        TreeShakeStats shake;
+        err = bytecode_tree_shake(module, options->entry_function, &shake);
+        if (err != OK) {
+            fprintf(stderr, "警告：裁剪不可达代码失败\n");
+        } else if (shake.removed_instructions > 0 || shake.removed_function_count > 0 ||
+                   shake.removed_constants > 0) {
+            printf("裁剪不可达代码: %u 函数, %u 指令, %u 常量, %u 描述符\n",
+                   shake.removed_function_count, shake.removed_instructions,
+                   shake.removed_constants, shake.removed_descriptors);
+            for (uint32_t i = 0; i < shake.removed_function_count; i++) {
+                printf("  删除函数: %s\n", shake.removed_functions[i]);
+            }
+        }
+        bytecode_tree_shake_stats_free(&shake);
+    }
+    
+    cli_generate_register_code(module, options);
+    
     // 打印字节码（如果需要）
     if (options->dump_bytecode) {
         printf("\n=== 字节码 ===\n");
         bytecode_print_module(module);
+        regcode_print(module);
         printf("\n");
     }
     
@@ -649,18 +846,82 @@ int cli_compile(const CliOptions* options) {
         const MemoryStats* stats = mmgr_get_stats();
         printf("内存使用: %zu 字节\n", stats->total_allocated);
         printf("内存峰值: %zu 字节\n", stats->peak_usage);
+        
+        if (optimizer) {
+            optimizer_print_stats(optimizer);
+        }
     }
     
     // 清理
     bytecode_module_free(module);
     libmgr_free(libmgr);
     symtbl_free(symtbl);
+    optimizer_free(optimizer);
     ast_free_node(parse_result);
     mmgr_cleanup();
     
     return exit_code;
 }
 
+/**
+ * @brief 按命令行选项启用 I/O 输入记录或回放
+ * @return 回放实例（未启用回放时为 NULL），由调用者在释放 IO 管理器后关闭
+ */
+static IOTraceReplay* cli_setup_io_trace(IOManager* iomgr, const CliOptions* options) {
+    IOTraceReplay* replay = NULL;
+    
+    if (options->io_replay_file) {
+        replay = io_trace_replay_open(options->io_replay_file);
+        if (!replay) {
+            fprintf(stderr, "警告：无法打开IO回放文件 '%s'\n", options->io_replay_file);
+        } else {
+            io_manager_attach_replay(iomgr, replay);
+            if (options->verbose) {
+                printf("IO回放: %s (%llu 个扫描)\n", options->io_replay_file,
+                       (unsigned long long)io_trace_replay_scan_count(replay));
+            }
+        }
+    }
+    
+    if (options->io_record_file) {
+        if (io_trace_start_recording(iomgr, options->io_record_file) != OK) {
+            fprintf(stderr, "警告：无法创建IO记录文件 '%s'\n", options->io_record_file);
+        } else if (options->verbose) {
+            printf("IO记录: %s\n", options->io_record_file);
+        }
+    }
+    
+    return replay;
+}
+
+/**
+ * @brief 是否由扫描驱动 I/O 刷新（启用了输入记录或回放）
+ * 
+ * 回放的记录序号随刷新计数推进，由自由运行的刷新线程推进时与 VM 扫描无关，
+ * 因此记录/回放时不启动刷新线程，每次扫描前后各刷新一次。
+ */
+static bool cli_io_scan_driven(const CliOptions* options) {
+    return options->io_replay_file != NULL || options->io_record_file != NULL;
+}
+
+/**
+ * @brief 扫描开始：扫描驱动时刷新输入（回放取下一条记录，记录写入本次输入）
+ */
+static void cli_io_scan_begin(IOManager* iomgr, const CliOptions* options) {
+    if (iomgr && cli_io_scan_driven(options)) {
+        io_manager_refresh_inputs(iomgr);
+    }
+}
+
+/**
+ * @brief 扫描结束：扫描驱动时刷新输出
+ */
+static void cli_io_scan_end(IOManager* iomgr, const CliOptions* options) {
+    if (iomgr && cli_io_scan_driven(options)) {
+        io_manager_refresh_outputs(iomgr);
+    }
+}
+
 /**
  * @brief 运行模式
  */
@@ -701,14 +962,15 @@ int cli_run(const CliOptions* options) {
             return 1;
         }
         
-        // 加载所有依赖的库
+        // 加载所有依赖的库（延迟模式下只登记，首次调用时加载）
         for (uint32_t i = 0; i < module->library_dep_count; i++) {
             const char* lib_path = module->library_deps[i];
             if (options->verbose) {
-                printf("  加载库: %s\n", lib_path);
+                printf("  %s: %s\n", options->lazy_libraries ? "登记库" : "加载库", lib_path);
             }
             
-            ErrorCode err = libmgr_load_library(libmgr, lib_path);
+            ErrorCode err = options->lazy_libraries ? libmgr_defer_library(libmgr, lib_path)
+                                                    : libmgr_load_library(libmgr, lib_path);
             if (err != OK) {
                 fprintf(stderr, "错误：无法加载库 '%s'\n", lib_path);
                 libmgr_free(libmgr);
@@ -727,6 +989,7 @@ int cli_run(const CliOptions* options) {
     if (options->dump_bytecode) {
         printf("\n=== 字节码 ===\n");
         bytecode_print_module(module);
+        regcode_print(module);
         printf("\n");
     }
     
@@ -758,6 +1021,7 @@ int cli_run(const CliOptions* options) {
     // 初始化IO管理器(如果启用或需要)
     IOManager* iomgr = NULL;
     IOHardwareAdapter* io_adapter = NULL;
+    IOTraceReplay* io_replay = NULL;
     
     if (options->use_io_simulator || needs_io_manager) {
         if (options->verbose) {
@@ -799,7 +1063,7 @@ int cli_run(const CliOptions* options) {
             if (options->verbose) {
                 printf("加载IO配置文件: %s\n", options->io_config_file);
             }
-            ErrorCode cfg_err = io_manager_load_config_simple(iomgr, options->io_config_file);
+            ErrorCode cfg_err = io_manager_load_config_cached(iomgr, options->io_config_file, NULL);
             if (cfg_err != OK) {
                 fprintf(stderr, "警告：IO配置文件加载失败,使用默认配置\n");
                 // 加载失败，使用默认配置
@@ -826,6 +1090,7 @@ add_default_io_points:
             io_config.offset = 0.0;
             io_config.enable_filter = false;
             io_config.filter_samples = 1;
+            io_config.deadband = 0.0;
             io_manager_add_point(iomgr, &io_config);
             
             // %QX0.0 - 数字输出
@@ -857,10 +1122,15 @@ add_default_io_points:
             }
         }
         
-        // 启动IO自动刷新(10ms周期)
-        ErrorCode err = io_manager_start_refresh(iomgr, 1000000);
-        if (err != OK) {
-            fprintf(stderr, "警告：无法启动IO自动刷新\n");
+        // 输入记录/回放
+        io_replay = cli_setup_io_trace(iomgr, options);
+        
+        // 启动IO自动刷新(10ms周期)；记录/回放时改由每次扫描刷新，回放逐扫描确定
+        if (!cli_io_scan_driven(options)) {
+            ErrorCode err = io_manager_start_refresh(iomgr, 1000000);
+            if (err != OK) {
+                fprintf(stderr, "警告：无法启动IO自动刷新\n");
+            }
         }
         
         if (options->verbose) {
@@ -877,13 +1147,20 @@ add_default_io_points:
         }
         
         // 执行完整程序（包括全局变量初始化和所有代码）
+        cli_io_scan_begin(iomgr, options);
         ErrorCode err = vm_run_from(vm, module->entry_point);
+        cli_io_scan_end(iomgr, options);
         if (err != OK) {
             fprintf(stderr, "运行时错误: %s\n", vm->error_msg);
             exit_code = 1;
         } else if (options->verbose) {
             printf("脚本执行完成\n");
         }
+        if (options->statistics) {
+            printf("\n=== 统计信息 ===\n");
+            printf("执行格式: %s\n", module->reg_code ? "寄存器" : "栈式");
+            printf("执行指令数: %lu\n", (unsigned long)vm->instruction_count);
+        }
     } else {
         // 指定了入口函数，按原有逻辑执行
         const char* entry_name = options->entry_function;
@@ -975,7 +1252,9 @@ add_default_io_points:
                     }
                     
                     // 执行一次函数
+                    cli_io_scan_begin(iomgr, options);
                     ErrorCode err = vm_run_from(vm, entry_function->address);
+                    cli_io_scan_end(iomgr, options);
                     if (err != OK) {
                         fprintf(stderr, "运行时错误 (周期 %lu): %s\n", cycle_count + 1, vm->error_msg);
                         // 在周期性执行中，继续下一个周期而不是退出
@@ -1000,7 +1279,9 @@ add_default_io_points:
             } else {
                 // 单次执行模式
                 // 直接调用 vm_run_from 使用指定的入口函数地址
+                cli_io_scan_begin(iomgr, options);
                 ErrorCode err = vm_run_from(vm, entry_function->address);
+                cli_io_scan_end(iomgr, options);
                 if (err != OK) {
                     fprintf(stderr, "运行时错误: %s\n", vm->error_msg);
                     exit_code = 1;
@@ -1026,6 +1307,9 @@ add_default_io_points:
         io_manager_stop_refresh(iomgr);
         io_manager_free(iomgr);
     }
+    if (io_replay) {
+        io_trace_replay_close(io_replay);
+    }
     if (io_adapter) {
         io_adapter_free_simulator(io_adapter);
     }
@@ -1145,6 +1429,25 @@ int cli_compile_and_run(const CliOptions* options) {
     
     typecheck_cleanup(&typechecker);
     
+    // 优化：AST 遍（类型检查之后、代码生成之前）
+    Optimizer* optimizer = NULL;
+    if (options->optimize) {
+        optimizer = optimizer_create();
+        if (optimizer) optimizer->libmgr = libmgr;
+        if (!optimizer || optimizer_run_ast(optimizer, parse_result) != OK) {
+            fprintf(stderr, "错误：优化失败\n");
+            libmgr_free(libmgr);
+            symtbl_free(symtbl);
+            optimizer_free(optimizer);
+            ast_free_node(parse_result);
+            mmgr_cleanup();
+            return 1;
+        }
+        if (options->verbose) {
+            printf("AST 优化完成（%u 轮）\n", optimizer->rounds);
+        }
+    }
+    
     // 3. 代码生成阶段
     if (options->verbose) {
         printf("开始代码生成...\n");
@@ -1155,10 +1458,12 @@ int cli_compile_and_run(const CliOptions* options) {
         fprintf(stderr, "错误：无法创建字节码模块\n");
         libmgr_free(libmgr);
         symtbl_free(symtbl);
+        optimizer_free(optimizer);
         ast_free_node(parse_result);
         mmgr_cleanup();
         return 1;
     }
+    module->source_file = mmgr_strdup(options->input_file);  // 行号表所属源文件
     
     CodeGenContext* codegen = codegen_create(module, symtbl);
     if (!codegen) {
@@ -1166,10 +1471,14 @@ int cli_compile_and_run(const CliOptions* options) {
         bytecode_module_free(module);
         libmgr_free(libmgr);
         symtbl_free(symtbl);
+        optimizer_free(optimizer);
         ast_free_node(parse_result);
         mmgr_cleanup();
         return 1;
     }
+    codegen->use_ir = options->use_ir;
+    codegen->dump_ir = options->dump_ir;
+    codegen->optimizer = optimizer;
     
     err = codegen_generate(codegen, parse_result);
     if (err != OK) {
@@ -1178,6 +1487,7 @@ int cli_compile_and_run(const CliOptions* options) {
         bytecode_module_free(module);
         libmgr_free(libmgr);
         symtbl_free(symtbl);
+        optimizer_free(optimizer);
         ast_free_node(parse_result);
         mmgr_cleanup();
         return 1;
@@ -1188,13 +1498,32 @@ int cli_compile_and_run(const CliOptions* options) {
     }
     
     codegen_free(codegen);
+    
+    // 优化：字节码遍（内联、窥孔）
+    if (optimizer) {
+        err = optimizer_run_bytecode(optimizer, module);
+        if (err == OK && options->statistics) {
+            optimizer_print_stats(optimizer);
+        }
+    }
     symtbl_free(symtbl);
+    optimizer_free(optimizer);
     ast_free_node(parse_result);
+    if (err != OK) {
+        fprintf(stderr, "错误：字节码优化失败\n");
+        bytecode_module_free(module);
+        libmgr_free(libmgr);
+        mmgr_cleanup();
+        return 1;
+    }
+    
+    cli_generate_register_code(module, options);
     
     // 打印字节码（如果需要）
     if (options->dump_bytecode) {
         printf("\n=== 字节码 ===\n");
         bytecode_print_module(module);
+        regcode_print(module);
         printf("\n");
     }
     
@@ -1229,6 +1558,7 @@ int cli_compile_and_run(const CliOptions* options) {
     // 初始化IO管理器(如果启用或需要)
     IOManager* iomgr = NULL;
     IOHardwareAdapter* io_adapter = NULL;
+    IOTraceReplay* io_replay = NULL;
     
     if (options->use_io_simulator || needs_io_manager) {
         if (options->verbose) {
@@ -1270,7 +1600,7 @@ int cli_compile_and_run(const CliOptions* options) {
             if (options->verbose) {
                 printf("加载IO配置文件: %s\n", options->io_config_file);
             }
-            ErrorCode cfg_err = io_manager_load_config_simple(iomgr, options->io_config_file);
+            ErrorCode cfg_err = io_manager_load_config_cached(iomgr, options->io_config_file, NULL);
             if (cfg_err != OK) {
                 fprintf(stderr, "警告：IO配置文件加载失败,使用默认配置\n");
                 // 加载失败，使用默认配置
@@ -1297,6 +1627,7 @@ add_default_io_points_2:
             io_config.offset = 0.0;
             io_config.enable_filter = false;
             io_config.filter_samples = 1;
+            io_config.deadband = 0.0;
             io_manager_add_point(iomgr, &io_config);
             
             // %QX0.0 - 数字输出
@@ -1328,10 +1659,15 @@ add_default_io_points_2:
             }
         }
         
-        // 启动IO自动刷新(10ms周期)
-        ErrorCode io_err = io_manager_start_refresh(iomgr, 1000000);
-        if (io_err != OK) {
-            fprintf(stderr, "警告：无法启动IO自动刷新\n");
+        // 输入记录/回放
+        io_replay = cli_setup_io_trace(iomgr, options);
+        
+        // 启动IO自动刷新(10ms周期)；记录/回放时改由每次扫描刷新，回放逐扫描确定
+        if (!cli_io_scan_driven(options)) {
+            ErrorCode io_err = io_manager_start_refresh(iomgr, 1000000);
+            if (io_err != OK) {
+                fprintf(stderr, "警告：无法启动IO自动刷新\n");
+            }
         }
         
         if (options->verbose) {
@@ -1362,13 +1698,20 @@ add_default_io_points_2:
         }
         
         // 执行完整程序（包括全局变量初始化和所有代码）
+        cli_io_scan_begin(iomgr, options);
         ErrorCode err = vm_run_from(vm, module->entry_point);
+        cli_io_scan_end(iomgr, options);
         if (err != OK) {
             fprintf(stderr, "运行时错误: %s\n", vm->error_msg);
             exit_code = 1;
         } else if (options->verbose) {
             printf("脚本执行完成\n");
         }
+        if (options->statistics) {
+            printf("\n=== 统计信息 ===\n");
+            printf("执行格式: %s\n", module->reg_code ? "寄存器" : "栈式");
+            printf("执行指令数: %lu\n", (unsigned long)vm->instruction_count);
+        }
     } else {
         // 指定了入口函数，按原有逻辑执行
         const char* entry_name = options->entry_function;
@@ -1443,7 +1786,9 @@ add_default_io_points_2:
                     }
                     
                     // 执行一次函数
+                    cli_io_scan_begin(iomgr, options);
                     ErrorCode err = vm_run_from(vm, entry_function->address);
+                    cli_io_scan_end(iomgr, options);
                     if (err != OK) {
                         fprintf(stderr, "运行时错误 (周期 %lu): %s\n", cycle_count + 1, vm->error_msg);
                         if (options->verbose) {
@@ -1466,7 +1811,9 @@ add_default_io_points_2:
                 }
             } else {
                 // 单次执行模式
+                cli_io_scan_begin(iomgr, options);
                 ErrorCode err = vm_run_from(vm, entry_function->address);
+                cli_io_scan_end(iomgr, options);
                 if (err != OK) {
                     fprintf(stderr, "运行时错误: %s\n", vm->error_msg);
                     exit_code = 1;
@@ -1493,6 +1840,9 @@ add_default_io_points_2:
         io_manager_stop_refresh(iomgr);
         io_manager_free(iomgr);
     }
+    if (io_replay) {
+        io_trace_replay_close(io_replay);
+    }
     if (io_adapter) {
         io_adapter_free_simulator(io_adapter);
     }
@@ -1659,6 +2009,9 @@ int main(int argc, char** argv) {
         case MODE_WCET:
             return cli_wcet(&options);
             
+        case MODE_MAKE_PATCH:
+            return cli_make_patch(&options);
+            
         default:
             fprintf(stderr, "错误：未知模式\n");
             return 1;
@@ -0,0 +1,3079 @@
+/**
+ * @file optimizer.c
+ * @brief 优化器实现
+ *
+ * AST 遍只做不改变可观察行为的改写：
+ * - 会在运行时报错的运算（除零、溢出、非法移位量、NaN/Inf）不折叠，
+ *   也不作为无副作用表达式删除，错误仍在原处报告
+ * - 全局变量可能被强制、调试器或热更新修改，只传播 VAR CONSTANT 常量；
+ *   函数局部变量（不含静态变量、外部 I/O 变量）才做复写传播和死存储消除
+ *
+ * IR 遍同样不合并、不外提全局变量读取；函数调用只有经副作用分析确认为
+ * 纯函数（不读写全局变量、不做 I/O、只调用纯函数）时才参与。
+ */
+
+#include "optimizer.h"
+#include "bytecode_io.h"
+#include "libmgr.h"
+#include "mmgr.h"
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#define OPT_DEFAULT_MAX_ROUNDS  8   // AST 遍默认最大轮次
+#define PEEPHOLE_MAX_ROUNDS     8   // 窥孔优化最大轮次
+#define JUMP_THREAD_LIMIT       16  // 跳转穿透的最大跳数（防止跳转环）
+#define INLINE_MAX_SIZE         32  // 总是内联的函数体指令数上限
+#define INLINE_SINGLE_SITE_SIZE 128 // 只有一个调用点时的函数体指令数上限
+#define INLINE_GROWTH_PERCENT   50  // 内联造成的指令增长上限（占原指令数的百分比）
+#define INLINE_MIN_GROWTH       256 // 小模块的指令增长下限
+#define INLINE_MAX_ROUNDS       4   // 内联最大轮次（每轮展开后可能产生新的叶子函数）
+#define INLINE_MAX_SLOTS        64  // 被调函数的帧槽位上限（按位记录写入状态）
+#define EFFECT_MAX_DEPTH        8   // 副作用分析追踪嵌套调用的最大深度
+
+// ============================================================================
+// 遍表
+// ============================================================================
+
+typedef uint32_t (*AstPassFn)(Optimizer* opt, ASTNode* program);
+typedef uint32_t (*IrPassFn)(Optimizer* opt, IrModule* ir);
+typedef uint32_t (*BytecodePassFn)(Optimizer* opt, BytecodeModule* module);
+
+/**
+ * @brief 优化遍描述
+ */
+typedef struct {
+    const char* name;
+    OptUnit unit;
+    AstPassFn run_ast;
+    IrPassFn run_ir;
+    BytecodePassFn run_bytecode;
+} OptPassDesc;
+
+static uint32_t pass_const_globals(Optimizer* opt, ASTNode* program);
+static uint32_t pass_const_fold(Optimizer* opt, ASTNode* program);
+static uint32_t pass_algebraic(Optimizer* opt, ASTNode* program);
+static uint32_t pass_copy_prop(Optimizer* opt, ASTNode* program);
+static uint32_t pass_dead_store(Optimizer* opt, ASTNode* program);
+static uint32_t pass_dead_code(Optimizer* opt, ASTNode* program);
+static uint32_t pass_cse(Optimizer* opt, IrModule* ir);
+static uint32_t pass_licm(Optimizer* opt, IrModule* ir);
+static uint32_t pass_inline(Optimizer* opt, BytecodeModule* module);
+static uint32_t pass_peephole(Optimizer* opt, BytecodeModule* module);
+
+static const OptPassDesc g_passes[OPT_PASS_COUNT] = {
+    [OPT_PASS_CONST_GLOBALS] = {"const-globals", OPT_UNIT_AST,      pass_const_globals, NULL,      NULL},
+    [OPT_PASS_CONST_FOLD]    = {"const-fold",    OPT_UNIT_AST,      pass_const_fold,    NULL,      NULL},
+    [OPT_PASS_ALGEBRAIC]     = {"algebraic",     OPT_UNIT_AST,      pass_algebraic,     NULL,      NULL},
+    [OPT_PASS_COPY_PROP]     = {"copy-prop",     OPT_UNIT_AST,      pass_copy_prop,     NULL,      NULL},
+    [OPT_PASS_DEAD_STORE]    = {"dead-store",    OPT_UNIT_AST,      pass_dead_store,    NULL,      NULL},
+    [OPT_PASS_DEAD_CODE]     = {"dead-code",     OPT_UNIT_AST,      pass_dead_code,     NULL,      NULL},
+    [OPT_PASS_CSE]           = {"cse",           OPT_UNIT_IR,       NULL,               pass_cse,  NULL},
+    [OPT_PASS_LICM]          = {"licm",          OPT_UNIT_IR,       NULL,               pass_licm, NULL},
+    [OPT_PASS_INLINE]        = {"inline",        OPT_UNIT_BYTECODE, NULL,               NULL,      pass_inline},
+    [OPT_PASS_PEEPHOLE]      = {"peephole",      OPT_UNIT_BYTECODE, NULL,               NULL,      pass_peephole},
+};
+
+// ============================================================================
+// 优化器生命周期与遍管理
+// ============================================================================
+
+/**
+ * @brief 创建优化器
+ */
+Optimizer* optimizer_create(void) {
+    Optimizer* opt = (Optimizer*)mmgr_calloc(sizeof(Optimizer));
+    if (!opt) return NULL;
+
+    for (int i = 0; i < OPT_PASS_COUNT; i++) {
+        opt->passes[i].name = g_passes[i].name;
+        opt->passes[i].unit = g_passes[i].unit;
+        opt->passes[i].enabled = true;
+    }
+    opt->max_rounds = OPT_DEFAULT_MAX_ROUNDS;
+    opt->error_code = OK;
+    return opt;
+}
+
+/**
+ * @brief 释放优化器
+ */
+void optimizer_free(Optimizer* opt) {
+    if (!opt) return;
+
+    while (opt->graveyard) {
+        ASTNode* node = opt->graveyard;
+        opt->graveyard = node->next;
+        node->next = NULL;
+        ast_free_node(node);
+    }
+    mmgr_free(opt);
+}
+
+/**
+ * @brief 按名称启用或禁用优化遍
+ */
+bool optimizer_set_pass_enabled(Optimizer* opt, const char* name, bool enabled) {
+    if (!opt || !name) return false;
+
+    for (int i = 0; i < OPT_PASS_COUNT; i++) {
+        if (strcmp(opt->passes[i].name, name) == 0) {
+            opt->passes[i].enabled = enabled;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief 当前单调时钟（毫秒）
+ */
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+/**
+ * @brief 执行一个优化遍并累计统计
+ */
+static uint32_t run_pass(Optimizer* opt, int id, ASTNode* program, IrModule* ir, BytecodeModule* module) {
+    OptPassStats* stats = &opt->passes[id];
+    double start = now_ms();
+
+    uint32_t changes;
+    switch (g_passes[id].unit) {
+        case OPT_UNIT_AST: changes = g_passes[id].run_ast(opt, program); break;
+        case OPT_UNIT_IR:  changes = g_passes[id].run_ir(opt, ir); break;
+        default:           changes = g_passes[id].run_bytecode(opt, module); break;
+    }
+
+    stats->runs++;
+    stats->changes += changes;
+    stats->time_ms += now_ms() - start;
+    return changes;
+}
+
+/**
+ * @brief 执行 AST 优化遍
+ */
+ErrorCode optimizer_run_ast(Optimizer* opt, ASTNode* program) {
+    if (!opt || !program || program->type != AST_PROGRAM) return ERR_RUNTIME;
+
+    // 各遍互相制造机会（传播后可折叠，折叠后条件变为常量），反复执行到不动点
+    for (uint32_t round = 0; round < opt->max_rounds; round++) {
+        uint32_t changes = 0;
+        for (int i = 0; i < OPT_PASS_COUNT; i++) {
+            if (g_passes[i].unit != OPT_UNIT_AST || !opt->passes[i].enabled) continue;
+            changes += run_pass(opt, i, program, NULL, NULL);
+            if (opt->error_code != OK) return opt->error_code;
+        }
+        opt->rounds++;
+        if (changes == 0) break;
+    }
+    return OK;
+}
+
+/**
+ * @brief 执行 IR 优化遍
+ */
+ErrorCode optimizer_run_ir(Optimizer* opt, IrModule* ir) {
+    if (!opt || !ir) return ERR_RUNTIME;
+
+    for (int i = 0; i < OPT_PASS_COUNT; i++) {
+        if (g_passes[i].unit != OPT_UNIT_IR || !opt->passes[i].enabled) continue;
+        run_pass(opt, i, NULL, ir, NULL);
+        if (opt->error_code != OK) return opt->error_code;
+    }
+    return OK;
+}
+
+/**
+ * @brief 执行字节码优化遍
+ */
+ErrorCode optimizer_run_bytecode(Optimizer* opt, BytecodeModule* module) {
+    if (!opt || !module) return ERR_RUNTIME;
+
+    opt->instructions_before = module->instruction_count;
+    for (int i = 0; i < OPT_PASS_COUNT; i++) {
+        if (g_passes[i].unit != OPT_UNIT_BYTECODE || !opt->passes[i].enabled) continue;
+        run_pass(opt, i, NULL, NULL, module);
+        if (opt->error_code != OK) return opt->error_code;
+    }
+    opt->instructions_after = module->instruction_count;
+    
+    // 内联和窥孔改变了代码布局，重新标记免检的数组访问
+    bytecode_mark_unchecked_arrays(module);
+    return OK;
+}
+
+/**
+ * @brief 打印优化统计
+ */
+void optimizer_print_stats(const Optimizer* opt) {
+    if (!opt) return;
+
+    printf("\n=== 优化统计 ===\n");
+    printf("AST 轮次: %u\n", opt->rounds);
+    printf("%-16s %8s %8s %10s\n", "优化遍", "执行次数", "改动数", "耗时(ms)");
+    for (int i = 0; i < OPT_PASS_COUNT; i++) {
+        const OptPassStats* s = &opt->passes[i];
+        if (!s->enabled) {
+            printf("%-16s %8s\n", s->name, "(禁用)");
+            continue;
+        }
+        printf("%-16s %8u %8u %10.3f\n", s->name, s->runs, s->changes, s->time_ms);
+    }
+    if (opt->instructions_before > 0) {
+        printf("指令数: %u -> %u\n", opt->instructions_before, opt->instructions_after);
+    }
+}
+
+// ============================================================================
+// 公共工具：名字集合、节点回收、字面量
+// ============================================================================
+
+/**
+ * @brief 名字集合（名字指向 AST 内的字符串，不复制）
+ */
+typedef struct {
+    const char** names;
+    uint32_t count;
+    uint32_t capacity;
+} NameSet;
+
+static int32_t name_set_find(const NameSet* set, const char* name) {
+    for (uint32_t i = 0; i < set->count; i++) {
+        if (strcmp(set->names[i], name) == 0) return (int32_t)i;
+    }
+    return -1;
+}
+
+/**
+ * @brief 加入名字（已存在时不重复加入），内存不足时记录错误
+ */
+static void name_set_add(Optimizer* opt, NameSet* set, const char* name) {
+    if (!name || name_set_find(set, name) >= 0) return;
+
+    if (set->count >= set->capacity) {
+        uint32_t capacity = set->capacity ? set->capacity * 2 : 16;
+        const char** names = (const char**)mmgr_realloc((void*)set->names, sizeof(char*) * capacity);
+        if (!names) {
+            opt->error_code = ERR_OUT_OF_MEMORY;
+            return;
+        }
+        set->names = names;
+        set->capacity = capacity;
+    }
+    set->names[set->count++] = name;
+}
+
+static void name_set_free(NameSet* set) {
+    if (set->names) mmgr_free((void*)set->names);
+    memset(set, 0, sizeof(*set));
+}
+
+/**
+ * @brief 把单个节点挂入回收链表（调用者须已断开其 next）
+ */
+static void bury_node(Optimizer* opt, ASTNode* node) {
+    if (!node) return;
+    node->next = opt->graveyard;
+    opt->graveyard = node;
+}
+
+/**
+ * @brief 把语句链表逐个挂入回收链表
+ */
+static void bury_list(Optimizer* opt, ASTNode* list) {
+    while (list) {
+        ASTNode* next = list->next;
+        list->next = NULL;
+        bury_node(opt, list);
+        list = next;
+    }
+}
+
+static bool is_scalar_type(DataType type) {
+    return type == TYPE_INT || type == TYPE_REAL || type == TYPE_BOOL;
+}
+
+static bool is_scalar_literal(const ASTNode* node) {
+    return node && node->type == AST_LITERAL && is_scalar_type(node->data.literal.value.type);
+}
+
+static Value make_int(int64_t v) {
+    Value r;
+    memset(&r, 0, sizeof(r));
+    r.type = TYPE_INT;
+    r.int_val = (int32_t)v;
+    return r;
+}
+
+static Value make_real(double v) {
+    Value r;
+    memset(&r, 0, sizeof(r));
+    r.type = TYPE_REAL;
+    r.real_val = v;
+    return r;
+}
+
+static Value make_bool(bool v) {
+    Value r;
+    memset(&r, 0, sizeof(r));
+    r.type = TYPE_BOOL;
+    r.bool_val = v;
+    return r;
+}
+
+/**
+ * @brief 把表达式节点原地改写为字面量（子节点挂入回收链表）
+ *
+ * 原地改写保留节点在父节点中的位置和 resolved_type。
+ */
+static void replace_with_literal(Optimizer* opt, ASTNode* node, Value value) {
+    switch (node->type) {
+        case AST_BINARY_OP:
+            bury_node(opt, node->data.binary_op.left);
+            bury_node(opt, node->data.binary_op.right);
+            break;
+        case AST_UNARY_OP:
+            bury_node(opt, node->data.unary_op.operand);
+            break;
+        case AST_IDENTIFIER:
+            mmgr_free(node->data.identifier.name);
+            break;
+        default:
+            break;
+    }
+
+    memset(&node->data, 0, sizeof(node->data));
+    node->type = AST_LITERAL;
+    value.quality = QUALITY_GOOD;
+    node->data.literal.value = value;
+}
+
+/**
+ * @brief 是否为带整数结果类型的节点（AND/OR/XOR/NOT 据此选择位运算）
+ */
+static bool has_int_result(const ASTNode* node) {
+    return node->resolved_type && node->resolved_type->base_type == TYPE_INT;
+}
+
+// ============================================================================
+// 语法树遍历
+// ============================================================================
+
+typedef uint32_t (*ExprVisitor)(Optimizer* opt, ASTNode* expr, void* data);
+
+static uint32_t visit_stmt_list(Optimizer* opt, ASTNode* list, ExprVisitor visit, void* data);
+
+/**
+ * @brief 对语句中的每个表达式位置调用 visit（赋值目标只访问其下标）
+ */
+static uint32_t visit_stmt(Optimizer* opt, ASTNode* stmt, ExprVisitor visit, void* data) {
+    uint32_t changes = 0;
+
+    switch (stmt->type) {
+        case AST_ASSIGN: {
+            ASTNode* target = stmt->data.assign.target;
+            if (target && target->type == AST_ARRAY_ACCESS) {
+                changes += visit(opt, target->data.array_access.index, data);
+            }
+            changes += visit(opt, stmt->data.assign.value, data);
+            break;
+        }
+        case AST_IF:
+            changes += visit(opt, stmt->data.if_stmt.condition, data);
+            changes += visit_stmt_list(opt, stmt->data.if_stmt.then_branch, visit, data);
+            changes += visit_stmt_list(opt, stmt->data.if_stmt.else_branch, visit, data);
+            break;
+        case AST_WHILE:
+            changes += visit(opt, stmt->data.while_stmt.condition, data);
+            changes += visit_stmt_list(opt, stmt->data.while_stmt.body, visit, data);
+            break;
+        case AST_FOR:
+            changes += visit(opt, stmt->data.for_stmt.start, data);
+            changes += visit(opt, stmt->data.for_stmt.end, data);
+            changes += visit(opt, stmt->data.for_stmt.step, data);
+            changes += visit_stmt_list(opt, stmt->data.for_stmt.body, visit, data);
+            break;
+        case AST_REPEAT:
+            changes += visit_stmt_list(opt, stmt->data.repeat_stmt.body, visit, data);
+            changes += visit(opt, stmt->data.repeat_stmt.condition, data);
+            break;
+        case AST_CASE:
+            changes += visit(opt, stmt->data.case_stmt.expression, data);
+            for (int i = 0; i < stmt->data.case_stmt.case_count; i++) {
+                ASTNode* element = stmt->data.case_stmt.cases[i];
+                if (element && element->type == AST_CASE_ELEMENT) {
+                    // 标签折叠为字面量后代码生成才能使用跳转表
+                    for (ASTNode* label = element->data.case_element.labels; label; label = label->next) {
+                        if (label->type == AST_CASE_RANGE) {
+                            changes += visit(opt, label->data.case_range.low, data);
+                            changes += visit(opt, label->data.case_range.high, data);
+                        } else {
+                            changes += visit(opt, label, data);
+                        }
+                    }
+                    changes += visit_stmt_list(opt, element->data.case_element.statements, visit, data);
+                }
+            }
+            changes += visit_stmt_list(opt, stmt->data.case_stmt.default_case, visit, data);
+            break;
+        case AST_RETURN:
+            changes += visit(opt, stmt->data.return_stmt.value, data);
+            break;
+        case AST_BLOCK:
+            // 块内语句就是链表中其后的语句（见 ast_create_block）
+            break;
+        default:
+            // 函数调用语句
+            changes += visit(opt, stmt, data);
+            break;
+    }
+    return changes;
+}
+
+static uint32_t visit_stmt_list(Optimizer* opt, ASTNode* list, ExprVisitor visit, void* data) {
+    uint32_t changes = 0;
+    for (ASTNode* stmt = list; stmt && opt->error_code == OK; stmt = stmt->next) {
+        changes += visit_stmt(opt, stmt, visit, data);
+    }
+    return changes;
+}
+
+static void collect_writes_list(Optimizer* opt, const ASTNode* list, NameSet* writes);
+
+/**
+ * @brief 收集语句（含嵌套语句）写入的变量名：赋值目标和 FOR 循环变量
+ */
+static void collect_writes(Optimizer* opt, const ASTNode* stmt, NameSet* writes) {
+    switch (stmt->type) {
+        case AST_ASSIGN: {
+            const ASTNode* target = stmt->data.assign.target;
+            if (target && target->type == AST_ARRAY_ACCESS) target = target->data.array_access.array;
+            if (target && target->type == AST_MEMBER_ACCESS) target = target->data.member_access.object;
+            if (target && target->type == AST_IDENTIFIER) {
+                name_set_add(opt, writes, target->data.identifier.name);
+            }
+            break;
+        }
+        case AST_IF:
+            collect_writes_list(opt, stmt->data.if_stmt.then_branch, writes);
+            collect_writes_list(opt, stmt->data.if_stmt.else_branch, writes);
+            break;
+        case AST_WHILE:
+            collect_writes_list(opt, stmt->data.while_stmt.body, writes);
+            break;
+        case AST_FOR:
+            name_set_add(opt, writes, stmt->data.for_stmt.variable);
+            collect_writes_list(opt, stmt->data.for_stmt.body, writes);
+            break;
+        case AST_REPEAT:
+            collect_writes_list(opt, stmt->data.repeat_stmt.body, writes);
+            break;
+        case AST_CASE:
+            for (int i = 0; i < stmt->data.case_stmt.case_count; i++) {
+                const ASTNode* element = stmt->data.case_stmt.cases[i];
+                if (element && element->type == AST_CASE_ELEMENT) {
+                    collect_writes_list(opt, element->data.case_element.statements, writes);
+                }
+            }
+            collect_writes_list(opt, stmt->data.case_stmt.default_case, writes);
+            break;
+        default:
+            break;
+    }
+}
+
+static void collect_writes_list(Optimizer* opt, const ASTNode* list, NameSet* writes) {
+    for (const ASTNode* stmt = list; stmt; stmt = stmt->next) {
+        collect_writes(opt, stmt, writes);
+    }
+}
+
+static bool list_mentions(const ASTNode* list, const char* name);
+
+/**
+ * @brief 节点（不含其 next）中是否出现名字 name（读或写）
+ */
+static bool node_mentions(const ASTNode* node, const char* name) {
+    if (!node) return false;
+
+    switch (node->type) {
+        case AST_IDENTIFIER:
+            return strcmp(node->data.identifier.name, name) == 0;
+        case AST_BINARY_OP:
+            return node_mentions(node->data.binary_op.left, name) ||
+                   node_mentions(node->data.binary_op.right, name);
+        case AST_UNARY_OP:
+            return node_mentions(node->data.unary_op.operand, name);
+        case AST_FUNCTION_CALL:
+            for (int i = 0; i < node->data.function_call.arg_count; i++) {
+                if (node_mentions(node->data.function_call.arguments[i], name)) return true;
+            }
+            return false;
+        case AST_ARRAY_ACCESS:
+            return node_mentions(node->data.array_access.array, name) ||
+                   node_mentions(node->data.array_access.index, name);
+        case AST_MEMBER_ACCESS:
+            return node_mentions(node->data.member_access.object, name);
+        case AST_CASE_RANGE:
+            return node_mentions(node->data.case_range.low, name) ||
+                   node_mentions(node->data.case_range.high, name);
+        case AST_ASSIGN:
+            return node_mentions(node->data.assign.target, name) ||
+                   node_mentions(node->data.assign.value, name);
+        case AST_IF:
+            return node_mentions(node->data.if_stmt.condition, name) ||
+                   list_mentions(node->data.if_stmt.then_branch, name) ||
+                   list_mentions(node->data.if_stmt.else_branch, name);
+        case AST_WHILE:
+            return node_mentions(node->data.while_stmt.condition, name) ||
+                   list_mentions(node->data.while_stmt.body, name);
+        case AST_FOR:
+            return strcmp(node->data.for_stmt.variable, name) == 0 ||
+                   node_mentions(node->data.for_stmt.start, name) ||
+                   node_mentions(node->data.for_stmt.end, name) ||
+                   node_mentions(node->data.for_stmt.step, name) ||
+                   list_mentions(node->data.for_stmt.body, name);
+        case AST_REPEAT:
+            return list_mentions(node->data.repeat_stmt.body, name) ||
+                   node_mentions(node->data.repeat_stmt.condition, name);
+        case AST_CASE:
+            if (node_mentions(node->data.case_stmt.expression, name)) return true;
+            for (int i = 0; i < node->data.case_stmt.case_count; i++) {
+                const ASTNode* element = node->data.case_stmt.cases[i];
+                if (element && element->type == AST_CASE_ELEMENT &&
+                    (list_mentions(element->data.case_element.labels, name) ||
+                     list_mentions(element->data.case_element.statements, name))) {
+                    return true;
+                }
+            }
+            return list_mentions(node->data.case_stmt.default_case, name);
+        case AST_RETURN:
+            return node_mentions(node->data.return_stmt.value, name);
+        default:
+            return false;
+    }
+}
+
+static bool list_mentions(const ASTNode* list, const char* name) {
+    for (const ASTNode* node = list; node; node = node->next) {
+        if (node_mentions(node, name)) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 表达式是否读取名字 name
+ */
+static bool expr_reads(const ASTNode* expr, const char* name) {
+    return node_mentions(expr, name);
+}
+
+/**
+ * @brief 收集表达式读取的变量名
+ */
+static uint32_t collect_reads_expr(Optimizer* opt, ASTNode* expr, void* data) {
+    NameSet* reads = (NameSet*)data;
+    if (!expr) return 0;
+
+    switch (expr->type) {
+        case AST_IDENTIFIER:
+            name_set_add(opt, reads, expr->data.identifier.name);
+            break;
+        case AST_BINARY_OP:
+            collect_reads_expr(opt, expr->data.binary_op.left, data);
+            collect_reads_expr(opt, expr->data.binary_op.right, data);
+            break;
+        case AST_UNARY_OP:
+            collect_reads_expr(opt, expr->data.unary_op.operand, data);
+            break;
+        case AST_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.arg_count; i++) {
+                collect_reads_expr(opt, expr->data.function_call.arguments[i], data);
+            }
+            break;
+        case AST_ARRAY_ACCESS:
+            collect_reads_expr(opt, expr->data.array_access.array, data);
+            collect_reads_expr(opt, expr->data.array_access.index, data);
+            break;
+        case AST_MEMBER_ACCESS:
+            collect_reads_expr(opt, expr->data.member_access.object, data);
+            break;
+        case AST_CASE_RANGE:
+            collect_reads_expr(opt, expr->data.case_range.low, data);
+            collect_reads_expr(opt, expr->data.case_range.high, data);
+            break;
+        default:
+            break;
+    }
+    return 0;
+}
+
+/**
+ * @brief 收集语句链表读取的变量名（CASE 标签一并计入）
+ */
+static void collect_reads_list(Optimizer* opt, ASTNode* list, NameSet* reads) {
+    visit_stmt_list(opt, list, collect_reads_expr, reads);
+
+    for (ASTNode* stmt = list; stmt; stmt = stmt->next) {
+        if (stmt->type == AST_CASE) {
+            for (int i = 0; i < stmt->data.case_stmt.case_count; i++) {
+                ASTNode* element = stmt->data.case_stmt.cases[i];
+                if (!element || element->type != AST_CASE_ELEMENT) continue;
+                for (ASTNode* label = element->data.case_element.labels; label; label = label->next) {
+                    collect_reads_expr(opt, label, reads);
+                }
+                collect_reads_list(opt, element->data.case_element.statements, reads);
+            }
+            collect_reads_list(opt, stmt->data.case_stmt.default_case, reads);
+        } else if (stmt->type == AST_IF) {
+            collect_reads_list(opt, stmt->data.if_stmt.then_branch, reads);
+            collect_reads_list(opt, stmt->data.if_stmt.else_branch, reads);
+        } else if (stmt->type == AST_WHILE) {
+            collect_reads_list(opt, stmt->data.while_stmt.body, reads);
+        } else if (stmt->type == AST_FOR) {
+            collect_reads_list(opt, stmt->data.for_stmt.body, reads);
+        } else if (stmt->type == AST_REPEAT) {
+            collect_reads_list(opt, stmt->data.repeat_stmt.body, reads);
+        }
+    }
+}
+
+/**
+ * @brief 收集外部 I/O 变量名（读取外部变量有副作用，不能删除）
+ */
+static void collect_externals(Optimizer* opt, ASTNode* program, NameSet* externals) {
+    for (ASTNode* decl = program->data.program.var_decls; decl; decl = decl->next) {
+        if (decl->type == AST_VAR_DECL && decl->data.var_decl.is_external) {
+            name_set_add(opt, externals, decl->data.var_decl.name);
+        }
+    }
+    for (ASTNode* func = program->data.program.functions; func; func = func->next) {
+        if (func->type != AST_FUNCTION_DECL) continue;
+        for (ASTNode* decl = func->data.function_decl.declarations; decl; decl = decl->next) {
+            if (decl->type == AST_VAR_DECL && decl->data.var_decl.is_external) {
+                name_set_add(opt, externals, decl->data.var_decl.name);
+            }
+        }
+    }
+}
+
+/**
+ * @brief 表达式是否无副作用且不会在运行时报错（可以安全删除）
+ */
+static bool expr_is_pure(const ASTNode* expr, const NameSet* externals) {
+    if (!expr) return true;
+
+    switch (expr->type) {
+        case AST_LITERAL:
+            return true;
+        case AST_IDENTIFIER:
+            return name_set_find(externals, expr->data.identifier.name) < 0;
+        case AST_UNARY_OP:
+            return expr_is_pure(expr->data.unary_op.operand, externals);
+        case AST_BINARY_OP: {
+            const ASTNode* right = expr->data.binary_op.right;
+            switch (expr->data.binary_op.op) {
+                case BINOP_EQ: case BINOP_NE: case BINOP_LT:
+                case BINOP_LE: case BINOP_GT: case BINOP_GE:
+                case BINOP_AND: case BINOP_OR: case BINOP_XOR:
+                case BINOP_AND_THEN: case BINOP_OR_ELSE:
+                case BINOP_BIT_AND: case BINOP_BIT_OR: case BINOP_BIT_XOR:
+                    break;
+                case BINOP_SHL: case BINOP_SHR:
+                    // 移位量越界会报错，只接受范围内的常量移位量
+                    if (!right || right->type != AST_LITERAL ||
+                        right->data.literal.value.type != TYPE_INT ||
+                        right->data.literal.value.int_val < 0 ||
+                        right->data.literal.value.int_val >= 32) {
+                        return false;
+                    }
+                    break;
+                default:
+                    // 算术运算可能除零或溢出
+                    return false;
+            }
+            return expr_is_pure(expr->data.binary_op.left, externals) &&
+                   expr_is_pure(right, externals);
+        }
+        default:
+            return false;
+    }
+}
+
+// ============================================================================
+// 常量全局变量传播
+// ============================================================================
+
+/**
+ * @brief 常量绑定：VAR CONSTANT 中初始化为字面量的标量
+ */
+typedef struct {
+    const char* name;
+    Value value;
+} ConstBinding;
+
+typedef struct {
+    ConstBinding* bindings;
+    uint32_t count;
+    const NameSet* shadow;      // 当前函数中遮蔽全局名的参数、局部变量和函数名
+} ConstGlobalsCtx;
+
+static uint32_t subst_const_expr(Optimizer* opt, ASTNode* expr, void* data) {
+    ConstGlobalsCtx* ctx = (ConstGlobalsCtx*)data;
+    if (!expr) return 0;
+
+    uint32_t changes = 0;
+    switch (expr->type) {
+        case AST_IDENTIFIER: {
+            const char* name = expr->data.identifier.name;
+            if (ctx->shadow && name_set_find(ctx->shadow, name) >= 0) break;
+            for (uint32_t i = 0; i < ctx->count; i++) {
+                if (strcmp(ctx->bindings[i].name, name) == 0) {
+                    replace_with_literal(opt, expr, ctx->bindings[i].value);
+                    changes++;
+                    break;
+                }
+            }
+            break;
+        }
+        case AST_BINARY_OP:
+            changes += subst_const_expr(opt, expr->data.binary_op.left, data);
+            changes += subst_const_expr(opt, expr->data.binary_op.right, data);
+            break;
+        case AST_UNARY_OP:
+            changes += subst_const_expr(opt, expr->data.unary_op.operand, data);
+            break;
+        case AST_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.arg_count; i++) {
+                changes += subst_const_expr(opt, expr->data.function_call.arguments[i], data);
+            }
+            break;
+        case AST_ARRAY_ACCESS:
+            changes += subst_const_expr(opt, expr->data.array_access.index, data);
+            break;
+        default:
+            break;
+    }
+    return changes;
+}
+
+/**
+ * @brief 对声明链表中各初始化表达式执行 visit
+ */
+static uint32_t visit_decl_initializers(Optimizer* opt, ASTNode* decls, ExprVisitor visit, void* data) {
+    uint32_t changes = 0;
+    for (ASTNode* decl = decls; decl; decl = decl->next) {
+        if (decl->type == AST_VAR_DECL) {
+            changes += visit(opt, decl->data.var_decl.initializer, data);
+        }
+    }
+    return changes;
+}
+
+/**
+ * @brief 收集函数内遮蔽全局名的名字：参数、局部（含静态）变量和函数名
+ */
+static void collect_function_names(Optimizer* opt, ASTNode* func, NameSet* names) {
+    name_set_add(opt, names, func->data.function_decl.name);
+    for (ASTNode* p = func->data.function_decl.params; p; p = p->next) {
+        if (p->type == AST_VAR_DECL) name_set_add(opt, names, p->data.var_decl.name);
+    }
+    for (ASTNode* d = func->data.function_decl.declarations; d; d = d->next) {
+        if (d->type == AST_VAR_DECL) name_set_add(opt, names, d->data.var_decl.name);
+    }
+}
+
+/**
+ * @brief 把 VAR CONSTANT 全局常量的引用替换为字面量
+ *
+ * 常量全局变量本身仍会分配并初始化（热更新、调试器按名访问），
+ * 只是读取处不再需要 LOAD。程序中任何位置写过的名字都不传播。
+ */
+static uint32_t pass_const_globals(Optimizer* opt, ASTNode* program) {
+    ConstGlobalsCtx ctx;
+    memset(&ctx, 0, sizeof(ctx));
+
+    uint32_t decl_count = 0;
+    for (ASTNode* decl = program->data.program.var_decls; decl; decl = decl->next) {
+        decl_count++;
+    }
+    if (decl_count == 0) return 0;
+
+    NameSet writes;
+    memset(&writes, 0, sizeof(writes));
+    collect_writes_list(opt, program->data.program.body, &writes);
+    for (ASTNode* func = program->data.program.functions; func; func = func->next) {
+        if (func->type == AST_FUNCTION_DECL) {
+            collect_writes_list(opt, func->data.function_decl.body, &writes);
+        }
+    }
+
+    ctx.bindings = (ConstBinding*)mmgr_alloc(sizeof(ConstBinding) * decl_count);
+    if (!ctx.bindings || opt->error_code != OK) {
+        opt->error_code = ERR_OUT_OF_MEMORY;
+        if (ctx.bindings) mmgr_free(ctx.bindings);
+        name_set_free(&writes);
+        return 0;
+    }
+
+    for (ASTNode* decl = program->data.program.var_decls; decl; decl = decl->next) {
+        if (decl->type != AST_VAR_DECL || !decl->data.var_decl.is_const ||
+            decl->data.var_decl.is_external || !decl->data.var_decl.type) {
+            continue;
+        }
+        ASTNode* init = decl->data.var_decl.initializer;
+        // 字面量类型须与声明类型一致（INT 字面量初始化 REAL 常量时由 STORE 存入，不做替换）
+        if (!is_scalar_literal(init) ||
+            init->data.literal.value.type != decl->data.var_decl.type->base_type) {
+            continue;
+        }
+        if (name_set_find(&writes, decl->data.var_decl.name) >= 0) continue;
+
+        ctx.bindings[ctx.count].name = decl->data.var_decl.name;
+        ctx.bindings[ctx.count].value = init->data.literal.value;
+        ctx.count++;
+    }
+    name_set_free(&writes);
+
+    uint32_t changes = 0;
+    if (ctx.count > 0) {
+        changes += visit_decl_initializers(opt, program->data.program.var_decls, subst_const_expr, &ctx);
+        changes += visit_stmt_list(opt, program->data.program.body, subst_const_expr, &ctx);
+
+        for (ASTNode* func = program->data.program.functions; func && opt->error_code == OK; func = func->next) {
+            if (func->type != AST_FUNCTION_DECL) continue;
+            NameSet shadow;
+            memset(&shadow, 0, sizeof(shadow));
+            collect_function_names(opt, func, &shadow);
+            ctx.shadow = &shadow;
+            changes += visit_decl_initializers(opt, func->data.function_decl.declarations, subst_const_expr, &ctx);
+            changes += visit_stmt_list(opt, func->data.function_decl.body, subst_const_expr, &ctx);
+            ctx.shadow = NULL;
+            name_set_free(&shadow);
+        }
+    }
+
+    mmgr_free(ctx.bindings);
+    return changes;
+}
+
+// ============================================================================
+// 常量折叠
+// ============================================================================
+
+/**
+ * @brief 字面量的逻辑值（与 VM 的 AND/OR/XOR 一致：BOOL 或非零 INT）
+ */
+static bool literal_truth(const Value* v, bool* out) {
+    if (v->type == TYPE_BOOL) { *out = v->bool_val; return true; }
+    if (v->type == TYPE_INT)  { *out = v->int_val != 0; return true; }
+    return false;
+}
+
+static double literal_real(const Value* v) {
+    return v->type == TYPE_REAL ? v->real_val : (double)v->int_val;
+}
+
+/**
+ * @brief 折叠两个字面量的二元运算（语义与 VM 一致，运行时会报错的情况不折叠）
+ */
+static bool fold_binary(const ASTNode* node, Value* out) {
+    const Value* a = &node->data.binary_op.left->data.literal.value;
+    const Value* b = &node->data.binary_op.right->data.literal.value;
+    bool ints = a->type == TYPE_INT && b->type == TYPE_INT;
+    bool numeric = (a->type == TYPE_INT || a->type == TYPE_REAL) &&
+                   (b->type == TYPE_INT || b->type == TYPE_REAL);
+
+    switch (node->data.binary_op.op) {
+        case BINOP_ADD:
+        case BINOP_SUB:
+        case BINOP_MUL:
+        case BINOP_DIV: {
+            BinaryOp op = node->data.binary_op.op;
+            if (ints) {
+                int64_t x = a->int_val, y = b->int_val, r;
+                if (op == BINOP_ADD) r = x + y;
+                else if (op == BINOP_SUB) r = x - y;
+                else if (op == BINOP_MUL) r = x * y;
+                else {
+                    if (y == 0) return false;
+                    r = x / y;
+                }
+                if (r < INT32_MIN || r > INT32_MAX) return false;
+                *out = make_int(r);
+                return true;
+            }
+            if (!numeric) return false;
+            double x = literal_real(a), y = literal_real(b), r;
+            if (op == BINOP_ADD) r = x + y;
+            else if (op == BINOP_SUB) r = x - y;
+            else if (op == BINOP_MUL) r = x * y;
+            else {
+                if (y == 0.0) return false;
+                r = x / y;
+            }
+            if (!isfinite(r)) return false;
+            *out = make_real(r);
+            return true;
+        }
+        case BINOP_MOD:
+            if (!ints || b->int_val == 0 || (a->int_val == INT32_MIN && b->int_val == -1)) return false;
+            *out = make_int(a->int_val % b->int_val);
+            return true;
+
+        case BINOP_EQ: case BINOP_NE: case BINOP_LT:
+        case BINOP_LE: case BINOP_GT: case BINOP_GE: {
+            if (!numeric) return false;
+            int cmp;
+            if (ints) {
+                cmp = (a->int_val > b->int_val) - (a->int_val < b->int_val);
+            } else {
+                double x = literal_real(a), y = literal_real(b);
+                if (isnan(x) || isnan(y)) return false;
+                cmp = (x > y) - (x < y);
+            }
+            bool r;
+            switch (node->data.binary_op.op) {
+                case BINOP_EQ: r = cmp == 0; break;
+                case BINOP_NE: r = cmp != 0; break;
+                case BINOP_LT: r = cmp < 0;  break;
+                case BINOP_LE: r = cmp <= 0; break;
+                case BINOP_GT: r = cmp > 0;  break;
+                default:       r = cmp >= 0; break;
+            }
+            *out = make_bool(r);
+            return true;
+        }
+
+        case BINOP_AND:
+        case BINOP_OR:
+        case BINOP_XOR: {
+            BinaryOp op = node->data.binary_op.op;
+            if (has_int_result(node)) {
+                // 与代码生成一致：整数结果类型使用位运算
+                if (!ints) return false;
+                int32_t r = op == BINOP_AND ? (a->int_val & b->int_val)
+                          : op == BINOP_OR  ? (a->int_val | b->int_val)
+                          : (a->int_val ^ b->int_val);
+                *out = make_int(r);
+                return true;
+            }
+            bool x, y;
+            if (!literal_truth(a, &x) || !literal_truth(b, &y)) return false;
+            *out = make_bool(op == BINOP_AND ? (x && y) : op == BINOP_OR ? (x || y) : (x != y));
+            return true;
+        }
+
+        case BINOP_AND_THEN:
+        case BINOP_OR_ELSE: {
+            bool x, y;
+            if (!literal_truth(a, &x) || !literal_truth(b, &y)) return false;
+            *out = make_bool(node->data.binary_op.op == BINOP_AND_THEN ? (x && y) : (x || y));
+            return true;
+        }
+
+        case BINOP_BIT_AND:
+            if (!ints) return false;
+            *out = make_int(a->int_val & b->int_val);
+            return true;
+        case BINOP_BIT_OR:
+            if (!ints) return false;
+            *out = make_int(a->int_val | b->int_val);
+            return true;
+        case BINOP_BIT_XOR:
+            if (!ints) return false;
+            *out = make_int(a->int_val ^ b->int_val);
+            return true;
+
+        case BINOP_SHL:
+        case BINOP_SHR:
+            if (!ints || b->int_val < 0 || b->int_val >= 32) return false;
+            if (node->data.binary_op.op == BINOP_SHL) {
+                *out = make_int((int32_t)((uint32_t)a->int_val << b->int_val));
+            } else {
+                *out = make_int(a->int_val >> b->int_val);
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 折叠字面量的一元运算
+ */
+static bool fold_unary(const ASTNode* node, Value* out) {
+    const Value* v = &node->data.unary_op.operand->data.literal.value;
+
+    switch (node->data.unary_op.op) {
+        case UNOP_NEG:
+            if (v->type == TYPE_INT) {
+                if (v->int_val == INT32_MIN) return false;
+                *out = make_int(-(int64_t)v->int_val);
+                return true;
+            }
+            if (v->type == TYPE_REAL) {
+                *out = make_real(-v->real_val);
+                return true;
+            }
+            return false;
+        case UNOP_NOT:
+            if (has_int_result(node)) {
+                if (v->type != TYPE_INT) return false;
+                *out = make_int(~v->int_val);
+                return true;
+            }
+            if (v->type != TYPE_BOOL) return false;
+            *out = make_bool(!v->bool_val);
+            return true;
+        case UNOP_BIT_NOT:
+            if (v->type != TYPE_INT) return false;
+            *out = make_int(~v->int_val);
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 左操作数为常量且已决定结果的短路运算（FALSE AND_THEN x、TRUE OR_ELSE x）
+ */
+static bool fold_short_circuit(const ASTNode* node, Value* out) {
+    BinaryOp op = node->data.binary_op.op;
+    if (op != BINOP_AND_THEN && op != BINOP_OR_ELSE) return false;
+    if (!is_scalar_literal(node->data.binary_op.left)) return false;
+
+    bool x;
+    if (!literal_truth(&node->data.binary_op.left->data.literal.value, &x)) return false;
+    if (x != (op == BINOP_OR_ELSE)) return false;
+    *out = make_bool(x);
+    return true;
+}
+
+static uint32_t fold_expr(Optimizer* opt, ASTNode* expr, void* data) {
+    if (!expr) return 0;
+
+    uint32_t changes = 0;
+    Value result;
+    switch (expr->type) {
+        case AST_BINARY_OP:
+            changes += fold_expr(opt, expr->data.binary_op.left, data);
+            changes += fold_expr(opt, expr->data.binary_op.right, data);
+            if (is_scalar_literal(expr->data.binary_op.left) &&
+                is_scalar_literal(expr->data.binary_op.right) &&
+                fold_binary(expr, &result)) {
+                replace_with_literal(opt, expr, result);
+                changes++;
+            } else if (fold_short_circuit(expr, &result)) {
+                // 右操作数按语义不会被计算，连同副作用一起删除
+                replace_with_literal(opt, expr, result);
+                changes++;
+            }
+            break;
+        case AST_UNARY_OP:
+            changes += fold_expr(opt, expr->data.unary_op.operand, data);
+            if (is_scalar_literal(expr->data.unary_op.operand) && fold_unary(expr, &result)) {
+                replace_with_literal(opt, expr, result);
+                changes++;
+            }
+            break;
+        case AST_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.arg_count; i++) {
+                changes += fold_expr(opt, expr->data.function_call.arguments[i], data);
+            }
+            break;
+        case AST_ARRAY_ACCESS:
+            changes += fold_expr(opt, expr->data.array_access.index, data);
+            break;
+        default:
+            break;
+    }
+    return changes;
+}
+
+/**
+ * @brief 折叠全程序（含变量初始化表达式）中的常量表达式
+ */
+static uint32_t pass_const_fold(Optimizer* opt, ASTNode* program) {
+    uint32_t changes = 0;
+    changes += visit_decl_initializers(opt, program->data.program.var_decls, fold_expr, NULL);
+    changes += visit_stmt_list(opt, program->data.program.body, fold_expr, NULL);
+
+    for (ASTNode* func = program->data.program.functions; func; func = func->next) {
+        if (func->type != AST_FUNCTION_DECL) continue;
+        changes += visit_decl_initializers(opt, func->data.function_decl.declarations, fold_expr, NULL);
+        changes += visit_stmt_list(opt, func->data.function_decl.body, fold_expr, NULL);
+    }
+    return changes;
+}
+
+// ============================================================================
+// 代数化简与强度削弱
+// ============================================================================
+
+/**
+ * @brief 代数化简的作用域：标识符按参数、局部变量、返回值变量、全局变量的顺序查找类型
+ */
+typedef struct {
+    const ASTNode* globals;     // 程序的变量声明
+    const ASTNode* func;        // 当前函数（主程序为 NULL）
+} AlgebraCtx;
+
+static DataType decl_list_type(const ASTNode* decls, const char* name) {
+    for (const ASTNode* d = decls; d; d = d->next) {
+        if (d->type == AST_VAR_DECL && d->data.var_decl.type &&
+            strcmp(d->data.var_decl.name, name) == 0) {
+            return d->data.var_decl.type->base_type;
+        }
+    }
+    return TYPE_VOID;
+}
+
+/**
+ * @brief 表达式的静态类型（未知时返回 TYPE_VOID）
+ *
+ * 类型检查只给运算节点设置 resolved_type，标识符按声明查找。
+ */
+static DataType algebra_type(const AlgebraCtx* ctx, const ASTNode* expr) {
+    switch (expr->type) {
+        case AST_LITERAL:
+            return expr->data.literal.value.type;
+        case AST_BINARY_OP:
+        case AST_UNARY_OP:
+            return expr->resolved_type ? expr->resolved_type->base_type : TYPE_VOID;
+        case AST_IDENTIFIER: {
+            const char* name = expr->data.identifier.name;
+            DataType type = TYPE_VOID;
+            if (ctx->func) {
+                type = decl_list_type(ctx->func->data.function_decl.params, name);
+                if (type == TYPE_VOID) {
+                    type = decl_list_type(ctx->func->data.function_decl.declarations, name);
+                }
+                if (type == TYPE_VOID && ctx->func->data.function_decl.return_type &&
+                    strcmp(ctx->func->data.function_decl.name, name) == 0) {
+                    type = ctx->func->data.function_decl.return_type->base_type;
+                }
+            }
+            return type != TYPE_VOID ? type : decl_list_type(ctx->globals, name);
+        }
+        default:
+            return TYPE_VOID;
+    }
+}
+
+/**
+ * @brief INT 表达式的取值区间
+ *
+ * 字面量、对正常量取 MOD、与非负数按位与、常量右移以及不会溢出的 + - * NEG
+ * 按区间推导，其余取整个 INT 范围。
+ *
+ * @return 表达式不是 INT 类型时返回 false
+ */
+static bool algebra_range(const AlgebraCtx* ctx, const ASTNode* expr, int64_t* lo, int64_t* hi) {
+    if (algebra_type(ctx, expr) != TYPE_INT) return false;
+    *lo = INT32_MIN;
+    *hi = INT32_MAX;
+
+    int64_t l0, l1, r0, r1;
+    if (expr->type == AST_LITERAL) {
+        *lo = *hi = expr->data.literal.value.int_val;
+    } else if (expr->type == AST_UNARY_OP) {
+        if (expr->data.unary_op.op == UNOP_NEG &&
+            algebra_range(ctx, expr->data.unary_op.operand, &l0, &l1) && l0 > INT32_MIN) {
+            *lo = -l1;
+            *hi = -l0;
+        }
+    } else if (expr->type == AST_BINARY_OP &&
+               algebra_range(ctx, expr->data.binary_op.left, &l0, &l1) &&
+               algebra_range(ctx, expr->data.binary_op.right, &r0, &r1)) {
+        int64_t a, b;
+        switch (expr->data.binary_op.op) {
+            case BINOP_ADD:
+            case BINOP_SUB:
+            case BINOP_MUL:
+                if (expr->data.binary_op.op == BINOP_ADD) {
+                    a = l0 + r0;
+                    b = l1 + r1;
+                } else if (expr->data.binary_op.op == BINOP_SUB) {
+                    a = l0 - r1;
+                    b = l1 - r0;
+                } else {
+                    int64_t p[4] = { l0 * r0, l0 * r1, l1 * r0, l1 * r1 };
+                    a = b = p[0];
+                    for (int i = 1; i < 4; i++) {
+                        if (p[i] < a) a = p[i];
+                        if (p[i] > b) b = p[i];
+                    }
+                }
+                if (a >= INT32_MIN && b <= INT32_MAX) {
+                    *lo = a;
+                    *hi = b;
+                }
+                break;
+            case BINOP_MOD:
+                // 余数与被除数同号，绝对值小于除数
+                if (r0 == r1 && r0 > 0) {
+                    *lo = l0 >= 0 ? 0 : (l0 > 1 - r0 ? l0 : 1 - r0);
+                    *hi = l1 <= 0 ? 0 : (l1 < r0 - 1 ? l1 : r0 - 1);
+                }
+                break;
+            case BINOP_AND:
+            case BINOP_BIT_AND:
+                if (l0 >= 0 || r0 >= 0) {
+                    *lo = 0;
+                    *hi = (l0 >= 0 && r0 >= 0) ? (l1 < r1 ? l1 : r1) : (l0 >= 0 ? l1 : r1);
+                }
+                break;
+            case BINOP_SHR:
+                if (r0 == r1 && r0 >= 0 && r0 < 32) {
+                    *lo = l0 >> r0;
+                    *hi = l1 >> r0;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+static bool is_int_literal(const ASTNode* node, int32_t value) {
+    return node->type == AST_LITERAL && node->data.literal.value.type == TYPE_INT &&
+           node->data.literal.value.int_val == value;
+}
+
+/**
+ * @brief INT 字面量为 2 的 k 次幂（k >= 1）时返回 k，否则返回 -1
+ */
+static int32_t literal_log2(const ASTNode* node) {
+    if (node->type != AST_LITERAL || node->data.literal.value.type != TYPE_INT) return -1;
+    int32_t v = node->data.literal.value.int_val;
+    if (v < 2 || (v & (v - 1)) != 0) return -1;
+
+    int32_t k = 0;
+    while ((1 << k) != v) k++;
+    return k;
+}
+
+/**
+ * @brief 把表达式节点原地改写为其子树 keep（其余子节点挂入回收链表）
+ *
+ * keep 的内容移入 node，node 保留在父节点中的位置和 resolved_type；
+ * keep 的空壳随原来的子节点一起回收。
+ */
+static void replace_with_subtree(Optimizer* opt, ASTNode* node, ASTNode* keep) {
+    ASTNodeType type = keep->type;
+    ASTNodeData data = keep->data;
+    memset(&keep->data, 0, sizeof(keep->data));
+    keep->type = AST_LITERAL;
+
+    if (node->type == AST_BINARY_OP) {
+        bury_node(opt, node->data.binary_op.left);
+        bury_node(opt, node->data.binary_op.right);
+    } else if (node->type == AST_UNARY_OP) {
+        bury_node(opt, node->data.unary_op.operand);
+    }
+    node->type = type;
+    node->data = data;
+}
+
+/**
+ * @brief 比较运算取反（NOT (a < b) 即 a >= b）
+ */
+static BinaryOp invert_comparison(BinaryOp op) {
+    switch (op) {
+        case BINOP_EQ: return BINOP_NE;
+        case BINOP_NE: return BINOP_EQ;
+        case BINOP_LT: return BINOP_GE;
+        case BINOP_LE: return BINOP_GT;
+        case BINOP_GT: return BINOP_LE;
+        default:       return BINOP_LT;
+    }
+}
+
+/**
+ * @brief 一元运算：双重取负/取反消去，NOT 比较改为相反的比较
+ */
+static bool algebra_unary(Optimizer* opt, const AlgebraCtx* ctx, ASTNode* expr) {
+    UnaryOp op = expr->data.unary_op.op;
+    ASTNode* inner = expr->data.unary_op.operand;
+    DataType type = algebra_type(ctx, expr);
+
+    if (inner->type == AST_UNARY_OP) {
+        ASTNode* x = inner->data.unary_op.operand;
+        UnaryOp inner_op = inner->data.unary_op.op;
+        // -(-x)：NEG 不检查溢出，两次取负还原原值
+        bool negations = op == UNOP_NEG && inner_op == UNOP_NEG;
+        // NOT NOT b、~~x：BOOL 为逻辑非，INT 的 NOT 与 ~ 都是按位取反
+        bool inversions = op != UNOP_NEG && inner_op != UNOP_NEG &&
+                          (type == TYPE_BOOL || type == TYPE_INT) &&
+                          algebra_type(ctx, inner) == type && algebra_type(ctx, x) == type;
+        if (negations || inversions) {
+            replace_with_subtree(opt, expr, x);
+            return true;
+        }
+    }
+
+    if (op == UNOP_NOT && type == TYPE_BOOL && inner->type == AST_BINARY_OP) {
+        BinaryOp cmp = inner->data.binary_op.op;
+        if (cmp < BINOP_EQ || cmp > BINOP_GE) return false;
+        // 有序比较只对 INT 取反：REAL 的 NaN 使 NOT (a < b) 与 a >= b 不同
+        bool ordered = cmp != BINOP_EQ && cmp != BINOP_NE;
+        if (ordered && (algebra_type(ctx, inner->data.binary_op.left) != TYPE_INT ||
+                        algebra_type(ctx, inner->data.binary_op.right) != TYPE_INT)) {
+            return false;
+        }
+        inner->data.binary_op.op = invert_comparison(cmp);
+        replace_with_subtree(opt, expr, inner);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief 二元运算：恒等运算消去、强度削弱、与 BOOL 常量比较、REAL 除以常量
+ */
+static bool algebra_binary(Optimizer* opt, const AlgebraCtx* ctx, ASTNode* expr) {
+    BinaryOp op = expr->data.binary_op.op;
+    ASTNode* left = expr->data.binary_op.left;
+    ASTNode* right = expr->data.binary_op.right;
+    DataType type = algebra_type(ctx, expr);
+
+    if (type == TYPE_INT) {
+        // x + 0、0 + x、x - 0、x * 1、1 * x、x / 1：结果就是 x，且这些运算不会溢出
+        if (((op == BINOP_ADD || op == BINOP_SUB) && is_int_literal(right, 0)) ||
+            ((op == BINOP_MUL || op == BINOP_DIV) && is_int_literal(right, 1))) {
+            replace_with_subtree(opt, expr, left);
+            return true;
+        }
+        if ((op == BINOP_ADD && is_int_literal(left, 0)) ||
+            (op == BINOP_MUL && is_int_literal(left, 1))) {
+            replace_with_subtree(opt, expr, right);
+            return true;
+        }
+
+        // 乘除 2 的幂改为移位：MUL 溢出会报错、DIV/MOD 向零取整，
+        // 只有被乘数区间不会溢出、被除数非负时移位与原运算结果相同
+        ASTNode* x = left;
+        ASTNode* lit = right;
+        if (op == BINOP_MUL && literal_log2(left) > 0) {
+            x = right;
+            lit = left;
+        }
+        int32_t k = literal_log2(lit);
+        int64_t lo, hi;
+        if (k < 0 || !algebra_range(ctx, x, &lo, &hi)) return false;
+
+        Value* v = &lit->data.literal.value;
+        if (op == BINOP_MUL && lo * v->int_val >= INT32_MIN && hi * v->int_val <= INT32_MAX) {
+            expr->data.binary_op.op = BINOP_SHL;
+            expr->data.binary_op.left = x;
+            expr->data.binary_op.right = lit;
+            v->int_val = k;
+            return true;
+        }
+        if (op == BINOP_DIV && lo >= 0) {
+            expr->data.binary_op.op = BINOP_SHR;
+            v->int_val = k;
+            return true;
+        }
+        if (op == BINOP_MOD && lo >= 0) {
+            expr->data.binary_op.op = BINOP_BIT_AND;
+            v->int_val = v->int_val - 1;
+            return true;
+        }
+        return false;
+    }
+
+    if (type == TYPE_BOOL && (op == BINOP_EQ || op == BINOP_NE)) {
+        // b = TRUE、b <> FALSE 即 b；b = FALSE、b <> TRUE 即 NOT b
+        ASTNode* lit = right;
+        ASTNode* x = left;
+        if (left->type == AST_LITERAL) {
+            lit = left;
+            x = right;
+        }
+        if (lit->type != AST_LITERAL || lit->data.literal.value.type != TYPE_BOOL ||
+            algebra_type(ctx, x) != TYPE_BOOL) {
+            return false;
+        }
+        if (lit->data.literal.value.bool_val == (op == BINOP_EQ)) {
+            replace_with_subtree(opt, expr, x);
+        } else {
+            bury_node(opt, lit);
+            memset(&expr->data, 0, sizeof(expr->data));
+            expr->type = AST_UNARY_OP;
+            expr->data.unary_op.op = UNOP_NOT;
+            expr->data.unary_op.operand = x;
+        }
+        return true;
+    }
+
+    if (type == TYPE_REAL && op == BINOP_DIV && right->type == AST_LITERAL &&
+        right->data.literal.value.type == TYPE_REAL) {
+        // 除以 ±2 的幂：倒数可精确表示，x * (1/c) 与 x / c 舍入结果相同
+        double c = right->data.literal.value.real_val;
+        int exponent;
+        if (!isfinite(c) || fabs(frexp(c, &exponent)) != 0.5) return false;
+        double inverse = 1.0 / c;
+        if (!isnormal(inverse)) return false;
+        expr->data.binary_op.op = BINOP_MUL;
+        right->data.literal.value.real_val = inverse;
+        return true;
+    }
+    return false;
+}
+
+static uint32_t algebra_expr(Optimizer* opt, ASTNode* expr, void* data) {
+    if (!expr) return 0;
+
+    const AlgebraCtx* ctx = (const AlgebraCtx*)data;
+    uint32_t changes = 0;
+    switch (expr->type) {
+        case AST_BINARY_OP:
+            changes += algebra_expr(opt, expr->data.binary_op.left, data);
+            changes += algebra_expr(opt, expr->data.binary_op.right, data);
+            break;
+        case AST_UNARY_OP:
+            changes += algebra_expr(opt, expr->data.unary_op.operand, data);
+            break;
+        case AST_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.arg_count; i++) {
+                changes += algebra_expr(opt, expr->data.function_call.arguments[i], data);
+            }
+            return changes;
+        case AST_ARRAY_ACCESS:
+            return changes + algebra_expr(opt, expr->data.array_access.index, data);
+        default:
+            return 0;
+    }
+
+    // 改写后的节点可能再次适用（如 NOT (b = FALSE) -> NOT NOT b -> b）
+    for (;;) {
+        bool rewritten = false;
+        if (expr->type == AST_BINARY_OP) {
+            rewritten = algebra_binary(opt, ctx, expr);
+        } else if (expr->type == AST_UNARY_OP) {
+            rewritten = algebra_unary(opt, ctx, expr);
+        }
+        if (!rewritten) break;
+        changes++;
+    }
+    return changes;
+}
+
+/**
+ * @brief 对类型检查后的表达式做代数化简和强度削弱
+ *
+ * 只做结果与运行时错误都不变的改写：INT 的恒等运算不会溢出，移位只用于
+ * 区间分析证明等价的乘除，REAL 只把除以 2 的幂改为乘法（NaN/Inf 检查不变）。
+ */
+static uint32_t pass_algebraic(Optimizer* opt, ASTNode* program) {
+    AlgebraCtx ctx = { .globals = program->data.program.var_decls, .func = NULL };
+    uint32_t changes = visit_stmt_list(opt, program->data.program.body, algebra_expr, &ctx);
+
+    for (ASTNode* func = program->data.program.functions; func; func = func->next) {
+        if (func->type != AST_FUNCTION_DECL) continue;
+        ctx.func = func;
+        changes += visit_stmt_list(opt, func->data.function_decl.body, algebra_expr, &ctx);
+    }
+    return changes;
+}
+
+// ============================================================================
+// 函数局部变量：复写传播与死存储消除
+// ============================================================================
+
+/**
+ * @brief 函数中可跟踪的局部变量：标量参数和非静态、非外部的标量局部变量
+ *
+ * 局部变量只能被本函数修改（被调函数、强制、热更新都作用于全局区），
+ * 因此顺序代码中的值可以静态推断。函数名（返回值变量）不跟踪。
+ */
+typedef struct {
+    NameSet names;
+    DataType* types;
+    uint32_t param_count;       // names 中前 param_count 个是参数
+} LocalVars;
+
+static void add_local(Optimizer* opt, LocalVars* locals, ASTNode* decl, const char* func_name, bool is_param) {
+    if (decl->type != AST_VAR_DECL || !decl->data.var_decl.type) return;
+    // 参数与 VAR 块共用声明规则，is_global 对参数无意义
+    if ((!is_param && decl->data.var_decl.is_global) || decl->data.var_decl.is_external) return;
+
+    DataType type = decl->data.var_decl.type->base_type;
+    const char* name = decl->data.var_decl.name;
+    if (!is_scalar_type(type) || strcmp(name, func_name) == 0) return;
+    if (name_set_find(&locals->names, name) >= 0) return;
+
+    name_set_add(opt, &locals->names, name);
+    if (opt->error_code != OK) return;
+
+    DataType* types = (DataType*)mmgr_realloc(locals->types, sizeof(DataType) * locals->names.capacity);
+    if (!types) {
+        opt->error_code = ERR_OUT_OF_MEMORY;
+        return;
+    }
+    locals->types = types;
+    locals->types[locals->names.count - 1] = type;
+}
+
+static void collect_locals(Optimizer* opt, ASTNode* func, LocalVars* locals) {
+    memset(locals, 0, sizeof(*locals));
+    const char* func_name = func->data.function_decl.name;
+
+    for (ASTNode* p = func->data.function_decl.params; p; p = p->next) {
+        add_local(opt, locals, p, func_name, true);
+    }
+    locals->param_count = locals->names.count;
+    for (ASTNode* d = func->data.function_decl.declarations; d; d = d->next) {
+        add_local(opt, locals, d, func_name, false);
+    }
+}
+
+static void free_locals(LocalVars* locals) {
+    name_set_free(&locals->names);
+    if (locals->types) mmgr_free(locals->types);
+    locals->types = NULL;
+}
+
+/**
+ * @brief 局部变量在某一程序点的已知值
+ */
+typedef enum {
+    FACT_NONE,          // 未知
+    FACT_LITERAL,       // 等于字面量
+    FACT_COPY           // 等于另一个局部变量
+} FactKind;
+
+typedef struct {
+    FactKind kind;
+    Value value;        // FACT_LITERAL
+    uint32_t source;    // FACT_COPY：源变量下标
+} Fact;
+
+typedef struct {
+    Optimizer* opt;
+    LocalVars* locals;
+} CopyPropCtx;
+
+static uint32_t copy_prop_expr(CopyPropCtx* ctx, ASTNode* expr, const Fact* facts) {
+    if (!expr) return 0;
+
+    uint32_t changes = 0;
+    switch (expr->type) {
+        case AST_IDENTIFIER: {
+            int32_t idx = name_set_find(&ctx->locals->names, expr->data.identifier.name);
+            if (idx < 0) break;
+            const Fact* fact = &facts[idx];
+            if (fact->kind == FACT_LITERAL) {
+                replace_with_literal(ctx->opt, expr, fact->value);
+                changes++;
+            } else if (fact->kind == FACT_COPY) {
+                char* name = mmgr_strdup(ctx->locals->names.names[fact->source]);
+                if (!name) {
+                    ctx->opt->error_code = ERR_OUT_OF_MEMORY;
+                    break;
+                }
+                mmgr_free(expr->data.identifier.name);
+                expr->data.identifier.name = name;
+                changes++;
+            }
+            break;
+        }
+        case AST_BINARY_OP:
+            changes += copy_prop_expr(ctx, expr->data.binary_op.left, facts);
+            changes += copy_prop_expr(ctx, expr->data.binary_op.right, facts);
+            break;
+        case AST_UNARY_OP:
+            changes += copy_prop_expr(ctx, expr->data.unary_op.operand, facts);
+            break;
+        case AST_FUNCTION_CALL:
+            for (int i = 0; i < expr->data.function_call.arg_count; i++) {
+                changes += copy_prop_expr(ctx, expr->data.function_call.arguments[i], facts);
+            }
+            break;
+        case AST_ARRAY_ACCESS:
+            changes += copy_prop_expr(ctx, expr->data.array_access.index, facts);
+            break;
+        default:
+            break;
+    }
+    return changes;
+}
+
+/**
+ * @brief 变量 idx 被写入：清除它的值以及以它为源的复写
+ */
+static void fact_kill(CopyPropCtx* ctx, Fact* facts, uint32_t idx) {
+    facts[idx].kind = FACT_NONE;
+    for (uint32_t i = 0; i < ctx->locals->names.count; i++) {
+        if (facts[i].kind == FACT_COPY && facts[i].source == idx) {
+            facts[i].kind = FACT_NONE;
+        }
+    }
+}
+
+/**
+ * @brief 清除语句中（含嵌套）写入的所有变量的已知值
+ */
+static void fact_kill_writes(CopyPropCtx* ctx, Fact* facts, const ASTNode* stmt) {
+    NameSet writes;
+    memset(&writes, 0, sizeof(writes));
+    collect_writes(ctx->opt, stmt, &writes);
+    for (uint32_t i = 0; i < writes.count; i++) {
+        int32_t idx = name_set_find(&ctx->locals->names, writes.names[i]);
+        if (idx >= 0) fact_kill(ctx, facts, (uint32_t)idx);
+    }
+    name_set_free(&writes);
+}
+
+static void fact_clear(CopyPropCtx* ctx, Fact* facts) {
+    for (uint32_t i = 0; i < ctx->locals->names.count; i++) {
+        facts[i].kind = FACT_NONE;
+    }
+}
+
+static uint32_t copy_prop_list(CopyPropCtx* ctx, ASTNode* list, const Fact* entry);
+
+/**
+ * @brief 以 facts 的副本处理嵌套语句链表
+ */
+static uint32_t copy_prop_nested(CopyPropCtx* ctx, ASTNode* list, const Fact* facts) {
+    return list ? copy_prop_list(ctx, list, facts) : 0;
+}
+
+/**
+ * @brief 沿语句链表顺序传播局部变量的已知值
+ *
+ * 分支以入口处的已知值分别处理，汇合后清除分支内写过的变量；
+ * 循环先清除循环内写过的变量，剩下的已知值在整个循环中都成立。
+ */
+static uint32_t copy_prop_list(CopyPropCtx* ctx, ASTNode* list, const Fact* entry) {
+    uint32_t count = ctx->locals->names.count;
+    Fact* facts = (Fact*)mmgr_alloc(sizeof(Fact) * count);
+    if (!facts) {
+        ctx->opt->error_code = ERR_OUT_OF_MEMORY;
+        return 0;
+    }
+    memcpy(facts, entry, sizeof(Fact) * count);
+
+    uint32_t changes = 0;
+    for (ASTNode* stmt = list; stmt && ctx->opt->error_code == OK; stmt = stmt->next) {
+        switch (stmt->type) {
+            case AST_ASSIGN: {
+                ASTNode* target = stmt->data.assign.target;
+                ASTNode* value = stmt->data.assign.value;
+                if (target && target->type == AST_ARRAY_ACCESS) {
+                    changes += copy_prop_expr(ctx, target->data.array_access.index, facts);
+                }
+                changes += copy_prop_expr(ctx, value, facts);
+
+                if (!target || target->type != AST_IDENTIFIER) break;
+                int32_t idx = name_set_find(&ctx->locals->names, target->data.identifier.name);
+                if (idx < 0) break;
+                fact_kill(ctx, facts, (uint32_t)idx);
+
+                DataType type = ctx->locals->types[idx];
+                if (is_scalar_literal(value) && value->data.literal.value.type == type) {
+                    facts[idx].kind = FACT_LITERAL;
+                    facts[idx].value = value->data.literal.value;
+                } else if (value && value->type == AST_IDENTIFIER) {
+                    int32_t src = name_set_find(&ctx->locals->names, value->data.identifier.name);
+                    if (src >= 0 && src != idx && ctx->locals->types[src] == type) {
+                        facts[idx].kind = FACT_COPY;
+                        facts[idx].source = (uint32_t)src;
+                    }
+                }
+                break;
+            }
+            case AST_IF:
+                changes += copy_prop_expr(ctx, stmt->data.if_stmt.condition, facts);
+                changes += copy_prop_nested(ctx, stmt->data.if_stmt.then_branch, facts);
+                changes += copy_prop_nested(ctx, stmt->data.if_stmt.else_branch, facts);
+                fact_kill_writes(ctx, facts, stmt);
+                break;
+            case AST_CASE:
+                changes += copy_prop_expr(ctx, stmt->data.case_stmt.expression, facts);
+                for (int i = 0; i < stmt->data.case_stmt.case_count; i++) {
+                    ASTNode* element = stmt->data.case_stmt.cases[i];
+                    if (element && element->type == AST_CASE_ELEMENT) {
+                        changes += copy_prop_nested(ctx, element->data.case_element.statements, facts);
+                    }
+                }
+                changes += copy_prop_nested(ctx, stmt->data.case_stmt.default_case, facts);
+                fact_kill_writes(ctx, facts, stmt);
+                break;
+            case AST_WHILE:
+                fact_kill_writes(ctx, facts, stmt);
+                changes += copy_prop_expr(ctx, stmt->data.while_stmt.condition, facts);
+                changes += copy_prop_nested(ctx, stmt->data.while_stmt.body, facts);
+                break;
+            case AST_REPEAT:
+                fact_kill_writes(ctx, facts, stmt);
+                changes += copy_prop_nested(ctx, stmt->data.repeat_stmt.body, facts);
+                changes += copy_prop_expr(ctx, stmt->data.repeat_stmt.condition, facts);
+                break;
+            case AST_FOR:
+                fact_kill_writes(ctx, facts, stmt);
+                changes += copy_prop_expr(ctx, stmt->data.for_stmt.start, facts);
+                changes += copy_prop_expr(ctx, stmt->data.for_stmt.end, facts);
+                changes += copy_prop_expr(ctx, stmt->data.for_stmt.step, facts);
+                changes += copy_prop_nested(ctx, stmt->data.for_stmt.body, facts);
+                break;
+            case AST_RETURN:
+                changes += copy_prop_expr(ctx, stmt->data.return_stmt.value, facts);
+                break;
+            case AST_FUNCTION_CALL:
+                changes += copy_prop_expr(ctx, stmt, facts);
+                break;
+            default:
+                // AST_BLOCK 等结构不做推断
+                fact_clear(ctx, facts);
+                break;
+        }
+    }
+
+    mmgr_free(facts);
+    return changes;
+}
+
+/**
+ * @brief 函数入口处局部变量的已知值：字面量初始化或默认值（代码生成在入口处存入）
+ */
+static void copy_prop_entry_facts(ASTNode* func, LocalVars* locals, Fact* facts) {
+    memset(facts, 0, sizeof(Fact) * locals->names.count);
+
+    for (ASTNode* d = func->data.function_decl.declarations; d; d = d->next) {
+        if (d->type != AST_VAR_DECL) continue;
+        int32_t idx = name_set_find(&locals->names, d->data.var_decl.name);
+        if (idx < (int32_t)locals->param_count) continue;
+
+        DataType type = locals->types[idx];
+        ASTNode* init = d->data.var_decl.initializer;
+        if (!init) {
+            facts[idx].kind = FACT_LITERAL;
+            facts[idx].value = type == TYPE_INT  ? make_int(0)
+                             : type == TYPE_REAL ? make_real(0.0)
+                             : make_bool(false);
+        } else if (is_scalar_literal(init) && init->data.literal.value.type == type) {
+            facts[idx].kind = FACT_LITERAL;
+            facts[idx].value = init->data.literal.value;
+        }
+    }
+}
+
+static uint32_t pass_copy_prop(Optimizer* opt, ASTNode* program) {
+    uint32_t changes = 0;
+
+    for (ASTNode* func = program->data.program.functions; func && opt->error_code == OK; func = func->next) {
+        if (func->type != AST_FUNCTION_DECL || !func->data.function_decl.body) continue;
+
+        LocalVars locals;
+        collect_locals(opt, func, &locals);
+        if (opt->error_code == OK && locals.names.count > 0) {
+            Fact* facts = (Fact*)mmgr_alloc(sizeof(Fact) * locals.names.count);
+            if (!facts) {
+                opt->error_code = ERR_OUT_OF_MEMORY;
+            } else {
+                copy_prop_entry_facts(func, &locals, facts);
+                CopyPropCtx ctx = { opt, &locals };
+                changes += copy_prop_list(&ctx, func->data.function_decl.body, facts);
+                mmgr_free(facts);
+            }
+        }
+        free_locals(&locals);
+    }
+    return changes;
+}
+
+typedef struct {
+    LocalVars* locals;
+    NameSet* reads;             // 函数中读取过的名字
+    NameSet* externals;
+} DeadStoreCtx;
+
+/**
+ * @brief 赋值语句是否是对可跟踪局部变量的无副作用存储，是则返回变量名
+ */
+static const char* pure_local_store(const DeadStoreCtx* ctx, const ASTNode* stmt) {
+    if (stmt->type != AST_ASSIGN) return NULL;
+    const ASTNode* target = stmt->data.assign.target;
+    if (!target || target->type != AST_IDENTIFIER) return NULL;
+    if (name_set_find(&ctx->locals->names, target->data.identifier.name) < 0) return NULL;
+    if (!expr_is_pure(stmt->data.assign.value, ctx->externals)) return NULL;
+    return target->data.identifier.name;
+}
+
+/**
+ * @brief 判断存储是否在被读取之前就被覆盖或函数已返回
+ *
+ * 只沿同一语句链表向后查找；到达函数体末尾视为函数返回。
+ */
+static bool store_is_overwritten(const ASTNode* store, const char* name, bool top_level) {
+    for (const ASTNode* next = store->next; next; next = next->next) {
+        if (next->type == AST_ASSIGN) {
+            const ASTNode* target = next->data.assign.target;
+            if (expr_reads(next->data.assign.value, name)) return false;
+            if (target && target->type == AST_IDENTIFIER) {
+                if (strcmp(target->data.identifier.name, name) == 0) return true;
+                continue;
+            }
+            if (node_mentions(target, name)) return false;
+            continue;
+        }
+        if (next->type == AST_RETURN) {
+            return !node_mentions(next, name);
+        }
+        if (next->type == AST_BLOCK || node_mentions(next, name)) return false;
+    }
+    return top_level;
+}
+
+static uint32_t dead_store_list(Optimizer* opt, DeadStoreCtx* ctx, ASTNode** head, bool top_level);
+
+static uint32_t dead_store_nested(Optimizer* opt, DeadStoreCtx* ctx, ASTNode* stmt) {
+    uint32_t changes = 0;
+    switch (stmt->type) {
+        case AST_IF:
+            changes += dead_store_list(opt, ctx, &stmt->data.if_stmt.then_branch, false);
+            changes += dead_store_list(opt, ctx, &stmt->data.if_stmt.else_branch, false);
+            break;
+        case AST_WHILE:
+            changes += dead_store_list(opt, ctx, &stmt->data.while_stmt.body, false);
+            break;
+        case AST_FOR:
+            changes += dead_store_list(opt, ctx, &stmt->data.for_stmt.body, false);
+            break;
+        case AST_REPEAT:
+            changes += dead_store_list(opt, ctx, &stmt->data.repeat_stmt.body, false);
+            break;
+        case AST_CASE:
+            for (int i = 0; i < stmt->data.case_stmt.case_count; i++) {
+                ASTNode* element = stmt->data.case_stmt.cases[i];
+                if (element && element->type == AST_CASE_ELEMENT) {
+                    changes += dead_store_list(opt, ctx, &element->data.case_element.statements, false);
+                }
+            }
+            changes += dead_store_list(opt, ctx, &stmt->data.case_stmt.default_case, false);
+            break;
+        default:
+            break;
+    }
+    return changes;
+}
+
+static uint32_t dead_store_list(Optimizer* opt, DeadStoreCtx* ctx, ASTNode** head, bool top_level) {
+    uint32_t changes = 0;
+    ASTNode** link = head;
+
+    while (*link) {
+        ASTNode* stmt = *link;
+        const char* name = pure_local_store(ctx, stmt);
+
+        // 从不被读取的局部变量，或在读取前被覆盖的存储
+        if (name && (name_set_find(ctx->reads, name) < 0 ||
+                     store_is_overwritten(stmt, name, top_level))) {
+            *link = stmt->next;
+            stmt->next = NULL;
+            bury_node(opt, stmt);
+            changes++;
+            continue;
+        }
+
+        changes += dead_store_nested(opt, ctx, stmt);
+        link = &stmt->next;
+    }
+    return changes;
+}
+
+/**
+ * @brief 删除函数中对局部变量的死存储
+ */
+static uint32_t pass_dead_store(Optimizer* opt, ASTNode* program) {
+    uint32_t changes = 0;
+    NameSet externals;
+    memset(&externals, 0, sizeof(externals));
+    collect_externals(opt, program, &externals);
+
+    for (ASTNode* func = program->data.program.functions; func && opt->error_code == OK; func = func->next) {
+        if (func->type != AST_FUNCTION_DECL || !func->data.function_decl.body) continue;
+
+        LocalVars locals;
+        NameSet reads;
+        memset(&reads, 0, sizeof(reads));
+        collect_locals(opt, func, &locals);
+        collect_reads_list(opt, func->data.function_decl.body, &reads);
+
+        if (opt->error_code == OK && locals.names.count > 0) {
+            DeadStoreCtx ctx = { &locals, &reads, &externals };
+            changes += dead_store_list(opt, &ctx, &func->data.function_decl.body, true);
+        }
+        name_set_free(&reads);
+        free_locals(&locals);
+    }
+
+    name_set_free(&externals);
+    return changes;
+}
+
+// ============================================================================
+// 死代码消除
+// ============================================================================
+
+/**
+ * @brief 取出 IF 分支作为语句链表（ELSIF 之后的 ELSE 分支是 AST_BLOCK 包装）
+ */
+static ASTNode* take_branch(Optimizer* opt, ASTNode** branch) {
+    ASTNode* list = *branch;
+    *branch = NULL;
+    if (list && list->type == AST_BLOCK) {
+        ASTNode* block = list;
+        list = block->next;
+        block->next = NULL;
+        bury_node(opt, block);
+    }
+    return list;
+}
+
+static uint32_t dead_code_list(Optimizer* opt, ASTNode** head) {
+    uint32_t changes = 0;
+    ASTNode** link = head;
+
+    while (*link) {
+        ASTNode* stmt = *link;
+
+        // 条件为常量的 IF：用选中的分支替换整条语句
+        if (stmt->type == AST_IF && stmt->data.if_stmt.condition &&
+            stmt->data.if_stmt.condition->type == AST_LITERAL &&
+            stmt->data.if_stmt.condition->data.literal.value.type == TYPE_BOOL) {
+            bool taken = stmt->data.if_stmt.condition->data.literal.value.bool_val;
+            ASTNode* branch = take_branch(opt, taken ? &stmt->data.if_stmt.then_branch
+                                                     : &stmt->data.if_stmt.else_branch);
+            ASTNode* rest = stmt->next;
+            stmt->next = NULL;
+            bury_node(opt, stmt);
+
+            if (branch) {
+                ASTNode* tail = branch;
+                while (tail->next) tail = tail->next;
+                tail->next = rest;
+                *link = branch;
+            } else {
+                *link = rest;
+            }
+            changes++;
+            continue;   // 重新检查换入的语句
+        }
+
+        // WHILE FALSE：循环体从不执行
+        if (stmt->type == AST_WHILE && stmt->data.while_stmt.condition &&
+            stmt->data.while_stmt.condition->type == AST_LITERAL &&
+            stmt->data.while_stmt.condition->data.literal.value.type == TYPE_BOOL &&
+            !stmt->data.while_stmt.condition->data.literal.value.bool_val) {
+            *link = stmt->next;
+            stmt->next = NULL;
+            bury_node(opt, stmt);
+            changes++;
+            continue;
+        }
+
+        switch (stmt->type) {
+            case AST_IF:
+                changes += dead_code_list(opt, &stmt->data.if_stmt.then_branch);
+                changes += dead_code_list(opt, &stmt->data.if_stmt.else_branch);
+                break;
+            case AST_WHILE:
+                changes += dead_code_list(opt, &stmt->data.while_stmt.body);
+                break;
+            case AST_FOR:
+                changes += dead_code_list(opt, &stmt->data.for_stmt.body);
+                break;
+            case AST_REPEAT:
+                changes += dead_code_list(opt, &stmt->data.repeat_stmt.body);
+                break;
+            case AST_CASE:
+                for (int i = 0; i < stmt->data.case_stmt.case_count; i++) {
+                    ASTNode* element = stmt->data.case_stmt.cases[i];
+                    if (element && element->type == AST_CASE_ELEMENT) {
+                        changes += dead_code_list(opt, &element->data.case_element.statements);
+                    }
+                }
+                changes += dead_code_list(opt, &stmt->data.case_stmt.default_case);
+                break;
+            default:
+                break;
+        }
+
+        // RETURN 之后的语句不可达
+        if (stmt->type == AST_RETURN && stmt->next) {
+            bury_list(opt, stmt->next);
+            stmt->next = NULL;
+            changes++;
+        }
+        link = &stmt->next;
+    }
+    return changes;
+}
+
+/**
+ * @brief 删除常量条件的分支、WHILE FALSE 循环和 RETURN 之后的语句
+ */
+static uint32_t pass_dead_code(Optimizer* opt, ASTNode* program) {
+    uint32_t changes = dead_code_list(opt, &program->data.program.body);
+
+    for (ASTNode* func = program->data.program.functions; func; func = func->next) {
+        if (func->type == AST_FUNCTION_DECL) {
+            changes += dead_code_list(opt, &func->data.function_decl.body);
+        }
+    }
+    return changes;
+}
+
+// ============================================================================
+// 调用副作用分析
+// ============================================================================
+
+/**
+ * @brief 内置外部函数的副作用
+ */
+typedef struct {
+    const char* name;
+    uint32_t effects;
+} BuiltinEffect;
+
+static const BuiltinEffect g_builtin_effects[] = {
+    {"PRINT",      OPT_EFFECT_UNKNOWN},     // 输出
+    {"SYSTEM",     OPT_EFFECT_UNKNOWN},     // 执行系统命令
+    {"GetQuality", OPT_EFFECT_NONE},
+    {"SetQuality", OPT_EFFECT_NONE},        // 返回修改后的值，不改写实参
+    {"MakeQReal",  OPT_EFFECT_NONE},
+    {"ToReal",     OPT_EFFECT_NONE},
+};
+
+static uint32_t external_effects(const Optimizer* opt, const char* name, uint32_t depth);
+
+/**
+ * @brief 从入口沿控制流扫描字节码函数的副作用（嵌套调用递归分析，超过深度按未知处理）
+ */
+static uint32_t bytecode_effects(const Optimizer* opt, const BytecodeModule* module,
+                                 uint32_t entry, uint32_t depth) {
+    uint32_t count = module->instruction_count;
+    if (depth >= EFFECT_MAX_DEPTH || entry >= count) return OPT_EFFECT_UNKNOWN;
+
+    bool* visited = (bool*)mmgr_calloc(sizeof(bool) * count);
+    uint32_t* work = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * count);
+    if (!visited || !work) {
+        if (visited) mmgr_free(visited);
+        if (work) mmgr_free(work);
+        return OPT_EFFECT_UNKNOWN;
+    }
+
+    uint32_t effects = OPT_EFFECT_NONE;
+    uint32_t pending = 0;
+    visited[entry] = true;
+    work[pending++] = entry;
+    while (pending > 0 && !(effects & OPT_EFFECT_UNKNOWN)) {
+        uint32_t pc = work[--pending];
+        const Instruction* in = &module->instructions[pc];
+        bool global = (in->flags & FLAG_GLOBAL) != 0;
+        const SwitchTable* table = NULL;
+        const ForLoop* loop = NULL;
+        uint32_t succs[2];
+        uint32_t succ_count = 0;
+
+        switch (in->opcode) {
+            case OP_LOAD: case OP_LOAD_VAL: case OP_LOAD_QUALITY: case OP_LOAD_INDEXED:
+                if (global) effects |= OPT_EFFECT_READ_GLOBALS;
+                succs[succ_count++] = pc + 1;
+                break;
+            case OP_STORE: case OP_STORE_VAL: case OP_STORE_QUALITY: case OP_STORE_INDEXED:
+                if (global) effects |= OPT_EFFECT_WRITE_GLOBALS;
+                succs[succ_count++] = pc + 1;
+                break;
+            case OP_LOAD_ARRAY: case OP_STORE_ARRAY:
+                // 全局/局部由数组描述符决定
+                if (in->operand >= module->array_bound_count ||
+                    (module->array_bounds[in->operand].flags & ARRAY_BOUND_GLOBAL)) {
+                    effects |= in->opcode == OP_LOAD_ARRAY ? OPT_EFFECT_READ_GLOBALS
+                                                           : OPT_EFFECT_WRITE_GLOBALS;
+                }
+                succs[succ_count++] = pc + 1;
+                break;
+            case OP_IO_READ: case OP_IO_WRITE:
+                effects |= OPT_EFFECT_IO;
+                succs[succ_count++] = pc + 1;
+                break;
+            case OP_HALT:
+                effects |= OPT_EFFECT_UNKNOWN;
+                break;
+            case OP_RET:
+                break;
+            case OP_CALL:
+                effects |= bytecode_effects(opt, module, in->operand, depth + 1);
+                succs[succ_count++] = pc + 1;
+                break;
+            case OP_CALL_EXT:
+                effects |= in->operand < module->function_count
+                         ? external_effects(opt, module->functions[in->operand].name, depth + 1)
+                         : OPT_EFFECT_UNKNOWN;
+                succs[succ_count++] = pc + 1;
+                break;
+            case OP_JMP:
+                succs[succ_count++] = in->operand;
+                break;
+            case OP_JZ: case OP_JNZ:
+                succs[succ_count++] = pc + 1;
+                succs[succ_count++] = in->operand;
+                break;
+            case OP_SWITCH:
+                if (in->operand >= module->switch_table_count) {
+                    effects |= OPT_EFFECT_UNKNOWN;
+                    break;
+                }
+                table = &module->switch_tables[in->operand];
+                succs[succ_count++] = table->default_target;
+                break;
+            case OP_FOR_INIT: case OP_FOR_STEP:
+                if (in->operand >= module->for_loop_count) {
+                    effects |= OPT_EFFECT_UNKNOWN;
+                    break;
+                }
+                loop = &module->for_loops[in->operand];
+                if (loop->flags & FOR_LOOP_VAR_GLOBAL) {
+                    effects |= OPT_EFFECT_READ_GLOBALS | OPT_EFFECT_WRITE_GLOBALS;
+                }
+                if ((loop->flags & FOR_LOOP_END_VAR) && (loop->flags & FOR_LOOP_END_GLOBAL)) {
+                    effects |= OPT_EFFECT_READ_GLOBALS;
+                }
+                succs[succ_count++] = pc + 1;
+                succs[succ_count++] = in->opcode == OP_FOR_INIT ? loop->exit : loop->body;
+                break;
+            default:
+                succs[succ_count++] = pc + 1;
+                break;
+        }
+
+        uint32_t case_index = 0;
+        for (;;) {
+            uint32_t s;
+            if (succ_count > 0) {
+                s = succs[--succ_count];
+            } else if (table && case_index < table->count) {
+                s = module->switch_cases[table->first + case_index++].target;
+            } else {
+                break;
+            }
+            if (s < count && !visited[s]) {
+                visited[s] = true;
+                work[pending++] = s;
+            }
+        }
+    }
+
+    mmgr_free(visited);
+    mmgr_free(work);
+    return effects;
+}
+
+/**
+ * @brief 外部函数的副作用：内置函数查表，库函数分析其字节码，其余按未知处理
+ */
+static uint32_t external_effects(const Optimizer* opt, const char* name, uint32_t depth) {
+    if (!name) return OPT_EFFECT_UNKNOWN;
+    for (size_t i = 0; i < sizeof(g_builtin_effects) / sizeof(g_builtin_effects[0]); i++) {
+        if (strcmp(g_builtin_effects[i].name, name) == 0) return g_builtin_effects[i].effects;
+    }
+    if (!opt || !opt->libmgr) return OPT_EFFECT_UNKNOWN;
+
+    LoadedLibrary* lib = NULL;
+    FunctionEntry* func = libmgr_resolve_call(opt->libmgr, name, &lib);
+    if (!func || !lib || !lib->module) return OPT_EFFECT_UNKNOWN;
+    return bytecode_effects(opt, lib->module, func->address, depth);
+}
+
+uint32_t optimizer_call_effects(const Optimizer* opt, const char* name) {
+    return external_effects(opt, name, 0);
+}
+
+// ============================================================================
+// IR 遍：公共子表达式消除与循环不变量外提
+// ============================================================================
+
+/**
+ * @brief IR 模块中各函数的副作用
+ */
+typedef struct {
+    const Optimizer* opt;
+    const IrModule* ir;
+    uint32_t* effects;          // 按 ir->functions 下标
+} IrEffects;
+
+static int32_t ir_function_index(const IrModule* ir, const char* name) {
+    for (uint32_t i = 0; i < ir->function_count; i++) {
+        if (strcmp(ir->functions[i]->name, name) == 0) return (int32_t)i;
+    }
+    return -1;
+}
+
+static uint32_t ir_callee_effects(const IrEffects* fx, const char* callee) {
+    if (!callee) return OPT_EFFECT_UNKNOWN;
+    int32_t index = ir_function_index(fx->ir, callee);
+    return index >= 0 ? fx->effects[index] : optimizer_call_effects(fx->opt, callee);
+}
+
+/**
+ * @brief 求 IR 模块中每个函数的副作用
+ *
+ * 从"全部为纯函数"出发迭代到不动点：函数体内的全局变量访问（含静态变量）
+ * 和 I/O 直接计入，调用取被调函数当前的结果，因此互相递归的纯函数也能识别。
+ */
+static bool ir_effects_init(IrEffects* fx, const Optimizer* opt, const IrModule* ir) {
+    fx->opt = opt;
+    fx->ir = ir;
+    fx->effects = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * (ir->function_count + 1));
+    if (!fx->effects) return false;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t f = 0; f < ir->function_count; f++) {
+            const IrFunction* func = ir->functions[f];
+            uint32_t effects = fx->effects[f];
+            for (uint32_t b = 0; b < func->block_count; b++) {
+                const IrBlock* block = func->blocks[b];
+                for (uint32_t i = 0; i < block->instr_count; i++) {
+                    const IrInstr* ins = &block->instrs[i];
+                    switch (ins->op) {
+                        case IR_LOAD: case IR_LOAD_INDEXED: case IR_LOAD_MEMBER:
+                            if (ins->var.is_global) effects |= OPT_EFFECT_READ_GLOBALS;
+                            break;
+                        case IR_STORE: case IR_STORE_INDEXED: case IR_STORE_MEMBER:
+                            if (ins->var.is_global) effects |= OPT_EFFECT_WRITE_GLOBALS;
+                            break;
+                        case IR_IO_READ: case IR_IO_WRITE:
+                            effects |= OPT_EFFECT_IO;
+                            break;
+                        case IR_CALL:
+                            effects |= ir_callee_effects(fx, ins->callee);
+                            break;
+                        default:
+                            break;
+                    }
+                }
+            }
+            if (effects != fx->effects[f]) {
+                fx->effects[f] = effects;
+                changed = true;
+            }
+        }
+    }
+    return true;
+}
+
+static bool ir_call_is_pure(const char* callee, void* data) {
+    return ir_callee_effects((const IrEffects*)data, callee) == OPT_EFFECT_NONE;
+}
+
+typedef ErrorCode (*IrTransformFn)(IrFunction* func, IrPureCallFn pure_call, void* data,
+                                   uint32_t* changes);
+
+/**
+ * @brief 对模块中每个函数执行一个 IR 变换
+ */
+static uint32_t run_ir_transform(Optimizer* opt, IrModule* ir, IrTransformFn transform) {
+    IrEffects fx;
+    if (!ir_effects_init(&fx, opt, ir)) {
+        opt->error_code = ERR_OUT_OF_MEMORY;
+        return 0;
+    }
+
+    uint32_t total = 0;
+    for (uint32_t f = 0; f < ir->function_count; f++) {
+        uint32_t changes = 0;
+        ErrorCode err = transform(ir->functions[f], ir_call_is_pure, &fx, &changes);
+        if (err != OK) {
+            opt->error_code = err;
+            break;
+        }
+        total += changes;
+    }
+    mmgr_free(fx.effects);
+    return total;
+}
+
+static uint32_t pass_cse(Optimizer* opt, IrModule* ir) {
+    return run_ir_transform(opt, ir, ir_eliminate_common_subexprs);
+}
+
+static uint32_t pass_licm(Optimizer* opt, IrModule* ir) {
+    return run_ir_transform(opt, ir, ir_hoist_loop_invariants);
+}
+
+// ============================================================================
+// 字节码窥孔优化
+// ============================================================================
+
+static bool is_jump(uint8_t opcode) {
+    return opcode == OP_JMP || opcode == OP_JZ || opcode == OP_JNZ;
+}
+
+/**
+ * @brief 标记跳转目标：跳转指令、跳转表和 FOR 循环描述符的目标、函数入口、模块入口和地址 0
+ */
+static void mark_jump_targets(const BytecodeModule* module, bool* targets) {
+    uint32_t count = module->instruction_count;
+    memset(targets, 0, sizeof(bool) * (count + 1));
+
+    targets[0] = true;
+    if (module->entry_point <= count) targets[module->entry_point] = true;
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        if (module->functions[i].address <= count) targets[module->functions[i].address] = true;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        const Instruction* in = &module->instructions[i];
+        if (is_jump(in->opcode) && in->operand <= count) targets[in->operand] = true;
+    }
+    for (uint32_t i = 0; i < module->switch_table_count; i++) {
+        uint32_t target = module->switch_tables[i].default_target;
+        if (target <= count) targets[target] = true;
+    }
+    for (uint32_t i = 0; i < module->switch_case_count; i++) {
+        if (module->switch_cases[i].target <= count) targets[module->switch_cases[i].target] = true;
+    }
+    for (uint32_t i = 0; i < module->for_loop_count; i++) {
+        const ForLoop* loop = &module->for_loops[i];
+        if (loop->body <= count) targets[loop->body] = true;
+        if (loop->exit <= count) targets[loop->exit] = true;
+    }
+}
+
+/**
+ * @brief 跳转穿透：沿无条件跳转链找到最终目标
+ */
+static uint32_t thread_jump(const Instruction* code, uint32_t count, uint32_t target) {
+    for (int hops = 0; hops < JUMP_THREAD_LIMIT && target < count &&
+         code[target].opcode == OP_JMP && code[target].operand != target; hops++) {
+        target = code[target].operand;
+    }
+    return target;
+}
+
+/**
+ * @brief 常量池中可作为条件的常量取值（与 VM 的 JZ/JNZ 判断一致）
+ */
+static bool constant_truth(const BytecodeModule* module, uint16_t index, bool* out) {
+    if (index >= module->const_count) return false;
+    const Constant* c = &module->constants[index];
+    if (c->type == CONST_BOOL) { *out = c->bool_val; return true; }
+    if (c->type == CONST_INT)  { *out = c->int_val != 0; return true; }
+    return false;
+}
+
+/**
+ * @brief 一轮窥孔改写，返回改动数（删除标记写入 removed）
+ */
+static uint32_t peephole_round(BytecodeModule* module, bool* targets, bool* removed) {
+    uint32_t count = module->instruction_count;
+    Instruction* code = module->instructions;
+    uint32_t changes = 0;
+
+    // 1. 跳转穿透：目标是无条件跳转时直接跳到最终目标（跳转表和循环描述符同理）
+    for (uint32_t i = 0; i < count; i++) {
+        if (!is_jump(code[i].opcode)) continue;
+        uint32_t target = thread_jump(code, count, code[i].operand);
+        if (target != code[i].operand) {
+            code[i].operand = (uint16_t)target;
+            changes++;
+        }
+    }
+    for (uint32_t i = 0; i < module->switch_table_count; i++) {
+        SwitchTable* table = &module->switch_tables[i];
+        uint32_t target = thread_jump(code, count, table->default_target);
+        if (target != table->default_target) {
+            table->default_target = target;
+            changes++;
+        }
+    }
+    for (uint32_t i = 0; i < module->switch_case_count; i++) {
+        SwitchCase* entry = &module->switch_cases[i];
+        uint32_t target = thread_jump(code, count, entry->target);
+        if (target != entry->target) {
+            entry->target = target;
+            changes++;
+        }
+    }
+    for (uint32_t i = 0; i < module->for_loop_count; i++) {
+        ForLoop* loop = &module->for_loops[i];
+        uint32_t body = thread_jump(code, count, loop->body);
+        uint32_t exit = thread_jump(code, count, loop->exit);
+        if (body != loop->body || exit != loop->exit) {
+            loop->body = body;
+            loop->exit = exit;
+            changes++;
+        }
+    }
+    mark_jump_targets(module, targets);
+
+    // 2. 局部模式（组合中第二条指令不能是跳转目标）
+    for (uint32_t i = 0; i < count; i++) {
+        if (removed[i]) continue;
+        Instruction* in = &code[i];
+        Instruction* next = (i + 1 < count && !targets[i + 1]) ? &code[i + 1] : NULL;
+        bool truth;
+
+        switch (in->opcode) {
+            case OP_NOP:
+                removed[i] = true;
+                changes++;
+                break;
+
+            case OP_JMP:
+                // 跳到下一条
+                if (in->operand == i + 1) {
+                    removed[i] = true;
+                    changes++;
+                }
+                break;
+
+            case OP_PUSH:
+                if (!next) break;
+                if (next->opcode == OP_POP) {
+                    removed[i] = removed[i + 1] = true;
+                    changes++;
+                } else if ((next->opcode == OP_JZ || next->opcode == OP_JNZ) &&
+                           constant_truth(module, in->operand, &truth)) {
+                    // 常量条件：要么无条件跳转，要么两条都删除
+                    bool taken = next->opcode == OP_JZ ? !truth : truth;
+                    if (taken) {
+                        in->opcode = OP_JMP;
+                        in->flags = 0;
+                        in->operand = next->operand;
+                        removed[i + 1] = true;
+                    } else {
+                        removed[i] = removed[i + 1] = true;
+                    }
+                    changes++;
+                }
+                break;
+
+            case OP_LOAD:
+            case OP_DUP:
+                if (next && next->opcode == OP_POP) {
+                    removed[i] = removed[i + 1] = true;
+                    changes++;
+                }
+                break;
+
+            case OP_NOT:
+                // NOT + JZ/JNZ：翻转条件跳转
+                if (next && (next->opcode == OP_JZ || next->opcode == OP_JNZ)) {
+                    next->opcode = next->opcode == OP_JZ ? OP_JNZ : OP_JZ;
+                    removed[i] = true;
+                    changes++;
+                }
+                break;
+
+            default:
+                break;
+        }
+        if (removed[i] && i + 1 < count && removed[i + 1]) i++;
+    }
+
+    // 3. 不可达代码：无条件转移之后、下一个跳转目标之前的指令
+    for (uint32_t i = 0; i < count; i++) {
+        if (removed[i]) continue;
+        uint8_t op = code[i].opcode;
+        if (op != OP_JMP && op != OP_SWITCH && op != OP_RET && op != OP_HALT) continue;
+        for (uint32_t j = i + 1; j < count && !targets[j]; j++) {
+            if (!removed[j]) {
+                removed[j] = true;
+                changes++;
+            }
+        }
+    }
+    return changes;
+}
+
+/**
+ * @brief 窥孔优化：跳转穿透、常量条件跳转、冗余压栈/出栈、不可达代码
+ */
+static uint32_t pass_peephole(Optimizer* opt, BytecodeModule* module) {
+    uint32_t total = 0;
+
+    for (int round = 0; round < PEEPHOLE_MAX_ROUNDS; round++) {
+        uint32_t count = module->instruction_count;
+        if (count == 0 || !bytecode_make_writable(module)) break;
+
+        bool* targets = (bool*)mmgr_alloc(sizeof(bool) * (count + 1));
+        bool* removed = (bool*)mmgr_calloc(sizeof(bool) * count);
+        if (!targets || !removed) {
+            if (targets) mmgr_free(targets);
+            if (removed) mmgr_free(removed);
+            opt->error_code = ERR_OUT_OF_MEMORY;
+            break;
+        }
+
+        uint32_t changes = peephole_round(module, targets, removed);
+        if (changes > 0 && bytecode_remove_instructions(module, removed) == (uint32_t)-1) {
+            opt->error_code = ERR_OUT_OF_MEMORY;
+        }
+        mmgr_free(targets);
+        mmgr_free(removed);
+
+        total += changes;
+        if (changes == 0 || opt->error_code != OK) break;
+    }
+    return total;
+}
+
+// ============================================================================
+// 函数内联
+// ============================================================================
+//
+// 在字节码上把叶子函数（不含 CALL/CALL_EXT/HALT）的调用展开到调用点。静态链接
+// 后库函数调用已是 CALL，同样可以内联。被调函数的帧槽位改为隐藏的全局变量
+// （名为 "函数名.$槽位号"，调试器按全局变量显示）：叶子函数的内联代码中没有调用，
+// 不同内联实例的执行区间不会交叠，同一函数的所有调用点可共用一组槽位。
+//
+// 展开后的片段：
+//   STORE 参数槽位（逆序弹出实参，未使用的参数 POP）
+//   函数体副本（局部变量访问改为全局，跳转重定位，RET 改为跳到片段末尾）
+//   LOAD 返回值槽位（有返回值时）
+//
+// 帧槽位初值是 VOID、全局变量初值是 INT 0，所以只内联每个非参数槽位都先写后读
+// （在所有路径上）的函数；RET 时求值栈须为空。只写不读的槽位不分配全局变量，
+// 对它的 STORE 改为 POP（随后由窥孔优化与压栈指令一起删除）。代价模型按函数体指令数：
+// 不超过 INLINE_MAX_SIZE 的总是内联，只有一个调用点的放宽到 INLINE_SINGLE_SITE_SIZE，
+// 总增长不超过原指令数的 INLINE_GROWTH_PERCENT%。
+
+/**
+ * @brief 被调函数体的分析结果
+ */
+typedef struct {
+    uint32_t size;              // 函数体指令数（从入口到最后一条可达指令）
+    bool* reachable;            // 可达标记（INLINE_SINGLE_SITE_SIZE 条）
+    uint64_t slots;             // 需要隐藏全局变量的帧槽位（被读取、作循环变量或返回值）
+} InlineBody;
+
+/**
+ * @brief 内联遍的上下文
+ */
+typedef struct {
+    Optimizer* opt;
+    BytecodeModule* module;
+    int32_t** slot_globals;     // 每个函数的帧槽位对应的隐藏全局变量（按需分配）
+    uint32_t function_count;
+    uint32_t budget;            // 剩余的指令增长额度
+} InlineCtx;
+
+/**
+ * @brief 指令的出栈/入栈数，不能出现在内联函数体中的指令返回 false
+ */
+static bool inline_stack_effect(uint8_t opcode, int32_t* pops, int32_t* pushes) {
+    *pops = 0;
+    *pushes = 0;
+    switch (opcode) {
+        case OP_PUSH: case OP_LOAD: case OP_LOAD_VAL: case OP_LOAD_QUALITY: case OP_IO_READ:
+            *pushes = 1;
+            return true;
+        case OP_DUP:
+            *pops = 1;
+            *pushes = 2;
+            return true;
+        case OP_POP: case OP_STORE: case OP_STORE_VAL: case OP_STORE_QUALITY: case OP_IO_WRITE:
+        case OP_JZ: case OP_JNZ: case OP_SWITCH: case OP_FOR_INIT:
+            *pops = 1;
+            return true;
+        case OP_NEG: case OP_NOT: case OP_BIT_NOT: case OP_LOAD_INDEXED: case OP_LOAD_ARRAY:
+            *pops = 1;
+            *pushes = 1;
+            return true;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_EQ: case OP_NE: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+        case OP_AND: case OP_OR: case OP_XOR:
+        case OP_BIT_AND: case OP_BIT_OR: case OP_BIT_XOR: case OP_SHL: case OP_SHR:
+            *pops = 2;
+            *pushes = 1;
+            return true;
+        case OP_STORE_INDEXED: case OP_STORE_ARRAY:
+            *pops = 2;
+            return true;
+        case OP_JMP: case OP_NOP: case OP_FOR_STEP: case OP_RET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 按变量名访问帧槽位的指令
+ */
+static bool is_local_slot_access(const Instruction* in) {
+    if (in->flags & FLAG_GLOBAL) return false;
+    switch (in->opcode) {
+        case OP_LOAD: case OP_STORE:
+        case OP_LOAD_VAL: case OP_LOAD_QUALITY: case OP_STORE_VAL: case OP_STORE_QUALITY:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief 分析被调函数能否内联
+ *
+ * 从入口沿控制流遍历，同时求每条指令处的求值栈深度（汇合处须一致）和一定已写入
+ * 的帧槽位集合（汇合处取交集，收缩到不动点）。
+ *
+ * @return 可以内联返回 true（body->reachable 由调用者释放）
+ */
+static bool inline_analyze(const BytecodeModule* module, const FunctionEntry* func, InlineBody* body) {
+    uint32_t entry = func->address;
+    if (entry >= module->instruction_count || func->param_count < 0 ||
+        func->local_count < func->param_count || func->local_count > INLINE_MAX_SLOTS) {
+        return false;
+    }
+    uint32_t window = module->instruction_count - entry;
+    if (window > INLINE_SINGLE_SITE_SIZE) window = INLINE_SINGLE_SITE_SIZE;
+
+    int32_t return_slot = func->return_type != TYPE_VOID ? func->param_count : -1;
+    if (return_slot >= func->local_count) return false;
+
+    int32_t* depth = (int32_t*)mmgr_alloc(sizeof(int32_t) * window);
+    uint64_t* defined = (uint64_t*)mmgr_alloc(sizeof(uint64_t) * window);
+    uint32_t* work = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * window);
+    bool* queued = (bool*)mmgr_calloc(sizeof(bool) * window);
+    if (!depth || !defined || !work || !queued) {
+        if (depth) mmgr_free(depth);
+        if (defined) mmgr_free(defined);
+        if (work) mmgr_free(work);
+        if (queued) mmgr_free(queued);
+        return false;
+    }
+    for (uint32_t i = 0; i < window; i++) depth[i] = -1;
+
+    const Instruction* code = module->instructions + entry;
+    uint64_t params = func->param_count >= 64 ? ~0ULL : ((1ULL << func->param_count) - 1);
+    depth[0] = 0;
+    defined[0] = params;
+    work[0] = 0;
+    queued[0] = true;
+    uint32_t pending = 1;
+    uint32_t last = 0;
+    uint64_t slots = 0;
+    bool ok = true;
+
+    while (ok && pending > 0) {
+        uint32_t i = work[--pending];
+        queued[i] = false;
+        const Instruction* in = &code[i];
+        int32_t pops, pushes;
+        if (!inline_stack_effect(in->opcode, &pops, &pushes) || depth[i] < pops) {
+            ok = false;
+            break;
+        }
+        if (i > last) last = i;
+        uint64_t def = defined[i];
+
+        // 帧槽位的读写
+        int32_t reads[2] = {-1, -1};
+        int32_t write = -1;
+        const ForLoop* loop = NULL;
+        if (in->opcode == OP_FOR_INIT || in->opcode == OP_FOR_STEP) {
+            if (in->operand >= module->for_loop_count) { ok = false; break; }
+            loop = &module->for_loops[in->operand];
+            if (!(loop->flags & FOR_LOOP_VAR_GLOBAL)) {
+                if (loop->var >= (uint32_t)func->local_count) { ok = false; break; }
+                if (in->opcode == OP_FOR_INIT) write = (int32_t)loop->var;
+                else reads[0] = (int32_t)loop->var;
+                slots |= 1ULL << loop->var;
+            }
+            if ((loop->flags & FOR_LOOP_END_VAR) && !(loop->flags & FOR_LOOP_END_GLOBAL)) {
+                reads[1] = (int32_t)loop->end_var;
+                if (loop->end_var >= (uint32_t)func->local_count) { ok = false; break; }
+            }
+        } else if (is_local_slot_access(in)) {
+            if (in->operand >= func->local_count) { ok = false; break; }
+            if (in->opcode == OP_STORE) {
+                write = in->operand;
+            } else {
+                // STORE_VAL/STORE_QUALITY 只改写一部分，原值须已写入
+                reads[0] = in->operand;
+            }
+        } else if ((in->opcode == OP_LOAD_INDEXED || in->opcode == OP_STORE_INDEXED) &&
+                   !(in->flags & FLAG_GLOBAL)) {
+            ok = false;
+            break;
+        } else if ((in->opcode == OP_LOAD_ARRAY || in->opcode == OP_STORE_ARRAY) &&
+                   (in->operand >= module->array_bound_count ||
+                    !(module->array_bounds[in->operand].flags & ARRAY_BOUND_GLOBAL))) {
+            // 局部数组描述符按帧偏移寻址，内联到调用者的帧后不再成立
+            ok = false;
+            break;
+        } else if (in->opcode == OP_RET) {
+            if (depth[i] != 0) { ok = false; break; }
+            reads[0] = return_slot;
+        }
+        for (int r = 0; r < 2; r++) {
+            if (reads[r] < 0) continue;
+            if (!(def & (1ULL << reads[r]))) { ok = false; break; }
+            slots |= 1ULL << reads[r];
+        }
+        if (!ok) break;
+        if (write >= 0) def |= 1ULL << write;
+
+        // 后继（相对入口的下标）
+        uint32_t succs[2];
+        uint32_t succ_count = 0;
+        const SwitchTable* table = NULL;
+        switch (in->opcode) {
+            case OP_RET:
+                break;
+            case OP_JMP:
+                succs[succ_count++] = in->operand - entry;
+                break;
+            case OP_JZ: case OP_JNZ:
+                succs[succ_count++] = i + 1;
+                succs[succ_count++] = in->operand - entry;
+                break;
+            case OP_SWITCH:
+                if (in->operand >= module->switch_table_count) { ok = false; break; }
+                table = &module->switch_tables[in->operand];
+                succs[succ_count++] = table->default_target - entry;
+                break;
+            case OP_FOR_INIT:
+                succs[succ_count++] = i + 1;
+                succs[succ_count++] = loop->exit - entry;
+                break;
+            case OP_FOR_STEP:
+                succs[succ_count++] = loop->body - entry;
+                succs[succ_count++] = i + 1;
+                break;
+            default:
+                succs[succ_count++] = i + 1;
+                break;
+        }
+        if (!ok) break;
+
+        int32_t out_depth = depth[i] - pops + pushes;
+        uint32_t case_index = 0;
+        for (;;) {
+            uint32_t s;
+            if (succ_count > 0) {
+                s = succs[--succ_count];
+            } else if (table && case_index < table->count) {
+                s = module->switch_cases[table->first + case_index++].target - entry;
+            } else {
+                break;
+            }
+            // 目标在入口之前时无符号差值回绕，同样落在窗口之外
+            if (s >= window) { ok = false; break; }
+            if (depth[s] < 0) {
+                depth[s] = out_depth;
+                defined[s] = def;
+            } else if (depth[s] != out_depth) {
+                ok = false;
+                break;
+            } else if ((defined[s] & def) != defined[s]) {
+                defined[s] &= def;
+            } else {
+                continue;
+            }
+            if (!queued[s]) {
+                queued[s] = true;
+                work[pending++] = s;
+            }
+        }
+    }
+
+    if (ok) {
+        body->size = last + 1;
+        // 没有可达 RET 时尾部的返回值读取仍需槽位
+        body->slots = return_slot >= 0 ? slots | (1ULL << return_slot) : slots;
+        body->reachable = (bool*)mmgr_calloc(sizeof(bool) * body->size);
+        if (!body->reachable) {
+            ok = false;
+        } else {
+            for (uint32_t i = 0; i < body->size; i++) body->reachable[i] = depth[i] >= 0;
+        }
+    }
+    mmgr_free(depth);
+    mmgr_free(defined);
+    mmgr_free(work);
+    mmgr_free(queued);
+    return ok;
+}
+
+/**
+ * @brief 取函数帧槽位对应的隐藏全局变量，首次使用时分配
+ * @return 全局变量索引，失败返回 -1
+ */
+static int32_t inline_slot_global(InlineCtx* ctx, uint32_t func_index, uint32_t slot) {
+    const FunctionEntry* func = &ctx->module->functions[func_index];
+    int32_t* globals = ctx->slot_globals[func_index];
+    if (!globals) {
+        globals = (int32_t*)mmgr_alloc(sizeof(int32_t) * (size_t)func->local_count);
+        if (!globals) return -1;
+        for (int32_t i = 0; i < func->local_count; i++) globals[i] = -1;
+        ctx->slot_globals[func_index] = globals;
+    }
+    if (globals[slot] < 0) {
+        DataType type = TYPE_VOID;
+        if ((int32_t)slot < func->param_count && func->param_types) {
+            type = func->param_types[slot];
+        } else if ((int32_t)slot == func->param_count) {
+            type = func->return_type;
+        }
+        char name[128];
+        snprintf(name, sizeof(name), "%s.$%u", func->name ? func->name : "", slot);
+        globals[slot] = bytecode_add_global(ctx->module, name, type);
+    }
+    return globals[slot];
+}
+
+/**
+ * @brief 把 site 处的 CALL 展开为被调函数体
+ * @return 展开返回 true（内存不足时设置 opt->error_code）
+ */
+static bool inline_call(InlineCtx* ctx, uint32_t site, uint32_t func_index, const InlineBody* body) {
+    BytecodeModule* module = ctx->module;
+    const FunctionEntry* func = &module->functions[func_index];
+    uint32_t entry = func->address;
+    uint32_t params = (uint32_t)func->param_count;
+    bool returns = func->return_type != TYPE_VOID;
+    uint32_t count = params + body->size + (returns ? 1 : 0);
+    uint32_t base = site + params;         // 函数体副本的起点
+    uint32_t done = base + body->size;     // RET 的跳转目标
+
+    if (count - 1 > ctx->budget || module->instruction_count + count - 1 > UINT16_MAX) return false;
+
+    // 隐藏全局变量须在生成片段前分配（失败时尚未改动指令）
+    for (uint32_t slot = 0; slot < (uint32_t)func->local_count; slot++) {
+        if ((body->slots & (1ULL << slot)) && inline_slot_global(ctx, func_index, slot) < 0) {
+            ctx->opt->error_code = ERR_OUT_OF_MEMORY;
+            return false;
+        }
+    }
+    const int32_t* globals = ctx->slot_globals[func_index];
+
+    Instruction* code = (Instruction*)mmgr_alloc(sizeof(Instruction) * count);
+    LineEntry* lines = (LineEntry*)mmgr_alloc(sizeof(LineEntry) * (module->line_table.count + 3));
+    uint32_t* switch_map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * body->size);
+    uint32_t* loop_map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * body->size);
+    if (!code || !lines || !switch_map || !loop_map) {
+        if (code) mmgr_free(code);
+        if (lines) mmgr_free(lines);
+        if (switch_map) mmgr_free(switch_map);
+        if (loop_map) mmgr_free(loop_map);
+        ctx->opt->error_code = ERR_OUT_OF_MEMORY;
+        return false;
+    }
+    uint32_t switch_count = 0;
+    uint32_t loop_count = 0;
+
+    // 实参按顺序压栈，逆序弹出到参数槽位
+    for (uint32_t k = 0; k < params; k++) {
+        uint32_t slot = params - 1 - k;
+        if (body->slots & (1ULL << slot)) {
+            code[k] = (Instruction){.opcode = OP_STORE, .flags = FLAG_GLOBAL, .operand = (uint16_t)globals[slot]};
+        } else {
+            code[k] = (Instruction){.opcode = OP_POP, .flags = 0, .operand = 0};
+        }
+    }
+
+    for (uint32_t k = 0; k < body->size; k++) {
+        Instruction in = module->instructions[entry + k];
+        Instruction* out = &code[params + k];
+        if (!body->reachable[k]) {
+            *out = (Instruction){.opcode = OP_NOP, .flags = 0, .operand = 0};
+            continue;
+        }
+        if (in.opcode == OP_STORE && !(in.flags & FLAG_GLOBAL) && !(body->slots & (1ULL << in.operand))) {
+            in = (Instruction){.opcode = OP_POP, .flags = 0, .operand = 0};
+        } else if (is_local_slot_access(&in)) {
+            in.flags |= FLAG_GLOBAL;
+            in.operand = (uint16_t)globals[in.operand];
+        } else if (is_jump(in.opcode)) {
+            in.operand = (uint16_t)(base + in.operand - entry);
+        } else if (in.opcode == OP_RET) {
+            in = (Instruction){.opcode = OP_JMP, .flags = 0, .operand = (uint16_t)done};
+        } else if (in.opcode == OP_SWITCH) {
+            uint32_t j = 0;
+            while (j < switch_count && switch_map[j] != in.operand) j++;
+            if (j == switch_count) switch_map[switch_count++] = in.operand;
+            in.operand = (uint16_t)(module->switch_table_count + j);
+        } else if (in.opcode == OP_FOR_INIT || in.opcode == OP_FOR_STEP) {
+            uint32_t j = 0;
+            while (j < loop_count && loop_map[j] != in.operand) j++;
+            if (j == loop_count) loop_map[loop_count++] = in.operand;
+            in.operand = (uint16_t)(module->for_loop_count + j);
+        }
+        *out = in;
+    }
+    if (returns) {
+        code[count - 1] = (Instruction){.opcode = OP_LOAD, .flags = FLAG_GLOBAL,
+                                        .operand = (uint16_t)globals[params]};
+    }
+
+    // 行号：参数和返回值搬运属于调用所在行，函数体沿用被调函数的行号
+    int32_t call_line = bytecode_line_for_pc(module, site);
+    uint32_t line_count = 0;
+    lines[line_count++] = (LineEntry){.pc = 0, .line = call_line};
+    lines[line_count++] = (LineEntry){.pc = params, .line = bytecode_line_for_pc(module, entry)};
+    for (uint32_t i = 0; i < module->line_table.count; i++) {
+        const LineEntry* e = &module->line_table.entries[i];
+        if (e->pc > entry && e->pc < entry + body->size) {
+            lines[line_count++] = (LineEntry){.pc = params + e->pc - entry, .line = e->line};
+        }
+    }
+    if (returns) lines[line_count++] = (LineEntry){.pc = count - 1, .line = call_line};
+    if (module->line_table.count == 0) line_count = 0;
+
+    // 跳转表和循环描述符的副本在替换后追加，先按替换前的地址取出
+    SwitchTable* tables = NULL;
+    SwitchCase** cases = NULL;
+    ForLoop* loops = NULL;
+    bool ok = true;
+    if (switch_count > 0) {
+        tables = (SwitchTable*)mmgr_alloc(sizeof(SwitchTable) * switch_count);
+        cases = (SwitchCase**)mmgr_calloc(sizeof(SwitchCase*) * switch_count);
+        ok = tables && cases;
+        for (uint32_t j = 0; ok && j < switch_count; j++) {
+            SwitchTable t = module->switch_tables[switch_map[j]];
+            tables[j] = t;
+            if (t.count == 0) continue;
+            cases[j] = (SwitchCase*)mmgr_alloc(sizeof(SwitchCase) * t.count);
+            if (!cases[j]) { ok = false; break; }
+            for (uint32_t c = 0; c < t.count; c++) {
+                cases[j][c] = module->switch_cases[t.first + c];
+                cases[j][c].target = base + cases[j][c].target - entry;
+            }
+            tables[j].default_target = base + t.default_target - entry;
+        }
+    }
+    if (ok && loop_count > 0) {
+        loops = (ForLoop*)mmgr_alloc(sizeof(ForLoop) * loop_count);
+        ok = loops != NULL;
+        for (uint32_t j = 0; ok && j < loop_count; j++) {
+            ForLoop loop = module->for_loops[loop_map[j]];
+            if (!(loop.flags & FOR_LOOP_VAR_GLOBAL)) {
+                loop.var = (uint32_t)globals[loop.var];
+                loop.flags |= FOR_LOOP_VAR_GLOBAL;
+            }
+            if ((loop.flags & FOR_LOOP_END_VAR) && !(loop.flags & FOR_LOOP_END_GLOBAL)) {
+                loop.end_var = (uint32_t)globals[loop.end_var];
+                loop.flags |= FOR_LOOP_END_GLOBAL;
+            }
+            loop.body = base + loop.body - entry;
+            loop.exit = base + loop.exit - entry;
+            loops[j] = loop;
+        }
+    }
+
+    bool inlined = ok && bytecode_replace_instruction(module, site, code, count, lines, line_count);
+    if (inlined) {
+        ctx->budget -= count - 1;
+        for (uint32_t j = 0; j < switch_count; j++) {
+            if (bytecode_add_switch_table(module, (SwitchKind)tables[j].kind, cases[j], tables[j].count,
+                                          tables[j].default_target) == (uint32_t)-1) {
+                ctx->opt->error_code = ERR_OUT_OF_MEMORY;
+            }
+        }
+        for (uint32_t j = 0; j < loop_count; j++) {
+            if (bytecode_add_for_loop(module, &loops[j]) == (uint32_t)-1) {
+                ctx->opt->error_code = ERR_OUT_OF_MEMORY;
+            }
+        }
+    } else {
+        ctx->opt->error_code = ERR_OUT_OF_MEMORY;
+    }
+
+    if (cases) {
+        for (uint32_t j = 0; j < switch_count; j++) {
+            if (cases[j]) mmgr_free(cases[j]);
+        }
+        mmgr_free(cases);
+    }
+    if (tables) mmgr_free(tables);
+    if (loops) mmgr_free(loops);
+    mmgr_free(code);
+    mmgr_free(lines);
+    mmgr_free(switch_map);
+    mmgr_free(loop_map);
+    return inlined;
+}
+
+/**
+ * @brief 一轮内联：按地址从高到低展开调用点（低地址的调用点不受前面展开的影响）
+ * @return 展开的调用点数
+ */
+static uint32_t inline_round(InlineCtx* ctx) {
+    BytecodeModule* module = ctx->module;
+    uint32_t* sites = (uint32_t*)mmgr_calloc(sizeof(uint32_t) * ctx->function_count);
+    if (!sites) {
+        ctx->opt->error_code = ERR_OUT_OF_MEMORY;
+        return 0;
+    }
+    for (uint32_t i = 0; i < module->instruction_count; i++) {
+        const Instruction* in = &module->instructions[i];
+        if (in->opcode == OP_CALL && in->operand < ctx->function_count) sites[in->operand]++;
+    }
+
+    uint32_t changes = 0;
+    for (uint32_t i = module->instruction_count; i-- > 0 && ctx->opt->error_code == OK;) {
+        const Instruction* in = &module->instructions[i];
+        if (in->opcode != OP_CALL || in->operand >= ctx->function_count) continue;
+        uint32_t func_index = in->operand;
+
+        InlineBody body = {0};
+        if (!inline_analyze(module, &module->functions[func_index], &body)) continue;
+        uint32_t limit = sites[func_index] == 1 ? INLINE_SINGLE_SITE_SIZE : INLINE_MAX_SIZE;
+        if (body.size <= limit && inline_call(ctx, i, func_index, &body)) changes++;
+        mmgr_free(body.reachable);
+    }
+    mmgr_free(sites);
+    return changes;
+}
+
+/**
+ * @brief 函数内联：展开小的叶子函数调用，展开后成为叶子的函数在下一轮继续展开
+ */
+static uint32_t pass_inline(Optimizer* opt, BytecodeModule* module) {
+    if (module->function_count == 0 || module->instruction_count == 0) return 0;
+    if (bytecode_load_debug_info(module) != OK || !bytecode_make_writable(module)) return 0;
+
+    InlineCtx ctx = {
+        .opt = opt,
+        .module = module,
+        .slot_globals = (int32_t**)mmgr_calloc(sizeof(int32_t*) * module->function_count),
+        .function_count = module->function_count,
+        .budget = module->instruction_count * INLINE_GROWTH_PERCENT / 100,
+    };
+    if (ctx.budget < INLINE_MIN_GROWTH) ctx.budget = INLINE_MIN_GROWTH;
+    if (!ctx.slot_globals) {
+        opt->error_code = ERR_OUT_OF_MEMORY;
+        return 0;
+    }
+
+    uint32_t total = 0;
+    for (int round = 0; round < INLINE_MAX_ROUNDS && opt->error_code == OK; round++) {
+        uint32_t changes = inline_round(&ctx);
+        total += changes;
+        if (changes == 0) break;
+    }
+
+    for (uint32_t i = 0; i < ctx.function_count; i++) {
+        if (ctx.slot_globals[i]) mmgr_free(ctx.slot_globals[i]);
+    }
+    mmgr_free(ctx.slot_globals);
+    return total;
+}
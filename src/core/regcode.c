@@ -0,0 +1,1214 @@
+/**
+ * @file regcode.c
+ * @brief 寄存器格式字节码 - 由栈式字节码翻译、校验与打印
+ *
+ * 翻译分两遍：
+ * 1. 从入口和每个被调用函数的入口出发做工作表遍历，求出每条指令所属的过程
+ *    （主程序或函数）、执行前的栈深度和基本块首，同时检查能否翻译
+ * 2. 按地址顺序逐个过程翻译：模拟操作数栈，槽位记录操作数描述（寄存器、常量
+ *    或全局变量），PUSH/LOAD/DUP 不生成指令，运算直接读取变量和常量，结果写入
+ *    槽位对应的临时寄存器；紧随的 STORE 改写上一条指令的目标，比较之后紧随的
+ *    条件跳转合并为比较跳转。基本块边界和有副作用的指令之前，槽位落到各自的
+ *    临时寄存器
+ */
+
+#include "regcode.h"
+#include "mmgr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+// ============================================================================
+// 翻译上下文
+// ============================================================================
+
+/**
+ * @brief 操作数描述（模拟栈槽位的内容）
+ */
+typedef struct {
+    uint8_t kind;       // REG_KIND_*
+    uint16_t index;
+} RegOperand;
+
+/**
+ * @brief 过程（主程序或函数）
+ */
+typedef struct {
+    uint32_t entry;         // 栈式入口地址
+    uint32_t locals;        // 局部变量数（主程序为 0）
+    int32_t function;       // 函数表下标（主程序为 -1）
+    uint32_t max_depth;     // 最大栈深度
+} RegProc;
+
+typedef struct {
+    BytecodeModule* module;
+    char* error_msg;
+    size_t error_size;
+    bool failed;
+
+    // 第一遍
+    int32_t* depth;             // 每条指令执行前的栈深度
+    int32_t* owner;             // 所属过程（-1 表示不可达）
+    bool* leader;               // 基本块首
+    uint32_t* worklist;
+    uint32_t work_count;
+    RegProc* procs;
+    uint32_t proc_count;
+    int32_t* proc_of_function;  // 函数表下标 → 过程（-1 表示尚未加入）
+
+    // 第二遍
+    RegInstruction* code;
+    uint32_t* origin;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t* address_map;
+    uint32_t* fixups;           // a 中暂存栈式目标地址的跳转指令
+    uint32_t fixup_count;
+    uint32_t fixup_capacity;
+    RegOperand* slots;          // 模拟栈槽位
+    int32_t last_producer;      // 结果可被紧随的 STORE 改写的指令（-1 表示没有）
+    uint32_t locals;            // 当前过程的局部变量数
+} RegGen;
+
+static void gen_fail(RegGen* g, const char* fmt, ...) {
+    if (g->failed) return;
+    g->failed = true;
+    if (g->error_msg && g->error_size > 0) {
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(g->error_msg, g->error_size, fmt, args);
+        va_end(args);
+    }
+}
+
+/**
+ * @brief 栈式运算指令对应的寄存器操作码（不是运算指令返回 ROP_COUNT）
+ */
+static RegOpcode arith_opcode(Opcode op) {
+    switch (op) {
+        case OP_ADD: return ROP_ADD;
+        case OP_SUB: return ROP_SUB;
+        case OP_MUL: return ROP_MUL;
+        case OP_DIV: return ROP_DIV;
+        case OP_MOD: return ROP_MOD;
+        case OP_NEG: return ROP_NEG;
+        case OP_EQ: return ROP_EQ;
+        case OP_NE: return ROP_NE;
+        case OP_LT: return ROP_LT;
+        case OP_LE: return ROP_LE;
+        case OP_GT: return ROP_GT;
+        case OP_GE: return ROP_GE;
+        case OP_AND: return ROP_AND;
+        case OP_OR: return ROP_OR;
+        case OP_XOR: return ROP_XOR;
+        case OP_NOT: return ROP_NOT;
+        case OP_BIT_AND: return ROP_BIT_AND;
+        case OP_BIT_OR: return ROP_BIT_OR;
+        case OP_BIT_XOR: return ROP_BIT_XOR;
+        case OP_BIT_NOT: return ROP_BIT_NOT;
+        case OP_SHL: return ROP_SHL;
+        case OP_SHR: return ROP_SHR;
+        default: return ROP_COUNT;
+    }
+}
+
+static bool is_unary(RegOpcode op) {
+    return op == ROP_NEG || op == ROP_NOT || op == ROP_BIT_NOT;
+}
+
+// ============================================================================
+// 第一遍：过程划分与栈深度
+// ============================================================================
+
+/**
+ * @brief 取得函数对应的过程（首次出现时加入）
+ */
+static int32_t proc_for_function(RegGen* g, uint32_t func_idx) {
+    if (g->proc_of_function[func_idx] >= 0) return g->proc_of_function[func_idx];
+
+    const FunctionEntry* func = &g->module->functions[func_idx];
+    if (func->address >= g->module->instruction_count) {
+        gen_fail(g, "函数 %s 没有可执行代码", func->name ? func->name : "?");
+        return -1;
+    }
+    if (func->param_count < 0 || func->local_count < func->param_count) {
+        gen_fail(g, "函数 %s 的帧布局无效", func->name ? func->name : "?");
+        return -1;
+    }
+    RegProc* proc = &g->procs[g->proc_count];
+    proc->entry = func->address;
+    proc->locals = (uint32_t)func->local_count;
+    proc->function = (int32_t)func_idx;
+    proc->max_depth = 0;
+    g->proc_of_function[func_idx] = (int32_t)g->proc_count;
+    return (int32_t)g->proc_count++;
+}
+
+/**
+ * @brief 记录控制流后继
+ */
+static void visit(RegGen* g, int32_t proc, uint32_t target, int32_t depth, bool leader) {
+    if (target >= g->module->instruction_count) {
+        gen_fail(g, "跳转目标 @%u 越界", target);
+        return;
+    }
+    if (g->owner[target] < 0) {
+        g->owner[target] = proc;
+        g->depth[target] = depth;
+        g->worklist[g->work_count++] = target;
+    } else if (g->owner[target] != proc) {
+        gen_fail(g, "@%u 处的代码被多个函数共用", target);
+        return;
+    } else if (g->depth[target] != depth) {
+        gen_fail(g, "@%u 处汇合的栈深度不一致", target);
+        return;
+    }
+    if (leader) g->leader[target] = true;
+}
+
+/**
+ * @brief 检查变量访问（主程序没有局部变量）
+ */
+static void check_local(RegGen* g, const RegProc* proc, uint32_t pc, Instruction ins, uint32_t index) {
+    if (ins.flags & FLAG_GLOBAL) return;
+    if (index >= proc->locals) {
+        gen_fail(g, proc->function < 0 ? "主程序在 @%u 使用局部变量"
+                                        : "@%u 处的局部变量越界", pc);
+    }
+}
+
+static void check_constant(RegGen* g, uint32_t pc, uint32_t index) {
+    if (index >= g->module->const_count) {
+        gen_fail(g, "@%u 处的常量下标越界", pc);
+    }
+}
+
+/**
+ * @brief 遍历一个过程，求出各指令的栈深度和块首
+ */
+static void analyze_proc(RegGen* g, int32_t p) {
+    const BytecodeModule* module = g->module;
+    uint32_t count = module->instruction_count;
+
+    visit(g, p, g->procs[p].entry, 0, true);
+
+    while (g->work_count > 0 && !g->failed) {
+        uint32_t pc = g->worklist[--g->work_count];
+        Instruction ins = module->instructions[pc];
+        int32_t d = g->depth[pc];
+        int32_t pops = 0, pushes = 0;
+        bool falls = true;
+
+        switch ((Opcode)ins.opcode) {
+            case OP_PUSH:
+                check_constant(g, pc, ins.operand);
+                pushes = 1;
+                break;
+            case OP_POP:
+            case OP_STORE:
+                if (ins.opcode == OP_STORE) check_local(g, &g->procs[p], pc, ins, ins.operand);
+                pops = 1;
+                break;
+            case OP_DUP:
+                pops = 1; pushes = 2;
+                break;
+            case OP_LOAD:
+                check_local(g, &g->procs[p], pc, ins, ins.operand);
+                pushes = 1;
+                break;
+            case OP_NEG: case OP_NOT: case OP_BIT_NOT:
+                pops = 1; pushes = 1;
+                break;
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+            case OP_EQ: case OP_NE: case OP_LT: case OP_LE: case OP_GT: case OP_GE:
+            case OP_AND: case OP_OR: case OP_XOR:
+            case OP_BIT_AND: case OP_BIT_OR: case OP_BIT_XOR: case OP_SHL: case OP_SHR:
+                pops = 2; pushes = 1;
+                break;
+            case OP_JMP:
+                visit(g, p, ins.operand, d, true);
+                falls = false;
+                break;
+            case OP_JZ:
+            case OP_JNZ:
+                pops = 1;
+                if (d >= 1) visit(g, p, ins.operand, d - 1, true);
+                break;
+            case OP_SWITCH: {
+                pops = 1;
+                falls = false;
+                if (ins.operand >= module->switch_table_count) {
+                    gen_fail(g, "@%u 处的跳转表下标越界", pc);
+                    break;
+                }
+                if (d < 1) break;
+                const SwitchTable* table = &module->switch_tables[ins.operand];
+                for (uint32_t i = 0; i < table->count && !g->failed; i++) {
+                    visit(g, p, module->switch_cases[table->first + i].target, d - 1, true);
+                }
+                visit(g, p, table->default_target, d - 1, true);
+                break;
+            }
+            case OP_FOR_INIT:
+            case OP_FOR_STEP: {
+                if (ins.opcode == OP_FOR_INIT) pops = 1;
+                if (ins.operand >= module->for_loop_count) {
+                    gen_fail(g, "@%u 处的循环描述符下标越界", pc);
+                    break;
+                }
+                const ForLoop* loop = &module->for_loops[ins.operand];
+                if ((!(loop->flags & FOR_LOOP_VAR_GLOBAL) && loop->var >= g->procs[p].locals) ||
+                    ((loop->flags & FOR_LOOP_END_VAR) && !(loop->flags & FOR_LOOP_END_GLOBAL) &&
+                     loop->end_var >= g->procs[p].locals)) {
+                    gen_fail(g, "@%u 处的循环变量无效", pc);
+                    break;
+                }
+                // 跳转目标（FOR_INIT 的出口、FOR_STEP 的循环体）执行时经 address_map 换算
+                if (d >= pops) {
+                    visit(g, p, ins.opcode == OP_FOR_INIT ? loop->exit : loop->body, d - pops, true);
+                }
+                break;
+            }
+            case OP_CALL: {
+                if (ins.operand >= module->function_count) {
+                    gen_fail(g, "@%u 处的函数下标越界", pc);
+                    break;
+                }
+                const FunctionEntry* func = &module->functions[ins.operand];
+                if (proc_for_function(g, ins.operand) < 0) break;
+                pops = func->param_count;
+                pushes = func->return_type != TYPE_VOID ? 1 : 0;
+                break;
+            }
+            case OP_CALL_EXT:
+                if (ins.operand >= module->function_count) {
+                    gen_fail(g, "@%u 处的函数下标越界", pc);
+                    break;
+                }
+                pops = ins.flags;
+                pushes = module->functions[ins.operand].return_type != TYPE_VOID ? 1 : 0;
+                break;
+            case OP_RET:
+            case OP_HALT:
+                falls = false;
+                break;
+            case OP_NOP:
+                break;
+            case OP_LOAD_INDEXED:
+                pops = 1; pushes = 1;
+                break;
+            case OP_STORE_INDEXED:
+                pops = 2;
+                break;
+            case OP_LOAD_ARRAY:
+            case OP_STORE_ARRAY:
+                if (ins.operand >= module->array_bound_count) {
+                    gen_fail(g, "@%u 处的数组描述符下标越界", pc);
+                    break;
+                }
+                pops = ins.opcode == OP_LOAD_ARRAY ? 1 : 2;
+                pushes = ins.opcode == OP_LOAD_ARRAY ? 1 : 0;
+                break;
+            case OP_LOAD_VAL:
+            case OP_LOAD_QUALITY:
+                check_local(g, &g->procs[p], pc, ins, ins.operand);
+                pushes = 1;
+                break;
+            case OP_STORE_VAL:
+            case OP_STORE_QUALITY:
+                check_local(g, &g->procs[p], pc, ins, ins.operand);
+                pops = 1;
+                break;
+            case OP_IO_READ:
+                check_constant(g, pc, ins.operand);
+                pushes = 1;
+                break;
+            case OP_IO_WRITE:
+                check_constant(g, pc, ins.operand);
+                pops = 1;
+                break;
+            default:
+                gen_fail(g, "@%u 处的操作码 %u 无效", pc, ins.opcode);
+                break;
+        }
+        if (g->failed) break;
+        if (d < pops) {
+            gen_fail(g, "@%u 处栈下溢", pc);
+            break;
+        }
+
+        int32_t after = d - pops + pushes;
+        if ((uint32_t)after > g->procs[p].max_depth) g->procs[p].max_depth = (uint32_t)after;
+        if (falls && pc + 1 < count) {
+            visit(g, p, pc + 1, after, false);
+        }
+    }
+}
+
+// ============================================================================
+// 第二遍：生成寄存器指令
+// ============================================================================
+
+static bool ensure_code(RegGen* g) {
+    if (g->count < g->capacity) return true;
+    uint32_t capacity = g->capacity ? g->capacity * 2 : 256;
+    RegInstruction* code = (RegInstruction*)mmgr_realloc(g->code, sizeof(RegInstruction) * capacity);
+    if (!code) return false;
+    g->code = code;
+    uint32_t* origin = (uint32_t*)mmgr_realloc(g->origin, sizeof(uint32_t) * capacity);
+    if (!origin) return false;
+    g->origin = origin;
+    g->capacity = capacity;
+    return true;
+}
+
+static uint32_t emit(RegGen* g, RegOpcode op, uint8_t flags, uint16_t a, uint16_t b, uint16_t c, uint32_t pc) {
+    g->last_producer = -1;
+    if (g->failed) return 0;
+    if (!ensure_code(g)) {
+        gen_fail(g, "内存不足");
+        return 0;
+    }
+    RegInstruction* ins = &g->code[g->count];
+    ins->opcode = (uint8_t)op;
+    ins->flags = flags;
+    ins->a = a;
+    ins->b = b;
+    ins->c = c;
+    g->origin[g->count] = pc;
+    return g->count++;
+}
+
+/**
+ * @brief 生成跳转（a 暂存栈式目标，全部过程翻译完后换算）
+ */
+static void emit_jump(RegGen* g, RegOpcode op, uint8_t flags, uint32_t target,
+                      uint16_t b, uint16_t c, uint32_t pc) {
+    uint32_t index = emit(g, op, flags, (uint16_t)target, b, c, pc);
+    if (g->failed) return;
+    if (g->fixup_count >= g->fixup_capacity) {
+        uint32_t capacity = g->fixup_capacity ? g->fixup_capacity * 2 : 64;
+        uint32_t* fixups = (uint32_t*)mmgr_realloc(g->fixups, sizeof(uint32_t) * capacity);
+        if (!fixups) {
+            gen_fail(g, "内存不足");
+            return;
+        }
+        g->fixups = fixups;
+        g->fixup_capacity = capacity;
+    }
+    g->fixups[g->fixup_count++] = index;
+}
+
+static uint16_t temp(const RegGen* g, uint32_t depth) {
+    return (uint16_t)(g->locals + depth);
+}
+
+static bool slot_is(const RegOperand* s, uint8_t kind, uint16_t index) {
+    return s->kind == kind && s->index == index;
+}
+
+/**
+ * @brief 把槽位落到对应的临时寄存器
+ */
+static void materialize(RegGen* g, uint32_t depth, uint32_t pc) {
+    RegOperand* s = &g->slots[depth];
+    if (slot_is(s, REG_KIND_REG, temp(g, depth))) return;
+    emit(g, ROP_MOVE, REG_FLAGS(s->kind, REG_KIND_REG), temp(g, depth), s->index, 0, pc);
+    s->kind = REG_KIND_REG;
+    s->index = temp(g, depth);
+}
+
+/**
+ * @brief 把深度 depth 以下的所有槽位落到临时寄存器
+ */
+static void flush(RegGen* g, uint32_t depth, uint32_t pc) {
+    for (uint32_t i = 0; i < depth; i++) {
+        materialize(g, i, pc);
+    }
+}
+
+/**
+ * @brief 变量即将被改写：引用它的槽位先落到临时寄存器
+ */
+static void materialize_aliases(RegGen* g, uint32_t depth, uint8_t kind, uint16_t index, uint32_t pc) {
+    for (uint32_t i = 0; i < depth; i++) {
+        if (slot_is(&g->slots[i], kind, index)) materialize(g, i, pc);
+    }
+}
+
+/**
+ * @brief 生成结果写入深度 depth 的临时寄存器的指令
+ */
+static void produce(RegGen* g, RegOpcode op, uint8_t flags, uint32_t depth,
+                    uint16_t b, uint16_t c, uint32_t pc) {
+    uint32_t index = emit(g, op, flags, temp(g, depth), b, c, pc);
+    if (g->failed) return;
+    g->slots[depth].kind = REG_KIND_REG;
+    g->slots[depth].index = temp(g, depth);
+    g->last_producer = (int32_t)index;
+}
+
+static void translate_store(RegGen* g, uint32_t d, uint8_t kind, uint16_t index, uint32_t pc) {
+    RegOperand value = g->slots[d - 1];
+
+    // 上一条指令的结果正在被存储：直接改写其目标
+    if (g->last_producer >= 0 && slot_is(&value, REG_KIND_REG, temp(g, d - 1))) {
+        RegInstruction* prev = &g->code[g->last_producer];
+        bool aliased = false;
+        for (uint32_t i = 0; i + 1 < d; i++) {
+            if (slot_is(&g->slots[i], kind, index)) aliased = true;
+        }
+        if (prev->a == temp(g, d - 1) && !(prev->flags & REG_FLAG_DEST_GLOBAL) && !aliased) {
+            prev->a = index;
+            if (kind == REG_KIND_GLOBAL) prev->flags |= REG_FLAG_DEST_GLOBAL;
+            g->last_producer = -1;
+            return;
+        }
+    }
+
+    materialize_aliases(g, d - 1, kind, index, pc);
+    if (slot_is(&value, kind, index)) return;
+    emit(g, ROP_MOVE, (uint8_t)(REG_FLAGS(value.kind, REG_KIND_REG) |
+                                (kind == REG_KIND_GLOBAL ? REG_FLAG_DEST_GLOBAL : 0)),
+         index, value.index, 0, pc);
+}
+
+/**
+ * @brief 翻译一个过程（owned 为该过程拥有的指令地址，升序）
+ */
+static void translate_proc(RegGen* g, int32_t p, const uint32_t* owned, uint32_t owned_count) {
+    const BytecodeModule* module = g->module;
+    g->locals = g->procs[p].locals;
+    g->last_producer = -1;
+    uint32_t d = 0;
+    bool falls_in = false;
+
+    for (uint32_t k = 0; k < owned_count && !g->failed; k++) {
+        uint32_t pc = owned[k];
+        Instruction ins = module->instructions[pc];
+
+        if (g->leader[pc]) {
+            if (falls_in) flush(g, d, pc);
+            d = (uint32_t)g->depth[pc];
+            for (uint32_t i = 0; i < d; i++) {
+                g->slots[i].kind = REG_KIND_REG;
+                g->slots[i].index = temp(g, i);
+            }
+            g->address_map[pc] = g->count;
+            g->last_producer = -1;
+        }
+        falls_in = true;
+
+        uint8_t var_kind = (ins.flags & FLAG_GLOBAL) ? REG_KIND_GLOBAL : REG_KIND_REG;
+        RegOpcode rop = arith_opcode((Opcode)ins.opcode);
+        if (rop != ROP_COUNT) {
+            if (is_unary(rop)) {
+                RegOperand x = g->slots[d - 1];
+                produce(g, rop, REG_FLAGS(x.kind, REG_KIND_REG), d - 1, x.index, 0, pc);
+            } else {
+                RegOperand x = g->slots[d - 2], y = g->slots[d - 1];
+                produce(g, rop, REG_FLAGS(x.kind, y.kind), d - 2, x.index, y.index, pc);
+                d--;
+            }
+            continue;
+        }
+
+        switch ((Opcode)ins.opcode) {
+            case OP_PUSH:
+                g->slots[d].kind = REG_KIND_CONST;
+                g->slots[d].index = ins.operand;
+                d++;
+                break;
+            case OP_LOAD:
+                g->slots[d].kind = var_kind;
+                g->slots[d].index = ins.operand;
+                d++;
+                break;
+            case OP_DUP:
+                g->slots[d] = g->slots[d - 1];
+                d++;
+                break;
+            case OP_POP:
+                d--;
+                break;
+            case OP_NOP:
+                break;
+            case OP_STORE:
+                translate_store(g, d, var_kind, ins.operand, pc);
+                d--;
+                break;
+            case OP_JMP:
+                flush(g, d, pc);
+                if (k + 1 < owned_count && owned[k + 1] == ins.operand) break;
+                emit_jump(g, ROP_JMP, 0, ins.operand, 0, 0, pc);
+                falls_in = false;
+                break;
+            case OP_JZ:
+            case OP_JNZ: {
+                RegOperand cond = g->slots[d - 1];
+                d--;
+                if (g->last_producer >= 0 && slot_is(&cond, REG_KIND_REG, temp(g, d))) {
+                    RegInstruction cmp = g->code[g->last_producer];
+                    if (cmp.opcode >= ROP_EQ && cmp.opcode <= ROP_GE && cmp.a == temp(g, d) &&
+                        !(cmp.flags & REG_FLAG_DEST_GLOBAL)) {
+                        // 比较结果只被这次跳转使用：合并为比较跳转
+                        g->count--;
+                        flush(g, d, pc);
+                        uint8_t flags = (uint8_t)((cmp.flags & 0x0F) |
+                                                  ((cmp.opcode - ROP_EQ) << REG_CMP_SHIFT));
+                        emit_jump(g, ins.opcode == OP_JZ ? ROP_JCMPZ : ROP_JCMPNZ, flags,
+                                  ins.operand, cmp.b, cmp.c, pc);
+                        break;
+                    }
+                }
+                flush(g, d, pc);
+                emit_jump(g, ins.opcode == OP_JZ ? ROP_JZ : ROP_JNZ,
+                          REG_FLAGS(cond.kind, REG_KIND_REG), ins.operand, cond.index, 0, pc);
+                break;
+            }
+            case OP_SWITCH: {
+                RegOperand sel = g->slots[d - 1];
+                d--;
+                flush(g, d, pc);
+                emit(g, ROP_SWITCH, REG_FLAGS(sel.kind, REG_KIND_REG), ins.operand, sel.index, 0, pc);
+                falls_in = false;
+                break;
+            }
+            case OP_FOR_INIT: {
+                RegOperand start = g->slots[d - 1];
+                d--;
+                flush(g, d, pc);
+                emit(g, ROP_FOR_INIT, REG_FLAGS(start.kind, REG_KIND_REG), ins.operand, start.index, 0, pc);
+                break;
+            }
+            case OP_FOR_STEP:
+                flush(g, d, pc);
+                emit(g, ROP_FOR_STEP, 0, ins.operand, 0, 0, pc);
+                break;
+            case OP_CALL: {
+                const FunctionEntry* func = &module->functions[ins.operand];
+                flush(g, d, pc);
+                d -= (uint32_t)func->param_count;
+                emit(g, ROP_CALL, 0, temp(g, d), ins.operand, 0, pc);
+                if (func->return_type != TYPE_VOID) d++;
+                break;
+            }
+            case OP_CALL_EXT:
+                flush(g, d, pc);
+                d -= ins.flags;
+                emit(g, ROP_CALL_EXT, 0, temp(g, d), ins.operand, ins.flags, pc);
+                if (module->functions[ins.operand].return_type != TYPE_VOID) d++;
+                break;
+            case OP_RET:
+                if (g->procs[p].function < 0) flush(g, d, pc);
+                emit(g, ROP_RET, 0, g->procs[p].function < 0 ? temp(g, d) : 0, 0, 0, pc);
+                falls_in = false;
+                break;
+            case OP_HALT:
+                flush(g, d, pc);
+                emit(g, ROP_HALT, 0, temp(g, d), 0, 0, pc);
+                falls_in = false;
+                break;
+            case OP_LOAD_INDEXED: {
+                RegOperand index = g->slots[d - 1];
+                produce(g, ROP_LOAD_INDEXED,
+                        (uint8_t)(REG_FLAGS(REG_KIND_REG, index.kind) |
+                                  ((ins.flags & FLAG_GLOBAL) ? REG_FLAG_VAR_GLOBAL : 0)),
+                        d - 1, ins.operand, index.index, pc);
+                break;
+            }
+            case OP_STORE_INDEXED: {
+                RegOperand value = g->slots[d - 2], index = g->slots[d - 1];
+                d -= 2;
+                flush(g, d, pc);
+                emit(g, ROP_STORE_INDEXED,
+                     (uint8_t)(REG_FLAGS(value.kind, index.kind) |
+                               ((ins.flags & FLAG_GLOBAL) ? REG_FLAG_VAR_GLOBAL : 0)),
+                     ins.operand, value.index, index.index, pc);
+                break;
+            }
+            case OP_LOAD_ARRAY: {
+                RegOperand index = g->slots[d - 1];
+                produce(g, ROP_LOAD_ARRAY,
+                        (uint8_t)(REG_FLAGS(REG_KIND_REG, index.kind) |
+                                  ((ins.flags & FLAG_UNCHECKED) ? REG_FLAG_UNCHECKED : 0)),
+                        d - 1, ins.operand, index.index, pc);
+                break;
+            }
+            case OP_STORE_ARRAY: {
+                RegOperand value = g->slots[d - 2], index = g->slots[d - 1];
+                d -= 2;
+                flush(g, d, pc);
+                emit(g, ROP_STORE_ARRAY,
+                     (uint8_t)(REG_FLAGS(value.kind, index.kind) |
+                               ((ins.flags & FLAG_UNCHECKED) ? REG_FLAG_UNCHECKED : 0)),
+                     ins.operand, value.index, index.index, pc);
+                break;
+            }
+            case OP_LOAD_VAL:
+            case OP_LOAD_QUALITY:
+                produce(g, ins.opcode == OP_LOAD_VAL ? ROP_LOAD_VAL : ROP_LOAD_QUALITY,
+                        (ins.flags & FLAG_GLOBAL) ? REG_FLAG_VAR_GLOBAL : 0,
+                        d, ins.operand, 0, pc);
+                d++;
+                break;
+            case OP_STORE_VAL:
+            case OP_STORE_QUALITY: {
+                RegOperand value = g->slots[d - 1];
+                d--;
+                materialize_aliases(g, d, var_kind, ins.operand, pc);
+                emit(g, ins.opcode == OP_STORE_VAL ? ROP_STORE_VAL : ROP_STORE_QUALITY,
+                     (uint8_t)(REG_FLAGS(value.kind, REG_KIND_REG) |
+                               ((ins.flags & FLAG_GLOBAL) ? REG_FLAG_VAR_GLOBAL : 0)),
+                     ins.operand, value.index, 0, pc);
+                break;
+            }
+            case OP_IO_READ:
+                produce(g, ROP_IO_READ, 0, d, ins.operand, 0, pc);
+                d++;
+                break;
+            case OP_IO_WRITE: {
+                RegOperand value = g->slots[d - 1];
+                d--;
+                emit(g, ROP_IO_WRITE, REG_FLAGS(value.kind, REG_KIND_REG), ins.operand, value.index, 0, pc);
+                break;
+            }
+            default:
+                gen_fail(g, "@%u 处的操作码 %u 无效", pc, ins.opcode);
+                break;
+        }
+
+        // 顺序执行到代码末尾：与栈式解释循环一样停机
+        if (falls_in && pc + 1 >= module->instruction_count) {
+            flush(g, d, pc);
+            emit(g, ROP_HALT, 0, temp(g, d), 0, 0, pc);
+            falls_in = false;
+        }
+    }
+}
+
+static void gen_cleanup(RegGen* g) {
+    mmgr_free(g->depth);
+    mmgr_free(g->owner);
+    mmgr_free(g->leader);
+    mmgr_free(g->worklist);
+    mmgr_free(g->procs);
+    mmgr_free(g->proc_of_function);
+    mmgr_free(g->code);
+    mmgr_free(g->origin);
+    mmgr_free(g->address_map);
+    mmgr_free(g->fixups);
+    mmgr_free(g->slots);
+}
+
+static ErrorCode attach_code(BytecodeModule* module, RegCode* rc);
+
+ErrorCode regcode_generate(BytecodeModule* module, char* error_msg, size_t size) {
+    if (!module) return ERR_RUNTIME;
+    regcode_discard(module);
+
+    RegGen g;
+    memset(&g, 0, sizeof(g));
+    g.module = module;
+    g.error_msg = error_msg;
+    g.error_size = size;
+
+    uint32_t count = module->instruction_count;
+    if (count == 0 || module->entry_point >= count) {
+        gen_fail(&g, "模块没有可执行代码");
+        return ERR_INVALID_BYTECODE;
+    }
+
+    g.depth = (int32_t*)mmgr_alloc(sizeof(int32_t) * count);
+    g.owner = (int32_t*)mmgr_alloc(sizeof(int32_t) * count);
+    g.leader = (bool*)mmgr_calloc(sizeof(bool) * count);
+    g.worklist = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * count);
+    g.procs = (RegProc*)mmgr_alloc(sizeof(RegProc) * (module->function_count + 1));
+    g.proc_of_function = (int32_t*)mmgr_alloc(sizeof(int32_t) * (module->function_count + 1));
+    g.address_map = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * count);
+    if (!g.depth || !g.owner || !g.leader || !g.worklist || !g.procs ||
+        !g.proc_of_function || !g.address_map) {
+        gen_cleanup(&g);
+        return ERR_OUT_OF_MEMORY;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        g.owner[i] = -1;
+        g.address_map[i] = REG_NO_ADDRESS;
+    }
+    for (uint32_t i = 0; i < module->function_count; i++) {
+        g.proc_of_function[i] = -1;
+    }
+
+    // 第一遍：主程序和可达的函数（分析过程中加入）
+    g.procs[0].entry = module->entry_point;
+    g.procs[0].locals = 0;
+    g.procs[0].function = -1;
+    g.procs[0].max_depth = 0;
+    g.proc_count = 1;
+    for (uint32_t p = 0; p < g.proc_count && !g.failed; p++) {
+        analyze_proc(&g, (int32_t)p);
+        if (g.procs[p].locals + g.procs[p].max_depth > UINT16_MAX) {
+            gen_fail(&g, "帧大小超过寄存器编号范围");
+        }
+    }
+
+    // 第二遍：按地址顺序翻译各过程，主程序在前
+    uint32_t max_depth = 0;
+    for (uint32_t p = 0; p < g.proc_count; p++) {
+        if (g.procs[p].max_depth > max_depth) max_depth = g.procs[p].max_depth;
+    }
+    uint32_t* owned = NULL;
+    if (!g.failed) {
+        g.slots = (RegOperand*)mmgr_alloc(sizeof(RegOperand) * (max_depth + 1));
+        owned = (uint32_t*)mmgr_alloc(sizeof(uint32_t) * count);
+        if (!g.slots || !owned) gen_fail(&g, "内存不足");
+    }
+    for (uint32_t p = 0; p < g.proc_count && !g.failed; p++) {
+        uint32_t owned_count = 0;
+        for (uint32_t pc = 0; pc < count; pc++) {
+            if (g.owner[pc] == (int32_t)p) owned[owned_count++] = pc;
+        }
+        translate_proc(&g, (int32_t)p, owned, owned_count);
+    }
+    mmgr_free(owned);
+
+    if (!g.failed && g.count > UINT16_MAX) {
+        gen_fail(&g, "寄存器代码超过 %u 条指令", UINT16_MAX);
+    }
+    for (uint32_t i = 0; i < g.fixup_count && !g.failed; i++) {
+        RegInstruction* ins = &g.code[g.fixups[i]];
+        ins->a = (uint16_t)g.address_map[ins->a];
+    }
+
+    RegCode* rc = NULL;
+    if (!g.failed) {
+        rc = (RegCode*)mmgr_calloc(sizeof(RegCode));
+        RegFunction* functions = module->function_count > 0 ?
+            (RegFunction*)mmgr_alloc(sizeof(RegFunction) * module->function_count) : NULL;
+        if (!rc || (module->function_count > 0 && !functions)) {
+            mmgr_free(rc);
+            mmgr_free(functions);
+            gen_cleanup(&g);
+            return ERR_OUT_OF_MEMORY;
+        }
+        for (uint32_t i = 0; i < module->function_count; i++) {
+            functions[i].address = REG_NO_ADDRESS;
+            functions[i].frame_size = 0;
+        }
+        for (uint32_t p = 1; p < g.proc_count; p++) {
+            RegFunction* f = &functions[g.procs[p].function];
+            f->address = g.address_map[g.procs[p].entry];
+            f->frame_size = g.procs[p].locals + g.procs[p].max_depth;
+        }
+        rc->code = g.code;
+        rc->count = g.count;
+        rc->origin = g.origin;
+        rc->functions = functions;
+        rc->function_count = module->function_count;
+        rc->main_entry = g.address_map[module->entry_point];
+        rc->main_frame_size = g.procs[0].max_depth;
+        rc->address_map = g.address_map;
+        rc->map_count = count;
+        g.code = NULL;
+        g.origin = NULL;
+        g.address_map = NULL;
+    }
+    gen_cleanup(&g);
+    if (!rc) return ERR_INVALID_BYTECODE;
+
+    ErrorCode err = attach_code(module, rc);
+    if (err != OK) {
+        if (error_msg && size > 0) snprintf(error_msg, size, "生成的寄存器代码未通过校验");
+        regcode_free(rc);
+        return ERR_INVALID_BYTECODE;
+    }
+    return OK;
+}
+
+// ============================================================================
+// 校验与挂载
+// ============================================================================
+
+/**
+ * @brief 寄存器代码中的函数区段
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t frame_size;
+} RegRegion;
+
+static int compare_regions(const void* a, const void* b) {
+    uint32_t x = ((const RegRegion*)a)->start, y = ((const RegRegion*)b)->start;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static bool check_source(const BytecodeModule* module, uint8_t kind, uint16_t index, uint32_t frame_size) {
+    switch (kind) {
+        case REG_KIND_REG: return index < frame_size;
+        case REG_KIND_CONST: return index < module->const_count;
+        case REG_KIND_GLOBAL: return true;    // 执行时检查
+        default: return false;
+    }
+}
+
+static bool check_target(const RegCode* rc, const RegRegion* region, uint32_t target) {
+    if (target >= rc->map_count) return false;
+    uint32_t address = rc->address_map[target];
+    return address != REG_NO_ADDRESS && address >= region->start && address < region->end;
+}
+
+/**
+ * @brief 校验一条指令
+ */
+static bool check_instruction(const BytecodeModule* module, const RegCode* rc,
+                              const RegRegion* region, const RegInstruction* ins) {
+    uint32_t frame = region->frame_size;
+    uint8_t kb = REG_KIND_B(ins->flags), kc = REG_KIND_C(ins->flags);
+    bool dest_ok = (ins->flags & REG_FLAG_DEST_GLOBAL) || ins->a < frame;
+
+    switch ((RegOpcode)ins->opcode) {
+        case ROP_MOVE:
+        case ROP_NEG: case ROP_NOT: case ROP_BIT_NOT:
+            return dest_ok && check_source(module, kb, ins->b, frame);
+        case ROP_ADD: case ROP_SUB: case ROP_MUL: case ROP_DIV: case ROP_MOD:
+        case ROP_EQ: case ROP_NE: case ROP_LT: case ROP_LE: case ROP_GT: case ROP_GE:
+        case ROP_AND: case ROP_OR: case ROP_XOR:
+        case ROP_BIT_AND: case ROP_BIT_OR: case ROP_BIT_XOR: case ROP_SHL: case ROP_SHR:
+            return dest_ok && check_source(module, kb, ins->b, frame) &&
+                   check_source(module, kc, ins->c, frame);
+        case ROP_JMP:
+            return ins->a >= region->start && ins->a < region->end;
+        case ROP_JZ:
+        case ROP_JNZ:
+            return ins->a >= region->start && ins->a < region->end &&
+                   check_source(module, kb, ins->b, frame);
+        case ROP_JCMPZ:
+        case ROP_JCMPNZ:
+            return ins->a >= region->start && ins->a < region->end &&
+                   (ins->flags >> REG_CMP_SHIFT) <= (OP_GE - OP_EQ) &&
+                   check_source(module, kb, ins->b, frame) && check_source(module, kc, ins->c, frame);
+        case ROP_SWITCH: {
+            if (ins->a >= module->switch_table_count || !check_source(module, kb, ins->b, frame)) {
+                return false;
+            }
+            const SwitchTable* table = &module->switch_tables[ins->a];
+            if (!check_target(rc, region, table->default_target)) return false;
+            for (uint32_t i = 0; i < table->count; i++) {
+                if (!check_target(rc, region, module->switch_cases[table->first + i].target)) return false;
+            }
+            return true;
+        }
+        case ROP_FOR_INIT:
+        case ROP_FOR_STEP: {
+            if (ins->a >= module->for_loop_count) return false;
+            if (ins->opcode == ROP_FOR_INIT && !check_source(module, kb, ins->b, frame)) return false;
+            const ForLoop* loop = &module->for_loops[ins->a];
+            return check_target(rc, region, ins->opcode == ROP_FOR_INIT ? loop->exit : loop->body);
+        }
+        case ROP_CALL: {
+            if (ins->b >= rc->function_count || rc->functions[ins->b].address == REG_NO_ADDRESS) {
+                return false;
+            }
+            const FunctionEntry* func = &module->functions[ins->b];
+            uint32_t args = (uint32_t)func->param_count;
+            if (func->return_type != TYPE_VOID && args == 0) args = 1;
+            return (uint32_t)ins->a + args <= frame;
+        }
+        case ROP_CALL_EXT: {
+            if (ins->b >= module->function_count) return false;
+            uint32_t args = ins->c;
+            if (module->functions[ins->b].return_type != TYPE_VOID && args == 0) args = 1;
+            return (uint32_t)ins->a + args <= frame;
+        }
+        case ROP_RET:
+        case ROP_HALT:
+            return ins->a <= frame;
+        case ROP_LOAD_INDEXED:
+            return dest_ok && check_source(module, kc, ins->c, frame);
+        case ROP_STORE_INDEXED:
+            return check_source(module, kb, ins->b, frame) && check_source(module, kc, ins->c, frame);
+        case ROP_LOAD_ARRAY:
+            return dest_ok && ins->b < module->array_bound_count && check_source(module, kc, ins->c, frame);
+        case ROP_STORE_ARRAY:
+            return ins->a < module->array_bound_count &&
+                   check_source(module, kb, ins->b, frame) && check_source(module, kc, ins->c, frame);
+        case ROP_LOAD_VAL:
+        case ROP_LOAD_QUALITY:
+            return dest_ok;
+        case ROP_STORE_VAL:
+        case ROP_STORE_QUALITY:
+            return check_source(module, kb, ins->b, frame);
+        case ROP_IO_READ:
+            return dest_ok && ins->b < module->const_count;
+        case ROP_IO_WRITE:
+            return ins->a < module->const_count && check_source(module, kb, ins->b, frame);
+        default:
+            return false;
+    }
+}
+
+static bool is_terminator(uint8_t opcode) {
+    return opcode == ROP_JMP || opcode == ROP_RET || opcode == ROP_HALT || opcode == ROP_SWITCH;
+}
+
+static ErrorCode attach_code(BytecodeModule* module, RegCode* rc) {
+    if (!module || !rc || !rc->code) return ERR_INVALID_BYTECODE;
+    if (rc->count == 0 || rc->count > UINT16_MAX || rc->map_count != module->instruction_count ||
+        rc->function_count != module->function_count || rc->main_frame_size > UINT16_MAX) {
+        return ERR_INVALID_BYTECODE;
+    }
+    for (uint32_t i = 0; i < rc->map_count; i++) {
+        if (rc->address_map[i] != REG_NO_ADDRESS && rc->address_map[i] >= rc->count) {
+            return ERR_INVALID_BYTECODE;
+        }
+    }
+
+    // 区段：主程序从 0 开始，每个已翻译的函数一段
+    RegRegion* regions = (RegRegion*)mmgr_alloc(sizeof(RegRegion) * (rc->function_count + 1));
+    if (!regions) return ERR_OUT_OF_MEMORY;
+    uint32_t region_count = 0;
+    regions[region_count].start = 0;
+    regions[region_count++].frame_size = rc->main_frame_size;
+    ErrorCode err = OK;
+    for (uint32_t i = 0; i < rc->function_count; i++) {
+        const RegFunction* f = &rc->functions[i];
+        if (f->address == REG_NO_ADDRESS) continue;
+        const FunctionEntry* func = &module->functions[i];
+        if (f->address == 0 || f->address >= rc->count || f->frame_size > UINT16_MAX ||
+            func->param_count < 0 || func->local_count < func->param_count ||
+            f->frame_size < (uint32_t)func->local_count) {
+            err = ERR_INVALID_BYTECODE;
+            break;
+        }
+        regions[region_count].start = f->address;
+        regions[region_count++].frame_size = f->frame_size;
+    }
+    if (err == OK) {
+        qsort(regions, region_count, sizeof(RegRegion), compare_regions);
+        for (uint32_t r = 0; r < region_count; r++) {
+            regions[r].end = r + 1 < region_count ? regions[r + 1].start : rc->count;
+            if (regions[r].end <= regions[r].start) err = ERR_INVALID_BYTECODE;
+        }
+    }
+    if (err == OK && (region_count > 1 ? rc->main_entry >= regions[1].start : rc->main_entry >= rc->count)) {
+        err = ERR_INVALID_BYTECODE;
+    }
+    for (uint32_t r = 0; r < region_count && err == OK; r++) {
+        const RegRegion* region = &regions[r];
+        if (!is_terminator(rc->code[region->end - 1].opcode)) {
+            err = ERR_INVALID_BYTECODE;
+            break;
+        }
+        for (uint32_t i = region->start; i < region->end; i++) {
+            if (rc->origin[i] >= rc->map_count ||
+                !check_instruction(module, rc, region, &rc->code[i])) {
+                err = ERR_INVALID_BYTECODE;
+                break;
+            }
+        }
+    }
+    mmgr_free(regions);
+    if (err != OK) return err;
+
+    // 常量按 OP_PUSH 的方式转换为 Value
+    Value* constants = NULL;
+    if (module->const_count > 0) {
+        constants = (Value*)mmgr_calloc(sizeof(Value) * module->const_count);
+        if (!constants) return ERR_OUT_OF_MEMORY;
+        for (uint32_t i = 0; i < module->const_count; i++) {
+            const Constant* c = &module->constants[i];
+            Value* v = &constants[i];
+            switch (c->type) {
+                case CONST_INT: v->type = TYPE_INT; v->int_val = c->int_val; break;
+                case CONST_REAL: v->type = TYPE_REAL; v->real_val = c->real_val; break;
+                case CONST_BOOL: v->type = TYPE_BOOL; v->bool_val = c->bool_val; break;
+                case CONST_STRING: v->type = TYPE_STRING; v->string_val = c->string_val; break;
+                default: v->type = TYPE_VOID; break;
+            }
+        }
+    }
+    mmgr_free(rc->constants);
+    rc->constants = constants;
+
+    if (module->reg_code && module->reg_code != rc) regcode_free(module->reg_code);
+    module->reg_code = rc;
+    return OK;
+}
+
+/**
+ * @brief 校验免检的数组访问
+ * 
+ * 栈式代码的免检标记已由 bytecode_verify_arrays 重新证明，但寄存器指令的下标操作数
+ * 无法单独核对来源，所以整段代码须与按栈式代码重新生成的结果一致，否则全部改为检查边界。
+ */
+static void verify_unchecked(BytecodeModule* module, RegCode* rc) {
+    bool has_unchecked = false;
+    for (uint32_t i = 0; i < rc->count && !has_unchecked; i++) {
+        has_unchecked = (rc->code[i].opcode == ROP_LOAD_ARRAY || rc->code[i].opcode == ROP_STORE_ARRAY) &&
+                        (rc->code[i].flags & REG_FLAG_UNCHECKED);
+    }
+    if (!has_unchecked) return;
+
+    bool same = false;
+    RegCode* saved = module->reg_code;
+    module->reg_code = NULL;
+    if (regcode_generate(module, NULL, 0) == OK) {
+        const RegCode* fresh = module->reg_code;
+        same = fresh->count == rc->count &&
+               memcmp(fresh->code, rc->code, sizeof(RegInstruction) * rc->count) == 0;
+        regcode_discard(module);
+    }
+    module->reg_code = saved;
+    if (same) return;
+
+    for (uint32_t i = 0; i < rc->count; i++) {
+        if (rc->code[i].opcode == ROP_LOAD_ARRAY || rc->code[i].opcode == ROP_STORE_ARRAY) {
+            rc->code[i].flags &= (uint8_t)~REG_FLAG_UNCHECKED;
+        }
+    }
+}
+
+ErrorCode regcode_attach(BytecodeModule* module, RegCode* rc) {
+    if (!module || !rc || !rc->code) return ERR_INVALID_BYTECODE;
+    verify_unchecked(module, rc);
+    return attach_code(module, rc);
+}
+
+void regcode_discard(BytecodeModule* module) {
+    if (!module || !module->reg_code) return;
+    regcode_free(module->reg_code);
+    module->reg_code = NULL;
+}
+
+void regcode_free(RegCode* rc) {
+    if (!rc) return;
+    mmgr_free(rc->code);
+    mmgr_free(rc->origin);
+    mmgr_free(rc->functions);
+    mmgr_free(rc->address_map);
+    mmgr_free(rc->constants);
+    mmgr_free(rc);
+}
+
+// ============================================================================
+// 打印
+// ============================================================================
+
+static const char* reg_opcode_names[ROP_COUNT] = {
+    "MOVE",
+    "ADD", "SUB", "MUL", "DIV", "MOD", "NEG",
+    "EQ", "NE", "LT", "LE", "GT", "GE",
+    "AND", "OR", "XOR", "NOT",
+    "BIT_AND", "BIT_OR", "BIT_XOR", "BIT_NOT", "SHL", "SHR",
+    "JMP", "JZ", "JNZ", "JCMPZ", "JCMPNZ", "SWITCH", "FOR_INIT", "FOR_STEP",
+    "CALL", "CALL_EXT", "RET", "HALT",
+    "LOAD_IDX", "STORE_IDX", "LOAD_VAL", "LOAD_Q", "STORE_VAL", "STORE_Q", "IO_READ", "IO_WRITE",
+    "LOAD_ARR", "STORE_ARR"
+};
+
+const char* regcode_opcode_name(uint8_t opcode) {
+    return opcode < ROP_COUNT ? reg_opcode_names[opcode] : "???";
+}
+
+static void format_operand(char* buf, size_t size, uint8_t kind, uint16_t index) {
+    switch (kind) {
+        case REG_KIND_REG: snprintf(buf, size, "r%u", index); break;
+        case REG_KIND_CONST: snprintf(buf, size, "#%u", index); break;
+        case REG_KIND_GLOBAL: snprintf(buf, size, "g%u", index); break;
+        default: snprintf(buf, size, "?%u", index); break;
+    }
+}
+
+static void print_instruction(const RegInstruction* ins) {
+    char a[16], b[16], c[16];
+    char var = (ins->flags & REG_FLAG_VAR_GLOBAL) ? 'g' : 'r';
+    format_operand(a, sizeof(a), (ins->flags & REG_FLAG_DEST_GLOBAL) ? REG_KIND_GLOBAL : REG_KIND_REG, ins->a);
+    format_operand(b, sizeof(b), REG_KIND_B(ins->flags), ins->b);
+    format_operand(c, sizeof(c), REG_KIND_C(ins->flags), ins->c);
+    printf("%-9s ", regcode_opcode_name(ins->opcode));
+
+    switch ((RegOpcode)ins->opcode) {
+        case ROP_MOVE: case ROP_NEG: case ROP_NOT: case ROP_BIT_NOT:
+            printf("%s, %s", a, b);
+            break;
+        case ROP_JMP:
+            printf("@%u", ins->a);
+            break;
+        case ROP_JZ: case ROP_JNZ:
+            printf("%s, @%u", b, ins->a);
+            break;
+        case ROP_JCMPZ: case ROP_JCMPNZ:
+            printf("%s %s %s, @%u", b, opcode_to_string(REG_CMP(ins->flags)), c, ins->a);
+            break;
+        case ROP_SWITCH:
+            printf("%s, table[%u]", b, ins->a);
+            break;
+        case ROP_FOR_INIT:
+            printf("loop[%u], %s", ins->a, b);
+            break;
+        case ROP_FOR_STEP:
+            printf("loop[%u]", ins->a);
+            break;
+        case ROP_CALL:
+            printf("r%u, func[%u]", ins->a, ins->b);
+            break;
+        case ROP_CALL_EXT:
+            printf("r%u, func[%u], argc=%u", ins->a, ins->b, ins->c);
+            break;
+        case ROP_RET: case ROP_HALT:
+            printf("live=%u", ins->a);
+            break;
+        case ROP_LOAD_INDEXED:
+            printf("%s, %c%u[%s]", a, var, ins->b, c);
+            break;
+        case ROP_STORE_INDEXED:
+            printf("%c%u[%s], %s", var, ins->a, c, b);
+            break;
+        case ROP_LOAD_ARRAY:
+            printf("%s, array[%u][%s]%s", a, ins->b, c,
+                   (ins->flags & REG_FLAG_UNCHECKED) ? " unchecked" : "");
+            break;
+        case ROP_STORE_ARRAY:
+            printf("array[%u][%s], %s%s", ins->a, c, b,
+                   (ins->flags & REG_FLAG_UNCHECKED) ? " unchecked" : "");
+            break;
+        case ROP_LOAD_VAL: case ROP_LOAD_QUALITY:
+            printf("%s, %c%u", a, var, ins->b);
+            break;
+        case ROP_STORE_VAL: case ROP_STORE_QUALITY:
+            printf("%c%u, %s", var, ins->a, b);
+            break;
+        case ROP_IO_READ:
+            printf("%s, io#%u", a, ins->b);
+            break;
+        case ROP_IO_WRITE:
+            printf("io#%u, %s", ins->a, b);
+            break;
+        default:
+            printf("%s, %s, %s", a, b, c);
+            break;
+    }
+}
+
+void regcode_print(const BytecodeModule* module) {
+    if (!module || !module->reg_code) return;
+    const RegCode* rc = module->reg_code;
+
+    printf("\n=== Register Code ===\n");
+    printf("Main entry: %u, frame=%u\n", rc->main_entry, rc->main_frame_size);
+    for (uint32_t i = 0; i < rc->function_count; i++) {
+        if (rc->functions[i].address == REG_NO_ADDRESS) continue;
+        printf("  [%u] %s(@%u): frame=%u\n", i, module->functions[i].name,
+               rc->functions[i].address, rc->functions[i].frame_size);
+    }
+
+    printf("\n--- Instructions (%u, stack format %u) ---\n", rc->count, module->instruction_count);
+    for (uint32_t i = 0; i < rc->count; i++) {
+        printf("  %04u: ", i);
+        print_instruction(&rc->code[i]);
+        printf("    ; @%u\n", rc->origin[i]);
+    }
+    printf("======================\n");
+}
@@ -56,7 +56,7 @@ ASTNode* parse_result = NULL;
 %token TOKEN_PROGRAM TOKEN_END_PROGRAM TOKEN_BEGIN
 %token TOKEN_FUNCTION TOKEN_END_FUNCTION
 %token TOKEN_PRINT
-%token TOKEN_VAR TOKEN_VAR_INPUT TOKEN_VAR_OUTPUT TOKEN_VAR_LOCAL TOKEN_VAR_EXTERNAL TOKEN_END_VAR TOKEN_AT
+%token TOKEN_VAR TOKEN_VAR_INPUT TOKEN_VAR_OUTPUT TOKEN_VAR_LOCAL TOKEN_VAR_EXTERNAL TOKEN_END_VAR TOKEN_AT TOKEN_CONSTANT
 %token TOKEN_IF TOKEN_THEN TOKEN_ELSIF TOKEN_ELSE TOKEN_END_IF
 %token TOKEN_CASE TOKEN_OF TOKEN_END_CASE
 %token TOKEN_FOR TOKEN_TO TOKEN_BY TOKEN_DO TOKEN_END_FOR
@@ -78,6 +78,7 @@ ASTNode* parse_result = NULL;
 %token TOKEN_PLUS TOKEN_MINUS TOKEN_MULTIPLY TOKEN_DIVIDE TOKEN_MOD
 %token TOKEN_POWER TOKEN_BIT_NOT
 %token TOKEN_AND TOKEN_OR TOKEN_XOR TOKEN_NOT
+%token TOKEN_AND_THEN TOKEN_OR_ELSE
 %token TOKEN_SHL TOKEN_SHR
 
 %token TOKEN_SEMICOLON TOKEN_COLON TOKEN_COMMA TOKEN_DOT TOKEN_RANGE
@@ -91,16 +92,16 @@ ASTNode* parse_result = NULL;
 %type <ast_node> function_list function_decl function_params function_local_vars function_var_decl_list external_var_decl_list
 %type <ast_node> statement_list statement
 %type <ast_node> assignment_stmt if_stmt elsif_list while_stmt for_stmt repeat_stmt case_stmt return_stmt print_stmt
-%type <ast_node> case_element_list case_element case_labels case_label_list
+%type <ast_node> case_element_list case_element case_labels case_label_list case_label
 %type <ast_node> expression or_expr xor_expr and_expr comparison_expr
 %type <ast_node> add_expr mult_expr unary_expr primary_expr
 %type <ast_node> argument_list identifier_list
 %type <type_info> type_spec
 
 /* 运算符优先级和结合性（符合 IEC 61131-3）*/
-%left TOKEN_OR
+%left TOKEN_OR TOKEN_OR_ELSE
 %left TOKEN_XOR
-%left TOKEN_AND
+%left TOKEN_AND TOKEN_AND_THEN
 %left TOKEN_EQ TOKEN_NE
 %left TOKEN_LT TOKEN_LE TOKEN_GT TOKEN_GE
 %left TOKEN_PLUS TOKEN_MINUS
@@ -254,6 +255,14 @@ var_decl:
     {
         $$ = NULL;  // 空的 VAR 块
     }
+    | TOKEN_VAR TOKEN_CONSTANT var_decl_item TOKEN_END_VAR
+    {
+        // 常量块：变量只读，-O 时读取处替换为初始值
+        for (ASTNode* decl = $3; decl; decl = decl->next) {
+            decl->data.var_decl.is_const = true;
+        }
+        $$ = $3;
+    }
     | TOKEN_VAR_INPUT var_decl_item TOKEN_END_VAR
     {
         $$ = $2;
@@ -324,11 +333,12 @@ type_spec:
     | TOKEN_QSTRING { $$ = type_info_create(TYPE_QSTRING); }
     | TOKEN_ARRAY TOKEN_LBRACKET TOKEN_INTEGER_LITERAL TOKEN_RANGE TOKEN_INTEGER_LITERAL TOKEN_RBRACKET TOKEN_OF type_spec
     {
-        // type_info_create_array(elem_type, dimensions, sizes)
+        // type_info_create_array(elem_type, dimensions, sizes)，下界单独记录
         int32_t size = (int32_t)($5 - $3 + 1);
         int32_t* sizes = (int32_t*)mmgr_alloc(sizeof(int32_t));
         sizes[0] = size;
         $$ = type_info_create_array($8, 1, sizes);
+        if ($$) $$->array_info.lower = (int32_t)$3;
     }
     | TOKEN_ARRAY TOKEN_LBRACKET TOKEN_INTEGER_LITERAL TOKEN_RBRACKET TOKEN_OF type_spec
     {
@@ -524,6 +534,10 @@ statement_list:
     /* 空 */ { $$ = NULL; }
     | statement_list statement
     {
+        // 记录语句起始行，供代码生成构建行号表
+        if ($2 && $2->location.line == 0) {
+            ast_set_location($2, NULL, @2.first_line, @2.first_column);
+        }
         if ($1 == NULL) {
             $$ = $2;
         } else {
@@ -816,11 +830,11 @@ case_labels:
 
 /* CASE 标签列表 */
 case_label_list:
-    expression
+    case_label
     {
         $$ = $1;
     }
-    | case_label_list TOKEN_COMMA expression
+    | case_label_list TOKEN_COMMA case_label
     {
         // 将表达式添加到链表末尾
         if ($1 == NULL) {
@@ -836,6 +850,18 @@ case_label_list:
     }
     ;
 
+/* CASE 标签：单个值或范围（1..5） */
+case_label:
+    expression
+    {
+        $$ = $1;
+    }
+    | expression TOKEN_RANGE expression
+    {
+        $$ = ast_create_case_range($1, $3);
+    }
+    ;
+
 /* RETURN语句 */
 return_stmt:
     TOKEN_RETURN TOKEN_SEMICOLON
@@ -887,6 +913,10 @@ or_expr:
     {
         $$ = ast_create_binary_op(BINOP_OR, $1, $3);
     }
+    | or_expr TOKEN_OR_ELSE xor_expr
+    {
+        $$ = ast_create_binary_op(BINOP_OR_ELSE, $1, $3);
+    }
     ;
 
 xor_expr:
@@ -903,6 +933,10 @@ and_expr:
     {
         $$ = ast_create_binary_op(BINOP_AND, $1, $3);
     }
+    | and_expr TOKEN_AND_THEN comparison_expr
+    {
+        $$ = ast_create_binary_op(BINOP_AND_THEN, $1, $3);
+    }
     ;
 
 comparison_expr:
@@ -372,6 +372,18 @@ static TypeInfo* check_statement(TypeChecker* checker, ASTNode* stmt) {
             TypeInfo* target_type = check_expression(checker, stmt->data.assign.target);
             TypeInfo* value_type = check_expression(checker, stmt->data.assign.value);
             
+            // 常量（VAR CONSTANT）不可赋值
+            ASTNode* target = stmt->data.assign.target;
+            if (target->type == AST_ARRAY_ACCESS) target = target->data.array_access.array;
+            if (target->type == AST_IDENTIFIER) {
+                Symbol* sym = symtbl_lookup(checker->symtbl, target->data.identifier.name);
+                if (sym && sym->kind == SYM_CONSTANT) {
+                    fprintf(stderr, "Type error: Cannot assign to constant '%s'\n",
+                            target->data.identifier.name);
+                    checker->error_count++;
+                }
+            }
+            
             // 特殊处理：函数体内对函数名的赋值是设置返回值
             if (target_type && target_type->base_type == TYPE_FUNCTION && 
                 checker->current_function && 
@@ -497,10 +509,18 @@ static TypeInfo* check_statement(TypeChecker* checker, ASTNode* stmt) {
                     // 检查标签列表中的每个标签
                     ASTNode* label = case_elem->data.case_element.labels;
                     while (label) {
-                        TypeInfo* label_type = check_expression(checker, label);
-                        if (label_type && !type_info_can_convert(case_expr_type, label_type)) {
-                            fprintf(stderr, "Type error: CASE label type does not match expression type\n");
-                            checker->error_count++;
+                        // 范围标签（low..high）的两端分别检查
+                        ASTNode* bounds[2] = { label, NULL };
+                        if (label->type == AST_CASE_RANGE) {
+                            bounds[0] = label->data.case_range.low;
+                            bounds[1] = label->data.case_range.high;
+                        }
+                        for (int b = 0; b < 2 && bounds[b]; b++) {
+                            TypeInfo* label_type = check_expression(checker, bounds[b]);
+                            if (label_type && !type_info_can_convert(case_expr_type, label_type)) {
+                                fprintf(stderr, "Type error: CASE label type does not match expression type\n");
+                                checker->error_count++;
+                            }
                         }
                         label = label->next;
                     }
@@ -635,6 +655,16 @@ static TypeInfo* check_expression(TypeChecker* checker, ASTNode* expr) {
                 }
             }
             
+            // 短路逻辑运算: AND_THEN OR_ELSE（仅BOOL）
+            else if (op == BINOP_AND_THEN || op == BINOP_OR_ELSE) {
+                if (left_type->base_type != TYPE_BOOL || right_type->base_type != TYPE_BOOL) {
+                    fprintf(stderr, "Type error: AND_THEN/OR_ELSE requires BOOL operands\n");
+                    checker->error_count++;
+                    return NULL;
+                }
+                result_type = type_info_create(TYPE_BOOL);
+            }
+            
             // 位运算: BIT_AND BIT_OR BIT_XOR（仅INT）
             else if (op >= BINOP_BIT_AND && op <= BINOP_BIT_XOR) {
                 if (left_type->base_type != TYPE_INT || right_type->base_type != TYPE_INT) {
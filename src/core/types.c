@@ -104,6 +104,33 @@ TypeInfo* type_info_create_array(TypeInfo* elem_type, int32_t dimensions, int32_
     return ti;
 }
 
+/**
+ * @brief 数组声明的元素总数
+ */
+uint32_t type_info_array_length(const TypeInfo* type_info) {
+    if (!type_info || type_info->base_type != TYPE_ARRAY ||
+        type_info->array_info.dimensions <= 0 || !type_info->array_info.sizes) {
+        return 0;
+    }
+    uint32_t length = 1;
+    for (int32_t i = 0; i < type_info->array_info.dimensions; i++) {
+        int32_t size = type_info->array_info.sizes[i];
+        if (size <= 0 || (uint64_t)length * (uint32_t)size > UINT16_MAX) return 0;
+        length *= (uint32_t)size;
+    }
+    return length;
+}
+
+/**
+ * @brief 数组下标下界
+ */
+int32_t type_info_array_lower(const TypeInfo* type_info) {
+    if (!type_info || type_info->base_type != TYPE_ARRAY) {
+        return 0;
+    }
+    return type_info->array_info.lower;
+}
+
 /**
  * @brief 创建函数类型信息
  */
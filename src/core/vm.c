@@ -17,6 +17,8 @@
 #include "iomgr.h"
 #include "force.h"
 #include "vm_hotreload.h"
+#include "bytecode_io.h"
+#include "regcode.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -264,13 +266,9 @@ static inline Value* vm_get_variable(VM* vm, uint16_t index, bool is_global) {
 }
 
 /**
- * @brief 执行算术运算
+ * @brief 对两个值执行算术运算（栈式和寄存器格式共用）
  */
-static ErrorCode vm_execute_arithmetic(VM* vm, Opcode op) {
-    CHECK_STACK(2);
-    
-    Value b = POP();
-    Value a = POP();
+static ErrorCode vm_arith_values(VM* vm, Opcode op, Value a, Value b, Value* out) {
     Value result;
     result.type = a.type;
     result.quality = QUALITY_GOOD;  // 默认质量位
@@ -408,21 +406,33 @@ static ErrorCode vm_execute_arithmetic(VM* vm, Opcode op) {
         }
     }
     
-    PUSH(result);
+    *out = result;
     return OK;
 }
 
 /**
- * @brief 执行比较运算
- * 
- * IEC 61508: 质量位传播 - 比较结果的质量位由操作数质量决定
- * 如果任一操作数质量异常，比较结果的质量位也异常
+ * @brief 执行算术运算
  */
-static ErrorCode vm_execute_comparison(VM* vm, Opcode op) {
+static ErrorCode vm_execute_arithmetic(VM* vm, Opcode op) {
     CHECK_STACK(2);
     
     Value b = POP();
     Value a = POP();
+    Value result;
+    ErrorCode err = vm_arith_values(vm, op, a, b, &result);
+    if (err != OK) return err;
+    
+    PUSH(result);
+    return OK;
+}
+
+/**
+ * @brief 比较两个值
+ * 
+ * IEC 61508: 质量位传播 - 比较结果的质量位由操作数质量决定
+ * 如果任一操作数质量异常，比较结果的质量位也异常
+ */
+static ErrorCode vm_compare_values(Opcode op, Value a, Value b, Value* out) {
     Value result;
     result.type = TYPE_BOOL;
     result.quality = QUALITY_GOOD;
@@ -458,26 +468,39 @@ static ErrorCode vm_execute_comparison(VM* vm, Opcode op) {
     QualityFlag quality_b = is_qualified_type(b.type) ? b.quality : QUALITY_GOOD;
     result.quality = quality_propagate(quality_a, quality_b);
     
+    *out = result;
+    return OK;
+}
+
+/**
+ * @brief 执行比较运算
+ */
+static ErrorCode vm_execute_comparison(VM* vm, Opcode op) {
+    CHECK_STACK(2);
+    
+    Value b = POP();
+    Value a = POP();
+    Value result;
+    ErrorCode err = vm_compare_values(op, a, b, &result);
+    if (err != OK) return err;
+    
     PUSH(result);
     return OK;
 }
 
 /**
- * @brief 执行逻辑运算
+ * @brief 对值执行逻辑运算（NOT 只使用 a）
  * 
  * IEC 61508: 
  * - 操作数必须为 BOOL 类型（避免类型混淆 UB）
  * - 质量位传播：任一操作数质量异常则结果质量异常
  */
-static ErrorCode vm_execute_logical(VM* vm, Opcode op) {
+static ErrorCode vm_logic_values(VM* vm, Opcode op, Value a, Value b, Value* out) {
     Value result;
     result.type = TYPE_BOOL;
     result.quality = QUALITY_GOOD;
     
     if (op == OP_NOT) {
-        CHECK_STACK(1);
-        Value a = POP();
-        
         // 类型检查：必须为 BOOL 或 INT（兼容 bool/int 混用）
         if (a.type != TYPE_BOOL && a.type != TYPE_INT) {
             vm->error_code = ERR_TYPE;
@@ -492,10 +515,6 @@ static ErrorCode vm_execute_logical(VM* vm, Opcode op) {
         QualityFlag quality_a = is_qualified_type(a.type) ? a.quality : QUALITY_GOOD;
         result.quality = quality_a;
     } else {
-        CHECK_STACK(2);
-        Value b = POP();
-        Value a = POP();
-        
         // 类型检查：必须为 BOOL 或 INT
         if ((a.type != TYPE_BOOL && a.type != TYPE_INT) ||
             (b.type != TYPE_BOOL && b.type != TYPE_INT)) {
@@ -521,21 +540,39 @@ static ErrorCode vm_execute_logical(VM* vm, Opcode op) {
         result.quality = quality_propagate(quality_a, quality_b);
     }
     
+    *out = result;
+    return OK;
+}
+
+/**
+ * @brief 执行逻辑运算
+ */
+static ErrorCode vm_execute_logical(VM* vm, Opcode op) {
+    Value a, b = {.type = TYPE_VOID};
+    if (op == OP_NOT) {
+        CHECK_STACK(1);
+        a = POP();
+    } else {
+        CHECK_STACK(2);
+        b = POP();
+        a = POP();
+    }
+    
+    Value result;
+    ErrorCode err = vm_logic_values(vm, op, a, b, &result);
+    if (err != OK) return err;
+    
     PUSH(result);
     return OK;
 }
 
 /**
- * @brief 执行位运算（符合 IEC 61131-3 标准）
+ * @brief 对值执行位运算（BIT_NOT 只使用 a，符合 IEC 61131-3 标准）
  */
-static ErrorCode vm_execute_bitwise(VM* vm, Opcode op) {
+static ErrorCode vm_bitwise_values(VM* vm, Opcode op, Value a, Value b, Value* out) {
     Value result;
     
     if (op == OP_BIT_NOT) {
-        // 位取反（一元操作）
-        CHECK_STACK(1);
-        Value a = POP();
-        
         // 类型检查：只能对整数类型进行位操作
         if (a.type != TYPE_INT) {
             vm->error_code = ERR_TYPE;
@@ -547,28 +584,23 @@ static ErrorCode vm_execute_bitwise(VM* vm, Opcode op) {
         result.type = a.type;
         result.int_val = ~a.int_val;
     } else if (op == OP_SHL || op == OP_SHR) {
-        // 移位操作
-        CHECK_STACK(2);
-        Value shift_amount = POP();
-        Value value = POP();
-        
-        // 类型检查
-        if (value.type != TYPE_INT) {
+        // 移位操作：a 为被移位的值，b 为移位量
+        if (a.type != TYPE_INT) {
             vm->error_code = ERR_TYPE;
             snprintf(vm->error_msg, sizeof(vm->error_msg), 
                     "Shift operation requires integer type at PC=%u", vm->pc-1);
             return ERR_TYPE;
         }
         
-        if (shift_amount.type != TYPE_INT) {
+        if (b.type != TYPE_INT) {
             vm->error_code = ERR_TYPE;
             snprintf(vm->error_msg, sizeof(vm->error_msg), 
                     "Shift amount must be INT at PC=%u", vm->pc-1);
             return ERR_TYPE;
         }
         
-        result.type = value.type;
-        int32_t shift = shift_amount.int_val;
+        result.type = a.type;
+        int32_t shift = b.int_val;
         
         // 检查移位量合法性（避免未定义行为）
         if (shift < 0 || shift >= 32) {
@@ -579,18 +611,13 @@ static ErrorCode vm_execute_bitwise(VM* vm, Opcode op) {
         }
         
         if (op == OP_SHL) {
-            result.int_val = value.int_val << shift;
+            result.int_val = a.int_val << shift;
         } else {
             // 算术右移（保留符号位）
-            result.int_val = value.int_val >> shift;
+            result.int_val = a.int_val >> shift;
         }
     } else {
         // 二元位操作（AND, OR, XOR）
-        CHECK_STACK(2);
-        Value b = POP();
-        Value a = POP();
-        
-        // 类型检查
         if (a.type != TYPE_INT || b.type != TYPE_INT) {
             vm->error_code = ERR_TYPE;
             snprintf(vm->error_msg, sizeof(vm->error_msg), 
@@ -609,10 +636,518 @@ static ErrorCode vm_execute_bitwise(VM* vm, Opcode op) {
         }
     }
     
+    *out = result;
+    return OK;
+}
+
+/**
+ * @brief 执行位运算
+ */
+static ErrorCode vm_execute_bitwise(VM* vm, Opcode op) {
+    Value a, b = {.type = TYPE_VOID};
+    if (op == OP_BIT_NOT) {
+        // 位取反（一元操作）
+        CHECK_STACK(1);
+        a = POP();
+    } else {
+        CHECK_STACK(2);
+        b = POP();
+        a = POP();
+    }
+    
+    Value result;
+    ErrorCode err = vm_bitwise_values(vm, op, a, b, &result);
+    if (err != OK) return err;
+    
     PUSH(result);
     return OK;
 }
 
+/**
+ * @brief 更新计数循环变量（FOR_INIT/FOR_STEP，栈式和寄存器格式共用）
+ *
+ * FOR_INIT 把初值 start 写入循环变量，FOR_STEP 把循环变量加上步长；
+ * 之后按步长方向与终值比较，FOR_INIT 不满足时跳到出口，FOR_STEP 满足时跳回循环体。
+ *
+ * @param target 需要跳转时返回栈式目标地址，否则为 (uint32_t)-1
+ */
+static ErrorCode vm_for_update(VM* vm, Opcode op, uint16_t loop_index, Value start, uint32_t* target) {
+    *target = (uint32_t)-1;
+    if (loop_index >= vm->module->for_loop_count) {
+        vm->error_code = ERR_INVALID_INSTRUCTION;
+        snprintf(vm->error_msg, sizeof(vm->error_msg),
+                "Invalid FOR loop %u at PC=%u", loop_index, vm->pc-1);
+        return ERR_INVALID_INSTRUCTION;
+    }
+    const ForLoop* loop = &vm->module->for_loops[loop_index];
+    
+    Value* var = vm_get_variable(vm, (uint16_t)loop->var, (loop->flags & FOR_LOOP_VAR_GLOBAL) != 0);
+    if (!var) return vm->error_code;
+    
+    int32_t value;
+    if (op == OP_FOR_INIT) {
+        if (start.type != TYPE_INT) {
+            vm->error_code = ERR_TYPE;
+            snprintf(vm->error_msg, sizeof(vm->error_msg),
+                    "FOR_INIT requires integer start value at PC=%u", vm->pc-1);
+            return ERR_TYPE;
+        }
+        value = start.int_val;
+    } else {
+        if (var->type != TYPE_INT) {
+            vm->error_code = ERR_TYPE;
+            snprintf(vm->error_msg, sizeof(vm->error_msg),
+                    "FOR_STEP requires integer loop variable at PC=%u", vm->pc-1);
+            return ERR_TYPE;
+        }
+        int64_t next = (int64_t)var->int_val + loop->step;
+        if (next > INT32_MAX || next < INT32_MIN) {
+            vm->error_code = ERR_ARITHMETIC_OVERFLOW;
+            snprintf(vm->error_msg, sizeof(vm->error_msg), "Integer overflow in FOR_STEP at PC=%u", vm->pc);
+            return ERR_ARITHMETIC_OVERFLOW;
+        }
+        value = (int32_t)next;
+    }
+    var->type = TYPE_INT;
+    var->int_val = value;
+    
+    // 终值每次比较时重新读取，与展开的比较循环语义一致
+    int32_t end = loop->end;
+    if (loop->flags & FOR_LOOP_END_VAR) {
+        Value* end_var = vm_get_variable(vm, (uint16_t)loop->end_var,
+                                         (loop->flags & FOR_LOOP_END_GLOBAL) != 0);
+        if (!end_var) return vm->error_code;
+        end = end_var->int_val;
+    }
+    
+    bool in_range = loop->step > 0 ? value <= end : value >= end;
+    if (op == OP_FOR_INIT) {
+        if (!in_range) *target = loop->exit;
+    } else {
+        if (in_range) *target = loop->body;
+    }
+    return OK;
+}
+
+/**
+ * @brief 执行计数循环指令（FOR_INIT 先弹出初值）
+ */
+static ErrorCode vm_execute_for(VM* vm, Instruction instr) {
+    Value start = {.type = TYPE_VOID};
+    if (instr.opcode == OP_FOR_INIT) {
+        CHECK_STACK(1);
+        start = POP();
+    }
+    
+    uint32_t target;
+    ErrorCode err = vm_for_update(vm, (Opcode)instr.opcode, instr.operand, start, &target);
+    if (err != OK) return err;
+    if (target != (uint32_t)-1) vm->pc = target;
+    return OK;
+}
+
+/**
+ * @brief 调用外部函数（库函数或注册的 C 函数）
+ * 
+ * 实参是栈顶的 argc 个值；返回时实参已弹出，非 VOID 的返回值压栈。
+ * 
+ * @param func_idx 函数表下标（按名称查找实现）
+ * @param argc 实参个数
+ */
+static ErrorCode vm_call_external(VM* vm, uint32_t func_idx, int32_t argc) {
+    // 通过函数表查找函数名
+    if (func_idx >= vm->module->function_count) {
+        vm->error_code = ERR_OUT_OF_BOUNDS;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "Invalid function index %u at PC=%u", func_idx, vm->pc-1);
+        return ERR_OUT_OF_BOUNDS;
+    }
+    
+    const char* func_name = vm->module->functions[func_idx].name;
+    
+    // 首先尝试作为库函数查找
+    // 库函数名格式：<library_path>.stbc.<function_name>
+    if (vm->libmgr) {
+        // 解析结果由库管理器缓存；延迟依赖的库在首次调用时才加载
+        LoadedLibrary* lib = NULL;
+        FunctionEntry* lib_func = libmgr_resolve_call(vm->libmgr, func_name, &lib);
+        if (lib_func) {
+            // 检查是否有函数实现（地址 >= 0 就行，因为库函数地址从0开始也有效）
+            if (lib_func->address < lib->module->instruction_count) {
+                // 找到了库函数实现，创建调用帧
+                CHECK_STACK(argc);
+                
+                if (vm->call_sp + 1 >= vm->call_stack_size) {
+                    vm->error_code = ERR_STACK_OVERFLOW;
+                    snprintf(vm->error_msg, sizeof(vm->error_msg),
+                            "Call stack overflow at PC=%u", vm->pc-1);
+                    return ERR_STACK_OVERFLOW;
+                }
+                
+                CallFrame* frame = &vm->call_stack[++vm->call_sp];
+                frame->return_address = vm->pc;
+                frame->base_pointer = vm->sp - argc + 1;
+                frame->local_count = lib_func->local_count;
+                frame->function = lib_func;
+                
+                // 为局部变量分配空间
+                for (int32_t j = 0; j < lib_func->local_count; j++) {
+                    Value local = {.type = TYPE_INT, .int_val = 0};
+                    PUSH(local);
+                }
+                
+                // 临时保存当前模块和PC
+                BytecodeModule* saved_module = vm->module;
+                uint32_t saved_pc = vm->pc;
+                int32_t saved_call_sp = vm->call_sp;
+                
+                // 切换到库模块
+                vm->module = lib->module;
+                vm->pc = lib_func->address;
+                
+                // 执行库函数直到返回
+                while (vm->running && vm->call_sp >= saved_call_sp) {
+                    if (vm->pc >= vm->module->instruction_count) break;
+                    ErrorCode err = vm_step(vm);
+                    if (err != OK) {
+                        // 恢复原模块
+                        vm->module = saved_module;
+                        return err;
+                    }
+                }
+                
+                // 恢复原模块和PC
+                vm->module = saved_module;
+                vm->pc = saved_pc;
+                
+                // 成功调用库函数，跳过后面的外部函数查找
+                return OK;
+            }
+        }
+    }
+    
+    // 如果不是库函数或未找到，尝试作为C外部函数
+    ExternalFunction* ext_func = find_external_function(vm, func_name);
+    
+    if (!ext_func) {
+        vm->error_code = ERR_RUNTIME;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "External function '%s' not registered at PC=%u", func_name, vm->pc-1);
+        return ERR_RUNTIME;
+    }
+    
+    // 检查参数个数
+    if (ext_func->param_count >= 0 && argc != ext_func->param_count) {
+        vm->error_code = ERR_RUNTIME;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "Function '%s' expects %d args, got %d at PC=%u",
+                func_name, ext_func->param_count, argc, vm->pc-1);
+        return ERR_RUNTIME;
+    }
+    
+    // 检查栈上是否有足够的参数
+    CHECK_STACK(argc);
+    
+    // 调用外部函数
+    Value result = ext_func->callback(vm, argc);
+    
+    // 弹出参数
+    for (int32_t i = 0; i < argc; i++) {
+        POP();
+    }
+    
+    // 压入返回值
+    if (result.type != TYPE_VOID) {
+        PUSH(result);
+    }
+    return OK;
+}
+
+/**
+ * @brief 取数组元素（base 为数组基址，index 为下标）
+ * @return 元素指针，越界时设置错误并返回 NULL
+ */
+static Value* vm_indexed_element(VM* vm, uint16_t base, int32_t index, bool is_global) {
+    int32_t actual_offset = base + index;
+    
+    if (is_global) {
+        if (actual_offset < 0 || actual_offset >= vm->global_count) {
+            vm->error_code = ERR_OUT_OF_BOUNDS;
+            snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                    "Global array index out of bounds: %d", actual_offset);
+            return NULL;
+        }
+        return &vm->globals[actual_offset];
+    }
+    
+    // 获取当前调用栈帧的基指针
+    int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
+    int32_t local_addr = bp + actual_offset;
+    if (local_addr < 0 || local_addr > vm->sp) {
+        vm->error_code = ERR_OUT_OF_BOUNDS;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "Local array index out of bounds: %d", local_addr);
+        return NULL;
+    }
+    return &vm->stack[local_addr];
+}
+
+/**
+ * @brief 数组访问是否需要检查边界
+ *
+ * 免检证明依赖 FOR 循环变量只由 FOR_INIT/FOR_STEP 写入；有变量被强制时
+ * （调试器可在循环中途改写强制值）全部按检查执行。
+ */
+static inline bool vm_array_checked(const VM* vm, bool unchecked) {
+    return !unchecked || (vm->force_mgr && vm->force_mgr->force_count > 0);
+}
+
+/**
+ * @brief 按数组描述符取元素（OP_LOAD_ARRAY/OP_STORE_ARRAY）
+ * 
+ * checked 为 false 时下标已在加载时证明在声明范围内（FLAG_UNCHECKED），直接寻址；
+ * 否则检查描述符、下标类型和声明的下标范围，局部数组还要在当前帧的局部变量区内。
+ * 元素位于 base + (下标 - 下界)。
+ * 
+ * @return 元素指针，越界时设置错误并返回 NULL
+ */
+static inline Value* vm_array_element(VM* vm, uint16_t bound_index, const Value* index, bool checked) {
+    int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
+    
+    if (!checked) {
+        const ArrayBound* bound = &vm->module->array_bounds[bound_index];
+        return (bound->flags & ARRAY_BOUND_GLOBAL)
+            ? &vm->globals[bound->base + (index->int_val - bound->lower)]
+            : &vm->stack[bp + bound->base + (index->int_val - bound->lower)];
+    }
+    
+    if (bound_index >= vm->module->array_bound_count) {
+        vm->error_code = ERR_OUT_OF_BOUNDS;
+        snprintf(vm->error_msg, sizeof(vm->error_msg),
+                "Invalid array descriptor %u at PC=%u", bound_index, vm->pc - 1);
+        return NULL;
+    }
+    if (index->type != TYPE_INT) {
+        vm->error_code = ERR_TYPE;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), "Array index must be INT");
+        return NULL;
+    }
+    const ArrayBound* bound = &vm->module->array_bounds[bound_index];
+    int64_t rel = (int64_t)index->int_val - bound->lower;
+    if (rel < 0 || rel >= (int64_t)bound->length) {
+        vm->error_code = ERR_OUT_OF_BOUNDS;
+        snprintf(vm->error_msg, sizeof(vm->error_msg),
+                "Array index out of bounds: %d (range %d..%lld) at PC=%u",
+                index->int_val, bound->lower, (long long)bound->lower + bound->length - 1, vm->pc - 1);
+        return NULL;
+    }
+    
+    uint32_t offset = bound->base + (uint32_t)rel;
+    if (bound->flags & ARRAY_BOUND_GLOBAL) {
+        if (offset >= (uint32_t)vm->global_count) {
+            vm->error_code = ERR_OUT_OF_BOUNDS;
+            snprintf(vm->error_msg, sizeof(vm->error_msg),
+                    "Global array index out of bounds: %u", offset);
+            return NULL;
+        }
+        return &vm->globals[offset];
+    }
+    int32_t locals = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].local_count : 0;
+    if (offset >= (uint32_t)locals) {
+        vm->error_code = ERR_OUT_OF_BOUNDS;
+        snprintf(vm->error_msg, sizeof(vm->error_msg),
+                "Local array index out of bounds: %u", offset);
+        return NULL;
+    }
+    return &vm->stack[bp + offset];
+}
+
+/**
+ * @brief 数组元素的读出值（未赋值的局部数组元素按 INT 0 读出，与全局数组的初值一致）
+ */
+static inline Value vm_array_value(const Value* elem) {
+    Value v = *elem;
+    if (v.type == TYPE_VOID) {
+        v.type = TYPE_INT;
+        v.int_val = 0;
+    }
+    return v;
+}
+
+/**
+ * @brief 取质量化变量
+ * @return 变量指针，越界时设置错误并返回 NULL
+ */
+static Value* vm_quality_variable(VM* vm, uint16_t index, bool is_global) {
+    int32_t var_idx = (int32_t)index;
+    
+    if (is_global) {
+        if (var_idx >= vm->global_count) {
+            vm->error_code = ERR_OUT_OF_BOUNDS;
+            snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                    "Global variable index out of bounds: %u", var_idx);
+            return NULL;
+        }
+        return &vm->globals[var_idx];
+    }
+    
+    int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
+    int32_t local_addr = bp + var_idx;
+    if (local_addr < 0 || local_addr >= vm->sp) {
+        vm->error_code = ERR_OUT_OF_BOUNDS;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "Local variable index out of bounds: %d", local_addr);
+        return NULL;
+    }
+    return &vm->stack[local_addr];
+}
+
+/**
+ * @brief 提取质量化值的值部分，转换为对应的基础类型
+ */
+static Value vm_value_part(Value qualified_val) {
+    Value value_part = qualified_val;
+    if (is_qualified_type(qualified_val.type)) {
+        value_part.type = get_base_type(qualified_val.type);
+        value_part.quality = QUALITY_GOOD;  // 提取的值默认为GOOD
+    }
+    return value_part;
+}
+
+/**
+ * @brief 提取质量位，作为整数返回
+ */
+static Value vm_quality_part(Value qualified_val) {
+    Value quality_val;
+    quality_val.type = TYPE_INT;
+    quality_val.quality = QUALITY_GOOD;
+    quality_val.int_val = (int)qualified_val.quality;
+    return quality_val;
+}
+
+/**
+ * @brief 更新质量化变量的值部分，保持质量位不变
+ */
+static void vm_store_value_part(Value* qualified_var, Value new_value) {
+    if (is_qualified_type(qualified_var->type)) {
+        QualityFlag old_quality = qualified_var->quality;
+        *qualified_var = new_value;
+        qualified_var->type = get_qualified_type(new_value.type);
+        qualified_var->quality = old_quality;
+    } else {
+        // 如果目标不是质量化类型，转换为质量化类型
+        *qualified_var = new_value;
+        qualified_var->type = get_qualified_type(new_value.type);
+        qualified_var->quality = QUALITY_GOOD;
+    }
+}
+
+/**
+ * @brief 检查待写入的质量位（INT 且在 0-3 之间）
+ */
+static ErrorCode vm_check_quality(VM* vm, Value quality_val) {
+    if (quality_val.type != TYPE_INT) {
+        vm->error_code = ERR_TYPE;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), "Quality must be INT");
+        return ERR_TYPE;
+    }
+    
+    int quality = quality_val.int_val;
+    if (quality < 0 || quality > 3) {
+        vm->error_code = ERR_RUNTIME;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), "Quality must be 0-3, got %d", quality);
+        return ERR_RUNTIME;
+    }
+    return OK;
+}
+
+/**
+ * @brief 更新质量化变量的质量位，保持值不变
+ */
+static void vm_store_quality_part(Value* qualified_var, Value quality_val) {
+    if (!is_qualified_type(qualified_var->type)) {
+        // 如果不是质量化类型，转换为质量化类型
+        qualified_var->type = get_qualified_type(qualified_var->type);
+    }
+    qualified_var->quality = (QualityFlag)quality_val.int_val;
+}
+
+/**
+ * @brief 解析 I/O 指令的地址（operand 为常量池中的地址字符串）
+ * @param io_addr 输出解析后的地址
+ * @param name 输出地址字符串（用于错误信息）
+ */
+static ErrorCode vm_io_address(VM* vm, uint16_t addr_idx, IOAddress* io_addr, const char** name) {
+    if (!vm->io_manager) {
+        vm->error_code = ERR_RUNTIME;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "I/O manager not set at PC=%u", vm->pc-1);
+        return ERR_RUNTIME;
+    }
+    
+    if (addr_idx >= vm->module->const_count) {
+        vm->error_code = ERR_OUT_OF_BOUNDS;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "Invalid constant index %u at PC=%u", addr_idx, vm->pc-1);
+        return ERR_OUT_OF_BOUNDS;
+    }
+    
+    Constant* c = &vm->module->constants[addr_idx];
+    if (c->type != CONST_STRING) {
+        vm->error_code = ERR_TYPE;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "I/O address must be STRING at PC=%u", vm->pc-1);
+        return ERR_TYPE;
+    }
+    
+    // 解析 I/O 地址
+    ErrorCode err = io_address_parse(c->string_val, io_addr);
+    if (err != OK) {
+        vm->error_code = err;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "Failed to parse I/O address '%s' at PC=%u", c->string_val, vm->pc-1);
+        return err;
+    }
+    *name = c->string_val;
+    return OK;
+}
+
+/**
+ * @brief 从 I/O 管理器读取
+ */
+static ErrorCode vm_io_read(VM* vm, uint16_t addr_idx, Value* out) {
+    IOAddress io_addr;
+    const char* name;
+    ErrorCode err = vm_io_address(vm, addr_idx, &io_addr, &name);
+    if (err != OK) return err;
+    
+    err = io_manager_read(vm->io_manager, &io_addr, out);
+    if (err != OK) {
+        vm->error_code = err;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "Failed to read I/O '%s' at PC=%u", name, vm->pc-1);
+    }
+    return err;
+}
+
+/**
+ * @brief 写入 I/O 管理器
+ */
+static ErrorCode vm_io_write(VM* vm, uint16_t addr_idx, Value value) {
+    IOAddress io_addr;
+    const char* name;
+    ErrorCode err = vm_io_address(vm, addr_idx, &io_addr, &name);
+    if (err != OK) return err;
+    
+    err = io_manager_write(vm->io_manager, &io_addr, &value);
+    if (err != OK) {
+        vm->error_code = err;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                "Failed to write I/O '%s' at PC=%u", name, vm->pc-1);
+    }
+    return err;
+}
+
 /**
  * @brief 主解释循环
  */
@@ -788,6 +1323,27 @@ ErrorCode vm_step(VM* vm) {
             break;
         }
         
+        case OP_SWITCH: {
+            CHECK_STACK(1);
+            Value selector = POP();
+            uint32_t target = bytecode_switch_target(vm->module, instr.operand, selector.int_val);
+            if (target == (uint32_t)-1) {
+                vm->error_code = ERR_INVALID_INSTRUCTION;
+                snprintf(vm->error_msg, sizeof(vm->error_msg),
+                        "Invalid switch table %u at PC=%u", instr.operand, vm->pc-1);
+                return ERR_INVALID_INSTRUCTION;
+            }
+            vm->pc = target;
+            break;
+        }
+        
+        case OP_FOR_INIT:
+        case OP_FOR_STEP: {
+            ErrorCode err = vm_execute_for(vm, instr);
+            if (err != OK) return err;
+            break;
+        }
+        
         case OP_CALL: {
             // 函数调用
             if (vm->call_sp + 1 >= vm->call_stack_size) {
@@ -883,117 +1439,80 @@ ErrorCode vm_step(VM* vm) {
             
             // 首先尝试作为库函数查找
             // 库函数名格式：<library_path>.stbc.<function_name>
-            if (vm->libmgr && strstr(func_name, ".stbc.")) {
-                // 提取真实函数名（最后一个点之后）
-                const char* real_name = strrchr(func_name, '.');
-                if (real_name) {
-                    real_name++;  // 跳过点号
-                    
-                    // 提取库文件路径（.stbc. 之前的部分）
-                    char lib_path[256];
-                    const char* stbc_pos = strstr(func_name, ".stbc.");
-                    size_t lib_path_len = stbc_pos - func_name + 5; // 包含 ".stbc"
-                    if (lib_path_len < sizeof(lib_path)) {
-                        strncpy(lib_path, func_name, lib_path_len);
-                        lib_path[lib_path_len] = '\0';
+            if (vm->libmgr) {
+                // 解析结果由库管理器缓存；延迟依赖的库在首次调用时才加载
+                LoadedLibrary* lib = NULL;
+                FunctionEntry* lib_func = libmgr_resolve_call(vm->libmgr, func_name, &lib);
+                if (lib_func) {
+                    // 检查是否有函数实现
+                    if (lib_func->address > 0 && lib_func->address < lib->module->instruction_count) {
+                        // 找到了库函数实现，创建调用帧
+                        CHECK_STACK(argc);
                         
-                        // 从库管理器查找库
-                        LoadedLibrary* lib = vm->libmgr->libraries;
-                        while (lib) {
-                            // 检查路径是否匹配（lib->path 可能是完整路径，检查是否以 lib_path 结尾）
-                            bool path_match = false;
-                            size_t lib_full_path_len = strlen(lib->path);
-                            if (lib_full_path_len >= lib_path_len) {
-                                // 检查结尾是否匹配
-                                const char* path_end = lib->path + (lib_full_path_len - lib_path_len);
-                                if (strcmp(path_end, lib_path) == 0) {
-                                    path_match = true;
-                                }
+                        if (vm->call_sp + 1 >= vm->call_stack_size) {
+                            vm->error_code = ERR_STACK_OVERFLOW;
+                            snprintf(vm->error_msg, sizeof(vm->error_msg),
+                                    "Call stack overflow at PC=%u", vm->pc-1);
+                            return ERR_STACK_OVERFLOW;
+                        }
+                        
+                        CallFrame* frame = &vm->call_stack[++vm->call_sp];
+                        frame->return_address = vm->pc;
+                        frame->base_pointer = vm->sp - argc + 1;
+                        frame->local_count = lib_func->local_count;
+                        frame->function = lib_func;
+                        
+                        // 为局部变量分配空间
+                        for (int32_t j = 0; j < lib_func->local_count; j++) {
+                            Value local = {.type = TYPE_INT, .int_val = 0};
+                            PUSH(local);
+                        }
+                        
+                        // 临时保存当前模块、PC、SP和调用栈深度
+                        BytecodeModule* saved_module = vm->module;
+                        uint32_t saved_pc = vm->pc;
+                        int32_t saved_sp = vm->sp;
+                        int32_t saved_call_sp = vm->call_sp;
+                        
+                        // 切换到库模块
+                        vm->module = lib->module;
+                        vm->pc = lib_func->address;
+                        
+                        // 执行库函数直到返回
+                        bool lib_call_complete = false;
+                        Value return_value = {.type = TYPE_VOID};
+                        while (!lib_call_complete && vm->running) {
+                            ErrorCode err = vm_step(vm);
+                            if (err != OK) {
+                                // 恢复原模块和状态
+                                vm->module = saved_module;
+                                vm->sp = saved_sp;
+                                return err;
                             }
                             
-                            if (path_match) {
-                                // 找到库，搜索函数
-                                for (uint32_t i = 0; i < lib->module->function_count; i++) {
-                                    if (strcmp(lib->module->functions[i].name, real_name) == 0) {
-                                        FunctionEntry* lib_func = &lib->module->functions[i];
-                                        
-                                        // 检查是否有函数实现
-                                        if (lib_func->address > 0 && lib_func->address < lib->module->instruction_count) {
-                                            // 找到了库函数实现，创建调用帧
-                                            CHECK_STACK(argc);
-                                            
-                                            if (vm->call_sp + 1 >= vm->call_stack_size) {
-                                                vm->error_code = ERR_STACK_OVERFLOW;
-                                                snprintf(vm->error_msg, sizeof(vm->error_msg),
-                                                        "Call stack overflow at PC=%u", vm->pc-1);
-                                                return ERR_STACK_OVERFLOW;
-                                            }
-                                            
-                                            CallFrame* frame = &vm->call_stack[++vm->call_sp];
-                                            frame->return_address = vm->pc;
-                                            frame->base_pointer = vm->sp - argc + 1;
-                                            frame->local_count = lib_func->local_count;
-                                            frame->function = lib_func;
-                                            
-                                            // 为局部变量分配空间
-                                            for (int32_t j = 0; j < lib_func->local_count; j++) {
-                                                Value local = {.type = TYPE_INT, .int_val = 0};
-                                                PUSH(local);
-                                            }
-                                            
-                                            // 临时保存当前模块、PC、SP和调用栈深度
-                                            BytecodeModule* saved_module = vm->module;
-                                            uint32_t saved_pc = vm->pc;
-                                            int32_t saved_sp = vm->sp;
-                                            int32_t saved_call_sp = vm->call_sp;
-                                            
-                                            // 切换到库模块
-                                            vm->module = lib->module;
-                                            vm->pc = lib_func->address;
-                                            
-                                            // 执行库函数直到返回
-                                            bool lib_call_complete = false;
-                                            Value return_value = {.type = TYPE_VOID};
-                                            while (!lib_call_complete && vm->running) {
-                                                ErrorCode err = vm_step(vm);
-                                                if (err != OK) {
-                                                    // 恢复原模块和状态
-                                                    vm->module = saved_module;
-                                                    vm->sp = saved_sp;
-                                                    return err;
-                                                }
-                                                
-                                                // 检查是否返回（调用栈恢复到调用前的深度）
-                                                if (vm->call_sp < saved_call_sp) {
-                                                    lib_call_complete = true;
-                                                    // 获取返回值（如果有）
-                                                    if (lib_func->return_type != TYPE_VOID && vm->sp >= 0) {
-                                                        return_value = POP();
-                                                        // 强制设置返回值类型为函数签名声明的类型
-                                                        return_value.type = lib_func->return_type;
-                                                    }
-                                                }
-                                            }
-                                            
-                                            // 恢复原模块、PC和SP
-                                            vm->module = saved_module;
-                                            vm->pc = saved_pc;
-                                            vm->sp = saved_sp;
-                                            
-                                            // 压入返回值
-                                            if (return_value.type != TYPE_VOID) {
-                                                PUSH(return_value);
-                                            }
-                                            
-                                            goto call_ext_done;
-                                        }
-                                        break;
-                                    }
+                            // 检查是否返回（调用栈恢复到调用前的深度）
+                            if (vm->call_sp < saved_call_sp) {
+                                lib_call_complete = true;
+                                // 获取返回值（如果有）
+                                if (lib_func->return_type != TYPE_VOID && vm->sp >= 0) {
+                                    return_value = POP();
+                                    // 强制设置返回值类型为函数签名声明的类型
+                                    return_value.type = lib_func->return_type;
                                 }
-                                break;
                             }
-                            lib = lib->next;
                         }
+                        
+                        // 恢复原模块、PC和SP
+                        vm->module = saved_module;
+                        vm->pc = saved_pc;
+                        vm->sp = saved_sp;
+                        
+                        // 压入返回值
+                        if (return_value.type != TYPE_VOID) {
+                            PUSH(return_value);
+                        }
+                        
+                        goto call_ext_done;
                     }
                 }
             }
@@ -1237,6 +1756,27 @@ ErrorCode vm_step(VM* vm) {
             break;
         }
         
+        case OP_LOAD_ARRAY: {
+            // 弹出下标，压入数组元素（单步执行时调试器可能改过变量，总是检查边界）
+            CHECK_STACK(1);
+            Value index_val = POP();
+            Value* elem = vm_array_element(vm, instr.operand, &index_val, true);
+            if (!elem) return vm->error_code;
+            PUSH(vm_array_value(elem));
+            break;
+        }
+        
+        case OP_STORE_ARRAY: {
+            // 弹出下标和值，写入数组元素
+            CHECK_STACK(2);
+            Value index_val = POP();
+            Value value = POP();
+            Value* elem = vm_array_element(vm, instr.operand, &index_val, true);
+            if (!elem) return vm->error_code;
+            *elem = value;
+            break;
+        }
+        
         // === 质量位访问 ===
         case OP_LOAD_VAL: {
             // 加载质量化变量的值部分
@@ -1339,87 +1879,594 @@ ErrorCode vm_step(VM* vm) {
                             "Local variable index out of bounds: %d", local_addr);
                     return ERR_OUT_OF_BOUNDS;
                 }
-                qualified_var = &vm->stack[local_addr];
+                qualified_var = &vm->stack[local_addr];
+            }
+            
+            // 更新值部分，保持质量位不变
+            if (is_qualified_type(qualified_var->type)) {
+                QualityFlag old_quality = qualified_var->quality;
+                *qualified_var = new_value;
+                qualified_var->type = get_qualified_type(new_value.type);
+                qualified_var->quality = old_quality;
+            } else {
+                // 如果目标不是质量化类型，转换为质量化类型
+                *qualified_var = new_value;
+                qualified_var->type = get_qualified_type(new_value.type);
+                qualified_var->quality = QUALITY_GOOD;
+            }
+            break;
+        }
+        
+        case OP_STORE_QUALITY: {
+            // 存储质量化变量的质量位
+            int32_t var_idx = (int32_t)instr.operand;
+            
+            if (vm->sp < 0) {
+                vm->error_code = ERR_STACK_UNDERFLOW;
+                snprintf(vm->error_msg, sizeof(vm->error_msg), "Stack underflow in STORE_QUALITY");
+                return ERR_STACK_UNDERFLOW;
+            }
+            
+            Value quality_val = POP();
+            if (quality_val.type != TYPE_INT) {
+                vm->error_code = ERR_TYPE;
+                snprintf(vm->error_msg, sizeof(vm->error_msg), "Quality must be INT");
+                return ERR_TYPE;
+            }
+            
+            int quality = quality_val.int_val;
+            if (quality < 0 || quality > 3) {
+                vm->error_code = ERR_RUNTIME;
+                snprintf(vm->error_msg, sizeof(vm->error_msg), "Quality must be 0-3, got %d", quality);
+                return ERR_RUNTIME;
+            }
+            
+            Value* qualified_var;
+            
+            if (instr.flags & FLAG_GLOBAL) {
+                if (var_idx >= vm->global_count) {
+                    vm->error_code = ERR_OUT_OF_BOUNDS;
+                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                            "Global variable index out of bounds: %u", var_idx);
+                    return ERR_OUT_OF_BOUNDS;
+                }
+                qualified_var = &vm->globals[var_idx];
+            } else {
+                int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
+                int32_t local_addr = bp + var_idx;
+                if (local_addr < 0 || local_addr >= vm->sp) {
+                    vm->error_code = ERR_OUT_OF_BOUNDS;
+                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                            "Local variable index out of bounds: %d", local_addr);
+                    return ERR_OUT_OF_BOUNDS;
+                }
+                qualified_var = &vm->stack[local_addr];
+            }
+            
+            // 更新质量位，保持值不变
+            if (!is_qualified_type(qualified_var->type)) {
+                // 如果不是质量化类型，转换为质量化类型
+                qualified_var->type = get_qualified_type(qualified_var->type);
+            }
+            qualified_var->quality = (QualityFlag)quality;
+            break;
+        }
+        
+        default:
+            vm->error_code = ERR_INVALID_INSTRUCTION;
+            snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                    "Invalid opcode %u at PC=%u", instr.opcode, vm->pc-1);
+            return ERR_INVALID_INSTRUCTION;
+    }
+    
+    return OK;
+}
+
+// ============================================================================
+// 寄存器格式执行
+// ============================================================================
+
+/**
+ * @brief 同步栈式程序计数器（错误信息、行号和调试接口按栈式地址报告）
+ */
+#define REG_SYNC_PC() (vm->pc = origin[pc - 1] + 1)
+
+/**
+ * @brief 寄存器指令运行时错误：同步程序计数器后返回
+ */
+#define REG_FAIL(code) do { REG_SYNC_PC(); return (code); } while (0)
+
+/**
+ * @brief 取源操作数（寄存器、常量或全局变量）
+ */
+#define REG_OPERAND(var, kind, index) do { \
+    if ((kind) == REG_KIND_REG) { \
+        var = &frame[(index)]; \
+    } else if ((kind) == REG_KIND_CONST) { \
+        var = &constants[(index)]; \
+    } else { \
+        var = vm_get_variable(vm, (index), true); \
+        if (!var) REG_FAIL(vm->error_code); \
+    } \
+} while (0)
+
+/**
+ * @brief 取目标操作数（寄存器或全局变量）
+ */
+#define REG_DEST(var) do { \
+    if (ins->flags & REG_FLAG_DEST_GLOBAL) { \
+        var = vm_get_variable(vm, ins->a, true); \
+        if (!var) REG_FAIL(vm->error_code); \
+    } else { \
+        var = &frame[ins->a]; \
+    } \
+} while (0)
+
+/**
+ * @brief 切换到寄存器帧（vm->sp 指向帧顶，局部变量访问和外部调用照常工作）
+ */
+#define REG_ENTER_FRAME(new_base, new_size) do { \
+    base = (new_base); \
+    frame_size = (new_size); \
+    frame = &vm->stack[base]; \
+    vm->sp = base + (int32_t)frame_size - 1; \
+} while (0)
+
+/**
+ * @brief 按寄存器格式执行模块主程序
+ *
+ * 帧布局与栈式相同（见 regcode.h），调用帧的 return_address 记录寄存器代码地址。
+ * 执行结束时 vm->sp 指向仍有效的最后一个寄存器，vm_get_result 照常读取栈顶。
+ */
+static ErrorCode vm_run_registers(VM* vm) {
+    BytecodeModule* module = vm->module;
+    const RegCode* rc = module->reg_code;
+    const RegInstruction* code = rc->code;
+    const uint32_t* origin = rc->origin;
+    Value* constants = rc->constants;
+    int32_t entry_call_sp = vm->call_sp;
+    int32_t main_base = vm->sp + 1;
+    int32_t base = 0;
+    uint32_t frame_size = 0;
+    Value* frame = NULL;
+    uint32_t pc = rc->main_entry;
+    
+    if (main_base + (int64_t)rc->main_frame_size > vm->stack_size) {
+        vm->error_code = ERR_STACK_OVERFLOW;
+        snprintf(vm->error_msg, sizeof(vm->error_msg), "Stack overflow at PC=%u", vm->pc);
+        return ERR_STACK_OVERFLOW;
+    }
+    REG_ENTER_FRAME(main_base, rc->main_frame_size);
+    for (uint32_t i = 0; i < frame_size; i++) {
+        frame[i].type = TYPE_VOID;
+    }
+    
+    while (vm->running) {
+        // 热加载检查点（与栈式解释循环相同）
+        if (vm->hotreload_enabled && vm->hotreload) {
+            vm->instructions_since_check++;
+            if (vm->hotreload_check_interval == 0 ||
+                vm->instructions_since_check >= vm->hotreload_check_interval) {
+                ErrorCode hr_err = vm_check_hotreload(vm);
+                if (hr_err != OK && hr_err != ERR_NOT_FOUND) {
+                    fprintf(stderr, "[VM] Hotreload check failed: error code %d\n", hr_err);
+                }
+                vm->instructions_since_check = 0;
+                
+                // 更新已应用（模块被替换或寄存器代码已丢弃）：从新入口重新开始
+                if (vm->module != module || vm->module->reg_code != rc) {
+                    return vm_run_from(vm, vm->pc);
+                }
+            }
+        }
+        
+        const RegInstruction* ins = &code[pc++];
+        vm->instruction_count++;
+        
+        switch (ins->opcode) {
+            case ROP_MOVE: {
+                Value* src;
+                Value* dst;
+                REG_OPERAND(src, REG_KIND_B(ins->flags), ins->b);
+                REG_DEST(dst);
+                *dst = *src;
+                break;
+            }
+            
+            // === 算术运算 ===
+            case ROP_ADD:
+            case ROP_SUB:
+            case ROP_MUL:
+            case ROP_DIV:
+            case ROP_MOD: {
+                Value* x;
+                Value* y;
+                Value* dst;
+                Value result;
+                REG_OPERAND(x, REG_KIND_B(ins->flags), ins->b);
+                REG_OPERAND(y, REG_KIND_C(ins->flags), ins->c);
+                
+                // 整数加减的快速路径（溢出时交给通用实现报告）
+                int64_t sum = 0;
+                bool fast = false;
+                if (x->type == TYPE_INT && y->type == TYPE_INT) {
+                    if (ins->opcode == ROP_ADD) {
+                        sum = (int64_t)x->int_val + y->int_val;
+                        fast = true;
+                    } else if (ins->opcode == ROP_SUB) {
+                        sum = (int64_t)x->int_val - y->int_val;
+                        fast = true;
+                    }
+                }
+                if (fast && sum >= INT32_MIN && sum <= INT32_MAX) {
+                    result.type = TYPE_INT;
+                    result.quality = QUALITY_GOOD;
+                    result.int_val = (int32_t)sum;
+                } else {
+                    REG_SYNC_PC();
+                    ErrorCode err = vm_arith_values(vm, (Opcode)(OP_ADD + (ins->opcode - ROP_ADD)),
+                                                    *x, *y, &result);
+                    if (err != OK) return err;
+                }
+                REG_DEST(dst);
+                *dst = result;
+                break;
+            }
+            
+            case ROP_NEG: {
+                Value* x;
+                Value* dst;
+                REG_OPERAND(x, REG_KIND_B(ins->flags), ins->b);
+                Value a = *x;
+                if (a.type == TYPE_REAL) {
+                    a.real_val = -a.real_val;
+                } else {
+                    a.int_val = -a.int_val;
+                }
+                REG_DEST(dst);
+                *dst = a;
+                break;
+            }
+            
+            // === 比较运算 ===
+            case ROP_EQ:
+            case ROP_NE:
+            case ROP_LT:
+            case ROP_LE:
+            case ROP_GT:
+            case ROP_GE: {
+                Value* x;
+                Value* y;
+                Value* dst;
+                Value result;
+                REG_OPERAND(x, REG_KIND_B(ins->flags), ins->b);
+                REG_OPERAND(y, REG_KIND_C(ins->flags), ins->c);
+                ErrorCode err = vm_compare_values((Opcode)(OP_EQ + (ins->opcode - ROP_EQ)), *x, *y, &result);
+                if (err != OK) REG_FAIL(err);
+                REG_DEST(dst);
+                *dst = result;
+                break;
+            }
+            
+            // === 逻辑与位运算 ===
+            case ROP_AND:
+            case ROP_OR:
+            case ROP_XOR:
+            case ROP_NOT:
+            case ROP_BIT_AND:
+            case ROP_BIT_OR:
+            case ROP_BIT_XOR:
+            case ROP_BIT_NOT:
+            case ROP_SHL:
+            case ROP_SHR: {
+                Value* x;
+                Value* y = NULL;
+                Value* dst;
+                Value result;
+                Value none = {.type = TYPE_VOID};
+                bool unary = ins->opcode == ROP_NOT || ins->opcode == ROP_BIT_NOT;
+                REG_OPERAND(x, REG_KIND_B(ins->flags), ins->b);
+                if (!unary) REG_OPERAND(y, REG_KIND_C(ins->flags), ins->c);
+                
+                REG_SYNC_PC();
+                ErrorCode err;
+                switch (ins->opcode) {
+                    case ROP_AND: err = vm_logic_values(vm, OP_AND, *x, *y, &result); break;
+                    case ROP_OR:  err = vm_logic_values(vm, OP_OR, *x, *y, &result); break;
+                    case ROP_XOR: err = vm_logic_values(vm, OP_XOR, *x, *y, &result); break;
+                    case ROP_NOT: err = vm_logic_values(vm, OP_NOT, *x, none, &result); break;
+                    default:
+                        err = vm_bitwise_values(vm, (Opcode)(OP_BIT_AND + (ins->opcode - ROP_BIT_AND)),
+                                                *x, unary ? none : *y, &result);
+                        break;
+                }
+                if (err != OK) return err;
+                REG_DEST(dst);
+                *dst = result;
+                break;
+            }
+            
+            // === 控制流 ===
+            case ROP_JMP:
+                pc = ins->a;
+                break;
+            
+            case ROP_JZ:
+            case ROP_JNZ: {
+                Value* cond;
+                REG_OPERAND(cond, REG_KIND_B(ins->flags), ins->b);
+                bool is_true = (cond->type == TYPE_BOOL) ? cond->bool_val : (cond->int_val != 0);
+                if (is_true == (ins->opcode == ROP_JNZ)) {
+                    pc = ins->a;
+                }
+                break;
+            }
+            
+            case ROP_JCMPZ:
+            case ROP_JCMPNZ: {
+                Value* x;
+                Value* y;
+                REG_OPERAND(x, REG_KIND_B(ins->flags), ins->b);
+                REG_OPERAND(y, REG_KIND_C(ins->flags), ins->c);
+                Opcode cmp = REG_CMP(ins->flags);
+                bool holds;
+                if (x->type == TYPE_INT && y->type == TYPE_INT) {
+                    switch (cmp) {
+                        case OP_EQ: holds = x->int_val == y->int_val; break;
+                        case OP_NE: holds = x->int_val != y->int_val; break;
+                        case OP_LT: holds = x->int_val < y->int_val; break;
+                        case OP_LE: holds = x->int_val <= y->int_val; break;
+                        case OP_GT: holds = x->int_val > y->int_val; break;
+                        default:    holds = x->int_val >= y->int_val; break;
+                    }
+                } else {
+                    Value result;
+                    ErrorCode err = vm_compare_values(cmp, *x, *y, &result);
+                    if (err != OK) REG_FAIL(err);
+                    holds = result.bool_val;
+                }
+                if (holds == (ins->opcode == ROP_JCMPNZ)) {
+                    pc = ins->a;
+                }
+                break;
+            }
+            
+            case ROP_SWITCH: {
+                Value* selector;
+                REG_OPERAND(selector, REG_KIND_B(ins->flags), ins->b);
+                uint32_t target = bytecode_switch_target(module, ins->a, selector->int_val);
+                if (target == (uint32_t)-1) {
+                    REG_SYNC_PC();
+                    vm->error_code = ERR_INVALID_INSTRUCTION;
+                    snprintf(vm->error_msg, sizeof(vm->error_msg),
+                            "Invalid switch table %u at PC=%u", ins->a, vm->pc-1);
+                    return ERR_INVALID_INSTRUCTION;
+                }
+                pc = rc->address_map[target];
+                break;
+            }
+            
+            case ROP_FOR_INIT:
+            case ROP_FOR_STEP: {
+                Value start = {.type = TYPE_VOID};
+                if (ins->opcode == ROP_FOR_INIT) {
+                    Value* x;
+                    REG_OPERAND(x, REG_KIND_B(ins->flags), ins->b);
+                    start = *x;
+                }
+                REG_SYNC_PC();
+                uint32_t target;
+                ErrorCode err = vm_for_update(vm, ins->opcode == ROP_FOR_INIT ? OP_FOR_INIT : OP_FOR_STEP,
+                                              ins->a, start, &target);
+                if (err != OK) return err;
+                if (target != (uint32_t)-1) pc = rc->address_map[target];
+                break;
+            }
+            
+            case ROP_CALL: {
+                FunctionEntry* func = &module->functions[ins->b];
+                const RegFunction* callee = &rc->functions[ins->b];
+                int32_t callee_base = base + ins->a;
+                if (vm->call_sp + 1 >= vm->call_stack_size) {
+                    vm->error_code = ERR_CALL_STACK_OVERFLOW;
+                    REG_FAIL(ERR_CALL_STACK_OVERFLOW);
+                }
+                if (callee_base + (int64_t)callee->frame_size > vm->stack_size) {
+                    REG_SYNC_PC();
+                    vm->error_code = ERR_STACK_OVERFLOW;
+                    snprintf(vm->error_msg, sizeof(vm->error_msg), "Stack overflow at PC=%u", vm->pc);
+                    return ERR_STACK_OVERFLOW;
+                }
+                
+                CallFrame* call = &vm->call_stack[++vm->call_sp];
+                call->return_address = pc;
+                call->base_pointer = callee_base;
+                call->local_count = func->local_count;
+                call->function = func;
+                
+                REG_ENTER_FRAME(callee_base, callee->frame_size);
+                // 参数之外的局部变量
+                for (int32_t i = func->param_count; i < func->local_count; i++) {
+                    frame[i].type = TYPE_VOID;
+                }
+                pc = callee->address;
+                break;
+            }
+            
+            case ROP_RET: {
+                if (vm->call_sp <= entry_call_sp) {
+                    // 主程序返回，停止执行
+                    vm->sp = base + ins->a - 1;
+                    vm->running = false;
+                    break;
+                }
+                
+                CallFrame call = vm->call_stack[vm->call_sp--];
+                pc = call.return_address;
+                
+                // 返回值（参数之后的第一个局部变量）写回第一个实参所在的寄存器
+                if (call.function->return_type != TYPE_VOID) {
+                    vm->stack[call.base_pointer] = vm->stack[call.base_pointer + call.function->param_count];
+                }
+                
+                if (vm->call_sp > entry_call_sp) {
+                    const CallFrame* caller = &vm->call_stack[vm->call_sp];
+                    REG_ENTER_FRAME(caller->base_pointer,
+                                    rc->functions[caller->function - module->functions].frame_size);
+                } else {
+                    REG_ENTER_FRAME(main_base, rc->main_frame_size);
+                }
+                break;
             }
             
-            // 更新值部分，保持质量位不变
-            if (is_qualified_type(qualified_var->type)) {
-                QualityFlag old_quality = qualified_var->quality;
-                *qualified_var = new_value;
-                qualified_var->type = get_qualified_type(new_value.type);
-                qualified_var->quality = old_quality;
-            } else {
-                // 如果目标不是质量化类型，转换为质量化类型
-                *qualified_var = new_value;
-                qualified_var->type = get_qualified_type(new_value.type);
-                qualified_var->quality = QUALITY_GOOD;
+            case ROP_HALT:
+                vm->sp = base + ins->a - 1;
+                vm->running = false;
+                break;
+            
+            case ROP_CALL_EXT: {
+                // 实参位于寄存器 a 起的 c 个寄存器，按栈式调用约定临时收缩栈顶
+                REG_SYNC_PC();
+                vm->sp = base + ins->a + ins->c - 1;
+                ErrorCode err = vm_call_external(vm, ins->b, ins->c);
+                if (err != OK) return err;
+                if (module->functions[ins->b].return_type != TYPE_VOID && vm->sp < base + ins->a) {
+                    frame[ins->a].type = TYPE_VOID;
+                }
+                vm->sp = base + (int32_t)frame_size - 1;
+                break;
             }
-            break;
-        }
-        
-        case OP_STORE_QUALITY: {
-            // 存储质量化变量的质量位
-            int32_t var_idx = (int32_t)instr.operand;
             
-            if (vm->sp < 0) {
-                vm->error_code = ERR_STACK_UNDERFLOW;
-                snprintf(vm->error_msg, sizeof(vm->error_msg), "Stack underflow in STORE_QUALITY");
-                return ERR_STACK_UNDERFLOW;
+            // === 数组、质量位、I/O ===
+            case ROP_LOAD_INDEXED: {
+                Value* index;
+                Value* dst;
+                REG_OPERAND(index, REG_KIND_C(ins->flags), ins->c);
+                if (index->type != TYPE_INT) {
+                    vm->error_code = ERR_TYPE;
+                    snprintf(vm->error_msg, sizeof(vm->error_msg), "Array index must be INT");
+                    REG_FAIL(ERR_TYPE);
+                }
+                Value* elem = vm_indexed_element(vm, ins->b, index->int_val,
+                                                 (ins->flags & REG_FLAG_VAR_GLOBAL) != 0);
+                if (!elem) REG_FAIL(ERR_OUT_OF_BOUNDS);
+                Value elem_val = {.type = TYPE_INT};
+                elem_val.int_val = elem->int_val;
+                REG_DEST(dst);
+                *dst = elem_val;
+                break;
             }
             
-            Value quality_val = POP();
-            if (quality_val.type != TYPE_INT) {
-                vm->error_code = ERR_TYPE;
-                snprintf(vm->error_msg, sizeof(vm->error_msg), "Quality must be INT");
-                return ERR_TYPE;
+            case ROP_STORE_INDEXED: {
+                Value* value;
+                Value* index;
+                REG_OPERAND(value, REG_KIND_B(ins->flags), ins->b);
+                REG_OPERAND(index, REG_KIND_C(ins->flags), ins->c);
+                if (index->type != TYPE_INT) {
+                    vm->error_code = ERR_TYPE;
+                    snprintf(vm->error_msg, sizeof(vm->error_msg), "Array index must be INT");
+                    REG_FAIL(ERR_TYPE);
+                }
+                if (value->type != TYPE_INT) {
+                    vm->error_code = ERR_TYPE;
+                    snprintf(vm->error_msg, sizeof(vm->error_msg), "Array element must be INT");
+                    REG_FAIL(ERR_TYPE);
+                }
+                Value* elem = vm_indexed_element(vm, ins->a, index->int_val,
+                                                 (ins->flags & REG_FLAG_VAR_GLOBAL) != 0);
+                if (!elem) REG_FAIL(ERR_OUT_OF_BOUNDS);
+                *elem = *value;
+                break;
             }
             
-            int quality = quality_val.int_val;
-            if (quality < 0 || quality > 3) {
-                vm->error_code = ERR_RUNTIME;
-                snprintf(vm->error_msg, sizeof(vm->error_msg), "Quality must be 0-3, got %d", quality);
-                return ERR_RUNTIME;
+            case ROP_LOAD_ARRAY: {
+                Value* index;
+                Value* dst;
+                REG_OPERAND(index, REG_KIND_C(ins->flags), ins->c);
+                bool checked = vm_array_checked(vm, (ins->flags & REG_FLAG_UNCHECKED) != 0);
+                if (checked) REG_SYNC_PC();     // 错误信息按栈式地址报告
+                Value* elem = vm_array_element(vm, ins->b, index, checked);
+                if (!elem) REG_FAIL(vm->error_code);
+                REG_DEST(dst);
+                *dst = vm_array_value(elem);
+                break;
             }
             
-            Value* qualified_var;
+            case ROP_STORE_ARRAY: {
+                Value* value;
+                Value* index;
+                REG_OPERAND(value, REG_KIND_B(ins->flags), ins->b);
+                REG_OPERAND(index, REG_KIND_C(ins->flags), ins->c);
+                bool checked = vm_array_checked(vm, (ins->flags & REG_FLAG_UNCHECKED) != 0);
+                if (checked) REG_SYNC_PC();
+                Value* elem = vm_array_element(vm, ins->a, index, checked);
+                if (!elem) REG_FAIL(vm->error_code);
+                *elem = *value;
+                break;
+            }
             
-            if (instr.flags & FLAG_GLOBAL) {
-                if (var_idx >= vm->global_count) {
-                    vm->error_code = ERR_OUT_OF_BOUNDS;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Global variable index out of bounds: %u", var_idx);
-                    return ERR_OUT_OF_BOUNDS;
+            case ROP_LOAD_VAL:
+            case ROP_LOAD_QUALITY: {
+                Value* dst;
+                Value* qualified_var = vm_quality_variable(vm, ins->b, (ins->flags & REG_FLAG_VAR_GLOBAL) != 0);
+                if (!qualified_var) REG_FAIL(ERR_OUT_OF_BOUNDS);
+                Value part = ins->opcode == ROP_LOAD_VAL ? vm_value_part(*qualified_var)
+                                                         : vm_quality_part(*qualified_var);
+                REG_DEST(dst);
+                *dst = part;
+                break;
+            }
+            
+            case ROP_STORE_VAL:
+            case ROP_STORE_QUALITY: {
+                Value* value;
+                REG_OPERAND(value, REG_KIND_B(ins->flags), ins->b);
+                Value new_value = *value;
+                if (ins->opcode == ROP_STORE_QUALITY) {
+                    ErrorCode err = vm_check_quality(vm, new_value);
+                    if (err != OK) REG_FAIL(err);
                 }
-                qualified_var = &vm->globals[var_idx];
-            } else {
-                int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
-                int32_t local_addr = bp + var_idx;
-                if (local_addr < 0 || local_addr >= vm->sp) {
-                    vm->error_code = ERR_OUT_OF_BOUNDS;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Local variable index out of bounds: %d", local_addr);
-                    return ERR_OUT_OF_BOUNDS;
+                Value* qualified_var = vm_quality_variable(vm, ins->a, (ins->flags & REG_FLAG_VAR_GLOBAL) != 0);
+                if (!qualified_var) REG_FAIL(ERR_OUT_OF_BOUNDS);
+                if (ins->opcode == ROP_STORE_VAL) {
+                    vm_store_value_part(qualified_var, new_value);
+                } else {
+                    vm_store_quality_part(qualified_var, new_value);
                 }
-                qualified_var = &vm->stack[local_addr];
+                break;
             }
             
-            // 更新质量位，保持值不变
-            if (!is_qualified_type(qualified_var->type)) {
-                // 如果不是质量化类型，转换为质量化类型
-                qualified_var->type = get_qualified_type(qualified_var->type);
+            case ROP_IO_READ: {
+                Value* dst;
+                Value io_value;
+                REG_SYNC_PC();
+                ErrorCode err = vm_io_read(vm, ins->b, &io_value);
+                if (err != OK) return err;
+                REG_DEST(dst);
+                *dst = io_value;
+                break;
             }
-            qualified_var->quality = (QualityFlag)quality;
-            break;
+            
+            case ROP_IO_WRITE: {
+                Value* value;
+                REG_OPERAND(value, REG_KIND_B(ins->flags), ins->b);
+                REG_SYNC_PC();
+                ErrorCode err = vm_io_write(vm, ins->a, *value);
+                if (err != OK) return err;
+                break;
+            }
+            
+            default:
+                REG_SYNC_PC();
+                vm->error_code = ERR_INVALID_INSTRUCTION;
+                snprintf(vm->error_msg, sizeof(vm->error_msg), 
+                        "Invalid register opcode %u at PC=%u", ins->opcode, vm->pc-1);
+                return ERR_INVALID_INSTRUCTION;
         }
-        
-        default:
-            vm->error_code = ERR_INVALID_INSTRUCTION;
-            snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                    "Invalid opcode %u at PC=%u", instr.opcode, vm->pc-1);
-            return ERR_INVALID_INSTRUCTION;
     }
     
-    return OK;
+    REG_SYNC_PC();
+    return vm->error_code;
 }
 
 /**
@@ -1432,6 +2479,11 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
     vm->running = true;
     vm->error_code = OK;
     
+    // 模块带寄存器格式代码时，主程序按寄存器格式执行（单独的入口函数仍按栈式执行）
+    if (vm->module->reg_code && entry_point == vm->module->entry_point) {
+        return vm_run_registers(vm);
+    }
+    
     Instruction* code = vm->module->instructions;
     uint32_t code_size = vm->module->instruction_count;
     
@@ -1613,6 +2665,27 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
                 break;
             }
             
+            case OP_SWITCH: {
+                CHECK_STACK(1);
+                Value selector = POP();
+                uint32_t target = bytecode_switch_target(vm->module, instr.operand, selector.int_val);
+                if (target == (uint32_t)-1) {
+                    vm->error_code = ERR_INVALID_INSTRUCTION;
+                    snprintf(vm->error_msg, sizeof(vm->error_msg),
+                            "Invalid switch table %u at PC=%u", instr.operand, vm->pc-1);
+                    return ERR_INVALID_INSTRUCTION;
+                }
+                vm->pc = target;
+                break;
+            }
+            
+            case OP_FOR_INIT:
+            case OP_FOR_STEP: {
+                ErrorCode err = vm_execute_for(vm, instr);
+                if (err != OK) return err;
+                break;
+            }
+            
             case OP_CALL: {
                 // 函数调用
                 if (vm->call_sp + 1 >= vm->call_stack_size) {
@@ -1686,155 +2759,9 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
                 break;
             
             case OP_CALL_EXT: {
-                // 外部函数调用
-                // operand是函数索引（用于查找），flags包含参数个数
-                uint32_t func_idx = instr.operand;
-                int32_t argc = instr.flags;
-                
-                // 通过函数表查找函数名
-                if (func_idx >= vm->module->function_count) {
-                    vm->error_code = ERR_OUT_OF_BOUNDS;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Invalid function index %u at PC=%u", func_idx, vm->pc-1);
-                    return ERR_OUT_OF_BOUNDS;
-                }
-                
-                const char* func_name = vm->module->functions[func_idx].name;
-                
-                // 首先尝试作为库函数查找
-                // 库函数名格式：<library_path>.stbc.<function_name>
-                if (vm->libmgr && strstr(func_name, ".stbc.")) {
-                    // 提取真实函数名（最后一个点之后）
-                    const char* real_name = strrchr(func_name, '.');
-                    if (real_name) {
-                        real_name++;  // 跳过点号
-                        
-                        // 提取库文件路径（.stbc. 之前的部分）
-                        char lib_path[256];
-                        const char* stbc_pos = strstr(func_name, ".stbc.");
-                        size_t lib_path_len = stbc_pos - func_name + 5; // 包含 ".stbc"
-                        if (lib_path_len < sizeof(lib_path)) {
-                            strncpy(lib_path, func_name, lib_path_len);
-                            lib_path[lib_path_len] = '\0';
-                            
-                            // 从库管理器查找库
-                            LoadedLibrary* lib = vm->libmgr->libraries;
-                            while (lib) {
-                                // 检查路径是否匹配（lib->path 可能是完整路径，检查是否以 lib_path 结尾）
-                                bool path_match = false;
-                                size_t lib_full_path_len = strlen(lib->path);
-                                if (lib_full_path_len >= lib_path_len) {
-                                    // 检查结尾是否匹配
-                                    const char* path_end = lib->path + (lib_full_path_len - lib_path_len);
-                                    if (strcmp(path_end, lib_path) == 0) {
-                                        path_match = true;
-                                    }
-                                }
-                                
-                                if (path_match) {
-                                    // 找到库，搜索函数
-                                    for (uint32_t i = 0; i < lib->module->function_count; i++) {
-                                        if (strcmp(lib->module->functions[i].name, real_name) == 0) {
-                                            FunctionEntry* lib_func = &lib->module->functions[i];
-                                            
-                                            // 检查是否有函数实现（地址 >= 0 就行，因为库函数地址从0开始也有效）
-                                            if (lib_func->address < lib->module->instruction_count) {
-                                                // 找到了库函数实现，创建调用帧
-                                                CHECK_STACK(argc);
-                                                
-                                                if (vm->call_sp + 1 >= vm->call_stack_size) {
-                                                    vm->error_code = ERR_STACK_OVERFLOW;
-                                                    snprintf(vm->error_msg, sizeof(vm->error_msg),
-                                                            "Call stack overflow at PC=%u", vm->pc-1);
-                                                    return ERR_STACK_OVERFLOW;
-                                                }
-                                                
-                                                CallFrame* frame = &vm->call_stack[++vm->call_sp];
-                                                frame->return_address = vm->pc;
-                                                frame->base_pointer = vm->sp - argc + 1;
-                                                frame->local_count = lib_func->local_count;
-                                                frame->function = lib_func;
-                                                
-                                                // 为局部变量分配空间
-                                                for (int32_t j = 0; j < lib_func->local_count; j++) {
-                                                    Value local = {.type = TYPE_INT, .int_val = 0};
-                                                    PUSH(local);
-                                                }
-                                                
-                                                // 临时保存当前模块和PC
-                                                BytecodeModule* saved_module = vm->module;
-                                                uint32_t saved_pc = vm->pc;
-                                                int32_t saved_call_sp = vm->call_sp;
-                                                
-                                                // 切换到库模块
-                                                vm->module = lib->module;
-                                                vm->pc = lib_func->address;
-                                                
-                                                // 执行库函数直到返回
-                                                while (vm->running && vm->call_sp >= saved_call_sp) {
-                                                    if (vm->pc >= vm->module->instruction_count) break;
-                                                    ErrorCode err = vm_step(vm);
-                                                    if (err != OK) {
-                                                        // 恢复原模块
-                                                        vm->module = saved_module;
-                                                        return err;
-                                                    }
-                                                }
-                                                
-                                                // 恢复原模块和PC
-                                                vm->module = saved_module;
-                                                vm->pc = saved_pc;
-                                                
-                                                // 成功调用库函数，跳过后面的外部函数查找
-                                                goto call_ext_done_run;
-                                            }
-                                            break;
-                                        }
-                                    }
-                                    break;
-                                }
-                                lib = lib->next;
-                            }
-                        }
-                    }
-                }
-                
-                // 如果不是库函数或未找到，尝试作为C外部函数
-                ExternalFunction* ext_func = find_external_function(vm, func_name);
-                
-                if (!ext_func) {
-                    vm->error_code = ERR_RUNTIME;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "External function '%s' not registered at PC=%u", func_name, vm->pc-1);
-                    return ERR_RUNTIME;
-                }
-                
-                // 检查参数个数
-                if (ext_func->param_count >= 0 && argc != ext_func->param_count) {
-                    vm->error_code = ERR_RUNTIME;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Function '%s' expects %d args, got %d at PC=%u",
-                            func_name, ext_func->param_count, argc, vm->pc-1);
-                    return ERR_RUNTIME;
-                }
-                
-                // 检查栈上是否有足够的参数
-                CHECK_STACK(argc);
-                
-                // 调用外部函数
-                Value result = ext_func->callback(vm, argc);
-                
-                // 弹出参数
-                for (int32_t i = 0; i < argc; i++) {
-                    POP();
-                }
-                
-                // 压入返回值
-                if (result.type != TYPE_VOID) {
-                    PUSH(result);
-                }
-                
-            call_ext_done_run:
+                // 外部函数调用：operand是函数索引（用于查找），flags包含参数个数
+                ErrorCode err = vm_call_external(vm, instr.operand, instr.flags);
+                if (err != OK) return err;
                 break;
             }
             
@@ -1845,48 +2772,9 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
             // === 硬件 I/O ===
             case OP_IO_READ: {
                 // operand: 常量池中的 I/O 地址字符串索引
-                if (!vm->io_manager) {
-                    vm->error_code = ERR_RUNTIME;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "I/O manager not set at PC=%u", vm->pc-1);
-                    return ERR_RUNTIME;
-                }
-                
-                uint32_t addr_idx = instr.operand;
-                if (addr_idx >= vm->module->const_count) {
-                    vm->error_code = ERR_OUT_OF_BOUNDS;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Invalid constant index %u at PC=%u", addr_idx, vm->pc-1);
-                    return ERR_OUT_OF_BOUNDS;
-                }
-                
-                Constant* c = &vm->module->constants[addr_idx];
-                if (c->type != CONST_STRING) {
-                    vm->error_code = ERR_TYPE;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "I/O address must be STRING at PC=%u", vm->pc-1);
-                    return ERR_TYPE;
-                }
-                
-                // 解析 I/O 地址
-                IOAddress io_addr;
-                ErrorCode err = io_address_parse(c->string_val, &io_addr);
-                if (err != OK) {
-                    vm->error_code = err;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Failed to parse I/O address '%s' at PC=%u", c->string_val, vm->pc-1);
-                    return err;
-                }
-                
-                // 从 I/O 管理器读取
                 Value io_value;
-                err = io_manager_read(vm->io_manager, &io_addr, &io_value);
-                if (err != OK) {
-                    vm->error_code = err;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Failed to read I/O '%s' at PC=%u", c->string_val, vm->pc-1);
-                    return err;
-                }
+                ErrorCode err = vm_io_read(vm, instr.operand, &io_value);
+                if (err != OK) return err;
                 
                 // 压入栈
                 PUSH(io_value);
@@ -1896,13 +2784,6 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
             case OP_IO_WRITE: {
                 // operand: 常量池中的 I/O 地址字符串索引
                 // 栈顶: 要写入的值
-                if (!vm->io_manager) {
-                    vm->error_code = ERR_RUNTIME;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "I/O manager not set at PC=%u", vm->pc-1);
-                    return ERR_RUNTIME;
-                }
-                
                 if (vm->sp < 0) {
                     vm->error_code = ERR_STACK_UNDERFLOW;
                     snprintf(vm->error_msg, sizeof(vm->error_msg), 
@@ -1910,44 +2791,8 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
                     return ERR_STACK_UNDERFLOW;
                 }
                 
-                uint32_t addr_idx = instr.operand;
-                if (addr_idx >= vm->module->const_count) {
-                    vm->error_code = ERR_OUT_OF_BOUNDS;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Invalid constant index %u at PC=%u", addr_idx, vm->pc-1);
-                    return ERR_OUT_OF_BOUNDS;
-                }
-                
-                Constant* c = &vm->module->constants[addr_idx];
-                if (c->type != CONST_STRING) {
-                    vm->error_code = ERR_TYPE;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "I/O address must be STRING at PC=%u", vm->pc-1);
-                    return ERR_TYPE;
-                }
-                
-                // 解析 I/O 地址
-                IOAddress io_addr;
-                ErrorCode err = io_address_parse(c->string_val, &io_addr);
-                if (err != OK) {
-                    vm->error_code = err;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Failed to parse I/O address '%s' at PC=%u", c->string_val, vm->pc-1);
-                    return err;
-                }
-                
-                // 从栈弹出值
-                Value write_value = POP();
-                
-                // 写入 I/O 管理器
-                err = io_manager_write(vm->io_manager, &io_addr, &write_value);
-                if (err != OK) {
-                    vm->error_code = err;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                            "Failed to write I/O '%s' at PC=%u", c->string_val, vm->pc-1);
-                    return err;
-                }
-                
+                ErrorCode err = vm_io_write(vm, instr.operand, POP());
+                if (err != OK) return err;
                 break;
             }
             
@@ -1966,35 +2811,13 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
                     return ERR_TYPE;
                 }
                 
-                int32_t index = index_val.int_val;
-                int32_t base_offset = instr.operand;
-                int32_t actual_offset = base_offset + index;
-                
                 // 根据标志位确定是全局还是局部变量
-                Value elem_val;
-                elem_val.type = TYPE_INT;  // 目前只支持 INT 数组
-                
-                if (instr.flags & FLAG_GLOBAL) {
-                    if (actual_offset >= vm->global_count) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Global array index out of bounds: %d", actual_offset);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    elem_val.int_val = vm->globals[actual_offset].int_val;
-                } else {
-                    // 获取当前调用栈帧的基指针
-                    int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
-                    int32_t local_addr = bp + actual_offset;
-                    if (local_addr < 0 || local_addr > vm->sp) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Local array index out of bounds: %d", local_addr);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    elem_val.int_val = vm->stack[local_addr].int_val;
-                }
+                Value* elem = vm_indexed_element(vm, instr.operand, index_val.int_val,
+                                                 (instr.flags & FLAG_GLOBAL) != 0);
+                if (!elem) return ERR_OUT_OF_BOUNDS;
                 
+                Value elem_val = {.type = TYPE_INT};  // 目前只支持 INT 数组
+                elem_val.int_val = elem->int_val;
                 PUSH(elem_val);
                 break;
             }
@@ -2022,111 +2845,48 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
                     return ERR_TYPE;
                 }
                 
-                int32_t index = index_val.int_val;
-                int32_t base_offset = instr.operand;
-                int32_t actual_offset = base_offset + index;
-                
-                // 根据标志位确定是全局还是局部变量
-                if (instr.flags & FLAG_GLOBAL) {
-                    if (actual_offset >= vm->global_count) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Global array index out of bounds: %d", actual_offset);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    vm->globals[actual_offset] = value_val;
-                } else {
-                    // 获取当前调用栈帧的基指针
-                    int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
-                    int32_t local_addr = bp + actual_offset;
-                    if (local_addr < 0 || local_addr > vm->sp) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Local array index out of bounds: %d", local_addr);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    vm->stack[local_addr] = value_val;
-                }
-                
+                Value* elem = vm_indexed_element(vm, instr.operand, index_val.int_val,
+                                                 (instr.flags & FLAG_GLOBAL) != 0);
+                if (!elem) return ERR_OUT_OF_BOUNDS;
+                *elem = value_val;
                 break;
             }
             
-            // === 质量位访问（需要在vm_run_from中也实现）===
-            case OP_LOAD_VAL: {
-                // 加载质量化变量的值部分
-                int32_t var_idx = (int32_t)instr.operand;
-                Value qualified_val;
-                
-                if (instr.flags & FLAG_GLOBAL) {
-                    if (var_idx >= vm->global_count) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Global variable index out of bounds: %u", var_idx);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    qualified_val = vm->globals[var_idx];
-                } else {
-                    int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
-                    int32_t local_addr = bp + var_idx;
-                    if (local_addr < 0 || local_addr >= vm->sp) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Local variable index out of bounds: %d", local_addr);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    qualified_val = vm->stack[local_addr];
-                }
-                
-                // 提取值部分，转换为对应的基础类型
-                Value value_part = qualified_val;
-                if (is_qualified_type(qualified_val.type)) {
-                    value_part.type = get_base_type(qualified_val.type);
-                    value_part.quality = QUALITY_GOOD;  // 提取的值默认为GOOD
-                }
-                
-                PUSH(value_part);
+            case OP_LOAD_ARRAY: {
+                // 弹出下标，压入数组元素（FLAG_UNCHECKED：下标已证明在声明范围内）
+                Value index_val = POP();
+                Value* elem = vm_array_element(vm, instr.operand, &index_val,
+                                               vm_array_checked(vm, (instr.flags & FLAG_UNCHECKED) != 0));
+                if (!elem) return vm->error_code;
+                PUSH(vm_array_value(elem));
+                break;
+            }
+            
+            case OP_STORE_ARRAY: {
+                // 弹出下标和值，写入数组元素
+                Value index_val = POP();
+                Value value_val = POP();
+                Value* elem = vm_array_element(vm, instr.operand, &index_val,
+                                               vm_array_checked(vm, (instr.flags & FLAG_UNCHECKED) != 0));
+                if (!elem) return vm->error_code;
+                *elem = value_val;
                 break;
             }
             
+            // === 质量位访问（需要在vm_run_from中也实现）===
+            case OP_LOAD_VAL:
             case OP_LOAD_QUALITY: {
-                // 加载质量化变量的质量位
-                int32_t var_idx = (int32_t)instr.operand;
-                Value qualified_val;
-                
-                if (instr.flags & FLAG_GLOBAL) {
-                    if (var_idx >= vm->global_count) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Global variable index out of bounds: %u", var_idx);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    qualified_val = vm->globals[var_idx];
-                } else {
-                    int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
-                    int32_t local_addr = bp + var_idx;
-                    if (local_addr < 0 || local_addr >= vm->sp) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Local variable index out of bounds: %d", local_addr);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    qualified_val = vm->stack[local_addr];
-                }
+                // 加载质量化变量的值部分或质量位
+                Value* qualified_var = vm_quality_variable(vm, instr.operand, (instr.flags & FLAG_GLOBAL) != 0);
+                if (!qualified_var) return ERR_OUT_OF_BOUNDS;
                 
-                // 提取质量位，作为整数返回
-                Value quality_val;
-                quality_val.type = TYPE_INT;
-                quality_val.quality = QUALITY_GOOD;
-                quality_val.int_val = (int)qualified_val.quality;
-                
-                PUSH(quality_val);
+                PUSH(instr.opcode == OP_LOAD_VAL ? vm_value_part(*qualified_var)
+                                                 : vm_quality_part(*qualified_var));
                 break;
             }
             
             case OP_STORE_VAL: {
                 // 存储质量化变量的值部分
-                int32_t var_idx = (int32_t)instr.operand;
-                
                 if (vm->sp < 0) {
                     vm->error_code = ERR_STACK_UNDERFLOW;
                     snprintf(vm->error_msg, sizeof(vm->error_msg), "Stack underflow in STORE_VAL");
@@ -2134,47 +2894,14 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
                 }
                 
                 Value new_value = POP();
-                Value* qualified_var;
-                
-                if (instr.flags & FLAG_GLOBAL) {
-                    if (var_idx >= vm->global_count) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Global variable index out of bounds: %u", var_idx);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    qualified_var = &vm->globals[var_idx];
-                } else {
-                    int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
-                    int32_t local_addr = bp + var_idx;
-                    if (local_addr < 0 || local_addr >= vm->sp) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Local variable index out of bounds: %d", local_addr);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    qualified_var = &vm->stack[local_addr];
-                }
-                
-                // 更新值部分，保持质量位不变
-                if (is_qualified_type(qualified_var->type)) {
-                    QualityFlag old_quality = qualified_var->quality;
-                    *qualified_var = new_value;
-                    qualified_var->type = get_qualified_type(new_value.type);
-                    qualified_var->quality = old_quality;
-                } else {
-                    // 如果目标不是质量化类型，转换为质量化类型
-                    *qualified_var = new_value;
-                    qualified_var->type = get_qualified_type(new_value.type);
-                    qualified_var->quality = QUALITY_GOOD;
-                }
+                Value* qualified_var = vm_quality_variable(vm, instr.operand, (instr.flags & FLAG_GLOBAL) != 0);
+                if (!qualified_var) return ERR_OUT_OF_BOUNDS;
+                vm_store_value_part(qualified_var, new_value);
                 break;
             }
             
             case OP_STORE_QUALITY: {
                 // 存储质量化变量的质量位
-                int32_t var_idx = (int32_t)instr.operand;
-                
                 if (vm->sp < 0) {
                     vm->error_code = ERR_STACK_UNDERFLOW;
                     snprintf(vm->error_msg, sizeof(vm->error_msg), "Stack underflow in STORE_QUALITY");
@@ -2182,47 +2909,12 @@ ErrorCode vm_run_from(VM* vm, uint32_t entry_point) {
                 }
                 
                 Value quality_val = POP();
-                if (quality_val.type != TYPE_INT) {
-                    vm->error_code = ERR_TYPE;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), "Quality must be INT");
-                    return ERR_TYPE;
-                }
-                
-                int quality = quality_val.int_val;
-                if (quality < 0 || quality > 3) {
-                    vm->error_code = ERR_RUNTIME;
-                    snprintf(vm->error_msg, sizeof(vm->error_msg), "Quality must be 0-3, got %d", quality);
-                    return ERR_RUNTIME;
-                }
-                
-                Value* qualified_var;
-                
-                if (instr.flags & FLAG_GLOBAL) {
-                    if (var_idx >= vm->global_count) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Global variable index out of bounds: %u", var_idx);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    qualified_var = &vm->globals[var_idx];
-                } else {
-                    int32_t bp = (vm->call_sp >= 0) ? vm->call_stack[vm->call_sp].base_pointer : 0;
-                    int32_t local_addr = bp + var_idx;
-                    if (local_addr < 0 || local_addr >= vm->sp) {
-                        vm->error_code = ERR_OUT_OF_BOUNDS;
-                        snprintf(vm->error_msg, sizeof(vm->error_msg), 
-                                "Local variable index out of bounds: %d", local_addr);
-                        return ERR_OUT_OF_BOUNDS;
-                    }
-                    qualified_var = &vm->stack[local_addr];
-                }
+                ErrorCode err = vm_check_quality(vm, quality_val);
+                if (err != OK) return err;
                 
-                // 更新质量位，保持值不变
-                if (!is_qualified_type(qualified_var->type)) {
-                    // 如果不是质量化类型，转换为质量化类型
-                    qualified_var->type = get_qualified_type(qualified_var->type);
-                }
-                qualified_var->quality = (QualityFlag)quality;
+                Value* qualified_var = vm_quality_variable(vm, instr.operand, (instr.flags & FLAG_GLOBAL) != 0);
+                if (!qualified_var) return ERR_OUT_OF_BOUNDS;
+                vm_store_quality_part(qualified_var, quality_val);
                 break;
             }
             
@@ -2300,6 +2992,24 @@ void vm_dump_call_stack(VM* vm) {
     printf("==================\n");
 }
 
+/**
+ * @brief 获取当前指令对应的源码行号
+ */
+int vm_get_current_line(VM* vm) {
+    if (!vm || !vm->module) return 0;
+    bytecode_load_debug_info(vm->module);
+    return bytecode_line_for_pc(vm->module, vm->pc);
+}
+
+/**
+ * @brief 获取当前模块的源文件名
+ */
+const char* vm_get_current_file(VM* vm) {
+    if (!vm || !vm->module) return NULL;
+    bytecode_load_debug_info(vm->module);
+    return vm->module->source_file;
+}
+
 /**
  * @brief 注册外部函数
  */
@@ -95,8 +95,19 @@ static const InstructionCost g_cost_table[OP_COUNT] = {
     // I/O
     [OP_IO_READ]       = { .base = 25, .memory = 8, .branch_penalty = 0 },
     [OP_IO_WRITE]      = { .base = 25, .memory = 8, .branch_penalty = 0 },
+    // 多路分支（有序区间表另按二分查找次数计 WCET_SWITCH_PROBE_CYCLES）
+    [OP_SWITCH]        = { .base = 12, .memory = 8, .branch_penalty = 6 },
+    // 计数循环（读写循环变量和终值变量）
+    [OP_FOR_INIT]      = { .base = 14, .memory = 12,.branch_penalty = 6 },
+    [OP_FOR_STEP]      = { .base = 14, .memory = 12,.branch_penalty = 6 },
+    // 按数组描述符寻址（免检访问的成本；检查边界的另计 WCET_ARRAY_CHECK_CYCLES）
+    [OP_LOAD_ARRAY]    = { .base = 10, .memory = 12,.branch_penalty = 0 },
+    [OP_STORE_ARRAY]   = { .base = 10, .memory = 12,.branch_penalty = 0 },
 };
 
+#define WCET_SWITCH_PROBE_CYCLES 12     // 有序跳转表每次二分探测的周期数
+#define WCET_ARRAY_CHECK_CYCLES  6      // 数组访问检查下标类型和声明长度的周期数
+
 const InstructionCost* wcet_get_instruction_cost_table(void) {
     return g_cost_table;
 }
@@ -120,7 +131,9 @@ typedef enum {
     BT_BRANCH,       // 条件分支
     BT_CALL,         // 函数调用
     BT_RETURN,       // 函数返回
-    BT_HALT          // 程序停止
+    BT_HALT,         // 程序停止
+    BT_SWITCH,       // 跳转表分支（目标在模块跳转表中）
+    BT_LOOP          // FOR_INIT/FOR_STEP（目标在循环描述符中）
 } BlockTerminator;
 
 /**
@@ -185,6 +198,19 @@ static uint64_t compute_instruction_cycles(Opcode opcode) {
 // 基本块构建
 // ============================================================================
 
+/**
+ * @brief 有序跳转表二分查找的额外周期（稠密表按下标直接取，无额外成本）
+ */
+static uint64_t switch_probe_cycles(const BytecodeModule* module, uint32_t table_index) {
+    if (table_index >= module->switch_table_count) return 0;
+    const SwitchTable* table = &module->switch_tables[table_index];
+    if (table->kind != SWITCH_SORTED) return 0;
+    
+    uint64_t probes = 0;
+    for (uint32_t n = table->count; n > 0; n >>= 1) probes++;
+    return probes * WCET_SWITCH_PROBE_CYCLES;
+}
+
 /**
  * @brief 构建所有基本块
  *
@@ -237,6 +263,31 @@ static ErrorCode wcet_build_blocks(WcetAnalyzer* a) {
             if (i + 1 < a->code_size) {
                 is_block_start[i + 1] = true;
             }
+        } else if (op == OP_SWITCH) {
+            // 跳转表：默认目标和每个表项目标都是新块
+            if (instr->operand < a->module->switch_table_count) {
+                const SwitchTable* table = &a->module->switch_tables[instr->operand];
+                if (table->default_target < a->code_size) {
+                    is_block_start[table->default_target] = true;
+                }
+                for (uint32_t k = 0; k < table->count; k++) {
+                    uint32_t target = a->module->switch_cases[table->first + k].target;
+                    if (target < a->code_size) is_block_start[target] = true;
+                }
+            }
+            if (i + 1 < a->code_size) {
+                is_block_start[i + 1] = true;
+            }
+        } else if (op == OP_FOR_INIT || op == OP_FOR_STEP) {
+            // 计数循环：循环体入口和出口都是新块
+            if (instr->operand < a->module->for_loop_count) {
+                const ForLoop* loop = &a->module->for_loops[instr->operand];
+                if (loop->body < a->code_size) is_block_start[loop->body] = true;
+                if (loop->exit < a->code_size) is_block_start[loop->exit] = true;
+            }
+            if (i + 1 < a->code_size) {
+                is_block_start[i + 1] = true;
+            }
         } else if (op == OP_RET || op == OP_HALT) {
             // 返回/停机后是新块
             if (i + 1 < a->code_size) {
@@ -279,6 +330,10 @@ static ErrorCode wcet_build_blocks(WcetAnalyzer* a) {
             for (uint32_t j = block_start; j < i; j++) {
                 Instruction* instr = &a->code[j];
                 bb->cycle_cost += compute_instruction_cycles(instr->opcode);
+                if ((instr->opcode == OP_LOAD_ARRAY || instr->opcode == OP_STORE_ARRAY) &&
+                    !(instr->flags & FLAG_UNCHECKED)) {
+                    bb->cycle_cost += WCET_ARRAY_CHECK_CYCLES;
+                }
                 bb->instruction_count++;
 
                 // 只处理块的终结指令
@@ -308,6 +363,18 @@ static ErrorCode wcet_build_blocks(WcetAnalyzer* a) {
                         bb->target_pc[0] = instr->operand; // 外部调用保持索引
                         bb->target_pc[1] = i;
                         bb->target_count = 2;
+                    } else if (op == OP_SWITCH) {
+                        bb->terminator = BT_SWITCH;
+                        bb->target_count = 0;
+                        bb->cycle_cost += switch_probe_cycles(a->module, instr->operand);
+                    } else if ((op == OP_FOR_INIT || op == OP_FOR_STEP) &&
+                               instr->operand < a->module->for_loop_count) {
+                        // FOR_INIT 不进入循环时跳到出口，FOR_STEP 继续时跳回循环体
+                        const ForLoop* loop = &a->module->for_loops[instr->operand];
+                        bb->terminator = BT_LOOP;
+                        bb->target_pc[0] = op == OP_FOR_INIT ? loop->exit : loop->body;
+                        bb->target_pc[1] = i;
+                        bb->target_count = 2;
                     } else if (op == OP_RET) {
                         bb->terminator = BT_RETURN;
                         bb->target_count = 0;
@@ -338,12 +405,15 @@ static ErrorCode wcet_build_blocks(WcetAnalyzer* a) {
  * @brief 检测基本块中的循环
  *
  * 如果一个块包含向回跳转（目标地址 <= 自身起始地址），
- * 则该块形成一个循环。
+ * 则该块形成一个循环。迭代次数优先取 @LOOP_MAX 标注；FOR_STEP 回边
+ * 未标注时取循环描述符在编译期已知的迭代次数（循环体可能改写循环变量时不取），
+ * 再退回默认边界。
  */
 static void wcet_detect_loops(WcetAnalyzer* a) {
     for (uint32_t i = 0; i < a->block_count; i++) {
         BasicBlock* bb = &a->blocks[i];
-        if (bb->terminator == BT_JUMP && bb->target_pc[0] <= bb->start_pc) {
+        if ((bb->terminator == BT_JUMP || bb->terminator == BT_LOOP) &&
+            bb->target_pc[0] <= bb->start_pc) {
             // 向后跳转 = 循环
             bb->in_loop = true;
             a->result.analyzed_loops++;
@@ -358,6 +428,19 @@ static void wcet_detect_loops(WcetAnalyzer* a) {
                 }
             }
 
+            if (!found_bound && bb->terminator == BT_LOOP) {
+                // 循环体改写循环变量时描述符不给出次数，退回默认边界
+                uint32_t trips;
+                if (bytecode_for_loop_trip_count(a->module, a->code[bb->end_pc - 1].operand, &trips)) {
+                    bb->loop_multiplier = trips > 0 ? trips : 1;
+                    found_bound = true;
+                    if (a->config.verbose) {
+                        printf("[WCET] FOR 循环 @PC=%u, 由循环描述符得到边界 %u\n",
+                               bb->start_pc, trips);
+                    }
+                }
+            }
+
             if (!found_bound) {
                 if (a->config.default_loop_bound > 0) {
                     bb->loop_multiplier = a->config.default_loop_bound;
@@ -28,6 +28,7 @@ typedef enum {
     AST_REPEAT,             // repeat循环
     AST_CASE,               // case语句
     AST_CASE_ELEMENT,       // case分支元素
+    AST_CASE_RANGE,         // case范围标签（low..high）
     AST_RETURN,             // return语句
     AST_BLOCK,              // 语句块
     AST_EXPR_STMT,          // 表达式语句
@@ -77,7 +78,11 @@ typedef enum {
     
     // 移位运算
     BINOP_SHL,      // SHL（左移）
-    BINOP_SHR       // SHR（右移）
+    BINOP_SHR,      // SHR（右移）
+    
+    // 短路逻辑运算（IEC 61131-3，仅BOOL）
+    BINOP_AND_THEN, // AND_THEN（左侧为假时不计算右侧）
+    BINOP_OR_ELSE   // OR_ELSE（左侧为真时不计算右侧）
 } BinaryOp;
 
 /**
@@ -198,6 +203,12 @@ typedef union {
         ASTNode* statements;        // 语句列表
     } case_element;
     
+    // case范围标签
+    struct {
+        ASTNode* low;               // 下界（含）
+        ASTNode* high;              // 上界（含）
+    } case_range;
+    
     // return语句
     struct {
         ASTNode* value;             // 返回值（可选）
@@ -330,6 +341,11 @@ ASTNode* ast_create_case(ASTNode* expression, ASTNode** cases, int case_count, A
  */
 ASTNode* ast_create_case_element(ASTNode* labels, ASTNode* statements);
 
+/**
+ * @brief 创建case范围标签节点（low..high）
+ */
+ASTNode* ast_create_case_range(ASTNode* low, ASTNode* high);
+
 /**
  * @brief 创建语句块节点
  */
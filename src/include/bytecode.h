@@ -18,10 +18,15 @@
 #include "types.h"
 #include "error.h"
 
-// 初始容量
-#define INITIAL_INSTRUCTION_CAPACITY (1024*256)
-#define INITIAL_CONSTANT_CAPACITY (1024*64)
-#define INITIAL_FUNCTION_CAPACITY (1024*32)
+// 前向声明
+struct STBCSymbolIndex;
+struct RegCode;
+
+// 初始容量（编译器从小容量起步，按 2 倍几何增长；
+// 从 .stbc 加载的模块按文件头计数精确分配，见 bytecode_module_create_sized）
+#define INITIAL_INSTRUCTION_CAPACITY 256
+#define INITIAL_CONSTANT_CAPACITY 64
+#define INITIAL_FUNCTION_CAPACITY 16
 
 /**
  * @brief 操作码枚举（精简到28个核心指令）
@@ -88,7 +93,18 @@ typedef enum {
     OP_IO_READ,         // 从硬件 I/O 读取 operand: I/O地址索引（常量池中）
     OP_IO_WRITE,        // 向硬件 I/O 写入 operand: I/O地址索引（常量池中）
     
-    OP_COUNT            // 指令总数（现在包含37个指令）
+    // === 多路分支（1个）===
+    OP_SWITCH,          // 按跳转表分支 operand: 跳转表下标，弹出栈顶整数作为选择值
+    
+    // === 计数循环（2个）===
+    OP_FOR_INIT,        // FOR 循环入口 operand: 循环描述符下标，弹出初值写入循环变量，不进入循环时跳到出口
+    OP_FOR_STEP,        // FOR 循环步进 operand: 循环描述符下标，循环变量加步长，仍在范围内时跳回循环体
+    
+    // === 按声明长度检查的数组访问（2个）===
+    OP_LOAD_ARRAY,      // 加载数组元素 operand: 数组描述符下标，弹出下标，压入元素
+    OP_STORE_ARRAY,     // 存储数组元素 operand: 数组描述符下标，栈顶为下标，栈次为值
+    
+    OP_COUNT            // 指令总数（现在包含48个指令）
 } Opcode;
 
 /**
@@ -96,6 +112,7 @@ typedef enum {
  */
 #define FLAG_GLOBAL  0x01   // LOAD/STORE: 全局变量
 #define FLAG_LOCAL   0x00   // LOAD/STORE: 局部变量
+#define FLAG_UNCHECKED 0x02 // LOAD_ARRAY/STORE_ARRAY: 下标已证明在声明范围内，不做边界检查
 
 /**
  * @brief 指令结构（固定4字节格式）
@@ -155,6 +172,101 @@ typedef struct {
     int32_t index;          // 在全局数组中的索引
 } GlobalEntry;
 
+/**
+ * @brief 行号表条目：从 pc 开始（直到下一条目之前）的指令都属于 line
+ */
+typedef struct {
+    uint32_t pc;            // 起始指令地址
+    int32_t line;           // 源码行号（0 表示无对应源码）
+} LineEntry;
+
+/**
+ * @brief 行号表（类似 DWARF 行号程序，只在行号变化处记录一条）
+ * 
+ * 条目按 pc 递增，pc→行号二分查找；行号→pc 使用首次查询时构建的
+ * 按 (line, pc) 排序的条目副本（在锁内构建后发布，可被多个线程同时查询）。
+ * 序列化时按差分变长编码写入 LINES 段。
+ */
+typedef struct {
+    LineEntry* entries;     // 条目数组
+    uint32_t count;         // 条目数
+    uint32_t capacity;      // 条目容量
+    LineEntry* by_line;     // 按 (line, pc) 排序的条目副本（按需构建，追加时失效）
+} LineTable;
+
+/**
+ * @brief 跳转表查找方式
+ */
+typedef enum {
+    SWITCH_DENSE = 0,       // 稠密表：每个值一个条目，按 value - low 直接索引
+    SWITCH_SORTED           // 有序区间表：每个区间一个条目，按值二分查找
+} SwitchKind;
+
+/**
+ * @brief 跳转表条目：选择值落在 [low, high] 内时跳到 target
+ */
+typedef struct {
+    int32_t low;
+    int32_t high;
+    uint32_t target;        // 目标指令地址
+} SwitchCase;
+
+/**
+ * @brief 跳转表（CASE 语句的多路分支，OP_SWITCH 的操作数是其下标）
+ * 
+ * 条目按 low 递增且互不重叠；稠密表中未列出的值的条目指向 default_target。
+ */
+typedef struct {
+    uint32_t kind;          // SwitchKind
+    uint32_t first;         // 首条目在模块 switch_cases 中的下标
+    uint32_t count;         // 条目数
+    uint32_t default_target;// 没有匹配条目时的目标地址
+} SwitchTable;
+
+/**
+ * @brief FOR 循环描述符标志
+ */
+#define FOR_LOOP_VAR_GLOBAL   0x01  // 循环变量在全局区
+#define FOR_LOOP_END_VAR      0x02  // 终值是变量（每次比较时读取），否则为常量 end
+#define FOR_LOOP_END_GLOBAL   0x04  // 终值变量在全局区
+#define FOR_LOOP_CONST_START  0x08  // 初值是编译期常量 start
+
+/**
+ * @brief FOR 循环描述符（OP_FOR_INIT/OP_FOR_STEP 的操作数是其下标）
+ * 
+ * 步长为非零编译期常量：步长为正时循环条件为 变量 <= 终值，为负时为 变量 >= 终值。
+ * 初值和终值都是常量、且循环体不改写循环变量时迭代次数在编译期已知
+ * （见 bytecode_for_loop_trip_count）。
+ */
+typedef struct {
+    uint32_t var;           // 循环变量（全局索引或帧内偏移）
+    uint32_t end_var;       // 终值变量（FOR_LOOP_END_VAR）
+    uint32_t flags;         // FOR_LOOP_* 标志
+    int32_t start;          // 常量初值（FOR_LOOP_CONST_START）
+    int32_t end;            // 常量终值
+    int32_t step;           // 步长
+    uint32_t body;          // 循环体入口地址（OP_FOR_INIT 之后）
+    uint32_t exit;          // 循环出口地址（OP_FOR_STEP 之后）
+} ForLoop;
+
+/**
+ * @brief 数组描述符标志
+ */
+#define ARRAY_BOUND_GLOBAL    0x01  // 数组在全局区
+
+/**
+ * @brief 数组描述符（OP_LOAD_ARRAY/OP_STORE_ARRAY 的操作数是其下标）
+ * 
+ * 记录声明的下标范围，合法下标为 [lower, lower + length)，元素位于 base + (下标 - lower)。
+ * 局部数组的 base 是帧内偏移，加载时检查不超出引用它的函数的局部变量区。
+ */
+typedef struct {
+    uint32_t base;          // 首元素（全局索引或帧内偏移）
+    uint32_t length;        // 声明的元素个数
+    uint32_t flags;         // ARRAY_BOUND_* 标志
+    int32_t lower;          // 下标下界（ARRAY[lo..hi] 的 lo，STBC 3.5 起）
+} ArrayBound;
+
 /**
  * @brief 字节码模块
  */
@@ -169,6 +281,11 @@ typedef struct {
     uint32_t const_count;
     uint32_t const_capacity;
     
+    // 常量池哈希索引（开放寻址，槽位存放 常量索引+1，0 表示空槽）
+    uint32_t* const_index;
+    uint32_t const_index_capacity;  // 槽位数，2 的幂
+    uint32_t const_indexed;         // 已纳入索引的常量个数（其后的常量按需补录）
+    
     // 函数表
     FunctionEntry* functions;
     uint32_t function_count;
@@ -185,9 +302,35 @@ typedef struct {
     char** library_deps;    // 依赖的库文件名数组
     uint32_t library_dep_count;
     
+    // 跳转表
+    SwitchTable* switch_tables;
+    uint32_t switch_table_count;
+    SwitchCase* switch_cases;       // 所有跳转表的条目，按表连续存放
+    uint32_t switch_case_count;
+    
+    // FOR 循环描述符
+    ForLoop* for_loops;
+    uint32_t for_loop_count;
+    
+    // 数组描述符
+    ArrayBound* array_bounds;
+    uint32_t array_bound_count;
+    
     // 调试信息
-    int* line_numbers;      // 指令行号映射（可选）
+    LineTable line_table;   // 指令行号表（可选，count 为 0 表示没有）
     char* source_file;      // 源文件名（可选）
+    
+    // 文件映像（零拷贝加载时，指令数组和字符串常量直接指向映像内部）
+    void* image;            // 映像基址（NULL 表示没有映像）
+    size_t image_size;      // 映像大小
+    bool image_mapped;      // true: mmap 只读映射；false: mmgr 分配的缓冲区
+    bool debug_pending;     // 映像中的调试段尚未加载
+    
+    // 导出符号索引（库文件映像中的 SYMBOLS 段；函数表被修改时失效置空）
+    const struct STBCSymbolIndex* symbol_index;
+    
+    // 寄存器格式代码（NULL 表示只按栈式执行；修改指令时丢弃，见 regcode.h）
+    struct RegCode* reg_code;
 } BytecodeModule;
 
 /**
@@ -203,6 +346,63 @@ const char* opcode_to_string(Opcode opcode);
  */
 BytecodeModule* bytecode_module_create(void);
 
+/**
+ * @brief 按给定容量创建字节码模块
+ * 
+ * 用于已知规模的场景（如从 .stbc 加载），容量为 0 的表不预先分配，
+ * 之后追加时仍会按需增长。
+ * 
+ * @param instruction_capacity 指令数组容量
+ * @param const_capacity 常量池容量
+ * @param function_capacity 函数表容量
+ * @return 新创建的模块，失败返回 NULL
+ */
+BytecodeModule* bytecode_module_create_sized(uint32_t instruction_capacity,
+                                             uint32_t const_capacity,
+                                             uint32_t function_capacity);
+
+/**
+ * @brief 确保指令数组至少能容纳 needed 条指令（行号数组同步扩展）
+ * @param module 字节码模块
+ * @param needed 需要的指令总数
+ * @return 成功返回 true
+ */
+bool bytecode_reserve_instructions(BytecodeModule* module, uint32_t needed);
+
+/**
+ * @brief 确保常量池至少能容纳 needed 个常量
+ * @param module 字节码模块
+ * @param needed 需要的常量总数
+ * @return 成功返回 true
+ */
+bool bytecode_reserve_constants(BytecodeModule* module, uint32_t needed);
+
+/**
+ * @brief 确保函数表至少能容纳 needed 个函数
+ * @param module 字节码模块
+ * @param needed 需要的函数总数
+ * @return 成功返回 true
+ */
+bool bytecode_reserve_functions(BytecodeModule* module, uint32_t needed);
+
+/**
+ * @brief 判断指针是否指向模块的文件映像内部
+ * @param module 字节码模块
+ * @param ptr 待检查的指针
+ * @return 位于映像内返回 true（此类内存不能单独释放或写入）
+ */
+bool bytecode_in_image(const BytecodeModule* module, const void* ptr);
+
+/**
+ * @brief 确保指令数组可写
+ * 
+ * 指令数组仍指向只读映像时，复制一份到堆上；原地修改指令前调用。
+ * 
+ * @param module 字节码模块
+ * @return 成功返回 true
+ */
+bool bytecode_make_writable(BytecodeModule* module);
+
 /**
  * @brief 释放字节码模块
  * @param module 字节码模块指针
@@ -230,6 +430,35 @@ uint32_t bytecode_add_instruction(BytecodeModule* module, Opcode opcode, uint8_t
  */
 uint32_t bytecode_add_instruction_with_line(BytecodeModule* module, Opcode opcode, uint8_t flags, uint16_t operand, int line);
 
+/**
+ * @brief 在行号表末尾记录 pc 处开始的行号（行号未变化时不新增条目）
+ * @param module 字节码模块
+ * @param pc 指令地址（不得小于已记录的最大地址）
+ * @param line 源码行号
+ * @return 成功返回 true
+ */
+bool bytecode_line_table_append(BytecodeModule* module, uint32_t pc, int32_t line);
+
+/**
+ * @brief 查询指令对应的源码行号（O(log n)）
+ * @param module 字节码模块
+ * @param pc 指令地址
+ * @return 行号，没有行号信息返回 0
+ */
+int32_t bytecode_line_for_pc(const BytecodeModule* module, uint32_t pc);
+
+/**
+ * @brief 查询源码行对应的首条指令地址（O(log n)）
+ * 
+ * 该行没有生成代码时返回其后最近一个有代码的行的首条指令，
+ * 便于调试器在空行或注释行上设置断点。
+ * 
+ * @param module 字节码模块
+ * @param line 源码行号
+ * @return 指令地址，找不到返回 (uint32_t)-1
+ */
+uint32_t bytecode_pc_for_line(BytecodeModule* module, int32_t line);
+
 /**
  * @brief 修改指令的操作数（用于回填跳转地址）
  * @param module 字节码模块
@@ -238,6 +467,38 @@ uint32_t bytecode_add_instruction_with_line(BytecodeModule* module, Opcode opcod
  */
 void bytecode_patch_operand(BytecodeModule* module, uint32_t index, uint16_t operand);
 
+/**
+ * @brief 删除标记的指令并压缩指令序列
+ * 
+ * 跳转目标（含跳转表）、函数入口地址、入口点和行号表随之重定位：指向被删指令的
+ * 地址改为其后第一条保留的指令。调用者须保证被删指令不影响语义
+ * （如 NOP、跳到下一条的 JMP、不可达代码）。
+ * 
+ * @param module 字节码模块
+ * @param removed 删除标记，长度为 instruction_count
+ * @return 删除的指令数，失败返回 (uint32_t)-1
+ */
+uint32_t bytecode_remove_instructions(BytecodeModule* module, const bool* removed);
+
+/**
+ * @brief 用一段指令替换一条指令
+ * 
+ * 原指令之后的代码后移 count-1 条；跳转目标（含跳转表和 FOR 循环描述符）、
+ * 函数入口地址和入口点随之重定位，指向原指令的地址改为指向片段起点。
+ * 片段内的跳转由调用者按最终地址填写，不再重定位。
+ * 
+ * @param module 字节码模块
+ * @param index 被替换指令的地址
+ * @param code 替换片段
+ * @param count 片段指令数（至少 1）
+ * @param lines 片段的行号条目（pc 相对片段起点，可为 NULL）
+ * @param line_count 行号条目数
+ * @return 成功返回 true（失败时模块不变）
+ */
+bool bytecode_replace_instruction(BytecodeModule* module, uint32_t index,
+                                  const Instruction* code, uint32_t count,
+                                  const LineEntry* lines, uint32_t line_count);
+
 /**
  * @brief 添加整数常量
  * @param module 字节码模块
@@ -270,6 +531,13 @@ uint32_t bytecode_add_bool_constant(BytecodeModule* module, bool value);
  */
 uint32_t bytecode_add_string_constant(BytecodeModule* module, const char* value);
 
+/**
+ * @brief 截断常量池，释放 count 之后的常量（哈希索引随之重建）
+ * @param module 字节码模块
+ * @param count 保留的常量个数
+ */
+void bytecode_truncate_constants(BytecodeModule* module, uint32_t count);
+
 /**
  * @brief 添加函数到函数表
  * @param module 字节码模块
@@ -285,14 +553,121 @@ uint32_t bytecode_add_function(BytecodeModule* module, const char* name, uint32_
                                 int32_t param_count, int32_t local_count, DataType return_type,
                                 const DataType* param_types);
 
+/**
+ * @brief 追加全局变量
+ * 
+ * 模块已有元数据（或尚无全局变量）时同时追加元数据条目，新变量初值由虚拟机按
+ * 全局区统一初始化。
+ * 
+ * @param module 字节码模块
+ * @param name 变量名（复制）
+ * @param type 变量类型
+ * @return 全局变量索引，失败返回 -1
+ */
+int32_t bytecode_add_global(BytecodeModule* module, const char* name, DataType type);
+
 /**
  * @brief 查找函数
+ * 
+ * 模块带导出符号索引（库文件）时按哈希查找，否则顺序查找。
+ * 
  * @param module 字节码模块
  * @param name 函数名
  * @return 函数条目指针，未找到返回NULL
  */
 FunctionEntry* bytecode_find_function(BytecodeModule* module, const char* name);
 
+/**
+ * @brief 添加跳转表
+ * 
+ * cases 须按 low 递增且互不重叠。kind 为 SWITCH_DENSE 时按值展开为
+ * 逐值条目，区间之间的空缺指向 default_target。
+ * 
+ * @param module 字节码模块
+ * @param kind 查找方式
+ * @param cases 区间条目
+ * @param count 条目数
+ * @param default_target 没有匹配时的目标地址
+ * @return 跳转表下标，失败返回 (uint32_t)-1
+ */
+uint32_t bytecode_add_switch_table(BytecodeModule* module, SwitchKind kind,
+                                   const SwitchCase* cases, uint32_t count,
+                                   uint32_t default_target);
+
+/**
+ * @brief 查找选择值在跳转表中的目标地址（稠密表 O(1)，有序表 O(log n)）
+ * @param module 字节码模块
+ * @param table 跳转表下标
+ * @param value 选择值
+ * @return 目标地址，跳转表下标无效返回 (uint32_t)-1
+ */
+uint32_t bytecode_switch_target(const BytecodeModule* module, uint32_t table, int32_t value);
+
+/**
+ * @brief 添加 FOR 循环描述符
+ * @param module 字节码模块
+ * @param loop 描述符（复制）
+ * @return 描述符下标，失败返回 (uint32_t)-1
+ */
+uint32_t bytecode_add_for_loop(BytecodeModule* module, const ForLoop* loop);
+
+/**
+ * @brief FOR 循环体是否可能改写循环变量
+ * 
+ * 检查循环体内（不含本循环的 OP_FOR_STEP）对循环变量的存储、同一变量的内层循环、
+ * 覆盖它的数组存储、同一区内的 *_INDEXED 存储，以及循环变量在全局区时的调用。
+ * 
+ * @param module 字节码模块
+ * @param loop_index 描述符下标
+ * @return 可能改写（或描述符无效）返回 true
+ */
+bool bytecode_for_loop_writes_var(const BytecodeModule* module, uint32_t loop_index);
+
+/**
+ * @brief 计算 FOR 循环的迭代次数（初值和终值都是常量、循环体不改写循环变量时）
+ * @param module 字节码模块
+ * @param loop_index 描述符下标
+ * @param trip_count 输出迭代次数（不进入循环时为 0）
+ * @return 迭代次数在编译期已知返回 true
+ */
+bool bytecode_for_loop_trip_count(const BytecodeModule* module, uint32_t loop_index,
+                                  uint32_t* trip_count);
+
+/**
+ * @brief 添加数组描述符（与已有描述符相同时复用）
+ * @param module 字节码模块
+ * @param base 首元素（全局索引或帧内偏移）
+ * @param lower 下标下界
+ * @param length 声明的元素个数
+ * @param is_global 是否在全局区
+ * @return 描述符下标，失败返回 (uint32_t)-1
+ */
+uint32_t bytecode_add_array_bound(BytecodeModule* module, uint32_t base, int32_t lower,
+                                  uint32_t length, bool is_global);
+
+/**
+ * @brief 标记下标可证明在声明范围内的数组访问（设置或清除 FLAG_UNCHECKED）
+ *
+ * 区间分析只看栈式代码中紧邻访问指令的下标表达式：整数常量、FOR 循环变量
+ * （常量初值和终值、循环体只能从 OP_FOR_INIT 进入、体内不改写循环变量）以及
+ * 它们的 + - * NEG 和对正常量取 MOD。修改指令的变换（内联、链接、窥孔）之后须重新标记。
+ *
+ * @param module 字节码模块
+ * @return 免检的访问数
+ */
+uint32_t bytecode_mark_unchecked_arrays(BytecodeModule* module);
+
+/**
+ * @brief 校验数组访问（加载 .stbc 时使用）
+ *
+ * 描述符下标有效、全局数组不超出全局变量区、局部数组不超出所在函数的局部变量区，
+ * 且每条免检访问的下标都能按 bytecode_mark_unchecked_arrays 的规则重新证明。
+ *
+ * @param module 字节码模块
+ * @return 校验通过返回 true
+ */
+bool bytecode_verify_arrays(const BytecodeModule* module);
+
 /**
  * @brief 获取当前指令位置（用于标签）
  * @param module 字节码模块
@@ -323,6 +698,39 @@ void bytecode_print_module(BytecodeModule* module);
  */
 ErrorCode bytecode_merge_library(BytecodeModule* main, BytecodeModule* library, const char* library_name);
 
+/**
+ * @brief 裁剪结果（静态链接后删除的内容）
+ */
+typedef struct TreeShakeStats {
+    char** removed_functions;       // 删除的函数名（bytecode_tree_shake_stats_free 释放）
+    uint32_t removed_function_count;
+    uint32_t removed_instructions;  // 删除的指令数
+    uint32_t removed_constants;     // 删除的常量数
+    uint32_t removed_descriptors;   // 删除的跳转表、FOR 循环和数组描述符数
+} TreeShakeStats;
+
+/**
+ * @brief 删除从入口不可达的函数、指令、常量和描述符（静态链接后的树摇）
+ *
+ * 从模块入口点（和指定的入口函数）出发，沿顺序执行、跳转、跳转表、FOR 循环
+ * 描述符以及 OP_CALL/OP_CALL_EXT 调用关系求可达指令；不可达的指令（未被调用的
+ * 函数、库自身的初始化代码等）被删除，剩余代码压缩并重定位。函数表只保留被可达
+ * 调用引用的函数和入口函数，常量池和描述符只保留可达指令引用的条目，操作数随之重编号。
+ * 库模块（导出全部函数）不应裁剪。
+ *
+ * @param module 字节码模块
+ * @param entry_function 额外的入口函数名（-e，可为 NULL；先精确后不区分大小写查找）
+ * @param stats 输出裁剪结果（可为 NULL）
+ * @return 成功返回 OK，失败返回错误码（内存不足时模块可能只裁剪了一部分，但仍一致）
+ */
+ErrorCode bytecode_tree_shake(BytecodeModule* module, const char* entry_function, TreeShakeStats* stats);
+
+/**
+ * @brief 释放裁剪结果中的函数名
+ * @param stats 裁剪结果
+ */
+void bytecode_tree_shake_stats_free(TreeShakeStats* stats);
+
 /**
  * @brief 添加库依赖到字节码模块
  * @param module 字节码模块
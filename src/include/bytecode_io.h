@@ -22,8 +22,18 @@ struct SymbolTable;
 /**
  * @brief STBC文件版本
  */
-#define STBC_VERSION_MAJOR 1
-#define STBC_VERSION_MINOR 1
+#define STBC_VERSION_MAJOR 3
+#define STBC_VERSION_MINOR 5
+
+/**
+ * @brief 仍可读取的旧版本（流式逐字段格式）
+ */
+#define STBC_LEGACY_VERSION_MAJOR 1
+
+/**
+ * @brief 段对齐（字节）
+ */
+#define STBC_SECTION_ALIGN 8
 
 /**
  * @brief STBC文件头
@@ -41,8 +51,156 @@ typedef struct STBCHeader {
     uint32_t checksum;              // CRC32校验和（可选）
 } STBCHeader;
 
+/**
+ * @brief 段类型
+ */
+typedef enum {
+    STBC_SECTION_CODE = 1,      // 指令数组
+    STBC_SECTION_CONSTANTS,     // 常量表（STBCConstRecord 数组）
+    STBC_SECTION_STRINGS,       // 常量字符串区
+    STBC_SECTION_FUNCTIONS,     // 函数表
+    STBC_SECTION_GLOBALS,       // 全局变量元数据（调试/热重载）
+    STBC_SECTION_LIBDEPS,       // 库依赖
+    STBC_SECTION_LINES,         // 源文件名与行号表（调试）
+    STBC_SECTION_SYMBOLS,       // 导出符号索引（带函数的模块）
+    STBC_SECTION_SWITCHES,      // CASE 跳转表（3.1 起，有 OP_SWITCH 时才写出）
+    STBC_SECTION_LOOPS,         // FOR 循环描述符（3.2 起，有 OP_FOR_INIT 时才写出）
+    STBC_SECTION_REGCODE,       // 寄存器格式代码（3.3 起，带 STBC_FLAG_REGISTER_CODE 时写出）
+    STBC_SECTION_ARRAYS         // 数组描述符（3.4 起，有 OP_LOAD_ARRAY/OP_STORE_ARRAY 时才写出；3.5 起带下界）
+} STBCSectionType;
+
+/**
+ * @brief 段标志：调试段，加载时跳过，按需通过 bytecode_load_debug_info 读取
+ */
+#define STBC_SECTION_FLAG_DEBUG 0x01
+
+/**
+ * @brief 段表最大条目数
+ */
+#define STBC_MAX_SECTIONS 16
+
+/**
+ * @brief STBC 3.x 段表头（紧跟文件头，其后是 section_count 个 STBCSection）
+ */
+typedef struct STBCLayout {
+    uint32_t file_size;             // 文件总大小
+    uint32_t section_count;         // 段表条目数
+    uint32_t flags;                 // STBC_FLAG_*（3.3 起，旧版本为 0）
+    uint32_t reserved;
+} STBCLayout;
+
+/**
+ * @brief 模块标志：按寄存器格式执行（模块带 STBC_SECTION_REGCODE 段）
+ */
+#define STBC_FLAG_REGISTER_CODE 0x01
+
+/**
+ * @brief 段表条目
+ * 
+ * 偏移相对文件起始且按 STBC_SECTION_ALIGN 对齐；checksum 是该段内容的 CRC32，
+ * 加载（或按需读取调试段）时逐段校验。未知类型的段被忽略。
+ */
+typedef struct STBCSection {
+    uint32_t type;                  // STBCSectionType
+    uint32_t flags;                 // STBC_SECTION_FLAG_*
+    uint32_t offset;                // 段偏移
+    uint32_t size;                  // 段大小
+    uint32_t checksum;              // 段内容 CRC32
+    uint32_t reserved;
+} STBCSection;
+
+/**
+ * @brief 常量表记录（定长 16 字节）
+ */
+typedef struct STBCConstRecord {
+    uint32_t type;                  // ConstantType
+    uint32_t length;                // 字符串长度（含 '\0'，0 表示空指针）
+    union {
+        int32_t int_val;
+        double real_val;
+        uint8_t bool_val;
+        uint64_t string_ref;        // 字符串在字符串区内的偏移
+    } value;
+} STBCConstRecord;
+
+/**
+ * @brief 导出符号索引段头（STBC_SECTION_SYMBOLS，带函数的模块和库文件）
+ * 
+ * 其后是 bucket_count 个 uint32_t 槽位（开放寻址、线性探测，存放 记录下标+1，
+ * 0 表示空槽），再后是 symbol_count 个 STBCSymbolRecord。名称不重复存储，
+ * 哈希命中后与函数表中的名称比较确认。同名函数只索引第一个。
+ */
+typedef struct STBCSymbolIndex {
+    uint32_t symbol_count;          // 符号个数
+    uint32_t bucket_count;          // 槽位数，2 的幂且大于 symbol_count
+    uint32_t function_count;        // 建立索引时的函数个数
+    uint32_t reserved;
+} STBCSymbolIndex;
+
+/**
+ * @brief 导出符号记录（定长 24 字节）
+ */
+typedef struct STBCSymbolRecord {
+    uint32_t hash;                  // 名称哈希（bytecode_symbol_hash）
+    uint32_t function_index;        // 函数表下标（参数类型等见函数表）
+    uint32_t address;               // 函数入口地址
+    int32_t param_count;            // 参数个数
+    int32_t local_count;            // 局部变量个数
+    uint32_t return_type;           // 返回类型（DataType）
+} STBCSymbolRecord;
+
+/**
+ * @brief 跳转表段头（STBC_SECTION_SWITCHES）
+ * 
+ * 其后是 table_count 个 SwitchTable，再后是 case_count 个 SwitchCase
+ * （均为定长 4 字节字段，与内存布局相同）。
+ */
+typedef struct STBCSwitchHeader {
+    uint32_t table_count;           // 跳转表个数
+    uint32_t case_count;            // 条目总数
+} STBCSwitchHeader;
+
+/**
+ * @brief FOR 循环描述符段头（STBC_SECTION_LOOPS）
+ * 
+ * 其后是 loop_count 个 ForLoop（均为定长 4 字节字段，与内存布局相同）。
+ */
+typedef struct STBCLoopHeader {
+    uint32_t loop_count;            // 描述符个数
+} STBCLoopHeader;
+
+/**
+ * @brief 数组描述符段头（STBC_SECTION_ARRAYS）
+ * 
+ * 其后是 bound_count 个 ArrayBound（均为定长 4 字节字段，与内存布局相同）。
+ * 3.4 的记录没有末尾的 lower 字段，加载时按段大小识别，下界取 0。
+ * 加载时校验描述符和所有免检访问（见 bytecode_verify_arrays）。
+ */
+typedef struct STBCArrayHeader {
+    uint32_t bound_count;           // 描述符个数
+} STBCArrayHeader;
+
+/**
+ * @brief 寄存器格式代码段头（STBC_SECTION_REGCODE）
+ * 
+ * 其后依次是 function_count 个 RegFunction、instruction_count 个 RegInstruction、
+ * instruction_count 个来源地址和 map_count 个地址映射（均为 uint32_t），
+ * 定长字段与内存布局相同。加载时完整校验后才按寄存器格式执行。
+ */
+typedef struct STBCRegCodeHeader {
+    uint32_t instruction_count;     // 寄存器指令数
+    uint32_t function_count;        // 函数条目数（等于函数表大小）
+    uint32_t main_entry;            // 主程序入口
+    uint32_t main_frame_size;       // 主程序帧大小
+    uint32_t map_count;             // 地址映射条目数（等于栈式指令数）
+    uint32_t reserved;
+} STBCRegCodeHeader;
+
 /**
  * @brief 保存字节码模块到文件
+ * 
+ * 模块带函数时同时写出导出符号索引段，编译结果可直接作为库导入。
+ * 
  * @param module 字节码模块
  * @param filename 文件名（.stbc）
  * @return 成功返回OK，失败返回错误码
@@ -51,6 +209,11 @@ ErrorCode bytecode_save(const BytecodeModule* module, const char* filename);
 
 /**
  * @brief 从文件加载字节码模块
+ * 
+ * 3.x 格式以只读 mmap 映射整个文件，指令数组与字符串常量直接指向映射
+ * （多个进程加载同一文件时共享物理页），调试段（全局变量元数据、行号表）
+ * 延迟到 bytecode_load_debug_info 时读取；1.x 旧格式回退到流式读取。
+ * 
  * @param filename 文件名（.stbc）
  * @return 成功返回字节码模块，失败返回NULL
  */
@@ -66,11 +229,43 @@ ErrorCode bytecode_save_to_stream(const BytecodeModule* module, FILE* fp);
 
 /**
  * @brief 从文件流加载字节码模块
+ * 
+ * 3.x 格式将剩余内容读入一块缓冲区后按映像解析。
+ * 
  * @param fp 文件指针
  * @return 成功返回字节码模块，失败返回NULL
  */
 BytecodeModule* bytecode_load_from_stream(FILE* fp);
 
+/**
+ * @brief 从内存映像加载字节码模块
+ * @param data 映像数据（3.x 格式）
+ * @param size 映像大小
+ * @param take_ownership 为 true 时 data 必须由 mmgr_alloc 分配，模块接管并零拷贝引用；
+ *                       为 false 时复制一份
+ * @return 成功返回字节码模块，失败返回NULL（take_ownership 时 data 已被释放）
+ */
+BytecodeModule* bytecode_load_from_memory(void* data, size_t size, bool take_ownership);
+
+/**
+ * @brief 按需加载调试段（全局变量元数据、源文件名与行号表）
+ * 
+ * 供调试器和热重载在需要时调用；模块没有待加载的调试段时直接返回 OK。
+ * 
+ * @param module 字节码模块
+ * @return 成功返回OK，调试段损坏返回 ERR_INVALID_BYTECODE
+ */
+ErrorCode bytecode_load_debug_info(BytecodeModule* module);
+
+/**
+ * @brief 获取模块映像中的段
+ * @param module 字节码模块（须由 3.x 映像加载）
+ * @param type 段类型
+ * @param size 输出段大小（可为NULL）
+ * @return 段数据指针，不存在返回NULL
+ */
+const void* bytecode_get_section(const BytecodeModule* module, STBCSectionType type, uint32_t* size);
+
 /**
  * @brief 验证STBC文件头
  * @param header 文件头
@@ -94,12 +289,90 @@ uint32_t bytecode_compute_checksum(const BytecodeModule* module);
 bool bytecode_verify_checksum(const BytecodeModule* module, uint32_t expected_checksum);
 
 /**
- * @brief 将字节码模块保存为库文件（包含符号表导出）
+ * @brief 内容摘要的规模部分（按字节参与摘要，各字段都是 uint32_t，没有填充）
+ */
+typedef struct {
+    uint32_t entry_point;
+    uint32_t instruction_count;
+    uint32_t const_count;
+    uint32_t function_count;
+    uint32_t global_count;
+    uint32_t library_dep_count;
+    uint32_t switch_table_count;
+    uint32_t switch_case_count;
+    uint32_t for_loop_count;
+    uint32_t array_bound_count;
+} STBCDigestShape;
+
+/**
+ * @brief 计算模块内容摘要（标识补丁的基准和目标模块）
+ *
+ * 与只覆盖代码和表项个数的 bytecode_compute_checksum 不同，摘要覆盖所有影响执行的
+ * 内容：依次是规模（STBCDigestShape）、指令、常量值、函数表、库依赖、跳转表、FOR 循环
+ * 描述符和数组描述符。调试信息（行号表、全局变量元数据、源文件名）和寄存器代码不参与。
+ *
  * @param module 字节码模块
- * @param symtbl 符号表（用于导出函数签名）
+ * @return CRC32 摘要
+ */
+uint32_t bytecode_compute_digest(const BytecodeModule* module);
+
+/**
+ * @brief 把一个常量按摘要格式加入 CRC（供按补丁预测目标摘要）
+ * @param crc 之前的 CRC32
+ * @param constant 常量
+ * @return 更新后的 CRC32
+ */
+uint32_t bytecode_digest_constant(uint32_t crc, const Constant* constant);
+
+/**
+ * @brief 把一个函数表条目按摘要格式加入 CRC（没有参数类型时按 TYPE_INT 计）
+ * @param crc 之前的 CRC32
+ * @param name 函数名
+ * @param address 入口地址
+ * @param param_count 参数个数（负数表示可变参数，没有参数类型）
+ * @param local_count 局部变量个数
+ * @param return_type 返回类型
+ * @param param_types 参数类型（DataType 数组，未必对齐，可为 NULL）
+ * @return 更新后的 CRC32
+ */
+uint32_t bytecode_digest_function(uint32_t crc, const char* name, uint32_t address,
+                                  int32_t param_count, int32_t local_count,
+                                  DataType return_type, const void* param_types);
+
+/**
+ * @brief 把一个字符串（含长度）按摘要格式加入 CRC
+ * @param crc 之前的 CRC32
+ * @param str 字符串（NULL 按空串计）
+ * @return 更新后的 CRC32
+ */
+uint32_t bytecode_digest_string(uint32_t crc, const char* str);
+
+/**
+ * @brief 将字节码模块保存为库文件（没有函数时也附带导出符号索引段）
+ * 
+ * 导出模块中所有具名函数。导入方加载后无需重建查找结构，
+ * 即可按名称 O(1) 查到函数的类型、地址和参数个数。
+ * 
+ * @param module 字节码模块
+ * @param symtbl 符号表（保留，函数签名取自函数表）
  * @param filename 文件名（.stbc）
  * @return 成功返回OK，失败返回错误码
  */
 ErrorCode bytecode_save_library(const BytecodeModule* module, const struct SymbolTable* symtbl, const char* filename);
 
+/**
+ * @brief 计算符号名哈希（FNV-1a）
+ * @param name 符号名
+ * @return 哈希值
+ */
+uint32_t bytecode_symbol_hash(const char* name);
+
+/**
+ * @brief 在模块的导出符号索引中查找符号
+ * @param module 字节码模块
+ * @param name 符号名
+ * @return 符号记录（指向映像），模块没有索引或未找到返回NULL
+ */
+const STBCSymbolRecord* bytecode_lookup_symbol(const BytecodeModule* module, const char* name);
+
 #endif // STVM_BYTECODE_IO_H
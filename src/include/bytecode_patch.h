@@ -0,0 +1,249 @@
+/**
+ * @file bytecode_patch.h
+ * @brief 字节码差分补丁 - .stbp 文件格式
+ *
+ * 补丁描述从基准模块到目标模块的变化，基准和目标模块以内容摘要
+ * （bytecode_compute_digest，覆盖指令、常量值、函数表和各描述符）标识：
+ * 1. 指令：按函数名对齐的代码段从基准搬移并重定位（跳转地址、常量下标、
+ *    函数下标），只记录重定位后仍与目标不同的指令区间
+ * 2. 常量：与基准相同的常量按复制区间取自基准，其余逐条给出
+ * 3. 函数表、全局变量布局：只记录（入口地址重定位后）与基准不同的条目（按下标）
+ * 4. 行号表：随代码段重定位，相同的条目按复制区间取自重定位结果，其余逐条给出
+ * 5. 库依赖、跳转表、FOR 循环描述符、数组描述符：重定位后仍有变化时整体替换
+ *
+ * 前面的函数变长或变短时，后面的函数整体平移，不会进入补丁：
+ * 补丁大小与应用开销只与变化量相关，与程序规模和变化位置无关。
+ */
+
+#ifndef STVM_BYTECODE_PATCH_H
+#define STVM_BYTECODE_PATCH_H
+
+#include "bytecode.h"
+#include "error.h"
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief STBP 文件格式魔数
+ */
+#define STBP_MAGIC 0x50425453  // "STBP" in little-endian
+
+/**
+ * @brief STBP 文件版本
+ */
+#define STBP_VERSION_MAJOR 3
+#define STBP_VERSION_MINOR 0
+
+/**
+ * @brief 补丁标志
+ */
+#define STBP_FLAG_GLOBAL_INFO 0x01  // 目标模块带全局变量元数据
+#define STBP_FLAG_LIBDEPS     0x02  // 库依赖整体替换
+#define STBP_FLAG_SWITCHES    0x08  // 跳转表整体替换
+#define STBP_FLAG_LOOPS       0x10  // FOR 循环描述符整体替换
+#define STBP_FLAG_ARRAYS      0x20  // 数组描述符整体替换
+
+/**
+ * @brief STBP 文件头（其后依次是代码段、指令区间、常量复制区间、新常量、函数条目、
+ *        全局变量条目、库依赖、行号复制区间、新行号条目、跳转表、FOR 循环描述符、数组描述符）
+ */
+typedef struct STBPHeader {
+    uint32_t magic;                 // 魔数 (STBP_MAGIC)
+    uint16_t version_major;         // 主版本号
+    uint16_t version_minor;         // 次版本号
+    uint32_t base_digest;           // 基准模块内容摘要
+    uint32_t target_digest;         // 目标模块内容摘要
+    uint32_t flags;                 // STBP_FLAG_*
+    uint32_t entry_point;           // 目标入口点
+    uint32_t instruction_count;     // 目标指令数
+    uint32_t const_count;           // 目标常量个数
+    uint32_t const_copy_count;      // 常量复制区间个数
+    uint32_t function_count;        // 目标函数个数
+    uint32_t global_count;          // 目标全局变量个数
+    uint32_t line_count;            // 目标行号条目个数
+    uint32_t line_copy_count;       // 行号复制区间个数
+    uint32_t segment_count;         // 代码段个数
+    uint32_t run_count;             // 指令区间个数
+    uint32_t function_record_count; // 函数条目个数
+    uint32_t global_record_count;   // 全局变量条目个数
+    uint32_t payload_size;          // 文件头之后的数据长度
+    uint32_t payload_checksum;      // 文件头之后数据的 CRC32
+} STBPHeader;
+
+/**
+ * @brief 代码段：基准 [base_offset, base_offset + count) 搬到目标 target_offset 处
+ *
+ * 段内指令的跳转地址按所有代码段组成的地址映射重定位，常量下标按常量复制区间、
+ * 函数下标按函数名重定位；落在段内的行号条目随之平移，行号加上 line_delta。
+ */
+typedef struct {
+    uint32_t target_offset;
+    uint32_t base_offset;
+    uint32_t count;
+    int32_t line_delta;
+} PatchSegment;
+
+/**
+ * @brief 复制区间：目标表 [target_offset, target_offset + count) 取自来源表 source_offset 起的条目
+ *
+ * 常量的来源是基准常量池，行号条目的来源是重定位后的基准行号表；
+ * 不在任何复制区间内的条目按顺序取补丁中逐条给出的内容。
+ */
+typedef struct {
+    uint32_t target_offset;
+    uint32_t source_offset;
+    uint32_t count;
+} PatchCopy;
+
+/**
+ * @brief 指令区间：目标模块 [offset, offset + count) 的指令（覆盖代码段的结果）
+ */
+typedef struct {
+    uint32_t offset;
+    uint32_t count;
+    const uint8_t* code;            // 指向补丁数据（未必对齐）
+} PatchCodeRun;
+
+/**
+ * @brief 函数条目：目标函数表第 index 项
+ */
+typedef struct {
+    uint32_t index;
+    const char* name;               // 指向补丁数据
+    uint32_t address;
+    int32_t param_count;
+    int32_t local_count;
+    DataType return_type;
+    const uint8_t* param_types;     // 指向补丁数据（未必对齐）
+} PatchFunction;
+
+/**
+ * @brief 全局变量条目：目标全局变量第 index 项
+ */
+typedef struct {
+    uint32_t index;
+    const char* name;               // 指向补丁数据
+    DataType type;
+} PatchGlobal;
+
+/**
+ * @brief 已解析的补丁（各视图直接指向 data 内部）
+ */
+typedef struct BytecodePatch {
+    uint8_t* data;                  // 补丁文件内容（补丁拥有）
+    size_t size;
+    STBPHeader header;
+
+    PatchSegment* segments;         // header.segment_count 项（按目标地址递增）
+    PatchCodeRun* runs;             // header.run_count 项
+    PatchCopy* const_copies;        // header.const_copy_count 项（按目标下标递增）
+    PatchCopy* line_copies;         // header.line_copy_count 项（按目标下标递增）
+    PatchFunction* functions;       // header.function_record_count 项
+    PatchGlobal* globals;           // header.global_record_count 项
+
+    const uint8_t* constants;       // 新常量记录
+    size_t constants_size;
+    uint32_t new_const_count;       // 新常量个数（不在复制区间内的常量）
+    const uint8_t* library_deps;    // 库依赖（STBP_FLAG_LIBDEPS）
+    size_t library_deps_size;
+    uint32_t library_dep_count;
+    const uint8_t* lines;           // 新行号条目 LineEntry 数组（未必对齐）
+    uint32_t new_line_count;        // 新行号条目个数
+    const uint8_t* switch_tables;   // SwitchTable 数组（STBP_FLAG_SWITCHES，未必对齐）
+    uint32_t switch_table_count;
+    const uint8_t* switch_cases;    // SwitchCase 数组（未必对齐）
+    uint32_t switch_case_count;
+    const uint8_t* for_loops;       // ForLoop 数组（STBP_FLAG_LOOPS，未必对齐）
+    uint32_t for_loop_count;
+    const uint8_t* array_bounds;    // ArrayBound 数组（STBP_FLAG_ARRAYS，未必对齐）
+    uint32_t array_bound_count;
+} BytecodePatch;
+
+/**
+ * @brief 比较两个模块，生成把 base 变为 target 的补丁
+ *
+ * 两个模块的调试段会被加载，以便比较全局变量布局和行号表。
+ *
+ * @param base 基准模块
+ * @param target 目标模块
+ * @return 补丁，失败返回 NULL
+ */
+BytecodePatch* bytecode_patch_create(BytecodeModule* base, BytecodeModule* target);
+
+/**
+ * @brief 从内存解析补丁
+ * @param data 补丁数据（须由 mmgr_alloc 分配）
+ * @param size 数据长度
+ * @param take_ownership 为 true 时补丁接管 data（失败时也会释放），否则复制一份
+ * @return 补丁，格式错误返回 NULL
+ */
+BytecodePatch* bytecode_patch_load_from_memory(void* data, size_t size, bool take_ownership);
+
+/**
+ * @brief 从 .stbp 文件加载补丁
+ * @param filename 文件名
+ * @return 补丁，失败返回 NULL
+ */
+BytecodePatch* bytecode_patch_load(const char* filename);
+
+/**
+ * @brief 保存补丁到 .stbp 文件
+ * @param patch 补丁
+ * @param filename 文件名
+ * @return 错误码
+ */
+ErrorCode bytecode_patch_save(const BytecodePatch* patch, const char* filename);
+
+/**
+ * @brief 释放补丁
+ * @param patch 补丁
+ */
+void bytecode_patch_free(BytecodePatch* patch);
+
+/**
+ * @brief 检查补丁能否应用于模块
+ *
+ * 模块摘要须等于补丁的基准摘要，各表规模须能由补丁补齐，且按补丁叠加后的
+ * 内容摘要（在临时缓冲中构造，不修改模块）须等于目标摘要。
+ *
+ * @param patch 补丁
+ * @param module 基准模块
+ * @return 可以应用返回 OK，否则返回 ERR_INVALID_BYTECODE
+ */
+ErrorCode bytecode_patch_check(const BytecodePatch* patch, const BytecodeModule* module);
+
+/**
+ * @brief 原地把补丁应用到模块
+ *
+ * 先做完检查（含目标摘要）和容量预留再修改模块：基准或目标不符时模块保持不变，
+ * 除内存不足外不会半途失败。
+ *
+ * @param module 基准模块（被修改为目标模块）
+ * @param patch 补丁
+ * @return 错误码
+ */
+ErrorCode bytecode_patch_apply(BytecodeModule* module, const BytecodePatch* patch);
+
+/**
+ * @brief 判断补丁是否修改了目标模块 [start, end) 内的指令
+ * @param patch 补丁
+ * @param start 起始地址
+ * @param end 结束地址（不含）
+ * @return 有修改返回 true
+ */
+bool bytecode_patch_touches(const BytecodePatch* patch, uint32_t start, uint32_t end);
+
+/**
+ * @brief 判断基准模块 [start, end) 内的代码在目标模块中是否改变或平移
+ *
+ * 整段落在同一个不平移的代码段内、且对应目标范围没有指令区间时返回 false。
+ * 平移的代码按修改处理：调用栈上指向它的返回地址在目标中不再有效。
+ *
+ * @param patch 补丁
+ * @param start 基准起始地址
+ * @param end 基准结束地址（不含）
+ * @return 改变或平移返回 true
+ */
+bool bytecode_patch_moves_range(const BytecodePatch* patch, uint32_t start, uint32_t end);
+
+#endif // STVM_BYTECODE_PATCH_H
@@ -22,6 +22,7 @@ typedef enum {
     MODE_COMPILE_AND_RUN,   // 编译并运行模式
     MODE_REPL,              // 交互模式
     MODE_WCET,              // WCET 分析模式
+    MODE_MAKE_PATCH,        // 生成差分补丁
     MODE_HELP,              // 显示帮助
     MODE_VERSION            // 显示版本
 } CliMode;
@@ -38,6 +39,9 @@ typedef struct {
     bool optimize;                  // 优化开关
     bool dump_ast;                  // 打印AST
     bool dump_bytecode;             // 打印字节码
+    bool use_ir;                    // 经中间表示生成字节码
+    bool dump_ir;                   // 打印中间表示
+    bool register_vm;               // 生成寄存器格式代码（--regvm）
     bool statistics;                // 显示统计信息
     bool compile_library;           // 编译为库文件
     bool static_link;               // 静态链接库（将库代码合并到输出）
@@ -45,8 +49,11 @@ typedef struct {
     int library_path_count;         // 库路径数量
     char* entry_function;           // 入口函数名（运行模式专用）
     int cycle_time_ms;              // 执行周期（毫秒，运行模式专用）
+    bool lazy_libraries;            // 库依赖延迟到首次调用时加载（运行模式专用）
     bool use_io_simulator;          // 启用IO模拟器
     char* io_config_file;           // IO配置文件路径
+    char* io_record_file;           // IO输入记录轨迹文件
+    char* io_replay_file;           // IO输入回放轨迹文件
     
     // WCET 分析选项
     bool run_wcet;                  // 运行 WCET 分析
@@ -54,6 +61,9 @@ typedef struct {
     double wcet_cpu_freq_mhz;       // WCET 目标 CPU 频率
     bool wcet_verbose;              // WCET 详细输出
     char* wcet_source_file;         // WCET 标注解析的 ST 源文件
+    
+    // 差分补丁选项
+    char* patch_base_file;          // 补丁的基准字节码文件
 } CliOptions;
 
 /**
@@ -103,6 +113,13 @@ int cli_compile_and_run(const CliOptions* options);
  */
 int cli_wcet(const CliOptions* options);
 
+/**
+ * @brief 差分补丁生成模式入口
+ * @param options 命令行选项（patch_base_file 为基准，input_file 为目标）
+ * @return 成功返回0，失败返回错误码
+ */
+int cli_make_patch(const CliOptions* options);
+
 /**
  * @brief REPL模式入口
  * @param options 命令行选项
@@ -21,6 +21,8 @@ typedef struct JumpLabel {
     struct JumpLabel* next;         // 链表下一个
 } JumpLabel;
 
+struct Optimizer;
+
 /**
  * @brief 代码生成上下文
  */
@@ -29,6 +31,10 @@ typedef struct CodeGenContext {
     SymbolTable* symtbl;            // 当前符号表
     Symbol* current_function;       // 当前正在生成的函数
     int32_t local_var_count;        // 当前函数的局部变量数
+    int current_line;               // 当前语句的源码行号（0 表示未知）
+    bool use_ir;                    // 经中间表示（SSA）生成字节码
+    bool dump_ir;                   // 打印中间表示
+    struct Optimizer* optimizer;    // 非 NULL 时经中间表示生成，降级前执行 IR 优化遍
     ErrorCode error_code;           // 错误码
     char error_msg[256];            // 错误消息
 } CodeGenContext;
@@ -64,6 +70,13 @@ void codegen_free(CodeGenContext* ctx);
  */
 ErrorCode codegen_generate(CodeGenContext* ctx, ASTNode* program);
 
+/**
+ * @brief 填充模块的全局变量计数和元数据（热加载用）
+ * @param ctx 代码生成器上下文
+ * @return 成功返回OK，失败返回错误码
+ */
+ErrorCode codegen_init_globals(CodeGenContext* ctx);
+
 /**
  * @brief 生成表达式的字节码（结果压栈）
  * @param ctx 代码生成器上下文
@@ -72,6 +85,63 @@ ErrorCode codegen_generate(CodeGenContext* ctx, ASTNode* program);
  */
 ErrorCode codegen_expr(CodeGenContext* ctx, ASTNode* expr);
 
+/**
+ * @brief 逻辑运算是否按短路方式生成
+ *
+ * AND_THEN/OR_ELSE 总是短路；BOOL 类型的 AND/OR 在右操作数无副作用
+ * （不含函数调用和外部 I/O 变量读取）时短路，跳过右操作数不改变结果。
+ *
+ * @param symtbl 符号表（判断外部变量）
+ * @param node 二元运算节点
+ * @return 需要短路时返回 true
+ */
+bool codegen_short_circuit(SymbolTable* symtbl, const ASTNode* node);
+
+/**
+ * @brief FOR 循环能否用循环描述符（OP_FOR_INIT/OP_FOR_STEP）生成
+ *
+ * 循环变量为非外部的 INT 变量，步长为非零常量，终值为常量或变量（每次比较时
+ * 重新读取，与原语义一致），且循环体不给循环变量赋值（否则描述符给出的迭代
+ * 次数不成立）。可以时填写描述符（body/exit 由调用者在发射时填写）。
+ *
+ * @param symtbl 符号表
+ * @param func_name 当前函数名（查找静态终值变量，主程序为 NULL）
+ * @param node FOR 语句节点
+ * @param loop_var 循环变量符号
+ * @param loop 输出描述符
+ * @return 可以时返回 true
+ */
+bool codegen_for_loop_descriptor(SymbolTable* symtbl, const char* func_name, ASTNode* node,
+                                 const Symbol* loop_var, ForLoop* loop);
+
+/**
+ * @brief CASE 标签区间（单值标签 low == high）
+ */
+typedef struct {
+    int32_t low;
+    int32_t high;
+    int branch;                 // 所属分支下标
+} CaseRange;
+
+/**
+ * @brief 收集 CASE 的标签区间，判断能否用跳转表
+ *
+ * 条件：选择表达式为 INT，所有标签都是整数常量，区间互不重叠
+ * （重叠时按源码顺序首个匹配的语义只有比较链能保证），合并后至少
+ * 有 3 个区间。结果按下界排序，同一分支的相邻区间合并。
+ *
+ * @param node CASE 语句节点
+ * @param out 输出区间数组（调用者释放），不可用时为 NULL
+ * @param count 输出区间数
+ * @return 成功返回 OK（包括不可用的情况），内存不足返回错误码
+ */
+ErrorCode codegen_case_ranges(ASTNode* node, CaseRange** out, uint32_t* count);
+
+/**
+ * @brief 选择跳转表形式：值域小且覆盖率高用稠密表，否则用有序区间表
+ */
+SwitchKind codegen_case_table_kind(const CaseRange* ranges, uint32_t count);
+
 /**
  * @brief 生成语句的字节码
  * @param ctx 代码生成器上下文
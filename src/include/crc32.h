@@ -0,0 +1,51 @@
+/**
+ * @file crc32.h
+ * @brief CRC32 (IEEE 802.3, 反射多项式 0xEDB88320) 校验
+ *
+ * 通用实现为 slicing-by-8 查表；在 x86-64 上运行时检测 PCLMULQDQ/SSE4.1，
+ * 可用时对 64 字节以上的数据使用无进位乘法折叠。两条路径结果一致。
+ */
+
+#ifndef STVM_CRC32_H
+#define STVM_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief 计算一块数据的 CRC32
+ * @param data 数据
+ * @param length 数据长度（字节）
+ * @return CRC32
+ */
+uint32_t crc32_compute(const void* data, size_t length);
+
+/**
+ * @brief 增量计算 CRC32
+ *
+ * 初值为 0；分块依次调用的结果与一次性计算整块相同，
+ * 便于逐段校验或边写边算。
+ *
+ * @param crc 之前的 CRC32（首块传 0）
+ * @param data 数据
+ * @param length 数据长度（字节）
+ * @return 更新后的 CRC32
+ */
+uint32_t crc32_update(uint32_t crc, const void* data, size_t length);
+
+/**
+ * @brief 仅使用查表实现增量计算 CRC32（用于校验加速路径）
+ * @param crc 之前的 CRC32（首块传 0）
+ * @param data 数据
+ * @param length 数据长度（字节）
+ * @return 更新后的 CRC32
+ */
+uint32_t crc32_update_portable(uint32_t crc, const void* data, size_t length);
+
+/**
+ * @brief 获取当前选用的实现名称
+ * @return "pclmul" 或 "slice8"
+ */
+const char* crc32_implementation(void);
+
+#endif // STVM_CRC32_H
@@ -14,6 +14,9 @@
  * 3. 检查安全性: hotreload_is_safe()
  * 4. 应用更新: hotreload_apply_staged()
  * 5. 清理: hotreload_free()
+ * 
+ * 也可以暂存差分补丁（hotreload_stage_patch()），应用时原地修改当前模块，
+ * 开销只与补丁大小相关。
  */
 
 #ifndef STVM_HOTRELOAD_H
@@ -22,6 +25,7 @@
 #include "vm.h"
 #include "bytecode.h"
 #include "error.h"
+#include "bytecode_patch.h"
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -46,7 +50,8 @@ typedef enum {
     HOTRELOAD_OP_UPDATE_FUNCTION,   // 更新函数
     HOTRELOAD_OP_ADD_FUNCTION,      // 添加函数
     HOTRELOAD_OP_DELETE_FUNCTION,   // 删除函数
-    HOTRELOAD_OP_REPLACE_MODULE     // 替换整个模块
+    HOTRELOAD_OP_REPLACE_MODULE,    // 替换整个模块
+    HOTRELOAD_OP_APPLY_PATCH        // 原地应用差分补丁
 } HotReloadOperation;
 
 /**
@@ -69,6 +74,7 @@ typedef struct HotReloadManager {
     VM* vm;                         // 虚拟机实例
     BytecodeModule* active_module;  // 当前活动模块（原始）
     BytecodeModule* staged_module;  // 暂存的新模块
+    BytecodePatch* staged_patch;    // 暂存的差分补丁（与 staged_module 互斥）
     FunctionMapping* mappings;      // 函数映射表
     bool reload_pending;            // 是否有待处理的更新
     HotReloadOperation pending_op;  // 待处理的操作类型
@@ -112,6 +118,25 @@ ErrorCode hotreload_stage_module(HotReloadManager* mgr, const char* bytecode_fil
  */
 ErrorCode hotreload_stage_module_from_memory(HotReloadManager* mgr, BytecodeModule* new_module);
 
+/**
+ * @brief 暂存差分补丁（不立即生效）
+ * @param mgr 热更新管理器实例
+ * @param patch_file 补丁文件路径（.stbp）
+ * @return 错误码
+ * 
+ * 补丁须以当前活动模块为基准（校验和一致）。应用时原地修改活动模块，
+ * 不重新加载整个程序。
+ */
+ErrorCode hotreload_stage_patch(HotReloadManager* mgr, const char* patch_file);
+
+/**
+ * @brief 暂存差分补丁（从内存）
+ * @param mgr 热更新管理器实例
+ * @param patch 补丁（管理器接管所有权，失败时也会释放）
+ * @return 错误码
+ */
+ErrorCode hotreload_stage_patch_from_memory(HotReloadManager* mgr, BytecodePatch* patch);
+
 /**
  * @brief 检查是否可以安全地应用热更新
  * @param mgr 热更新管理器实例
@@ -77,6 +77,7 @@ typedef struct {
     double offset;
     bool enable_filter;
     uint32_t filter_samples;
+    double deadband;            // 变化检测死区（模拟量，0 = 任何变化都上报）
 } IOPointConfig;
 
 typedef struct {
@@ -90,8 +91,44 @@ typedef struct {
     uint64_t last_update_us;
     bool initialized;
     pthread_mutex_t mutex;
+    Value reported_value;       // 上次上报变化时的值（死区比较基准）
+    bool reported;              // 是否已上报过
 } IOPoint;
 
+// ============================================================================
+// 变化检测 (Change-of-State)
+// ============================================================================
+
+/**
+ * @brief 变化事件
+ */
+typedef struct {
+    uint32_t point_index;       // I/O 点索引（io_manager_get_point）
+    IOAddress address;          // I/O 地址
+    Value old_value;            // 上次上报的值
+    Value new_value;            // 当前值
+    uint64_t refresh_cycle;     // 发生变化的刷新序号
+} IOChangeEvent;
+
+/**
+ * @brief 变化事件回调
+ *
+ * 在刷新线程中、不持 mgr_mutex 时调用，可以调用本模块的查询、订阅和死区接口。
+ * 分发使用刷新开始时的订阅快照：取消订阅返回后仍可能收到该次刷新的事件。
+ */
+typedef void (*IOChangeCallback)(const IOChangeEvent* event, void* user_data);
+
+/**
+ * @brief 变化订阅
+ */
+typedef struct {
+    uint32_t id;
+    bool has_filter;            // 是否只关注单个地址
+    IOAddress filter;
+    IOChangeCallback callback;
+    void* user_data;
+} IOChangeSubscription;
+
 // ============================================================================
 // 硬件抽象层适配器
 // ============================================================================
@@ -119,6 +156,49 @@ typedef struct IOHardwareAdapter {
     void* platform_data;
 } IOHardwareAdapter;
 
+// ============================================================================
+// 刷新线程实时配置与时序统计
+// ============================================================================
+
+/**
+ * @brief 刷新线程实时配置
+ *
+ * 需在 io_manager_start_refresh() 之前设置。设置失败（如权限不足）时
+ * 刷新线程退回默认属性运行，IOTimingStats::realtime_applied 为 false。
+ */
+typedef struct {
+    int cpu_affinity;           // 绑定的 CPU 编号（-1 = 不绑定）
+    int sched_policy;           // 调度策略（SCHED_OTHER / SCHED_FIFO / SCHED_RR）
+    int sched_priority;         // 调度优先级（SCHED_FIFO/RR 有效）
+    bool lock_memory;           // 启动时 mlockall(MCL_CURRENT | MCL_FUTURE)
+} IORealtimeConfig;
+
+#define IO_TIMING_HIST_BUCKETS 32
+
+/**
+ * @brief 刷新周期时序统计
+ *
+ * 直方图按 2 的幂分桶：第 0 桶为 0 µs，第 i 桶为 [2^(i-1), 2^i) µs。
+ * 由刷新线程无锁更新，通过 io_manager_get_timing_stats() 读取快照。
+ */
+typedef struct {
+    uint64_t latency_hist[IO_TIMING_HIST_BUCKETS];  // 唤醒延迟（实际唤醒 - 截止时刻）
+    uint64_t jitter_hist[IO_TIMING_HIST_BUCKETS];   // 周期抖动（|实际周期 - 名义周期|）
+    uint64_t cycles;            // 已完成周期数
+    uint64_t overruns;          // 超限周期数（刷新耗时超过周期）
+    uint64_t max_latency_us;    // 最大唤醒延迟
+    uint64_t max_jitter_us;     // 最大抖动
+    uint64_t max_exec_us;       // 最大刷新耗时
+    bool realtime_applied;      // 实时属性是否生效
+} IOTimingStats;
+
+// ============================================================================
+// I/O 记录与回放（前向声明，实现见 io_trace.c）
+// ============================================================================
+
+typedef struct IOTraceRecorder IOTraceRecorder;
+typedef struct IOTraceReplay IOTraceReplay;
+
 // ============================================================================
 // I/O 管理器
 // ============================================================================
@@ -141,6 +221,8 @@ typedef struct IOManager {
     
     bool auto_refresh;
     uint32_t refresh_cycle_us;
+    IORealtimeConfig rt_config;
+    IOTimingStats timing;
     pthread_t refresh_thread;
     pthread_mutex_t mgr_mutex;
     
@@ -153,6 +235,28 @@ typedef struct IOManager {
     } stats;
     
     void (*log_callback)(const char* level, const char* message);
+    
+    struct {
+        uint64_t* bitmap;               // 已发布的变化位图（按点索引，受 mgr_mutex 保护）
+        uint32_t bitmap_words;
+        uint32_t published_words;       // 已发布位图的有效字数
+        uint32_t changed_count;         // 已发布刷新变化的点数（受 mgr_mutex 保护）
+        uint64_t* work;                 // 刷新路径私有的工作位图
+        uint32_t work_words;
+        IOChangeEvent* events;          // 刷新路径私有的事件缓冲
+        uint32_t event_capacity;
+        IOChangeSubscription* dispatch; // 刷新路径私有的订阅快照
+        uint32_t dispatch_capacity;
+        IOChangeSubscription* subs;
+        uint32_t sub_count;
+        uint32_t sub_capacity;
+        uint32_t next_sub_id;
+    } cos;
+    
+    IOTraceRecorder* trace_recorder;    // 输入记录器（NULL = 不记录）
+    IOTraceReplay* trace_replay;        // 输入回放源（NULL = 从硬件读取）
+    uint64_t scan_count;                // 输入刷新次数（不随统计重置清零）
+    uint64_t replay_base_cycle;         // 挂接回放时的 scan_count
 } IOManager;
 
 // ============================================================================
@@ -168,6 +272,25 @@ ErrorCode io_manager_add_point(IOManager* mgr, const IOPointConfig* config);
 ErrorCode io_manager_remove_point(IOManager* mgr, const IOAddress* addr);
 IOPoint* io_manager_find_point(IOManager* mgr, const IOAddress* addr);
 
+/**
+ * @brief 预分配 I/O 点数组容量
+ * @param mgr I/O 管理器
+ * @param point_count 预期点数
+ * @return 错误码
+ */
+ErrorCode io_manager_reserve(IOManager* mgr, uint32_t point_count);
+
+/**
+ * @brief 批量添加 I/O 点（一次确定所有表的大小，一次加锁）
+ * @param mgr I/O 管理器
+ * @param configs 点配置数组
+ * @param count 点数
+ * @param added 输出实际添加的点数（重复地址被跳过，可为 NULL）
+ * @return 错误码
+ */
+ErrorCode io_manager_add_points(IOManager* mgr, const IOPointConfig* configs, uint32_t count,
+                                uint32_t* added);
+
 // I/O 读写
 ErrorCode io_manager_read(IOManager* mgr, const IOAddress* addr, Value* value);
 ErrorCode io_manager_write(IOManager* mgr, const IOAddress* addr, const Value* value);
@@ -178,6 +301,22 @@ ErrorCode io_manager_refresh_outputs(IOManager* mgr);
 ErrorCode io_manager_start_refresh(IOManager* mgr, uint32_t cycle_us);
 ErrorCode io_manager_stop_refresh(IOManager* mgr);
 
+/**
+ * @brief 设置刷新线程实时属性（CPU 亲和性、调度策略/优先级、内存锁定）
+ * @param mgr I/O 管理器
+ * @param config 实时配置
+ * @return 错误码（刷新线程运行中返回 ERR_RUNTIME）
+ */
+ErrorCode io_manager_set_realtime(IOManager* mgr, const IORealtimeConfig* config);
+
+/**
+ * @brief 获取刷新周期时序统计快照
+ * @param mgr I/O 管理器
+ * @param stats 输出统计
+ * @return 错误码
+ */
+ErrorCode io_manager_get_timing_stats(IOManager* mgr, IOTimingStats* stats);
+
 // 地址解析
 ErrorCode io_address_parse(const char* addr_str, IOAddress* addr);
 void io_address_format(const IOAddress* addr, char* buffer, size_t size);
@@ -189,6 +328,61 @@ void io_manager_set_log_callback(IOManager* mgr, void (*callback)(const char* le
 uint32_t io_manager_get_point_count(IOManager* mgr);
 IOPoint* io_manager_get_point(IOManager* mgr, uint32_t index);
 
+// 变化检测
+/**
+ * @brief 设置 I/O 点的变化检测死区
+ * @param mgr I/O 管理器
+ * @param addr I/O 地址
+ * @param deadband 死区（绝对值，INT/REAL 有效；0 = 任何变化都上报）
+ * @return 错误码
+ */
+ErrorCode io_manager_set_deadband(IOManager* mgr, const IOAddress* addr, double deadband);
+
+/**
+ * @brief 订阅变化事件
+ * @param mgr I/O 管理器
+ * @param filter 只关注该地址（NULL = 所有输入点）
+ * @param callback 回调函数
+ * @param user_data 用户数据
+ * @param out_id 输出订阅 ID（可为 NULL）
+ * @return 错误码
+ */
+ErrorCode io_manager_subscribe(IOManager* mgr, const IOAddress* filter,
+                               IOChangeCallback callback, void* user_data, uint32_t* out_id);
+
+/**
+ * @brief 取消订阅
+ * @param mgr I/O 管理器
+ * @param id 订阅 ID
+ * @return 错误码（不存在返回 ERR_NOT_FOUND）
+ */
+ErrorCode io_manager_unsubscribe(IOManager* mgr, uint32_t id);
+
+/**
+ * @brief 复制最近一次刷新的变化位图
+ *
+ * 刷新路径在私有位图中计算变化，整次刷新完成后在锁内发布；这里在同一把锁内
+ * 复制，得到的总是某一次完整刷新的结果。
+ *
+ * @param mgr I/O 管理器
+ * @param out 输出缓冲（第 i 位对应 io_manager_get_point(mgr, i)）
+ * @param max_words 输出缓冲的 64 位字数
+ * @param word_count 输出位图的有效字数（可为 NULL；大于 max_words 时只复制前 max_words 个字）
+ * @return 错误码
+ */
+ErrorCode io_manager_copy_change_bitmap(IOManager* mgr, uint64_t* out, uint32_t max_words,
+                                        uint32_t* word_count);
+
+/**
+ * @brief 最近一次刷新中指定点是否变化
+ */
+bool io_manager_point_changed(IOManager* mgr, uint32_t index);
+
+/**
+ * @brief 最近一次刷新变化的点数
+ */
+uint32_t io_manager_get_changed_count(IOManager* mgr);
+
 // 适配器创建
 IOHardwareAdapter* io_adapter_create_simulator(void);
 void io_adapter_free_simulator(IOHardwareAdapter* adapter);
@@ -196,4 +390,110 @@ void io_adapter_free_simulator(IOHardwareAdapter* adapter);
 // 配置文件加载
 ErrorCode io_manager_load_config_simple(IOManager* mgr, const char* config_file);
 
+/**
+ * @brief 编译配置文件为点配置数组
+ * @param config_file 配置文件路径
+ * @param configs 输出点配置数组（用 io_config_free_compiled 释放）
+ * @param count 输出点数
+ * @return 错误码
+ */
+ErrorCode io_config_compile(const char* config_file, IOPointConfig** configs, uint32_t* count);
+
+/**
+ * @brief 释放 io_config_compile 的结果
+ */
+void io_config_free_compiled(IOPointConfig* configs, uint32_t count);
+
+/**
+ * @brief 通过二进制缓存加载配置
+ * @param mgr I/O 管理器
+ * @param config_file 配置文件路径
+ * @param cache_file 缓存文件路径（NULL = <config_file>.cache）
+ * @return 错误码
+ *
+ * 缓存以源文件内容哈希为键：哈希匹配时直接 mmap 缓存批量建点，
+ * 否则重新编译源文件并重写缓存。
+ */
+ErrorCode io_manager_load_config_cached(IOManager* mgr, const char* config_file,
+                                        const char* cache_file);
+
+// ============================================================================
+// I/O 记录与回放
+// ============================================================================
+
+/**
+ * @brief 开始记录输入刷新
+ * @param mgr I/O 管理器
+ * @param trace_file 轨迹文件路径（覆盖写入）
+ * @return 错误码
+ *
+ * 以当前的输入点集合作为记录列，此后每次 io_manager_refresh_inputs()
+ * 在刷新完成后追加一条定长记录：扫描序号 + 时间戳 + 每列的值。
+ */
+ErrorCode io_trace_start_recording(IOManager* mgr, const char* trace_file);
+
+/**
+ * @brief 停止记录并关闭轨迹文件
+ * @param mgr I/O 管理器
+ * @return 错误码
+ */
+ErrorCode io_trace_stop_recording(IOManager* mgr);
+
+/**
+ * @brief 以 mmap 方式打开轨迹文件
+ * @param trace_file 轨迹文件路径
+ * @return 回放实例，失败返回 NULL
+ */
+IOTraceReplay* io_trace_replay_open(const char* trace_file);
+
+/**
+ * @brief 关闭回放并解除映射
+ * @param replay 回放实例
+ */
+void io_trace_replay_close(IOTraceReplay* replay);
+
+/**
+ * @brief 获取轨迹中的扫描记录数
+ */
+uint64_t io_trace_replay_scan_count(const IOTraceReplay* replay);
+
+/**
+ * @brief 获取轨迹中的列数（记录时的输入点数）
+ */
+uint32_t io_trace_replay_column_count(const IOTraceReplay* replay);
+
+/**
+ * @brief 读取指定扫描、指定列的记录值
+ * @param replay 回放实例
+ * @param scan 扫描序号（从 0 开始）
+ * @param column 列序号
+ * @param value 输出值
+ * @param timestamp_us 输出该扫描相对记录起点的时间戳（可为 NULL）
+ * @return 错误码（越界返回 ERR_OUT_OF_BOUNDS）
+ */
+ErrorCode io_trace_replay_get(const IOTraceReplay* replay, uint64_t scan, uint32_t column,
+                              Value* value, uint64_t* timestamp_us);
+
+/**
+ * @brief 将回放源挂接到 I/O 管理器（NULL 表示解除）
+ * @param mgr I/O 管理器
+ * @param replay 回放实例（管理器不拥有所有权）
+ * @return 错误码
+ *
+ * 挂接后 io_manager_refresh_inputs() 不再访问硬件，而是按刷新计数
+ * 逐条取出记录：第 N 次刷新总是得到第 N 条记录，与墙钟时间无关，
+ * 因此回放是确定性的，且可以快于实时运行。
+ */
+ErrorCode io_manager_attach_replay(IOManager* mgr, IOTraceReplay* replay);
+
+/**
+ * @brief 由 io_manager_refresh_inputs() 调用：追加一条记录（内部使用）
+ */
+ErrorCode io_trace_record_scan(IOManager* mgr);
+
+/**
+ * @brief 由 io_manager_refresh_inputs() 调用：用当前扫描的记录填充输入（内部使用）
+ */
+ErrorCode io_trace_replay_scan(IOManager* mgr);
+
 #endif // STVM_IOMGR_H
@@ -0,0 +1,427 @@
+/**
+ * @file ir.h
+ * @brief 中间表示 - 基本块控制流图上的类型化三地址指令与 SSA
+ *
+ * 编译流水线（--ir 或 -O）：
+ *   类型检查后的 AST --ir_build--> IR（每个函数一张 CFG）
+ *                    --ir_to_ssa--> SSA 形式（局部标量变量提升为虚拟寄存器）
+ *                    --[-O] CSE、循环不变量外提（ir_opt.c）
+ *                    --ir_lower---> BytecodeModule（栈式字节码）
+ *
+ * 约定：
+ * 1. 虚拟寄存器（IrReg）在函数内编号，每个寄存器只有一条定义指令
+ * 2. 变量访问在构建时都是 IR_LOAD/IR_STORE；ir_to_ssa 把可提升的变量
+ *    （参数、函数名返回值变量、非静态非外部的标量局部变量）改写为寄存器，
+ *    在支配边界插入 IR_PHI。全局变量、数组、质量化变量、I/O 仍是内存访问。
+ *    短路逻辑运算的结果也经一个临时可提升变量汇合
+ * 3. 每个基本块以一个终结符结束（跳转、条件分支、跳转表、FOR 循环入口/步进、返回、停机）
+ * 4. 主程序体（含全局变量初始化）作为名为 IR_MAIN_NAME 的函数
+ * 5. 能用循环描述符的 FOR 循环（见 codegen_for_loop_descriptor）保留为 FOR_INIT/FOR_STEP
+ *    终结符，循环变量和终值变量不提升，降级为 OP_FOR_INIT/OP_FOR_STEP；能用跳转表的
+ *    CASE 保留为 SWITCH 终结符，降级为 OP_SWITCH
+ */
+
+#ifndef STVM_IR_H
+#define STVM_IR_H
+
+#include "ast.h"
+#include "bytecode.h"
+#include "symtbl.h"
+#include "error.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+#define IR_MAIN_NAME    "$main"     // 主程序体对应的 IR 函数名
+#define IR_NO_REG       (-1)        // 无寄存器（无结果的指令）
+
+// 被删除指令的标记：无目标的 IR_COPY（正常的 COPY 总有目标）
+#define IR_IS_DELETED(ins)  ((ins)->op == IR_COPY && (ins)->dest == IR_NO_REG)
+
+typedef int32_t IrReg;
+
+/**
+ * @brief IR 指令操作
+ */
+typedef enum {
+    IR_CONST,           // dest = 常量
+    IR_PARAM,           // dest = 第 index 个参数的入口值
+    IR_COPY,            // dest = args[0]
+    IR_BINARY,          // dest = args[0] <opcode> args[1]
+    IR_UNARY,           // dest = <opcode> args[0]
+    IR_LOAD,            // dest = var
+    IR_STORE,           // var = args[0]
+    IR_LOAD_INDEXED,    // dest = var[args[0]]（运行时下标）
+    IR_STORE_INDEXED,   // var[args[1]] = args[0]
+    IR_LOAD_MEMBER,     // dest = var.VAL / var.QUALITY（opcode 为 OP_LOAD_VAL/OP_LOAD_QUALITY）
+    IR_STORE_MEMBER,    // var.VAL / var.QUALITY = args[0]
+    IR_IO_READ,         // dest = I/O[io_address]
+    IR_IO_WRITE,        // I/O[io_address] = args[0]
+    IR_CALL,            // dest = callee(args...)，本模块或外部函数由降级时决定
+    IR_PHI              // dest = phi(args[i] 来自 block->preds[i])
+} IrOp;
+
+/**
+ * @brief 基本块终结符
+ */
+typedef enum {
+    IR_TERM_NONE,       // 尚未结束（构建中）
+    IR_TERM_JMP,        // 跳转到 succs[0]
+    IR_TERM_BR,         // value 为真跳 succs[0]，否则 succs[1]
+    IR_TERM_RET,        // 函数返回（value 为返回值，可为 IR_NO_REG）
+    IR_TERM_HALT,       // 主程序结束
+    IR_TERM_SWITCH,     // 按 value 查跳转表 cases，没有匹配时跳 succs[0]
+    IR_TERM_FOR_INIT,   // value 写入循环 loop 的循环变量，进入循环跳 succs[0]（循环体，
+                        // 降级时紧随其后），否则跳 succs[1]（出口）
+    IR_TERM_FOR_STEP    // 循环 loop 的循环变量加步长，仍在范围内跳 succs[0]（循环体），
+                        // 否则 succs[1]（出口）
+} IrTermKind;
+
+/**
+ * @brief 变量引用（内存访问的目标）
+ */
+typedef struct {
+    const char* name;   // 变量名（指向 AST/符号表中的字符串）
+    bool is_global;     // 全局区（含函数内静态变量）还是栈帧
+    uint16_t address;   // 全局索引或帧内偏移
+    DataType type;      // 变量类型
+    int32_t promoted;   // 可提升变量编号（IrFunction::vars 下标），不可提升为 -1
+    uint16_t length;    // 运行时下标访问的数组声明长度（0 表示未知）
+    int32_t lower;      // 运行时下标访问的数组下标下界
+} IrVarRef;
+
+/**
+ * @brief IR 指令
+ */
+typedef struct {
+    IrOp op;
+    Opcode opcode;      // IR_BINARY/IR_UNARY/IR_LOAD_MEMBER/IR_STORE_MEMBER：对应的字节码操作
+    DataType type;      // 结果类型（无结果为 TYPE_VOID）
+    IrReg dest;         // 结果寄存器，无结果为 IR_NO_REG
+    IrReg* args;        // 操作数寄存器
+    uint32_t arg_count;
+    IrVarRef var;       // 内存访问的变量
+    Value constant;     // IR_CONST 的值（字符串指向 AST，不复制）
+    int32_t index;      // IR_PARAM：参数序号
+    const char* callee; // IR_CALL：被调函数名（库函数为完全限定名）
+    const char* io_address;     // IR_IO_READ/IR_IO_WRITE：I/O 地址
+    int32_t callee_params;      // IR_CALL：被调函数参数个数（外部函数登记函数表用）
+    int line;           // 源码行号（0 表示未知）
+} IrInstr;
+
+/**
+ * @brief 基本块
+ */
+typedef struct IrBlock {
+    uint32_t id;
+    IrInstr* instrs;
+    uint32_t instr_count;
+    uint32_t instr_capacity;
+
+    IrTermKind term;
+    IrReg term_value;           // BR 的条件 / RET 的返回值 / SWITCH 的选择值 / FOR_INIT 的初值
+    uint32_t* succs;            // 后继块（SWITCH 为默认目标和各不相同的分支目标，其余指向 succ_buf）
+    uint32_t succ_count;
+    uint32_t succ_buf[2];
+    int term_line;
+    uint32_t loop;              // FOR_INIT/FOR_STEP：循环描述符下标（IrFunction::loops）
+    SwitchCase* cases;          // SWITCH：按下界排序的区间，target 为块编号
+    uint32_t case_count;
+    SwitchKind switch_kind;
+
+    uint32_t* preds;            // 前驱块编号（PHI 的操作数与之一一对应）
+    uint32_t pred_count;
+
+    int32_t idom;               // 直接支配者（入口块和不可达块为 -1）
+    int32_t rpo;                // 逆后序编号（不可达块为 -1）
+} IrBlock;
+
+/**
+ * @brief 可提升为 SSA 寄存器的变量
+ */
+typedef struct {
+    const char* name;
+    DataType type;
+    uint16_t offset;            // 帧内偏移
+    int32_t param_index;        // 参数序号，非参数为 -1
+    bool is_return;             // 函数名返回值变量
+} IrVar;
+
+/**
+ * @brief FOR 循环描述符（FOR_INIT/FOR_STEP 终结符共用）
+ */
+typedef struct {
+    ForLoop desc;               // 描述符（body/exit 在降级时填写）
+    IrVarRef var;               // 循环变量（不提升）
+    IrVarRef end_var;           // 终值变量（desc.flags 含 FOR_LOOP_END_VAR 时，不提升）
+} IrLoop;
+
+/**
+ * @brief IR 函数（一张控制流图）
+ */
+typedef struct {
+    char* name;
+    bool is_main;               // 主程序体
+    int32_t param_count;
+    int32_t frame_size;         // 符号表分配的帧大小（参数 + 返回值变量 + 局部变量）
+    DataType return_type;
+    int32_t return_offset;      // 返回值变量的帧内偏移，无返回值为 -1
+    DataType* param_types;      // 参数类型（param_count 个）
+
+    IrBlock** blocks;           // blocks[0] 为入口块
+    uint32_t block_count;
+    uint32_t block_capacity;
+
+    DataType* reg_types;        // 寄存器类型
+    uint32_t reg_count;
+    uint32_t reg_capacity;
+
+    IrVar* vars;                // 可提升变量
+    uint32_t var_count;
+    uint32_t var_capacity;
+
+    IrLoop* loops;              // FOR 循环描述符
+    uint32_t loop_count;
+
+    bool in_ssa;                // 已完成 SSA 构造
+} IrFunction;
+
+/**
+ * @brief IR 模块
+ */
+typedef struct {
+    IrFunction** functions;     // 按源码顺序，主程序体在最后
+    uint32_t function_count;
+    uint32_t function_capacity;
+} IrModule;
+
+// ============================================================================
+// 构造与释放
+// ============================================================================
+
+/**
+ * @brief 创建空模块
+ * @return 模块，失败返回 NULL
+ */
+IrModule* ir_module_create(void);
+
+/**
+ * @brief 释放模块及其所有函数
+ * @param module 模块
+ */
+void ir_module_free(IrModule* module);
+
+/**
+ * @brief 向模块添加函数
+ * @param module 模块
+ * @param name 函数名
+ * @return 新函数（已含入口块），失败返回 NULL
+ */
+IrFunction* ir_function_add(IrModule* module, const char* name);
+
+/**
+ * @brief 按名称查找函数
+ */
+IrFunction* ir_module_find_function(const IrModule* module, const char* name);
+
+/**
+ * @brief 新建基本块
+ * @return 新块，失败返回 NULL
+ */
+IrBlock* ir_block_create(IrFunction* func);
+
+/**
+ * @brief 分配虚拟寄存器
+ * @return 寄存器编号，失败返回 IR_NO_REG
+ */
+IrReg ir_new_reg(IrFunction* func, DataType type);
+
+/**
+ * @brief 在块末尾追加指令（args 被复制）
+ * @return 指向新指令的指针（块扩容后失效），失败返回 NULL
+ */
+IrInstr* ir_append(IrFunction* func, IrBlock* block, IrOp op, DataType type,
+                   const IrReg* args, uint32_t arg_count, int line);
+
+/**
+ * @brief 结束基本块
+ * @param kind 终结符类型
+ * @param value 条件或返回值寄存器（不需要时为 IR_NO_REG）
+ * @param succ0 第一个后继（JMP 目标或 BR 真分支）
+ * @param succ1 第二个后继（BR 假分支）
+ */
+void ir_terminate(IrBlock* block, IrTermKind kind, IrReg value,
+                  uint32_t succ0, uint32_t succ1, int line);
+
+/**
+ * @brief 以跳转表结束基本块（SWITCH）
+ * @param selector 选择值寄存器
+ * @param kind 跳转表形式
+ * @param cases 按下界排序、互不重叠的区间（target 为块编号，被复制）
+ * @param case_count 区间数
+ * @param default_block 没有匹配时的目标
+ * @return 错误码
+ */
+ErrorCode ir_terminate_switch(IrBlock* block, IrReg selector, SwitchKind kind,
+                              const SwitchCase* cases, uint32_t case_count,
+                              uint32_t default_block, int line);
+
+/**
+ * @brief 登记 FOR 循环描述符
+ * @return 描述符下标，失败返回 -1
+ */
+int32_t ir_add_loop(IrFunction* func, const IrLoop* loop);
+
+/**
+ * @brief 登记可提升变量
+ * @return 变量编号，失败返回 -1
+ */
+int32_t ir_add_var(IrFunction* func, const char* name, DataType type,
+                   uint16_t offset, int32_t param_index, bool is_return);
+
+// ============================================================================
+// 分析与变换
+// ============================================================================
+
+/**
+ * @brief 由终结符重建前驱表、逆后序和支配树
+ * @param func 函数
+ * @return 错误码
+ */
+ErrorCode ir_compute_cfg(IrFunction* func);
+
+/**
+ * @brief 块 a 是否支配块 b（需先调用 ir_compute_cfg）
+ */
+bool ir_dominates(const IrFunction* func, uint32_t a, uint32_t b);
+
+/**
+ * @brief 指令是否写变量内存（IR_STORE、IR_STORE_INDEXED、IR_STORE_MEMBER）
+ */
+bool ir_is_store(const IrInstr* ins);
+
+/**
+ * @brief 两条内存访问指令是否可能涉及同一位置
+ *
+ * 同一存储区（全局区或帧）内按地址范围判断，声明长度未知的运行时下标访问视为覆盖整个存储区。
+ */
+bool ir_may_alias(const IrInstr* a, const IrInstr* b);
+
+/**
+ * @brief 构造 SSA：提升变量、插入 PHI（剪除无用和平凡 PHI）
+ * @param func 函数
+ * @return 错误码
+ */
+ErrorCode ir_to_ssa(IrFunction* func);
+
+/**
+ * @brief 统计寄存器的使用次数（含 PHI 和终结符中的使用）
+ * @param func 函数
+ * @param counts 输出数组，长度至少 reg_count
+ */
+void ir_count_uses(const IrFunction* func, uint32_t* counts);
+
+/**
+ * @brief 移除所有被标记删除的指令（IR_IS_DELETED）
+ * @param func 函数
+ */
+void ir_compact(IrFunction* func);
+
+/**
+ * @brief 按替换表改写所有操作数（含终结符的值，替换链会被追到底）
+ * @param func 函数
+ * @param repl 替换表，长度至少 reg_count，-1 表示不替换
+ */
+void ir_replace_regs(IrFunction* func, const IrReg* repl);
+
+// ============================================================================
+// 优化（-O，见 ir_opt.c）
+// ============================================================================
+
+/**
+ * @brief 判断被调函数是否为纯函数（结果只取决于实参：不读写全局变量、不做 I/O）
+ * @param callee 被调函数名（库函数为完全限定名）
+ * @param data 调用者数据
+ */
+typedef bool (*IrPureCallFn)(const char* callee, void* data);
+
+/**
+ * @brief 公共子表达式消除
+ *
+ * 按逆后序遍历，重复的常量、参数读取、一元/二元运算和纯函数调用改用支配它的
+ * 等价指令的结果。内存读取（变量、数组元素、成员）只在同一块内消除：中间可能
+ * 写同一位置的存储使记录失效，有副作用的调用和 I/O 使全局变量的记录失效。
+ *
+ * @param func SSA 形式的函数
+ * @param pure_call 纯函数判断
+ * @param data 传给 pure_call
+ * @param changes 输出：消除的运算、调用和内存读取数（不含常量与参数读取）
+ * @return 错误码
+ */
+ErrorCode ir_eliminate_common_subexprs(IrFunction* func, IrPureCallFn pure_call, void* data,
+                                       uint32_t* changes);
+
+/**
+ * @brief 循环不变量外提
+ *
+ * 只处理有前置块（循环外唯一前驱且只跳到循环头，或 FOR_INIT 块）的自然循环，
+ * 由内向外。不会报错的运算和循环中没有写入的帧内变量读取外提到前置块末尾
+ * （全局变量可能被强制或 I/O 改写，不外提）。可能报错的运算（溢出、除零、移位量）
+ * 和纯函数调用只从支配所有出口的块外提，且之前没有未外提的副作用或可能报错的
+ * 指令；循环可能一次也不执行时（FOR 终值为变量）先在前置块前插入进入判断，
+ * 错误的报告时机不变。
+ *
+ * @param func SSA 形式的函数
+ * @param pure_call 纯函数判断
+ * @param data 传给 pure_call
+ * @param changes 输出：外提的运算和调用数（不含常量与参数读取）
+ * @return 错误码
+ */
+ErrorCode ir_hoist_loop_invariants(IrFunction* func, IrPureCallFn pure_call, void* data,
+                                   uint32_t* changes);
+
+// ============================================================================
+// 前端与后端
+// ============================================================================
+
+/**
+ * @brief 由类型检查后的程序构建 IR
+ * @param program 程序节点
+ * @param symtbl 符号表（与代码生成共用，构建过程中进出函数作用域）
+ * @param error_msg 错误消息缓冲区
+ * @param error_size 缓冲区大小
+ * @param out 输出模块
+ * @return 错误码
+ */
+ErrorCode ir_build(ASTNode* program, SymbolTable* symtbl,
+                   char* error_msg, size_t error_size, IrModule** out);
+
+/**
+ * @brief 把 IR 模块降级为栈式字节码
+ *
+ * 调用前字节码模块的全局变量表应已填好（见 codegen_init_globals）。
+ *
+ * @param ir IR 模块（函数须已处于 SSA 形式或不含 PHI）
+ * @param module 目标字节码模块
+ * @param symtbl 符号表（查找外部函数）
+ * @param error_msg 错误消息缓冲区
+ * @param error_size 缓冲区大小
+ * @return 错误码
+ */
+ErrorCode ir_lower(IrModule* ir, BytecodeModule* module, SymbolTable* symtbl,
+                   char* error_msg, size_t error_size);
+
+// ============================================================================
+// 调试输出
+// ============================================================================
+
+/**
+ * @brief 打印 IR 函数
+ */
+void ir_print_function(const IrFunction* func);
+
+/**
+ * @brief 打印 IR 模块（--dump-ir）
+ */
+void ir_print_module(const IrModule* module);
+
+#endif // STVM_IR_H
@@ -7,6 +7,13 @@
  * 2. 符号解析和导入
  * 3. 库依赖管理
  * 4. 符号冲突检测
+ * 5. 进程级库缓存：同一库文件（按规范路径和校验和区分）只加载一次，
+ *    其字节码模块与符号表在所有库管理器、所有 VM 之间共享（只读），
+ *    按引用计数在最后一个使用者卸载时释放
+ * 6. 带导出符号索引的库（bytecode_save_library）加载时不构建符号表，
+ *    符号在首次导入/解析时按索引 O(1) 查到后再登记
+ * 7. 延迟加载：依赖可只登记不映射，首次调用其中的函数时才加载；
+ *    库函数调用的解析结果按调用名缓存
  */
 
 #ifndef STVM_LIBMGR_H
@@ -17,14 +24,37 @@
 #include "error.h"
 #include <stdbool.h>
 
+/**
+ * @brief 库缓存条目（进程内共享）
+ */
+typedef struct CachedLibrary {
+    char* path;                     // 规范化的库文件路径
+    uint32_t digest;                // 文件内容摘要（文件头与段表的 CRC32）
+    BytecodeModule* module;         // 共享的字节码模块（只读）
+    SymbolTable* symbols;           // 共享的导出符号表（有索引时按需登记，受缓存锁保护）
+    uint32_t ref_count;             // 引用计数
+    struct CachedLibrary* next;     // 链表指针
+} CachedLibrary;
+
+/**
+ * @brief 库缓存统计
+ */
+typedef struct LibraryCacheStats {
+    uint32_t entries;               // 缓存中的库数量
+    uint32_t references;            // 引用总数
+    uint64_t hits;                  // 命中次数
+    uint64_t misses;                // 未命中（实际加载）次数
+} LibraryCacheStats;
+
 /**
  * @brief 已加载库信息
  */
 typedef struct LoadedLibrary {
     char* name;                     // 库名称
     char* path;                     // 库文件路径
-    BytecodeModule* module;         // 字节码模块
-    SymbolTable* symbols;           // 库导出的符号表
+    BytecodeModule* module;         // 字节码模块（来自缓存，只读）
+    SymbolTable* symbols;           // 库导出的符号表（来自缓存，经 libmgr 查找）
+    CachedLibrary* cache_entry;     // 持有引用的缓存条目
     struct LoadedLibrary* next;     // 链表指针
 } LoadedLibrary;
 
@@ -37,14 +67,47 @@ typedef struct ImportedSymbol {
     LoadedLibrary* library;         // 所属库
     Symbol* symbol;                 // 符号定义
     struct ImportedSymbol* next;    // 链表指针
+    struct ImportedSymbol* hash_next; // 哈希桶链表指针
 } ImportedSymbol;
 
+/**
+ * @brief 导入符号哈希桶数（2 的幂）
+ */
+#define LIBMGR_IMPORT_BUCKETS 256
+
+/**
+ * @brief 延迟加载的库依赖（登记时不映射文件）
+ */
+typedef struct PendingLibrary {
+    char* name;                     // 库名称
+    char* filename;                 // 登记的库文件名
+    struct PendingLibrary* next;    // 链表指针
+} PendingLibrary;
+
+/**
+ * @brief 已解析的库函数调用
+ */
+typedef struct ResolvedCall {
+    char* name;                     // 调用名（<库文件路径>.stbc.<函数名>）
+    LoadedLibrary* library;         // 所属库
+    FunctionEntry* function;        // 库中的函数条目
+    struct ResolvedCall* next;      // 哈希桶链表指针
+} ResolvedCall;
+
+/**
+ * @brief 库函数调用缓存哈希桶数（2 的幂）
+ */
+#define LIBMGR_CALL_BUCKETS 256
+
 /**
  * @brief 库管理器结构
  */
 typedef struct LibraryManager {
     LoadedLibrary* libraries;       // 已加载库列表
     ImportedSymbol* imports;        // 已导入符号列表
+    ImportedSymbol* import_buckets[LIBMGR_IMPORT_BUCKETS]; // 按名称索引的导入符号
+    PendingLibrary* pending;        // 尚未加载的延迟依赖
+    ResolvedCall* call_cache[LIBMGR_CALL_BUCKETS]; // 库函数调用解析缓存
     SymbolTable* global_symtbl;     // 全局符号表
     char search_paths[256][512];    // 库搜索路径
     int search_path_count;          // 搜索路径数量
@@ -127,6 +190,8 @@ Symbol* libmgr_resolve_symbol(LibraryManager* mgr, const char* qualified_name);
  * @param mgr 库管理器实例
  * @param name 库名称
  * @return 错误码
+ * 
+ * 释放本管理器对缓存条目的引用；引用归零时从缓存中移除并释放模块。
  */
 ErrorCode libmgr_unload_library(LibraryManager* mgr, const char* name);
 
@@ -173,4 +238,39 @@ BytecodeModule* libmgr_get_library_module(LibraryManager* mgr, const char* name)
  */
 const char* libmgr_get_library_path(LibraryManager* mgr, const char* name);
 
+/**
+ * @brief 登记延迟加载的库依赖（不打开文件，首次调用其中函数时才加载）
+ * @param mgr 库管理器实例
+ * @param filename 库文件名（与 libmgr_load_library 相同）
+ * @return 错误码（库已加载或已登记时直接返回OK）
+ */
+ErrorCode libmgr_defer_library(LibraryManager* mgr, const char* filename);
+
+/**
+ * @brief 获取尚未加载的延迟依赖个数
+ * @param mgr 库管理器实例
+ * @return 延迟依赖个数
+ */
+uint32_t libmgr_get_pending_count(LibraryManager* mgr);
+
+/**
+ * @brief 解析库函数调用
+ * 
+ * 调用名格式为 <库文件路径>.stbc.<函数名>，库按路径后缀匹配。
+ * 匹配的库尚未加载而有对应的延迟依赖时在此加载。成功的解析结果
+ * 按调用名缓存，库被卸载时对应缓存失效。
+ * 
+ * @param mgr 库管理器实例
+ * @param call_name 调用名
+ * @param lib_out 输出函数所属的库
+ * @return 函数条目，不是库函数或未找到返回NULL
+ */
+FunctionEntry* libmgr_resolve_call(LibraryManager* mgr, const char* call_name, LoadedLibrary** lib_out);
+
+/**
+ * @brief 获取进程级库缓存的统计信息
+ * @param stats 输出统计
+ */
+void libmgr_cache_get_stats(LibraryCacheStats* stats);
+
 #endif // STVM_LIBMGR_H
@@ -0,0 +1,156 @@
+/**
+ * @file optimizer.h
+ * @brief 优化器 - 类型检查与代码生成之间的优化流水线（-O）
+ *
+ * 优化遍分三类：
+ * 1. AST 遍：在类型检查之后、代码生成之前改写语法树，按轮次反复执行
+ *    直到不再产生改动（或达到轮次上限）
+ * 2. IR 遍：-O 时代码经中间表示生成，在 SSA 构造之后、降级之前做公共子表达式
+ *    消除和循环不变量外提；函数调用按副作用分析（optimizer_call_effects）区分纯函数
+ * 3. 字节码遍：在代码生成（和静态链接）之后内联小函数、对指令序列做窥孔优化
+ *
+ * 每个遍记录执行次数、改动数和耗时，--stats 时打印。
+ *
+ * 被删除的语法树节点挂到优化器的回收链表，在 optimizer_free 时释放：
+ * 类型检查设置的 resolved_type 有的与符号表共享，不能早于符号表释放。
+ */
+
+#ifndef STVM_OPTIMIZER_H
+#define STVM_OPTIMIZER_H
+
+#include "ast.h"
+#include "bytecode.h"
+#include "ir.h"
+#include "error.h"
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief 优化遍编号（与优化器内部的遍表一一对应，按执行顺序排列）
+ */
+typedef enum {
+    OPT_PASS_CONST_GLOBALS,     // 常量全局变量（VAR CONSTANT）传播
+    OPT_PASS_CONST_FOLD,        // 常量折叠
+    OPT_PASS_ALGEBRAIC,         // 代数化简与强度削弱
+    OPT_PASS_COPY_PROP,         // 函数局部变量的常量/复写传播
+    OPT_PASS_DEAD_STORE,        // 死存储消除
+    OPT_PASS_DEAD_CODE,         // 死代码消除
+    OPT_PASS_CSE,               // 公共子表达式消除（IR）
+    OPT_PASS_LICM,              // 循环不变量外提（IR）
+    OPT_PASS_INLINE,            // 小叶子函数内联（字节码）
+    OPT_PASS_PEEPHOLE,          // 字节码窥孔优化
+    OPT_PASS_COUNT
+} OptPassId;
+
+/**
+ * @brief 优化遍的作用对象
+ */
+typedef enum {
+    OPT_UNIT_AST,               // 语法树
+    OPT_UNIT_IR,                // SSA 形式的中间表示
+    OPT_UNIT_BYTECODE           // 字节码模块
+} OptUnit;
+
+/**
+ * @brief 单个优化遍的统计
+ */
+typedef struct {
+    const char* name;           // 遍名称
+    OptUnit unit;               // 作用对象
+    bool enabled;               // 是否启用
+    uint32_t runs;              // 执行次数
+    uint32_t changes;           // 改动数（折叠的表达式、删除的语句/指令等）
+    double time_ms;             // 累计耗时（毫秒）
+} OptPassStats;
+
+/**
+ * @brief 函数调用的副作用（按位组合，OPT_EFFECT_NONE 为纯函数：结果只取决于实参）
+ */
+typedef enum {
+    OPT_EFFECT_NONE          = 0,
+    OPT_EFFECT_READ_GLOBALS  = 0x01,    // 读全局变量（可能被强制、调试器或热更新改写）
+    OPT_EFFECT_WRITE_GLOBALS = 0x02,    // 写全局变量
+    OPT_EFFECT_IO            = 0x04,    // 读写硬件 I/O
+    OPT_EFFECT_UNKNOWN       = 0x08     // 无法分析（未知外部函数、系统调用、输出、停机）
+} OptEffect;
+
+struct LibraryManager;
+
+/**
+ * @brief 优化器
+ */
+typedef struct Optimizer {
+    OptPassStats passes[OPT_PASS_COUNT];
+    uint32_t max_rounds;        // AST 遍的最大轮次
+    uint32_t rounds;            // 实际执行的 AST 轮次
+    uint32_t instructions_before;   // 字节码优化前的指令数
+    uint32_t instructions_after;    // 字节码优化后的指令数
+    ASTNode* graveyard;         // 被删除节点的回收链表
+    struct LibraryManager* libmgr;  // 分析库函数调用的副作用（可为 NULL，库函数按未知处理）
+    ErrorCode error_code;       // 遍内部错误（如内存不足）
+} Optimizer;
+
+/**
+ * @brief 创建优化器（所有遍默认启用）
+ * @return 优化器，失败返回 NULL
+ */
+Optimizer* optimizer_create(void);
+
+/**
+ * @brief 释放优化器及回收链表中的语法树节点
+ * @param opt 优化器
+ */
+void optimizer_free(Optimizer* opt);
+
+/**
+ * @brief 按名称启用或禁用优化遍
+ * @param opt 优化器
+ * @param name 遍名称（如 "const-fold"）
+ * @param enabled 是否启用
+ * @return 找到该遍返回 true
+ */
+bool optimizer_set_pass_enabled(Optimizer* opt, const char* name, bool enabled);
+
+/**
+ * @brief 对类型检查后的程序执行 AST 优化遍
+ * @param opt 优化器
+ * @param program 程序节点
+ * @return 错误码
+ */
+ErrorCode optimizer_run_ast(Optimizer* opt, ASTNode* program);
+
+/**
+ * @brief 对 SSA 形式的 IR 模块执行 IR 优化遍（降级之前）
+ * @param opt 优化器
+ * @param ir IR 模块
+ * @return 错误码
+ */
+ErrorCode optimizer_run_ir(Optimizer* opt, IrModule* ir);
+
+/**
+ * @brief 分析外部函数调用（CALL_EXT 目标）的副作用
+ *
+ * 内置函数查表；库函数（"<库文件>.stbc.<函数名>"）经库管理器找到字节码后，
+ * 沿控制流扫描全局变量访问、I/O、停机和嵌套调用。
+ *
+ * @param opt 优化器
+ * @param name 外部函数名
+ * @return OptEffect 位组合
+ */
+uint32_t optimizer_call_effects(const Optimizer* opt, const char* name);
+
+/**
+ * @brief 对代码生成后的模块执行字节码优化遍
+ * @param opt 优化器
+ * @param module 字节码模块
+ * @return 错误码
+ */
+ErrorCode optimizer_run_bytecode(Optimizer* opt, BytecodeModule* module);
+
+/**
+ * @brief 打印各优化遍的统计信息
+ * @param opt 优化器
+ */
+void optimizer_print_stats(const Optimizer* opt);
+
+#endif // STVM_OPTIMIZER_H
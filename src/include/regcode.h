@@ -0,0 +1,212 @@
+/**
+ * @file regcode.h
+ * @brief 寄存器格式字节码 - 帧内虚拟寄存器上的三地址指令
+ *
+ * 与栈式字节码并存的第二种执行格式（--regvm 编译时生成，.stbc 中带
+ * STBC_FLAG_REGISTER_CODE 标志的模块由虚拟机按此格式执行）：
+ *   栈式字节码（优化、静态链接之后）--regcode_generate--> RegCode
+ *
+ * 约定：
+ * 1. 每个函数一个寄存器帧，仍位于 vm->stack 上、从调用帧的 base_pointer 开始：
+ *    寄存器 0..local_count-1 是局部变量（与栈式帧布局相同，参数在前），
+ *    其后是临时寄存器，第 d 个临时寄存器对应栈式代码中深度为 d 的操作数栈槽位。
+ *    主程序没有局部变量，帧从栈底开始
+ * 2. 源操作数可以是寄存器、常量池下标或全局变量下标（由 flags 中的两位种类
+ *    区分），目标可以是寄存器或全局变量；全局变量仍经过强制值检查
+ * 3. 调用时实参已在连续的临时寄存器中，被调函数的帧从第一个实参开始，
+ *    返回值写回该寄存器（与栈式调用约定的栈布局相同）
+ * 4. 跳转目标是寄存器代码地址；跳转表和 FOR 循环描述符仍记录栈式地址，
+ *    执行时经 address_map 换算
+ * 5. 每条寄存器指令记录来源栈式指令地址（origin），错误信息和行号按栈式地址报告
+ */
+
+#ifndef STVM_REGCODE_H
+#define STVM_REGCODE_H
+
+#include "bytecode.h"
+#include "types.h"
+#include "error.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief 寄存器指令操作码（A 为目标，B/C 为源操作数）
+ */
+typedef enum {
+    ROP_MOVE = 0,       // A = B
+
+    // 算术（语义与同名栈式指令相同，含溢出和除零陷阱）
+    ROP_ADD,            // A = B + C
+    ROP_SUB,            // A = B - C
+    ROP_MUL,            // A = B * C
+    ROP_DIV,            // A = B / C
+    ROP_MOD,            // A = B MOD C
+    ROP_NEG,            // A = -B
+
+    // 比较
+    ROP_EQ,             // A = B = C
+    ROP_NE,             // A = B <> C
+    ROP_LT,             // A = B < C
+    ROP_LE,             // A = B <= C
+    ROP_GT,             // A = B > C
+    ROP_GE,             // A = B >= C
+
+    // 逻辑与位运算
+    ROP_AND,            // A = B AND C
+    ROP_OR,             // A = B OR C
+    ROP_XOR,            // A = B XOR C
+    ROP_NOT,            // A = NOT B
+    ROP_BIT_AND,        // A = B & C
+    ROP_BIT_OR,         // A = B | C
+    ROP_BIT_XOR,        // A = B ^ C
+    ROP_BIT_NOT,        // A = ~B
+    ROP_SHL,            // A = B << C
+    ROP_SHR,            // A = B >> C
+
+    // 控制流（a 为目标地址）
+    ROP_JMP,            // goto a
+    ROP_JZ,             // B 为假时 goto a
+    ROP_JNZ,            // B 为真时 goto a
+    ROP_JCMPZ,          // 比较 B <cmp> C 不成立时 goto a（cmp 见 REG_CMP_*）
+    ROP_JCMPNZ,         // 比较 B <cmp> C 成立时 goto a
+    ROP_SWITCH,         // 按跳转表 a 以 B 为选择值分支
+    ROP_FOR_INIT,       // 循环描述符 a：循环变量 = B，不进入循环时跳到出口
+    ROP_FOR_STEP,       // 循环描述符 a：步进，仍在范围内时跳回循环体
+    ROP_CALL,           // 调用函数 b，实参从寄存器 a 开始，返回值写入寄存器 a
+    ROP_CALL_EXT,       // 调用外部函数 b（c 个实参），实参从寄存器 a 开始，返回值写入寄存器 a
+    ROP_RET,            // 返回（返回值在寄存器 param_count；主程序返回时同 ROP_HALT）
+    ROP_HALT,           // 停机，a 为仍有效的寄存器数（栈顶留给 vm_get_result）
+
+    // 数组、质量位、I/O（b 为变量下标或基址，全局由 REG_FLAG_VAR_GLOBAL 决定）
+    ROP_LOAD_INDEXED,   // A = var[b + C]
+    ROP_STORE_INDEXED,  // var[a + C] = B
+    ROP_LOAD_VAL,       // A = var[b].VAL
+    ROP_LOAD_QUALITY,   // A = var[b].QUALITY
+    ROP_STORE_VAL,      // var[a].VAL = B
+    ROP_STORE_QUALITY,  // var[a].QUALITY = B
+    ROP_IO_READ,        // A = I/O[常量 b]
+    ROP_IO_WRITE,       // I/O[常量 a] = B
+
+    // 按数组描述符寻址（b/a 为描述符下标，REG_FLAG_UNCHECKED 时不检查边界）
+    ROP_LOAD_ARRAY,     // A = array[b][C]
+    ROP_STORE_ARRAY,    // array[a][C] = B
+
+    ROP_COUNT
+} RegOpcode;
+
+/**
+ * @brief 源操作数种类（flags 中 B 占位 0-1，C 占位 2-3）
+ */
+#define REG_KIND_REG     0  // 帧内寄存器
+#define REG_KIND_CONST   1  // 常量池下标
+#define REG_KIND_GLOBAL  2  // 全局变量下标
+
+#define REG_KIND_B(flags)   ((flags) & 0x03)
+#define REG_KIND_C(flags)   (((flags) >> 2) & 0x03)
+#define REG_FLAGS(kb, kc)   ((uint8_t)((kb) | ((kc) << 2)))
+
+/**
+ * @brief 其他标志位
+ */
+#define REG_FLAG_DEST_GLOBAL  0x10  // 目标 A 是全局变量
+#define REG_FLAG_VAR_GLOBAL   0x20  // 数组/质量位指令访问的变量在全局区
+#define REG_FLAG_UNCHECKED    0x40  // 数组访问的下标已证明在声明范围内（来自 FLAG_UNCHECKED）
+
+/**
+ * @brief 条件跳转的比较种类（ROP_JCMPZ/ROP_JCMPNZ 的 flags 高 3 位，按 OP_EQ 起的偏移）
+ */
+#define REG_CMP_SHIFT       5
+#define REG_CMP(flags)      ((Opcode)(OP_EQ + ((flags) >> REG_CMP_SHIFT)))
+
+/**
+ * @brief 寄存器指令（固定 8 字节）
+ */
+typedef struct {
+    uint8_t opcode;     // RegOpcode
+    uint8_t flags;      // 操作数种类与标志
+    uint16_t a;         // 目标寄存器/全局变量、跳转目标或表下标
+    uint16_t b;         // 源操作数 B
+    uint16_t c;         // 源操作数 C
+} RegInstruction;
+
+/**
+ * @brief 函数的寄存器代码入口
+ */
+typedef struct {
+    uint32_t address;       // 入口地址（外部函数为 REG_NO_ADDRESS）
+    uint32_t frame_size;    // 帧大小：局部变量 + 临时寄存器
+} RegFunction;
+
+#define REG_NO_ADDRESS  0xFFFFFFFFu
+
+/**
+ * @brief 模块的寄存器格式代码
+ */
+typedef struct RegCode {
+    RegInstruction* code;       // 指令数组
+    uint32_t count;             // 指令数
+    uint32_t* origin;           // 每条指令的来源栈式指令地址
+    RegFunction* functions;     // 与模块函数表一一对应
+    uint32_t function_count;
+    uint32_t main_entry;        // 主程序入口（模块 entry_point 对应的地址）
+    uint32_t main_frame_size;   // 主程序帧大小（只有临时寄存器）
+    uint32_t* address_map;      // 栈式地址 → 寄存器地址（仅块首有效，其余为 REG_NO_ADDRESS）
+    uint32_t map_count;         // 等于模块 instruction_count
+    Value* constants;           // 常量池的 Value 形式（执行时直接引用，不序列化）
+} RegCode;
+
+/**
+ * @brief 由模块的栈式字节码生成寄存器格式代码并挂到 module->reg_code
+ *
+ * 须在所有字节码变换（优化、静态链接）之后调用；之后再修改指令会丢弃寄存器代码。
+ * 不能翻译的模块（主程序使用局部变量、汇合处栈深度不一致、多个函数共用代码、
+ * 寄存器地址超过 16 位等）保持栈式格式。
+ *
+ * @param module 字节码模块
+ * @param error_msg 不能翻译时的原因（可为 NULL）
+ * @param size 缓冲区大小
+ * @return 成功返回 OK；不能翻译返回 ERR_INVALID_BYTECODE（模块不变）
+ */
+ErrorCode regcode_generate(BytecodeModule* module, char* error_msg, size_t size);
+
+/**
+ * @brief 校验寄存器代码并挂到模块上（加载 .stbc 时使用，成功后所有权转移给模块）
+ *
+ * 检查每个函数的代码连续且末条指令不会顺序执行到下一个函数，寄存器、常量、函数、
+ * 跳转表、循环描述符和数组描述符下标都在范围内，跳转目标不出本函数（全局变量下标在
+ * 执行时检查），并建立常量的 Value 形式。带 REG_FLAG_UNCHECKED 的数组访问只有在整段代码
+ * 与按（已校验的）栈式代码重新生成的结果一致时才保留免检，否则改为检查边界。
+ *
+ * @param module 字节码模块
+ * @param rc 寄存器代码
+ * @return 成功返回 OK，失败返回错误码（rc 仍归调用者）
+ */
+ErrorCode regcode_attach(BytecodeModule* module, RegCode* rc);
+
+/**
+ * @brief 丢弃模块的寄存器代码（修改栈式指令前调用）
+ * @param module 字节码模块
+ */
+void regcode_discard(BytecodeModule* module);
+
+/**
+ * @brief 释放寄存器代码
+ * @param rc 寄存器代码
+ */
+void regcode_free(RegCode* rc);
+
+/**
+ * @brief 获取寄存器操作码名称
+ * @param opcode 操作码
+ * @return 名称字符串
+ */
+const char* regcode_opcode_name(uint8_t opcode);
+
+/**
+ * @brief 打印模块的寄存器代码（调试用）
+ * @param module 字节码模块
+ */
+void regcode_print(const BytecodeModule* module);
+
+#endif // STVM_REGCODE_H
@@ -80,6 +80,7 @@ typedef struct TypeInfo {
         struct TypeInfo* elem_type; // 元素类型（递归定义，支持多维数组）
         int32_t dimensions;         // 维度数
         int32_t* sizes;             // 每个维度的大小（动态数组时为NULL）
+        int32_t lower;              // 下标下界（ARRAY[lo..hi] 的 lo，ARRAY[N] 为 0）
     } array_info;
     
     // 函数类型扩展信息
@@ -127,6 +128,20 @@ TypeInfo* type_info_create(DataType type);
  */
 TypeInfo* type_info_create_array(TypeInfo* elem_type, int32_t dimensions, int32_t* sizes);
 
+/**
+ * @brief 数组声明的元素总数（多维数组按展开后计算）
+ * @param type_info 类型信息指针
+ * @return 元素总数；不是数组、大小未知或超过 65535 时返回 0
+ */
+uint32_t type_info_array_length(const TypeInfo* type_info);
+
+/**
+ * @brief 数组下标下界（合法下标为 [下界, 下界 + 元素总数)）
+ * @param type_info 类型信息指针
+ * @return 下界；不是数组时返回 0
+ */
+int32_t type_info_array_lower(const TypeInfo* type_info);
+
 /**
  * @brief 创建函数类型信息
  * @param return_type 返回类型
@@ -184,6 +184,20 @@ void vm_dump_state(VM* vm);
  */
 void vm_dump_call_stack(VM* vm);
 
+/**
+ * @brief 获取当前指令对应的源码行号（按需加载调试段）
+ * @param vm 虚拟机实例
+ * @return 行号，没有行号信息返回 0
+ */
+int vm_get_current_line(VM* vm);
+
+/**
+ * @brief 获取当前模块的源文件名（按需加载调试段）
+ * @param vm 虚拟机实例
+ * @return 源文件名，没有时返回 NULL
+ */
+const char* vm_get_current_file(VM* vm);
+
 /**
  * @brief 注册外部函数
  * @param vm 虚拟机实例
@@ -5,7 +5,7 @@
  * 功能安全 (IEC 61508) 要求：
  * - 静态分析字节码的最坏执行路径
  * - 为每条指令分配周期成本
- * - 支持循环边界标注 (@LOOP_MAX)
+ * - 支持循环边界标注 (@LOOP_MAX)，常量边界的 FOR 循环由循环描述符自动推导
  * - 输出 WCET 估算结果用于周期时间验证
  */
 
@@ -4,10 +4,16 @@
  */
 
 #include "bytecode.h"
+#include "bytecode_io.h"
 #include "mmgr.h"
+#include "crc32.h"
+#include "bytecode_patch.h"
+#include "vm.h"
 #include <stdio.h>
 #include <assert.h>
 #include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
 
 void test_module_creation(void) {
     printf("\n--- Test: Module Creation ---\n");
@@ -84,6 +90,50 @@ void test_add_constants(void) {
     bytecode_module_free(module);
 }
 
+void test_constant_pool_index(void) {
+    printf("\n--- Test: Constant Pool Hash Index ---\n");
+    
+    BytecodeModule* module = bytecode_module_create();
+    const uint32_t n = 20000;
+    char buf[32];
+    
+    // 大量不同常量：每个都得到新索引
+    for (uint32_t i = 0; i < n; i++) {
+        assert(bytecode_add_int_constant(module, (int32_t)i) == i);
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "s%u", i);
+        assert(bytecode_add_string_constant(module, buf) == n + i);
+    }
+    assert(module->const_count == 2 * n);
+    
+    // 再次添加：全部命中已有索引
+    for (uint32_t i = 0; i < n; i++) {
+        assert(bytecode_add_int_constant(module, (int32_t)i) == i);
+        snprintf(buf, sizeof(buf), "s%u", i);
+        assert(bytecode_add_string_constant(module, buf) == n + i);
+    }
+    assert(module->const_count == 2 * n);
+    printf("✓ %u constants deduplicated through hash index\n", 2 * n);
+    
+    // 类型不同的相同位模式不应合并
+    uint32_t b = bytecode_add_bool_constant(module, true);
+    uint32_t r = bytecode_add_real_constant(module, 1.0);
+    assert(b != 1 && r != 1 && b != r);
+    assert(bytecode_add_real_constant(module, 1.0) == r);
+    assert(bytecode_add_bool_constant(module, true) == b);
+    printf("✓ Constants of different types kept apart\n");
+    
+    // 模拟加载器直接追加常量：索引应按需补录
+    module->constants[module->const_count].type = CONST_INT;
+    module->constants[module->const_count].int_val = -7;
+    uint32_t appended = module->const_count++;
+    assert(bytecode_add_int_constant(module, -7) == appended);
+    printf("✓ Directly appended constants picked up by the index\n");
+    
+    bytecode_module_free(module);
+}
+
 void test_add_functions(void) {
     printf("\n--- Test: Add Functions ---\n");
     
@@ -214,13 +264,822 @@ void test_line_numbers(void) {
     bytecode_add_instruction_with_line(module, OP_PUSH, 0, 1, 11);
     bytecode_add_instruction_with_line(module, OP_ADD, 0, 0, 12);
     
-    assert(module->line_numbers != NULL);
-    assert(module->line_numbers[0] == 10);
-    assert(module->line_numbers[1] == 11);
-    assert(module->line_numbers[2] == 12);
+    assert(module->line_table.count == 3);
+    assert(bytecode_line_for_pc(module, 0) == 10);
+    assert(bytecode_line_for_pc(module, 1) == 11);
+    assert(bytecode_line_for_pc(module, 2) == 12);
     printf("✓ Line numbers recorded correctly\n");
     
     bytecode_module_free(module);
+    
+    // 行号表只在行号变化处记录条目
+    module = bytecode_module_create();
+    const int lines[] = { 5, 5, 5, 6, 6, 9, 9, 9, 9, 6, 12 };
+    const uint32_t n = sizeof(lines) / sizeof(lines[0]);
+    for (uint32_t i = 0; i < n; i++) {
+        bytecode_add_instruction_with_line(module, OP_NOP, 0, 0, lines[i]);
+    }
+    assert(module->line_table.count == 5);
+    for (uint32_t i = 0; i < n; i++) {
+        assert(bytecode_line_for_pc(module, i) == lines[i]);
+    }
+    assert(bytecode_line_for_pc(module, n) == 0);
+    printf("✓ Line table compressed to %u entries for %u instructions\n",
+           module->line_table.count, n);
+    
+    // 行号 -> pc：取该行首条指令；空行落到其后最近的有代码行
+    assert(bytecode_pc_for_line(module, 5) == 0);
+    assert(bytecode_pc_for_line(module, 6) == 3);
+    assert(bytecode_pc_for_line(module, 7) == 5);
+    assert(bytecode_pc_for_line(module, 12) == 10);
+    assert(bytecode_pc_for_line(module, 13) == (uint32_t)-1);
+    bytecode_add_instruction_with_line(module, OP_HALT, 0, 0, 2);
+    assert(bytecode_pc_for_line(module, 1) == n);
+    printf("✓ Line to pc queries resolved\n");
+    
+    bytecode_module_free(module);
+}
+
+void test_capacity_model(void) {
+    printf("\n--- Test: Capacity Model ---\n");
+    
+    // 编译期模块从小容量起步，按需几何增长（行号数组同步增长）
+    BytecodeModule* module = bytecode_module_create();
+    assert(module->instruction_capacity == INITIAL_INSTRUCTION_CAPACITY);
+    const uint32_t n = INITIAL_INSTRUCTION_CAPACITY * 5 + 3;
+    for (uint32_t i = 0; i < n; i++) {
+        assert(bytecode_add_instruction_with_line(module, OP_NOP, 0, 0, (int)i + 1) == i);
+    }
+    assert(module->instruction_capacity >= n);
+    assert(bytecode_line_for_pc(module, n - 1) == (int)n);
+    for (uint32_t i = 0; i < INITIAL_FUNCTION_CAPACITY * 3; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "f%u", i);
+        assert(bytecode_add_function(module, name, i, 0, 0, TYPE_VOID, NULL) == i);
+    }
+    printf("✓ Module grew geometrically to %u instructions\n", module->instruction_capacity);
+    
+    // 从文件加载的模块按文件头计数精确分配
+    const char* path = "/tmp/stvm_test_capacity.stbc";
+    assert(bytecode_save(module, path) == OK);
+    BytecodeModule* loaded = bytecode_load(path);
+    assert(loaded != NULL);
+    assert(loaded->instruction_count == n);
+    assert(loaded->instruction_capacity == n);
+    assert(loaded->function_capacity == loaded->function_count);
+    assert(loaded->const_capacity == loaded->const_count);
+    printf("✓ Loaded module sized exactly from header\n");
+    
+    // 精确分配的模块仍可继续追加
+    assert(bytecode_add_instruction(loaded, OP_HALT, 0, 0) == n);
+    assert(bytecode_add_int_constant(loaded, 7) == loaded->const_count - 1);
+    bytecode_module_free(loaded);
+    remove(path);
+    
+    // 零容量模块
+    BytecodeModule* empty = bytecode_module_create_sized(0, 0, 0);
+    assert(empty != NULL && empty->instructions == NULL);
+    assert(bytecode_add_instruction(empty, OP_HALT, 0, 0) == 0);
+    assert(bytecode_add_function(empty, "main", 0, 0, 0, TYPE_VOID, NULL) == 0);
+    printf("✓ Zero-capacity module grows on demand\n");
+    bytecode_module_free(empty);
+    
+    bytecode_module_free(module);
+}
+
+void test_zero_copy_load(void) {
+    printf("\n--- Test: Zero-Copy Load ---\n");
+    
+    BytecodeModule* module = bytecode_module_create();
+    uint32_t s0 = bytecode_add_string_constant(module, "hello");
+    uint32_t r0 = bytecode_add_real_constant(module, 2.5);
+    bytecode_add_instruction(module, OP_PUSH, 0, (uint16_t)s0);
+    bytecode_add_instruction(module, OP_PUSH, 0, (uint16_t)r0);
+    bytecode_add_instruction(module, OP_HALT, 0, 0);
+    DataType params[2] = { TYPE_INT, TYPE_REAL };
+    bytecode_add_function(module, "f", 0, 2, 1, TYPE_BOOL, params);
+    bytecode_add_library_dependency(module, "libs/math.stbc");
+    
+    const char* path = "/tmp/stvm_test_zero_copy.stbc";
+    assert(bytecode_save(module, path) == OK);
+    
+    // mmap 加载：指令与字符串常量指向映射
+    BytecodeModule* loaded = bytecode_load(path);
+    assert(loaded != NULL && loaded->image_mapped);
+    assert(bytecode_in_image(loaded, loaded->instructions));
+    assert(bytecode_in_image(loaded, loaded->constants[s0].string_val));
+    assert(strcmp(loaded->constants[s0].string_val, "hello") == 0);
+    assert(loaded->constants[r0].real_val == 2.5);
+    assert(loaded->instruction_count == 3);
+    assert(loaded->instructions[0].opcode == OP_PUSH);
+    assert(loaded->functions[0].param_types[1] == TYPE_REAL);
+    assert(strcmp(loaded->library_deps[0], "libs/math.stbc") == 0);
+    printf("✓ Instructions and strings reference the mapping\n");
+    
+    // 修改前写时复制
+    bytecode_patch_operand(loaded, 0, (uint16_t)r0);
+    assert(!bytecode_in_image(loaded, loaded->instructions));
+    assert(loaded->instructions[0].operand == r0);
+    assert(bytecode_add_instruction(loaded, OP_NOP, 0, 0) == 3);
+    printf("✓ Instructions copied out of the mapping on write\n");
+    bytecode_module_free(loaded);
+    
+    // 流式加载与内存加载走同一解析路径
+    FILE* fp = fopen(path, "rb");
+    assert(fp != NULL);
+    BytecodeModule* streamed = bytecode_load_from_stream(fp);
+    fclose(fp);
+    assert(streamed != NULL && !streamed->image_mapped);
+    assert(strcmp(streamed->constants[s0].string_val, "hello") == 0);
+    bytecode_module_free(streamed);
+    
+    // 截断的映像应被拒绝
+    fp = fopen(path, "rb");
+    static uint8_t raw[4096];
+    size_t size = fread(raw, 1, sizeof(raw), fp);
+    fclose(fp);
+    assert(bytecode_load_from_memory(raw, size - 8, false) == NULL);
+    
+    // 文件头计数与段大小不符：在按计数分配之前拒绝
+    static uint8_t forged[4096];
+    uint32_t huge = 0x40000000u;
+    memcpy(forged, raw, size);
+    memcpy(forged + offsetof(STBCHeader, constant_count), &huge, sizeof(huge));
+    assert(bytecode_load_from_memory(forged, size, false) == NULL);
+    memcpy(forged, raw, size);
+    memcpy(forged + offsetof(STBCHeader, function_count), &huge, sizeof(huge));
+    assert(bytecode_load_from_memory(forged, size, false) == NULL);
+    BytecodeModule* from_mem = bytecode_load_from_memory(raw, size, false);
+    assert(from_mem != NULL && from_mem->function_count == 1);
+    bytecode_module_free(from_mem);
+    printf("✓ Stream and memory loads share the image parser\n");
+    
+    // 已映射的文件被重新保存：旧映射仍然完整可读
+    BytecodeModule* big = bytecode_module_create();
+    for (uint32_t i = 0; i < 20000; i++) {
+        bytecode_add_instruction(big, OP_NOP, 0, (uint16_t)i);
+    }
+    bytecode_add_instruction(big, OP_HALT, 0, 7);
+    assert(bytecode_save(big, path) == OK);
+    BytecodeModule* mapped = bytecode_load(path);
+    assert(mapped != NULL && mapped->image_mapped);
+    assert(bytecode_save(module, path) == OK);
+    assert(mapped->instructions[mapped->instruction_count - 1].opcode == OP_HALT);
+    assert(mapped->instructions[mapped->instruction_count - 1].operand == 7);
+    assert(mapped->instructions[12345].operand == 12345);
+    BytecodeModule* reloaded = bytecode_load(path);
+    assert(reloaded != NULL && reloaded->instruction_count == 3);
+    bytecode_module_free(reloaded);
+    bytecode_module_free(mapped);
+    bytecode_module_free(big);
+    printf("✓ Saving over a mapped file leaves the old mapping intact\n");
+    
+    remove(path);
+    bytecode_module_free(module);
+}
+
+void test_sectioned_format(void) {
+    printf("\n--- Test: Sectioned Format ---\n");
+    
+    BytecodeModule* module = bytecode_module_create();
+    bytecode_add_instruction_with_line(module, OP_PUSH, 0, (uint16_t)bytecode_add_int_constant(module, 5), 3);
+    bytecode_add_instruction_with_line(module, OP_STORE, FLAG_GLOBAL, 0, 3);
+    bytecode_add_instruction_with_line(module, OP_HALT, 0, 0, 4);
+    module->source_file = mmgr_strdup("demo.st");
+    module->global_count = 1;
+    module->globals_info = (GlobalEntry*)mmgr_calloc(sizeof(GlobalEntry));
+    module->globals_info[0].name = mmgr_strdup("counter");
+    module->globals_info[0].type = TYPE_INT;
+    
+    const char* path = "/tmp/stvm_test_sections.stbc";
+    assert(bytecode_save(module, path) == OK);
+    
+    // 调试段不在加载路径上
+    BytecodeModule* loaded = bytecode_load(path);
+    assert(loaded != NULL && loaded->debug_pending);
+    assert(loaded->globals_info == NULL && loaded->line_table.count == 0);
+    uint32_t size = 0;
+    assert(bytecode_get_section(loaded, STBC_SECTION_CODE, &size) != NULL);
+    assert(size == 3 * sizeof(Instruction));
+    assert(bytecode_get_section(loaded, STBC_SECTION_LINES, NULL) != NULL);
+    printf("✓ Debug sections skipped at load time\n");
+    
+    // 未加载调试段时重新保存，调试段原样保留
+    const char* path2 = "/tmp/stvm_test_sections2.stbc";
+    assert(bytecode_save(loaded, path2) == OK);
+    BytecodeModule* resaved = bytecode_load(path2);
+    assert(resaved != NULL);
+    assert(bytecode_load_debug_info(resaved) == OK);
+    assert(strcmp(resaved->globals_info[0].name, "counter") == 0);
+    bytecode_module_free(resaved);
+    remove(path2);
+    
+    // 按需加载
+    assert(bytecode_load_debug_info(loaded) == OK && !loaded->debug_pending);
+    assert(strcmp(loaded->globals_info[0].name, "counter") == 0);
+    assert(strcmp(loaded->source_file, "demo.st") == 0);
+    assert(bytecode_line_for_pc(loaded, 0) == 3);
+    assert(bytecode_line_for_pc(loaded, 2) == 4);
+    assert(bytecode_pc_for_line(loaded, 4) == 2);
+    printf("✓ Debug sections loaded on demand\n");
+    bytecode_module_free(loaded);
+    
+    // 逐段校验：代码段损坏拒绝加载，调试段损坏只影响调试信息
+    FILE* fp = fopen(path, "rb");
+    static uint8_t raw[4096];
+    size_t file_size = fread(raw, 1, sizeof(raw), fp);
+    fclose(fp);
+    const STBCLayout* layout = (const STBCLayout*)(raw + sizeof(STBCHeader));
+    const STBCSection* table = (const STBCSection*)(raw + sizeof(STBCHeader) + sizeof(STBCLayout));
+    uint32_t code_off = 0, lines_off = 0;
+    for (uint32_t i = 0; i < layout->section_count; i++) {
+        if (table[i].type == STBC_SECTION_CODE) code_off = table[i].offset;
+        if (table[i].type == STBC_SECTION_LINES) lines_off = table[i].offset;
+    }
+    assert(code_off && lines_off);
+    
+    raw[code_off] ^= 0xFF;
+    assert(bytecode_load_from_memory(raw, file_size, false) == NULL);
+    raw[code_off] ^= 0xFF;
+    raw[lines_off] ^= 0xFF;
+    BytecodeModule* partial = bytecode_load_from_memory(raw, file_size, false);
+    assert(partial != NULL);
+    assert(bytecode_load_debug_info(partial) == ERR_INVALID_BYTECODE);
+    assert(partial->line_table.count == 0);
+    bytecode_module_free(partial);
+    printf("✓ Per-section checksums verified\n");
+    
+    remove(path);
+    bytecode_module_free(module);
+}
+
+void test_variadic_function_roundtrip(void) {
+    printf("\n--- Test: Variadic Function Round Trip ---\n");
+    
+    // 内置 PRINT 以参数个数 -1 登记为可变参数外部函数
+    BytecodeModule* module = bytecode_module_create();
+    DataType params[] = {TYPE_INT, TYPE_REAL};
+    bytecode_add_function(module, "PRINT", 0, -1, 0, TYPE_VOID, NULL);
+    bytecode_add_function(module, "f", 2, 2, 3, TYPE_INT, params);
+    bytecode_add_instruction(module, OP_PUSH, 0, (uint16_t)bytecode_add_int_constant(module, 1));
+    bytecode_add_instruction(module, OP_CALL_EXT, 1, 0);
+    bytecode_add_instruction(module, OP_HALT, 0, 0);
+    bytecode_add_instruction(module, OP_RET, 0, 0);
+    
+    const char* path = "/tmp/stvm_test_variadic.stbc";
+    const char* lib_path = "/tmp/stvm_test_variadic_lib.stbc";
+    assert(bytecode_save(module, path) == OK);
+    assert(bytecode_save_library(module, NULL, lib_path) == OK);
+    
+    const char* paths[] = {path, lib_path};
+    for (int i = 0; i < 2; i++) {
+        BytecodeModule* loaded = bytecode_load(paths[i]);
+        assert(loaded != NULL && loaded->function_count == 2);
+        assert(strcmp(loaded->functions[0].name, "PRINT") == 0);
+        assert(loaded->functions[0].param_count == -1);
+        assert(loaded->functions[0].param_types == NULL);
+        // 后面的条目不受影响
+        assert(loaded->functions[1].param_count == 2 && loaded->functions[1].local_count == 3);
+        assert(loaded->functions[1].param_types[1] == TYPE_REAL);
+        bytecode_module_free(loaded);
+    }
+    printf("✓ Negative parameter count saved and loaded without parameter types\n");
+    
+    remove(path);
+    remove(lib_path);
+    bytecode_module_free(module);
+}
+
+/**
+ * @brief 构造补丁测试用模块（v2 修改 helper、追加函数和常量、插入全局变量）
+ */
+static BytecodeModule* build_patch_module(bool v2) {
+    BytecodeModule* module = bytecode_module_create();
+    uint16_t k100 = (uint16_t)bytecode_add_int_constant(module, 100);
+    uint16_t kpi = (uint16_t)bytecode_add_real_constant(module, 3.14);
+    
+    for (uint32_t i = 0; i < 2000; i++) {
+        bytecode_add_instruction_with_line(module, OP_PUSH, 0, (i % 2) ? k100 : kpi, 10 + (int)i / 10);
+    }
+    bytecode_add_function(module, "main", 0, 0, 0, TYPE_VOID, NULL);
+    bytecode_add_function(module, "helper", 1000, 0, 2, TYPE_INT, NULL);
+    
+    if (v2) {
+        uint16_t kstr = (uint16_t)bytecode_add_string_constant(module, "patched");
+        module->instructions[1005].operand = kstr;
+        bytecode_add_instruction(module, OP_PUSH, 0, k100);
+        bytecode_add_instruction(module, OP_RET, 0, 0);
+        DataType params[1] = { TYPE_INT };
+        bytecode_add_function(module, "extra", 2000, 1, 0, TYPE_INT, params);
+    }
+    
+    const char* names_v1[] = { "a", "b" };
+    const char* names_v2[] = { "a", "c", "b" };
+    const char** names = v2 ? names_v2 : names_v1;
+    module->global_count = v2 ? 3 : 2;
+    module->globals_info = (GlobalEntry*)mmgr_calloc(sizeof(GlobalEntry) * module->global_count);
+    for (uint32_t i = 0; i < module->global_count; i++) {
+        module->globals_info[i].name = mmgr_strdup(names[i]);
+        module->globals_info[i].type = TYPE_INT;
+        module->globals_info[i].index = (int32_t)i;
+    }
+    return module;
+}
+
+void test_bytecode_patch(void) {
+    printf("\n--- Test: Bytecode Patch ---\n");
+    
+    BytecodeModule* v1 = build_patch_module(false);
+    BytecodeModule* v2 = build_patch_module(true);
+    
+    BytecodePatch* patch = bytecode_patch_create(v1, v2);
+    assert(patch != NULL);
+    assert(patch->header.base_digest == bytecode_compute_digest(v1));
+    assert(patch->header.target_digest == bytecode_compute_digest(v2));
+    assert(patch->header.run_count == 2);
+    assert(patch->header.const_copy_count == 1 && patch->new_const_count == 1 && patch->header.const_count == 3);
+    assert(patch->header.function_record_count == 1 && patch->functions[0].index == 2);
+    assert(patch->header.global_record_count == 2);
+    assert(bytecode_patch_touches(patch, 1000, 2000));
+    assert(!bytecode_patch_touches(patch, 0, 1000));
+    printf("✓ Patch created: %zu bytes, %u runs\n", patch->size, patch->header.run_count);
+    
+    // 保存后重新加载
+    const char* base_path = "/tmp/stvm_test_patch_base.stbc";
+    const char* patch_path = "/tmp/stvm_test_patch.stbp";
+    assert(bytecode_save(v1, base_path) == OK);
+    assert(bytecode_patch_save(patch, patch_path) == OK);
+    BytecodePatch* loaded_patch = bytecode_patch_load(patch_path);
+    assert(loaded_patch != NULL && loaded_patch->size == patch->size);
+    
+    // 原地应用到零拷贝加载的基准模块
+    BytecodeModule* module = bytecode_load(base_path);
+    assert(module != NULL);
+    assert(bytecode_load_debug_info(module) == OK);
+    assert(bytecode_patch_apply(module, loaded_patch) == OK);
+    
+    assert(module->instruction_count == v2->instruction_count);
+    assert(memcmp(module->instructions, v2->instructions,
+                  sizeof(Instruction) * v2->instruction_count) == 0);
+    assert(module->const_count == 3);
+    assert(module->constants[2].type == CONST_STRING);
+    assert(strcmp(module->constants[2].string_val, "patched") == 0);
+    assert(module->function_count == 3);
+    assert(strcmp(module->functions[2].name, "extra") == 0);
+    assert(module->functions[2].address == 2000);
+    assert(module->functions[2].param_types[0] == TYPE_INT);
+    assert(module->global_count == 3);
+    assert(strcmp(module->globals_info[1].name, "c") == 0);
+    assert(strcmp(module->globals_info[2].name, "b") == 0);
+    assert(module->line_table.count == v2->line_table.count);
+    assert(bytecode_line_for_pc(module, 1999) == bytecode_line_for_pc(v2, 1999));
+    assert(bytecode_compute_checksum(module) == bytecode_compute_checksum(v2));
+    assert(bytecode_compute_digest(module) == bytecode_compute_digest(v2));
+    printf("✓ Patch applied in place matches target module\n");
+    
+    // 只有常量值不同的基准：旧校验和相同，摘要不同，补丁被拒绝且模块不变
+    BytecodeModule* other = build_patch_module(false);
+    other->constants[0].int_val = 200;
+    assert(bytecode_compute_checksum(other) == bytecode_compute_checksum(v1));
+    assert(bytecode_compute_digest(other) != bytecode_compute_digest(v1));
+    assert(bytecode_patch_apply(other, loaded_patch) == ERR_INVALID_BYTECODE);
+    assert(other->instruction_count == v1->instruction_count && other->const_count == 2);
+    bytecode_module_free(other);
+    
+    // 叠加结果与目标摘要不符时在修改模块之前失败
+    BytecodePatch* bad_target = bytecode_patch_load(patch_path);
+    assert(bad_target != NULL);
+    bad_target->header.target_digest ^= 1;
+    BytecodeModule* base = bytecode_load(base_path);
+    assert(base != NULL);
+    assert(bytecode_patch_check(bad_target, base) == ERR_INVALID_BYTECODE);
+    assert(bytecode_patch_apply(base, bad_target) == ERR_INVALID_BYTECODE);
+    assert(bytecode_compute_digest(base) == bytecode_compute_digest(v1));
+    bytecode_module_free(base);
+    bytecode_patch_free(bad_target);
+    printf("✓ Constant-only base difference and target mismatch rejected\n");
+    
+    // 常量索引随截断重建，去重仍然正确
+    assert(bytecode_add_string_constant(module, "patched") == 2);
+    assert(bytecode_add_int_constant(module, 100) == 0);
+    
+    // 基准不符时拒绝，数据损坏时拒绝加载
+    assert(bytecode_patch_apply(module, loaded_patch) == ERR_INVALID_BYTECODE);
+    uint8_t* raw = (uint8_t*)mmgr_alloc(patch->size);
+    memcpy(raw, patch->data, patch->size);
+    raw[patch->size - 1] ^= 0xFF;
+    assert(bytecode_patch_load_from_memory(raw, patch->size, true) == NULL);
+    printf("✓ Mismatched base and corrupted patch rejected\n");
+    
+    bytecode_module_free(module);
+    bytecode_patch_free(loaded_patch);
+    bytecode_patch_free(patch);
+    bytecode_module_free(v2);
+    bytecode_module_free(v1);
+    remove(base_path);
+    remove(patch_path);
+}
+
+/**
+ * @brief 构造重定位测试用模块：8 个函数依次调用下一个，
+ *        v2 在第一个函数开头插入一条引用新常量的指令，新常量排在常量池最前面
+ */
+static BytecodeModule* build_reloc_module(bool v2) {
+    BytecodeModule* module = bytecode_module_create();
+    uint16_t kstr = 0;
+    if (v2) kstr = (uint16_t)bytecode_add_string_constant(module, "inserted");
+    
+    int32_t line = 1;
+    for (uint32_t f = 0; f < 8; f++) {
+        char name[8];
+        snprintf(name, sizeof(name), "F%u", f);
+        bytecode_add_function(module, name, module->instruction_count, 0, 1, TYPE_VOID, NULL);
+        if (v2 && f == 0) {
+            bytecode_add_instruction_with_line(module, OP_PUSH, 0, kstr, line++);
+        }
+        uint16_t k = (uint16_t)bytecode_add_int_constant(module, 100 + (int32_t)f);
+        bytecode_add_instruction_with_line(module, OP_PUSH, 0, k, line++);
+        bytecode_add_instruction_with_line(module, OP_JZ, 0, (uint16_t)(module->instruction_count + 2), line++);
+        bytecode_add_instruction_with_line(module, OP_CALL, 0, (uint16_t)((f + 1) % 8), line++);
+        bytecode_add_instruction_with_line(module, OP_RET, 0, 0, line++);
+    }
+    return module;
+}
+
+void test_patch_relocation(void) {
+    printf("\n--- Test: Patch Relocation ---\n");
+    
+    BytecodeModule* v1 = build_reloc_module(false);
+    BytecodeModule* v2 = build_reloc_module(true);
+    
+    // 后面的函数整体平移：跳转地址、常量下标、行号都由重定位得到，不进入补丁
+    BytecodePatch* patch = bytecode_patch_create(v1, v2);
+    assert(patch != NULL);
+    assert(patch->header.run_count == 1);
+    assert(patch->runs[0].offset == 0 && patch->runs[0].count <= 2);
+    assert(patch->header.function_record_count == 0);
+    assert(patch->header.const_copy_count == 1 && patch->new_const_count == 1);
+    assert(patch->new_line_count == 1);
+    assert(bytecode_patch_moves_range(patch, 0, 4));
+    assert(bytecode_patch_moves_range(patch, 28, 32));
+    assert(!bytecode_patch_touches(patch, 5, v2->instruction_count));
+    printf("✓ Early insertion: %zu bytes, %u segments, %u runs\n",
+           patch->size, patch->header.segment_count, patch->header.run_count);
+    
+    BytecodeModule* module = build_reloc_module(false);
+    assert(bytecode_patch_apply(module, patch) == OK);
+    assert(bytecode_compute_digest(module) == bytecode_compute_digest(v2));
+    assert(module->functions[7].address == v2->functions[7].address);
+    assert(strcmp(module->constants[0].string_val, "inserted") == 0);
+    assert(module->line_table.count == v2->line_table.count);
+    for (uint32_t pc = 0; pc < v2->instruction_count; pc++) {
+        assert(bytecode_line_for_pc(module, pc) == bytecode_line_for_pc(v2, pc));
+    }
+    printf("✓ Relocated patch applied matches target module\n");
+    
+    // 反向补丁删除插入的指令和常量
+    BytecodePatch* reverse = bytecode_patch_create(v2, v1);
+    assert(reverse != NULL && reverse->header.function_record_count == 0);
+    assert(reverse->new_const_count == 0 && reverse->new_line_count == 0);
+    assert(bytecode_patch_apply(module, reverse) == OK);
+    assert(bytecode_compute_digest(module) == bytecode_compute_digest(v1));
+    printf("✓ Reverse patch: %zu bytes\n", reverse->size);
+    
+    bytecode_patch_free(reverse);
+    bytecode_patch_free(patch);
+    bytecode_module_free(module);
+    bytecode_module_free(v2);
+    bytecode_module_free(v1);
+}
+
+void test_crc32(void) {
+    printf("\n--- Test: CRC32 ---\n");
+    
+    // 标准检验值
+    assert(crc32_compute("123456789", 9) == 0xCBF43926u);
+    assert(crc32_compute(NULL, 0) == 0);
+    printf("✓ Check value matches (implementation: %s)\n", crc32_implementation());
+    
+    // 加速路径与查表路径在各种长度、对齐下一致
+    size_t size = 4096 + 64;
+    uint8_t* buf = (uint8_t*)mmgr_alloc(size);
+    assert(buf != NULL);
+    srand(12345);
+    for (size_t i = 0; i < size; i++) buf[i] = (uint8_t)rand();
+    
+    for (size_t offset = 0; offset < 16; offset++) {
+        for (size_t len = 0; len + offset <= size; len += (len < 300 ? 1 : 97)) {
+            assert(crc32_update(0, buf + offset, len) ==
+                   crc32_update_portable(0, buf + offset, len));
+        }
+    }
+    printf("✓ Accelerated and portable paths agree\n");
+    
+    // 分块增量计算与一次性计算一致
+    uint32_t whole = crc32_compute(buf, size);
+    uint32_t crc = 0;
+    size_t pos = 0;
+    size_t chunk = 1;
+    while (pos < size) {
+        size_t n = (chunk < size - pos) ? chunk : size - pos;
+        crc = crc32_update(crc, buf + pos, n);
+        pos += n;
+        chunk = chunk * 3 + 1;
+    }
+    assert(crc == whole);
+    printf("✓ Incremental update matches one-shot CRC\n");
+    
+    mmgr_free(buf);
+}
+
+void test_symbol_index(void) {
+    printf("\n--- Test: Library Symbol Index ---\n");
+    
+    // 足够多的函数让探测链出现冲突，外加一个同名函数
+    BytecodeModule* module = bytecode_module_create();
+    DataType params[] = {TYPE_INT, TYPE_REAL};
+    char name[32];
+    for (int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "fn_%d", i);
+        bytecode_add_function(module, name, (uint32_t)i * 4, i % 3, i % 5, TYPE_INT, params);
+    }
+    bytecode_add_function(module, "fn_7", 9999, 0, 0, TYPE_VOID, NULL);
+    bytecode_add_instruction(module, OP_HALT, 0, 0);
+    
+    const char* lib_path = "/tmp/stvm_test_symbols.stbc";
+    const char* plain_path = "/tmp/stvm_test_plain.stbc";
+    assert(bytecode_save_library(module, NULL, lib_path) == OK);
+    assert(bytecode_save(module, plain_path) == OK);
+    
+    // 带函数的模块按普通文件保存也带索引，没有函数的模块不带
+    BytecodeModule* plain = bytecode_load(plain_path);
+    assert(plain != NULL && plain->symbol_index != NULL);
+    assert(plain->symbol_index->symbol_count == 200);
+    
+    BytecodeModule* no_funcs = bytecode_module_create();
+    bytecode_add_instruction(no_funcs, OP_HALT, 0, 0);
+    assert(bytecode_save(no_funcs, plain_path) == OK);
+    bytecode_module_free(no_funcs);
+    no_funcs = bytecode_load(plain_path);
+    assert(no_funcs != NULL && no_funcs->symbol_index == NULL);
+    assert(bytecode_get_section(no_funcs, STBC_SECTION_SYMBOLS, NULL) == NULL);
+    bytecode_module_free(no_funcs);
+    
+    BytecodeModule* lib = bytecode_load(lib_path);
+    assert(lib != NULL && lib->symbol_index != NULL);
+    assert(lib->symbol_index->symbol_count == 200);
+    
+    for (int i = 0; i < 200; i++) {
+        snprintf(name, sizeof(name), "fn_%d", i);
+        const STBCSymbolRecord* rec = bytecode_lookup_symbol(lib, name);
+        assert(rec != NULL && rec->function_index == (uint32_t)i);
+        assert(rec->address == (uint32_t)i * 4);
+        assert(rec->param_count == i % 3 && rec->local_count == i % 5);
+        assert(bytecode_find_function(lib, name) == &lib->functions[i]);
+        assert(bytecode_find_function(plain, name) == &plain->functions[i]);
+    }
+    assert(bytecode_lookup_symbol(lib, "fn_200") == NULL);
+    assert(bytecode_find_function(lib, "missing") == NULL);
+    assert(bytecode_lookup_symbol(plain, "fn_1") != NULL);
+    printf("✓ All 200 symbols found through the index (first duplicate wins)\n");
+    
+    // 修改函数表后索引失效，回退顺序查找
+    bytecode_add_function(lib, "late", 0, 0, 0, TYPE_VOID, NULL);
+    assert(lib->symbol_index == NULL);
+    assert(bytecode_find_function(lib, "late") == &lib->functions[201]);
+    assert(bytecode_find_function(lib, "fn_42") == &lib->functions[42]);
+    printf("✓ Index invalidated when the function table changes\n");
+    
+    bytecode_module_free(lib);
+    bytecode_module_free(plain);
+    bytecode_module_free(module);
+    remove(lib_path);
+    remove(plain_path);
+}
+
+void test_remove_instructions(void) {
+    printf("\n--- Test: Remove Instructions ---\n");
+    
+    BytecodeModule* module = bytecode_module_create();
+    
+    // 0: JMP 4        ; 跳过函数
+    // 1: NOP          ; 函数 f 入口（将被删除，入口落到下一条）
+    // 2: PUSH 0
+    // 3: RET
+    // 4: NOP          ; 主程序（将被删除）
+    // 5: JZ 1
+    // 6: JMP 4
+    // 7: HALT
+    bytecode_add_instruction_with_line(module, OP_JMP, 0, 4, 1);
+    bytecode_add_instruction_with_line(module, OP_NOP, 0, 0, 2);
+    bytecode_add_instruction_with_line(module, OP_PUSH, 0, 0, 3);
+    bytecode_add_instruction_with_line(module, OP_RET, 0, 0, 3);
+    bytecode_add_instruction_with_line(module, OP_NOP, 0, 0, 5);
+    bytecode_add_instruction_with_line(module, OP_JZ, 0, 1, 6);
+    bytecode_add_instruction_with_line(module, OP_JMP, 0, 4, 7);
+    bytecode_add_instruction_with_line(module, OP_HALT, 0, 0, 8);
+    bytecode_add_function(module, "f", 1, 0, 0, TYPE_INT, NULL);
+    module->entry_point = 4;
+    
+    bool removed[8] = { false, true, false, false, true, false, false, false };
+    assert(bytecode_remove_instructions(module, removed) == 2);
+    assert(module->instruction_count == 6);
+    
+    // 跳转目标、函数入口、模块入口都落到原位置之后第一条保留的指令
+    assert(module->instructions[0].opcode == OP_JMP && module->instructions[0].operand == 3);
+    assert(module->functions[0].address == 1);
+    assert(module->instructions[1].opcode == OP_PUSH);
+    assert(module->instructions[3].opcode == OP_JZ && module->instructions[3].operand == 1);
+    assert(module->instructions[4].opcode == OP_JMP && module->instructions[4].operand == 3);
+    assert(module->entry_point == 3);
+    printf("✓ Jump targets and function addresses relocated\n");
+    
+    // 行号表随指令压缩：被删除指令的行号不再出现
+    assert(bytecode_line_for_pc(module, 0) == 1);
+    assert(bytecode_line_for_pc(module, 1) == 3);
+    assert(bytecode_line_for_pc(module, 3) == 6);
+    assert(bytecode_line_for_pc(module, 5) == 8);
+    assert(bytecode_pc_for_line(module, 2) == 1);
+    printf("✓ Line table rebuilt\n");
+    
+    bytecode_module_free(module);
+}
+
+void test_replace_instruction(void) {
+    printf("\n--- Test: Replace Instruction ---\n");
+    
+    BytecodeModule* module = bytecode_module_create();
+    
+    // 0: JMP 3        ; 跳过函数
+    // 1: PUSH 0       ; 函数 f 入口
+    // 2: RET
+    // 3: CALL f       ; 主程序（替换为三条指令）
+    // 4: JZ 3
+    // 5: HALT
+    bytecode_add_instruction_with_line(module, OP_JMP, 0, 3, 1);
+    bytecode_add_instruction_with_line(module, OP_PUSH, 0, 0, 2);
+    bytecode_add_instruction_with_line(module, OP_RET, 0, 0, 2);
+    bytecode_add_instruction_with_line(module, OP_CALL, 0, 0, 5);
+    bytecode_add_instruction_with_line(module, OP_JZ, 0, 3, 6);
+    bytecode_add_instruction_with_line(module, OP_HALT, 0, 0, 7);
+    bytecode_add_function(module, "f", 1, 0, 0, TYPE_INT, NULL);
+    module->entry_point = 3;
+    
+    Instruction code[3] = {
+        {.opcode = OP_PUSH, .flags = 0, .operand = 0},
+        {.opcode = OP_NOP, .flags = 0, .operand = 0},
+        {.opcode = OP_NOP, .flags = 0, .operand = 0},
+    };
+    LineEntry lines[2] = { {.pc = 0, .line = 2}, {.pc = 1, .line = 3} };
+    assert(bytecode_replace_instruction(module, 3, code, 3, lines, 2));
+    assert(module->instruction_count == 8);
+    
+    // 指向被替换指令的地址指向片段起点，之后的地址后移
+    assert(module->instructions[0].operand == 3);
+    assert(module->instructions[3].opcode == OP_PUSH);
+    assert(module->instructions[6].opcode == OP_JZ && module->instructions[6].operand == 3);
+    assert(module->instructions[7].opcode == OP_HALT);
+    assert(module->functions[0].address == 1);
+    assert(module->entry_point == 3);
+    printf("✓ Fragment spliced, addresses relocated\n");
+    
+    // 片段带自己的行号，片段之后恢复原来的行号
+    assert(bytecode_line_for_pc(module, 0) == 1);
+    assert(bytecode_line_for_pc(module, 3) == 2);
+    assert(bytecode_line_for_pc(module, 5) == 3);
+    assert(bytecode_line_for_pc(module, 6) == 6);
+    assert(bytecode_line_for_pc(module, 7) == 7);
+    printf("✓ Line table merged\n");
+    
+    // 超出 16 位地址空间时拒绝且不改动模块
+    Instruction* big = (Instruction*)mmgr_calloc(sizeof(Instruction) * UINT16_MAX);
+    assert(!bytecode_replace_instruction(module, 3, big, UINT16_MAX, NULL, 0));
+    assert(module->instruction_count == 8);
+    mmgr_free(big);
+    
+    bytecode_module_free(module);
+}
+
+/**
+ * @brief 构造静态链接后的程序：主程序调用库函数 Used，库中的 Unused、库初始化代码
+ *        和主程序的 Helper 都不可达
+ */
+static BytecodeModule* build_shake_program(void) {
+    BytecodeModule* lib = bytecode_module_create();
+    uint32_t ten = bytecode_add_int_constant(lib, 10);
+    uint32_t dead_int = bytecode_add_int_constant(lib, 777);
+    uint32_t dead_str = bytecode_add_string_constant(lib, "dead");
+    SwitchCase cases[] = { {1, 1, 8} };
+    assert(bytecode_add_switch_table(lib, SWITCH_SORTED, cases, 1, 8) == 0);
+    
+    // 0: JMP 9           ; 库自身的初始化代码
+    // 1: LOAD 0          ; Used(x) := x + 10
+    // 2: PUSH 10
+    // 3: ADD
+    // 4: STORE 1
+    // 5: RET
+    // 6: PUSH 777        ; Unused
+    // 7: SWITCH 0
+    // 8: RET
+    // 9: PUSH 'dead'
+    // 10: HALT
+    bytecode_add_instruction(lib, OP_JMP, 0, 9);
+    bytecode_add_instruction(lib, OP_LOAD, FLAG_LOCAL, 0);
+    bytecode_add_instruction(lib, OP_PUSH, 0, (uint16_t)ten);
+    bytecode_add_instruction(lib, OP_ADD, 0, 0);
+    bytecode_add_instruction(lib, OP_STORE, FLAG_LOCAL, 1);
+    bytecode_add_instruction(lib, OP_RET, 0, 0);
+    bytecode_add_instruction(lib, OP_PUSH, 0, (uint16_t)dead_int);
+    bytecode_add_instruction(lib, OP_SWITCH, 0, 0);
+    bytecode_add_instruction(lib, OP_RET, 0, 0);
+    bytecode_add_instruction(lib, OP_PUSH, 0, (uint16_t)dead_str);
+    bytecode_add_instruction(lib, OP_HALT, 0, 0);
+    bytecode_add_function(lib, "Used", 1, 1, 2, TYPE_INT, NULL);
+    bytecode_add_function(lib, "Unused", 6, 0, 0, TYPE_VOID, NULL);
+    
+    BytecodeModule* module = bytecode_module_create();
+    module->global_count = 1;
+    uint32_t five = bytecode_add_int_constant(module, 5);
+    uint32_t helper_val = bytecode_add_int_constant(module, 99);
+    
+    // 0: JMP 3
+    // 1: PUSH 99         ; Helper
+    // 2: RET
+    // 3: PUSH 5
+    // 4: CALL_EXT lib.stbc.Used
+    // 5: STORE global 0
+    // 6: HALT
+    bytecode_add_instruction(module, OP_JMP, 0, 3);
+    bytecode_add_instruction(module, OP_PUSH, 0, (uint16_t)helper_val);
+    bytecode_add_instruction(module, OP_RET, 0, 0);
+    bytecode_add_instruction(module, OP_PUSH, 0, (uint16_t)five);
+    bytecode_add_instruction(module, OP_CALL_EXT, 1, 1);
+    bytecode_add_instruction(module, OP_STORE, FLAG_GLOBAL, 0);
+    bytecode_add_instruction(module, OP_HALT, 0, 0);
+    bytecode_add_function(module, "Helper", 1, 0, 0, TYPE_INT, NULL);
+    bytecode_add_function(module, "lib.stbc.Used", 0, 1, 0, TYPE_INT, NULL);
+    
+    assert(bytecode_merge_library(module, lib, "lib.stbc") == OK);
+    assert(module->instruction_count == 18 && module->function_count == 4);
+    assert(module->instructions[4].opcode == OP_CALL && module->instructions[4].operand == 2);
+    bytecode_module_free(lib);
+    return module;
+}
+
+void test_tree_shake(void) {
+    printf("\n--- Test: Tree Shaking After Static Link ---\n");
+    
+    BytecodeModule* module = build_shake_program();
+    TreeShakeStats stats;
+    assert(bytecode_tree_shake(module, NULL, &stats) == OK);
+    
+    // Helper、入口的 JMP 之外的库代码（JMP、Unused、初始化）共 8 条指令被删除
+    assert(stats.removed_instructions == 8);
+    assert(module->instruction_count == 10);
+    assert(stats.removed_function_count == 3);
+    assert(strcmp(stats.removed_functions[0], "Helper") == 0);
+    assert(strcmp(stats.removed_functions[1], "lib.stbc.Used") == 0);
+    assert(strcmp(stats.removed_functions[2], "lib.stbc::Unused") == 0);
+    assert(module->function_count == 1);
+    assert(strcmp(module->functions[0].name, "lib.stbc::Used") == 0);
+    assert(module->functions[0].address == 5);
+    printf("✓ Unreachable functions removed: Helper, lib.stbc.Used, lib.stbc::Unused\n");
+    
+    // 调用、跳转和常量下标都已重编号
+    assert(module->instructions[0].opcode == OP_JMP && module->instructions[0].operand == 1);
+    assert(module->instructions[2].opcode == OP_CALL && module->instructions[2].operand == 0);
+    assert(module->instructions[6].opcode == OP_PUSH && module->instructions[6].operand == 1);
+    assert(stats.removed_constants == 3 && module->const_count == 2);
+    assert(module->constants[0].int_val == 5 && module->constants[1].int_val == 10);
+    assert(stats.removed_descriptors == 1 && module->switch_table_count == 0);
+    assert(module->switch_case_count == 0);
+    printf("✓ Calls, jumps and constants renumbered; unused switch table dropped\n");
+    
+    // 常量池索引重建后仍能去重
+    assert(bytecode_add_int_constant(module, 10) == 1);
+    assert(bytecode_add_int_constant(module, 777) == 2);
+    
+    VM* vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == OK);
+    assert(vm->globals[0].int_val == 15);
+    vm_free(vm);
+    printf("✓ Shaken program still computes 5 + 10 = 15\n");
+    
+    bytecode_tree_shake_stats_free(&stats);
+    assert(stats.removed_functions == NULL);
+    bytecode_module_free(module);
+    
+    // -e 指定的入口函数（不区分大小写）也是根
+    module = build_shake_program();
+    assert(bytecode_tree_shake(module, "HELPER", &stats) == OK);
+    assert(stats.removed_instructions == 6 && stats.removed_function_count == 2);
+    assert(module->function_count == 2);
+    assert(strcmp(module->functions[0].name, "Helper") == 0 && module->functions[0].address == 1);
+    assert(module->constants[module->instructions[1].operand].int_val == 99);
+    printf("✓ Entry function kept as a root\n");
+    bytecode_tree_shake_stats_free(&stats);
+    bytecode_module_free(module);
 }
 
 void test_opcode_strings(void) {
@@ -251,11 +1110,23 @@ int main(void) {
     test_module_creation();
     test_add_instructions();
     test_add_constants();
+    test_constant_pool_index();
     test_add_functions();
     test_patch_operand();
     test_disassemble();
     test_simple_program();
     test_line_numbers();
+    test_capacity_model();
+    test_zero_copy_load();
+    test_sectioned_format();
+    test_variadic_function_roundtrip();
+    test_bytecode_patch();
+    test_patch_relocation();
+    test_crc32();
+    test_symbol_index();
+    test_remove_instructions();
+    test_replace_instruction();
+    test_tree_shake();
     test_opcode_strings();
     
     // 打印统计信息
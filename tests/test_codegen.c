@@ -4,7 +4,14 @@
  */
 
 #include "codegen.h"
+#include "ir.h"
+#include "optimizer.h"
+#include "typecheck.h"
+#include "vm.h"
 #include "bytecode_io.h"
+#include "regcode.h"
+#include "wcet.h"
+#include "libmgr.h"
 #include "ast.h"
 #include "symtbl.h"
 #include "mmgr.h"
@@ -283,6 +290,1704 @@ void test_bytecode_save_load(void) {
     symtbl_free(symtbl);
 }
 
+// ============================================================================
+// 优化流水线（-O）
+// ============================================================================
+
+static ASTNode* opt_int_lit(int32_t v) {
+    Value val;
+    memset(&val, 0, sizeof(val));
+    val.type = TYPE_INT;
+    val.int_val = v;
+    return ast_create_literal(val);
+}
+
+static ASTNode* opt_bool_lit(bool v) {
+    Value val;
+    memset(&val, 0, sizeof(val));
+    val.type = TYPE_BOOL;
+    val.bool_val = v;
+    return ast_create_literal(val);
+}
+
+/**
+ * VAR CONSTANT LIMIT : INT := 10; TRACE : BOOL := FALSE; END_VAR
+ * VAR y : INT; END_VAR
+ * y := LIMIT * 2 + 1;
+ * IF TRACE THEN y := 0; END_IF
+ */
+static ASTNode* build_const_globals_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    TypeInfo* bool_type = type_info_create(TYPE_BOOL);
+
+    ASTNode* limit = ast_create_var_decl("LIMIT", int_type, opt_int_lit(10), true, true);
+    ASTNode* trace = ast_create_var_decl("TRACE", bool_type, opt_bool_lit(false), true, true);
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    limit->next = trace;
+    trace->next = y;
+
+    ASTNode* expr = ast_create_binary_op(BINOP_ADD,
+        ast_create_binary_op(BINOP_MUL, ast_create_identifier("LIMIT"), opt_int_lit(2)),
+        opt_int_lit(1));
+    ASTNode* assign = ast_create_assign(ast_create_identifier("y"), expr);
+    assign->next = ast_create_if(ast_create_identifier("TRACE"),
+                                 ast_create_assign(ast_create_identifier("y"), opt_int_lit(0)),
+                                 NULL);
+
+    type_info_free(int_type);
+    type_info_free(bool_type);
+    return ast_create_program("test", NULL, limit, NULL, assign);
+}
+
+/**
+ * FUNCTION Scale : INT
+ * VAR_INPUT v : INT; END_VAR
+ * VAR_LOCAL k : INT; t : INT; u : INT; END_VAR
+ *   k := 3; t := v; u := t AND 7; Scale := t * k;
+ * END_FUNCTION
+ * y := Scale(5);
+ */
+static ASTNode* build_local_copies_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+
+    ASTNode* param = ast_create_var_decl("v", int_type, NULL, false, true);
+    ASTNode* k = ast_create_var_decl("k", int_type, NULL, false, false);
+    ASTNode* t = ast_create_var_decl("t", int_type, NULL, false, false);
+    ASTNode* u = ast_create_var_decl("u", int_type, NULL, false, false);
+    k->next = t;
+    t->next = u;
+
+    ASTNode* s1 = ast_create_assign(ast_create_identifier("k"), opt_int_lit(3));
+    ASTNode* s2 = ast_create_assign(ast_create_identifier("t"), ast_create_identifier("v"));
+    ASTNode* s3 = ast_create_assign(ast_create_identifier("u"),
+        ast_create_binary_op(BINOP_AND, ast_create_identifier("t"), opt_int_lit(7)));
+    ASTNode* s4 = ast_create_assign(ast_create_identifier("Scale"),
+        ast_create_binary_op(BINOP_MUL, ast_create_identifier("t"), ast_create_identifier("k")));
+    s1->next = s2;
+    s2->next = s3;
+    s3->next = s4;
+    ASTNode* func = ast_create_function_decl("Scale", param, int_type, k, s1);
+
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    ASTNode** args = (ASTNode**)mmgr_alloc(sizeof(ASTNode*));
+    args[0] = opt_int_lit(5);
+    ASTNode* main_body = ast_create_assign(ast_create_identifier("y"),
+                                           ast_create_function_call("Scale", args, 1));
+
+    type_info_free(int_type);
+    return ast_create_program("test", NULL, y, func, main_body);
+}
+
+/**
+ * @brief 类型检查、（可选）优化、代码生成并执行，返回全局变量 y 与指令数
+ */
+static void compile_and_run_program(ASTNode* (*build)(void), bool optimize, bool use_ir,
+                                    int32_t* y_out, uint32_t* instr_out, Optimizer** opt_out) {
+    ASTNode* program = build();
+    SymbolTable* symtbl = symtbl_init();
+    TypeChecker checker;
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+
+    Optimizer* opt = NULL;
+    if (optimize) {
+        opt = optimizer_create();
+        assert(opt != NULL);
+        assert(optimizer_run_ast(opt, program) == OK);
+    }
+
+    BytecodeModule* module = bytecode_module_create();
+    CodeGenContext* ctx = codegen_create(module, symtbl);
+    ctx->use_ir = use_ir;
+    ctx->optimizer = opt;
+    assert(codegen_generate(ctx, program) == OK);
+    codegen_free(ctx);
+    if (opt) {
+        assert(optimizer_run_bytecode(opt, module) == OK);
+    }
+
+    VM* vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == OK);
+
+    const GlobalEntry* y = NULL;
+    for (uint32_t i = 0; i < module->global_count; i++) {
+        if (module->globals_info[i].name && strcmp(module->globals_info[i].name, "y") == 0) {
+            y = &module->globals_info[i];
+        }
+    }
+    assert(y != NULL);
+    *y_out = vm->globals[y->index].int_val;
+    *instr_out = module->instruction_count;
+
+    vm_free(vm);
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    if (opt_out) {
+        *opt_out = opt;
+    } else {
+        optimizer_free(opt);
+    }
+    ast_free_node(program);
+}
+
+void test_optimizer_const_globals(void) {
+    printf("\n--- Test: Optimizer (VAR CONSTANT globals) ---\n");
+
+    int32_t y_plain, y_opt;
+    uint32_t n_plain, n_opt;
+    Optimizer* opt = NULL;
+    compile_and_run_program(build_const_globals_program, false, false, &y_plain, &n_plain, NULL);
+    compile_and_run_program(build_const_globals_program, true, false, &y_opt, &n_opt, &opt);
+
+    assert(y_plain == 21);
+    assert(y_opt == 21);
+    assert(n_opt < n_plain);
+    assert(opt->passes[OPT_PASS_CONST_GLOBALS].changes == 2);
+    assert(opt->passes[OPT_PASS_CONST_FOLD].changes >= 2);
+    assert(opt->passes[OPT_PASS_DEAD_CODE].changes == 1);
+    printf("✓ y = %d, instructions %u -> %u\n", y_opt, n_plain, n_opt);
+
+    optimizer_print_stats(opt);
+    optimizer_free(opt);
+}
+
+void test_optimizer_local_copies(void) {
+    printf("\n--- Test: Optimizer (copy propagation, dead stores) ---\n");
+
+    int32_t y_plain, y_opt;
+    uint32_t n_plain, n_opt;
+    Optimizer* opt = NULL;
+    compile_and_run_program(build_local_copies_program, false, false, &y_plain, &n_plain, NULL);
+    compile_and_run_program(build_local_copies_program, true, false, &y_opt, &n_opt, &opt);
+
+    assert(y_plain == 15);
+    assert(y_opt == 15);
+    assert(n_opt < n_plain);
+    assert(opt->passes[OPT_PASS_COPY_PROP].changes >= 2);
+    assert(opt->passes[OPT_PASS_DEAD_STORE].changes == 3);
+    printf("✓ y = %d, instructions %u -> %u\n", y_opt, n_plain, n_opt);
+
+    optimizer_free(opt);
+}
+
+void test_optimizer_keeps_traps(void) {
+    printf("\n--- Test: Optimizer (no folding of trapping operations) ---\n");
+
+    Optimizer* opt = optimizer_create();
+    assert(opt != NULL);
+
+    // 1 / 0 和 INT 溢出保留到运行时报错
+    ASTNode* div = ast_create_binary_op(BINOP_DIV, opt_int_lit(1), opt_int_lit(0));
+    ASTNode* ovf = ast_create_binary_op(BINOP_MUL, opt_int_lit(65536), opt_int_lit(65536));
+    ASTNode* s1 = ast_create_assign(ast_create_identifier("a"), div);
+    s1->next = ast_create_assign(ast_create_identifier("b"), ovf);
+    ASTNode* program = ast_create_program("test", NULL, NULL, NULL, s1);
+
+    assert(optimizer_run_ast(opt, program) == OK);
+    assert(div->type == AST_BINARY_OP);
+    assert(ovf->type == AST_BINARY_OP);
+    assert(opt->passes[OPT_PASS_CONST_FOLD].changes == 0);
+    printf("✓ Division by zero and overflow left for runtime\n");
+
+    assert(optimizer_set_pass_enabled(opt, "peephole", false));
+    assert(!optimizer_set_pass_enabled(opt, "no-such-pass", false));
+
+    optimizer_free(opt);
+    ast_free_node(program);
+}
+
+// ============================================================================
+// 中间表示（--ir）
+// ============================================================================
+
+/**
+ * FUNCTION SumTo : INT
+ * VAR_INPUT n : INT; END_VAR
+ * VAR i : INT; acc : INT; END_VAR
+ *   acc := 0;
+ *   FOR i := 1 TO n DO
+ *     IF i MOD 2 = 0 THEN acc := acc + i; ELSE acc := acc - 1; END_IF
+ *   END_FOR
+ *   SumTo := acc;
+ * END_FUNCTION
+ * VAR y : INT; k : INT; END_VAR
+ * k := 3;
+ * WHILE k > 0 DO y := y + SumTo(k * 2 + 4); k := k - 1; END_WHILE
+ */
+static ASTNode* build_loops_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+
+    ASTNode* param = ast_create_var_decl("n", int_type, NULL, false, true);
+    ASTNode* i = ast_create_var_decl("i", int_type, NULL, false, false);
+    ASTNode* acc = ast_create_var_decl("acc", int_type, NULL, false, false);
+    i->next = acc;
+
+    ASTNode* even = ast_create_binary_op(BINOP_EQ,
+        ast_create_binary_op(BINOP_MOD, ast_create_identifier("i"), opt_int_lit(2)),
+        opt_int_lit(0));
+    ASTNode* add = ast_create_assign(ast_create_identifier("acc"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("acc"), ast_create_identifier("i")));
+    ASTNode* sub = ast_create_assign(ast_create_identifier("acc"),
+        ast_create_binary_op(BINOP_SUB, ast_create_identifier("acc"), opt_int_lit(1)));
+    ASTNode* loop = ast_create_for("i", opt_int_lit(1), ast_create_identifier("n"), NULL,
+                                   ast_create_if(even, add, sub));
+    ASTNode* f1 = ast_create_assign(ast_create_identifier("acc"), opt_int_lit(0));
+    f1->next = loop;
+    loop->next = ast_create_assign(ast_create_identifier("SumTo"), ast_create_identifier("acc"));
+    ASTNode* func = ast_create_function_decl("SumTo", param, int_type, i, f1);
+
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    y->next = ast_create_var_decl("k", int_type, NULL, false, true);
+
+    ASTNode** args = (ASTNode**)mmgr_alloc(sizeof(ASTNode*));
+    args[0] = ast_create_binary_op(BINOP_ADD,
+        ast_create_binary_op(BINOP_MUL, ast_create_identifier("k"), opt_int_lit(2)),
+        opt_int_lit(4));
+    ASTNode* w1 = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"),
+                             ast_create_function_call("SumTo", args, 1)));
+    w1->next = ast_create_assign(ast_create_identifier("k"),
+        ast_create_binary_op(BINOP_SUB, ast_create_identifier("k"), opt_int_lit(1)));
+    ASTNode* m1 = ast_create_assign(ast_create_identifier("k"), opt_int_lit(3));
+    m1->next = ast_create_while(
+        ast_create_binary_op(BINOP_GT, ast_create_identifier("k"), opt_int_lit(0)), w1);
+
+    type_info_free(int_type);
+    return ast_create_program("test", NULL, y, func, m1);
+}
+
+void test_ir_ssa_form(void) {
+    printf("\n--- Test: IR (basic blocks and SSA) ---\n");
+
+    ASTNode* program = build_loops_program();
+    SymbolTable* symtbl = symtbl_init();
+    TypeChecker checker;
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+
+    char msg[256];
+    IrModule* ir = NULL;
+    assert(ir_build(program, symtbl, msg, sizeof(msg), &ir) == OK);
+    assert(ir->function_count == 2);
+    assert(ir->functions[1]->is_main);
+
+    IrFunction* func = ir_module_find_function(ir, "SumTo");
+    assert(func != NULL && func->in_ssa);
+    assert(func->param_count == 1);
+
+    // FOR 用循环描述符：循环变量 i 和终值参数 n 留在内存中（i 只有入口处的零初始化
+    // STORE），其余变量提升后不再有 LOAD/STORE；循环头和 IF 汇合点有 acc 的 PHI
+    uint32_t phis = 0, for_terms = 0;
+    for (uint32_t b = 0; b < func->block_count; b++) {
+        const IrBlock* block = func->blocks[b];
+        assert(block->term != IR_TERM_NONE);
+        if (block->term == IR_TERM_FOR_INIT || block->term == IR_TERM_FOR_STEP) for_terms++;
+        for (uint32_t k = 0; k < block->instr_count; k++) {
+            const IrInstr* ins = &block->instrs[k];
+            if (ins->op == IR_STORE) {
+                assert(b == 0 && strcmp(ins->var.name, "i") == 0);
+            }
+            if (ins->op == IR_LOAD) {
+                assert(strcmp(ins->var.name, "i") == 0 || strcmp(ins->var.name, "n") == 0);
+            }
+            if (ins->op == IR_PHI) {
+                assert(ins->arg_count == block->pred_count);
+                assert(ir_dominates(func, (uint32_t)block->idom, b));
+                phis++;
+            }
+        }
+    }
+    assert(func->loop_count == 1 && for_terms == 2);
+    assert(phis >= 2);  // 循环头 acc，IF 汇合点 acc
+    printf("✓ %u blocks, %u phis in SumTo\n", func->block_count, phis);
+
+    // 主程序的全局变量仍是内存访问
+    const IrFunction* main_func = ir->functions[1];
+    bool has_store = false;
+    for (uint32_t b = 0; b < main_func->block_count; b++) {
+        for (uint32_t k = 0; k < main_func->blocks[b]->instr_count; k++) {
+            if (main_func->blocks[b]->instrs[k].op == IR_STORE) has_store = true;
+        }
+    }
+    assert(has_store);
+
+    ir_module_free(ir);
+    symtbl_free(symtbl);
+    ast_free_node(program);
+}
+
+void test_ir_lowering(void) {
+    printf("\n--- Test: IR (lowering matches stack codegen) ---\n");
+
+    int32_t y_stack, y_ir;
+    uint32_t n_stack, n_ir;
+    compile_and_run_program(build_loops_program, false, false, &y_stack, &n_stack, NULL);
+    compile_and_run_program(build_loops_program, false, true, &y_ir, &n_ir, NULL);
+    assert(y_ir == 50);
+    assert(y_stack == y_ir);
+    printf("✓ y = %d, instructions %u (stack) / %u (ir)\n", y_ir, n_stack, n_ir);
+
+    compile_and_run_program(build_local_copies_program, false, true, &y_ir, &n_ir, NULL);
+    assert(y_ir == 15);
+    compile_and_run_program(build_const_globals_program, false, true, &y_ir, &n_ir, NULL);
+    assert(y_ir == 21);
+
+    // IR 输出再经 -O 字节码优化仍然正确
+    compile_and_run_program(build_loops_program, true, true, &y_ir, &n_ir, NULL);
+    assert(y_ir == 50);
+    printf("✓ Function results and globals agree\n");
+}
+
+// ============================================================================
+// CASE 跳转表
+// ============================================================================
+
+static ASTNode* case_arm(ASTNode* labels, int32_t delta) {
+    ASTNode* body = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"), opt_int_lit(delta)));
+    return ast_create_case_element(labels, body);
+}
+
+/**
+ * VAR y : INT; k : INT; END_VAR
+ * FOR k := -2 TO 12 DO
+ *   CASE k * scale OF
+ *     0, 1:  y := y + 1;       (标签均乘以 scale)
+ *     2..4:  y := y + 10;
+ *     5, 7:  y := y + 100;
+ *     -2:    y := y + 1000;
+ *   ELSE     y := y - 1;
+ *   END_CASE
+ * END_FOR
+ * 结果 y = 1225
+ */
+static ASTNode* build_case_program_scaled(int32_t scale) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    y->next = ast_create_var_decl("k", int_type, NULL, false, true);
+
+    ASTNode* l0 = opt_int_lit(0);
+    l0->next = opt_int_lit(scale);
+    ASTNode* l5 = opt_int_lit(5 * scale);
+    l5->next = opt_int_lit(7 * scale);
+
+    ASTNode** arms = (ASTNode**)mmgr_alloc(sizeof(ASTNode*) * 4);
+    arms[0] = case_arm(l0, 1);
+    arms[1] = case_arm(ast_create_case_range(opt_int_lit(2 * scale), opt_int_lit(4 * scale)), 10);
+    arms[2] = case_arm(l5, 100);
+    arms[3] = case_arm(ast_create_unary_op(UNOP_NEG, opt_int_lit(2 * scale)), 1000);
+    ASTNode* otherwise = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_SUB, ast_create_identifier("y"), opt_int_lit(1)));
+
+    ASTNode* selector = ast_create_binary_op(BINOP_MUL, ast_create_identifier("k"), opt_int_lit(scale));
+    ASTNode* loop = ast_create_for("k", ast_create_unary_op(UNOP_NEG, opt_int_lit(2)), opt_int_lit(12),
+                                   NULL, ast_create_case(selector, arms, 4, otherwise));
+
+    type_info_free(int_type);
+    return ast_create_program("test", NULL, y, NULL, loop);
+}
+
+static ASTNode* build_dense_case_program(void) {
+    return build_case_program_scaled(1);
+}
+
+static ASTNode* build_sparse_case_program(void) {
+    return build_case_program_scaled(1000);
+}
+
+/**
+ * @brief 编译 CASE 程序，检查跳转表形式并验证保存/加载往返
+ */
+static void check_case_table(ASTNode* (*build)(void), SwitchKind expected) {
+    ASTNode* program = build();
+    SymbolTable* symtbl = symtbl_init();
+    TypeChecker checker;
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+
+    BytecodeModule* module = bytecode_module_create();
+    CodeGenContext* ctx = codegen_create(module, symtbl);
+    assert(codegen_generate(ctx, program) == OK);
+    codegen_free(ctx);
+
+    assert(module->switch_table_count == 1);
+    assert(module->switch_tables[0].kind == (uint32_t)expected);
+    bool has_switch = false;
+    for (uint32_t i = 0; i < module->instruction_count; i++) {
+        if (module->instructions[i].opcode == OP_SWITCH) has_switch = true;
+    }
+    assert(has_switch);
+
+    // 查找：命中区间、区间之间的空隙、超出范围都走正确目标
+    const SwitchTable* table = &module->switch_tables[0];
+    int32_t scale = (expected == SWITCH_DENSE) ? 1 : 1000;
+    uint32_t arm_2_4 = bytecode_switch_target(module, 0, 3 * scale);
+    assert(arm_2_4 == bytecode_switch_target(module, 0, 2 * scale));
+    assert(arm_2_4 == bytecode_switch_target(module, 0, 4 * scale));
+    assert(bytecode_switch_target(module, 0, 6 * scale) == table->default_target);
+    assert(bytecode_switch_target(module, 0, -1 * scale) == table->default_target);
+    assert(bytecode_switch_target(module, 0, 100 * scale) == table->default_target);
+    assert(bytecode_switch_target(module, 0, INT32_MIN) == table->default_target);
+    assert(bytecode_switch_target(module, 1, 0) == (uint32_t)-1);
+
+    assert(bytecode_save(module, "test.stbc") == OK);
+    BytecodeModule* loaded = bytecode_load("test.stbc");
+    assert(loaded != NULL);
+    assert(loaded->switch_table_count == module->switch_table_count);
+    assert(loaded->switch_case_count == module->switch_case_count);
+    assert(memcmp(loaded->switch_tables, module->switch_tables,
+                  sizeof(SwitchTable) * module->switch_table_count) == 0);
+    assert(memcmp(loaded->switch_cases, module->switch_cases,
+                  sizeof(SwitchCase) * module->switch_case_count) == 0);
+    printf("✓ %s table, %u entries, save/load round-trip\n",
+           expected == SWITCH_DENSE ? "dense" : "sorted", table->count);
+
+    bytecode_module_free(loaded);
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    ast_free_node(program);
+}
+
+void test_case_jump_tables(void) {
+    printf("\n--- Test: CASE jump tables ---\n");
+
+    check_case_table(build_dense_case_program, SWITCH_DENSE);
+    check_case_table(build_sparse_case_program, SWITCH_SORTED);
+
+    // 跳转表、-O 优化后的跳转表、IR 比较链三条路径结果一致
+    ASTNode* (*builds[2])(void) = { build_dense_case_program, build_sparse_case_program };
+    for (int i = 0; i < 2; i++) {
+        int32_t y;
+        uint32_t n;
+        compile_and_run_program(builds[i], false, false, &y, &n, NULL);
+        assert(y == 1225);
+        compile_and_run_program(builds[i], true, false, &y, &n, NULL);
+        assert(y == 1225);
+        compile_and_run_program(builds[i], false, true, &y, &n, NULL);
+        assert(y == 1225);
+    }
+    printf("✓ y = 1225 with tables, optimized tables and IR compare chains\n");
+}
+
+// ============================================================================
+// 短路逻辑运算
+// ============================================================================
+
+/**
+ * FUNCTION Bump : BOOL  calls := calls + 1; Bump := TRUE; END_FUNCTION
+ * VAR y : INT; calls : INT; k : INT; a : ARRAY[0..4] OF INT; flag : BOOL; END_VAR
+ * k := 100;
+ * IF k < 5 AND a[k] > 0 THEN y := 1; END_IF          右侧无副作用：短路，a[100] 不被访问
+ * IF flag AND_THEN Bump() THEN y := y + 10; END_IF    显式短路：Bump 不被调用
+ * IF flag AND Bump() THEN y := y + 100; END_IF        右侧有副作用：完整求值，calls = 1
+ * IF NOT flag OR_ELSE Bump() THEN y := y + 1000; END_IF
+ * y := y + calls * 10000;
+ * 结果 y = 11000
+ */
+static ASTNode* build_short_circuit_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    TypeInfo* bool_type = type_info_create(TYPE_BOOL);
+    int32_t sizes[1] = { 5 };
+    TypeInfo* array_type = type_info_create_array(int_type, 1, sizes);
+
+    ASTNode* bump_body = ast_create_assign(ast_create_identifier("calls"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("calls"), opt_int_lit(1)));
+    bump_body->next = ast_create_assign(ast_create_identifier("Bump"), opt_bool_lit(true));
+    ASTNode* func = ast_create_function_decl("Bump", NULL, bool_type, NULL, bump_body);
+
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    ASTNode* calls = ast_create_var_decl("calls", int_type, NULL, false, true);
+    ASTNode* k = ast_create_var_decl("k", int_type, NULL, false, true);
+    ASTNode* a = ast_create_var_decl("a", array_type, NULL, false, true);
+    ASTNode* flag = ast_create_var_decl("flag", bool_type, NULL, false, true);
+    y->next = calls;
+    calls->next = k;
+    k->next = a;
+    a->next = flag;
+
+    ASTNode* guard = ast_create_binary_op(BINOP_AND,
+        ast_create_binary_op(BINOP_LT, ast_create_identifier("k"), opt_int_lit(5)),
+        ast_create_binary_op(BINOP_GT,
+            ast_create_array_access(ast_create_identifier("a"), ast_create_identifier("k")),
+            opt_int_lit(0)));
+    BinaryOp ops[3] = { BINOP_AND_THEN, BINOP_AND, BINOP_OR_ELSE };
+    int32_t deltas[3] = { 10, 100, 1000 };
+
+    ASTNode* s1 = ast_create_assign(ast_create_identifier("k"), opt_int_lit(100));
+    ASTNode* tail = ast_create_if(guard, ast_create_assign(ast_create_identifier("y"), opt_int_lit(1)), NULL);
+    s1->next = tail;
+    for (int i = 0; i < 3; i++) {
+        ASTNode* left = ast_create_identifier("flag");
+        if (ops[i] == BINOP_OR_ELSE) left = ast_create_unary_op(UNOP_NOT, left);
+        ASTNode* cond = ast_create_binary_op(ops[i], left, ast_create_function_call("Bump", NULL, 0));
+        ASTNode* then = ast_create_assign(ast_create_identifier("y"),
+            ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"), opt_int_lit(deltas[i])));
+        tail->next = ast_create_if(cond, then, NULL);
+        tail = tail->next;
+    }
+    tail->next = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"),
+            ast_create_binary_op(BINOP_MUL, ast_create_identifier("calls"), opt_int_lit(10000))));
+
+    type_info_free(array_type);
+    type_info_free(int_type);
+    type_info_free(bool_type);
+    return ast_create_program("test", NULL, y, func, s1);
+}
+
+void test_short_circuit(void) {
+    printf("\n--- Test: Short-circuit AND/OR, AND_THEN/OR_ELSE ---\n");
+
+    int32_t y;
+    uint32_t n;
+    compile_and_run_program(build_short_circuit_program, false, false, &y, &n, NULL);
+    assert(y == 11000);
+    compile_and_run_program(build_short_circuit_program, true, false, &y, &n, NULL);
+    assert(y == 11000);
+    compile_and_run_program(build_short_circuit_program, false, true, &y, &n, NULL);
+    assert(y == 11000);
+    compile_and_run_program(build_short_circuit_program, true, true, &y, &n, NULL);
+    assert(y == 11000);
+    printf("✓ Guarded array access skipped, side-effecting AND evaluated, y = %d\n", y);
+}
+
+// ============================================================================
+// FOR 循环
+// ============================================================================
+
+/**
+ * VAR y : INT; i : INT; j : INT; n : INT; END_VAR
+ * n := 4;
+ * FOR i := 1 TO 10 DO y := y + i; END_FOR                  10 次
+ * FOR i := 10 TO 1 BY -3 DO y := y + i * 100; END_FOR      10, 7, 4, 1
+ * FOR j := 0 TO n DO y := y + 10000; END_FOR               终值为变量，5 次
+ * FOR i := 5 TO 1 DO y := y + 1000000; END_FOR             不进入
+ * 结果 y = 55 + 2200 + 50000 = 52255
+ */
+static ASTNode* build_for_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    const char* names[4] = { "y", "i", "j", "n" };
+    ASTNode* decls = NULL;
+    for (int k = 3; k >= 0; k--) {
+        ASTNode* decl = ast_create_var_decl(names[k], int_type, NULL, false, true);
+        decl->next = decls;
+        decls = decl;
+    }
+    type_info_free(int_type);
+
+    const char* vars[4] = { "i", "i", "j", "i" };
+    int32_t starts[4] = { 1, 10, 0, 5 };
+    int32_t scales[4] = { 1, 100, 0, 0 };
+    int32_t adds[4] = { 0, 0, 10000, 1000000 };
+
+    ASTNode* body = ast_create_assign(ast_create_identifier("n"), opt_int_lit(4));
+    ASTNode* tail = body;
+    for (int k = 0; k < 4; k++) {
+        ASTNode* delta;
+        if (scales[k] == 1) {
+            delta = ast_create_identifier(vars[k]);
+        } else if (scales[k]) {
+            delta = ast_create_binary_op(BINOP_MUL, ast_create_identifier(vars[k]), opt_int_lit(scales[k]));
+        } else {
+            delta = opt_int_lit(adds[k]);
+        }
+        ASTNode* stmt = ast_create_assign(ast_create_identifier("y"),
+            ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"), delta));
+        ASTNode* end = k == 2 ? ast_create_identifier("n") : opt_int_lit(k == 0 ? 10 : 1);
+        ASTNode* step = k == 1 ? ast_create_unary_op(UNOP_NEG, opt_int_lit(3)) : NULL;
+        tail->next = ast_create_for(vars[k], opt_int_lit(starts[k]), end, step, stmt);
+        tail = tail->next;
+    }
+    return ast_create_program("test", NULL, decls, NULL, body);
+}
+
+/**
+ * VAR y : INT; i : INT; END_VAR
+ * FOR i := 1 TO 10 DO IF i = 3 THEN i := 8; END_IF; y := y + i; END_FOR
+ * 结果 y = 1 + 2 + 8 + 9 + 10 = 30
+ */
+static ASTNode* build_for_var_written_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    y->next = ast_create_var_decl("i", int_type, NULL, false, true);
+    type_info_free(int_type);
+
+    ASTNode* jump = ast_create_if(
+        ast_create_binary_op(BINOP_EQ, ast_create_identifier("i"), opt_int_lit(3)),
+        ast_create_assign(ast_create_identifier("i"), opt_int_lit(8)), NULL);
+    jump->next = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"), ast_create_identifier("i")));
+    ASTNode* body = ast_create_for("i", opt_int_lit(1), opt_int_lit(10), NULL, jump);
+    return ast_create_program("test", NULL, y, NULL, body);
+}
+
+void test_for_loops(void) {
+    printf("\n--- Test: Fused FOR loops ---\n");
+
+    ASTNode* program = build_for_program();
+    SymbolTable* symtbl = symtbl_init();
+    TypeChecker checker;
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+
+    BytecodeModule* module = bytecode_module_create();
+    CodeGenContext* ctx = codegen_create(module, symtbl);
+    assert(codegen_generate(ctx, program) == OK);
+    codegen_free(ctx);
+
+    // 四个循环都使用 FOR_INIT/FOR_STEP，没有比较和回跳
+    uint32_t inits = 0, steps = 0;
+    for (uint32_t i = 0; i < module->instruction_count; i++) {
+        Opcode op = module->instructions[i].opcode;
+        if (op == OP_FOR_INIT) inits++;
+        if (op == OP_FOR_STEP) steps++;
+        assert(op != OP_LE && op != OP_GE && op != OP_JZ);
+    }
+    assert(inits == 4 && steps == 4);
+    assert(module->for_loop_count == 4);
+
+    // 常量边界的迭代次数在编译期已知
+    uint32_t trips;
+    assert(bytecode_for_loop_trip_count(module, 0, &trips) && trips == 10);
+    assert(bytecode_for_loop_trip_count(module, 1, &trips) && trips == 4);
+    assert(!bytecode_for_loop_trip_count(module, 2, &trips));
+    assert(module->for_loops[2].flags & FOR_LOOP_END_VAR);
+    assert(bytecode_for_loop_trip_count(module, 3, &trips) && trips == 0);
+
+    // WCET：常量循环由描述符得到边界，终值为变量的循环仍需标注或默认边界
+    WcetConfig cfg;
+    wcet_config_init(&cfg);
+    WcetResult result;
+    WcetAnalyzer* analyzer = wcet_analyzer_create(module, &cfg);
+    assert(wcet_analyze(analyzer, NULL, &result) == ERR_RUNTIME);
+    assert(strstr(result.error_msg, "Unbounded loop") != NULL);
+    wcet_analyzer_free(analyzer);
+    cfg.default_loop_bound = 1;
+    analyzer = wcet_analyzer_create(module, &cfg);
+    assert(wcet_analyze(analyzer, NULL, &result) == OK);
+    assert(result.analysis_complete);
+    assert(result.analyzed_loops == 4);
+    assert(result.max_loop_iterations == 10);
+    wcet_analyzer_free(analyzer);
+
+    assert(bytecode_save(module, "test.stbc") == OK);
+    BytecodeModule* loaded = bytecode_load("test.stbc");
+    assert(loaded != NULL);
+    assert(loaded->for_loop_count == module->for_loop_count);
+    assert(memcmp(loaded->for_loops, module->for_loops,
+                  sizeof(ForLoop) * module->for_loop_count) == 0);
+    bytecode_module_free(loaded);
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    ast_free_node(program);
+    printf("✓ 4 fused loops, trip counts 10/4/?/0, WCET bound from descriptors, save/load round-trip\n");
+
+    // 融合循环、-O、IR 比较循环结果一致
+    int32_t y;
+    uint32_t n;
+    compile_and_run_program(build_for_program, false, false, &y, &n, NULL);
+    assert(y == 52255);
+    compile_and_run_program(build_for_program, true, false, &y, &n, NULL);
+    assert(y == 52255);
+    compile_and_run_program(build_for_program, false, true, &y, &n, NULL);
+    assert(y == 52255);
+    printf("✓ y = %d with fused loops, optimizer and IR\n", y);
+
+    // 循环体给循环变量赋值：不融合，结果与比较循环一致
+    for (int variant = 0; variant < 4; variant++) {
+        compile_and_run_program(build_for_var_written_program, (variant & 1) != 0, (variant & 2) != 0,
+                                &y, &n, NULL);
+        assert(y == 30);
+    }
+    program = build_for_var_written_program();
+    symtbl = symtbl_init();
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+    module = bytecode_module_create();
+    ctx = codegen_create(module, symtbl);
+    assert(codegen_generate(ctx, program) == OK);
+    codegen_free(ctx);
+    assert(module->for_loop_count == 0);
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    ast_free_node(program);
+
+    // 描述符常量边界 1..10，但循环体改写循环变量：不给出次数，WCET 退回默认边界
+    module = bytecode_module_create();
+    uint16_t k1 = (uint16_t)bytecode_add_int_constant(module, 1);
+    module->global_count = 1;
+    ForLoop loop = { .var = 0, .flags = FOR_LOOP_VAR_GLOBAL | FOR_LOOP_CONST_START,
+                     .start = 1, .end = 10, .step = 1, .body = 2, .exit = 5 };
+    assert(bytecode_add_for_loop(module, &loop) == 0);
+    bytecode_add_instruction(module, OP_PUSH, 0, k1);
+    bytecode_add_instruction(module, OP_FOR_INIT, 0, 0);
+    bytecode_add_instruction(module, OP_PUSH, 0, k1);
+    bytecode_add_instruction(module, OP_STORE, FLAG_GLOBAL, 0);
+    bytecode_add_instruction(module, OP_FOR_STEP, 0, 0);
+    bytecode_add_instruction(module, OP_HALT, 0, 0);
+    assert(bytecode_for_loop_writes_var(module, 0));
+    assert(!bytecode_for_loop_trip_count(module, 0, &trips));
+    wcet_config_init(&cfg);
+    cfg.default_loop_bound = 7;
+    analyzer = wcet_analyzer_create(module, &cfg);
+    assert(wcet_analyze(analyzer, NULL, &result) == OK);
+    assert(result.analyzed_loops == 1 && result.max_loop_iterations == 7);
+    wcet_analyzer_free(analyzer);
+
+    // 去掉体内的写入后由描述符得到 10 次
+    module->instructions[3].flags = 0;
+    assert(!bytecode_for_loop_writes_var(module, 0));
+    assert(bytecode_for_loop_trip_count(module, 0, &trips) && trips == 10);
+    bytecode_module_free(module);
+    printf("✓ Loop variable written in body: not fused, no descriptor trip count, default WCET bound\n");
+}
+
+// ============================================================================
+// 函数内联
+// ============================================================================
+
+/**
+ * FUNCTION Clamp : INT                                      第 2 行起
+ * VAR_INPUT v : INT; lo : INT; hi : INT; END_VAR
+ *   Clamp := v;
+ *   IF v < lo THEN Clamp := lo; RETURN; END_IF
+ *   IF v > hi THEN Clamp := hi; END_IF
+ * END_FUNCTION
+ * FUNCTION Weigh : INT                                      第 10 行起
+ * VAR_INPUT x : INT; END_VAR
+ * VAR t : INT; END_VAR
+ *   t := Clamp(x * 3, 0, 20);
+ *   Weigh := t + Clamp(x, 2, 4);
+ * END_FUNCTION
+ * VAR y : INT; k : INT; END_VAR                             第 20 行起
+ * k := 0;
+ * WHILE k < 10 DO y := y + Weigh(k) + Clamp(k - 5, -1, 1); k := k + 1; END_WHILE
+ * 结果 y = 123 + 33 - 1 = 155
+ */
+static ASTNode* clamp_call(ASTNode* v, int32_t lo, int32_t hi) {
+    ASTNode** args = (ASTNode**)mmgr_alloc(sizeof(ASTNode*) * 3);
+    args[0] = v;
+    args[1] = opt_int_lit(lo);
+    args[2] = opt_int_lit(hi);
+    return ast_create_function_call("Clamp", args, 3);
+}
+
+static ASTNode* build_inline_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+
+    ASTNode* v = ast_create_var_decl("v", int_type, NULL, false, true);
+    v->next = ast_create_var_decl("lo", int_type, NULL, false, true);
+    v->next->next = ast_create_var_decl("hi", int_type, NULL, false, true);
+    ASTNode* c1 = ast_create_assign(ast_create_identifier("Clamp"), ast_create_identifier("v"));
+    ASTNode* low = ast_create_assign(ast_create_identifier("Clamp"), ast_create_identifier("lo"));
+    low->next = ast_create_return(NULL);
+    c1->next = ast_create_if(
+        ast_create_binary_op(BINOP_LT, ast_create_identifier("v"), ast_create_identifier("lo")), low, NULL);
+    c1->next->next = ast_create_if(
+        ast_create_binary_op(BINOP_GT, ast_create_identifier("v"), ast_create_identifier("hi")),
+        ast_create_assign(ast_create_identifier("Clamp"), ast_create_identifier("hi")), NULL);
+    ast_set_location(c1, "test.st", 4, 1);
+    ast_set_location(c1->next, "test.st", 5, 1);
+    ast_set_location(low, "test.st", 5, 20);
+    ast_set_location(low->next, "test.st", 5, 34);
+    ast_set_location(c1->next->next, "test.st", 6, 1);
+    ast_set_location(c1->next->next->data.if_stmt.then_branch, "test.st", 6, 20);
+    ASTNode* clamp = ast_create_function_decl("Clamp", v, int_type, NULL, c1);
+
+    ASTNode* x = ast_create_var_decl("x", int_type, NULL, false, true);
+    ASTNode* t = ast_create_var_decl("t", int_type, NULL, false, false);
+    ASTNode* w1 = ast_create_assign(ast_create_identifier("t"),
+        clamp_call(ast_create_binary_op(BINOP_MUL, ast_create_identifier("x"), opt_int_lit(3)), 0, 20));
+    w1->next = ast_create_assign(ast_create_identifier("Weigh"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("t"), clamp_call(ast_create_identifier("x"), 2, 4)));
+    ast_set_location(w1, "test.st", 13, 1);
+    ast_set_location(w1->next, "test.st", 14, 1);
+    clamp->next = ast_create_function_decl("Weigh", x, int_type, t, w1);
+
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    y->next = ast_create_var_decl("k", int_type, NULL, false, true);
+    ASTNode** args = (ASTNode**)mmgr_alloc(sizeof(ASTNode*));
+    args[0] = ast_create_identifier("k");
+    ASTNode* sum = ast_create_binary_op(BINOP_ADD,
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"), ast_create_function_call("Weigh", args, 1)),
+        clamp_call(ast_create_binary_op(BINOP_SUB, ast_create_identifier("k"), opt_int_lit(5)), -1, 1));
+    ASTNode* b1 = ast_create_assign(ast_create_identifier("y"), sum);
+    b1->next = ast_create_assign(ast_create_identifier("k"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("k"), opt_int_lit(1)));
+    ASTNode* m1 = ast_create_assign(ast_create_identifier("k"), opt_int_lit(0));
+    m1->next = ast_create_while(
+        ast_create_binary_op(BINOP_LT, ast_create_identifier("k"), opt_int_lit(10)), b1);
+    ast_set_location(m1, "test.st", 21, 1);
+    ast_set_location(m1->next, "test.st", 22, 1);
+    ast_set_location(b1, "test.st", 22, 17);
+    ast_set_location(b1->next, "test.st", 22, 60);
+
+    type_info_free(int_type);
+    return ast_create_program("test", NULL, y, clamp, m1);
+}
+
+void test_function_inlining(void) {
+    printf("\n--- Test: Function inlining ---\n");
+
+    ASTNode* program = build_inline_program();
+    SymbolTable* symtbl = symtbl_init();
+    TypeChecker checker;
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+
+    Optimizer* opt = optimizer_create();
+    assert(opt != NULL);
+    assert(optimizer_run_ast(opt, program) == OK);
+    BytecodeModule* module = bytecode_module_create();
+    CodeGenContext* ctx = codegen_create(module, symtbl);
+    assert(codegen_generate(ctx, program) == OK);
+    codegen_free(ctx);
+    assert(optimizer_run_bytecode(opt, module) == OK);
+
+    // 第一轮展开 Clamp 的三个调用点，Weigh 随之成为叶子函数，第二轮展开
+    assert(opt->passes[OPT_PASS_INLINE].changes == 4);
+    for (uint32_t i = 0; i < module->instruction_count; i++) {
+        assert(module->instructions[i].opcode != OP_CALL);
+    }
+
+    // 被调函数的帧槽位成为调试器可见的隐藏全局变量
+    bool has_param = false, has_result = false;
+    for (uint32_t i = 0; i < module->global_count; i++) {
+        const char* name = module->globals_info[i].name;
+        if (name && strcmp(name, "Clamp.$0") == 0) has_param = true;
+        if (name && strcmp(name, "Clamp.$3") == 0) has_result = true;
+    }
+    assert(has_param && has_result);
+
+    // 内联副本沿用被调函数的行号
+    FunctionEntry* clamp = bytecode_find_function(module, "Clamp");
+    FunctionEntry* weigh = bytecode_find_function(module, "Weigh");
+    assert(clamp && weigh);
+    uint32_t copies = 0;
+    for (uint32_t pc = weigh->address + 1; pc < module->instruction_count; pc++) {
+        if (bytecode_line_for_pc(module, pc) == 5 &&
+            (pc == 0 || bytecode_line_for_pc(module, pc - 1) != 5)) {
+            copies++;
+        }
+    }
+    assert(copies >= 3);
+
+    VM* vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == OK);
+    vm_free(vm);
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    optimizer_free(opt);
+    ast_free_node(program);
+    printf("✓ 4 call sites inlined over 2 rounds, no CALL left, hidden slots and line info kept\n");
+
+    // 不优化、-O、IR 结果一致
+    int32_t y;
+    uint32_t n;
+    compile_and_run_program(build_inline_program, false, false, &y, &n, NULL);
+    assert(y == 155);
+    compile_and_run_program(build_inline_program, true, false, &y, &n, NULL);
+    assert(y == 155);
+    compile_and_run_program(build_inline_program, true, true, &y, &n, NULL);
+    assert(y == 155);
+    printf("✓ y = %d without optimization, with -O and with -O --ir\n", y);
+}
+
+/**
+ * @brief 按 `stvm -c` 的步骤编译并保存，作为库加载后按导出符号索引解析函数
+ */
+void test_compiled_library(void) {
+    printf("\n--- Test: Compiled module as library ---\n");
+
+    ASTNode* program = build_inline_program();
+    SymbolTable* symtbl = symtbl_init();
+    TypeChecker checker;
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+    BytecodeModule* module = bytecode_module_create();
+    CodeGenContext* ctx = codegen_create(module, symtbl);
+    assert(codegen_generate(ctx, program) == OK);
+    codegen_free(ctx);
+    assert(bytecode_save(module, "test_cg_lib.stbc") == OK);
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    ast_free_node(program);
+
+    SymbolTable* global_symtbl = symtbl_init();
+    LibraryManager* mgr = libmgr_create(global_symtbl);
+    assert(libmgr_load_library(mgr, "test_cg_lib.stbc") == OK);
+    LoadedLibrary* lib = libmgr_find_library(mgr, "test_cg_lib");
+    assert(lib != NULL && lib->module->symbol_index != NULL);
+    assert(bytecode_lookup_symbol(lib->module, "Weigh") != NULL);
+    Symbol* sym = libmgr_resolve_symbol(mgr, "test_cg_lib.Clamp");
+    assert(sym != NULL && sym->kind == SYM_FUNCTION && sym->param_count == 3);
+    assert(libmgr_resolve_symbol(mgr, "test_cg_lib.Missing") == NULL);
+    libmgr_free(mgr);
+    symtbl_free(global_symtbl);
+    remove("test_cg_lib.stbc");
+    printf("✓ Compiled output carries a symbol index and resolves as a library\n");
+}
+
+// ============================================================================
+// 公共子表达式消除与循环不变量外提（IR）
+// ============================================================================
+
+/**
+ * FUNCTION Mix : INT
+ * VAR_INPUT a : INT; b : INT; n : INT; END_VAR
+ * VAR i : INT; s : INT; END_VAR
+ *   FOR i := 1 TO n * 2 DO                    n * 2 从循环头外提
+ *     s := s + (a * b + i) + (a * b - i);     第二个 a * b 被消除
+ *     IF a > b THEN s := s + 1; END_IF        a > b 外提到前置块
+ *   END_FOR
+ *   Mix := s;
+ * END_FUNCTION
+ * FUNCTION Tick : INT                         写全局变量，不是纯函数
+ *   count := count + 1; Tick := count;
+ * END_FUNCTION
+ * VAR y : INT; count : INT; END_VAR
+ * y := Mix(3, 2, 3) + Tick() + Mix(3, 2, 3) + Tick();
+ * 结果 y = 78 + 1 + 78 + 2 = 159
+ */
+static ASTNode* build_cse_licm_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+
+    ASTNode* a = ast_create_var_decl("a", int_type, NULL, false, true);
+    a->next = ast_create_var_decl("b", int_type, NULL, false, true);
+    a->next->next = ast_create_var_decl("n", int_type, NULL, false, true);
+    ASTNode* i = ast_create_var_decl("i", int_type, NULL, false, false);
+    i->next = ast_create_var_decl("s", int_type, NULL, false, false);
+
+    ASTNode* ab1 = ast_create_binary_op(BINOP_MUL, ast_create_identifier("a"), ast_create_identifier("b"));
+    ASTNode* ab2 = ast_create_binary_op(BINOP_MUL, ast_create_identifier("a"), ast_create_identifier("b"));
+    ASTNode* sum = ast_create_binary_op(BINOP_ADD,
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("s"),
+            ast_create_binary_op(BINOP_ADD, ab1, ast_create_identifier("i"))),
+        ast_create_binary_op(BINOP_SUB, ab2, ast_create_identifier("i")));
+    ASTNode* body = ast_create_assign(ast_create_identifier("s"), sum);
+    body->next = ast_create_if(
+        ast_create_binary_op(BINOP_GT, ast_create_identifier("a"), ast_create_identifier("b")),
+        ast_create_assign(ast_create_identifier("s"),
+            ast_create_binary_op(BINOP_ADD, ast_create_identifier("s"), opt_int_lit(1))),
+        NULL);
+    ASTNode* loop = ast_create_for("i", opt_int_lit(1),
+        ast_create_binary_op(BINOP_MUL, ast_create_identifier("n"), opt_int_lit(2)), NULL, body);
+    loop->next = ast_create_assign(ast_create_identifier("Mix"), ast_create_identifier("s"));
+    ASTNode* mix = ast_create_function_decl("Mix", a, int_type, i, loop);
+
+    ASTNode* tick_body = ast_create_assign(ast_create_identifier("count"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("count"), opt_int_lit(1)));
+    tick_body->next = ast_create_assign(ast_create_identifier("Tick"), ast_create_identifier("count"));
+    mix->next = ast_create_function_decl("Tick", NULL, int_type, NULL, tick_body);
+
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    y->next = ast_create_var_decl("count", int_type, NULL, false, true);
+    ASTNode* total = NULL;
+    for (int k = 0; k < 4; k++) {
+        ASTNode* call;
+        if (k % 2 == 0) {
+            ASTNode** args = (ASTNode**)mmgr_alloc(sizeof(ASTNode*) * 3);
+            args[0] = opt_int_lit(3);
+            args[1] = opt_int_lit(2);
+            args[2] = opt_int_lit(3);
+            call = ast_create_function_call("Mix", args, 3);
+        } else {
+            call = ast_create_function_call("Tick", NULL, 0);
+        }
+        total = total ? ast_create_binary_op(BINOP_ADD, total, call) : call;
+    }
+    ASTNode* main_body = ast_create_assign(ast_create_identifier("y"), total);
+
+    type_info_free(int_type);
+    return ast_create_program("test", NULL, y, mix, main_body);
+}
+
+/**
+ * FUNCTION Scan : INT
+ * VAR_INPUT last : INT; div : INT; END_VAR
+ * VAR ch : INT; i : INT; s : INT; END_VAR
+ *   FOR ch := 0 TO 3 DO
+ *     FOR i := 0 TO last DO                   终值为变量：循环可能一次也不执行
+ *       s := s + 64 / div + sensor[ch * 8 + i] * sensor[ch * 8 + i];
+ *     END_FOR                                 第二次读取 sensor 被消除，ch * 8 外提；
+ *   END_FOR                                   64 / div 可能出错，外提后只在进入循环时执行
+ *   Scan := s;
+ * END_FUNCTION
+ * VAR y : INT; k : INT; sensor : ARRAY[0..31] OF INT; END_VAR
+ * FOR k := 0 TO 31 DO sensor[k] := k; END_FOR
+ * y := Scan(7, 2) + Scan(-1, 0);
+ * 结果 y = (0² + … + 31²) + 32 * 32 + 0 = 10416 + 1024 = 11440
+ */
+static ASTNode* build_sensor_scan_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    int32_t sizes[1] = { 32 };
+    TypeInfo* array_type = type_info_create_array(int_type, 1, sizes);
+
+    ASTNode* params = ast_create_var_decl("last", int_type, NULL, false, true);
+    params->next = ast_create_var_decl("div", int_type, NULL, false, true);
+    ASTNode* locals = ast_create_var_decl("ch", int_type, NULL, false, false);
+    locals->next = ast_create_var_decl("i", int_type, NULL, false, false);
+    locals->next->next = ast_create_var_decl("s", int_type, NULL, false, false);
+
+    ASTNode* reads[2];
+    for (int r = 0; r < 2; r++) {
+        reads[r] = ast_create_array_access(ast_create_identifier("sensor"),
+            ast_create_binary_op(BINOP_ADD,
+                ast_create_binary_op(BINOP_MUL, ast_create_identifier("ch"), opt_int_lit(8)),
+                ast_create_identifier("i")));
+    }
+    ASTNode* body = ast_create_assign(ast_create_identifier("s"),
+        ast_create_binary_op(BINOP_ADD,
+            ast_create_binary_op(BINOP_ADD, ast_create_identifier("s"),
+                ast_create_binary_op(BINOP_DIV, opt_int_lit(64), ast_create_identifier("div"))),
+            ast_create_binary_op(BINOP_MUL, reads[0], reads[1])));
+    ASTNode* inner = ast_create_for("i", opt_int_lit(0), ast_create_identifier("last"), NULL, body);
+    ASTNode* outer = ast_create_for("ch", opt_int_lit(0), opt_int_lit(3), NULL, inner);
+    outer->next = ast_create_assign(ast_create_identifier("Scan"), ast_create_identifier("s"));
+    ASTNode* scan = ast_create_function_decl("Scan", params, int_type, locals, outer);
+
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    y->next = ast_create_var_decl("k", int_type, NULL, false, true);
+    y->next->next = ast_create_var_decl("sensor", array_type, NULL, false, true);
+
+    ASTNode* fill = ast_create_assign(
+        ast_create_array_access(ast_create_identifier("sensor"), ast_create_identifier("k")),
+        ast_create_identifier("k"));
+    ASTNode* main_body = ast_create_for("k", opt_int_lit(0), opt_int_lit(31), NULL, fill);
+    ASTNode* calls[2];
+    for (int c = 0; c < 2; c++) {
+        ASTNode** args = (ASTNode**)mmgr_alloc(sizeof(ASTNode*) * 2);
+        args[0] = opt_int_lit(c == 0 ? 7 : -1);
+        args[1] = opt_int_lit(c == 0 ? 2 : 0);
+        calls[c] = ast_create_function_call("Scan", args, 2);
+    }
+    main_body->next = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_ADD, calls[0], calls[1]));
+
+    type_info_free(array_type);
+    type_info_free(int_type);
+    return ast_create_program("test", NULL, y, scan, main_body);
+}
+
+void test_cse_licm(void) {
+    printf("\n--- Test: CSE and loop-invariant code motion ---\n");
+
+    // 外部函数的副作用：内置函数查表，未知函数按有副作用处理
+    Optimizer* opt = optimizer_create();
+    assert(opt != NULL);
+    assert(optimizer_call_effects(opt, "ToReal") == OPT_EFFECT_NONE);
+    assert(optimizer_call_effects(opt, "SetQuality") == OPT_EFFECT_NONE);
+    assert(optimizer_call_effects(opt, "PRINT") & OPT_EFFECT_UNKNOWN);
+    assert(optimizer_call_effects(opt, "NoSuchHostFunction") & OPT_EFFECT_UNKNOWN);
+    assert(optimizer_call_effects(opt, "lib.stbc.F") & OPT_EFFECT_UNKNOWN);
+    optimizer_free(opt);
+    printf("✓ Builtin effect table, unknown externals are impure\n");
+
+    int32_t y;
+    uint32_t n;
+    compile_and_run_program(build_cse_licm_program, false, false, &y, &n, NULL);
+    assert(y == 159);
+    compile_and_run_program(build_cse_licm_program, false, true, &y, &n, NULL);
+    assert(y == 159);
+
+    // -O 默认经中间表示生成：a * b 与纯函数 Mix 的第二次调用被消除，Tick 仍调用两次；
+    // n * 2 和 a > b 外提
+    compile_and_run_program(build_cse_licm_program, true, false, &y, &n, &opt);
+    assert(y == 159);
+    assert(opt->passes[OPT_PASS_CSE].changes >= 2);
+    assert(opt->passes[OPT_PASS_LICM].changes >= 2);
+    printf("✓ y = %d, cse: %u, licm: %u\n", y,
+           opt->passes[OPT_PASS_CSE].changes, opt->passes[OPT_PASS_LICM].changes);
+    optimizer_free(opt);
+
+    // 数组读取的块内消除、内层循环的外提与进入判断：Scan(-1, 0) 不执行 64 / 0
+    compile_and_run_program(build_sensor_scan_program, false, false, &y, &n, NULL);
+    assert(y == 11440);
+    compile_and_run_program(build_sensor_scan_program, false, true, &y, &n, NULL);
+    assert(y == 11440);
+    compile_and_run_program(build_sensor_scan_program, true, false, &y, &n, &opt);
+    assert(y == 11440);
+    assert(opt->passes[OPT_PASS_CSE].changes >= 2);
+    assert(opt->passes[OPT_PASS_LICM].changes >= 3);
+    optimizer_free(opt);
+    printf("✓ y = %d with sensor[ch * 8 + i] read once per iteration\n", y);
+}
+
+// ============================================================================
+// 寄存器格式后端（--regvm）
+// ============================================================================
+
+// ============================================================================
+// 数组边界检查
+// ============================================================================
+
+/**
+ * VAR y : INT; i : INT; k : INT; a : ARRAY[0..9] OF INT; END_VAR
+ * k := 10;
+ * FOR i := 0 TO 9 DO a[i] := i * 2; END_FOR                下标区间 [0, 9]：免检
+ * FOR i := 0 TO 9 DO y := y + a[9 - i]; END_FOR            下标区间 [0, 9]：免检
+ * y := y + a[k - 1];                                       下标为变量：运行时检查
+ * （overrun 时最后一句为 y := a[k]，越界报错）
+ * 结果 y = 90 + 18 = 108
+ */
+static ASTNode* build_array_program_ex(bool overrun) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    int32_t sizes[1] = { 10 };
+    TypeInfo* array_type = type_info_create_array(int_type, 1, sizes);
+
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    ASTNode* i = ast_create_var_decl("i", int_type, NULL, false, true);
+    ASTNode* k = ast_create_var_decl("k", int_type, NULL, false, true);
+    ASTNode* a = ast_create_var_decl("a", array_type, NULL, false, true);
+    y->next = i;
+    i->next = k;
+    k->next = a;
+
+    ASTNode* fill = ast_create_assign(
+        ast_create_array_access(ast_create_identifier("a"), ast_create_identifier("i")),
+        ast_create_binary_op(BINOP_MUL, ast_create_identifier("i"), opt_int_lit(2)));
+    ASTNode* sum = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"),
+            ast_create_array_access(ast_create_identifier("a"),
+                ast_create_binary_op(BINOP_SUB, opt_int_lit(9), ast_create_identifier("i")))));
+    ASTNode* index = overrun ? ast_create_identifier("k")
+        : ast_create_binary_op(BINOP_SUB, ast_create_identifier("k"), opt_int_lit(1));
+    ASTNode* tail = ast_create_array_access(ast_create_identifier("a"), index);
+    if (!overrun) {
+        tail = ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"), tail);
+    }
+
+    ASTNode* body = ast_create_assign(ast_create_identifier("k"), opt_int_lit(10));
+    body->next = ast_create_for("i", opt_int_lit(0), opt_int_lit(9), NULL, fill);
+    body->next->next = ast_create_for("i", opt_int_lit(0), opt_int_lit(9), NULL, sum);
+    body->next->next->next = ast_create_assign(ast_create_identifier("y"), tail);
+
+    type_info_free(array_type);
+    type_info_free(int_type);
+    return ast_create_program("test", NULL, y, NULL, body);
+}
+
+static ASTNode* build_array_program(void) {
+    return build_array_program_ex(false);
+}
+
+static ASTNode* build_array_overrun_program(void) {
+    return build_array_program_ex(true);
+}
+
+/**
+ * VAR y : INT; i : INT; k : INT; a : ARRAY[1..10] OF INT; END_VAR
+ * k := 1;
+ * FOR i := 1 TO 10 DO a[i] := i; END_FOR                   下标区间 [1, 10]：免检
+ * y := a[10] + a[k];                                       常量下标直接寻址，变量下标运行时检查
+ * （overrun 时 k := 0，越界报错）
+ * 结果 y = 10 + 1 = 11
+ */
+static ASTNode* build_lower_array_program_ex(bool overrun) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    int32_t sizes[1] = { 10 };
+    TypeInfo* array_type = type_info_create_array(int_type, 1, sizes);
+    array_type->array_info.lower = 1;
+
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    ASTNode* i = ast_create_var_decl("i", int_type, NULL, false, true);
+    ASTNode* k = ast_create_var_decl("k", int_type, NULL, false, true);
+    ASTNode* a = ast_create_var_decl("a", array_type, NULL, false, true);
+    y->next = i;
+    i->next = k;
+    k->next = a;
+
+    ASTNode* fill = ast_create_assign(
+        ast_create_array_access(ast_create_identifier("a"), ast_create_identifier("i")),
+        ast_create_identifier("i"));
+    ASTNode* body = ast_create_assign(ast_create_identifier("k"), opt_int_lit(overrun ? 0 : 1));
+    body->next = ast_create_for("i", opt_int_lit(1), opt_int_lit(10), NULL, fill);
+    body->next->next = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_ADD,
+            ast_create_array_access(ast_create_identifier("a"), opt_int_lit(10)),
+            ast_create_array_access(ast_create_identifier("a"), ast_create_identifier("k"))));
+
+    type_info_free(array_type);
+    type_info_free(int_type);
+    return ast_create_program("test", NULL, y, NULL, body);
+}
+
+static ASTNode* build_lower_array_program(void) {
+    return build_lower_array_program_ex(false);
+}
+
+static ASTNode* build_lower_array_overrun_program(void) {
+    return build_lower_array_program_ex(true);
+}
+
+/**
+ * @brief 生成模块并统计免检/检查的数组访问
+ */
+static BytecodeModule* compile_array_module(ASTNode* (*build)(void), bool optimize,
+                                            SymbolTable** symtbl_out, ASTNode** program_out,
+                                            uint32_t* unchecked, uint32_t* checked) {
+    ASTNode* program = build();
+    SymbolTable* symtbl = symtbl_init();
+    TypeChecker checker;
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+
+    Optimizer* opt = NULL;
+    if (optimize) {
+        opt = optimizer_create();
+        assert(opt != NULL);
+        assert(optimizer_run_ast(opt, program) == OK);
+    }
+    BytecodeModule* module = bytecode_module_create();
+    CodeGenContext* ctx = codegen_create(module, symtbl);
+    ctx->optimizer = opt;
+    assert(codegen_generate(ctx, program) == OK);
+    codegen_free(ctx);
+    if (opt) {
+        assert(optimizer_run_bytecode(opt, module) == OK);
+        optimizer_free(opt);
+    }
+
+    *unchecked = 0;
+    *checked = 0;
+    for (uint32_t pc = 0; pc < module->instruction_count; pc++) {
+        const Instruction* in = &module->instructions[pc];
+        assert(in->opcode != OP_LOAD_INDEXED && in->opcode != OP_STORE_INDEXED);
+        if (in->opcode != OP_LOAD_ARRAY && in->opcode != OP_STORE_ARRAY) continue;
+        if (in->flags & FLAG_UNCHECKED) {
+            (*unchecked)++;
+        } else {
+            (*checked)++;
+        }
+    }
+    *symtbl_out = symtbl;
+    *program_out = program;
+    return module;
+}
+
+void test_array_bounds(void) {
+    printf("\n--- Test: Array bounds checks ---\n");
+
+    for (int optimize = 0; optimize < 2; optimize++) {
+        SymbolTable* symtbl;
+        ASTNode* program;
+        uint32_t unchecked, checked;
+        BytecodeModule* module = compile_array_module(build_array_program, optimize != 0,
+                                                      &symtbl, &program, &unchecked, &checked);
+        assert(module->array_bound_count == 1);
+        assert(module->array_bounds[0].length == 10);
+        assert(unchecked == 2 && checked == 1);
+        assert(bytecode_verify_arrays(module));
+
+        // 伪造免检标志：变量下标无法重新证明，加载时拒绝
+        for (uint32_t pc = 0; pc < module->instruction_count; pc++) {
+            Instruction* in = &module->instructions[pc];
+            if (in->opcode == OP_LOAD_ARRAY && !(in->flags & FLAG_UNCHECKED)) {
+                in->flags |= FLAG_UNCHECKED;
+                assert(!bytecode_verify_arrays(module));
+                assert(bytecode_save(module, "test.stbc") == OK);
+                assert(bytecode_load("test.stbc") == NULL);
+                in->flags &= (uint8_t)~FLAG_UNCHECKED;
+            }
+        }
+        assert(bytecode_verify_arrays(module));
+
+        bytecode_module_free(module);
+        symtbl_free(symtbl);
+        ast_free_node(program);
+    }
+    printf("✓ Loop-indexed accesses unchecked, variable index checked, forged flag rejected\n");
+
+    // 越界下标在两种后端上都报错
+    SymbolTable* symtbl;
+    ASTNode* program;
+    uint32_t unchecked, checked;
+    BytecodeModule* module = compile_array_module(build_array_overrun_program, false,
+                                                  &symtbl, &program, &unchecked, &checked);
+    assert(unchecked == 2 && checked == 1);
+    VM* vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == ERR_OUT_OF_BOUNDS);
+    assert(strstr(vm->error_msg, "out of bounds: 10") != NULL);
+    vm_free(vm);
+
+    char reason[256];
+    assert(regcode_generate(module, reason, sizeof(reason)) == OK);
+    vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == ERR_OUT_OF_BOUNDS);
+    vm_free(vm);
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    ast_free_node(program);
+
+    // 常量下标越界在编译期报错
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    int32_t sizes[1] = { 10 };
+    TypeInfo* array_type = type_info_create_array(int_type, 1, sizes);
+    for (int use_ir = 0; use_ir < 2; use_ir++) {
+        ASTNode* decl = ast_create_var_decl("a", array_type, NULL, false, true);
+        ASTNode* stmt = ast_create_assign(
+            ast_create_array_access(ast_create_identifier("a"), opt_int_lit(10)), opt_int_lit(1));
+        program = ast_create_program("test", NULL, decl, NULL, stmt);
+        symtbl = symtbl_init();
+        TypeChecker checker;
+        assert(typecheck_init(&checker, symtbl, NULL) == OK);
+        assert(typecheck_program(&checker, program) == OK);
+        typecheck_cleanup(&checker);
+        module = bytecode_module_create();
+        CodeGenContext* ctx = codegen_create(module, symtbl);
+        ctx->use_ir = use_ir != 0;
+        assert(codegen_generate(ctx, program) == ERR_OUT_OF_BOUNDS);
+        assert(strstr(ctx->error_msg, "a[10]") != NULL);
+        codegen_free(ctx);
+        bytecode_module_free(module);
+        symtbl_free(symtbl);
+        ast_free_node(program);
+    }
+    type_info_free(array_type);
+    type_info_free(int_type);
+    printf("✓ a[10] fails at runtime on both backends and at compile time for a literal\n");
+
+    // ARRAY[1..10]：下标按 [1, 10] 检查，元素位于 基址 + (下标 - 1)
+    for (int variant = 0; variant < 4; variant++) {
+        int32_t y;
+        uint32_t n;
+        Optimizer* opt = NULL;
+        compile_and_run_program(build_lower_array_program, (variant & 1) != 0, (variant & 2) != 0,
+                                &y, &n, &opt);
+        assert(y == 11);
+        if (opt) optimizer_free(opt);
+    }
+
+    module = compile_array_module(build_lower_array_program, false, &symtbl, &program,
+                                  &unchecked, &checked);
+    assert(module->array_bound_count == 1);
+    assert(module->array_bounds[0].lower == 1 && module->array_bounds[0].length == 10);
+    assert(unchecked == 1 && checked == 1);
+    assert(bytecode_save(module, "test.stbc") == OK);
+    BytecodeModule* loaded = bytecode_load("test.stbc");
+    assert(loaded != NULL && loaded->array_bounds[0].lower == 1);
+    bytecode_module_free(loaded);
+    remove("test.stbc");
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    ast_free_node(program);
+
+    module = compile_array_module(build_lower_array_overrun_program, false, &symtbl, &program,
+                                  &unchecked, &checked);
+    vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == ERR_OUT_OF_BOUNDS);
+    assert(strstr(vm->error_msg, "out of bounds: 0 (range 1..10)") != NULL);
+    vm_free(vm);
+    assert(regcode_generate(module, reason, sizeof(reason)) == OK);
+    vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == ERR_OUT_OF_BOUNDS);
+    vm_free(vm);
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    ast_free_node(program);
+
+    // 常量下标 0 低于下界，编译期报错
+    int_type = type_info_create(TYPE_INT);
+    array_type = type_info_create_array(int_type, 1, sizes);
+    array_type->array_info.lower = 1;
+    for (int use_ir = 0; use_ir < 2; use_ir++) {
+        ASTNode* decl = ast_create_var_decl("a", array_type, NULL, false, true);
+        ASTNode* stmt = ast_create_assign(
+            ast_create_array_access(ast_create_identifier("a"), opt_int_lit(0)), opt_int_lit(1));
+        program = ast_create_program("test", NULL, decl, NULL, stmt);
+        symtbl = symtbl_init();
+        TypeChecker checker;
+        assert(typecheck_init(&checker, symtbl, NULL) == OK);
+        assert(typecheck_program(&checker, program) == OK);
+        typecheck_cleanup(&checker);
+        module = bytecode_module_create();
+        CodeGenContext* ctx = codegen_create(module, symtbl);
+        ctx->use_ir = use_ir != 0;
+        assert(codegen_generate(ctx, program) == ERR_OUT_OF_BOUNDS);
+        assert(strstr(ctx->error_msg, "a[0]") != NULL);
+        codegen_free(ctx);
+        bytecode_module_free(module);
+        symtbl_free(symtbl);
+        ast_free_node(program);
+    }
+    type_info_free(array_type);
+    type_info_free(int_type);
+    printf("✓ ARRAY[1..10] indexed 1..10 on both backends, 0 rejected at runtime and compile time\n");
+}
+
+// ============================================================================
+// 代数化简与强度削弱
+// ============================================================================
+
+/**
+ * VAR y : INT; x : INT; raw : INT; r : REAL; flag : BOOL; END_VAR
+ * raw := 1234; x := 7; r := 10.0; flag := TRUE;
+ * y := (raw AND 4095) * 100 / 4096;                 被除数 [0, 409500]：SHR 12
+ * y := y + (x MOD 8) * 4;                           被乘数 [-7, 7]：SHL 2
+ * y := ((y + x * 1) + 0) - -(-x);                   恒等运算、双重取负消去
+ * IF flag = FALSE THEN y := 0; END_IF               NOT flag
+ * IF NOT (x < 3) THEN y := y + 1000; END_IF         x >= 3
+ * IF r / 4.0 = 2.5 THEN y := y + 10000; END_IF      r * 0.25
+ * y := y + (x AND 15) / 2 + (x - 10) / 4;           前者 SHR 1，后者可能为负保留 DIV
+ * 结果 y = 30 + 28 + 1000 + 10000 + 3 + 0 = 11061
+ */
+static ASTNode* build_algebra_program(void) {
+    TypeInfo* int_type = type_info_create(TYPE_INT);
+    TypeInfo* real_type = type_info_create(TYPE_REAL);
+    TypeInfo* bool_type = type_info_create(TYPE_BOOL);
+
+    ASTNode* y = ast_create_var_decl("y", int_type, NULL, false, true);
+    y->next = ast_create_var_decl("x", int_type, NULL, false, true);
+    y->next->next = ast_create_var_decl("raw", int_type, NULL, false, true);
+    y->next->next->next = ast_create_var_decl("r", real_type, NULL, false, true);
+    y->next->next->next->next = ast_create_var_decl("flag", bool_type, NULL, false, true);
+
+    Value ten;
+    memset(&ten, 0, sizeof(ten));
+    ten.type = TYPE_REAL;
+    ten.real_val = 10.0;
+    Value four = ten, half = ten;
+    four.real_val = 4.0;
+    half.real_val = 2.5;
+
+    ASTNode* stmts[10];
+    stmts[0] = ast_create_assign(ast_create_identifier("raw"), opt_int_lit(1234));
+    stmts[1] = ast_create_assign(ast_create_identifier("x"), opt_int_lit(7));
+    stmts[2] = ast_create_assign(ast_create_identifier("r"), ast_create_literal(ten));
+    stmts[3] = ast_create_assign(ast_create_identifier("flag"), opt_bool_lit(true));
+    stmts[4] = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_DIV,
+            ast_create_binary_op(BINOP_MUL,
+                ast_create_binary_op(BINOP_AND, ast_create_identifier("raw"), opt_int_lit(4095)),
+                opt_int_lit(100)),
+            opt_int_lit(4096)));
+    stmts[5] = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"),
+            ast_create_binary_op(BINOP_MUL,
+                ast_create_binary_op(BINOP_MOD, ast_create_identifier("x"), opt_int_lit(8)),
+                opt_int_lit(4))));
+    stmts[6] = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_SUB,
+            ast_create_binary_op(BINOP_ADD,
+                ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"),
+                    ast_create_binary_op(BINOP_MUL, ast_create_identifier("x"), opt_int_lit(1))),
+                opt_int_lit(0)),
+            ast_create_unary_op(UNOP_NEG, ast_create_unary_op(UNOP_NEG, ast_create_identifier("x")))));
+    stmts[7] = ast_create_if(
+        ast_create_binary_op(BINOP_EQ, ast_create_identifier("flag"), opt_bool_lit(false)),
+        ast_create_assign(ast_create_identifier("y"), opt_int_lit(0)), NULL);
+    stmts[8] = ast_create_if(
+        ast_create_unary_op(UNOP_NOT,
+            ast_create_binary_op(BINOP_LT, ast_create_identifier("x"), opt_int_lit(3))),
+        ast_create_assign(ast_create_identifier("y"),
+            ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"), opt_int_lit(1000))), NULL);
+    stmts[8]->next = ast_create_if(
+        ast_create_binary_op(BINOP_EQ,
+            ast_create_binary_op(BINOP_DIV, ast_create_identifier("r"), ast_create_literal(four)),
+            ast_create_literal(half)),
+        ast_create_assign(ast_create_identifier("y"),
+            ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"), opt_int_lit(10000))), NULL);
+    stmts[9] = ast_create_assign(ast_create_identifier("y"),
+        ast_create_binary_op(BINOP_ADD,
+            ast_create_binary_op(BINOP_ADD, ast_create_identifier("y"),
+                ast_create_binary_op(BINOP_DIV,
+                    ast_create_binary_op(BINOP_AND, ast_create_identifier("x"), opt_int_lit(15)),
+                    opt_int_lit(2))),
+            ast_create_binary_op(BINOP_DIV,
+                ast_create_binary_op(BINOP_SUB, ast_create_identifier("x"), opt_int_lit(10)),
+                opt_int_lit(4))));
+    for (int i = 0; i < 9; i++) {
+        ASTNode* tail = stmts[i];
+        while (tail->next) tail = tail->next;
+        tail->next = stmts[i + 1];
+    }
+
+    type_info_free(int_type);
+    type_info_free(real_type);
+    type_info_free(bool_type);
+    return ast_create_program("test", NULL, y, NULL, stmts[0]);
+}
+
+void test_algebraic_simplification(void) {
+    printf("\n--- Test: Algebraic simplification and strength reduction ---\n");
+
+    ASTNode* program = build_algebra_program();
+    SymbolTable* symtbl = symtbl_init();
+    TypeChecker checker;
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+
+    Optimizer* opt = optimizer_create();
+    assert(opt != NULL);
+    assert(optimizer_run_ast(opt, program) == OK);
+    assert(opt->passes[OPT_PASS_ALGEBRAIC].changes == 9);
+
+    BytecodeModule* module = bytecode_module_create();
+    CodeGenContext* ctx = codegen_create(module, symtbl);
+    assert(codegen_generate(ctx, program) == OK);
+    codegen_free(ctx);
+
+    uint32_t counts[OP_COUNT] = { 0 };
+    for (uint32_t i = 0; i < module->instruction_count; i++) {
+        counts[module->instructions[i].opcode]++;
+    }
+    assert(counts[OP_SHR] == 2 && counts[OP_SHL] == 1);
+    assert(counts[OP_DIV] == 1);        // (x - 10) / 4
+    assert(counts[OP_MUL] == 2);        // * 100、r * 0.25
+    assert(counts[OP_NEG] == 0 && counts[OP_MOD] == 1);    // x MOD 8 可能为负，不改写
+    printf("✓ 9 rewrites: SHR x2, SHL x1, REAL division by 4.0 as multiplication\n");
+
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    optimizer_free(opt);
+    ast_free_node(program);
+
+    int32_t y;
+    uint32_t n_plain, n_opt;
+    compile_and_run_program(build_algebra_program, false, false, &y, &n_plain, NULL);
+    assert(y == 11061);
+    compile_and_run_program(build_algebra_program, true, false, &y, &n_opt, NULL);
+    assert(y == 11061);
+    assert(n_opt < n_plain);
+    compile_and_run_program(build_algebra_program, true, true, &y, &n_opt, NULL);
+    assert(y == 11061);
+    printf("✓ y = %d with and without the pass, instructions %u -> %u\n", y, n_plain, n_opt);
+}
+
+/**
+ * @brief 全局变量 y 的下标（加载的 .stbc 不带全局变量名）
+ */
+static uint32_t global_y_index(const BytecodeModule* module) {
+    for (uint32_t i = 0; i < module->global_count; i++) {
+        if (module->globals_info[i].name && strcmp(module->globals_info[i].name, "y") == 0) {
+            return module->globals_info[i].index;
+        }
+    }
+    assert(false);
+    return 0;
+}
+
+/**
+ * @brief 同一模块分别按栈式和寄存器格式执行，并经 .stbc 往返后再执行一次
+ */
+static void run_on_both_backends(ASTNode* (*build)(void), bool optimize, bool use_ir,
+                                 int32_t* y_out, uint64_t* stack_steps, uint64_t* reg_steps) {
+    ASTNode* program = build();
+    SymbolTable* symtbl = symtbl_init();
+    TypeChecker checker;
+    assert(typecheck_init(&checker, symtbl, NULL) == OK);
+    assert(typecheck_program(&checker, program) == OK);
+    typecheck_cleanup(&checker);
+
+    Optimizer* opt = NULL;
+    if (optimize) {
+        opt = optimizer_create();
+        assert(opt != NULL);
+        assert(optimizer_run_ast(opt, program) == OK);
+    }
+
+    BytecodeModule* module = bytecode_module_create();
+    CodeGenContext* ctx = codegen_create(module, symtbl);
+    ctx->use_ir = use_ir;
+    ctx->optimizer = opt;
+    assert(codegen_generate(ctx, program) == OK);
+    codegen_free(ctx);
+    if (opt) {
+        assert(optimizer_run_bytecode(opt, module) == OK);
+    }
+
+    uint32_t y = global_y_index(module);
+    VM* vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == OK);
+    int32_t y_stack = vm->globals[y].int_val;
+    *stack_steps = vm->instruction_count;
+    vm_free(vm);
+
+    char reason[256];
+    assert(regcode_generate(module, reason, sizeof(reason)) == OK);
+    assert(module->reg_code != NULL);
+    assert(module->reg_code->count < module->instruction_count);
+
+    vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == OK);
+    assert(vm->globals[y].int_val == y_stack);
+    *reg_steps = vm->instruction_count;
+    vm_free(vm);
+
+    // .stbc 往返保留寄存器代码
+    assert(bytecode_save(module, "test.stbc") == OK);
+    BytecodeModule* loaded = bytecode_load("test.stbc");
+    assert(loaded != NULL && loaded->reg_code != NULL);
+    assert(loaded->reg_code->count == module->reg_code->count);
+    vm = vm_create(loaded);
+    assert(vm != NULL);
+    assert(vm_run(vm) == OK);
+    assert(vm->globals[y].int_val == y_stack);
+    assert(vm->instruction_count == *reg_steps);
+    vm_free(vm);
+
+    // 修改指令后寄存器代码被丢弃，回到栈式执行
+    assert(bytecode_make_writable(loaded));
+    assert(loaded->reg_code == NULL);
+    vm = vm_create(loaded);
+    assert(vm != NULL);
+    assert(vm_run(vm) == OK);
+    assert(vm->globals[y].int_val == y_stack);
+    assert(vm->instruction_count == *stack_steps);
+    vm_free(vm);
+    bytecode_module_free(loaded);
+
+    *y_out = y_stack;
+    bytecode_module_free(module);
+    symtbl_free(symtbl);
+    optimizer_free(opt);
+    ast_free_node(program);
+}
+
+void test_register_vm(void) {
+    printf("\n--- Test: Register-based backend ---\n");
+
+    static ASTNode* (*const programs[])(void) = {
+        build_loops_program, build_dense_case_program, build_sparse_case_program,
+        build_short_circuit_program, build_for_program, build_inline_program,
+        build_cse_licm_program, build_array_program, build_algebra_program,
+    };
+    static const int32_t expected[] = { 50, 1225, 1225, 11000, 52255, 155, 159, 108, 11061 };
+
+    for (size_t p = 0; p < sizeof(programs) / sizeof(programs[0]); p++) {
+        for (int variant = 0; variant < 4; variant++) {
+            int32_t y;
+            uint64_t stack_steps, reg_steps;
+            run_on_both_backends(programs[p], (variant & 1) != 0, (variant & 2) != 0,
+                                 &y, &stack_steps, &reg_steps);
+            assert(y == expected[p]);
+            assert(reg_steps < stack_steps);
+            if (p == 0 && variant == 0) {
+                printf("✓ y = %d, executed %llu (stack) / %llu (register)\n", y,
+                       (unsigned long long)stack_steps, (unsigned long long)reg_steps);
+            }
+        }
+    }
+    printf("✓ Same results on both backends, .stbc round trip keeps register code\n");
+}
+
 int main(void) {
     printf("========================================\n");
     printf("  STVM Code Generator Test Suite\n");
@@ -301,6 +2006,20 @@ int main(void) {
     test_if_statement();
     test_while_loop();
     test_bytecode_save_load();
+    test_optimizer_const_globals();
+    test_optimizer_local_copies();
+    test_optimizer_keeps_traps();
+    test_ir_ssa_form();
+    test_ir_lowering();
+    test_case_jump_tables();
+    test_short_circuit();
+    test_for_loops();
+    test_function_inlining();
+    test_compiled_library();
+    test_cse_licm();
+    test_array_bounds();
+    test_algebraic_simplification();
+    test_register_vm();
     
     // 打印统计信息
     mmgr_print_stats();
@@ -10,6 +10,7 @@
 #include "../src/include/vm.h"
 #include "../src/include/bytecode_io.h"
 #include "../src/include/hotreload.h"
+#include "../src/include/bytecode_patch.h"
 #include "../src/include/mmgr.h"
 
 void create_test_program_v1(const char* filename) {
@@ -227,6 +228,80 @@ void test_enable_disable(void) {
     unlink("test_hr3.stbc");
 }
 
+/**
+ * @brief 构造补丁测试程序：把常量 value 写入名为 name 的全局变量
+ */
+static BytecodeModule* build_patch_program(int32_t value, const char** globals, uint32_t global_count,
+                                           uint16_t target_global) {
+    BytecodeModule* module = bytecode_module_create();
+    bytecode_add_instruction(module, OP_PUSH, 0, (uint16_t)bytecode_add_int_constant(module, value));
+    bytecode_add_instruction(module, OP_STORE, FLAG_GLOBAL, target_global);
+    bytecode_add_instruction(module, OP_HALT, 0, 0);
+    
+    module->global_count = global_count;
+    module->globals_info = (GlobalEntry*)mmgr_calloc(sizeof(GlobalEntry) * global_count);
+    for (uint32_t i = 0; i < global_count; i++) {
+        module->globals_info[i].name = mmgr_strdup(globals[i]);
+        module->globals_info[i].type = TYPE_INT;
+        module->globals_info[i].index = (int32_t)i;
+    }
+    return module;
+}
+
+void test_patch_hotreload(void) {
+    printf("=== 测试 4: 差分补丁热加载 ===\n\n");
+    
+    mmgr_init();
+    
+    const char* v1_globals[] = { "result" };
+    const char* v2_globals[] = { "result", "fresh" };
+    BytecodeModule* module = build_patch_program(100, v1_globals, 1, 0);
+    BytecodeModule* v2 = build_patch_program(200, v2_globals, 2, 1);
+    
+    VM* vm = vm_create(module);
+    assert(vm != NULL);
+    assert(vm_run(vm) == OK);
+    assert(vm->globals[0].int_val == 100);
+    vm->globals[0].int_val = 42;  // 运行期状态，补丁后应保留
+    
+    BytecodePatch* patch = bytecode_patch_create(module, v2);
+    assert(patch != NULL);
+    printf("补丁大小: %zu 字节\n", patch->size);
+    
+    HotReloadManager* mgr = hotreload_create(vm);
+    assert(mgr != NULL);
+    assert(hotreload_stage_patch_from_memory(mgr, patch) == OK);
+    assert(mgr->pending_op == HOTRELOAD_OP_APPLY_PATCH);
+    assert(hotreload_is_safe(mgr));
+    assert(hotreload_apply_staged(mgr) == OK);
+    assert(mgr->staged_patch == NULL);
+    assert(vm->module == module);  // 原地修改，模块未替换
+    
+    printf("运行补丁后的程序...\n");
+    assert(vm_run(vm) == OK);
+    printf("result = %d (预期: 42), fresh = %d (预期: 200)\n",
+           vm->globals[0].int_val, vm->globals[1].int_val);
+    assert(vm->global_count == 2);
+    assert(vm->globals[0].int_val == 42);
+    assert(vm->globals[1].int_val == 200);
+    
+    // 同一补丁不能再次应用（基准已变）
+    BytecodeModule* v1_copy = build_patch_program(100, v1_globals, 1, 0);
+    BytecodePatch* again = bytecode_patch_create(v1_copy, v2);
+    assert(again != NULL);
+    assert(hotreload_stage_patch_from_memory(mgr, again) == ERR_INVALID_BYTECODE);
+    assert(!mgr->reload_pending);
+    bytecode_module_free(v1_copy);
+    
+    printf("\n✓ 差分补丁热加载测试通过！\n\n");
+    
+    hotreload_free(mgr);
+    vm_free(vm);
+    bytecode_module_free(module);
+    bytecode_module_free(v2);
+    mmgr_cleanup();
+}
+
 int main(void) {
     printf("\n╔═══════════════════════════════════════╗\n");
     printf("║  STVM 热加载集成测试                 ║\n");
@@ -235,6 +310,7 @@ int main(void) {
     test_enable_disable();
     test_manual_hotreload();
     test_staged_hotreload();
+    test_patch_hotreload();
     
     printf("╔═══════════════════════════════════════╗\n");
     printf("║  所有测试通过！🎉                    ║\n");
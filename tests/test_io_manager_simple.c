@@ -5,8 +5,33 @@
 
 #include <stdio.h>
 #include <assert.h>
+#include <time.h>
+#include <sched.h>
 #include "iomgr.h"
 
+static int change_events = 0;
+static int32_t last_change_value = 0;
+
+static void on_change(const IOChangeEvent* event, void* user_data) {
+    (void)user_data;
+    change_events++;
+    last_change_value = event->new_value.int_val;
+}
+
+static IOManager* reentrant_mgr = NULL;
+static uint32_t reentrant_sub = 0;
+static int reentrant_events = 0;
+
+// 回调中调用管理器的加锁接口，并取消自己的订阅
+static void on_change_reentrant(const IOChangeEvent* event, void* user_data) {
+    (void)user_data;
+    reentrant_events++;
+    assert(io_manager_point_changed(reentrant_mgr, event->point_index));
+    assert(io_manager_get_changed_count(reentrant_mgr) >= 1);
+    assert(io_manager_set_deadband(reentrant_mgr, &event->address, 5.0) == OK);
+    assert(io_manager_unsubscribe(reentrant_mgr, reentrant_sub) == OK);
+}
+
 int main() {
     printf("=== STVM I/O Manager Test ===\n\n");
     
@@ -70,6 +95,191 @@ int main() {
     assert(err == OK);
     printf("✓ Read operation successful\n\n");
     
+    // 测试6：输入记录与回放
+    printf("Test 5: Record and replay...\n");
+    const char* trace_file = "/tmp/stvm_test_io_trace.bin";
+    IOAddress in_addr = {IO_LOC_INPUT, IO_SIZE_BIT, 0, 0};
+    
+    err = io_trace_start_recording(mgr, trace_file);
+    assert(err == OK);
+    for (int i = 0; i < 5; i++) {
+        // 通过模拟器的写入模拟外部信号变化
+        Value sim_val = {.type = TYPE_INT, .int_val = i * 10};
+        adapter->write(point->hal_handle, 0, &sim_val);
+        assert(io_manager_refresh_inputs(mgr) == OK);
+    }
+    assert(io_trace_stop_recording(mgr) == OK);
+    printf("✓ Recorded 5 scans\n");
+    
+    IOTraceReplay* replay = io_trace_replay_open(trace_file);
+    assert(replay != NULL);
+    assert(io_trace_replay_scan_count(replay) == 5);
+    assert(io_trace_replay_column_count(replay) == 1);
+    
+    assert(io_manager_attach_replay(mgr, replay) == OK);
+    for (int i = 0; i < 5; i++) {
+        // 中途重置统计不影响回放位置
+        if (i == 2) io_manager_reset_stats(mgr);
+        assert(io_manager_refresh_inputs(mgr) == OK);
+        err = io_manager_read(mgr, &in_addr, &read_val);
+        assert(err == OK);
+        assert(read_val.int_val == i * 10);
+    }
+    // 轨迹耗尽后保持最后的值
+    assert(io_manager_refresh_inputs(mgr) == ERR_OUT_OF_BOUNDS);
+    io_manager_read(mgr, &in_addr, &read_val);
+    assert(read_val.int_val == 40);
+    
+    assert(io_manager_attach_replay(mgr, NULL) == OK);
+    io_trace_replay_close(replay);
+    remove(trace_file);
+    printf("✓ Replay is deterministic per scan\n\n");
+    
+    // 测试7：变化检测与订阅
+    printf("Test 6: Change-of-state detection...\n");
+    uint32_t sub_id = 0;
+    assert(io_manager_subscribe(mgr, &in_addr, on_change, NULL, &sub_id) == OK);
+    assert(io_manager_set_deadband(mgr, &in_addr, 5.0) == OK);
+    
+    Value sim_val = {.type = TYPE_INT, .int_val = 100};
+    adapter->write(point->hal_handle, 0, &sim_val);
+    io_manager_refresh_inputs(mgr);
+    assert(io_manager_point_changed(mgr, 0));
+    assert(io_manager_get_changed_count(mgr) == 1);
+    assert(change_events == 1 && last_change_value == 100);
+    
+    // 死区内的变化不上报
+    sim_val.int_val = 104;
+    adapter->write(point->hal_handle, 0, &sim_val);
+    io_manager_refresh_inputs(mgr);
+    assert(!io_manager_point_changed(mgr, 0));
+    assert(change_events == 1);
+    
+    // 相对上次上报值累计超出死区后上报
+    sim_val.int_val = 106;
+    adapter->write(point->hal_handle, 0, &sim_val);
+    io_manager_refresh_inputs(mgr);
+    uint32_t words = 0;
+    uint64_t bitmap[1] = {0};
+    assert(io_manager_copy_change_bitmap(mgr, bitmap, 1, &words) == OK);
+    assert(words == 1 && (bitmap[0] & 1));
+    assert(change_events == 2 && last_change_value == 106);
+    
+    assert(io_manager_unsubscribe(mgr, sub_id) == OK);
+    assert(io_manager_unsubscribe(mgr, sub_id) == ERR_NOT_FOUND);
+    printf("✓ Change bitmap, deadband and subscriptions work\n");
+    
+    // 回调可以重入管理器
+    reentrant_mgr = mgr;
+    assert(io_manager_subscribe(mgr, NULL, on_change_reentrant, NULL, &reentrant_sub) == OK);
+    sim_val.int_val = 200;
+    adapter->write(point->hal_handle, 0, &sim_val);
+    io_manager_refresh_inputs(mgr);
+    assert(reentrant_events == 1);
+    sim_val.int_val = 300;
+    adapter->write(point->hal_handle, 0, &sim_val);
+    io_manager_refresh_inputs(mgr);
+    assert(reentrant_events == 1);
+    printf("✓ Callbacks may call back into the manager\n\n");
+    
+    // 测试8：实时刷新线程与时序统计
+    printf("Test 7: Real-time refresh timing...\n");
+    IORealtimeConfig rt = {
+        .cpu_affinity = 0,
+        .sched_policy = SCHED_FIFO,
+        .sched_priority = 10,
+        .lock_memory = false
+    };
+    assert(io_manager_set_realtime(mgr, &rt) == OK);
+    io_manager_reset_stats(mgr);
+    // 权限不足时退回默认属性，仍应能启动
+    assert(io_manager_start_refresh(mgr, 2000) == OK);
+    assert(io_manager_set_realtime(mgr, &rt) == ERR_RUNTIME);
+    // 刷新线程运行时读取变化位图快照
+    for (int i = 0; i < 1000; i++) {
+        uint64_t snapshot[1];
+        uint32_t snapshot_words = 0;
+        assert(io_manager_copy_change_bitmap(mgr, snapshot, 1, &snapshot_words) == OK);
+        assert(snapshot_words == 1);
+    }
+    struct timespec wait = {.tv_sec = 0, .tv_nsec = 50 * 1000000L};
+    nanosleep(&wait, NULL);
+    assert(io_manager_stop_refresh(mgr) == OK);
+    
+    IOTimingStats timing;
+    assert(io_manager_get_timing_stats(mgr, &timing) == OK);
+    assert(timing.cycles > 0);
+    uint64_t latency_samples = 0;
+    for (int i = 0; i < IO_TIMING_HIST_BUCKETS; i++) {
+        latency_samples += timing.latency_hist[i];
+    }
+    assert(latency_samples >= timing.cycles);
+    printf("✓ %llu cycles, max latency %llu us, max jitter %llu us, overruns %llu (rt=%d)\n\n",
+           (unsigned long long)timing.cycles, (unsigned long long)timing.max_latency_us,
+           (unsigned long long)timing.max_jitter_us, (unsigned long long)timing.overruns,
+           timing.realtime_applied);
+    
+    // 测试9：大规模配置编译与二进制缓存
+    printf("Test 8: Bulk config with binary cache...\n");
+    const char* cfg_file = "/tmp/stvm_test_io_bulk.json";
+    const char* cache_file = "/tmp/stvm_test_io_bulk.json.cache";
+    remove(cache_file);
+    FILE* cfg = fopen(cfg_file, "w");
+    assert(cfg != NULL);
+    fprintf(cfg, "[\n");
+    for (int i = 0; i < 10000; i++) {
+        fprintf(cfg, "  {\n    \"address\": \"%%IX%d.%d\",\n    \"type\": \"digital_in\",\n"
+                     "    \"pin\": %d\n  },\n", i / 8, i % 8, i);
+    }
+    fprintf(cfg, "]\n");
+    fclose(cfg);
+    
+    IOManager* bulk = io_manager_create(NULL);
+    assert(io_manager_load_config_cached(bulk, cfg_file, NULL) == OK);
+    assert(io_manager_get_point_count(bulk) == 10000);
+    io_manager_free(bulk);
+    
+    // 第二次加载命中缓存：改写缓存中最后一个点的硬件地址（32 字节文件头，
+    // 每点 48 字节记录，硬件地址在记录偏移 12），加载结果应来自缓存
+    const long last_record = 32 + 9999L * 48;
+    uint8_t word[4] = {0x39, 0x30, 0, 0};   // 12345，小端
+    FILE* cache = fopen(cache_file, "r+b");
+    assert(cache != NULL);
+    assert(fseek(cache, last_record + 12, SEEK_SET) == 0);
+    assert(fwrite(word, 1, sizeof(word), cache) == sizeof(word));
+    fclose(cache);
+    bulk = io_manager_create(NULL);
+    assert(io_manager_load_config_cached(bulk, cfg_file, NULL) == OK);
+    assert(io_manager_get_point_count(bulk) == 10000);
+    IOAddress bulk_addr = {IO_LOC_INPUT, IO_SIZE_BIT, 1249, 7};
+    IOPoint* bulk_point = io_manager_find_point(bulk, &bulk_addr);
+    assert(bulk_point != NULL && bulk_point->config.hardware_address == 12345);
+    io_manager_free(bulk);
+    
+    // 路径没有结尾的 NUL：缓存按损坏处理，回退到解析源文件并重写缓存
+    // （文件头偏移 12 为路径区长度，记录偏移 20 为路径在路径区中的偏移）
+    uint8_t blob_len[4] = {4, 0, 0, 0};
+    uint8_t path_offset[4] = {0, 0, 0, 0};
+    cache = fopen(cache_file, "r+b");
+    assert(cache != NULL);
+    assert(fseek(cache, 12, SEEK_SET) == 0);
+    assert(fwrite(blob_len, 1, sizeof(blob_len), cache) == sizeof(blob_len));
+    assert(fseek(cache, last_record + 20, SEEK_SET) == 0);
+    assert(fwrite(path_offset, 1, sizeof(path_offset), cache) == sizeof(path_offset));
+    assert(fseek(cache, 0, SEEK_END) == 0);
+    assert(fwrite("/dev", 1, 4, cache) == 4);
+    fclose(cache);
+    bulk = io_manager_create(NULL);
+    assert(io_manager_load_config_cached(bulk, cfg_file, NULL) == OK);
+    assert(io_manager_get_point_count(bulk) == 10000);
+    bulk_point = io_manager_find_point(bulk, &bulk_addr);
+    assert(bulk_point != NULL && bulk_point->config.hardware_address == 9999);
+    assert(bulk_point->config.hardware_path == NULL);
+    io_manager_free(bulk);
+    remove(cfg_file);
+    remove(cache_file);
+    printf("✓ 10000 points compiled, reloaded from cache, unterminated path falls back to JSON\n\n");
+    
     // 清理
     printf("Cleanup...\n");
     io_manager_free(mgr);
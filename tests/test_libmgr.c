@@ -7,6 +7,7 @@
 #include "bytecode.h"
 #include "bytecode_io.h"
 #include "mmgr.h"
+#include "vm.h"
 #include <stdio.h>
 #include <assert.h>
 
@@ -212,6 +213,232 @@ void test_duplicate_import() {
     symtbl_free(global_symtbl);
 }
 
+void test_indexed_library() {
+    printf("\n--- Test: Library With Symbol Index ---\n");
+    
+    BytecodeModule* module = create_test_library();
+    assert(bytecode_save_library(module, NULL, "test_lib_idx.stbc") == OK);
+    bytecode_module_free(module);
+    
+    SymbolTable* global_symtbl = symtbl_init();
+    LibraryManager* mgr = libmgr_create(global_symtbl);
+    
+    assert(libmgr_load_library(mgr, "test_lib_idx.stbc") == OK);
+    LoadedLibrary* lib = libmgr_find_library(mgr, "test_lib_idx");
+    assert(lib != NULL && lib->module->symbol_index != NULL);
+    
+    // 符号在首次使用时按索引登记，之后返回同一个符号
+    Symbol* sym = libmgr_resolve_symbol(mgr, "test_lib_idx.sqrt");
+    assert(sym != NULL && sym->kind == SYM_FUNCTION && sym->param_count == 1);
+    assert(libmgr_resolve_symbol(mgr, "test_lib_idx.sqrt") == sym);
+    assert(libmgr_resolve_symbol(mgr, "test_lib_idx.missing") == NULL);
+    
+    assert(libmgr_import_symbol(mgr, "test_lib_idx", "multiply", "mul") == OK);
+    assert(libmgr_import_symbol(mgr, "test_lib_idx", "missing", NULL) != OK);
+    ImportedSymbol* import = libmgr_find_import(mgr, "mul");
+    assert(import != NULL && import->symbol->param_count == 2);
+    assert(libmgr_resolve_symbol(mgr, "mul") != NULL);
+    
+    assert(libmgr_unload_library(mgr, "test_lib_idx") == OK);
+    assert(libmgr_find_import(mgr, "mul") == NULL);
+    
+    printf("✓ Symbols resolved through the embedded index\n");
+    
+    libmgr_free(mgr);
+    symtbl_free(global_symtbl);
+    remove("test_lib_idx.stbc");
+}
+
+void test_lazy_loading() {
+    printf("\n--- Test: Lazy Library Loading ---\n");
+    
+    // 库函数 twice(x) := x + x（返回值变量是参数之后的第一个局部变量）
+    BytecodeModule* lib_module = bytecode_module_create();
+    DataType int_param[] = {TYPE_INT};
+    bytecode_add_instruction(lib_module, OP_HALT, 0, 0);
+    uint32_t twice_addr = bytecode_current_position(lib_module);
+    bytecode_add_instruction(lib_module, OP_LOAD, 0, 0);
+    bytecode_add_instruction(lib_module, OP_LOAD, 0, 0);
+    bytecode_add_instruction(lib_module, OP_ADD, 0, 0);
+    bytecode_add_instruction(lib_module, OP_STORE, 0, 1);
+    bytecode_add_instruction(lib_module, OP_RET, 0, 0);
+    bytecode_add_function(lib_module, "twice", twice_addr, 1, 1, TYPE_INT, int_param);
+    assert(bytecode_save_library(lib_module, NULL, "lazy_lib.stbc") == OK);
+    bytecode_module_free(lib_module);
+    
+    // 主程序：twice(21)
+    BytecodeModule* module = bytecode_module_create();
+    uint32_t func_idx = bytecode_add_function(module, "lazy_lib.stbc.twice", 0, 1, 0, TYPE_INT, int_param);
+    bytecode_add_instruction(module, OP_PUSH, 0, bytecode_add_int_constant(module, 21));
+    bytecode_add_instruction(module, OP_CALL_EXT, 1, func_idx);
+    bytecode_add_instruction(module, OP_HALT, 0, 0);
+    
+    LibraryManager* mgr = libmgr_create(NULL);
+    assert(libmgr_defer_library(mgr, "lazy_lib.stbc") == OK);
+    assert(libmgr_defer_library(mgr, "lazy_lib.stbc") == OK);
+    assert(libmgr_defer_library(mgr, "never_called.stbc") == OK);
+    assert(libmgr_get_pending_count(mgr) == 2);
+    assert(libmgr_get_library_count(mgr) == 0);
+    
+    // 首次调用时才加载
+    VM* vm = vm_create(module);
+    vm_set_library_manager(vm, mgr);
+    assert(vm_run(vm) == OK);
+    Value result;
+    vm_get_result(vm, &result);
+    assert(result.type == TYPE_INT && result.int_val == 42);
+    vm_free(vm);
+    
+    assert(libmgr_get_library_count(mgr) == 1);
+    assert(libmgr_get_pending_count(mgr) == 1);
+    assert(libmgr_find_library(mgr, "never_called") == NULL);
+    
+    // 解析结果被缓存
+    LoadedLibrary* lib = NULL;
+    FunctionEntry* func = libmgr_resolve_call(mgr, "lazy_lib.stbc.twice", &lib);
+    assert(func != NULL && lib == libmgr_find_library(mgr, "lazy_lib"));
+    assert(func == &lib->module->functions[0]);
+    assert(libmgr_resolve_call(mgr, "lazy_lib.stbc.missing", NULL) == NULL);
+    assert(libmgr_resolve_call(mgr, "plain_function", NULL) == NULL);
+    
+    // 卸载后缓存失效，且不会再次加载（已不是延迟依赖）
+    assert(libmgr_unload_library(mgr, "lazy_lib") == OK);
+    assert(libmgr_resolve_call(mgr, "lazy_lib.stbc.twice", NULL) == NULL);
+    
+    printf("✓ Library loaded on first call, unused dependency never loaded\n");
+    
+    libmgr_free(mgr);
+    bytecode_module_free(module);
+    remove("lazy_lib.stbc");
+}
+
+/**
+ * @brief 保存只含一个单参数函数 name(x) := x * factor 的库
+ */
+static void save_scale_library(const char* filename, const char* name, int factor) {
+    BytecodeModule* lib_module = bytecode_module_create();
+    DataType int_param[] = {TYPE_INT};
+    bytecode_add_instruction(lib_module, OP_HALT, 0, 0);
+    uint32_t addr = bytecode_current_position(lib_module);
+    bytecode_add_instruction(lib_module, OP_LOAD, 0, 0);
+    bytecode_add_instruction(lib_module, OP_PUSH, 0, bytecode_add_int_constant(lib_module, factor));
+    bytecode_add_instruction(lib_module, OP_MUL, 0, 0);
+    bytecode_add_instruction(lib_module, OP_STORE, 0, 1);
+    bytecode_add_instruction(lib_module, OP_RET, 0, 0);
+    bytecode_add_function(lib_module, name, addr, 1, 1, TYPE_INT, int_param);
+    assert(bytecode_save_library(lib_module, NULL, filename) == OK);
+    bytecode_module_free(lib_module);
+}
+
+void test_call_path_boundary() {
+    printf("\n--- Test: Library Call Path Matching ---\n");
+    
+    // 已加载的 xscale_lib 以 "scale_lib.stbc" 结尾但不在路径分隔处，不能代替延迟依赖 scale_lib
+    save_scale_library("xscale_lib.stbc", "twice", 3);
+    save_scale_library("scale_lib.stbc", "twice", 2);
+    
+    LibraryManager* mgr = libmgr_create(NULL);
+    assert(libmgr_load_library(mgr, "xscale_lib.stbc") == OK);
+    assert(libmgr_defer_library(mgr, "scale_lib.stbc") == OK);
+    
+    LoadedLibrary* lib = NULL;
+    FunctionEntry* func = libmgr_resolve_call(mgr, "scale_lib.stbc.twice", &lib);
+    assert(func != NULL && lib == libmgr_find_library(mgr, "scale_lib"));
+    assert(libmgr_get_pending_count(mgr) == 0);
+    
+    func = libmgr_resolve_call(mgr, "xscale_lib.stbc.twice", &lib);
+    assert(func != NULL && lib == libmgr_find_library(mgr, "xscale_lib"));
+    assert(libmgr_resolve_call(mgr, "cale_lib.stbc.twice", NULL) == NULL);
+    
+    printf("✓ Call paths match on a directory boundary, lazy dependency loaded\n");
+    
+    libmgr_free(mgr);
+    remove("xscale_lib.stbc");
+    remove("scale_lib.stbc");
+}
+
+void test_shared_library_cache() {
+    printf("\n--- Test: Shared Library Cache ---\n");
+    
+    LibraryCacheStats base;
+    libmgr_cache_get_stats(&base);
+    assert(base.entries == 0);
+    
+    SymbolTable* symtbl_a = symtbl_init();
+    SymbolTable* symtbl_b = symtbl_init();
+    LibraryManager* mgr_a = libmgr_create(symtbl_a);
+    LibraryManager* mgr_b = libmgr_create(symtbl_b);
+    
+    // 两个管理器加载同一个库，共享同一份模块和符号表
+    assert(libmgr_load_library(mgr_a, "test_lib.stbc") == OK);
+    assert(libmgr_load_library(mgr_b, "./test_lib.stbc") == OK);
+    
+    LoadedLibrary* lib_a = libmgr_find_library(mgr_a, "test_lib");
+    LoadedLibrary* lib_b = libmgr_find_library(mgr_b, "test_lib");
+    assert(lib_a && lib_b);
+    assert(lib_a->module == lib_b->module);
+    assert(lib_a->symbols == lib_b->symbols);
+    
+    LibraryCacheStats stats;
+    libmgr_cache_get_stats(&stats);
+    assert(stats.entries == 1);
+    assert(stats.references == 2);
+    assert(stats.hits == base.hits + 1);
+    assert(stats.misses == base.misses + 1);
+    
+    // 库文件重新编译（校验和变化）后加载的是新版本，旧版本仍被 mgr_a 持有
+    BytecodeModule* rebuilt = create_test_library();
+    bytecode_add_instruction(rebuilt, OP_NOP, 0, 0);
+    assert(bytecode_save(rebuilt, "test_lib.stbc") == OK);
+    bytecode_module_free(rebuilt);
+    
+    assert(libmgr_unload_library(mgr_b, "test_lib") == OK);
+    assert(libmgr_load_library(mgr_b, "test_lib.stbc") == OK);
+    lib_b = libmgr_find_library(mgr_b, "test_lib");
+    assert(lib_b->module != lib_a->module);
+    assert(lib_b->module->instruction_count == 2);
+    
+    libmgr_cache_get_stats(&stats);
+    assert(stats.entries == 2);
+    assert(stats.references == 2);
+    
+    // 只改常量值（指令和各表规模不变、文件头校验和不变）也会加载新版本
+    BytecodeModule* const_only = create_test_library();
+    bytecode_add_instruction(const_only, OP_NOP, 0, 0);
+    const_only->constants[0].int_val = 43;
+    assert(bytecode_save(const_only, "test_lib.stbc") == OK);
+    bytecode_module_free(const_only);
+    
+    LibraryCacheStats before;
+    libmgr_cache_get_stats(&before);
+    assert(libmgr_unload_library(mgr_b, "test_lib") == OK);
+    assert(libmgr_load_library(mgr_b, "test_lib.stbc") == OK);
+    lib_b = libmgr_find_library(mgr_b, "test_lib");
+    assert(lib_b->module != lib_a->module);
+    assert(lib_b->module->constants[0].int_val == 43);
+    
+    libmgr_cache_get_stats(&stats);
+    assert(stats.entries == 2);
+    assert(stats.references == 2);
+    assert(stats.misses == before.misses + 1);
+    
+    // 最后一个引用释放时从缓存中移除
+    assert(libmgr_unload_library(mgr_a, "test_lib") == OK);
+    libmgr_cache_get_stats(&stats);
+    assert(stats.entries == 1);
+    
+    libmgr_free(mgr_b);
+    libmgr_cache_get_stats(&stats);
+    assert(stats.entries == 0);
+    assert(stats.references == 0);
+    
+    printf("✓ Modules shared across managers and evicted on last unload\n");
+    
+    libmgr_free(mgr_a);
+    symtbl_free(symtbl_a);
+    symtbl_free(symtbl_b);
+}
+
 int main() {
     printf("========================================\n");
     printf("  STVM Library Manager Test Suite\n");
@@ -227,6 +454,10 @@ int main() {
     test_library_unload();
     test_search_paths();
     test_duplicate_import();
+    test_indexed_library();
+    test_lazy_loading();
+    test_call_path_boundary();
+    test_shared_library_cache();
     
     // 清理测试文件
     remove("test_lib.stbc");